@@ -109,6 +109,32 @@ extern bool         AVMPI_commitMemory(void* address, size_t size);
 */
 extern bool         AVMPI_decommitMemory(char *address, size_t size);
 
+/**
+* Like AVMPI_commitMemory, but also pass hints about the use of the memory to the OS.
+* The hints are advisory; the memory is committed whether or not they are honored.
+* @param address base address of the memory region to commit
+* @param size size, in bytes, of the memory to commit
+* @param hugePages if true, ask for the region to be backed by huge pages where it covers
+*        whole huge pages (see AVMPI_getHugePageSize)
+* @param numaNode if not negative, ask for the region to be placed on this NUMA node
+* @param hugePagesAdvised set to true if the OS accepted the request for huge pages
+* @return true if the function succeeds, false otherwise
+* @see AVMPI_commitMemory()
+*/
+extern bool         AVMPI_commitMemoryWithHints(void* address, size_t size, bool hugePages, int32_t numaNode, bool* hugePagesAdvised);
+
+/**
+* @return the size, in bytes, of the huge pages AVMPI_commitMemoryWithHints can ask for,
+* or 0 if the platform does not support them.
+*/
+extern size_t       AVMPI_getHugePageSize();
+
+/**
+* @return the NUMA node of the processor the calling thread is running on, or -1 if it
+* is not known.
+*/
+extern int32_t      AVMPI_getCurrentNumaNode();
+
 /**
  * Allocate memory for jitted code.
  *
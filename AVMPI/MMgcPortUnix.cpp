@@ -38,6 +38,10 @@
 
 #include <fcntl.h>
 
+#ifdef linux
+    #include <sys/syscall.h>
+#endif
+
 // It's possible to use the flushw instruction on sparc9, but this should always work
 
 #if defined SOLARIS && defined MMGC_SPARC
@@ -117,13 +121,46 @@ bool AVMPI_releaseMemoryRegion(void* address, size_t size)
     return (result == 0);
 }
 
-bool AVMPI_commitMemory(void* address, size_t size)
+// Huge pages and NUMA placement are only supported on Linux, through madvise(2),
+// mbind(2), and getcpu(2).  The system calls are made directly so that libnuma is
+// not required.
+
+#if defined(linux) && defined(MADV_HUGEPAGE)
+    #define HAVE_HUGE_PAGES
+#endif
+
+#if defined(linux) && defined(SYS_mbind) && defined(SYS_getcpu)
+    #define HAVE_NUMA
+    static const int kMPOL_PREFERRED = 1;   // From <numaif.h>
+#endif
+
+static bool commitMemory(void* address, size_t size, bool hugePages, int32_t numaNode, bool* hugePagesAdvised)
 {
     char *addr = (char*)mmap((maddr_ptr)address,
                              size,
                              PROT_READ | PROT_WRITE,
                              MAP_PRIVATE | MAP_FIXED | MAP_ANONYMOUS,
                              -1, 0);
+    if (addr != address)
+        return false;
+
+    // The hints have to be given before the pages are touched below, since that
+    // is when the pages are allocated.
+    *hugePagesAdvised = false;
+#ifdef HAVE_HUGE_PAGES
+    if (hugePages)
+        *hugePagesAdvised = madvise(addr, size, MADV_HUGEPAGE) == 0;
+#else
+    (void)hugePages;
+#endif
+#ifdef HAVE_NUMA
+    if (numaNode >= 0 && numaNode < int32_t(8 * sizeof(unsigned long))) {
+        unsigned long nodemask = 1UL << numaNode;
+        syscall(SYS_mbind, addr, size, kMPOL_PREFERRED, &nodemask, 8 * sizeof(unsigned long) + 1, 0);
+    }
+#else
+    (void)numaNode;
+#endif
 
     size_t pageSize = VMPI_getVMPageSize();
     char* temp_addr = addr;
@@ -133,7 +170,53 @@ bool AVMPI_commitMemory(void* address, size_t size)
         *temp_addr = 0;
         temp_addr += pageSize; //verify rishit
     }
-    return addr == address;
+    return true;
+}
+
+bool AVMPI_commitMemory(void* address, size_t size)
+{
+    bool hugePagesAdvised;
+    return commitMemory(address, size, false, -1, &hugePagesAdvised);
+}
+
+bool AVMPI_commitMemoryWithHints(void* address, size_t size, bool hugePages, int32_t numaNode, bool* hugePagesAdvised)
+{
+    return commitMemory(address, size, hugePages, numaNode, hugePagesAdvised);
+}
+
+size_t AVMPI_getHugePageSize()
+{
+#ifdef HAVE_HUGE_PAGES
+    // Transparent huge pages are available if the kernel reports their size.
+    static size_t hugePageSize = size_t(-1);
+    if (hugePageSize == size_t(-1)) {
+        size_t size = 0;
+        int fd = open("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", O_RDONLY);
+        if (fd != -1) {
+            char buf[32];
+            ssize_t n = read(fd, buf, sizeof(buf) - 1);
+            if (n > 0) {
+                buf[n] = 0;
+                size = (size_t)VMPI_strtol(buf, NULL, 10);
+            }
+            close(fd);
+        }
+        hugePageSize = size;
+    }
+    return hugePageSize;
+#else
+    return 0;
+#endif
+}
+
+int32_t AVMPI_getCurrentNumaNode()
+{
+#ifdef HAVE_NUMA
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0)
+        return int32_t(node);
+#endif
+    return -1;
 }
 
 bool AVMPI_decommitMemory(char *address, size_t size)
@@ -49,6 +49,22 @@ bool AVMPI_decommitMemory(char* /*address*/, size_t /*size*/)
 	return false;
 }
 
+bool AVMPI_commitMemoryWithHints(void* address, size_t size, bool /*hugePages*/, int32_t /*numaNode*/, bool* hugePagesAdvised)
+{
+    *hugePagesAdvised = false;
+    return AVMPI_commitMemory(address, size);
+}
+
+size_t AVMPI_getHugePageSize()
+{
+    return 0;
+}
+
+int32_t AVMPI_getCurrentNumaNode()
+{
+    return -1;
+}
+
 void* AVMPI_allocateAlignedMemory(size_t size)
 {
 	void* mem = _aligned_malloc(size, VMPI_getVMPageSize());
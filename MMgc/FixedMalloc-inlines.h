@@ -25,10 +25,10 @@ namespace MMgc
         m_heap->CheckForOOMAbortAllocation();
 #endif
 
-        if (size <= (size_t)kLargestAlloc)
+        if (size <= m_inlineAllocLimit)
             return FindAllocatorForSize(size)->Alloc(size, flags);
         else
-            return LargeAlloc(size, flags);
+            return AllocSlow(size, flags);
     }
 
     REALLY_INLINE void *FixedMalloc::PleaseAlloc(size_t size)
@@ -98,11 +98,11 @@ namespace MMgc
         // optimization allows us to skip the &~7 that is redundant
         // for non-debug builds.
 #ifdef MMGC_64BIT
-        unsigned const index = kSizeClassIndex[((size+7)>>3)];
+        unsigned const index = m_sizeClassIndex[((size+7)>>3)];
 #else
         // The first bucket is 4 on 32-bit systems, so special case that rather
         // than double the size-class-index table.
-        unsigned const index = (size <= 4) ? 0 : kSizeClassIndex[((size+7)>>3)];
+        unsigned const index = (size <= 4) ? 0 : m_sizeClassIndex[((size+7)>>3)];
 #endif
 
         // Assert that I fit.
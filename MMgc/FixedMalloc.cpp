@@ -137,8 +137,30 @@ static inline int LargeFixedAllocHeapPartition(int index) { GCAssert(kFixedParti
         VMPI_lockInit(&m_largeObjectLock);
     #endif
 
+        const uint16_t* sizeClasses = heap->Config().fixedMallocSizeClasses;
+        if (sizeClasses != NULL && !SizeClassHistogram::IsValid(sizeClasses, kSizeClasses, kNumSizeClasses))
+            sizeClasses = NULL;     // Ignored, as documented in GCHeap.h
+        m_sizeClassIndex = kSizeClassIndex;
         for (int i=0; i<kNumSizeClasses; i++)
-			m_allocs[i].Init((uint32_t)kSizeClasses[i], heap, SmallFixedAllocHeapPartition(partition));
+            m_sizeClasses[i] = sizeClasses != NULL ? sizeClasses[i] : uint16_t(kSizeClasses[i]);
+        if (sizeClasses != NULL) {
+            // As kSizeClassIndex is generated, see above.
+            int i = 0;
+            for (uint32_t j=0; j < kMaxSizeClassIndex; j++) {
+                while (m_sizeClasses[i] < j*8)
+                    i++;
+                m_tunedSizeClassIndex[j] = uint8_t(i);
+            }
+            m_sizeClassIndex = m_tunedSizeClassIndex;
+        }
+
+        VMPI_lockInit(&m_sizeClassHistogramLock);
+        m_inlineAllocLimit = kLargestAlloc;
+        if (heap->Config().fixedMallocStatistics && m_sizeClassHistogram.Init(kLargestAlloc))
+            m_inlineAllocLimit = 0;
+
+        for (int i=0; i<kNumSizeClasses; i++)
+			m_allocs[i].Init((uint32_t)m_sizeClasses[i], heap, SmallFixedAllocHeapPartition(partition));
 
         m_rootFindCache.Init();
 
@@ -155,6 +177,8 @@ static inline int LargeFixedAllocHeapPartition(int index) { GCAssert(kFixedParti
         VMPI_lockDestroy(&m_largeObjectLock);
     #endif
         m_rootFindCache.Destroy();
+        m_sizeClassHistogram.Destroy();
+        VMPI_lockDestroy(&m_sizeClassHistogramLock);
 
         FixedMalloc::instances[partition] = NULL;
     }
@@ -181,6 +205,65 @@ static inline int LargeFixedAllocHeapPartition(int index) { GCAssert(kFixedParti
         Free(p);
     }
 
+    void* FASTCALL FixedMalloc::AllocSlow(size_t size, FixedMallocOpts flags)
+    {
+        if (m_sizeClassHistogram.IsEnabled()) {
+            MMGC_LOCK(m_sizeClassHistogramLock);
+            m_sizeClassHistogram.Record(size, size);
+        }
+        if (size <= (size_t)kLargestAlloc)
+            return FindAllocatorForSize(size)->Alloc(size, flags);
+        else
+            return LargeAlloc(size, flags);
+    }
+
+    void FixedMalloc::GetSizeClassStats(int index, SizeClassStats& stats)
+    {
+        GCAssert(index >= 0 && index < kNumSizeClasses);
+        VMPI_memset(&stats, 0, sizeof(stats));
+        stats.itemSize = m_sizeClasses[index];
+        if (m_sizeClassHistogram.IsEnabled()) {
+            MMGC_LOCK(m_sizeClassHistogramLock);
+            m_sizeClassHistogram.Accumulate(index == 0 ? 0 : m_sizeClasses[index-1], m_sizeClasses[index], stats);
+        }
+        stats.bytesRounded = stats.requests * stats.itemSize;
+        size_t ask, allocated;
+        m_allocs[index].GetUsageInfo(ask, allocated);
+        stats.liveItems = allocated / (m_allocs[index].GetItemSize() + DebugSize());
+        stats.blocks = m_allocs[index].GetNumBlocks();
+    }
+
+    void FixedMalloc::DumpSizeClassStats()
+    {
+        SizeClassHistogram::LogHeader("FixedMalloc");
+        for (int i=0; i<kNumSizeClasses; i++) {
+            SizeClassStats stats;
+            GetSizeClassStats(i, stats);
+            SizeClassHistogram::LogStats(stats);
+        }
+        MMGC_LOCK(m_sizeClassHistogramLock);
+        m_sizeClassHistogram.LogLargeRequests();
+    }
+
+    bool FixedMalloc::ComputeSizeClasses(uint16_t sizeClasses[])
+    {
+        if (!m_sizeClassHistogram.IsEnabled())
+            return false;
+
+        // The smallest class is 4 bytes on 32-bit systems, so keep 8 as well: the
+        // buckets of the histogram are 8 bytes wide.
+        uint16_t table[kNumSizeClasses];
+        uint32_t numFixed = kSizeClasses[0] < 8 ? 2 : 1;
+        for (uint32_t i=0; i < numFixed; i++)
+            table[i] = uint16_t(kSizeClasses[i]);
+        MMGC_LOCK(m_sizeClassHistogramLock);
+        if (!m_sizeClassHistogram.ComputeSizeClasses(table, kNumSizeClasses, numFixed, GCHeap::kBlockSize - offsetof(FixedAlloc::FixedBlock, items)))
+            return false;
+        GCAssert(SizeClassHistogram::IsValid(table, kSizeClasses, kNumSizeClasses));
+        VMPI_memcpy(sizeClasses, table, sizeof(table));
+        return true;
+    }
+
     void FixedMalloc::GetUsageInfo(size_t& totalAskSize, size_t& totalAllocated)
     {
         totalAskSize = 0;
@@ -294,7 +377,7 @@ static inline int LargeFixedAllocHeapPartition(int index) { GCAssert(kFixedParti
         for (int i=0; i<kNumSizeClasses; i++) {
             m_allocs[i].GetUsageInfo(ask, inUse);
             if( m_allocs[i].GetNumBlocks() > 0)
-                GCLog("[mem] FixedMalloc[%d] total %d pages inuse %d bytes ask %d bytes\n", kSizeClasses[i], m_allocs[i].GetNumBlocks(), inUse, ask);
+                GCLog("[mem] FixedMalloc[%d] total %d pages inuse %d bytes ask %d bytes\n", m_sizeClasses[i], m_allocs[i].GetNumBlocks(), inUse, ask);
         }
         GCLog("[mem] FixedMalloc[large] total %d pages\n", GetNumLargeBlocks());
     }
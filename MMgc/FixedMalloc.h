@@ -150,6 +150,30 @@ namespace MMgc
          */
         size_t GetBytesInUse();
 
+        /**
+         * Obtain the statistics of one size class.  The requests are counted only
+         * if GCHeapConfig::fixedMallocStatistics was set.
+         *
+         * @param index  The size class, 0 to kNumSizeClasses-1
+         * @param stats  (out) The statistics
+         */
+        void GetSizeClassStats(int index, SizeClassStats& stats);
+
+        /**
+         * Print the statistics of the size classes in use on the VMPI_log channel.
+         */
+        void DumpSizeClassStats();
+
+        /**
+         * Compute a table of kNumSizeClasses size classes fitted to the requests
+         * recorded so far, for GCHeapConfig::fixedMallocSizeClasses.  The smallest
+         * and largest classes are those of kSizeClasses; see SizeClassHistogram.
+         *
+         * @return false if GCHeapConfig::fixedMallocStatistics was not set or no
+         *         requests were recorded.
+         */
+        bool ComputeSizeClasses(uint16_t sizeClasses[]);
+
 #ifdef MMGC_MEMORY_PROFILER
         /**
          * Print semi-structured human-readable data about FixedMalloc memory usage
@@ -244,9 +268,14 @@ namespace MMgc
         // from LargeAlloc.
         size_t LargeSize(const void *item);
         
+        // Allocate when the request is too large for the inline path in Alloc:
+        // record the request if statistics are enabled, then allocate it.
+        void* FASTCALL AllocSlow(size_t size, FixedMallocOpts flags);
+
     private:
         static FixedMalloc *instances[kNumFixedPartitions];   // A single FixedMalloc instance for each partition
 
+    public:
 #ifdef MMGC_64BIT
         const static int kLargestAlloc = 2016;  // The largest small-object allocation
 #else
@@ -254,9 +283,12 @@ namespace MMgc
 #endif
         const static int kNumSizeClasses = 41;  // The number of small-object size classes
         
-        // A table whose nth entry is the maximum size accomodated by the
-        // allocator in the nth entry of the m_allocs table.
+        // The built-in table whose nth entry is the maximum size accomodated by
+        // the allocator in the nth entry of the m_allocs table, unless
+        // GCHeapConfig::fixedMallocSizeClasses replaces it.
         const static int16_t kSizeClasses[kNumSizeClasses];
+
+    private:
         
         // The number of entries in the table mapping a request not greater than
         // kLargestAlloc to the appropriate index in m_allocs.
@@ -269,6 +301,12 @@ namespace MMgc
 
     private:
 		GCHeap *m_heap;								// The heap from which we allocate, set in InitInstance
+        size_t m_inlineAllocLimit;                  // The largest request Alloc handles inline: kLargestAlloc, or 0 while recording statistics
+        const uint8_t* m_sizeClassIndex;            // kSizeClassIndex, or m_tunedSizeClassIndex with GCHeapConfig::fixedMallocSizeClasses
+        uint16_t m_sizeClasses[kNumSizeClasses];    // The size classes in use, set in InitInstance
+        uint8_t m_tunedSizeClassIndex[kMaxSizeClassIndex];  // The index table for GCHeapConfig::fixedMallocSizeClasses
+        vmpi_spin_lock_t m_sizeClassHistogramLock;  // Protects m_sizeClassHistogram
+        SizeClassHistogram m_sizeClassHistogram;    // Sizes of small requests if GCHeapConfig::fixedMallocStatistics
 		int m_largeAllocHeapPartition;				// The heap partition in which we allocate large objects, set in InitInstance
         FixedAllocSafe m_allocs[kNumSizeClasses];   // The array of size-segregated allocators for small objects, set in InitInstance
 
@@ -108,7 +108,7 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if (size <= kLargestAlloc)
+        if (size <= inlineAllocLimit)
             return GetUserPointer(containsPointersNonfinalizedAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero));
 #endif
         return Alloc(size, GC::kContainsPointers|GC::kZero, partition);
@@ -118,7 +118,7 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if (size <= kLargestAlloc)
+        if (size <= inlineAllocLimit)
             return GetUserPointer(containsPointersNonfinalizedAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kInternalExact));
 #endif
         return Alloc(size, GC::kContainsPointers|GC::kZero|GC::kInternalExact, partition);
@@ -128,7 +128,7 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if (size <= kLargestAlloc)
+        if (size <= inlineAllocLimit)
             return GetUserPointer(containsPointersFinalizedAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kFinalize));
 #endif
         return Alloc(size, GC::kContainsPointers|GC::kZero|GC::kFinalize, partition);
@@ -138,7 +138,7 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if (size <= kLargestAlloc)
+        if (size <= inlineAllocLimit)
             return GetUserPointer(containsPointersFinalizedAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kFinalize|GC::kInternalExact));
 #endif
         return Alloc(size, GC::kContainsPointers|GC::kZero|GC::kFinalize|GC::kInternalExact, partition);
@@ -148,7 +148,7 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if (size <= kLargestAlloc)
+        if (size <= inlineAllocLimit)
             return GetUserPointer(containsPointersRCAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kRCObject|GC::kFinalize));
 #endif
         return Alloc(size, GC::kContainsPointers|GC::kZero|GC::kRCObject|GC::kFinalize, partition);
@@ -158,7 +158,7 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if (size <= kLargestAlloc)
+        if (size <= inlineAllocLimit)
             return GetUserPointer(containsPointersRCAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kRCObject|GC::kFinalize|GC::kInternalExact));
 #endif
         return Alloc(size, GC::kContainsPointers|GC::kZero|GC::kRCObject|GC::kFinalize|GC::kInternalExact, partition);
@@ -167,10 +167,10 @@ namespace MMgc
     REALLY_INLINE void* GC::AllocDouble()
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER && !defined MMGC_MEMORY_PROFILER
-        return GetUserPointer(noPointersNonfinalizedAllocs[0][kBoxedDoublePartition]->Alloc(/*flags*/0));
-#else
-        return Alloc(8,0,kBoxedDoublePartition);
+        if (inlineAllocLimit != 0)
+            return GetUserPointer(noPointersNonfinalizedAllocs[0][kBoxedDoublePartition]->Alloc(/*flags*/0));
 #endif
+        return Alloc(8,0,kBoxedDoublePartition);
     }
 
     REALLY_INLINE void* GC::AllocBibop(GCAlloc* bibopAlloc)
@@ -210,7 +210,7 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if ((size|extra) <= (kLargestAlloc/2 & ~7)) {
+        if ((size|extra) <= (inlineAllocLimit/2 & ~7)) {
             size += extra;
             return GetUserPointer(containsPointersNonfinalizedAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero));
         }
@@ -222,19 +222,31 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if ((size|extra) <= (kLargestAlloc/2 & ~7)) {
+        if ((size|extra) <= (inlineAllocLimit/2 & ~7)) {
             size += extra;
             return GetUserPointer(containsPointersNonfinalizedAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kInternalExact));
         }
 #endif
         return OutOfLineAllocExtra(size, extra, GC::kContainsPointers|GC::kZero|GC::kInternalExact, partition);
     }
+
+    REALLY_INLINE void *GC::AllocExtraPtrZeroExactMovable(size_t size, size_t extra, int partition)
+    {
+#if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
+		GCAssert(partition < kNumGCPartitions);
+        if ((size|extra) <= (inlineAllocLimit/2 & ~7)) {
+            size += extra;
+            return GetUserPointer(containsPointersNonfinalizedAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kInternalExact|GC::kInternalMovable));
+        }
+#endif
+        return OutOfLineAllocExtra(size, extra, GC::kContainsPointers|GC::kZero|GC::kInternalExact|GC::kInternalMovable, partition);
+    }
     
     REALLY_INLINE void *GC::AllocExtraPtrZeroFinalized(size_t size, size_t extra, int partition)
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if ((size|extra) <= (kLargestAlloc/2 & ~7)) {
+        if ((size|extra) <= (inlineAllocLimit/2 & ~7)) {
             size += extra;
             return GetUserPointer(containsPointersFinalizedAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kFinalize));
         }
@@ -246,7 +258,7 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if ((size|extra) <= (kLargestAlloc/2 & ~7)) {
+        if ((size|extra) <= (inlineAllocLimit/2 & ~7)) {
             size += extra;
             return GetUserPointer(containsPointersFinalizedAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kFinalize|GC::kInternalExact));
         }
@@ -258,7 +270,7 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if ((size|extra) <= kLargestAlloc/2) {
+        if ((size|extra) <= inlineAllocLimit/2) {
             size += extra;
             return GetUserPointer(containsPointersRCAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kRCObject|GC::kFinalize));
         }
@@ -270,7 +282,7 @@ namespace MMgc
     {
 #if !defined GCDEBUG && !defined AVMPLUS_SAMPLER
 		GCAssert(partition < kNumGCPartitions);
-        if ((size|extra) <= kLargestAlloc/2) {
+        if ((size|extra) <= inlineAllocLimit/2) {
             size += extra;
             return GetUserPointer(containsPointersRCAllocs[sizeClassIndex[(size-1)>>3]][partition]->Alloc(SIZEARG GC::kContainsPointers|GC::kZero|GC::kRCObject|GC::kFinalize|GC::kInternalExact));
         }
@@ -424,6 +436,112 @@ namespace MMgc
         GetGCBits(realptr) &= ~kQueued;
     }
 
+    REALLY_INLINE GCMarkStack& GC::CurrentMarkStack()
+    {
+        if (m_markingInParallel)
+            return *m_parallelMarker->CurrentMarker()->stack;
+        return m_incrementalWork;
+    }
+
+    REALLY_INLINE bool GC::ClaimForMarking(gcbits_t& bits, gcbits_t flag)
+    {
+        if (m_markingInParallel)
+            return ClaimForMarkingAtomic(bits, flag);
+        GCAssert((bits & (kMark|kQueued)) == 0);
+        bits |= flag;
+        return true;
+    }
+
+    /*static*/
+    REALLY_INLINE bool GC::ClaimForMarkingAtomic(gcbits_t& bits, gcbits_t flag)
+    {
+        // There is no byte-wide compare-and-swap, so operate on the aligned word
+        // that holds the bits.  Other markers may be claiming neighboring objects
+        // through the same word; the loop retries if any byte changed.
+        volatile int32_t* word = (volatile int32_t*)(uintptr_t(&bits) & ~uintptr_t(3));
+        uintptr_t offset = uintptr_t(&bits) & 3;
+        for (;;) {
+            int32_t oldval = *word;
+            int32_t newval = oldval;
+            gcbits_t* b = (gcbits_t*)&newval + offset;
+            if ((*b & (kMark|kQueued)) != 0)
+                return false;
+            *b |= flag;
+            if (VMPI_compareAndSwap32WithBarrier(oldval, newval, word))
+                return true;
+        }
+    }
+
+    /*static*/
+    REALLY_INLINE void GC::UpdateBitsAtomic(gcbits_t& bits, gcbits_t clear, gcbits_t set)
+    {
+        // See ClaimForMarkingAtomic.
+        volatile int32_t* word = (volatile int32_t*)(uintptr_t(&bits) & ~uintptr_t(3));
+        uintptr_t offset = uintptr_t(&bits) & 3;
+        for (;;) {
+            int32_t oldval = *word;
+            int32_t newval = oldval;
+            gcbits_t* b = (gcbits_t*)&newval + offset;
+            *b = gcbits_t((*b & ~clear) | set);
+            if (VMPI_compareAndSwap32WithBarrier(oldval, newval, word))
+                return;
+        }
+    }
+
+    REALLY_INLINE void GC::SetPinned(gcbits_t& bits)
+    {
+        if (m_markingInParallel)
+            UpdateBitsAtomic(bits, 0, kPinned);
+        else
+            bits |= kPinned;
+    }
+
+    REALLY_INLINE void GC::SignalExactMarkWork(uint32_t nbytes)
+    {
+        if (m_markingInParallel) {
+            GCMarkerWork& work = m_parallelMarker->CurrentMarker()->work;
+            work.objectsExact++;
+            work.bytesExact += nbytes;
+        }
+        else
+            policy.signalExactMarkWork(nbytes);
+    }
+
+    REALLY_INLINE void GC::SignalConservativeMarkWork(uint32_t nbytes)
+    {
+        if (m_markingInParallel) {
+            GCMarkerWork& work = m_parallelMarker->CurrentMarker()->work;
+            work.objectsConservative++;
+            work.bytesConservative += nbytes;
+        }
+        else
+            policy.signalConservativeMarkWork(nbytes);
+    }
+
+    REALLY_INLINE void GC::SignalPointerfreeMarkWork(uint32_t nbytes)
+    {
+        if (m_markingInParallel) {
+            GCMarkerWork& work = m_parallelMarker->CurrentMarker()->work;
+            work.objectsPointerfree++;
+            work.bytesPointerfree += nbytes;
+        }
+        else
+            policy.signalPointerfreeMarkWork(nbytes);
+    }
+
+#ifdef MMGC_POLICY_PROFILING
+    REALLY_INLINE void GC::SignalRootAndStackScan(uint64_t words, uint64_t ticks)
+    {
+        if (m_markingInParallel) {
+            GCMarkerWork& work = m_parallelMarker->CurrentMarker()->work;
+            work.rootAndStackWords += words;
+            work.rootAndStackTicks += ticks;
+        }
+        else
+            policy.signalRootAndStackScan(words, ticks);
+    }
+#endif
+
     /*static*/
     REALLY_INLINE void GC::ClearFinalized(const void *userptr)
     {
@@ -476,6 +594,11 @@ namespace MMgc
         return zct.IsReaping();
     }
 
+    REALLY_INLINE bool GC::ExactStackFrames() const
+    {
+        return exactStackFrames;
+    }
+
     REALLY_INLINE bool GC::IncrementalMarking()
     {
         return marking;
@@ -483,9 +606,9 @@ namespace MMgc
 
     REALLY_INLINE bool GC::BarrierActive()
     {
-        // Note, this will not always have the same value as IncrementalMarking
-        // in the future.
-        return marking;
+        // In generational mode the barrier also records old objects that are
+        // modified between collections; see StartIncrementalMark.
+        return marking || generational;
     }
     
     REALLY_INLINE bool GC::Collecting()
@@ -628,57 +751,98 @@ namespace MMgc
     template<class T>
     REALLY_INLINE void GC::TraceLocation(T* const * loc)
     {
+        if (m_edgeVisitor != NULL) {
+            m_edgeVisitor->VisitLocation((uintptr_t*)loc);
+            return;
+        }
         TracePointer((void*)*loc HEAP_GRAPH_ARG((uintptr_t*)loc));
     }
 
     REALLY_INLINE void GC::TraceLocation(uintptr_t* loc)
     {
+        if (m_edgeVisitor != NULL) {
+            m_edgeVisitor->VisitLocation(loc);
+            return;
+        }
         TracePointer((void*)(*loc & ~7) HEAP_GRAPH_ARG(loc));
     }
 
     REALLY_INLINE void GC::TraceAtom(avmplus::Atom* loc)
     {
+        if (m_edgeVisitor != NULL) {
+            m_edgeVisitor->VisitAtom(loc);
+            return;
+        }
         TraceAtomValue(*loc HEAP_GRAPH_ARG(loc));
     }
 
     template <class T>
     REALLY_INLINE void GC::TraceLocation(MMgc::WriteBarrier<T> const * loc)
     {
+        if (m_edgeVisitor != NULL) {
+            m_edgeVisitor->VisitLocation((uintptr_t*)loc->location());
+            return;
+        }
         TracePointer((void*)loc->value() HEAP_GRAPH_ARG((uintptr_t*)loc->location()));
     }
 
     template <>
     REALLY_INLINE void GC::TraceLocation(MMgc::WriteBarrier<uintptr_t> const * loc)
     {
+        if (m_edgeVisitor != NULL) {
+            m_edgeVisitor->VisitLocation((uintptr_t*)loc->location());
+            return;
+        }
         TracePointer((void*)(loc->value() & ~7) HEAP_GRAPH_ARG(loc->location()));
     }
     
     template <class T>
     REALLY_INLINE void GC::TraceLocation(MMgc::WriteBarrierRC<T> const * loc)
     {
+        if (m_edgeVisitor != NULL) {
+            m_edgeVisitor->VisitLocation((uintptr_t*)loc->location());
+            return;
+        }
         TracePointer((void*)loc->value() HEAP_GRAPH_ARG((uintptr_t*)loc->location()));
     }
 
     template <>
     REALLY_INLINE void GC::TraceLocation(MMgc::WriteBarrierRC<uintptr_t> const * loc)
     {
+        if (m_edgeVisitor != NULL) {
+            m_edgeVisitor->VisitLocation((uintptr_t*)loc->location());
+            return;
+        }
         TracePointer((void*)(loc->value() & ~7) HEAP_GRAPH_ARG(loc->location()));
     }
 
     template <class T>
     REALLY_INLINE void GC::TraceLocation(MMgc::GCMemberBase<T> const * loc)
     {
+        if (m_edgeVisitor != NULL) {
+            m_edgeVisitor->VisitLocation((uintptr_t*)loc->location());
+            return;
+        }
         TracePointer((void*)loc->value() HEAP_GRAPH_ARG((uintptr_t*)loc->location()));
     }
     
     REALLY_INLINE void GC::TraceAtom(AtomWBCore* loc)
     {
+        if (m_edgeVisitor != NULL) {
+            m_edgeVisitor->VisitAtom(loc->location());
+            return;
+        }
         TraceAtomValue(loc->value() HEAP_GRAPH_ARG(loc->location()));
     }
    
     template<class T>
     REALLY_INLINE void GC::TraceLocations(MMgc::GCMemberBase<T>* p, size_t numobjects)
     {
+        if (m_edgeVisitor != NULL) {
+            for ( size_t i=0 ; i < numobjects ; i++ )
+                m_edgeVisitor->VisitLocation((uintptr_t*)(p+i)->location());
+            return;
+        }
         for ( size_t i=0 ; i < numobjects ; i++ )
             TracePointer((void*)(p+i)->value() HEAP_GRAPH_ARG((uintptr_t*)(p+i)->location()));
     }
@@ -686,24 +850,43 @@ namespace MMgc
     template<class T>
     REALLY_INLINE void GC::TraceLocations(T** p, size_t numobjects)
     {
+        if (m_edgeVisitor != NULL) {
+            for ( size_t i=0 ; i < numobjects ; i++ )
+                m_edgeVisitor->VisitLocation((uintptr_t*)(p+i));
+            return;
+        }
         for ( size_t i=0 ; i < numobjects ; i++ )
             TracePointer(p[i] HEAP_GRAPH_ARG((uintptr_t*)(p+i)));
     }
 
     REALLY_INLINE void GC::TraceLocations(uintptr_t* p, size_t numobjects)
     {
+        if (m_edgeVisitor != NULL) {
+            for ( size_t i=0 ; i < numobjects ; i++ )
+                m_edgeVisitor->VisitLocation(p+i);
+            return;
+        }
         for ( size_t i=0 ; i < numobjects ; i++ )
             TracePointer((void*)(p[i] & ~7) HEAP_GRAPH_ARG(p+i));
     }
     
     REALLY_INLINE void GC::TraceAtoms(avmplus::Atom* p, size_t numobjects)
     {
+        if (m_edgeVisitor != NULL) {
+            for ( size_t i=0 ; i < numobjects ; i++ )
+                m_edgeVisitor->VisitAtom(p+i);
+            return;
+        }
         for ( size_t i=0 ; i < numobjects ; i++ )
             TraceAtomValue(p[i] HEAP_GRAPH_ARG(p+i));
     }
 
     REALLY_INLINE void GC::TraceConservativeLocation(uintptr_t* loc)
     {
+        if (m_edgeVisitor != NULL) {
+            m_edgeVisitor->VisitConservativeLocation(loc);
+            return;
+        }
         TraceConservativePointer(*loc, false HEAP_GRAPH_ARG(loc));
     }
 
@@ -768,6 +951,13 @@ namespace MMgc
         }
     }
 
+    REALLY_INLINE void GC::DoStackFramesCallbacks(GCStackFrames& frames)
+    {
+        for ( GCCallback *cb = m_callbacks; cb ; cb = cb->nextCB ) {
+            cb->enumerateStackFrames(frames);
+        }
+    }
+
 #ifdef MMGC_REFCOUNT_PROFILING
     REALLY_INLINE void GC::AddToZCT(RCObject *obj, bool initial)
     {
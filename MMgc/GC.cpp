@@ -10,6 +10,10 @@
 
 #include "ITelemetry.h"
 
+#ifdef MMGC_SIMD_CONSERVATIVE_SCAN
+    #include <emmintrin.h>
+#endif
+
 namespace MMgc
 {
 #ifdef MMGC_MEMORY_PROFILER
@@ -32,6 +36,9 @@ namespace MMgc
     /*virtual*/
     void GCCallback::prereap(void* /*rcobj*/) {}
 
+    /*virtual*/
+    void GCCallback::enumerateStackFrames(GCStackFrames& /*frames*/) {}
+
     ////////////// GC //////////////////////////////////////////////////////////
 
     // Size classes for our GC.  From 8 to 128, size classes are spaced
@@ -91,6 +98,15 @@ const static int kGCPartitionMapSize = sizeof(gcPartitionMap) / sizeof(int);
 static inline int SmallGCAllocHeapPartition(int index)	  { GCAssert(kGCPartitionMapSize == kNumGCPartitions); GCAssert(index < kNumGCPartitions); return gcPartitionMap[index]; }
 static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitionMapSize == kNumGCPartitions); GCAssert(index < kNumGCPartitions); return gcPartitionMap[index]; }
 
+// The size classes GCConfig::sizeClasses asks for, or NULL for the built-in ones
+// if there are none or the table is invalid.
+static inline const uint16_t* ConfiguredGCSizeClasses(GCConfig& config)
+{
+    if (config.sizeClasses != NULL && !SizeClassHistogram::IsValid(config.sizeClasses, GC::kSizeClasses, GC::kNumSizeClasses))
+        return NULL;
+    return config.sizeClasses;
+}
+
 #ifdef _MSC_VER
 #  pragma warning(push)
 #  pragma warning(disable:4355) // 'this': used in base member initializer list
@@ -101,6 +117,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         greedy(config.mode == GCConfig::kGreedyGC),
         nogc(config.mode == GCConfig::kDisableGC),
         incremental(config.mode == GCConfig::kIncrementalGC),
+        generational(config.mode == GCConfig::kIncrementalGC && config.generational),
         drcEnabled(config.mode != GCConfig::kDisableGC && config.drc),
         findUnmarkedPointers(false),
 #ifdef GCDEBUG
@@ -125,6 +142,10 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 #endif
         m_gcThread(0),
         m_stackBaseSaved(0),
+        incrementalWeakRefs(config.incrementalWeakRefs),
+        weakRefsCursor(0),
+        weakRefsVisited(false),
+        weakRefsPending(0),
         destroying(false),
         marking(false),
         collecting(false),
@@ -144,9 +165,31 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 #endif
         m_markStackOverflow(false),
         mark_item_recursion_control(20),    // About 3KB as measured with GCC 4.1 on MacOS X (144 bytes / frame), May 2009
-        sizeClassIndex(kSizeClassIndex),    // see comment in GC.h
+        m_parallelMarker(NULL),
+        m_backgroundSweeper(NULL),
+        m_compactor(NULL),
+        m_allocationSampler(NULL),
+        allocationSampleCountdown(0x7FFFFFFF),
+        m_edgeVisitor(NULL),
+        m_stackScannedForSweep(false),
+        m_blockCacheHits(0),
+        m_blockCacheRefills(0),
+        m_blockCacheReturns(0),
+        m_minorCollection(false),
+        m_majorCollectionRequested(false),
+        m_minorCollections(0),
+        m_majorCollections(0),
+        m_minorsSinceMajor(0),
+        m_bytesMarkedAtStart(0),
+        m_bytesLiveAfterMajor(0),
+        m_bytesPromoted(0),
+        m_markingInParallel(false),
+        sizeClassIndex(ConfiguredGCSizeClasses(config) != NULL ? m_sizeClassIndex : kSizeClassIndex),    // see comment in GC.h
+        inlineAllocLimit(config.sizeClassStatistics ? 0 : kLargestAlloc),
         pageMap(),
         heap(gcheap),
+        exactStackFrames(config.exactStackFrames),
+        traceTrack(0),
         finalizedValue(true),
         smallEmptyPageList(NULL),
         largeEmptyPageList(NULL),
@@ -202,6 +245,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         
         GCAssert(!(greedy && incremental));
         zct.SetGC(this);
+        zct.SetReapSlice(config.reapSlice);
        
 #ifdef VMCFG_TELEMETRY
         VMPI_memset(m_dependentMemory, 0, sizeof(size_t) * typeCount);
@@ -234,16 +278,31 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 		//### This means at least being prepared for null entries in the allocator arrays, however,
 		//### which we are explicitly attempting to avoid here.
 
+        const uint16_t* sizeClasses = ConfiguredGCSizeClasses(config);
+        for (int i=0; i<kNumSizeClasses; i++)
+            m_sizeClasses[i] = sizeClasses != NULL ? sizeClasses[i] : uint16_t(kSizeClasses[i]);
+        if (sizeClasses != NULL) {
+            // As kSizeClassIndex is generated, see above.
+            int i = 0;
+            for (uint32_t j=0; j < sizeof(m_sizeClassIndex); j++) {
+                while (m_sizeClasses[i] < (j+1)*8)
+                    i++;
+                m_sizeClassIndex[j] = uint8_t(i);
+            }
+        }
+        if (config.sizeClassStatistics)
+            m_sizeClassHistogram.Init(kLargestAlloc);
+
         // Create all the allocators up front (not lazy)
         // so that we don't have to check the pointers for
         // NULL on every allocation.
         for (int i=0; i<kNumSizeClasses; i++) {
 			for (int j=0; j<kNumGCPartitions; j++) {
-				containsPointersNonfinalizedAllocs[i][j] = mmfx_new(GCAlloc(this, kSizeClasses[i], true, false, false, i, j, SmallGCAllocHeapPartition(j), 0));
-				containsPointersFinalizedAllocs[i][j] = mmfx_new(GCAlloc(this, kSizeClasses[i], true, false, true, i, j, SmallGCAllocHeapPartition(j), 0));
-				containsPointersRCAllocs[i][j] = mmfx_new(GCAlloc(this, kSizeClasses[i], true, true, true, i, j, SmallGCAllocHeapPartition(j), 0));
-				noPointersNonfinalizedAllocs[i][j] = mmfx_new(GCAlloc(this, kSizeClasses[i], false, false, false, i, j, SmallGCAllocHeapPartition(j), 0));
-				noPointersFinalizedAllocs[i][j] = mmfx_new(GCAlloc(this, kSizeClasses[i], false, false, true, i, j, SmallGCAllocHeapPartition(j), 0));
+				containsPointersNonfinalizedAllocs[i][j] = mmfx_new(GCAlloc(this, m_sizeClasses[i], true, false, false, i, j, SmallGCAllocHeapPartition(j), 0));
+				containsPointersFinalizedAllocs[i][j] = mmfx_new(GCAlloc(this, m_sizeClasses[i], true, false, true, i, j, SmallGCAllocHeapPartition(j), 0));
+				containsPointersRCAllocs[i][j] = mmfx_new(GCAlloc(this, m_sizeClasses[i], true, true, true, i, j, SmallGCAllocHeapPartition(j), 0));
+				noPointersNonfinalizedAllocs[i][j] = mmfx_new(GCAlloc(this, m_sizeClasses[i], false, false, false, i, j, SmallGCAllocHeapPartition(j), 0));
+				noPointersFinalizedAllocs[i][j] = mmfx_new(GCAlloc(this, m_sizeClasses[i], false, false, true, i, j, SmallGCAllocHeapPartition(j), 0));
 			}
         }
 
@@ -324,6 +383,9 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         allocsTable[0] = &noPointersNonfinalizedAllocs;
 
         VMPI_memset(m_bitsFreelists, 0, sizeof(uint32_t*) * kNumSizeClasses * kNumGCPartitions);
+        VMPI_memset(m_blockCacheCount, 0, sizeof(m_blockCacheCount));
+        VMPI_memset(&weakRefStats, 0, sizeof(weakRefStats));
+        VMPI_memset(&stackFrameStats, 0, sizeof(stackFrameStats));
         m_bitsNext = (uint32_t*)heapAlloc(1, kGCBitmapPartition);
 
         // precondition for emptyPageList
@@ -342,6 +404,24 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
         m_incrementalWork.SetDeadItem(emptyWeakRef);    // The empty weak ref is as good an object as any for this
 
+#if !defined MMGC_HEAP_GRAPH && !defined MMGC_CONSERVATIVE_PROFILER && !defined MMGC_POINTINESS_PROFILING && \
+    (!defined MMGC_64BIT || defined MMGC_USE_UNIFORM_PAGEMAP || !defined MMGC_USE_DELAYED_PAGEMAP)
+        // The heap graph and the profilers record marking events in unsynchronized
+        // structures, so they force serial marking.  So does the DelayT4 page map: a
+        // lookup updates its cache of the last leaf without a lock, so lookups from
+        // several markers at once can pair an address with the wrong leaf.
+        if (config.markerThreads > 0)
+            m_parallelMarker = mmfx_new(GCParallelMarker(this, config.markerThreads));
+#endif
+        if (config.backgroundSweep)
+            m_backgroundSweeper = mmfx_new(GCBackgroundSweeper(this));
+        if (config.compaction && !generational)
+            m_compactor = mmfx_new(GCCompactor(this));
+        if (config.allocationSampleInterval > 0) {
+            m_allocationSampler = mmfx_new(AllocationSampler(this, config.allocationSampleInterval));
+            allocationSampleCountdown = m_allocationSampler->NextInterval();
+        }
+
 #ifdef MMGC_CONSERVATIVE_PROFILER
         if (demos == NULL && heap->profiler != NULL)
             demos = new AllocationSiteProfiler(this, "Conservative scanning volume incurred by allocation site");
@@ -394,6 +474,18 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 #ifdef MMGC_HEAP_GRAPH
         printBlacklist();
 #endif
+        if (m_parallelMarker != NULL) {
+            mmfx_delete(m_parallelMarker);
+            m_parallelMarker = NULL;
+        }
+        if (m_compactor != NULL) {
+            mmfx_delete(m_compactor);
+            m_compactor = NULL;
+        }
+        if (m_allocationSampler != NULL) {
+            mmfx_delete(m_allocationSampler);
+            m_allocationSampler = NULL;
+        }
         policy.shutdown();
         allocaShutdown();
 
@@ -415,6 +507,12 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
             ForceSweepAtShutdown();
         }
 
+        // ForceSweepAtShutdown has claimed every block queued for background sweeping.
+        if (m_backgroundSweeper != NULL) {
+            mmfx_delete(m_backgroundSweeper);
+            m_backgroundSweeper = NULL;
+        }
+
         for (int i=0; i < kNumSizeClasses; i++) {
 			for (int j=0; j < kNumGCPartitions; j++) {
 				mmfx_delete(containsPointersNonfinalizedAllocs[i][j]);
@@ -434,6 +532,9 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 			}
 		}
 
+        // The allocators returned their blocks through FreeBlock.
+        FlushBlockCache();
+
 		// Go through m_bitsFreelist and collect list of all pointers
 		// that are on page boundaries into new list, pageList
 		void **pageList = NULL;
@@ -504,6 +605,15 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         TELEMETRY_METHOD(getTelemetry(), ".gc.Collect");
         ReapZCT(scanStack);
 
+        if (generational) {
+            // A full collection must reclaim old objects too.  A minor collection
+            // that is in progress can't be upgraded, because the old objects have
+            // not been traced, so start over.
+            m_majorCollectionRequested = true;
+            if (marking && m_minorCollection)
+                AbortInProgressMarking();
+        }
+
         if(!marking)
             StartIncrementalMark();
         if(marking)
@@ -542,7 +652,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         GCAssert(p != NULL);
         GCAssert(!IsPointerToGCPage(GetRealPointer(p)) || !IsPointerToGCObject(GetRealPointer(p)));
 
-        if (!m_incrementalWork.Push_StackMemory(p, size, baseptr))
+        if (!CurrentMarkStack().Push_StackMemory(p, size, baseptr))
             SignalMarkStackOverflow_NonGCObject();
     }
     
@@ -551,7 +661,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         GCAssert(p != NULL);
         GCAssert(!IsPointerToGCPage(GetRealPointer(p)) || !IsPointerToGCObject(GetRealPointer(p)));
 
-        if (!m_incrementalWork.Push_RootProtector(p)) {
+        if (!CurrentMarkStack().Push_RootProtector(p)) {
             SignalMarkStackOverflow_NonGCObject();
             return false;
         }
@@ -563,7 +673,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         GCAssert(p != NULL);
         GCAssert(IsPointerToGCPage(GetRealPointer(p)) && IsPointerToGCObject(GetRealPointer(p)));
 
-        if (!m_incrementalWork.Push_LargeObjectProtector(p))
+        if (!CurrentMarkStack().Push_LargeObjectProtector(p))
             SignalMarkStackOverflow_NonGCObject();
     }
     
@@ -573,7 +683,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         GCAssert(cursor != 0);
         GCAssert(IsPointerToGCPage(GetRealPointer(p)) && IsPointerToGCObject(GetRealPointer(p)));
 
-        if (!m_incrementalWork.Push_LargeExactObjectTail(p, cursor))
+        if (!CurrentMarkStack().Push_LargeExactObjectTail(p, cursor))
             SignalMarkStackOverflow_NonGCObject();
     }
 
@@ -583,7 +693,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         GCAssert(IsPointerToGCPage(p));
         GCAssert(IsPointerToGCPage((char*)p + size - 1));
 
-        if (!m_incrementalWork.Push_LargeObjectChunk(p, size, baseptr))
+        if (!CurrentMarkStack().Push_LargeObjectChunk(p, size, baseptr))
             SignalMarkStackOverflow_NonGCObject();
     }
 
@@ -593,7 +703,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         GCAssert(!IsPointerToGCPage(p));
         GCAssert(!IsPointerToGCPage((char*)p + size - 1));
         
-        if (!m_incrementalWork.Push_LargeRootChunk(p, size, baseptr))
+        if (!CurrentMarkStack().Push_LargeRootChunk(p, size, baseptr))
             SignalMarkStackOverflow_NonGCObject();
     }
     
@@ -602,7 +712,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 #ifdef GCDEBUG
         WorkItemInvariants_GCObject(p);
 #endif
-        if (!m_incrementalWork.Push_GCObject(p))
+        if (!CurrentMarkStack().Push_GCObject(p))
             SignalMarkStackOverflow_GCObject(p);
     }
 
@@ -631,6 +741,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         ClearMarkStack();
         m_barrierWork.Clear();
         ClearMarks();
+        ResetWeakRefVisit();
 #ifdef MMGC_HEAP_GRAPH
         markerGraph.clear();
 #endif
@@ -859,6 +970,14 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
         void *item;                     // the allocated object (a user pointer!), or NULL
 
+        if (m_sizeClassHistogram.IsEnabled()) {
+#if defined GCDEBUG || defined MMGC_MEMORY_PROFILER
+            m_sizeClassHistogram.Record(size, askSize);
+#else
+            m_sizeClassHistogram.Record(size, size);
+#endif
+        }
+
         // In Release builds the calls to the underlying Allocs should end up being compiled
         // as tail calls with reasonable compilers.  Try to keep it that way.
 
@@ -939,6 +1058,89 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
     }
 #endif
 
+    void GC::SampleAllocation(const void* item, uintptr_t caller)
+    {
+        if (m_allocationSampler == NULL) {
+            allocationSampleCountdown = 0x7FFFFFFF;
+            return;
+        }
+        allocationSampleCountdown = m_allocationSampler->NextInterval();
+        if (item != NULL) {
+            GetGCBits(item) |= kSampled;
+            m_allocationSampler->Sample(GetUserPointer(item), caller);
+        }
+    }
+
+    bool GC::DumpAllocationProfile(const char* filename)
+    {
+        if (m_allocationSampler == NULL)
+            return true;
+        return m_allocationSampler->Dump(filename);
+    }
+
+    bool GC::WriteHeapSnapshot(const char* filename)
+    {
+        if (nogc || markerActive || collecting || Reaping())
+            return false;
+
+        // A full collection sweeps eagerly, so that afterwards every object that is
+        // not on a free list is live.
+        Collect();
+        if (marking)
+            return false;
+
+        HeapSnapshotWriter writer(this);
+        return writer.Write(filename);
+    }
+
+    void GC::GetSizeClassStats(int index, SizeClassStats& stats)
+    {
+        GCAssert(index >= 0 && index < kNumSizeClasses);
+        VMPI_memset(&stats, 0, sizeof(stats));
+        stats.itemSize = m_sizeClasses[index];
+        if (m_sizeClassHistogram.IsEnabled())
+            m_sizeClassHistogram.Accumulate(index == 0 ? 0 : m_sizeClasses[index-1], m_sizeClasses[index], stats);
+        stats.bytesRounded = stats.requests * stats.itemSize;
+        for (int j=0; j < kNumGCPartitions; j++) {
+            GCAlloc* allocs[] = { containsPointersNonfinalizedAllocs[index][j],
+                                  containsPointersFinalizedAllocs[index][j],
+                                  containsPointersRCAllocs[index][j],
+                                  noPointersNonfinalizedAllocs[index][j],
+                                  noPointersFinalizedAllocs[index][j] };
+            for (size_t k=0; k < sizeof(allocs)/sizeof(allocs[0]); k++) {
+                int numAlloc, maxAlloc;
+                allocs[k]->GetAllocStats(numAlloc, maxAlloc);
+                stats.liveItems += numAlloc;
+                stats.blocks += maxAlloc / allocs[k]->m_itemsPerBlock;
+            }
+        }
+    }
+
+    void GC::DumpSizeClassStats()
+    {
+        SizeClassHistogram::LogHeader("GC");
+        for (int i=0; i < kNumSizeClasses; i++) {
+            SizeClassStats stats;
+            GetSizeClassStats(i, stats);
+            SizeClassHistogram::LogStats(stats);
+        }
+        m_sizeClassHistogram.LogLargeRequests();
+    }
+
+    bool GC::ComputeSizeClasses(uint16_t sizeClasses[kNumSizeClasses])
+    {
+        if (!m_sizeClassHistogram.IsEnabled())
+            return false;
+
+        uint16_t table[kNumSizeClasses];
+        table[0] = uint16_t(kSizeClasses[0]);
+        if (!m_sizeClassHistogram.ComputeSizeClasses(table, kNumSizeClasses, 1, GCHeap::kBlockSize - sizeof(GCAlloc::GCBlock)))
+            return false;
+        GCAssert(SizeClassHistogram::IsValid(table, kSizeClasses, kNumSizeClasses));
+        VMPI_memcpy(sizeClasses, table, sizeof(table));
+        return true;
+    }
+
     // Mmmm.... gcc -O3 inlines Alloc into this in Release builds :-)
 
     void *GC::OutOfLineAllocExtra(size_t size, size_t extra, int flags, int partition)
@@ -1120,6 +1322,10 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
     void GC::Finalize()
     {
+        // The mark bits are final, and the dead objects have not been swept yet.
+        if (m_allocationSampler != NULL)
+            m_allocationSampler->RetireDeadSamples(true);
+
         MarkOrClearWeakRefs();
 
         for(int i=0; i < kNumSizeClasses; i++) {
@@ -1205,6 +1411,8 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
     {
         const void *realptr = GetRealPointer(userptr);
         GCAssert(GetGC(realptr)->IsPointerToGCObject(realptr));
+        if (!GCLargeAlloc::IsLargeBlock(realptr))
+            GCAlloc::ClaimObjectFromBackgroundSweeper(userptr);
         if (flag) {
             GetGCBits(realptr) |= kHasWeakRef;
             // Small-object allocators maintain an extra flag
@@ -1233,29 +1441,120 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         uint32_t count = weakRefs.count();
         uint32_t deleted = 0;
 #endif
-        {
-            GCHashtable::Iterator it(&weakRefs);
+        weakRefStats.entries = weakRefs.count();
+        weakRefStats.visitedInPause = 0;
+        weakRefStats.cleared = 0;
+        if (weakRefsCursor == 0 && !weakRefsVisited) {
+            GCGroupHashtable::Iterator it(&weakRefs);
 
             while (it.nextKey() != NULL) {
                 GCWeakRef* w = (GCWeakRef*)it.value();
                 GCObject* o = w->peek();
+                weakRefStats.visitedInPause++;
                 if (o != NULL && !GC::GetMark(o)) {
 #ifdef MMGC_WEAKREF_PROFILER
                     deleted++;
 #endif
+                    weakRefStats.cleared++;
                     ClearWeakRef(o, false);
                 }
                 else if (!GC::GetMark(w))
                     GC::SetMark(w);
             }
         }
+        else {
+            // The marked weak references visited during the incremental mark slices
+            // have been dealt with; finish the visit and check the rest.
+            uint32_t visited = weakRefStats.visitedIncrementally;
+            VisitWeakRefs(0);
+            weakRefStats.visitedInPause = weakRefStats.visitedIncrementally - visited;
+            weakRefStats.visitedIncrementally = visited;
+            // The visit is over: GetWeakRef must leave weakRefsPending alone.
+            weakRefsCursor = 0;
+            weakRefsVisited = false;
+            {
+                GCGroupHashtable::Iterator it(&weakRefsPending);
+                const void* key;
+                while ((key = it.nextKey()) != NULL) {
+                    // The entry may have been removed since, or its object freed and
+                    // the memory reused for an object with a new weak reference; check
+                    // whatever is there now.
+                    GCWeakRef* w = (GCWeakRef*)weakRefs.get(key);
+                    if (w == NULL)
+                        continue;
+                    weakRefStats.visitedInPause++;
+                    if (!GC::GetMark(key)) {
+#ifdef MMGC_WEAKREF_PROFILER
+                        deleted++;
+#endif
+                        weakRefStats.cleared++;
+                        ClearWeakRef(key, false);
+                    }
+                    else if (!GC::GetMark(w))
+                        GC::SetMark(w);
+                }
+            }
+        }
+        weakRefsPending.clear();
         weakRefs.prune();
+        if (heap->Config().gcstats) {
+            gclog("[mem] weak refs: %u, %u visited incrementally, %u in the pause, %u cleared\n",
+                  weakRefStats.entries, weakRefStats.visitedIncrementally,
+                  weakRefStats.visitedInPause, weakRefStats.cleared);
+        }
 #ifdef MMGC_WEAKREF_PROFILER
         if (weaklings)
             weaklings->reportGCStats(count, deleted);
 #endif
     }
 
+    void GC::VisitWeakRefs(uint64_t ticks)
+    {
+        GCAssert(marking);
+
+        // Checking the time costs about as much as visiting a few entries.
+        const uint32_t checkTimeIncrements = 64;
+        uint32_t n = 0;
+        while (!weakRefsVisited) {
+            int32_t index = weakRefs.nextIndex(weakRefsCursor);
+            if (index == 0) {
+                weakRefsVisited = true;
+                break;
+            }
+            weakRefsCursor = index;
+            const void* key = weakRefs.keyAt(index-1);
+            GCWeakRef* w = (GCWeakRef*)weakRefs.valueAt(index-1);
+            weakRefStats.visitedIncrementally++;
+            if (GC::GetMark(key)) {
+                // The object survives this collection, so its weak reference must too.
+                // A weak reference that is on the mark stack will be marked by the
+                // marker; SetMark would clear its queued bit.
+                if (!GC::GetMark(w) && !GC::GetQueued(w))
+                    GC::SetMark(w);
+            }
+            else
+                weakRefsPending.put(key, w);
+            if (ticks != 0 && ++n == checkTimeIncrements) {
+                n = 0;
+                if (VMPI_getPerformanceCounter() >= ticks)
+                    break;
+            }
+        }
+    }
+
+    void GC::ResetWeakRefVisit()
+    {
+        weakRefsCursor = 0;
+        weakRefsVisited = false;
+        weakRefsPending.clear();
+        weakRefStats.visitedIncrementally = 0;
+    }
+
+    void GC::GetWeakRefStats(WeakRefStats& stats)
+    {
+        stats = weakRefStats;
+    }
+
     void GC::ForceSweepAtShutdown()
     {
         // There are two preconditions for Sweep: the mark stacks must be empty, and
@@ -1323,7 +1622,9 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
         presweeping = true;
         // invoke presweep on all callbacks
+        uint64_t presweepStart = VMPI_getPerformanceCounter();
         DoPreSweepCallbacks();
+        TracePhase("PresweepCallbacks", presweepStart, 0);
         presweeping = false;
 
         SAMPLE_CHECK();
@@ -1345,6 +1646,13 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         GCAssert(m_incrementalWork.Count() == 0);
         GCAssert(m_barrierWork.Count() == 0);
 
+        // The mark bits are final now.  Move objects out of sparse blocks so that the
+        // blocks are freed below.
+
+        if (m_compactor != NULL && m_stackScannedForSweep && !destroying)
+            m_compactor->Compact();
+        m_stackScannedForSweep = false;
+
 #ifdef MMGC_HEAP_GRAPH
         // if destroying, then marks are gone and thus pruning is meaningless
         if (!destroying)
@@ -1403,8 +1711,11 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
         if (heap->Config().eagerSweeping)
             SweepNeedsSweeping();
+        else if (m_backgroundSweeper != NULL && !destroying)
+            m_backgroundSweeper->Start();
 
         // we potentially freed a lot of memory, tell heap to regulate
+        FlushBlockCache();
         heap->Decommit();
 
         SAMPLE_CHECK();
@@ -1422,7 +1733,9 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         zct.EndCollecting();
 
         // invoke postsweep callback
+        uint64_t postsweepStart = VMPI_getPerformanceCounter();
         DoPostSweepCallbacks();
+        TracePhase("PostsweepCallbacks", postsweepStart, 0);
 
         SAMPLE_CHECK();
 
@@ -1442,11 +1755,49 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
     }
 
+    // Every GCAlloc chunk is a single block, and a busy allocator takes blocks from
+    // the heap and gives them back at a high rate: AllocSlow creates chunks, the
+    // sweep frees empty ones.  Each of those would take the heap lock, which is
+    // shared by every GC in the process, so with several workers allocating the
+    // lock becomes the bottleneck.
+    //
+    // The GC therefore keeps up to kBlockCacheSize single blocks per partition.
+    // FreeBlock puts a block in the cache, and AllocBlock takes one out, without
+    // touching the heap.  When the cache is empty AllocBlock refills it with
+    // kBlockCacheBatch blocks under one acquisition of the heap lock, and when it
+    // is full FreeBlock returns kBlockCacheBatch blocks the same way.  The cache is
+    // emptied before the heap is asked to decommit at the end of a sweep, so that
+    // the cached blocks can be released, and when the GC is destroyed.
+    //
+    // Cached blocks are still allocated as far as the heap is concerned, but not
+    // as far as the policy manager is concerned: a block is accounted to the GC
+    // while the GC's allocators use it, just as before.  Requests that may fail
+    // bypass the cache so that they observe the heap's memory limits.
+
     void* GC::AllocBlock(int size, int partition, PageMap::PageType pageType, bool zero, bool canFail)
     {
         GCAssert(size > 0);
 
-        void *item = heapAlloc(size, partition, GCHeap::kExpand| (zero ? GCHeap::kZero : 0) | (canFail ? GCHeap::kCanFail : 0));
+        void *item = NULL;
+        if (size == 1 && !canFail) {
+            if (m_blockCacheCount[partition] == 0) {
+                m_blockCacheCount[partition] = (uint32_t)heap->GetPartition(partition)->AllocBlocks(m_blockCache[partition], kBlockCacheBatch);
+                m_blockCacheRefills++;
+            }
+            if (m_blockCacheCount[partition] > 0) {
+                uintptr_t entry = uintptr_t(m_blockCache[partition][--m_blockCacheCount[partition]]);
+                item = (void*)(entry & ~uintptr_t(1));
+                if (zero && (entry & 1) == 0)
+                    VMPI_memset(item, 0, GCHeap::kBlockSize);
+                policy.signalBlockAllocation(1);
+                m_blockCacheHits++;
+            }
+        }
+
+        // A refill can come up empty when the heap is at a limit; the regular path
+        // then takes care of OOM handling.
+        if (item == NULL)
+            item = heapAlloc(size, partition, GCHeap::kExpand| (zero ? GCHeap::kZero : 0) | (canFail ? GCHeap::kCanFail : 0));
 
         // mark GC pages in page map, small pages get marked one,
         // the first page of large pages is 3 and the rest are 2
@@ -1465,9 +1816,35 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         // Bugzilla 551833:  Unmark first so that any OOM or other action triggered
         // by heapFree does not examine bits representing pages that are gone.
         UnmarkGCPages(ptr, size);
+
+        if (size == 1) {
+            if (m_blockCacheCount[partition] == kBlockCacheSize) {
+                m_blockCacheCount[partition] -= kBlockCacheBatch;
+                heap->GetPartition(partition)->FreeBlocks(&m_blockCache[partition][m_blockCacheCount[partition]], kBlockCacheBatch);
+                m_blockCacheReturns++;
+            }
+#ifdef GCDEBUG
+            if (!RUNNING_ON_VALGRIND)
+                VMPI_memset(ptr, uint8_t(GCHeap::MMFreedPoison), GCHeap::kBlockSize);
+#endif
+            m_blockCache[partition][m_blockCacheCount[partition]++] = ptr;
+            policy.signalBlockDeallocation(1);
+            return;
+        }
+
         heapFree(ptr, size, partition, false);
     }
 
+    void GC::FlushBlockCache()
+    {
+        for (int i=0; i < kNumGCPartitions; i++) {
+            if (m_blockCacheCount[i] > 0) {
+                heap->GetPartition(i)->FreeBlocks(m_blockCache[i], m_blockCacheCount[i]);
+                m_blockCacheCount[i] = 0;
+            }
+        }
+    }
+
     void *GC::FindBeginningGuarded(const void *gcItem, bool allowGarbage)
     {
         (void)allowGarbage;
@@ -1510,6 +1887,15 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
     void GC::Mark()
     {
+        // Top-level drains outside the sweep are handed to the parallel marker, if
+        // there is one.  Nested drains (eg from HandleMarkStackOverflow) stay serial.
+        if (m_parallelMarker != NULL && markerActive == 0 && !collecting && !m_incrementalWork.IsEmpty()) {
+            markerActive++;
+            m_parallelMarker->Mark();
+            markerActive--;
+            return;
+        }
+
         markerActive++;
         while(m_incrementalWork.Count()) {
             const void* ptr;
@@ -1612,10 +1998,78 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         // Push the stack onto the mark stack and then mark synchronously until
         // everything reachable from the stack has been marked.
 
-        gc->Push_StackMemory(stackPointer, uint32_t(stackBase - (char*)stackPointer), stackPointer);
+        if (gc->exactStackFrames) {
+            gc->PushStackWithFrames((char*)stackPointer, stackBase);
+        }
+        else {
+            VMPI_memset(&gc->stackFrameStats, 0, sizeof(gc->stackFrameStats));
+            gc->stackFrameStats.wordsConservative = uint32_t((stackBase - (char*)stackPointer) / sizeof(void*));
+            gc->Push_StackMemory(stackPointer, uint32_t(stackBase - (char*)stackPointer), stackPointer);
+        }
         gc->Mark();
     }
 
+    void GC::PushStackWithFrames(const char* stackPointer, const char* stackBase)
+    {
+        StackFrameStats& stats = stackFrameStats;
+        VMPI_memset(&stats, 0, sizeof(stats));
+
+        stackFrames.Begin(stackPointer, stackBase);
+        DoStackFramesCallbacks(stackFrames);
+
+        // The frames are in increasing order and don't overlap.  What lies between
+        // them is pushed as stack memory, like the whole stack would be; the words
+        // of the frames that can hold pointers are traced now, which may mark the
+        // objects they reference on the spot.
+        markerActive++;
+        const char* p = stackPointer;
+        for ( uint32_t i=0 ; i < stackFrames.m_count ; i++ ) {
+            const GCStackFrames::Frame& frame = stackFrames.m_frames[i];
+            if ((const char*)frame.base > p) {
+                Push_StackMemory(p, uint32_t((const char*)frame.base - p), p);
+                stats.wordsConservative += uint32_t(((const char*)frame.base - p) / sizeof(void*));
+            }
+            for ( uint32_t j=0 ; j < frame.nwords ; j++ ) {
+                if (GCStackFrames::IsSet(frame.bitmap, j)) {
+                    TraceConservativePointer(frame.base[j], true HEAP_GRAPH_ARG(const_cast<uintptr_t*>(frame.base + j)));
+                    stats.wordsTraced++;
+                }
+            }
+            stats.frames++;
+            stats.wordsSkipped += frame.nwords;
+            p = (const char*)(frame.base + frame.nwords);
+        }
+        markerActive--;
+        stats.wordsSkipped -= stats.wordsTraced;
+        if (stackBase > p) {
+            Push_StackMemory(p, uint32_t(stackBase - p), p);
+            stats.wordsConservative += uint32_t((stackBase - p) / sizeof(void*));
+        }
+
+        stackFrames.End();
+
+        if (heap->Config().gcstats) {
+            gclog("[mem] native stack: %u frames with %u words traced and %u skipped, %u words scanned conservatively\n",
+                  stats.frames, stats.wordsTraced, stats.wordsSkipped, stats.wordsConservative);
+        }
+    }
+
+    void GC::TracePhase(const char* name, uint64_t start, int64_t bytes)
+    {
+        GCTraceLog* traceLog = heap->GetTraceLog();
+        if (traceLog == NULL)
+            return;
+        if (traceTrack == 0)
+            traceTrack = traceLog->NewTrack();
+        traceLog->Record(name, traceTrack, start, VMPI_getPerformanceCounter(), bytes,
+                         uint64_t(policy.blocksOwnedByGC()) * GCHeap::kBlockSize);
+    }
+
+    void GC::GetStackFrameStats(StackFrameStats& stats)
+    {
+        stats = stackFrameStats;
+    }
+
     struct CreateRootFromCurrentStackArgs
     {
         GC* gc;
@@ -1963,6 +2417,19 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         }
         GCLog("[mem] \tmark increments %d\n", markIncrements());
         GCLog("[mem] \tsweeps %d \n", sweeps);
+        if (generational)
+            GCLog("[mem] \tgenerational: %u minor collections, %u major collections\n", m_minorCollections, m_majorCollections);
+        GCLog("[mem] \tblock cache: %llu blocks taken, %llu refills, %llu returns\n",
+              (unsigned long long)m_blockCacheHits,
+              (unsigned long long)m_blockCacheRefills,
+              (unsigned long long)m_blockCacheReturns);
+        if (m_parallelMarker != NULL)
+            m_parallelMarker->DumpStats();
+        if (m_backgroundSweeper != NULL)
+            m_backgroundSweeper->DumpStats();
+        if (m_compactor != NULL)
+            m_compactor->DumpStats();
+        policy.DumpPacingInfo();
 
         size_t total_overhead = 0;
         size_t total_internal_waste = 0;
@@ -2125,6 +2592,49 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
 #endif // GCDEBUG
 
+    // Generational mode (GCConfig::generational).
+    //
+    // Objects are not moved; the generation of an object is given by its mark bit.
+    // Objects that survive a collection keep their mark bits through finalization
+    // and sweeping ("sticky" mark bits, see GCAlloc::SweepGuts), so after the
+    // collection every marked object is old and every unmarked object is young.
+    //
+    // BarrierActive() stays true between collections.  When a pointer is stored
+    // into an old object the write barrier flips the object from marked to queued
+    // and pushes it onto m_barrierWork, exactly as it does during incremental
+    // marking, so m_barrierWork accumulates the remembered set: the old objects that
+    // may point to young objects.  Each old object is recorded at most once.
+    //
+    // A minor collection leaves the mark bits alone and starts with the remembered
+    // set on the mark stack.  Marking then skips old objects (they are marked) and
+    // traces the young objects that are reachable from the roots, the stack, the
+    // ZCT's pinned objects, and the remembered set; the young objects that are not
+    // reached are finalized and swept.  Old garbage is not reclaimed until the next
+    // major collection, which clears all mark bits and the remembered set first and
+    // is then an ordinary full collection.
+    //
+    // A major collection is due when requested by GC::Collect, on the first
+    // collection, after kMaxMinorCollections minor collections in a row, or when the
+    // minor collections have promoted more than the last major collection found
+    // live and at least kMinPromotedBytes.
+
+    // Upper bound on the number of minor collections between major collections.
+    static const uint32_t kMaxMinorCollections = 16;
+
+    // Promotion below this does not force a major collection, as a heap that small
+    // is cheap to collect anyway.  Matches the policy's default lower limit.
+    static const uint64_t kMinPromotedBytes = 1024*1024;
+
+    bool GC::MajorCollectionDue()
+    {
+        GCAssert(generational);
+        return (m_majorCollectionRequested ||
+                m_majorCollections == 0 ||
+                m_minorsSinceMajor >= kMaxMinorCollections ||
+                (m_bytesPromoted > m_bytesLiveAfterMajor &&
+                 m_bytesPromoted >= kMinPromotedBytes));
+    }
+
     void GC::StartIncrementalMark()
     {
         policy.signal(GCPolicyManager::START_StartIncrementalMark);     // garbage collection starts
@@ -2138,32 +2648,51 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         // set the stack cleaning trigger
         stackCleaned = false;
 
-        marking = true;
-
         GCAssert(m_incrementalWork.Count() == 0);
-        GCAssert(m_barrierWork.Count() == 0);
+        GCAssert(m_barrierWork.Count() == 0 || generational);
+
+        m_minorCollection = generational && !MajorCollectionDue();
+        m_majorCollectionRequested = false;
+        m_bytesMarkedAtStart = policy.bytesMarked();
+        ResetWeakRefVisit();
+
+        if (generational && !m_minorCollection) {
+            // Forget the old generation and the remembered set.  ClearMarks also
+            // sweeps.
+            m_barrierWork.Clear();
+            ClearMarks();
+        }
+
+        marking = true;
 
         SweepNeedsSweeping();
 
-        // at this point every object should have no marks or be marked kFreelist
+        // at this point every object should have no marks or be marked kFreelist,
+        // unless this is a minor collection
 #ifdef GCDEBUG
-        for(int i=0; i < kNumSizeClasses; i++) {
-			for(int j=0; j < kNumGCPartitions; j++) {
-				containsPointersRCAllocs[i][j]->CheckMarks();
-				containsPointersNonfinalizedAllocs[i][j]->CheckMarks();
-				containsPointersFinalizedAllocs[i][j]->CheckMarks();
-				noPointersNonfinalizedAllocs[i][j]->CheckMarks();
-				noPointersFinalizedAllocs[i][j]->CheckMarks();
-			}
+        if (!m_minorCollection) {
+            for(int i=0; i < kNumSizeClasses; i++) {
+                for(int j=0; j < kNumGCPartitions; j++) {
+                    containsPointersRCAllocs[i][j]->CheckMarks();
+                    containsPointersNonfinalizedAllocs[i][j]->CheckMarks();
+                    containsPointersFinalizedAllocs[i][j]->CheckMarks();
+                    noPointersNonfinalizedAllocs[i][j]->CheckMarks();
+                    noPointersFinalizedAllocs[i][j]->CheckMarks();
+                }
+            }
+            bibopAllocFloat->CheckMarks();
+            bibopAllocFloat4->CheckMarks();
         }
-        bibopAllocFloat->CheckMarks();
-        bibopAllocFloat4->CheckMarks();
 #endif
 
 #ifdef MMGC_HEAP_GRAPH
         markerGraph.clear();
 #endif
 
+        // The remembered set is the first work of a minor collection.
+        if (m_minorCollection)
+            FlushBarrierWork();
+
         {
             if (incremental)
             {
@@ -2468,6 +2997,18 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
         const void *chunkptr = (const void*)((uintptr_t)userptr + kLargestAlloc);
         uint32_t chunksize = uint32_t(size - kLargestAlloc);
+
+        // While marking in parallel the rest of a large root or stack area can be
+        // scanned by all the markers; the mutator is stopped, so it can't go away.
+        if (m_markingInParallel &&
+            (type == GCMarkStack::kStackMemory || type == GCMarkStack::kLargeRootChunk) &&
+            chunksize >= GCParallelMarker::kShareRangeThreshold &&
+            m_parallelMarker->ShareRange(chunkptr, chunksize, type, baseptr))
+        {
+            size = kMarkItemSplitThreshold;
+            return;
+        }
+
         switch (type) {
             case GCMarkStack::kStackMemory:
                 Push_StackMemory(chunkptr, chunksize, baseptr);
@@ -2559,7 +3100,8 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
     
     void GC::MarkTopItem_NonGCObject()
     {
-        switch (m_incrementalWork.PeekTypetag()) {
+        GCMarkStack& stack = CurrentMarkStack();
+        switch (stack.PeekTypetag()) {
             default:
                 GCAssert(!"Unhandled mark item tag");
                 break;
@@ -2567,7 +3109,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
             case GCMarkStack::kLargeExactObjectTail: {
                 const void* ptr;
                 size_t cursor;
-                m_incrementalWork.Pop_LargeExactObjectTail(ptr, cursor);
+                stack.Pop_LargeExactObjectTail(ptr, cursor);
                 MarkItem_ExactObjectTail(ptr, cursor);
                 break;
             }
@@ -2576,7 +3118,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
                 const void* ptr;
                 const void* baseptr;
                 uint32_t size;
-                m_incrementalWork.Pop_StackMemory(ptr, size, baseptr);
+                stack.Pop_StackMemory(ptr, size, baseptr);
                 MarkItem_ConservativeOrNonGCObject(ptr, size, GCMarkStack::kStackMemory, baseptr, true);
                 break;
             }
@@ -2585,7 +3127,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
                 const void* ptr;
                 const void* baseptr;
                 uint32_t size;
-                m_incrementalWork.Pop_LargeObjectChunk(ptr, size, baseptr);
+                stack.Pop_LargeObjectChunk(ptr, size, baseptr);
                 MarkItem_ConservativeOrNonGCObject(ptr, size, GCMarkStack::kLargeObjectChunk, baseptr, MMGC_INTERIOR_PTRS_FLAG);
                 break;
             }
@@ -2594,14 +3136,14 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
                 const void* ptr;
                 const void* baseptr;
                 uint32_t size;
-                m_incrementalWork.Pop_LargeRootChunk(ptr, size, baseptr);
+                stack.Pop_LargeRootChunk(ptr, size, baseptr);
                 MarkItem_ConservativeOrNonGCObject(ptr, size, GCMarkStack::kLargeRootChunk, baseptr, MMGC_INTERIOR_PTRS_FLAG);
                 break;
             }
 
             case GCMarkStack::kRootProtector: {
                 const void* ptr;
-                m_incrementalWork.Pop_RootProtector(ptr);
+                stack.Pop_RootProtector(ptr);
                 GCRoot *sentinelRoot = (GCRoot*)ptr;
                 // The GCRoot is no longer on the stack, clear the pointers into the stack.
                 sentinelRoot->ClearMarkStackSentinelPointer();
@@ -2610,7 +3152,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
             case GCMarkStack::kLargeObjectProtector: {
                 const void* ptr;
-                m_incrementalWork.Pop_LargeObjectProtector(ptr);
+                stack.Pop_LargeObjectProtector(ptr);
                 // Unprotect an item that was protected earlier, see comment block above.
                 GCLargeAlloc::UnprotectAgainstFree(ptr);
                 break;
@@ -2654,8 +3196,12 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
         if (bits & kVirtualGCTrace)
         {
-            // Inlined and merged SetMark, since we have the bits anyway.
-            bits = (bits & ~kQueued) | kMark;
+            // Inlined and merged SetMark, since we have the bits anyway.  Another
+            // marker may be pinning a movable object at the same time.
+            if ((bits & kMovable) && m_markingInParallel)
+                UpdateBitsAtomic(bits, kQueued, kMark);
+            else
+                bits = (bits & ~kQueued) | kMark;
 
             if (((GCTraceableBase*)userptr)->gcTrace(this, 0))
                 SplitExactGCObject(userptr);
@@ -2665,7 +3211,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
             // object here, even if that object is being split.  Can that go wrong somehow,
             // eg, will it upset the computation of the mark rate?
 
-            policy.signalExactMarkWork(size);
+            SignalExactMarkWork(size);
             return;
         }
 #endif
@@ -2680,15 +3226,51 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         
         // Save the new state.
         Push_LargeExactObjectTail(userptr, cursor+1);
-        uintptr_t e1 = m_incrementalWork.Top();
+        GCMarkStack& stack = CurrentMarkStack();
+        uintptr_t e1 = stack.Top();
         
         if (!exactlyTraced->gcTrace(this, cursor))
         {
             // No more mark work, so clean up the mark state.
-            m_incrementalWork.ClearItemAt(e1);
+            stack.ClearItemAt(e1);
         }
     }
     
+#ifdef MMGC_SIMD_CONSERVATIVE_SCAN
+    // Return a mask of the words among the kFilterGroupWords words at 'p' that are
+    // in [memStart, memStart+memSpan), with bit i set for p[i].  A word w is in range
+    // if w-memStart is less than memSpan as an unsigned number; memSpan must not
+    // exceed kMaxFilterSpan.
+    //
+    // SSE2 has no 64-bit compares, so on 64-bit systems a word is in range if the
+    // high half of w-memStart is zero and the low half is less than memSpan.  The
+    // unsigned 32-bit compare is done as a signed compare of biased values.
+
+    /*static*/
+    REALLY_INLINE uint32_t GC::CandidateMask(const uintptr_t* p, uintptr_t memStart, uintptr_t memSpan)
+    {
+        const __m128i bias = _mm_set1_epi32(int32_t(0x80000000U));
+        const __m128i span = _mm_set1_epi32(int32_t(uint32_t(memSpan) ^ 0x80000000U));
+#ifdef MMGC_64BIT
+        const __m128i start = _mm_set1_epi64x(int64_t(memStart));
+        const __m128i zero = _mm_setzero_si128();
+        __m128i d0 = _mm_sub_epi64(_mm_loadu_si128((const __m128i*)p), start);
+        __m128i d1 = _mm_sub_epi64(_mm_loadu_si128((const __m128i*)(p + 2)), start);
+        uint32_t below = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(_mm_xor_si128(d0, bias), span))) |
+                         (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(_mm_xor_si128(d1, bias), span))) << 4);
+        uint32_t highZero = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(d0, zero))) |
+                            (_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(d1, zero))) << 4);
+        // Bit 2i of 'below' is the low half of word i, bit 2i+1 of 'highZero' the high half.
+        uint32_t m = below & (highZero >> 1);
+        return (m & 1) | ((m >> 1) & 2) | ((m >> 2) & 4) | ((m >> 3) & 8);
+#else
+        const __m128i start = _mm_set1_epi32(int32_t(memStart));
+        __m128i d = _mm_sub_epi32(_mm_loadu_si128((const __m128i*)p), start);
+        return _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(_mm_xor_si128(d, bias), span)));
+#endif
+    }
+#endif // MMGC_SIMD_CONSERVATIVE_SCAN
+
     void GC::MarkItem_ConservativeOrNonGCObject(const void *userptr, uint32_t size, GCMarkStack::TypeTag type, const void* baseptr, bool interiorPtrs)
     {
         // Conservative tracing.
@@ -2710,7 +3292,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         if (type == GCMarkStack::kGCObject)
             SetMark(userptr);
 
-        policy.signalConservativeMarkWork(size);
+        SignalConservativeMarkWork(size);
 #ifdef MMGC_CONSERVATIVE_PROFILER
         if (demos != NULL)
         {
@@ -2737,13 +3319,43 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         }
 #endif
         
+#ifdef MMGC_POLICY_PROFILING
+        // Time the scanning of roots and stacks for -gcsummary.  The time includes
+        // any marking that TraceConservativePointer does inline.
+        bool timeScan = (type == GCMarkStack::kStackMemory || type == GCMarkStack::kLargeRootChunk) &&
+                        heap->Config().gcbehavior > 0;
+        uint64_t scanStart = timeScan ? VMPI_getPerformanceCounter() : 0;
+#endif
+
         uintptr_t *p = (uintptr_t*) userptr;
         uintptr_t *end = p + (size / sizeof(void*));
+#ifdef MMGC_SIMD_CONSERVATIVE_SCAN
+        const uintptr_t memStart = pageMap.MemStart();
+        const uintptr_t memSpan = pageMap.MemEnd() - memStart;
+        if (memSpan <= kMaxFilterSpan)
+        {
+            while (end - p >= ptrdiff_t(kFilterGroupWords))
+            {
+                uint32_t candidates = CandidateMask(p, memStart, memSpan);
+                for ( uint32_t i=0 ; candidates != 0 ; i++, candidates >>= 1 )
+                {
+                    if (candidates & 1)
+                        TraceConservativePointer(uintptr_t(p[i]), interiorPtrs HEAP_GRAPH_ARG(p+i));
+                }
+                p += kFilterGroupWords;
+            }
+        }
+#endif
         while(p < end)
         {
             TraceConservativePointer(uintptr_t(*p), interiorPtrs HEAP_GRAPH_ARG(p));
             p++;
         }
+
+#ifdef MMGC_POLICY_PROFILING
+        if (timeScan)
+            SignalRootAndStackScan(size / sizeof(void*), VMPI_getPerformanceCounter() - scanStart);
+#endif
     }
 
     void GC::TraceConservativePointer(uintptr_t val, bool handleInteriorPtrs HEAP_GRAPH_ARG(uintptr_t* loc))
@@ -2819,6 +3431,11 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 #endif
 
             gcbits_t& bits2 = block->bits[GCAlloc::GetBitsIndex(block, item)];
+
+            // The compactor must not move an object that may be referenced from here.
+            if (bits2 & kMovable)
+                SetPinned(bits2);
+
             if ((bits2 & (kMark|kQueued)) == 0)
             {
                 uint32_t itemSize = block->size - (uint32_t)DebugSize();
@@ -2832,9 +3449,10 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
                     // merely a last-ditch mechanism then there's little reason to assume that
                     // recursive marking will buy us much here.
                     uintptr_t thisPage = val & GCHeap::kBlockMask;
-                    if(((uintptr_t)realItem & GCHeap::kBlockMask) != thisPage || mark_item_recursion_control == 0)
+                    if(((uintptr_t)realItem & GCHeap::kBlockMask) != thisPage || mark_item_recursion_control == 0 || m_markingInParallel)
                     {
-                        bits2 |= kQueued;
+                        if (!ClaimForMarking(bits2, kQueued))
+                            goto end;
                         Push_GCObject(realItem);
                     }
                     else
@@ -2846,8 +3464,9 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
                 }
                 else
                 {
-                    bits2 |= kMark;
-                    policy.signalPointerfreeMarkWork(itemSize);
+                    if (!ClaimForMarking(bits2, kMark))
+                        goto end;
+                    SignalPointerfreeMarkWork(itemSize);
                 }
 #ifdef MMGC_HEAP_GRAPH
                 markerGraph.edge(loc, GetUserPointer(item));
@@ -2894,14 +3513,16 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
                 uint32_t itemSize = b->size - (uint32_t)DebugSize();
                 if(b->containsPointers)
                 {
-                    b->flags[0] |= kQueued;
+                    if (!ClaimForMarking(b->flags[0], kQueued))
+                        goto end;
                     Push_GCObject(GetUserPointer(item));
                 }
                 else
                 {
                     // doesn't need marking go right to black
-                    b->flags[0] |= kMark;
-                    policy.signalPointerfreeMarkWork(itemSize);
+                    if (!ClaimForMarking(b->flags[0], kMark))
+                        goto end;
+                    SignalPointerfreeMarkWork(itemSize);
                 }
 #ifdef MMGC_HEAP_GRAPH
                 markerGraph.edge(loc, GetUserPointer(item));
@@ -2937,12 +3558,14 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         if ((bits2 & (kMark|kQueued)) == 0)
         {
             if (ContainsPointers(obj)) {
-                bits2 |= kQueued;
+                if (!ClaimForMarking(bits2, kQueued))
+                    return;
                 Push_GCObject(obj);
             }
             else {
-                bits2 |= kMark;
-                policy.signalPointerfreeMarkWork(Size(obj));
+                if (!ClaimForMarking(bits2, kMark))
+                    return;
+                SignalPointerfreeMarkWork(uint32_t(Size(obj)));
             }
 #ifdef MMGC_HEAP_GRAPH
             markerGraph.edge(loc, obj);
@@ -2980,9 +3603,9 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
     {
         GCAssert(!markerActive);
 
-        uint32_t time = incrementalValidation ? 1 : policy.incrementalMarkMilliseconds();
+        uint32_t time = incrementalValidation ? 1000 : policy.incrementalMarkMicroseconds();
 #ifdef GCDEBUG
-        time = 1;
+        time = 1000;
 #endif
 
         TELEMETRY_METHOD(getTelemetry(), ".gc.Mark");
@@ -2997,6 +3620,8 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
             if (m_incrementalWork.Count() == 0) {
                 // Policy triggers off these signals, so we still need to send them.
                 policy.signal(GCPolicyManager::START_IncrementalMark);
+                if (incrementalWeakRefs)
+                    VisitWeakRefs(VMPI_getPerformanceCounter() + time * VMPI_getPerformanceFrequency() / 1000000);
                 policy.signal(GCPolicyManager::END_IncrementalMark);
                 return;
             }
@@ -3021,7 +3646,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         uint64_t numObjects=policy.objectsMarked();
         uint64_t objSize=policy.bytesMarked();
 
-        uint64_t ticks = start + time * VMPI_getPerformanceFrequency() / 1000;
+        uint64_t ticks = start + time * VMPI_getPerformanceFrequency() / 1000000;
         do {
             // EXACTGC OPTIMIZEME: Count can overestimate the amount of work on the stack
             // because exactly traced large split items occupy two slots on the
@@ -3041,6 +3666,10 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
             SAMPLE_CHECK();
         } while(VMPI_getPerformanceCounter() < ticks);
 
+        // Spend the rest of the slice, if any, on the weak references.
+        if (incrementalWeakRefs && m_incrementalWork.Count() == 0)
+            VisitWeakRefs(ticks);
+
         policy.signal(GCPolicyManager::END_IncrementalMark);
 
         markerActive--;
@@ -3068,6 +3697,11 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         {
             TELEMETRY_METHOD(getTelemetry(), ".gc.Mark");
             
+            // The draining of the mark queue below is part of the final pause, so it
+            // is timed (and its work rated) as part of the final root and stack scan.
+
+            policy.signal(GCPolicyManager::START_FinalRootAndStackScan);
+
             // It is possible, probably common, to enter FinishIncrementalMark without the
             // mark queue being empty.   Clear out the queue synchronously here, we don't
             // want anything pending when we start marking roots: multiple active root protectors
@@ -3091,8 +3725,6 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
             // mark roots again, could have changed (alternative is to put WB's on the roots
             // which we may need to do if we find FinishIncrementalMark taking too long)
             
-            policy.signal(GCPolicyManager::START_FinalRootAndStackScan);
-            
             GCAssert(!m_markStackOverflow);
             
             FlushBarrierWork();
@@ -3132,6 +3764,26 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         FindMissingWriteBarriers();
 #endif
 
+        if (generational) {
+            uint64_t bytesMarked = policy.bytesMarked() - m_bytesMarkedAtStart;
+            if (m_minorCollection) {
+                m_minorCollections++;
+                m_minorsSinceMajor++;
+                m_bytesPromoted += bytesMarked;
+            }
+            else {
+                m_majorCollections++;
+                m_minorsSinceMajor = 0;
+                m_bytesLiveAfterMajor = bytesMarked;
+                m_bytesPromoted = 0;
+            }
+            if (heap->Config().gcstats) {
+                gclog("[mem] %s collection marked %u kb\n",
+                      m_minorCollection ? "minor" : "major", uint32_t(bytesMarked >> 10));
+            }
+            m_minorCollection = false;
+        }
+
         policy.signal(GCPolicyManager::START_FinalizeAndSweep);
         GCAssert(!collecting);
 
@@ -3140,6 +3792,7 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
 
         GCAssert(m_incrementalWork.Count() == 0);
         GCAssert(m_barrierWork.Count() == 0);
+        m_stackScannedForSweep = scanStack;
         Sweep();
         GCAssert(m_incrementalWork.Count() == 0);
         GCAssert(m_barrierWork.Count() == 0);
@@ -3301,8 +3954,17 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
         // support it anyway.
         WorkItemInvariants_GCObject(container);
 #endif
-        if (!m_barrierWork.Push_GCObject(container))
-            Push_GCObject(container);
+        if (!m_barrierWork.Push_GCObject(container)) {
+            if (marking)
+                Push_GCObject(container);
+            else {
+                // Generational mode, between collections: there is no mark stack to
+                // fall back on.  Leave the object marked and have the next collection
+                // rescan every marked object, as for a mark stack overflow.
+                SetMark(container);
+                m_markStackOverflow = true;
+            }
+        }
     }
 
     void GC::movePointers(void* dstObject, void **dstArray, uint32_t dstOffset, const void **srcArray, uint32_t srcOffset, size_t numPointers)
@@ -3547,7 +4209,18 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
                 }
             }
             ref = new (gc) GCWeakRef(userptr);
+            uint64_t tableBytes = gc->weakRefs.bytesUsed();
             gc->weakRefs.put(userptr, ref);
+            if (gc->weakRefsVisited)
+                gc->weakRefsPending.put(userptr, ref);
+            else if (gc->weakRefsCursor != 0) {
+                // Growing the table moves the entries, so the visit must start over;
+                // otherwise the new entry may be behind the visit's cursor.
+                if (gc->weakRefs.bytesUsed() != tableBytes)
+                    gc->weakRefsCursor = 0;
+                else
+                    gc->weakRefsPending.put(userptr, ref);
+            }
             SetHasWeakRef(userptr, true);
 #ifdef MMGC_WEAKREF_PROFILER
             if (gc->weaklings != NULL) {
@@ -3565,6 +4238,10 @@ static inline int LargeGCAllocHeapPartition(int index)    { GCAssert(kGCPartitio
     {
         GCWeakRef *ref = (GCWeakRef*) weakRefs.remove(item, allowRehash);
         GCAssert(weakRefs.get(item) == NULL);
+        // Removal may move an entry the visit has not seen behind its cursor, so
+        // an unfinished visit must start over.  See VisitWeakRefs.
+        if (ref && !weakRefsVisited)
+            weakRefsCursor = 0;
         GCAssert(ref != NULL || heap->GetStatus() == kMemAbort);
         if(ref) {
             GCAssert(ref->isNull() || ref->peek() == item);
@@ -148,6 +148,13 @@ namespace avmplus
     class Traits;
 #ifdef VMCFG_SELFTEST
     namespace ST_mmgc_basics { class ST_mmgc_basics; }
+    namespace ST_mmgc_generational { class ST_mmgc_generational; }
+    namespace ST_mmgc_reap { class ST_mmgc_reap; }
+    namespace ST_mmgc_incweakrefs { class ST_mmgc_incweakrefs; }
+    namespace ST_mmgc_stackframes { class ST_mmgc_stackframes; }
+    namespace ST_mmgc_tracelog { class ST_mmgc_tracelog; }
+    namespace ST_mmgc_allocsampler { class ST_mmgc_allocsampler; }
+    namespace ST_mmgc_bgsweep { class ST_mmgc_bgsweep; }
 #endif
 }
 
@@ -163,6 +170,10 @@ namespace MMgc
     typedef GCNoFinalizeDummyClass* GCNoFinalizeFlag;
     const GCNoFinalizeFlag kNoFinalize = 0;
 
+    class GCMovableDummyClass;
+    typedef GCMovableDummyClass* GCMovableFlag;
+    const GCMovableFlag kMovableObject = 0;
+
     /**
      * Memory types for dependent memory
      * @see SignalDependentAllocation, SignalDependentAllocation
@@ -176,6 +187,8 @@ namespace MMgc
     class GCRoot
     {
         friend class GC;
+        friend class GCCompactor;
+        friend class HeapSnapshotWriter;
 #ifdef VMCFG_SELFTEST
         friend class avmplus::ST_mmgc_basics::ST_mmgc_basics;
 #endif
@@ -358,6 +371,14 @@ namespace MMgc
          */
         virtual void prereap(void* /*rcobj*/);
 
+        /**
+         * Called when the native stack is about to be scanned, if
+         * GCConfig::exactStackFrames is set: report the frames on the stack
+         * whose layout is known to 'frames', see GCStackFrames.  Must not
+         * allocate.
+         */
+        virtual void enumerateStackFrames(GCStackFrames& frames);
+
     private:
         GC *gc;
         GCCallback *nextCB;
@@ -401,6 +422,17 @@ namespace MMgc
      */
     class GCObjectLock;
 
+    /**
+     * The weak references processed by the last collection, see GC::GetWeakRefStats.
+     */
+    struct WeakRefStats
+    {
+        uint32_t entries;               // The weak references at the end of marking
+        uint32_t visitedIncrementally;  // Those visited during the incremental mark slices
+        uint32_t visitedInPause;        // Those visited during the final pause
+        uint32_t cleared;               // Those whose objects were found dead and cleared
+    };
+
     /**
      * This is a general-purpose garbage collector used by the Flash Player.
      * Application code must implement the GCRoot interface to mark all
@@ -440,8 +472,13 @@ namespace MMgc
         friend class GCHeap;
         friend class GCCallback;
         friend class GCAlloc;
+        friend class AllocationSampler;
+        friend class HeapSnapshotWriter;
+        friend class GCBackgroundSweeper;
+        friend class GCCompactor;
         friend class GCLargeAlloc;
         friend class GCMarkStack;
+        friend class GCParallelMarker;
         friend class GCWeakRef;
         friend class RCObject;
         friend class ZCT;
@@ -461,6 +498,13 @@ namespace MMgc
         friend class GCTraceableBase;
 #ifdef VMCFG_SELFTEST
         friend class avmplus::ST_mmgc_basics::ST_mmgc_basics;
+        friend class avmplus::ST_mmgc_generational::ST_mmgc_generational;
+        friend class avmplus::ST_mmgc_reap::ST_mmgc_reap;
+        friend class avmplus::ST_mmgc_incweakrefs::ST_mmgc_incweakrefs;
+        friend class avmplus::ST_mmgc_stackframes::ST_mmgc_stackframes;
+        friend class avmplus::ST_mmgc_tracelog::ST_mmgc_tracelog;
+        friend class avmplus::ST_mmgc_allocsampler::ST_mmgc_allocsampler;
+        friend class avmplus::ST_mmgc_bgsweep::ST_mmgc_bgsweep;
 #endif
         friend class avmplus::Traits;    // We may be able to throttle back on this by making TracePointer visible, but OK for now
     public:
@@ -518,6 +562,15 @@ namespace MMgc
          */
         const bool incremental;
 
+        /**
+         * generational is set if GCConfig::generational was set and collection is
+         * incremental.  Objects then keep their mark bits when they survive a
+         * collection, the write barrier stays active between collections, and most
+         * collections are minor collections.  See the comment above
+         * GC::StartIncrementalMark.
+         */
+        const bool generational;
+
         /**
          * drcEnabled controls whether DRC is employed.  This is true
          * by default and disabling it is only recommended for
@@ -613,7 +666,8 @@ namespace MMgc
             kFinalize=4,            // This must match kFinalizable in GCAlloc.h
             kRCObject=8,
             kInternalExact=16,      // INTERNAL USE.  This must match kVirtualGCTrace in GCAlloc.h
-            kCanFail=32
+            kCanFail=32,
+            kInternalMovable=64     // INTERNAL USE.  This must match kMovable in GCAlloc.h
         };
 
         /**
@@ -679,6 +733,7 @@ namespace MMgc
          */
         void *AllocExtraPtrZero(size_t size, size_t extra, int partition);             // Flags: GC::kContainsPointers|GC::kZero
         void *AllocExtraPtrZeroExact(size_t size, size_t extra, int partition);        // Flags: GC::kContainsPointers|GC::kZero|GC::kInternalExact
+        void *AllocExtraPtrZeroExactMovable(size_t size, size_t extra, int partition); // Flags: GC::kContainsPointers|GC::kZero|GC::kInternalExact|GC::kInternalMovable
         void *AllocExtraPtrZeroFinalized(size_t size, size_t extra, int partition);    // Flags: GC::kContainsPointers|GC::kZero|GC::kFinalize
         void *AllocExtraPtrZeroFinalizedExact(size_t size, size_t extra, int partition); // Flags: GC::kContainsPointers|GC::kZero|GC::kFinalize|GC::kInternalExact
         void *AllocExtraRCObject(size_t size, size_t extra, int partition);            // Flags: GC::kContainsPointers|GC::kZero|GC::kRCObject|GC::kFinalize
@@ -934,6 +989,12 @@ namespace MMgc
 
         bool Reaping();
 
+        /**
+         * @return true if GCConfig::exactStackFrames was set, so that the frames
+         * reported by the GCCallbacks are scanned exactly.
+         */
+        bool ExactStackFrames() const;
+
 #ifdef GCDEBUG
         // Test whether the RCObject cleaned itself properly by zeroing everything.
         void RCObjectZeroCheck(RCObject *);
@@ -1446,8 +1507,10 @@ namespace MMgc
         void gclog(const char *format, ...);
         void log_mem(const char *name, size_t s, size_t comp );
 
+    public:
         const static int kNumSizeClasses = 40;
-		
+
+    private:
         uint32_t *AllocBits(int numBytes, int sizeClass, int partition);
 
         void FreeBits(uint32_t *bits, int sizeClass, int partition);
@@ -1455,7 +1518,7 @@ namespace MMgc
         uint32_t *m_bitsFreelists[kNumSizeClasses][kNumGCPartitions];
         uint32_t *m_bitsNext;
 
-        GCHashtable weakRefs;
+        GCGroupHashtable weakRefs;
 
         // If a weak reference in the weakref table points to an unmarked object then
         // clear the weak reference and remove it from the weakref table.  If a weak
@@ -1463,6 +1526,29 @@ namespace MMgc
         // mark it.
         void MarkOrClearWeakRefs();
 
+        // Incremental processing of weakRefs (GCConfig::incrementalWeakRefs).
+        //
+        // When the mark stack runs dry during incremental marking the rest of the mark
+        // slice is spent visiting weakRefs.  A weak reference whose object is marked
+        // is marked itself, as the object will survive the collection; the other
+        // entries go into weakRefsPending.  Once the visit is complete,
+        // MarkOrClearWeakRefs only has to look at weakRefsPending, to which GetWeakRef
+        // also adds the entries it creates in the meantime.  Removing an entry or
+        // growing the table may move entries the visit has not seen behind its cursor,
+        // so ClearWeakRef and GetWeakRef rewind an unfinished visit when they do that.
+        const bool incrementalWeakRefs;
+        int32_t weakRefsCursor;         // The weakRefs.nextIndex index to resume the visit at, 0 if not started
+        bool weakRefsVisited;           // The visit is complete
+        GCGroupHashtable weakRefsPending;
+        WeakRefStats weakRefStats;      // For the last collection
+
+        // Visit weakRefs until the visit is complete or, unless 'ticks' is 0, the
+        // performance counter reaches 'ticks'.
+        void VisitWeakRefs(uint64_t ticks);
+
+        // Forget the visit, at the start and the end of a collection.
+        void ResetWeakRefVisit();
+
         // BEGIN FLAGS
         // The flags are hot, group them and hope they end up in the same cache line
 
@@ -1562,6 +1648,95 @@ namespace MMgc
         // reach.  Managed entirely within MarkItem.
         uint32_t mark_item_recursion_control;
 
+        // Helper threads for draining the mark stack, NULL unless GCConfig::markerThreads
+        // is nonzero.  See GCParallelMarker.h.
+        GCParallelMarker* m_parallelMarker;
+
+        // Thread for sweeping small-object blocks after a collection, NULL unless
+        // GCConfig::backgroundSweep is set.  See GCBackgroundSweeper.h.
+        GCBackgroundSweeper* m_backgroundSweeper;
+
+        // Evacuates sparse blocks of movable objects at the start of Sweep, NULL
+        // unless GCConfig::compaction is set.  See GCCompactor.h.
+        GCCompactor* m_compactor;
+
+        // Samples allocations for an allocation profile, NULL unless
+        // GCConfig::allocationSampleInterval is nonzero.  See GCAllocationSampler.h.
+        AllocationSampler* m_allocationSampler;
+
+        // The number of bytes GCAlloc and GCLargeAlloc may allocate before the next
+        // allocation sample; they call SampleAllocation when it goes negative.
+        int32_t allocationSampleCountdown;
+
+        // Sample 'item', a real pointer to an object just allocated by a call from
+        // 'caller' or NULL if the allocation failed, and reset allocationSampleCountdown.
+        void SampleAllocation(const void* item, uintptr_t caller);
+
+        // Non-NULL while the compactor is updating references to moved objects or a
+        // heap snapshot is being written: the TraceLocation family then hands the
+        // traced fields to the visitor instead of marking.
+        GCEdgeVisitor* m_edgeVisitor;
+
+        // True if the collection being finished has scanned the native stack, so
+        // that objects the stack refers to are pinned and may not be moved.
+        bool m_stackScannedForSweep;
+
+        // Single blocks held back from the heap by FreeBlock and handed out again by
+        // AllocBlock, see the comment above GC::AllocBlock.  An entry with bit 0 set
+        // is a block that is known to be zeroed.
+        static const uint32_t kBlockCacheSize = 16;
+        static const uint32_t kBlockCacheBatch = 8;     // Blocks moved to or from the heap at a time
+        void* m_blockCache[kNumGCPartitions][kBlockCacheSize];
+        uint32_t m_blockCacheCount[kNumGCPartitions];
+        uint64_t m_blockCacheHits;          // Statistics for -memstats
+        uint64_t m_blockCacheRefills;
+        uint64_t m_blockCacheReturns;
+
+        // Return every cached block to the heap.
+        void FlushBlockCache();
+
+        // Generational mode state, see the comment above StartIncrementalMark.
+        bool m_minorCollection;             // The collection in progress is a minor collection
+        bool m_majorCollectionRequested;    // The next collection must be a major collection
+        uint32_t m_minorCollections;        // Statistics for -memstats
+        uint32_t m_majorCollections;
+        uint32_t m_minorsSinceMajor;
+        uint64_t m_bytesMarkedAtStart;      // policy.bytesMarked() when the collection started
+        uint64_t m_bytesLiveAfterMajor;     // Bytes marked by the last major collection
+        uint64_t m_bytesPromoted;           // Bytes marked by minor collections since then
+
+        // Decide whether the collection being started should be a major collection.
+        bool MajorCollectionDue();
+
+        // True while m_parallelMarker is draining the mark stack.  The marker then
+        // pushes onto the calling thread's mark stack, claims objects atomically, and
+        // accounts mark work per thread.
+        bool m_markingInParallel;
+
+        // The mark stack that the marker on the calling thread pushes onto.
+        GCMarkStack& CurrentMarkStack();
+
+        // Set 'flag' (kQueued or kMark) in 'bits' if neither kMark nor kQueued is set.
+        // Return true if the caller set the flag and is responsible for the object.
+        bool ClaimForMarking(gcbits_t& bits, gcbits_t flag);
+        static bool ClaimForMarkingAtomic(gcbits_t& bits, gcbits_t flag);
+
+        // Replace the 'clear' bits in 'bits' by the 'set' bits atomically, for bits
+        // that other markers may be updating at the same time.
+        static void UpdateBitsAtomic(gcbits_t& bits, gcbits_t clear, gcbits_t set);
+
+        // Pin a movable object (kPinned), atomically if marking in parallel.
+        void SetPinned(gcbits_t& bits);
+
+        // Route mark work to the policy manager, or to the current marker when
+        // marking in parallel.
+        void SignalExactMarkWork(uint32_t nbytes);
+        void SignalConservativeMarkWork(uint32_t nbytes);
+        void SignalPointerfreeMarkWork(uint32_t nbytes);
+#ifdef MMGC_POLICY_PROFILING
+        void SignalRootAndStackScan(uint64_t words, uint64_t ticks);
+#endif
+
 #ifdef GCDEBUG
         // Works on any address
         bool IsWhite(const void *item);
@@ -1573,9 +1748,17 @@ namespace MMgc
         // Used heavily by GC::Free.
         bool IsQueued(const void* userptr);
 
+    public:
+        // The built-in size classes, unless GCConfig::sizeClasses replaces them.
         const static int16_t kSizeClasses[kNumSizeClasses];
+
+    private:
         const static uint8_t kSizeClassIndex[246];
 
+        uint16_t m_sizeClasses[kNumSizeClasses];            // The size classes in use
+        uint8_t m_sizeClassIndex[kLargestAlloc>>3];         // The index table for GCConfig::sizeClasses
+        SizeClassHistogram m_sizeClassHistogram;            // Sizes of small requests if GCConfig::sizeClassStatistics
+
         // These two members help optimize GC::Alloc: by keeping a pointer in the GC instance
         // for the kSizeClassIndex table we avoid code generation SNAFUs when compiling with -fPIC,
         // which is the default on Mac at least.  (GCC generates a call-to-next-instruction-and-pop
@@ -1585,6 +1768,10 @@ namespace MMgc
         // tree inside GC::Alloc.
 
         const uint8_t* const sizeClassIndex;
+
+        // The largest request the inline allocators handle: kLargestAlloc, or 0 while
+        // recording size-class statistics, so that every request reaches GC::Alloc.
+        const size_t inlineAllocLimit;
 		
 		typedef GCAlloc* Allocators[kNumSizeClasses][kNumGCPartitions];
         Allocators* allocsTable[(kRCObject|kFinalize|kContainsPointers)+1];
@@ -1598,7 +1785,11 @@ namespace MMgc
         PageMap::Uniform pageMap;
 #else
 #ifdef MMGC_64BIT
+#ifdef MMGC_USE_DELAYED_PAGEMAP
         PageMap::DelayT4 pageMap;
+#else
+        PageMap::LockFreeT3 pageMap;
+#endif // MMGC_USE_DELAYED_PAGEMAP
 #else
         PageMap::Tiered2 pageMap;
 #endif // MMGC_64BIT
@@ -1666,6 +1857,14 @@ namespace MMgc
         void MarkItem_ConservativeOrNonGCObject(const void* object, uint32_t size, GCMarkStack::TypeTag type, const void* baseptr, bool interiorPtrs);
         void SplitExactGCObject(const void* object);
         void SplitItem_ConservativeOrNonGCObject(const void* object, uint32_t& size, GCMarkStack::TypeTag type, const void* baseptr);
+#ifdef MMGC_SIMD_CONSERVATIVE_SCAN
+        // The conservative marker's prefilter, see MMgc.h.  Words are tested in groups
+        // of kFilterGroupWords.  The filter is used only if the GC's memory spans no
+        // more than kMaxFilterSpan bytes, as it compares 32-bit offsets.
+        static const uint32_t kFilterGroupWords = 4;
+        static const uintptr_t kMaxFilterSpan = 0xFFFFFFFFU;
+        static uint32_t CandidateMask(const uintptr_t* p, uintptr_t memStart, uintptr_t memSpan);
+#endif
         void EstablishSweepInvariants();
         void ClearMarkStack();
         void AbortInProgressMarking();
@@ -1673,6 +1872,22 @@ namespace MMgc
         static void DoCleanStack(void* stackPointer, void* arg);
         static void DoMarkFromStack(void* stackPointer, void* arg);
 
+        // Exact scanning of stack frames (GCConfig::exactStackFrames).  The frames
+        // the callbacks report are collected in stackFrames, which is shared with
+        // the ZCT's pinning of the stack.
+        const bool exactStackFrames;
+        GCStackFrames stackFrames;
+        StackFrameStats stackFrameStats;    // For the last stack scan
+
+        // Push [stackPointer,stackBase) onto the mark stack, except for the
+        // frames the callbacks report, whose pointer words are traced instead.
+        void PushStackWithFrames(const char* stackPointer, const char* stackBase);
+
+        // Record a phase that started at 'start' (in VMPI_getPerformanceCounter ticks)
+        // and ends now in the heap's trace log, if there is one, on this GC's track.
+        void TracePhase(const char* name, uint64_t start, int64_t bytes);
+        uint32_t traceTrack;                // 0 until the first event is recorded
+
     public:
         // Sweep all small-block pages that need sweeping
         void SweepNeedsSweeping();
@@ -1736,6 +1951,7 @@ namespace MMgc
         void DoPreReapCallbacks();
         void DoPreReapCallbacks(void* rcObject);
         void DoPostReapCallbacks();
+        void DoStackFramesCallbacks(GCStackFrames& frames);
 
     public:
         // PreventImmediateReaping is used by Flash Player for older content: it means to flag
@@ -1779,6 +1995,65 @@ namespace MMgc
 
     public:
         void DumpMemoryInfo();
+
+        /**
+         * Write the allocation profile to 'filename', or to GCLog if filename is NULL.
+         * Does nothing unless GCConfig::allocationSampleInterval was set; see
+         * GCAllocationSampler.h.  Call it while the AvmCore is alive.
+         *
+         * @return false if the profile could not be written.
+         */
+        bool DumpAllocationProfile(const char* filename=NULL);
+
+        /**
+         * Write a snapshot of the heap to 'filename': the roots, and every object with
+         * its size, its type, and the objects it references.  Runs a full collection
+         * first.  See GCHeapSnapshot.h for the format; utils/heapsnapshot.py computes
+         * dominators and retained sizes from it.  Call it on the GC's thread while the
+         * AvmCore is alive, outside of collection.
+         *
+         * @return false if the snapshot could not be written.
+         */
+        bool WriteHeapSnapshot(const char* filename);
+
+        /**
+         * Obtain the statistics of one size class, summed over the kinds of object
+         * and the partitions.  The requests are counted only if
+         * GCConfig::sizeClassStatistics was set.
+         *
+         * @param index  The size class, 0 to kNumSizeClasses-1
+         * @param stats  (out) The statistics
+         */
+        void GetSizeClassStats(int index, SizeClassStats& stats);
+
+        /**
+         * Print the statistics of the size classes in use on the VMPI_log channel.
+         */
+        void DumpSizeClassStats();
+
+        /**
+         * Compute a table of kNumSizeClasses size classes fitted to the requests
+         * recorded so far, for GCConfig::sizeClasses.  The smallest and largest
+         * classes are those of kSizeClasses; see SizeClassHistogram.
+         *
+         * @return false if GCConfig::sizeClassStatistics was not set or no requests
+         *         were recorded.
+         */
+        bool ComputeSizeClasses(uint16_t sizeClasses[kNumSizeClasses]);
+
+        /**
+         * Obtain the counts of the weak references processed by the last collection,
+         * in its incremental mark slices (only if GCConfig::incrementalWeakRefs was
+         * set) and in its final pause.
+         */
+        void GetWeakRefStats(WeakRefStats& stats);
+
+        /**
+         * Obtain the counts of the words of the native stack scanned by the last
+         * scan of the stack for marking.  Only the conservatively scanned words are
+         * counted unless GCConfig::exactStackFrames is set.
+         */
+        void GetStackFrameStats(StackFrameStats& stats);
 #ifdef MMGC_MEMORY_PROFILER
         void DumpPauseInfo();
 #endif
@@ -50,6 +50,25 @@ namespace MMgc
         GetBlock(userptr)->slowFlags |= kFlagWeakRefs;
     }
 
+    /*static*/
+    REALLY_INLINE void GCAlloc::ClaimObjectFromBackgroundSweeper(const void *userptr)
+    {
+        GCBlock* b = GetBlock(userptr);
+        if (b->sweepIndex >= 0)
+            ((GCAlloc*)b->alloc)->TakeBackFromBackgroundSweeper(b);
+    }
+
+    REALLY_INLINE bool GCAlloc::ClaimFromBackgroundSweeper(GCBlock *b)
+    {
+        if (b->sweepIndex < 0)
+            return false;
+        int32_t numSwept = m_gc->m_backgroundSweeper->Claim(b);
+        if (numSwept < 0)
+            return false;
+        m_totalAllocatedBytes -= numSwept * m_itemSize;
+        return true;
+    }
+
     REALLY_INLINE void GCAlloc::AddToFreeList(GCBlock *b)
     {
         GCAssert(!IsOnEitherList(b) && !b->needsSweeping());
@@ -185,6 +204,23 @@ namespace MMgc
             }
         }
     }
+
+    REALLY_INLINE bool GCAllocIterator::GetNextAllocatedObject(void*& out_ptr)
+    {
+        for (;;) {
+            if (idx == limit) {
+                idx = 0;
+                block = GCAlloc::Next(block);
+            }
+            if (block == NULL)
+                return false;
+            uint32_t i = idx++;
+            if ((GC::GetGCBits(block->items + i*size) & GCAlloc::kFreelist) != GCAlloc::kFreelist) {
+                out_ptr = GetUserPointer(block->items + i*size);
+                return true;
+            }
+        }
+    }
 }
 
 #endif /* __GCAlloc_inlines__ */
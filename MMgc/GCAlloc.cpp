@@ -215,6 +215,7 @@ namespace MMgc
             b->alloc = this;
             b->size = m_itemSize;
             b->slowFlags = 0;
+            b->sweepIndex = -1;
             if(m_gc->collecting && m_finalized)
                 b->finalizeState = m_gc->finalizedValue;
             else
@@ -395,19 +396,26 @@ namespace MMgc
 #endif
 
         m_totalAllocatedBytes += m_itemSize;
+        void* item;
         if (m_qList == NULL) {
 #if defined GCDEBUG || defined MMGC_MEMORY_PROFILER
-            return AllocSlow(askSize, flags);
+            item = AllocSlow(askSize, flags);
 #else
-            return AllocSlow(flags);
+            item = AllocSlow(flags);
 #endif
         }
-
+        else {
 #if defined GCDEBUG || defined MMGC_MEMORY_PROFILER
-        return AllocFromQuickList(askSize, flags);
+            item = AllocFromQuickList(askSize, flags);
 #else
-        return AllocFromQuickList(flags);
+            item = AllocFromQuickList(flags);
 #endif
+        }
+
+        if ((m_gc->allocationSampleCountdown -= int32_t(m_itemSize)) < 0)
+            m_gc->SampleAllocation(item, MMGC_RETURN_ADDRESS());
+
+        return item;
     }
 
 #if defined GCDEBUG || defined MMGC_MEMORY_PROFILER
@@ -428,10 +436,11 @@ namespace MMgc
         // Code below uses these optimizations
         GCAssert((unsigned long)GC::kFinalize == (unsigned long)kFinalizable);
         GCAssert((unsigned long)GC::kInternalExact == (unsigned long)kVirtualGCTrace);
+        GCAssert((unsigned long)GC::kInternalMovable == (unsigned long)kMovable);
         GCAssert((flags & GC::kFinalize) == 0 || containsFinalizedObjects);
 
 #if defined VMCFG_EXACT_TRACING
-        b->bits[GetBitsIndex(b, item)] = (flags & (GC::kFinalize|GC::kInternalExact));
+        b->bits[GetBitsIndex(b, item)] = (flags & (GC::kFinalize|GC::kInternalExact|GC::kInternalMovable));
 #elif defined VMCFG_SELECTABLE_EXACT_TRACING
         b->bits[GetBitsIndex(b, item)] = (flags & (GC::kFinalize|m_gc->runtimeSelectableExactnessFlag));  // 0 or GC::kInternalExact
 #else
@@ -526,6 +535,29 @@ namespace MMgc
         }
     }
 
+    void* GCAlloc::AllocForMove()
+    {
+        GCAssert(m_gc->collecting && m_qList == NULL);
+
+        GCBlock* b = m_firstFree;
+        if (b == NULL) {
+            CreateChunk(GC::kCanFail);
+            b = m_firstFree;
+            if (b == NULL)
+                return NULL;
+        }
+        GCAssert(!b->needsSweeping() && !(b->slowFlags & kFlagEvacuated));
+
+        void* item = FLPopAndZero(b->firstFree);
+        if (--b->numFree == 0)
+            RemoveFromFreeList(b);
+        m_totalAllocatedBytes += m_itemSize;
+
+        VALGRIND_MEMPOOL_ALLOC(b, item, m_itemSize);
+
+        return item;
+    }
+
     void GCAlloc::FillQuickList(GCBlock* b)
     {
         GCAssert(m_qList == NULL);
@@ -553,10 +585,12 @@ namespace MMgc
         int bitsindex = GetBitsIndex(b, item);
 
         // We can't allow free'ing something during sweeping - it messes up
-        // the per-block statistics - or anything that's on a mark queue.
+        // the per-block statistics - or anything that's on a mark queue.  In
+        // generational mode the remembered set holds queued objects between
+        // collections too.
 
         GCAssert(m_gc->collecting == false || m_gc->marking == true);
-        if (m_gc->marking && (m_gc->collecting || b->bits[bitsindex] & kQueued)) {
+        if (m_gc->BarrierActive() && (m_gc->collecting || b->bits[bitsindex] & kQueued)) {
             m_gc->AbortFree(GetUserPointer(item));
             return;
         }
@@ -602,6 +636,12 @@ namespace MMgc
         // would mean that it may end up on both a free list and on the mark stack, and
         // that would be bad; it could also mean that objects reachable from the
         // dead object would be marked in turn and would be retained for a GC cycle.
+        //
+        // The background sweeper, if it has the block, may be updating the bits
+        // and the block's free list, so get the block back first.
+
+        if (b->sweepIndex >= 0)
+            TakeBackFromBackgroundSweeper(b);
 
         b->bits[bitsindex] |= kFreelist;    // Don't clear the weak ref bit, FreeSlow may inspect it
         m_totalAllocatedBytes -= m_itemSize;
@@ -867,10 +907,12 @@ namespace MMgc
                 b->gc->AddToSmallEmptyBlockList(b);
                 putOnFreeList = false;
             } else if(numMarkedItems == (m_itemsPerBlock - b->numFree)) {
-                // nothing changed on this page, clear marks
+                // nothing changed on this page, clear marks (unless they are sticky,
+                // in generational mode)
                 // note there will be at least one free item on the page (otherwise it
                 // would not have been scanned) so the page just stays on the freelist
-                ClearMarks(b);
+                if (!m_gc->generational)
+                    ClearMarks(b);
             } else if(!b->needsSweeping()) {
                 // Removed the block from the free list earlier, check again
                 GCAssert(!(b->nextFree || b->prevFree || b == m_firstFree));
@@ -946,6 +988,22 @@ namespace MMgc
 
     void GCAlloc::SweepGuts(GCBlock *b)
     {
+        // In generational mode survivors keep their mark bits, and the bits of live
+        // items are not written at all: the write barrier may be updating them.
+        //
+        // Otherwise the plain read-modify-write of a live item's bits below is safe
+        // on the background sweeper too, because it only sweeps blocks it has
+        // claimed, and no other thread writes those bits while it holds the claim:
+        //  - the marker and the write barrier are idle, since every queued block is
+        //    claimed back before the next collection starts (GC::SweepNeedsSweeping);
+        //  - GCAlloc::Free and GC::SetHasWeakRef claim the block before they touch
+        //    its bits, and GC::AbortFree only runs while the barrier is active,
+        //    which outside generational mode means while marking;
+        //  - allocation sets the bits of free items only, in blocks that have left
+        //    the sweep list;
+        //  - finalization and reference counting only touch finalized blocks, which
+        //    are never queued.
+        const bool sticky = m_gc->generational;
         gcbits_t* blockbits = b->bits;
         for ( char *item = b->items, *limit = b->items + m_itemSize * b->GetCount() ; item < limit ; item += m_itemSize )
         {
@@ -956,7 +1014,8 @@ namespace MMgc
             if(mq == kMark || mq == kQueued)    // Sweeping is lazy; don't sweep objects on the mark stack
             {
                 // live item, clear bits
-                marks &= ~kFreelist;
+                if (!sticky)
+                    marks &= ~(kFreelist|kPinned);
                 continue;
             }
 
@@ -991,14 +1050,15 @@ namespace MMgc
 
     bool GCAlloc::Sweep(GCBlock *b)
     {
-        int oldNumFree;
         GCAssert(b->needsSweeping());
         GCAssert(m_qList == NULL);
         RemoveFromSweepList(b);
 
-        oldNumFree = b->numFree;
-        SweepGuts(b);
-        m_totalAllocatedBytes -= (b->numFree - oldNumFree) * m_itemSize;
+        if (!ClaimFromBackgroundSweeper(b)) {
+            int oldNumFree = b->numFree;
+            SweepGuts(b);
+            m_totalAllocatedBytes -= (b->numFree - oldNumFree) * m_itemSize;
+        }
         if(b->numFree == m_itemsPerBlock)
         {
             UnlinkChunk(b);
@@ -1012,6 +1072,19 @@ namespace MMgc
         return false;
     }
 
+    void GCAlloc::TakeBackFromBackgroundSweeper(GCBlock *b)
+    {
+        GCAssert(b->needsSweeping());
+        if (!ClaimFromBackgroundSweeper(b))
+            return;
+
+        // The caller holds a live object in b, so the block can't be empty.
+        GCAssert(b->numFree < m_itemsPerBlock);
+        RemoveFromSweepList(b);
+        if (b->numFree > 0)
+            AddToFreeList(b);
+    }
+
     void GCAlloc::SweepNeedsSweeping()
     {
         GCBlock* next;
@@ -1030,10 +1103,11 @@ namespace MMgc
         GCAssert(sizeof(gcbits_t) == 1);
         GCAssert(kFreelist == 3);
         GCAssert(m_numBitmapBytes % 4 == 0);
+        GCAssert(kPinned == 0x80);
         uint32_t *pbits = (uint32_t*)(void *)block->bits;
-        uint32_t mq32 = ~uint32_t(0x03030303U);
+        uint32_t mq32 = ~uint32_t(0x83838383U);
 
-        // Clear the marked and queued bits
+        // Clear the marked, queued, and pinned bits
         // TODO: MMX version for IA32
         for(int i=0, n=m_numBitmapBytes>>2; i < n; i++) {
             pbits[i] &= mq32;
@@ -1160,7 +1234,9 @@ namespace MMgc
 #ifdef GCDEBUG
         // Check that we're not freeing something on the mark stack
         GCAssert((bits[bitsindex] & kQueued) == 0);
-        alloc->VerifyNotFree(this, item);
+        // The quick list belongs to the GC's thread; the background sweeper can't look at it.
+        if (alloc->m_gc->onThread())
+            alloc->VerifyNotFree(this, item);
 #endif
 
         numFree++;
@@ -57,10 +57,10 @@ namespace MMgc
         kQueued=2,              // object is on the mark or barrier queues
         kFinalizable=4,         // object's destructor must be called when the object is destroyed
         kHasWeakRef=8,          // there's an entry for the object in the weakRefs table
-        kVirtualGCTrace = 16    // object derived from GCTraceableBase and has gcTrace override(s), see GCObject.h
-        // free: 32
-        // free: 64
-        // free: 128
+        kVirtualGCTrace = 16,   // object derived from GCTraceableBase and has gcTrace override(s), see GCObject.h
+        kSampled = 32,          // object was sampled by the allocation sampler, see GCAllocationSampler.h
+        kMovable = 64,          // object may be moved by the compactor, see GCCompactor.h
+        kPinned = 128           // movable object was reached by the conservative marker in this collection
     };
 
     /**
@@ -107,6 +107,9 @@ namespace MMgc
     {
         friend class GC;
         friend class GCAllocIterator;
+        friend class AllocationSampler;
+        friend class GCBackgroundSweeper;
+        friend class GCCompactor;
         friend class ZCT;
 
     public:
@@ -142,6 +145,10 @@ namespace MMgc
         static bool IsUnmarkedPointer(const void *val);
         static void SetBlockHasWeakRef(const void *userptr);
 
+        // Take the block holding userptr back from the background sweeper, if it is
+        // queued there, before the object's bits are updated.
+        static void ClaimObjectFromBackgroundSweeper(const void *userptr);
+
         // Return the actual size of items managed by this allocator (includes debugging overheads)
         REALLY_INLINE uint32_t GetItemSize() { return m_itemSize; }
         
@@ -175,6 +182,7 @@ namespace MMgc
 
         const static short kFlagNeedsSweeping = 1;  // set if the block had finalized objects and needs to be swept
         const static short kFlagWeakRefs = 2;       // set if the block may have weak refs and we should check during free
+        const static short kFlagEvacuated = 4;      // set while GCCompactor is moving the objects out of the block
 
         // Objects on the free list all have a next pointer in the first word and
         // the object index within its block as the second word.  Only the low 16 bits
@@ -191,6 +199,7 @@ namespace MMgc
             short numFree;          // the number of free objects in this block
             uint8_t slowFlags;      // flags for special circumstances: kFlagNeedsSweeping, etc
             bool finalizeState:1;   // whether we've been visited during the Finalize stage
+            int32_t sweepIndex;     // index in the background sweeper's queue, or -1 if not queued
             char   *items;          // pointer to the array of objects in the block
 
             int GetCount() const;
@@ -300,6 +309,11 @@ namespace MMgc
         void* AllocFromQuickList(int flags);
 #endif
         void FillQuickList(GCBlock* b);
+
+        // Take an item off the free list of the first block on m_firstFree, creating
+        // a block if there is none, for an object that GCCompactor is moving.  The
+        // caller sets the item's bits.  Returns NULL if no block could be created.
+        void* AllocForMove();
         void CoalesceQuickList();
         void QuickListBudgetExhausted();
         void FreeSlow(GCBlock* b, int index, const void* item);
@@ -308,6 +322,17 @@ namespace MMgc
         bool Sweep(GCBlock *b);
         void SweepGuts(GCBlock *b);
 
+        // If b is queued for background sweeping take it back from the sweeper and
+        // account for any objects the sweeper freed.  Return true if the sweeper has
+        // swept b, false if b still needs to be swept (if it needs sweeping at all).
+        bool ClaimFromBackgroundSweeper(GCBlock *b);
+
+        // Take b back from the background sweeper before one of its live objects is
+        // updated outside of Sweep.  If the sweeper has swept b there is nothing left
+        // for Sweep to do, so b is moved from the sweep list to the free list here;
+        // sweeping it again would free the live objects, whose mark bits are gone.
+        void TakeBackFromBackgroundSweeper(GCBlock *b);
+
         void ClearMarks(GCAlloc::GCBlock* block);
         void SweepNeedsSweeping();
 
@@ -361,6 +386,10 @@ namespace MMgc
 
         bool GetNextMarkedObject(void*& out_ptr);
 
+        // Like GetNextMarkedObject, but returns every object that is not on a free
+        // list.  Only meaningful when no blocks are waiting to be swept.
+        bool GetNextAllocatedObject(void*& out_ptr);
+
     private:
         GCAlloc* const alloc;
         GCAlloc::GCBlock* block;
@@ -0,0 +1,256 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MMgc.h"
+#include "avmplus.h"
+
+#include <math.h>
+#include <stdio.h>
+
+namespace MMgc
+{
+    AllocationSampler::AllocationSampler(GC* gc, uint32_t meanInterval)
+        : gc(gc)
+        , meanInterval(double(meanInterval))
+        , rng(VMPI_getPerformanceCounter() | 1)
+        , sites(mmfx_new_array_opt(Site*, kSiteTableSize, kZero))
+        , numSites(0)
+        , numSamples(0)
+    {
+        GCAssert(meanInterval > 0);
+        VMPI_memset(&overflow, 0, sizeof(overflow));
+    }
+
+    AllocationSampler::~AllocationSampler()
+    {
+        SampleTable::Iterator iter(&samples);
+        while (iter.nextKey() != NULL)
+            mmfx_delete(iter.value());
+        for (uint32_t i=0 ; i < kSiteTableSize ; i++)
+            if (sites[i] != NULL)
+                mmfx_delete(sites[i]);
+        mmfx_delete_array(sites);
+    }
+
+    int32_t AllocationSampler::NextInterval()
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+
+        // -log(u) * mean is exponentially distributed for u uniform in (0,1].
+        double u = double((rng >> 11) + 1) * (1.0 / 9007199254740992.0);
+        double interval = -log(u) * meanInterval;
+        if (interval >= double(0x7FFFFFFF))
+            return 0x7FFFFFFF;
+        return int32_t(interval);
+    }
+
+    void AllocationSampler::Sample(const void* userptr, uintptr_t caller)
+    {
+        // A sample that is still in the table for this address is for an object that
+        // has been freed and whose memory has been reused.
+        SampledObject* s = samples.get(userptr);
+        if (s != NULL)
+            Retire(userptr, s);
+
+        uintptr_t frames[kMaxFrames];
+        uint32_t numFrames = 0;
+        avmplus::AvmCore* core = gc->core();
+        if (core != NULL)
+            numFrames = core->captureMethodFrames(frames, kMaxFrames);
+
+        Site* site = FindSite(caller, frames, numFrames);
+
+        s = mmfx_new(SampledObject);
+        s->site = site;
+        s->size = uint32_t(GC::Size(userptr));
+        s->weight = 1.0 / (1.0 - exp(-double(s->size) / meanInterval));
+        samples.put(userptr, s);
+
+        site->samples++;
+        site->allocObjects += s->weight;
+        site->allocBytes += s->weight * s->size;
+        site->liveObjects += s->weight;
+        site->liveBytes += s->weight * s->size;
+        numSamples++;
+    }
+
+    AllocationSampler::Site* AllocationSampler::FindSite(uintptr_t caller, const uintptr_t* frames, uint32_t numFrames)
+    {
+        uint32_t hash = uint32_t(caller >> 2) * 0x9E3779B1U;
+        for (uint32_t i=0 ; i < numFrames ; i++)
+            hash = (hash ^ uint32_t(frames[i] >> 3)) * 0x9E3779B1U;
+        hash ^= hash >> 16;
+
+        uint32_t i = hash & (kSiteTableSize - 1);
+        for (;;) {
+            Site* s = sites[i];
+            if (s == NULL)
+                break;
+            if (s->hash == hash &&
+                s->caller == caller &&
+                s->numFrames == numFrames &&
+                VMPI_memcmp(s->frames, frames, numFrames * sizeof(uintptr_t)) == 0)
+                return s;
+            i = (i + 1) & (kSiteTableSize - 1);
+        }
+
+        if (numSites >= kSiteTableSize / 4 * 3)
+            return &overflow;
+
+        Site* s = mmfx_new0(Site);
+        s->hash = hash;
+        s->caller = caller;
+        s->numFrames = numFrames;
+        VMPI_memcpy(s->frames, frames, numFrames * sizeof(uintptr_t));
+        sites[i] = s;
+        numSites++;
+        return s;
+    }
+
+    bool AllocationSampler::IsLive(const void* userptr, bool marksAreFinal)
+    {
+        const void* realptr = GetRealPointer(userptr);
+        gcbits_t bits;
+        switch (gc->GetPageMapValue(uintptr_t(realptr)))
+        {
+            case PageMap::kGCAllocPage: {
+                GCAlloc::GCBlock* b = GCAlloc::GetBlock(realptr);
+                // The block may have been freed and reused for a different size class.
+                if (b->bits == NULL || (uintptr_t(realptr) - uintptr_t(b->items)) % b->size != 0)
+                    return false;
+                bits = b->bits[GCAlloc::GetBitsIndex(b, realptr)];
+                if ((bits & GCAlloc::kFreelist) == GCAlloc::kFreelist)
+                    return false;
+                break;
+            }
+            case PageMap::kGCLargeAllocPageFirst: {
+                GCLargeAlloc::LargeBlock* b = GCLargeAlloc::GetLargeBlock(realptr);
+                if (b->GetObject() != realptr)
+                    return false;
+                bits = b->flags[0];
+                break;
+            }
+            default:
+                return false;
+        }
+        return (bits & kSampled) != 0 && (!marksAreFinal || (bits & kMark) != 0);
+    }
+
+    void AllocationSampler::Retire(const void* userptr, SampledObject* s)
+    {
+        s->site->liveObjects -= s->weight;
+        s->site->liveBytes -= s->weight * s->size;
+        samples.remove(userptr, false);
+        mmfx_delete(s);
+    }
+
+    void AllocationSampler::RetireDeadSamples(bool marksAreFinal)
+    {
+        {
+            SampleTable::Iterator iter(&samples);
+            const void* userptr;
+            while ((userptr = iter.nextKey()) != NULL) {
+                if (!IsLive(userptr, marksAreFinal))
+                    Retire(userptr, iter.value());
+            }
+        }
+        samples.prune();
+    }
+
+    void AllocationSampler::DumpSite(Site* s, void (*write)(void*, const char*), void* arg)
+    {
+        // Retiring samples leaves rounding errors behind; don't print them as "-0".
+        double liveBytes = s->liveBytes < 0.5 ? 0 : s->liveBytes;
+        double liveObjects = s->liveObjects < 0.5 ? 0 : s->liveObjects;
+
+        char line[2048];
+        int n = VMPI_snprintf(line, sizeof(line), "%12.0f %10.0f %14.0f %12.0f  ",
+                              liveBytes, liveObjects, s->allocBytes, s->allocObjects);
+        if (s == &overflow)
+            n += VMPI_snprintf(line + n, sizeof(line) - n, "(other sites)");
+        else if (s->numFrames == 0)
+            n += VMPI_snprintf(line + n, sizeof(line) - n, "(no AS3 frames)");
+        for (uint32_t i=0 ; i < s->numFrames && n < int(sizeof(line)) ; i++) {
+            avmplus::Stringp name = ((avmplus::MethodInfo*)s->frames[i])->getMethodName();
+            avmplus::StUTF8String utf8(name);
+            n += VMPI_snprintf(line + n, sizeof(line) - n, "%s%s", i > 0 ? " < " : "", name != NULL ? utf8.c_str() : "(anonymous)");
+        }
+        if (s->caller != 0 && n < int(sizeof(line)))
+            n += VMPI_snprintf(line + n, sizeof(line) - n, " [%p]", (void*)s->caller);
+        if (n < int(sizeof(line)))
+            VMPI_snprintf(line + n, sizeof(line) - n, "\n");
+        else
+            line[sizeof(line) - 2] = '\n';
+        write(arg, line);
+    }
+
+    static void writeToLog(void*, const char* s)
+    {
+        GCLog("%s", s);
+    }
+
+    static void writeToFile(void* arg, const char* s)
+    {
+        fputs(s, (FILE*)arg);
+    }
+
+    bool AllocationSampler::Dump(const char* filename)
+    {
+        RetireDeadSamples(false);
+
+        FILE* fp = NULL;
+        if (filename != NULL) {
+            fp = fopen(filename, "w");
+            if (fp == NULL)
+                return false;
+        }
+        void (*write)(void*, const char*) = fp != NULL ? writeToFile : writeToLog;
+
+        // Sort the sites by decreasing allocation volume (Shell sort).
+        Site** sorted = mmfx_new_array(Site*, numSites + 1);
+        uint32_t n = 0;
+        for (uint32_t i=0 ; i < kSiteTableSize ; i++)
+            if (sites[i] != NULL)
+                sorted[n++] = sites[i];
+        if (overflow.samples > 0)
+            sorted[n++] = &overflow;
+        for (uint32_t gap = n/2 ; gap > 0 ; gap /= 2) {
+            for (uint32_t i=gap ; i < n ; i++) {
+                Site* s = sorted[i];
+                uint32_t j = i;
+                for ( ; j >= gap && sorted[j-gap]->allocBytes < s->allocBytes ; j -= gap)
+                    sorted[j] = sorted[j-gap];
+                sorted[j] = s;
+            }
+        }
+
+        double liveBytes = 0, liveObjects = 0, allocBytes = 0, allocObjects = 0;
+        for (uint32_t i=0 ; i < n ; i++) {
+            liveBytes += sorted[i]->liveBytes;
+            liveObjects += sorted[i]->liveObjects;
+            allocBytes += sorted[i]->allocBytes;
+            allocObjects += sorted[i]->allocObjects;
+        }
+
+        char line[256];
+        VMPI_snprintf(line, sizeof(line), "Allocation profile: one sample per %.0f bytes on average, %llu samples, %u sites\n",
+                      meanInterval, (unsigned long long)numSamples, unsigned(n));
+        write(fp, line);
+        VMPI_snprintf(line, sizeof(line), "Estimated %.0f bytes live in %.0f objects, %.0f bytes allocated in %.0f objects\n",
+                      liveBytes, liveObjects, allocBytes, allocObjects);
+        write(fp, line);
+        write(fp, "  live bytes  live objs    alloc bytes   alloc objs  site (innermost AS3 frame first) [native caller]\n");
+        for (uint32_t i=0 ; i < n ; i++)
+            DumpSite(sorted[i], write, fp);
+
+        mmfx_delete_array(sorted);
+        if (fp != NULL)
+            fclose(fp);
+        return true;
+    }
+}
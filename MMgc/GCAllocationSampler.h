@@ -0,0 +1,148 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCAllocationSampler__
+#define __GCAllocationSampler__
+
+#ifdef VMCFG_SELFTEST
+namespace avmplus
+{
+    namespace ST_mmgc_allocsampler { class ST_mmgc_allocsampler; }
+}
+#endif
+
+// The address an allocator function will return to, used to tell the native
+// callers of the allocators apart.
+#if defined __GNUC__
+    #define MMGC_RETURN_ADDRESS()   uintptr_t(__builtin_return_address(0))
+#elif defined _MSC_VER
+    #include <intrin.h>
+    #define MMGC_RETURN_ADDRESS()   uintptr_t(_ReturnAddress())
+#else
+    #define MMGC_RETURN_ADDRESS()   uintptr_t(0)
+#endif
+
+namespace MMgc
+{
+    /**
+     * Sampling allocation profiler for managed objects (GCConfig::allocationSampleInterval).
+     *
+     * Unlike the MemoryProfiler (GCMemoryProfiler.h), which records every allocation
+     * and requires MMGC_MEMORY_PROFILER, the sampler is always compiled in and is
+     * cheap enough to leave on in release builds.  GCAlloc and GCLargeAlloc count
+     * the bytes they hand out down from GC::allocationSampleCountdown, and when the
+     * count goes negative the object being allocated is sampled and the count is
+     * reset to a fresh random interval.  The intervals are exponentially distributed
+     * with the configured mean, so an object of size S is sampled with probability
+     * 1-exp(-S/mean) independently of what was allocated before it, and each sample
+     * is weighted by the inverse of that probability to estimate the unsampled
+     * totals.  With the sampler off the count is simply reset to its maximum.
+     *
+     * A sample records the allocation site: the AS3 methods on the call stack
+     * (AvmCore::captureMethodFrames) and the native caller of the allocator.  Sites
+     * are aggregated in an open-addressed table that only the GC's thread writes,
+     * so nothing on the sampling path takes a lock.  Method names are resolved when
+     * the profile is dumped, since the sampler is called in the middle of an
+     * allocation and must not allocate managed memory itself.
+     *
+     * Sampled objects are flagged with kSampled in their GC bits, and the sampler
+     * keeps them in a table keyed by address.  Nothing is done when they are freed;
+     * instead the table is checked at the start of GC::Finalize, when the mark bits
+     * are final, and before a dump: an object that is no longer flagged, is on a
+     * free list, or is unmarked at finalization is dead, and its weight is moved
+     * out of the live totals of its site.  Sampled objects are never moved by the
+     * compactor.
+     */
+    class AllocationSampler
+    {
+#ifdef VMCFG_SELFTEST
+        friend class avmplus::ST_mmgc_allocsampler::ST_mmgc_allocsampler;
+#endif
+    public:
+        // The number of AS3 frames recorded per site, innermost first.
+        static const uint32_t kMaxFrames = 16;
+
+        // The capacity of the site table.  Samples from new sites are attributed to
+        // a catch-all site once the table is three quarters full.
+        static const uint32_t kSiteTableSize = 8192;
+
+        AllocationSampler(GC* gc, uint32_t meanInterval);
+        ~AllocationSampler();
+
+        /**
+         * @return a random number of bytes to allocate before the next sample.
+         */
+        int32_t NextInterval();
+
+        /**
+         * Record a sample of the object 'userptr', which has just been allocated by a
+         * call from 'caller' and flagged with kSampled.
+         */
+        void Sample(const void* userptr, uintptr_t caller);
+
+        /**
+         * Retire the samples whose objects are dead.  If 'marksAreFinal' is true then
+         * unmarked objects are dead too.
+         */
+        void RetireDeadSamples(bool marksAreFinal);
+
+        /**
+         * Write the profile to 'filename', or to GCLog if filename is NULL.  The sites
+         * are listed by estimated allocation volume.  Must be called on the GC's
+         * thread while its AvmCore is alive, outside of allocation.
+         *
+         * @return false if the file could not be written.
+         */
+        bool Dump(const char* filename);
+
+    private:
+        struct Site
+        {
+            uint32_t hash;
+            uint32_t numFrames;
+            uintptr_t caller;               // The allocator's native caller, or 0
+            uintptr_t frames[kMaxFrames];   // MethodInfo*, innermost first
+            uint64_t samples;               // Number of samples taken at the site
+            double allocObjects;            // Estimated number of objects allocated
+            double allocBytes;              // Estimated number of bytes allocated
+            double liveObjects;             // Estimated number of allocated objects still live
+            double liveBytes;               // Estimated number of allocated bytes still live
+        };
+
+        struct SampledObject
+        {
+            Site* site;
+            uint32_t size;
+            double weight;                  // Number of objects the sample stands for
+        };
+
+        typedef GCHashtableBase<SampledObject*, GCHashtableKeyHandler, GCHashtableAllocHandler_new> SampleTable;
+
+        // @return the site for the stack in 'frames' and 'caller', creating it if necessary.
+        Site* FindSite(uintptr_t caller, const uintptr_t* frames, uint32_t numFrames);
+
+        // @return true if the sampled object 'userptr' has not been freed, and if
+        // 'marksAreFinal' is true, is marked.
+        bool IsLive(const void* userptr, bool marksAreFinal);
+
+        // Remove the sample of 'userptr' from the live totals and the sample table.
+        void Retire(const void* userptr, SampledObject* s);
+
+        // Print one line of the profile, for site 's'.
+        void DumpSite(Site* s, void (*write)(void*, const char*), void* arg);
+
+        GC* const gc;
+        const double meanInterval;
+        uint64_t rng;                       // xorshift64 state
+        Site** sites;                       // Open-addressed by hash, kSiteTableSize entries
+        uint32_t numSites;
+        Site overflow;                      // The catch-all site
+        SampleTable samples;                // Live samples, by object address
+        uint64_t numSamples;                // Samples taken to date
+    };
+}
+
+#endif /* __GCAllocationSampler__ */
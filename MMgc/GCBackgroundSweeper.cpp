@@ -0,0 +1,238 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MMgc.h"
+
+namespace MMgc
+{
+    GCBackgroundSweeper::GCBackgroundSweeper(GC* gc)
+        : m_gc(gc)
+        , m_thread(NULL)
+        , m_threadFailed(false)
+        , m_blocks(NULL)
+        , m_state(NULL)
+        , m_capacity(0)
+        , m_count(0)
+        , m_busy(false)
+        , m_shutdown(false)
+        , m_sweeps(0)
+        , m_blocksQueued(0)
+        , m_blocksClaimed(0)
+        , m_blocksWaited(0)
+        , m_blocksSwept(0)
+        , m_itemsSwept(0)
+        , m_sweepTicks(0)
+    {
+    }
+
+    GCBackgroundSweeper::~GCBackgroundSweeper()
+    {
+        SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+            m_shutdown = true;
+            locker.notifyAll();
+        }
+        if (m_thread != NULL) {
+            m_thread->join();
+            mmfx_delete(m_thread);
+        }
+#ifdef DEBUG
+        for ( uint32_t i=0 ; i < m_count ; i++ )
+            GCAssert(m_state[i] != kQueued);
+#endif
+        if (m_blocks != NULL) {
+            mmfx_delete_array(m_blocks);
+            mmfx_delete_array((int32_t*)m_state);
+        }
+    }
+
+    void GCBackgroundSweeper::Start()
+    {
+        GCAssert(m_gc->onThread());
+
+        if (m_threadFailed)
+            return;
+
+        // The free hook of GCDEBUG builds only poisons the object, but the telemetry
+        // sampler's is not thread safe.
+#if defined(VMCFG_TELEMETRY_SAMPLER) && defined(DEBUGGER)
+        if (m_gc->heap->HooksEnabled())
+            return;
+#endif
+
+        if (m_thread == NULL) {
+            m_thread = mmfx_new(vmbase::VMThread("GCBackgroundSweeper", this));
+            if (!m_thread->start()) {
+                mmfx_delete(m_thread);
+                m_thread = NULL;
+                m_threadFailed = true;
+                return;
+            }
+        }
+
+        // Every block in the previous queue has been claimed by now (see the
+        // comment in the header), but the thread may not yet have run off the end.
+
+        SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+            while (m_busy)
+                locker.wait();
+        }
+
+        uint32_t count = 0;
+        for (int i=0; i < GC::kNumSizeClasses; i++) {
+            for (int j=0; j < kNumGCPartitions; j++) {
+                count += CountBlocks(m_gc->containsPointersNonfinalizedAllocs[i][j]);
+                count += CountBlocks(m_gc->noPointersNonfinalizedAllocs[i][j]);
+            }
+        }
+        count += CountBlocks(m_gc->bibopAllocFloat);
+        count += CountBlocks(m_gc->bibopAllocFloat4);
+
+        m_count = 0;
+        if (count == 0 || !EnsureCapacity(count))
+            return;
+
+        for (int i=0; i < GC::kNumSizeClasses; i++) {
+            for (int j=0; j < kNumGCPartitions; j++) {
+                QueueBlocks(m_gc->containsPointersNonfinalizedAllocs[i][j]);
+                QueueBlocks(m_gc->noPointersNonfinalizedAllocs[i][j]);
+            }
+        }
+        QueueBlocks(m_gc->bibopAllocFloat);
+        QueueBlocks(m_gc->bibopAllocFloat4);
+        GCAssert(m_count == count);
+
+        m_sweeps++;
+        m_blocksQueued += m_count;
+
+        // Taking the monitor publishes the queue to the thread.
+        SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+            m_busy = true;
+            locker.notifyAll();
+        }
+    }
+
+    uint32_t GCBackgroundSweeper::CountBlocks(GCAlloc* alloc)
+    {
+        uint32_t count = 0;
+        for ( GCAlloc::GCBlock* b = alloc->m_needsSweeping ; b != NULL ; b = b->nextFree )
+            count++;
+        return count;
+    }
+
+    void GCBackgroundSweeper::QueueBlocks(GCAlloc* alloc)
+    {
+        for ( GCAlloc::GCBlock* b = alloc->m_needsSweeping ; b != NULL ; b = b->nextFree ) {
+            GCAssert(b->sweepIndex < 0);
+            b->sweepIndex = int32_t(m_count);
+            m_blocks[m_count] = b;
+            m_state[m_count] = kQueued;
+            m_count++;
+        }
+    }
+
+    bool GCBackgroundSweeper::EnsureCapacity(uint32_t count)
+    {
+        if (count <= m_capacity)
+            return true;
+
+        // Grow geometrically so that a growing heap does not reallocate on every sweep.
+        uint32_t capacity = m_capacity < 256 ? 256 : m_capacity;
+        while (capacity < count)
+            capacity *= 2;
+
+        GCAlloc::GCBlock** blocks = mmfx_new_array_opt(GCAlloc::GCBlock*, capacity, kCanFail);
+        int32_t* state = mmfx_new_array_opt(int32_t, capacity, kCanFail);
+        if (blocks == NULL || state == NULL) {
+            if (blocks != NULL)
+                mmfx_delete_array(blocks);
+            if (state != NULL)
+                mmfx_delete_array(state);
+            return false;
+        }
+
+        if (m_blocks != NULL) {
+            mmfx_delete_array(m_blocks);
+            mmfx_delete_array((int32_t*)m_state);
+        }
+        m_blocks = blocks;
+        m_state = state;
+        m_capacity = capacity;
+        return true;
+    }
+
+    int32_t GCBackgroundSweeper::Claim(GCAlloc::GCBlock* b)
+    {
+        GCAssert(m_gc->onThread());
+
+        int32_t index = b->sweepIndex;
+        GCAssert(index >= 0 && uint32_t(index) < m_count && m_blocks[index] == b);
+        b->sweepIndex = -1;
+
+        if (VMPI_compareAndSwap32WithBarrier(kQueued, kClaimed, &m_state[index])) {
+            m_blocksClaimed++;
+            return -1;
+        }
+
+        if (m_state[index] == kSweeping) {
+            m_blocksWaited++;
+            while (m_state[index] == kSweeping)
+                VMPI_spinloopPause();
+        }
+
+        // Pairs with the barrier in run(), so that the sweeper's updates to the
+        // block are visible here.
+        VMPI_memoryBarrier();
+        GCAssert(m_state[index] >= kSwept);
+        return m_state[index] - kSwept;
+    }
+
+    void GCBackgroundSweeper::run()
+    {
+        for (;;) {
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                while (!m_shutdown && !m_busy)
+                    locker.wait();
+                if (m_shutdown)
+                    return;
+            }
+
+            uint64_t start = VMPI_getPerformanceCounter();
+            for ( uint32_t i=0 ; i < m_count ; i++ ) {
+                if (!VMPI_compareAndSwap32WithBarrier(kQueued, kSweeping, &m_state[i]))
+                    continue;
+
+                GCAlloc::GCBlock* b = m_blocks[i];
+                GCAlloc* alloc = (GCAlloc*)b->alloc;
+                int32_t oldNumFree = b->numFree;
+                alloc->SweepGuts(b);
+                int32_t numSwept = b->numFree - oldNumFree;
+                m_blocksSwept++;
+                m_itemsSwept += numSwept;
+
+                VMPI_memoryBarrier();
+                m_state[i] = kSwept + numSwept;
+            }
+            m_sweepTicks += VMPI_getPerformanceCounter() - start;
+
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                m_busy = false;
+                locker.notifyAll();
+            }
+        }
+    }
+
+    void GCBackgroundSweeper::DumpStats()
+    {
+        GCLog("[mem] \tbackground sweep: %u sweeps, %llu blocks queued, %llu swept in background (%llu objects in %u ms), %llu swept on demand, %llu waits\n",
+              m_sweeps,
+              (unsigned long long)m_blocksQueued,
+              (unsigned long long)m_blocksSwept,
+              (unsigned long long)m_itemsSwept,
+              uint32_t(GC::ticksToMillis(m_sweepTicks)),
+              (unsigned long long)m_blocksClaimed,
+              (unsigned long long)m_blocksWaited);
+    }
+}
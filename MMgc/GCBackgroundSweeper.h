@@ -0,0 +1,140 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCBackgroundSweeper__
+#define __GCBackgroundSweeper__
+
+#ifdef VMCFG_SELFTEST
+namespace avmplus
+{
+    namespace ST_mmgc_bgsweep { class ST_mmgc_bgsweep; }
+}
+#endif
+
+namespace MMgc
+{
+    /**
+     * Background sweeping of small-object blocks.
+     *
+     * After finalization GCAlloc leaves blocks that hold both live and dead objects
+     * on its sweep list (m_needsSweeping), and sweeps them lazily: when AllocSlow
+     * needs a block, when an object in the block is freed explicitly, or when the
+     * next collection starts.  A GCBackgroundSweeper owns one thread that sweeps
+     * those blocks ahead of the mutator, so that the mutator mostly finds them swept.
+     *
+     * At the end of GC::Sweep the blocks on the sweep lists of the non-finalized
+     * allocators are queued, and the thread is woken.  Finalized allocators are not
+     * involved: their blocks are visited by GCAlloc::FinalizationPass on the GC's
+     * thread, and finalizers and the reference counter may touch the bits of their
+     * objects at any time.
+     *
+     * A queued block stays on its allocator's sweep list, and the allocator remains
+     * responsible for it.  Whichever thread claims the block first sweeps it; the
+     * claim is a compare-and-swap on a per-block state word held by the sweeper, so
+     * the sweeper never dereferences a block that it has not claimed.  The sweeper
+     * only runs GCAlloc::SweepGuts, which touches nothing but the block's bits, its
+     * dead objects, and its free list; all list management and accounting stays on
+     * the GC's thread.  Before the GC's thread touches a queued block (GCAlloc::Sweep,
+     * GCAlloc::Free, GC::SetHasWeakRef) it calls Claim(), which either takes the
+     * block back or waits for the sweeper to finish with it.  A block the sweeper
+     * has swept is then moved off the sweep list, so that it is not swept again.
+     *
+     * Every queued block is claimed by GC::SweepNeedsSweeping at the start of the
+     * next collection at the latest, so the sweeper is quiescent while the GC marks.
+     *
+     * No blocks are queued while the telemetry sampler's hooks are enabled, since
+     * they are not thread safe.
+     */
+    class GCBackgroundSweeper : public vmbase::Runnable
+    {
+#ifdef VMCFG_SELFTEST
+        friend class avmplus::ST_mmgc_bgsweep::ST_mmgc_bgsweep;
+#endif
+    public:
+        GCBackgroundSweeper(GC* gc);
+
+        /**
+         * Stop and join the thread.  Every queued block must have been claimed.
+         */
+        virtual ~GCBackgroundSweeper();
+
+        /**
+         * Queue the blocks on the sweep lists of the GC's non-finalized allocators
+         * and wake the thread.  Called on the GC's thread at the end of GC::Sweep.
+         * Nothing is queued if the thread can't be started or the queue can't be
+         * allocated; the blocks are then swept lazily as usual.
+         */
+        void Start();
+
+        /**
+         * Take the queued block 'b' back from the sweeper, waiting for the sweeper
+         * if it is sweeping the block.
+         *
+         * @return -1 if the caller must sweep the block itself, otherwise the number
+         * of objects freed in the block by the sweeper.
+         */
+        int32_t Claim(GCAlloc::GCBlock* b);
+
+        /**
+         * Print statistics for all sweeps to date, for -memstats.
+         */
+        void DumpStats();
+
+        // Entry point of the thread.
+        virtual void run();
+
+    private:
+        // Per-block states in m_state.  A value at or above kSwept is kSwept plus the
+        // number of objects freed by the sweeper.
+        enum {
+            kQueued = 0,
+            kClaimed = 1,
+            kSweeping = 2,
+            kSwept = 3
+        };
+
+        // Return the number of blocks on alloc's sweep list.
+        uint32_t CountBlocks(GCAlloc* alloc);
+
+        // Add the blocks on alloc's sweep list to the queue.
+        void QueueBlocks(GCAlloc* alloc);
+
+        // Make room for 'count' blocks in the queue.
+        bool EnsureCapacity(uint32_t count);
+
+        GC* const m_gc;
+        vmbase::VMThread* m_thread;     // NULL until the first Start()
+        bool m_threadFailed;            // Set if the thread could not be started
+
+        // The queue, rebuilt by Start().  m_blocks is written only by Start();
+        // m_state is updated with compare-and-swap by both threads.
+        GCAlloc::GCBlock** m_blocks;
+        volatile int32_t* m_state;
+        uint32_t m_capacity;
+        uint32_t m_count;
+
+        // Thread control, protected by m_monitor.
+        vmbase::WaitNotifyMonitor m_monitor;
+        bool m_busy;                    // Set by Start(), cleared when the thread is done with the queue
+        bool m_shutdown;                // Set to make the thread exit
+
+        // Statistics for all sweeps to date.  m_blocksSwept, m_itemsSwept, and
+        // m_sweepTicks are updated by the thread, the others by the GC's thread.
+        uint32_t m_sweeps;
+        uint64_t m_blocksQueued;
+        uint64_t m_blocksClaimed;       // Queued blocks the GC's thread swept itself
+        uint64_t m_blocksWaited;        // Claims that had to wait for the thread
+        uint64_t m_blocksSwept;
+        uint64_t m_itemsSwept;
+        uint64_t m_sweepTicks;
+
+    private: // not implemented
+        GCBackgroundSweeper(const GCBackgroundSweeper&);
+        GCBackgroundSweeper& operator=(const GCBackgroundSweeper&);
+    };
+}
+
+#endif /* __GCBackgroundSweeper__ */
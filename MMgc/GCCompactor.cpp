@@ -0,0 +1,274 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MMgc.h"
+#include "avmplus.h"
+
+namespace MMgc
+{
+    GCCompactor::GCCompactor(GC* gc)
+        : m_gc(gc)
+        , m_compactions(0)
+        , m_objectsMoved(0)
+        , m_bytesMoved(0)
+        , m_blocksEvacuated(0)
+        , m_blocksCreated(0)
+        , m_fixupTicks(0)
+    {
+    }
+
+    void GCCompactor::Compact()
+    {
+        GCAssert(m_gc->collecting && !m_gc->generational);
+        GCAssert(m_gc->m_incrementalWork.Count() == 0);
+
+        // The memory profiler and the samplers keep track of objects by address.
+        // The debug decorations of GCDEBUG builds are copied with the objects.
+#ifdef MMGC_MEMORY_PROFILER
+        if (m_gc->heap->GetProfiler() != NULL)
+            return;
+#endif
+#if defined(AVMPLUS_SAMPLER) || (defined(VMCFG_TELEMETRY_SAMPLER) && defined(DEBUGGER))
+        if (m_gc->heap->HooksEnabled())
+            return;
+#endif
+
+        // Count first, so that nothing is disturbed if there are too few candidates.
+
+        uint32_t numCandidates = 0;
+        for (int i=0; i < GC::kNumSizeClasses; i++) {
+            for (int j=0; j < kNumGCPartitions; j++) {
+                GCAlloc* alloc = m_gc->containsPointersNonfinalizedAllocs[i][j];
+                for (GCAlloc::GCBlock* b = alloc->m_firstBlock; b != NULL; b = GCAlloc::Next(b)) {
+                    if (IsCandidate(alloc, b))
+                        numCandidates++;
+                }
+            }
+        }
+        if (numCandidates < kMinCandidates)
+            return;
+
+        // Flag the candidates of all the allocators before moving anything, so that
+        // no object is moved into a block that is being emptied.
+
+        for (int i=0; i < GC::kNumSizeClasses; i++)
+            for (int j=0; j < kNumGCPartitions; j++)
+                SelectCandidates(m_gc->containsPointersNonfinalizedAllocs[i][j]);
+
+        // If allocation fails the remaining objects stay where they are, but the
+        // references to the objects already moved must still be updated.
+
+        bool ok = true;
+        for (int i=0; ok && i < GC::kNumSizeClasses; i++)
+            for (int j=0; ok && j < kNumGCPartitions; j++)
+                ok = Evacuate(m_gc->containsPointersNonfinalizedAllocs[i][j]);
+
+        FixupReferences();
+
+        for (int i=0; i < GC::kNumSizeClasses; i++)
+            for (int j=0; j < kNumGCPartitions; j++)
+                m_blocksEvacuated += FinishEvacuation(m_gc->containsPointersNonfinalizedAllocs[i][j]);
+
+        m_compactions++;
+    }
+
+    bool GCCompactor::IsCandidate(GCAlloc* alloc, GCAlloc::GCBlock* b)
+    {
+        if (b->needsSweeping() || b->sweepIndex >= 0)
+            return false;
+
+        uint32_t numLive = 0;
+        for ( char *item = b->items, *limit = b->items + alloc->m_itemSize * b->GetCount() ; item < limit ; item += alloc->m_itemSize )
+        {
+            gcbits_t bits = b->bits[GCAlloc::GetBitsIndex(b, item)];
+            int mq = bits & GCAlloc::kFreelist;
+            if (mq == 0 || mq == GCAlloc::kFreelist)
+                continue;
+            if (mq != kMark || (bits & (kMovable|kPinned|kHasWeakRef|kSampled)) != kMovable)
+                return false;
+            numLive++;
+        }
+        return numLive > 0 && numLive * kMaxOccupancy <= uint32_t(alloc->m_itemsPerBlock);
+    }
+
+    uint32_t GCCompactor::SelectCandidates(GCAlloc* alloc)
+    {
+        uint32_t n = 0;
+        for (GCAlloc::GCBlock* b = alloc->m_firstBlock; b != NULL; b = GCAlloc::Next(b)) {
+            if (!IsCandidate(alloc, b))
+                continue;
+            b->slowFlags |= GCAlloc::kFlagEvacuated;
+            if (b->nextFree || b->prevFree || b == alloc->m_firstFree)
+                alloc->RemoveFromFreeList(b);
+            n++;
+        }
+        return n;
+    }
+
+    bool GCCompactor::Evacuate(GCAlloc* alloc)
+    {
+        const uint32_t itemSize = alloc->m_itemSize;
+
+        // Blocks created by AllocForMove are linked at the end and are not flagged.
+        for (GCAlloc::GCBlock* b = alloc->m_firstBlock; b != NULL; b = GCAlloc::Next(b)) {
+            if (!(b->slowFlags & GCAlloc::kFlagEvacuated))
+                continue;
+
+            for ( char *item = b->items, *limit = b->items + itemSize * b->GetCount() ; item < limit ; item += itemSize )
+            {
+                gcbits_t& bits = b->bits[GCAlloc::GetBitsIndex(b, item)];
+                if ((bits & GCAlloc::kFreelist) != kMark)
+                    continue;
+
+                if (alloc->m_firstFree == NULL)
+                    m_blocksCreated++;
+                void* copy = alloc->AllocForMove();
+                if (copy == NULL)
+                    return false;
+
+                VMPI_memcpy(copy, item, itemSize);
+                GCAlloc::GCBlock* cb = GCAlloc::GetBlock(copy);
+                cb->bits[GCAlloc::GetBitsIndex(cb, copy)] = bits;
+                bits &= ~kMark;
+                *(void**)GetUserPointer(item) = GetUserPointer(copy);
+
+                m_objectsMoved++;
+                m_bytesMoved += itemSize;
+            }
+        }
+        return true;
+    }
+
+    void GCCompactor::FixupReferences()
+    {
+        uint64_t start = VMPI_getPerformanceCounter();
+
+        m_gc->m_edgeVisitor = this;
+
+        void* ptr;
+        for (int i=0; i < GC::kNumSizeClasses; i++) {
+            for (int j=0; j < kNumGCPartitions; j++) {
+                GCAllocIterator iter1(m_gc->containsPointersRCAllocs[i][j]);
+                while (iter1.GetNextMarkedObject(ptr))
+                    FixupObject(ptr);
+                GCAllocIterator iter2(m_gc->containsPointersNonfinalizedAllocs[i][j]);
+                while (iter2.GetNextMarkedObject(ptr))
+                    FixupObject(ptr);
+                GCAllocIterator iter3(m_gc->containsPointersFinalizedAllocs[i][j]);
+                while (iter3.GetNextMarkedObject(ptr))
+                    FixupObject(ptr);
+            }
+        }
+        for (int j=0; j < kNumGCPartitions; j++) {
+            GCLargeAllocIterator iter(m_gc->largeAllocs[j]);
+            while (iter.GetNextMarkedObject(ptr))
+                FixupObject(ptr);
+        }
+
+        {
+            MMGC_LOCK(m_gc->m_rootListLock);
+            for (GCRoot* r = m_gc->m_roots; r != NULL; r = r->next) {
+                if (r->IsExactlyTraced())
+                    r->gcTrace(m_gc, 0);
+            }
+        }
+
+        m_gc->m_edgeVisitor = NULL;
+
+        m_fixupTicks += VMPI_getPerformanceCounter() - start;
+    }
+
+    void GCCompactor::FixupObject(const void* userptr)
+    {
+        if (!(GC::GetGCBits(GetRealPointer(userptr)) & kVirtualGCTrace))
+            return;
+
+        GCTraceableBase* obj = (GCTraceableBase*)userptr;
+        for ( size_t cursor=0 ; obj->gcTrace(m_gc, cursor) ; cursor++ )
+            ;
+    }
+
+    void GCCompactor::VisitLocation(uintptr_t* loc)
+    {
+        uintptr_t val = *loc;
+        uintptr_t userptr = val & ~uintptr_t(7);
+
+        if (userptr < m_gc->pageMap.MemStart() || userptr >= m_gc->pageMap.MemEnd())
+            return;
+        if (m_gc->GetPageMapValue(userptr) != PageMap::kGCAllocPage)
+            return;
+        if (!(GCAlloc::GetBlock((const void*)userptr)->slowFlags & GCAlloc::kFlagEvacuated))
+            return;
+
+        // A live field only references live objects, so an unmarked movable object
+        // in an evacuated block is an original whose first word holds its copy.
+        gcbits_t bits = GC::GetGCBits(GetRealPointer((const void*)userptr));
+        if ((bits & (kMark|kQueued|kMovable)) != kMovable)
+            return;
+
+        *loc = *(uintptr_t*)userptr | (val & 7);
+    }
+
+    void GCCompactor::VisitAtom(avmplus::Atom* loc)
+    {
+        // The pointer-valued atoms, see GC::TraceAtomValue.
+        switch (*loc & 7)
+        {
+            case avmplus::AtomConstants::kObjectType:
+            case avmplus::AtomConstants::kStringType:
+            case avmplus::AtomConstants::kNamespaceType:
+            case avmplus::AtomConstants::kSpecialBibopType:
+            case avmplus::AtomConstants::kDoubleType:
+                VisitLocation((uintptr_t*)loc);
+                break;
+        }
+    }
+
+    void GCCompactor::VisitConservativeLocation(uintptr_t*)
+    {
+    }
+
+    uint32_t GCCompactor::FinishEvacuation(GCAlloc* alloc)
+    {
+        const uint32_t itemSize = alloc->m_itemSize;
+        uint32_t n = 0;
+
+        for (GCAlloc::GCBlock* b = alloc->m_firstBlock; b != NULL; b = GCAlloc::Next(b)) {
+            if (!(b->slowFlags & GCAlloc::kFlagEvacuated))
+                continue;
+            b->slowFlags &= ~GCAlloc::kFlagEvacuated;
+
+            bool empty = true;
+            for ( char *item = b->items, *limit = b->items + itemSize * b->GetCount() ; item < limit ; item += itemSize ) {
+                if ((b->bits[GCAlloc::GetBitsIndex(b, item)] & GCAlloc::kFreelist) == kMark) {
+                    empty = false;
+                    break;
+                }
+            }
+            if (empty)
+                n++;
+        }
+        return n;
+    }
+
+    uint64_t GCCompactor::GetBytesReclaimed()
+    {
+        if (m_blocksEvacuated <= m_blocksCreated)
+            return 0;
+        return (m_blocksEvacuated - m_blocksCreated) * GCHeap::kBlockSize;
+    }
+
+    void GCCompactor::DumpStats()
+    {
+        GCLog("[mem] \tcompaction: %u compactions, %llu objects moved (%llu KB), %llu blocks evacuated, %llu blocks created, %u ms updating references\n",
+              m_compactions,
+              (unsigned long long)m_objectsMoved,
+              (unsigned long long)(m_bytesMoved >> 10),
+              (unsigned long long)m_blocksEvacuated,
+              (unsigned long long)m_blocksCreated,
+              uint32_t(GC::ticksToMillis(m_fixupTicks)));
+    }
+}
@@ -0,0 +1,142 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCCompactor__
+#define __GCCompactor__
+
+namespace MMgc
+{
+    /**
+     * Evacuation of sparsely occupied small-object blocks (GCConfig::compaction).
+     *
+     * A block that holds a single live object can't be returned to the heap, so
+     * after a phase change a program can be left with many nearly empty blocks and
+     * a heap that is much larger than its live data.  The compactor empties such
+     * blocks by moving their live objects into other blocks.
+     *
+     * Moving an object means updating every reference to it, which the GC can only
+     * do for exactly traced fields, and nothing may depend on the object's address.
+     * Therefore only objects that opt in are moved: objects allocated with
+     * kMovableObject (see GCTraceableObject), which are exactly traced, not
+     * finalized, not reference counted, and no larger than GC::kLargestAlloc, and
+     * which live in the containsPointersNonfinalizedAllocs.  In the VM these are
+     * the buffers of the traced lists (avmplus::TracedListData), which back arrays,
+     * object vectors and most of the VM's own lists, and which are referenced only
+     * from their list headers and from the stack.  A movable object is
+     * pinned (kPinned) when the conservative marker reaches it -- from the stack, a
+     * conservative root, a conservatively traced object or field -- and is not moved
+     * in that collection.  Objects with weak references are not moved either, nor
+     * are objects sampled by the allocation sampler (kSampled).
+     *
+     * Compact() runs in GC::Sweep after the presweep callbacks, when the mark bits
+     * are final:
+     *
+     *  - A block is a candidate if no more than 1/kMaxOccupancy of it is live and
+     *    every live object in it can be moved, so that moving them empties it.
+     *    Nothing happens unless there are at least kMinCandidates candidates, since
+     *    updating the references visits the entire heap.
+     *
+     *  - The live objects in candidate blocks are copied into free items of other
+     *    blocks of the same allocator (creating blocks if necessary).  A copy takes
+     *    over the bits of the original, which is left unmarked with the address of
+     *    the copy in its first word.
+     *
+     *  - The tracers of all marked exactly traced objects and of the exactly traced
+     *    roots are run with the compactor installed as GC::m_edgeVisitor.  The
+     *    TraceLocation family then calls VisitLocation and VisitAtom, which redirect
+     *    references to originals to their copies, instead of marking.
+     *
+     * The candidate blocks now hold no marked objects.  GCAlloc::LazySweepPass finds
+     * them empty, GC::Sweep frees them, and GCHeap::Decommit releases the memory.
+     *
+     * The compactor does nothing in a collection that did not scan the native stack,
+     * since the stack may then hold references that have not pinned anything, nor
+     * while the memory profiler or a sampler is tracking allocations, since they
+     * keep track of objects by address.  The debug decorations of GCDEBUG builds
+     * are part of the item and are copied with it.
+     */
+    class GCCompactor : public GCEdgeVisitor
+    {
+    public:
+        // A block is a candidate if at most 1/kMaxOccupancy of its items are live.
+        static const uint32_t kMaxOccupancy = 4;
+
+        // The least number of candidate blocks that makes compaction worthwhile.
+        static const uint32_t kMinCandidates = 8;
+
+        GCCompactor(GC* gc);
+
+        /**
+         * Move the objects out of the candidate blocks and update the references to
+         * them.  Called on the GC's thread by GC::Sweep.
+         */
+        void Compact();
+
+        /**
+         * Update the pointer in '*loc', which may be tagged in its low three bits,
+         * if it references an object that has been moved.
+         */
+        virtual void VisitLocation(uintptr_t* loc);
+
+        /**
+         * Update the atom in '*loc' if it references an object that has been moved.
+         */
+        virtual void VisitAtom(avmplus::Atom* loc);
+
+        /**
+         * Objects referenced from conservatively traced fields are pinned, so there
+         * is nothing to update.
+         */
+        virtual void VisitConservativeLocation(uintptr_t* loc);
+
+        /**
+         * @return the number of bytes in blocks emptied by compaction to date, less
+         * the bytes in blocks created to hold the moved objects.
+         */
+        uint64_t GetBytesReclaimed();
+
+        /**
+         * Print statistics for all compactions to date, for -memstats.
+         */
+        void DumpStats();
+
+    private:
+        // Return true if 'b' is a candidate block.
+        bool IsCandidate(GCAlloc* alloc, GCAlloc::GCBlock* b);
+
+        // Flag the candidate blocks of 'alloc' and take them off its free list,
+        // returning their number.
+        uint32_t SelectCandidates(GCAlloc* alloc);
+
+        // Move the live objects out of the flagged blocks of 'alloc'.  Returns
+        // false if allocation failed; the objects not yet moved then stay put.
+        bool Evacuate(GCAlloc* alloc);
+
+        // Run the tracer of every marked exactly traced object and exact root in
+        // fixup mode.
+        void FixupReferences();
+
+        // Run the tracer of the object at 'userptr' in fixup mode if it is exactly
+        // traced.
+        void FixupObject(const void* userptr);
+
+        // Clear kFlagEvacuated on the blocks of 'alloc', counting the blocks that
+        // are now free of live objects.
+        uint32_t FinishEvacuation(GCAlloc* alloc);
+
+        GC* const m_gc;
+
+        // Statistics for -memstats and GCHeap::DumpMemoryInfo.
+        uint32_t m_compactions;         // Collections in which objects were moved
+        uint64_t m_objectsMoved;
+        uint64_t m_bytesMoved;
+        uint64_t m_blocksEvacuated;     // Blocks emptied by moving their objects
+        uint64_t m_blocksCreated;       // Blocks created to hold the moved objects
+        uint64_t m_fixupTicks;          // Time spent updating references
+    };
+}
+
+#endif /* __GCCompactor__ */
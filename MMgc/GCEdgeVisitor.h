@@ -0,0 +1,40 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCEdgeVisitor__
+#define __GCEdgeVisitor__
+
+namespace MMgc
+{
+    /**
+     * GCEdgeVisitor is an interface for walking the references of exactly traced
+     * objects and roots.  While a visitor is installed in GC::m_edgeVisitor the
+     * TraceLocation family hands every traced field to the visitor instead of
+     * marking what it references.  See GCCompactor and HeapSnapshotWriter.
+     */
+    class GCEdgeVisitor
+    {
+    public:
+        virtual ~GCEdgeVisitor() {}
+
+        /**
+         * Visit the pointer in '*loc', which may be tagged in its low three bits.
+         */
+        virtual void VisitLocation(uintptr_t* loc) = 0;
+
+        /**
+         * Visit the atom in '*loc', which may or may not reference an object.
+         */
+        virtual void VisitAtom(avmplus::Atom* loc) = 0;
+
+        /**
+         * Visit the conservatively traced word in '*loc'.
+         */
+        virtual void VisitConservativeLocation(uintptr_t* loc) = 0;
+    };
+}
+
+#endif /* __GCEdgeVisitor__ */
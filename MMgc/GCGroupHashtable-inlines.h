@@ -0,0 +1,302 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCGroupHashtable_inlines_
+#define __GCGroupHashtable_inlines_
+
+namespace MMgc
+{
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::GCGroupHashtableBase(uint32_t initialCapacity)
+        : entries(NULL)
+        , ctrl(NULL)
+        , capacity(0)
+        , shift(32)
+        , numValues(0)
+#ifdef GCDEBUG
+        , numIterators(0)
+#endif
+#ifdef MMGC_GCHASHTABLE_PROFILER
+        , probes(0)
+        , accesses(0)
+#endif
+    {
+        if (initialCapacity > 0)
+        {
+            uint32_t n = kGroupSize;
+            while (n < initialCapacity)
+                n <<= 1;
+            resize(n, false);
+        }
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::~GCGroupHashtableBase()
+    {
+        clear();
+#ifdef GCDEBUG
+        numIterators = 0;
+#endif
+#ifdef MMGC_GCHASHTABLE_PROFILER
+        probes = 0;
+        accesses = 0;
+#endif
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    void GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::clear()
+    {
+        if (entries)
+            ALLOCHANDLER::free(entries);
+        entries = NULL;
+        ctrl = NULL;
+        capacity = 0;
+        shift = 32;
+        numValues = 0;
+    }
+
+#ifdef MMGC_SIMD_HASHTABLE_PROBE
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    REALLY_INLINE /*static*/ uint32_t GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::matchByte(const uint8_t* group, uint8_t b)
+    {
+        __m128i g = _mm_loadu_si128((const __m128i*)group);
+        return uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(char(b)))));
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    REALLY_INLINE /*static*/ uint32_t GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::matchEmpty(const uint8_t* group)
+    {
+        // kEmpty is the only control byte with the high bit set.
+        return uint32_t(_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)group)));
+    }
+#else
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    REALLY_INLINE /*static*/ uint32_t GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::matchByte(const uint8_t* group, uint8_t b)
+    {
+        uint32_t bits = 0;
+        for (uint32_t i=0; i < kGroupSize; i++)
+            bits |= uint32_t(group[i] == b) << i;
+        return bits;
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    REALLY_INLINE /*static*/ uint32_t GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::matchEmpty(const uint8_t* group)
+    {
+        return matchByte(group, kEmpty);
+    }
+#endif
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    REALLY_INLINE /*static*/ uint32_t GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::lowestBit(uint32_t bits)
+    {
+        GCAssert(bits != 0);
+#ifdef __GNUC__
+        return uint32_t(__builtin_ctz(bits));
+#else
+        uint32_t i = 0;
+        while ((bits & 1) == 0) {
+            bits >>= 1;
+            i++;
+        }
+        return i;
+#endif
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    REALLY_INLINE void GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::setControl(uint32_t i, uint8_t c)
+    {
+        ctrl[i] = c;
+        if (i < kGroupSize)
+            ctrl[capacity + i] = c;
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    uint32_t GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::find(const void* key)
+    {
+#ifdef MMGC_GCHASHTABLE_PROFILER
+        accesses++;
+#endif
+        if (capacity == 0)
+            return kNotFound;
+
+        uint32_t const bitMask = capacity - 1;
+        uint32_t const hash = hashOf(key);
+        uint8_t const tag = uint8_t(hash & 0x7f);
+        uint32_t pos = homeOf(hash);
+        for (;;)
+        {
+#ifdef MMGC_GCHASHTABLE_PROFILER
+            probes++;
+#endif
+            const uint8_t* group = ctrl + pos;
+            for (uint32_t bits = matchByte(group, tag); bits != 0; bits &= bits - 1)
+            {
+                uint32_t i = (pos + lowestBit(bits)) & bitMask;
+                if (KEYHANDLER::equal(entries[i].key, key))
+                    return i;
+            }
+            // A key is never stored past an empty slot of its probe sequence.
+            if (matchEmpty(group) != 0)
+                return kNotFound;
+            pos = (pos + kGroupSize) & bitMask;
+        }
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    uint32_t GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::findEmpty(uint32_t hash)
+    {
+        uint32_t const bitMask = capacity - 1;
+        uint32_t pos = homeOf(hash);
+        for (;;)
+        {
+            uint32_t bits = matchEmpty(ctrl + pos);
+            if (bits != 0)
+                return (pos + lowestBit(bits)) & bitMask;
+            pos = (pos + kGroupSize) & bitMask;
+        }
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    void GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::put(const void* key, VAL value)
+    {
+        // Bug 637993: see GCHashtableBase::put.
+        GCAssert(numIterators == 0);
+
+        uint32_t i = find(key);
+        if (i != kNotFound)
+        {
+            entries[i].value = value;
+            return;
+        }
+
+        // .75 load factor: the table is never full, so every probe sequence ends.
+        if ((numValues + 1) * 4 > capacity * 3)
+            resize(capacity == 0 ? kDefaultSize : capacity * 2, false);
+
+        uint32_t const hash = hashOf(key);
+        i = findEmpty(hash);
+        setControl(i, uint8_t(hash & 0x7f));
+        entries[i].key = key;
+        entries[i].value = value;
+        numValues++;
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    VAL GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::remove(const void* key, bool allowRehash)
+    {
+        // Bug 637993: allowRehash implies no active iterators.
+        GCAssert(!allowRehash || (numIterators == 0));
+
+        uint32_t i = find(key);
+        if (i == kNotFound)
+            return VAL(0);
+        VAL ret = entries[i].value;
+
+        // Backward-shift deletion: move each following entry of the cluster that
+        // may occupy slot i, that is whose first slot is not in (i,j], back to i,
+        // until the cluster ends.  Then every key is still reachable from its first
+        // slot without passing an empty slot.
+        uint32_t const bitMask = capacity - 1;
+        for (uint32_t j = (i + 1) & bitMask; ctrl[j] != kEmpty; j = (j + 1) & bitMask)
+        {
+            uint32_t home = homeOf(hashOf(entries[j].key));
+            if (((j - home) & bitMask) >= ((j - i) & bitMask))
+            {
+                setControl(i, ctrl[j]);
+                entries[i] = entries[j];
+                i = j;
+            }
+        }
+        setControl(i, kEmpty);
+        entries[i].key = NULL;
+        entries[i].value = VAL(0);
+        numValues--;
+
+        if (allowRehash)
+            prune();
+        return ret;
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    void GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::prune()
+    {
+        GCAssert(numIterators == 0);
+
+        // Shrink below 20% full, as GCHashtableBase does.
+        if (numValues * 5 < capacity && capacity > kDefaultSize)
+        {
+            uint32_t newCapacity = capacity;
+            while (numValues * 5 < newCapacity && newCapacity > kDefaultSize)
+                newCapacity >>= 1;
+            resize(newCapacity, true);
+        }
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    bool GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::resize(uint32_t newCapacity, bool isRemoval)
+    {
+        GCAssert(newCapacity >= kGroupSize && (newCapacity & (newCapacity - 1)) == 0);
+
+        if (isRemoval)
+        {
+            // Bugzilla 553679: see GCHashtableBase::grow.
+            if (GCHeap::GetGCHeap()->GetStatus() == kMemAbort)
+                return false;
+        }
+
+        size_t entryBytes = newCapacity * sizeof(Entry);
+        Entry* newEntries = (Entry*)ALLOCHANDLER::alloc(entryBytes + newCapacity + kGroupSize, isRemoval);
+        if (!newEntries)
+            return false;
+        VMPI_memset(newEntries, 0, entryBytes);
+        VMPI_memset((uint8_t*)newEntries + entryBytes, kEmpty, newCapacity + kGroupSize);
+
+        Entry* oldEntries = entries;
+        uint8_t* oldCtrl = ctrl;
+        uint32_t oldCapacity = capacity;
+
+        entries = newEntries;
+        ctrl = (uint8_t*)newEntries + entryBytes;
+        capacity = newCapacity;
+        shift = 32;
+        for (uint32_t n=newCapacity; n > 1; n >>= 1)
+            shift--;
+
+        for (uint32_t i=0; i < oldCapacity; i++)
+        {
+            if (oldCtrl[i] != kEmpty)
+            {
+                uint32_t j = findEmpty(hashOf(oldEntries[i].key));
+                setControl(j, oldCtrl[i]);
+                entries[j] = oldEntries[i];
+            }
+        }
+
+        if (oldEntries)
+            ALLOCHANDLER::free(oldEntries);
+        return true;
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    int32_t GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::nextIndex(int32_t index)
+    {
+        while(index < (int32_t)capacity)
+        {
+            if (ctrl[index] != kEmpty)
+                return (index + 1);
+            index++;
+        }
+        return 0;
+    }
+
+    template <typename VAL, class KEYHANDLER, class ALLOCHANDLER>
+    uint64_t GCGroupHashtableBase<VAL, KEYHANDLER,ALLOCHANDLER>::bytesUsed() const
+    {
+        return capacity == 0 ? 0 : ((uint64_t)capacity) * (sizeof(Entry) + 1) + kGroupSize;
+    }
+}
+
+#endif
@@ -0,0 +1,166 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCGroupHashtable__
+#define __GCGroupHashtable__
+
+#ifdef MMGC_SIMD_HASHTABLE_PROBE
+    #include <emmintrin.h>
+#endif
+
+namespace MMgc
+{
+    /**
+     * A variant of GCHashtableBase with the same interface and template parameters
+     * that keeps a control byte per slot next to the entries and examines the
+     * control bytes of kGroupSize slots at a time (with SSE2 where available).
+     *
+     * The control byte of an empty slot is kEmpty; that of a full slot holds 7 bits
+     * of the key's hash, so that a probe compares only the keys whose bits match.
+     * The table is probed linearly from the slot the hash selects, and removal
+     * shifts the following entries of the cluster back instead of leaving a
+     * DELETED marker, so that lookups never wade through the remains of removed
+     * keys and the table needs no rehashing after many removals, only shrinking.
+     *
+     * While iterating, the key the iterator last returned may be removed with
+     * allowRehash=false (GC::MarkOrClearWeakRefs does that); no other change is
+     * allowed.
+     */
+    template <typename VAL = const void*, class KEYHANDLER = GCHashtableKeyHandler, class ALLOCHANDLER=GCHashtableAllocHandler_new>
+    class GCGroupHashtableBase
+    {
+    public:
+        static uint32_t const kDefaultSize = 16;
+        static uint32_t const kGroupSize = 16;
+
+        GCGroupHashtableBase(uint32_t capacity = kDefaultSize);
+        ~GCGroupHashtableBase();
+
+        void clear();
+
+        REALLY_INLINE VAL get(const void* key) { uint32_t i = find(key); return i == kNotFound ? VAL(0) : entries[i].value; }
+        REALLY_INLINE const void* get(intptr_t key) { return get((const void*)key); }
+        VAL remove(const void* key, bool allowRehash=true);
+        // updates value if present, adds and grows if necessary if not
+        void put(const void* key, VAL value);
+        REALLY_INLINE void add(const void* key, VAL value) { put(key, value); }
+        REALLY_INLINE void add(intptr_t key, VAL value) { put((const void*)key, value); }
+        REALLY_INLINE uint32_t count() const { return numValues; }
+
+        int32_t nextIndex(int32_t index);
+        const void* keyAt(int32_t index) const { return entries[index].key; }
+        VAL valueAt(int32_t index) const { return entries[index].value; }
+
+        // Shrinks the table if it is sparse, useful after a lot of removals with
+        // allowRehash==false
+        void prune();
+
+        uint64_t bytesUsed() const;
+
+        class Iterator
+        {
+        public:
+            // Iteration starts just after an empty slot, so that no cluster
+            // straddles the start and entries moved back by a removal land either
+            // on the current slot or on slots not yet visited.
+            Iterator(GCGroupHashtableBase* _ht) : ht(_ht), offset(-1), start(0), index(0), key(NULL)
+            {
+#ifdef GCDEBUG
+                // Bug 637993: iterators stack allocated to ensure clean up.
+                GCAssert(IsAddressOnStack(this));
+                ht->numIterators++;
+#endif
+                if (ht->capacity > 0) {
+                    while (ht->ctrl[start] != kEmpty)
+                        start++;
+                    start = (start + 1) & (ht->capacity - 1);
+                }
+            }
+
+            ~Iterator()
+            {
+#ifdef GCDEBUG
+                ht->numIterators--;
+#endif
+            }
+
+            const void* nextKey()
+            {
+                if (offset >= (int32_t)ht->capacity)
+                    return NULL;
+                // If the last key was removed, an entry may have moved into its slot.
+                if (offset < 0 || ht->ctrl[index] == kEmpty || ht->entries[index].key == key) {
+                    do {
+                        offset++;
+                        index = (start + uint32_t(offset)) & (ht->capacity - 1);
+                    } while(offset < (int32_t)ht->capacity && ht->ctrl[index] == kEmpty);
+                }
+                key = (offset < (int32_t)ht->capacity) ? ht->entries[index].key : NULL;
+                return key;
+            }
+
+            VAL value()
+            {
+                GCAssert(ht->ctrl[index] != kEmpty);
+                return ht->entries[index].value;
+            }
+
+        private:
+            GCGroupHashtableBase* volatile ht;
+            int32_t offset;         // the number of slots visited, less one
+            uint32_t start;         // the first slot visited
+            uint32_t index;         // the current slot
+            const void* key;        // the key last returned
+        };
+
+    private:
+        typedef struct HashTableEntry<VAL> Entry;
+
+        static const uint8_t kEmpty = 0x80;
+        static const uint32_t kNotFound = 0xffffffffU;
+
+        // The hash of 'key', spread over all bits.  The high bits select the first
+        // slot to probe, the low 7 bits are the control byte.
+        REALLY_INLINE static uint32_t hashOf(const void* key) { return KEYHANDLER::hash(key) * 0x9E3779B1U; }
+        REALLY_INLINE uint32_t homeOf(uint32_t hash) const { return hash >> shift; }
+
+        // Bit i of the result is set if the control byte of slot i of the group
+        // at 'group' is 'b' (matchByte) or kEmpty (matchEmpty).
+        static uint32_t matchByte(const uint8_t* group, uint8_t b);
+        static uint32_t matchEmpty(const uint8_t* group);
+        static uint32_t lowestBit(uint32_t bits);
+
+        // Sets the control byte of slot 'i' and its copy past the end of the table.
+        void setControl(uint32_t i, uint8_t c);
+
+        uint32_t find(const void* key);
+        uint32_t findEmpty(uint32_t hash);
+
+        // Reallocate the table with 'newCapacity' slots and reinsert the entries.
+        // Returns false if the allocation failed, which it may only do if 'isRemoval'.
+        bool resize(uint32_t newCapacity, bool isRemoval);
+
+     protected:
+        Entry* entries;         // 'capacity' entries, followed by the control bytes
+        uint8_t* ctrl;          // 'capacity' control bytes, followed by copies of the first kGroupSize
+        uint32_t capacity;      // the number of slots, a power of 2 no less than kGroupSize, or 0
+        uint32_t shift;         // 32 - log2(capacity)
+        uint32_t numValues;     // the number of full slots
+#ifdef GCDEBUG
+        uint32_t numIterators;  // number of active iterators
+#endif
+#ifdef MMGC_GCHASHTABLE_PROFILER
+    public:
+        uint64_t probes;
+        uint64_t accesses;
+#endif
+    };
+
+    typedef GCGroupHashtableBase<const void*, GCHashtableKeyHandler, GCHashtableAllocHandler_new> GCGroupHashtable;
+    typedef GCGroupHashtableBase<const void*, GCHashtableKeyHandler, GCHashtableAllocHandler_VMPI> GCGroupHashtable_VMPI;
+}
+
+#endif
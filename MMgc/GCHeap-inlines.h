@@ -147,6 +147,11 @@ namespace MMgc
         return blocksLen - numDecommitted + largeAllocation;
     }
 
+    REALLY_INLINE GCTraceLog* GCHeap::GetTraceLog() const
+    {
+        return traceLog;
+    }
+
     REALLY_INLINE size_t GCHeap::GetTotalHeapSize() const
     {
 		size_t result = totalBlocksLen - totalNumDecommitted + totalLargeAllocs;
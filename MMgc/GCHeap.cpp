@@ -72,6 +72,10 @@ namespace MMgc
         trimVirtualMemory(true),
         mergeContiguousRegions(AVMPI_canMergeContiguousRegions()),
         sloppyCommit(AVMPI_canCommitAlreadyCommittedMemory()),
+        hugePages(false),
+        numaBind(false),
+        asyncDecommit(false),
+        decommitHysteresis(0),
         secret(0),
         verbose(false),
         returnMemory(true),
@@ -88,6 +92,10 @@ namespace MMgc
 #endif
         gcLoadCeiling(1.15), // Bug 619885: need > 1.0 to get belt loosening effect
         gcEfficiency(0.25),
+        gcPauseTarget(0),
+        gcOverheadTarget(1.0),
+        fixedMallocSizeClasses(NULL),
+        fixedMallocStatistics(false),
         _checkFixedMemory(true) // See comment in GCHeap.h for why the default must be 'true'
     {
         // Bugzilla 544695 - large heaps need to be controlled more tightly than
@@ -129,7 +137,9 @@ namespace MMgc
             || !VMPI_strcmp(arg, "-load")
             || !VMPI_strcmp(arg, "-loadCeiling")
             || !VMPI_strcmp(arg, "-gcwork")
-            || !VMPI_strcmp(arg, "-gcstack"))
+            || !VMPI_strcmp(arg, "-gcpause")
+            || !VMPI_strcmp(arg, "-gcstack")
+            || !VMPI_strcmp(arg, "-decommithysteresis"))
             return true;
         else
             return false;
@@ -200,6 +210,43 @@ namespace MMgc
             eagerSweeping = true;
             return true;
         }
+        else if (!VMPI_strcmp(arg, "-hugepages")) {
+            hugePages = true;
+            return true;
+        }
+        else if (!VMPI_strcmp(arg, "-numabind")) {
+            numaBind = true;
+            return true;
+        }
+        else if (!VMPI_strcmp(arg, "-asyncdecommit")) {
+            asyncDecommit = true;
+            return true;
+        }
+        else if (HasPrefix(arg, "-decommithysteresis")) {
+            const char *param =
+                useDefaultOrSkipForward(arg, "-decommithysteresis", successorString);
+            if (param == NULL) {
+                wrong = true;
+                return true;
+            }
+
+            int n;
+            int nchar;
+#ifdef _MSC_VER
+#pragma warning(disable: 4996)
+#endif
+            if (VMPI_sscanf(param, "%d%n", &n, &nchar) == 1 && size_t(nchar) == VMPI_strlen(param) && n >= 0) {
+                decommitHysteresis = uint32_t(n);
+                return true;
+            }
+            else {
+                wrong = true;
+                return true;
+            }
+#ifdef _MSC_VER
+#pragma warning(default: 4996)
+#endif
+        }
         else if (HasPrefix(arg, "-load") && !HasPrefix(arg, "-loadCeiling")) {
             const char *param =
                 useDefaultOrSkipForward(arg, "-load", successorString);
@@ -348,6 +395,40 @@ namespace MMgc
 #endif
         }
 
+        else if (HasPrefix(arg, "-gcpause")) {
+            const char* param =
+                useDefaultOrSkipForward(arg, "-gcpause", successorString);
+            if (param == NULL) {
+                wrong = true;
+                return true;
+            }
+
+            double pause;
+            double overhead = gcOverheadTarget;
+            int nchar;
+            const char* val = param;
+#ifdef _MSC_VER
+#pragma warning(disable: 4996)
+#endif
+            if ((VMPI_sscanf(val, "%lf,%lf%n", &pause, &overhead, &nchar) == 2 ||
+                 VMPI_sscanf(val, "%lf%n", &pause, &nchar) == 1) &&
+                size_t(nchar) == VMPI_strlen(val) &&
+                pause > 0.0 &&
+                overhead > 0.0)
+            {
+                gcPauseTarget = pause;
+                gcOverheadTarget = overhead;
+                return true;
+            }
+            else {
+                wrong = true;
+                return true;
+            }
+#ifdef _MSC_VER
+#pragma warning(default: 4996)
+#endif
+        }
+
         // arg unmatched; option not handled here.
         return false;
     }
@@ -408,6 +489,11 @@ namespace MMgc
 		  totalNumDecommitted(0),
 		  totalLargeAllocs(0),
           totalNumAlloc(0),
+          hintedCommits(0),
+          hugePageCommits(0),
+          numaBoundCommits(0),
+          hintedCommitBlocks(0),
+          hugePageCommitBlocks(0),
           gcheapCodeMemory(0),
           externalCodeMemory(0),
           externalPressure(0),
@@ -429,7 +515,12 @@ namespace MMgc
     #endif
           entryChecksEnabled(true),
           abortStatusNotificationSent(false),
-		  nextDecommitPartition(0)
+		  nextDecommitPartition(0),
+          releaser(NULL),
+          releaserFailed(false),
+          decommitStreak(0),
+          decommitStreakMin(0),
+          traceLog(NULL)
     {
         VMPI_lockInit(&m_spinlock);
         VMPI_lockInit(&gclog_spinlock);
@@ -528,6 +619,17 @@ namespace MMgc
         endGCLogToFile();
 #endif
 
+        // The releaser's queued blocks go back on the free lists before the leak
+        // checks below.
+        if (releaser != NULL) {
+            mmfx_delete(releaser);
+            releaser = NULL;
+        }
+        if (traceLog != NULL) {
+            mmfx_delete(traceLog);
+            traceLog = NULL;
+        }
+
         gcManager.destroy();
         callbacks.Destroy();
 
@@ -793,8 +895,83 @@ namespace MMgc
 
         heap->m_oomHandling = saved_oomHandling;
     }
-	
+
+    size_t GCHeap::Partition::AllocBlocks(void **items, size_t count)
+    {
+        MMGC_LOCK(heap->m_spinlock);
+
+        bool saved_oomHandling = heap->m_oomHandling;
+        heap->m_oomHandling = false;
+
+        size_t n = 0;
+        while (n < count)
+        {
+            // Checking the limits first keeps AllocHelper from sending a free memory
+            // signal, which is the single-block path's business.
+            if (heap->status == kMemSoftLimit || heap->SoftLimitExceeded(1) || heap->HardLimitExceeded(1))
+                break;
+
+            bool zero = true;
+            void *item = AllocHelper(1, /*expand*/true, zero, 1);
+            if (!item)
+                break;
+            // Not Size(item): it takes m_spinlock, which we hold.
+            GCAssert(BaseAddrToBlock(item) != NULL && BaseAddrToBlock(item)->size == 1);
+
+            numAlloc += 1;
+            heap->totalNumAlloc += 1;
+            items[n++] = zero ? item : (void*)(uintptr_t(item) | 1);
+        }
+
+        heap->m_oomHandling = saved_oomHandling;
+        return n;
+    }
+
+    void GCHeap::Partition::FreeBlocks(void **items, size_t count)
+    {
+        MMGC_LOCK(heap->m_spinlock);
+
+        bool saved_oomHandling = heap->m_oomHandling;
+        heap->m_oomHandling = false;
+
+        for (size_t i=0; i < count; i++)
+        {
+            // Bit 0 is the 'already zeroed' tag that AllocBlocks may have set.
+            HeapBlock *block = BaseAddrToBlock((void*)(uintptr_t(items[i]) & ~uintptr_t(1)));
+            GCAssert(block != NULL && block->size == 1);
+
+            GCAssert(numAlloc >= 1);
+            numAlloc -= 1;
+            GCAssert(heap->totalNumAlloc >= 1);
+            heap->totalNumAlloc -= 1;
+
+#if defined(MMGC_MEMORY_PROFILER) && defined(MMGC_MEMORY_INFO)
+            if (heap->profiler)
+                block->freeTrace = heap->profiler->GetStackTrace();
+#endif
+
+            FreeBlock(block);
+        }
+
+        heap->m_oomHandling = saved_oomHandling;
+    }
+
     void GCHeap::Decommit()
+    {
+        if (traceLog == NULL) {
+            DecommitInternal();
+            return;
+        }
+
+        uint64_t start = VMPI_getPerformanceCounter();
+        size_t before = GetTotalHeapSize();
+        DecommitInternal();
+        size_t after = GetTotalHeapSize();
+        traceLog->Record("Decommit", GCTraceLog::kHeapTrack, start, VMPI_getPerformanceCounter(),
+                         (int64_t(after) - int64_t(before)) * kBlockSize, uint64_t(after) * kBlockSize);
+    }
+
+    void GCHeap::DecommitInternal()
     {
         // keep at least initialSize free
         if(!config.returnMemory)
@@ -809,10 +986,12 @@ namespace MMgc
         size_t freeSize = GetFreeHeapSize();
 
         size_t decommitSize = 0;
+        bool overThreshold = false;
         // commit if > kDecommitThresholdPercentage is free
         if(FreeMemoryExceedsDecommitThreshold())
         {
             decommitSize = int((freeSize * 100 - heapSize * kDecommitThresholdPercentage) / 100);
+            overThreshold = true;
         }
         //  If we're over the heapLimit, attempt to decommit enough to get just under the limit
         else if ( (heapSize > config.heapLimit) && ((heapSize - freeSize) < config.heapLimit))
@@ -826,6 +1005,10 @@ namespace MMgc
             decommitSize = heapSize - config.heapSoftLimit + 1;
         }
         else {
+            if (config.decommitHysteresis > 0) {
+                MMGC_LOCK(m_spinlock);
+                decommitStreak = 0;
+            }
             return;
         }
 
@@ -841,8 +1024,28 @@ namespace MMgc
             decommitSize = heapSize - config.initialSize;
         }
 
+        // Memory freed under pressure must be gone by the time we return.
+        bool pressure = statusNotificationBeingSent() || status != kMemNormal;
+
+        bool async = false;
+#ifndef MMGC_MAC
+        async = config.asyncDecommit && config.useVirtualMemory && !pressure && EnsureReleaser();
+#endif
 
         MMGC_LOCK(m_spinlock);
+
+        if (!overThreshold || pressure) {
+            decommitStreak = 0;
+        }
+        else if (config.decommitHysteresis > 0) {
+            // Only decommit what has been free for decommitHysteresis+1 calls in a row.
+            if (decommitStreak == 0 || decommitSize < decommitStreakMin)
+                decommitStreakMin = decommitSize;
+            if (decommitStreak++ < config.decommitHysteresis)
+                return;
+            decommitSize = decommitStreakMin;
+            decommitStreak = 0;
+        }
 		
     restart:
 		
@@ -908,13 +1111,36 @@ namespace MMgc
 							}
 
 							decommitSize -= block->size;
-							partitions[part].RemoveBlock(block);
+							if(async)
+							{
+								// Leave the munmap to the releaser
+								char *baseAddr = block->baseAddr;
+								size_t size = block->size;
+								partitions[part].RemoveBlock(block, false);
+								if(!releaser->Queue(part, baseAddr, size, true))
+									partitions[part].ReleaseMemory(baseAddr, size * kBlockSize);
+							}
+							else
+							{
+								partitions[part].RemoveBlock(block);
+							}
 							goto restart;
 						}
+						else if(async && releaser->Queue(part, block->baseAddr, block->size, false))
+						{
+							// The block stays off the free lists until the releaser has
+							// decommitted it and calls AddDecommittedBlock
+							decommitSize -= block->size;
+							partitions[part].numDecommitted += block->size;
+							totalNumDecommitted += block->size;
+							if(config.verbose) {
+								GCLog("queued %d page block from %p for decommit\n", block->size, block->baseAddr);
+							}
+							block = freelist;
+							continue;
+						}
 						else if(AVMPI_decommitMemory(block->baseAddr, block->size * kBlockSize))
 						{
-							block->committed = false;
-							block->dirty = false;
 							decommitSize -= block->size;
 							if(config.verbose) {
 								GCLog("decommitted %d page block from %p\n", block->size, block->baseAddr);
@@ -935,43 +1161,7 @@ namespace MMgc
 						partitions[part].numDecommitted += block->size;
 						totalNumDecommitted += block->size;
 
-						// merge with previous/next if not in use and not committed
-						HeapBlock *prev = block - block->sizePrevious;
-						if(block->sizePrevious != 0 && !prev->committed && !prev->inUse()) {
-							partitions[part].RemoveFromList(prev);
-
-							prev->size += block->size;
-
-							block->size = 0;
-							block->sizePrevious = 0;
-							block->baseAddr = 0;
-
-							block = prev;
-						}
-
-						HeapBlock *next = block + block->size;
-						if(next->size != 0 && !next->committed && !next->inUse()) {
-							partitions[part].RemoveFromList(next);
-
-							block->size += next->size;
-
-							next->size = 0;
-							next->sizePrevious = 0;
-							next->baseAddr = 0;
-						}
-
-						next = block + block->size;
-						next->sizePrevious = block->size;
-
-						// add this block to the back of the bus to make sure we consume committed memory first
-						HeapBlock *backOfTheBus = &partitions[part].freelists[kNumFreeLists-1];
-						HeapBlock *pointToInsert = backOfTheBus;
-						while ((pointToInsert = pointToInsert->next) !=  backOfTheBus) {
-							if (pointToInsert->size >= block->size && !pointToInsert->committed) {
-								break;
-							}
-						}
-						partitions[part].AddToFreeList(block, pointToInsert);
+						partitions[part].AddDecommittedBlock(block);
 
 						// so we keep going through freelist properly
 						block = freelist;
@@ -996,6 +1186,83 @@ namespace MMgc
 				DumpHeapRep();
 			CheckForStatusReturnToNormal();
 		}
+
+		if(async)
+			releaser->Submit();
+    }
+
+    void GCHeap::Partition::AddDecommittedBlock(HeapBlock *block)
+    {
+        block->committed = false;
+        block->dirty = false;
+
+        // merge with previous/next if not in use and not committed
+        HeapBlock *prev = block - block->sizePrevious;
+        if(block->sizePrevious != 0 && !prev->committed && !prev->inUse()) {
+            RemoveFromList(prev);
+
+            prev->size += block->size;
+
+            block->size = 0;
+            block->sizePrevious = 0;
+            block->baseAddr = 0;
+
+            block = prev;
+        }
+
+        HeapBlock *next = block + block->size;
+        if(next->size != 0 && !next->committed && !next->inUse()) {
+            RemoveFromList(next);
+
+            block->size += next->size;
+
+            next->size = 0;
+            next->sizePrevious = 0;
+            next->baseAddr = 0;
+        }
+
+        next = block + block->size;
+        next->sizePrevious = block->size;
+
+        // add this block to the back of the bus to make sure we consume committed memory first
+        HeapBlock *backOfTheBus = &freelists[kNumFreeLists-1];
+        HeapBlock *pointToInsert = backOfTheBus;
+        while ((pointToInsert = pointToInsert->next) !=  backOfTheBus) {
+            if (pointToInsert->size >= block->size && !pointToInsert->committed) {
+                break;
+            }
+        }
+        AddToFreeList(block, pointToInsert);
+    }
+
+    bool GCHeap::EnableTraceLog(uint32_t capacity)
+    {
+        if (traceLog != NULL)
+            return true;
+        GCTraceLog* log = mmfx_new(GCTraceLog(capacity));
+        if (!log->IsValid()) {
+            mmfx_delete(log);
+            return false;
+        }
+        traceLog = log;
+        return true;
+    }
+
+    bool GCHeap::EnsureReleaser()
+    {
+        if (releaser != NULL)
+            return true;
+        if (releaserFailed)
+            return false;
+        // Not under m_spinlock: mmfx_new may need it.
+        releaser = mmfx_new(GCHeapReleaser(this));
+        if (!releaser->Start()) {
+            mmfx_delete(releaser);
+            releaser = NULL;
+            releaserFailed = true;
+            return false;
+        }
+        return true;
     }
 
     // m_spinlock is held
@@ -1398,20 +1665,82 @@ namespace MMgc
     }
 #endif
 
-    REALLY_INLINE char *GCHeap::Partition::ReserveSomeRegion(size_t sizeInBytes)
+    // Reserves a region of size == sizeInBytes anywhere, dispersively in debug
+    // builds if config.dispersiveAdversarial is set.
+    static char* reserveRegion(const GCHeapConfig& config, size_t sizeInBytes)
     {
 #ifdef GCDEBUG
-        if (!heap->config.dispersiveAdversarial)
-            return (char*)AVMPI_reserveMemoryRegion(NULL, sizeInBytes);
-        else
-            return reserveSomeRegionDispersively(heap->config.dispersiveAdversarial,
-                                                 sizeInBytes);
+        if (config.dispersiveAdversarial)
+            return reserveSomeRegionDispersively(config.dispersiveAdversarial, sizeInBytes);
 #else
-        return (char*)AVMPI_reserveMemoryRegion(NULL, sizeInBytes);
+        (void)config;
 #endif
+        return (char*)AVMPI_reserveMemoryRegion(NULL, sizeInBytes);
+    }
+
+    REALLY_INLINE char *GCHeap::Partition::ReserveSomeRegion(size_t sizeInBytes)
+    {
+        if (heap->config.hugePages) {
+            size_t hugePageSize = AVMPI_getHugePageSize();
+            if (hugePageSize > kBlockSize && sizeInBytes % hugePageSize == 0)
+                return ReserveHugePageAlignedRegion(sizeInBytes, hugePageSize);
+        }
+        return reserveRegion(heap->config, sizeInBytes);
+    }
+
+
+    char *GCHeap::Partition::ReserveHugePageAlignedRegion(size_t sizeInBytes, size_t hugePageSize)
+    {
+        // Reserve enough to find an aligned range in, then release the slop on either
+        // side.  Only platforms that support huge pages get here, and they can release
+        // part of a reservation.  In debug builds the reservation is still dispersed
+        // if GCHeapConfig::dispersiveAdversarial asks for it.
+        char *addr = reserveRegion(heap->config, sizeInBytes + hugePageSize);
+        if (addr == NULL)
+            return reserveRegion(heap->config, sizeInBytes);
+
+        char *alignedAddr = (char*)((uintptr_t(addr) + hugePageSize - 1) & ~(uintptr_t(hugePageSize) - 1));
+        char *top = addr + sizeInBytes + hugePageSize;
+        if (alignedAddr > addr)
+            AVMPI_releaseMemoryRegion(addr, alignedAddr - addr);
+        if (top > alignedAddr + sizeInBytes)
+            AVMPI_releaseMemoryRegion(alignedAddr + sizeInBytes, top - (alignedAddr + sizeInBytes));
+        return alignedAddr;
+    }
+
+    size_t GCHeap::Partition::HeapIncrement() const
+    {
+        // Growing by whole huge pages lets the OS back all of the new memory with
+        // huge pages.
+        if (heap->config.hugePages && heap->config.useVirtualMemory) {
+            size_t hugePageBlocks = AVMPI_getHugePageSize() / kBlockSize;
+            if (hugePageBlocks > kMinHeapIncrement)
+                return hugePageBlocks;
+        }
+        return kMinHeapIncrement;
+    }
+
+    bool GCHeap::Partition::CommitMemory(void *address, size_t size)
+    {
+        if (!heap->config.hugePages && !heap->config.numaBind)
+            return AVMPI_commitMemory(address, size);
+
+        int32_t numaNode = heap->config.numaBind ? AVMPI_getCurrentNumaNode() : -1;
+        bool hugePagesAdvised = false;
+        if (!AVMPI_commitMemoryWithHints(address, size, heap->config.hugePages, numaNode, &hugePagesAdvised))
+            return false;
+
+        heap->hintedCommits++;
+        heap->hintedCommitBlocks += size / kBlockSize;
+        if (hugePagesAdvised) {
+            heap->hugePageCommits++;
+            heap->hugePageCommitBlocks += size / kBlockSize;
+        }
+        if (numaNode >= 0)
+            heap->numaBoundCommits++;
+        return true;
     }
 
-	
     void *GCHeap::Partition::LargeAlloc(size_t size, size_t alignment)
     {
         GCAssert(heap->config.useVirtualMemory);
@@ -1437,7 +1766,7 @@ namespace MMgc
         }
 
         char *alignedAddr = addr + alignmentSlop(addr, alignment) * kBlockSize;
-        if(!AVMPI_commitMemory(alignedAddr, sizeInBytes)) {
+        if(!CommitMemory(alignedAddr, sizeInBytes)) {
             AVMPI_releaseMemoryRegion(addr, sizeInBytes);
             return NULL;
         }
@@ -1700,7 +2029,7 @@ namespace MMgc
     {
         GCAssert(heap->config.sloppyCommit || !block->committed);
 
-        if(!AVMPI_commitMemory(block->baseAddr, block->size * kBlockSize))
+        if(!CommitMemory(block->baseAddr, block->size * kBlockSize))
         {
             GCAssert(false);
         }
@@ -1948,8 +2277,16 @@ namespace MMgc
 
     bool GCHeap::Partition::ExpandHeap( size_t askSize)
     {
+        GCTraceLog* traceLog = heap->traceLog;
+        uint64_t start = traceLog != NULL ? VMPI_getPerformanceCounter() : 0;
+        size_t before = traceLog != NULL ? heap->GetTotalHeapSize() : 0;
         bool bRetVal = ExpandHeapInternal(askSize);
         heap->CheckForNewMaxTotalHeapSize();
+        if (traceLog != NULL) {
+            size_t after = heap->GetTotalHeapSize();
+            traceLog->Record("ExpandHeap", GCTraceLog::kHeapTrack, start, VMPI_getPerformanceCounter(),
+                             (int64_t(after) - int64_t(before)) * kBlockSize, uint64_t(after) * kBlockSize);
+        }
         return bRetVal;
     }
 
@@ -1985,8 +2322,9 @@ namespace MMgc
         bool contiguous = false;
         size_t commitAvail = 0;
 
-        // Round up to the nearest kMinHeapIncrement
-        size = roundUp(size, kMinHeapIncrement);
+        // Round up to the nearest heap increment
+        const size_t increment = HeapIncrement();
+        size = roundUp(size, increment);
 
         // when we allocate a new region the space needed for the HeapBlocks, if it won't fit
         // in existing space it must fit in new space so we may need to increase the new space
@@ -2007,7 +2345,7 @@ namespace MMgc
             while(newHeapBlocksSize > curHeapBlocksSize)
             {
                 // use askSize so HeapBlock's can fit in rounding slop
-                size = roundUp(askSize + newHeapBlocksSize + extraBlocks, kMinHeapIncrement);
+                size = roundUp(askSize + newHeapBlocksSize + extraBlocks, increment);
 
                 // tells us use new memory for blocks below
                 newBlocks = NULL;
@@ -2033,7 +2371,7 @@ namespace MMgc
                 // Can this request be satisfied purely by committing more memory that
                 // is already reserved?
                 if (size <= commitAvail) {
-                    if (AVMPI_commitMemory(region->commitTop, size * kBlockSize))
+                    if (CommitMemory(region->commitTop, size * kBlockSize))
                     {
                         // Succeeded!
                         baseAddr = region->commitTop;
@@ -2091,7 +2429,7 @@ namespace MMgc
 
                     // Commit available space from the existing region.
                     if (commitAvail != 0) {
-                        if (!AVMPI_commitMemory(region->commitTop, commitAvail * kBlockSize))
+                        if (!CommitMemory(region->commitTop, commitAvail * kBlockSize))
                         {
                             // We couldn't commit even this space.  We're doomed.
                             // Un-reserve the space we just reserved and fail.
@@ -2101,7 +2439,7 @@ namespace MMgc
                     }
 
                     // Commit needed space from the new region.
-                    if (!AVMPI_commitMemory(newRegionAddr, (size - commitAvail) * kBlockSize))
+                    if (!CommitMemory(newRegionAddr, (size - commitAvail) * kBlockSize))
                     {
                         // We couldn't commit this space.  We can't meet the
                         // request.  Un-commit any memory we just committed,
@@ -2156,7 +2494,7 @@ namespace MMgc
             }
 
             // - Try to commit the memory.
-            if (AVMPI_commitMemory(newRegionAddr,
+            if (CommitMemory(newRegionAddr,
                              size*kBlockSize) == 0)
             {
                 // Failed.  Un-reserve the memory and fail.
@@ -2765,6 +3103,8 @@ namespace MMgc
         size_t gc_allocated_total =0;
         size_t gc_ask_total = 0;
         size_t gc_count = 0;
+        size_t gc_compacted = 0;
+        bool gc_compacting = false;
         BasicListIterator<GC*> iter(gcManager.gcs());
         GC* gc;
         while((gc = iter.next()) != NULL)
@@ -2784,6 +3124,11 @@ namespace MMgc
             gc_count += 1;
 
             gc_total += gc->GetNumBlocks() * kBlockSize;
+
+            if (gc->m_compactor != NULL) {
+                gc_compacted += size_t(gc->m_compactor->GetBytesReclaimed());
+                gc_compacting = true;
+            }
         }
 
 #ifdef MMGC_MEMORY_PROFILER
@@ -2822,6 +3167,18 @@ namespace MMgc
         else
             GCLog("[mem] No gross stats available when profiler is enabled.\n");
 #endif
+        if (config.hugePages || config.numaBind) {
+            GCLog("[mem] huge pages: advised for %u of %u committed regions (%u of %u KB)\n",
+                  hugePageCommits, hintedCommits,
+                  unsigned(hugePageCommitBlocks * kBlockSize / 1024), unsigned(hintedCommitBlocks * kBlockSize / 1024));
+            GCLog("[mem] numa: %u of %u committed regions placed on the committing thread's node\n",
+                  numaBoundCommits, hintedCommits);
+        }
+        if (releaser != NULL)
+            releaser->DumpStats();
+        if (gc_compacting)
+            GCLog("[mem] compaction: %u KB reclaimed from sparse blocks by the live collectors\n",
+                  unsigned(gc_compacted / 1024));
         GCLog("[mem] -------- gross stats end -----\n");
 
 #ifdef MMGC_MEMORY_PROFILER
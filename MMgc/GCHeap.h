@@ -8,6 +8,9 @@
 #define __GCHeap__
 
 namespace avmplus { namespace ST_mmgc_gcoption { class ST_mmgc_gcoption; } };
+namespace avmplus { namespace ST_mmgc_pacing { class ST_mmgc_pacing; } };
+namespace avmplus { namespace ST_mmgc_asyncdecommit { class ST_mmgc_asyncdecommit; } };
+namespace avmplus { namespace ST_mmgc_tracelog { class ST_mmgc_tracelog; } };
 
 namespace MMgc
 {
@@ -113,6 +116,43 @@ namespace MMgc
          */
         bool sloppyCommit;
 
+        /**
+         * If hugePages is true then the heap asks for its memory to be backed by huge
+         * pages where the platform supports them (see AVMPI_getHugePageSize), to reduce
+         * TLB misses when marking large heaps.  The heap then grows in whole huge pages
+         * and aligns new regions on huge page boundaries.  Defaults to false.
+         */
+        bool hugePages;
+
+        /**
+         * If numaBind is true then the heap asks for newly committed memory to be placed
+         * on the NUMA node of the thread that needs it.  Since every isolate allocates
+         * on its own thread, an isolate's heap growth mostly lands on its own node.
+         * Defaults to false.
+         */
+        bool numaBind;
+
+        /**
+         * If asyncDecommit is true then GCHeap::Decommit leaves the decommitting and
+         * the releasing of whole regions to a GCHeapReleaser thread, so that the system
+         * calls are made outside the collector's pause.  Decommit still does all the
+         * accounting at once.  Memory freed under memory pressure (soft or hard limit,
+         * or a kFreeMemoryIfPossible notification) is always returned synchronously.
+         * Not supported on Mac, where decommitting may lose the memory to another
+         * thread.  Defaults to false.
+         */
+        bool asyncDecommit;
+
+        /**
+         * The number of consecutive calls to GCHeap::Decommit (one per collection)
+         * that must find more than kDecommitThresholdPercentage of the heap free
+         * before any of it is decommitted.  Decommit then returns the smallest excess
+         * seen over those calls, so that memory that was only briefly free between
+         * collections is not decommitted and committed again.  Does not apply to
+         * decommitting under memory pressure.  Defaults to 0, decommit at once.
+         */
+        uint32_t decommitHysteresis;
+
         /**
          * A randomly-chosen session secret used for security hardening.
          */
@@ -148,6 +188,10 @@ namespace MMgc
         double gcLoadCutoff[kNumLoadFactors]; // Heap sizes (MB) following GC below which the corresponding load factor applies, last entry is +infinity
         double gcLoadCeiling;   // Max multiple of gcLoad policy should use after adjusting L for various factors (0=unlimited)
         double gcEfficiency;    // Max fraction of time to spend in the collector while the incremental collector is active
+        double gcPauseTarget;   // Max incremental GC slice (ms) the policy adapts to (0=off: use gcLoad and a fixed slice); see GCPolicyManager
+        double gcOverheadTarget; // With gcPauseTarget: heap overhead to aim for, as a fraction of the live size following GC; replaces gcLoad
+        const uint16_t* fixedMallocSizeClasses; // FixedMalloc size classes replacing FixedMalloc::kSizeClasses (NULL or invalid=built-in); see FixedMalloc::ComputeSizeClasses
+        bool fixedMallocStatistics; // Record the sizes of FixedMalloc requests, see FixedMalloc::GetSizeClassStats; slows allocation
         
     private:
         bool _checkFixedMemory;
@@ -244,6 +288,10 @@ namespace MMgc
         friend class FixedMalloc;
         friend class GCPolicyManager;
         friend class avmplus::ST_mmgc_gcoption::ST_mmgc_gcoption;
+        friend class avmplus::ST_mmgc_pacing::ST_mmgc_pacing;
+        friend class avmplus::ST_mmgc_asyncdecommit::ST_mmgc_asyncdecommit;
+        friend class avmplus::ST_mmgc_tracelog::ST_mmgc_tracelog;
+        friend class GCHeapReleaser;
     public:
         // -- Constants
 
@@ -511,6 +559,7 @@ namespace MMgc
 		class Partition
 		{
 			friend class GCHeap;
+			friend class GCHeapReleaser;
 			
 		public:
 			/**
@@ -582,6 +631,19 @@ namespace MMgc
 			
 			void FreeInternal(const void *item, bool profile, bool oomHandling);
 			HeapBlock *InteriorAddrToBlock(const void *item) const;
+
+			// Allocate up to 'count' single blocks into 'items' with one acquisition of
+			// the heap lock, expanding the heap if necessary.  Stops early, without OOM
+			// handling, when a block can't be had or a memory limit has been reached.
+			// The allocations are not profiled.  A block whose entry has bit 0 set is
+			// known to be zeroed; the bit must be cleared before the block is used.
+			// Returns the number of blocks allocated.
+			size_t AllocBlocks(void **items, size_t count);
+
+			// Free 'count' single blocks, which must not be profiled allocations, with
+			// one acquisition of the heap lock.  Entries may still have the bit 0 tag
+			// from AllocBlocks.
+			void FreeBlocks(void **items, size_t count);
 			
 		private:
 			// Accessible to GCHeap class via friend declaration above.
@@ -616,6 +678,10 @@ namespace MMgc
 			HeapBlock *Split(HeapBlock *block, size_t size);
 			
 			void Commit(HeapBlock *block);
+
+			// AVMPI_commitMemory, with the hints requested by config.hugePages and
+			// config.numaBind.
+			bool CommitMemory(void *address, size_t size);
 			
 			// Large* handle allocations larger than kOSAllocThreshold.
 			void *LargeAlloc(size_t size, size_t alignment);
@@ -652,6 +718,11 @@ namespace MMgc
 			HeapBlock* AllocCommittedBlock(HeapBlock* block, size_t size, bool& zero, size_t alignment);
 			HeapBlock* CreateCommittedBlock(HeapBlock* block, size_t size, size_t alignment);
 			void PruneDecommittedBlock(HeapBlock* block, size_t available, size_t request);
+
+			// Mark the free block 'block', which is off the free lists and has just been
+			// decommitted, uncommitted, coalesce it with adjacent uncommitted free blocks,
+			// and add it to the back of the last free list.  Does not update numDecommitted.
+			void AddDecommittedBlock(HeapBlock *block);
 			
 #ifdef MMGC_MAC
 			// Abandon a block of memory that may be in the middle of a
@@ -749,6 +820,13 @@ namespace MMgc
 			 * @see VMPI_reserveMemoryRegion
 			 */
 			char* ReserveSomeRegion(size_t sizeInBytes);
+
+			// ReserveSomeRegion for a multiple of hugePageSize bytes, aligned on
+			// hugePageSize.
+			char* ReserveHugePageAlignedRegion(size_t sizeInBytes, size_t hugePageSize);
+
+			// The number of blocks by which the partition grows at a time.
+			size_t HeapIncrement() const;
 			
 			void ReleaseMemory(char *address, size_t size);
 			
@@ -814,6 +892,20 @@ namespace MMgc
          */
         void Decommit();
 
+        /**
+         * Start recording the phases of the heap and of every GC in a GCTraceLog
+         * that keeps the last 'capacity' events.  Does nothing if the log has
+         * already been created.
+         *
+         * @return false if the log could not be created.
+         */
+        bool EnableTraceLog(uint32_t capacity);
+
+        /**
+         * @return the trace log, or NULL if EnableTraceLog has not been called.
+         */
+        GCTraceLog* GetTraceLog() const;
+
         void PreventDestruct();
         void AllowDestruct();
 
@@ -1022,6 +1114,13 @@ namespace MMgc
         void CheckForSoftLimitExceeded(size_t request);
         bool FreeMemoryExceedsDecommitThreshold();
 
+        // Create and start the releaser if it does not exist, return false if it
+        // can't be started (see GCHeapConfig::asyncDecommit).
+        bool EnsureReleaser();
+
+        // The work of Decommit().
+        void DecommitInternal();
+
         void Enter(EnterFrame *frame);
         void Leave();
 
@@ -1051,6 +1150,14 @@ namespace MMgc
 		size_t totalLargeAllocs;
         size_t totalNumAlloc;				// running total of number of blocks allocated and not freed (entire heap)
 
+        // Statistics for commits made with hints (config.hugePages or config.numaBind),
+        // for -memstats.
+        uint32_t hintedCommits;
+        uint32_t hugePageCommits;           // Commits for which huge pages were advised
+        uint32_t numaBoundCommits;          // Commits placed on the committing thread's node
+        size_t hintedCommitBlocks;
+        size_t hugePageCommitBlocks;
+
         FixedMalloc fixedMallocs[kNumFixedPartitions];
 
         size_t gcheapCodeMemory;
@@ -1088,6 +1195,16 @@ namespace MMgc
         bool abortStatusNotificationSent;
 		
 		int nextDecommitPartition;	// round-robin partition index for Decommit
+
+        // Asynchronous decommit, see GCHeapConfig::asyncDecommit.
+        GCHeapReleaser* releaser;           // NULL until the first asynchronous Decommit
+        bool releaserFailed;                // Set if the releaser's thread could not be started
+
+        // Hysteresis, see GCHeapConfig::decommitHysteresis; protected by m_spinlock.
+        uint32_t decommitStreak;            // Consecutive Decommit calls above the threshold
+        size_t decommitStreakMin;           // Smallest excess, in blocks, over those calls
+
+        GCTraceLog* traceLog;               // NULL until EnableTraceLog
     };
 
 }
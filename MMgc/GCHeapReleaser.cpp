@@ -0,0 +1,190 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MMgc.h"
+
+namespace MMgc
+{
+    GCHeapReleaser::GCHeapReleaser(GCHeap* heap)
+        : m_heap(heap)
+        , m_thread(NULL)
+        , m_items(NULL)
+        , m_capacity(0)
+        , m_count(0)
+        , m_work(NULL)
+        , m_workCapacity(0)
+        , m_submitted(false)
+        , m_busy(false)
+        , m_shutdown(false)
+        , m_batches(0)
+        , m_blocksDecommitted(0)
+        , m_blocksReleased(0)
+        , m_releaseTicks(0)
+    {
+    }
+
+    GCHeapReleaser::~GCHeapReleaser()
+    {
+        if (m_thread != NULL) {
+            Flush();
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                m_shutdown = true;
+                locker.notifyAll();
+            }
+            m_thread->join();
+            mmfx_delete(m_thread);
+        }
+        GCAssert(m_count == 0);
+        if (m_items != NULL)
+            VMPI_free(m_items);
+        if (m_work != NULL)
+            VMPI_free(m_work);
+    }
+
+    bool GCHeapReleaser::Start()
+    {
+        GCAssert(m_thread == NULL);
+        m_thread = mmfx_new(vmbase::VMThread("GCHeapReleaser", this));
+        if (!m_thread->start()) {
+            mmfx_delete(m_thread);
+            m_thread = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    bool GCHeapReleaser::Queue(int partition, char* baseAddr, size_t size, bool release)
+    {
+        SCOPE_LOCK_NO_SP(m_monitor) {
+            if (!EnsureCapacity(m_count + 1))
+                return false;
+            Item& item = m_items[m_count++];
+            item.baseAddr = baseAddr;
+            item.size = size;
+            item.partition = partition;
+            item.release = release;
+        }
+        return true;
+    }
+
+    bool GCHeapReleaser::EnsureCapacity(uint32_t count)
+    {
+        if (count <= m_capacity)
+            return true;
+
+        uint32_t capacity = m_capacity < 64 ? 64 : m_capacity * 2;
+        Item* items = (Item*)VMPI_alloc(capacity * sizeof(Item));
+        if (items == NULL)
+            return false;
+        if (m_items != NULL) {
+            VMPI_memcpy(items, m_items, m_count * sizeof(Item));
+            VMPI_free(m_items);
+        }
+        m_items = items;
+        m_capacity = capacity;
+        return true;
+    }
+
+    void GCHeapReleaser::Submit()
+    {
+        SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+            if (m_count > 0) {
+                m_submitted = true;
+                locker.notifyAll();
+            }
+        }
+    }
+
+    void GCHeapReleaser::Flush()
+    {
+        SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+            if (m_count > 0) {
+                m_submitted = true;
+                locker.notifyAll();
+            }
+            while (m_count > 0 || m_busy)
+                locker.wait();
+        }
+    }
+
+    void GCHeapReleaser::run()
+    {
+        for (;;) {
+            uint32_t count;
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                while (!m_shutdown && !m_submitted)
+                    locker.wait();
+                if (m_shutdown)
+                    return;
+
+                Item* items = m_work;
+                uint32_t capacity = m_workCapacity;
+                m_work = m_items;
+                m_workCapacity = m_capacity;
+                m_items = items;
+                m_capacity = capacity;
+                count = m_count;
+                m_count = 0;
+                m_submitted = false;
+                m_busy = true;
+            }
+
+            uint64_t start = VMPI_getPerformanceCounter();
+            size_t decommitted = 0;
+            size_t released = 0;
+            for ( uint32_t i=0 ; i < count ; i++ ) {
+                Item& item = m_work[i];
+                size_t bytes = item.size * GCHeap::kBlockSize;
+                if (item.release) {
+                    bool success = AVMPI_releaseMemoryRegion(item.baseAddr, bytes);
+                    GCAssert(success);
+                    (void)success;
+                    released += item.size;
+                }
+                else {
+                    // As in GCHeap::Decommit: if the VM API's fail us bail
+                    if (!AVMPI_decommitMemory(item.baseAddr, bytes))
+                        VMPI_abort();
+                    decommitted += item.size;
+                }
+            }
+            uint64_t ticks = VMPI_getPerformanceCounter() - start;
+
+            if (decommitted > 0) {
+                MMGC_LOCK(m_heap->m_spinlock);
+                for ( uint32_t i=0 ; i < count ; i++ ) {
+                    Item& item = m_work[i];
+                    if (item.release)
+                        continue;
+                    GCHeap::Partition& partition = m_heap->partitions[item.partition];
+                    GCHeap::HeapBlock* block = partition.BaseAddrToBlock(item.baseAddr);
+                    GCAssert(block != NULL && block->size == item.size && block->inUse() && block->committed);
+                    partition.AddDecommittedBlock(block);
+                }
+            }
+
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                m_batches++;
+                m_blocksDecommitted += decommitted;
+                m_blocksReleased += released;
+                m_releaseTicks += ticks;
+                m_busy = false;
+                locker.notifyAll();
+            }
+        }
+    }
+
+    void GCHeapReleaser::DumpStats()
+    {
+        SCOPE_LOCK_NO_SP(m_monitor) {
+            GCLog("[mem] async decommit: %u batches, %llu KB decommitted, %llu KB released (%u ms)\n",
+                  m_batches,
+                  (unsigned long long)(m_blocksDecommitted * GCHeap::kBlockSize / 1024),
+                  (unsigned long long)(m_blocksReleased * GCHeap::kBlockSize / 1024),
+                  uint32_t(GC::ticksToMillis(m_releaseTicks)));
+        }
+    }
+}
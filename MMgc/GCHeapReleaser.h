@@ -0,0 +1,122 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCHeapReleaser__
+#define __GCHeapReleaser__
+
+namespace avmplus { namespace ST_mmgc_asyncdecommit { class ST_mmgc_asyncdecommit; } };
+
+namespace MMgc
+{
+    /**
+     * Asynchronous decommit (GCHeapConfig::asyncDecommit).
+     *
+     * GCHeap::Decommit runs at the end of every collection, and on a large heap the
+     * madvise and munmap calls it makes account for a good part of the pause.  With
+     * a GCHeapReleaser, Decommit still chooses the blocks and does all of the
+     * accounting, so that the heap size drops at once, but it only takes the blocks
+     * off the free lists and queues them.  The releaser's thread returns the memory
+     * to the OS without the heap lock, then takes the lock once per batch to put the
+     * decommitted blocks back on the free lists, uncommitted.
+     *
+     * A queued block is off the free lists and so looks in use to the rest of
+     * GCHeap: it is neither allocated nor coalesced with its neighbours until the
+     * thread is done with it.  The HeapBlock array may be reallocated meanwhile, so
+     * blocks are queued by address.  A region released whole (trimVirtualMemory) is
+     * removed from the heap by Decommit; only the munmap is left to the thread.
+     *
+     * Lock order: GCHeap::m_spinlock is taken before m_monitor, and the thread never
+     * holds m_monitor while it takes m_spinlock.
+     */
+    class GCHeapReleaser : public vmbase::Runnable
+    {
+        friend class avmplus::ST_mmgc_asyncdecommit::ST_mmgc_asyncdecommit;
+    public:
+        GCHeapReleaser(GCHeap* heap);
+
+        /**
+         * Finish the queued work, then stop and join the thread.  The heap lock
+         * must not be held.
+         */
+        virtual ~GCHeapReleaser();
+
+        /**
+         * Start the thread.  Returns false if it can't be started.
+         */
+        bool Start();
+
+        /**
+         * Queue 'size' blocks at 'baseAddr' in 'partition' to be decommitted, or
+         * the whole region at 'baseAddr' to be released if 'release' is true.
+         * Called by GCHeap::Decommit with the heap lock held; the work is not started
+         * before the next Submit().
+         *
+         * @return false if the queue can't grow, in which case the caller must do
+         * the work itself.
+         */
+        bool Queue(int partition, char* baseAddr, size_t size, bool release);
+
+        /**
+         * Hand the work queued so far to the thread as one batch.
+         */
+        void Submit();
+
+        /**
+         * Wait until all of the work submitted or queued so far is done.  The heap
+         * lock must not be held.
+         */
+        void Flush();
+
+        /**
+         * Print statistics for all batches to date, for -memstats.
+         */
+        void DumpStats();
+
+        // Entry point of the thread.
+        virtual void run();
+
+    private:
+        struct Item
+        {
+            char* baseAddr;
+            size_t size;                // In blocks
+            int32_t partition;
+            bool release;
+        };
+
+        // Make room for 'count' items in m_items.
+        bool EnsureCapacity(uint32_t count);
+
+        GCHeap* const m_heap;
+        vmbase::VMThread* m_thread;     // NULL until Start()
+
+        // The queue and thread control, protected by m_monitor.  The thread swaps
+        // m_items with m_work and works on m_work without the monitor.  Both are
+        // allocated with VMPI_alloc, since Queue() is called with the heap lock held.
+        vmbase::WaitNotifyMonitor m_monitor;
+        Item* m_items;
+        uint32_t m_capacity;
+        uint32_t m_count;
+        Item* m_work;
+        uint32_t m_workCapacity;
+        bool m_submitted;               // Set by Submit(), cleared when the thread takes the queue
+        bool m_busy;                    // Set while the thread works on m_work
+        bool m_shutdown;                // Set to make the thread exit
+
+        // Statistics for all batches to date, updated by the thread with the
+        // monitor held.
+        uint32_t m_batches;
+        uint64_t m_blocksDecommitted;
+        uint64_t m_blocksReleased;
+        uint64_t m_releaseTicks;        // Time spent in the OS calls
+
+    private: // not implemented
+        GCHeapReleaser(const GCHeapReleaser&);
+        GCHeapReleaser& operator=(const GCHeapReleaser&);
+    };
+}
+
+#endif /* __GCHeapReleaser__ */
@@ -0,0 +1,382 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MMgc.h"
+#include "avmplus.h"
+
+#include <stdio.h>
+
+namespace MMgc
+{
+    HeapSnapshotWriter::HeapSnapshotWriter(GC* gc)
+        : gc(gc)
+        , fp(NULL)
+        , learning(false)
+        , source(0)
+        , previousObject(0)
+        , nextType(kFirstDynamicType)
+        , numObjects(0)
+        , numEdges(0)
+    {
+    }
+
+    HeapSnapshotWriter::~HeapSnapshotWriter()
+    {
+        GCAssert(fp == NULL);
+    }
+
+    bool HeapSnapshotWriter::Write(const char* filename)
+    {
+        fp = fopen(filename, "wb");
+        if (fp == NULL)
+            return false;
+
+        fwrite("AVMHEAP", 1, 8, fp);
+        WriteUnsigned(kVersion);
+
+        static const char* const fixedTypes[] = {
+            NULL,
+            "(pointer-free object)",
+            "(conservatively traced object)",
+            "float",
+            "float4",
+            "String",
+            "Namespace"
+        };
+        for (uint32_t i=1 ; i < kFirstDynamicType ; i++) {
+            putc('T', fp);
+            WriteUnsigned(i);
+            WriteUnsigned(VMPI_strlen(fixedTypes[i]));
+            fputs(fixedTypes[i], fp);
+        }
+
+        GCAssert(gc->m_edgeVisitor == NULL);
+        gc->m_edgeVisitor = this;
+
+        learning = true;
+        ForEachObject(&HeapSnapshotWriter::LearnObject);
+        learning = false;
+
+        WriteRoots();
+        ForEachObject(&HeapSnapshotWriter::WriteObject);
+
+        gc->m_edgeVisitor = NULL;
+
+        putc('Z', fp);
+        WriteUnsigned(numObjects);
+        WriteUnsigned(numEdges);
+
+        bool ok = !ferror(fp);
+        if (fclose(fp) != 0)
+            ok = false;
+        fp = NULL;
+        return ok;
+    }
+
+    void HeapSnapshotWriter::ForEachObject(void (HeapSnapshotWriter::*visit)(const void* userptr, GCAlloc* alloc))
+    {
+        void* ptr;
+        for (int i=0; i < GC::kNumSizeClasses; i++) {
+            for (int j=0; j < kNumGCPartitions; j++) {
+                GCAlloc* allocs[] = {
+                    gc->containsPointersRCAllocs[i][j],
+                    gc->containsPointersNonfinalizedAllocs[i][j],
+                    gc->containsPointersFinalizedAllocs[i][j],
+                    gc->noPointersNonfinalizedAllocs[i][j],
+                    gc->noPointersFinalizedAllocs[i][j]
+                };
+                for (size_t k=0; k < sizeof(allocs)/sizeof(allocs[0]); k++) {
+                    GCAllocIterator iter(allocs[k]);
+                    while (iter.GetNextAllocatedObject(ptr))
+                        (this->*visit)(ptr, allocs[k]);
+                }
+            }
+        }
+        GCAlloc* bibopAllocs[] = { gc->bibopAllocFloat, gc->bibopAllocFloat4 };
+        for (size_t k=0; k < sizeof(bibopAllocs)/sizeof(bibopAllocs[0]); k++) {
+            GCAllocIterator iter(bibopAllocs[k]);
+            while (iter.GetNextAllocatedObject(ptr))
+                (this->*visit)(ptr, bibopAllocs[k]);
+        }
+        for (int j=0; j < kNumGCPartitions; j++) {
+            GCLargeAllocIterator iter(gc->largeAllocs[j]);
+            while (iter.GetNextAllocatedObject(ptr))
+                (this->*visit)(ptr, NULL);
+        }
+    }
+
+    void HeapSnapshotWriter::LearnObject(const void* userptr, GCAlloc*)
+    {
+        if (GC::GetGCBits(GetRealPointer(userptr)) & kVirtualGCTrace)
+            TraceObject(userptr);
+    }
+
+    void HeapSnapshotWriter::WriteObject(const void* userptr, GCAlloc* alloc)
+    {
+        gcbits_t bits = GC::GetGCBits(GetRealPointer(userptr));
+        GCBlockHeader* header = GetBlockHeader(userptr);
+        size_t size = GC::Size(userptr);
+
+        uint32_t flags = 0;
+        if (bits & kVirtualGCTrace)
+            flags |= kObjectExact;
+        else if (header->containsPointers)
+            flags |= kObjectConservative;
+        if (header->rcobject)
+            flags |= kObjectRC;
+        if (bits & kFinalizable)
+            flags |= kObjectFinalized;
+
+        uint32_t type = TypeOf(userptr, alloc, bits);
+
+        putc('O', fp);
+        WriteAddress(uintptr_t(userptr), previousObject);
+        WriteUnsigned(size);
+        WriteUnsigned(type);
+        WriteUnsigned(flags);
+        previousObject = uintptr_t(userptr);
+        numObjects++;
+
+        source = uintptr_t(userptr);
+        if (flags & kObjectExact)
+            TraceObject(userptr);
+        else if (flags & kObjectConservative)
+            ScanConservatively(userptr, size);
+    }
+
+    void HeapSnapshotWriter::WriteRoots()
+    {
+        {
+            MMGC_LOCK(gc->m_rootListLock);
+            for (GCRoot* r = gc->m_roots; r != NULL; r = r->next) {
+                if (r->IsExactlyTraced()) {
+                    putc('R', fp);
+                    WriteUnsigned(kRootExact);
+                    WriteAddress(uintptr_t(r), 0);
+                    source = uintptr_t(r);
+                    r->gcTrace(gc, 0);
+                }
+                else {
+                    const void* object;
+                    uint32_t size;
+                    bool isStackMemory;
+                    r->GetConservativeWorkItem(object, size, isStackMemory);
+                    if (object == NULL)
+                        continue;
+                    putc('R', fp);
+                    WriteUnsigned(kRootConservative);
+                    WriteAddress(uintptr_t(object), 0);
+                    source = uintptr_t(object);
+                    ScanConservatively(object, size);
+                }
+            }
+        }
+        VMPI_callWithRegistersSaved(HeapSnapshotWriter::DoWriteStack, this);
+    }
+
+    /*static*/
+    void HeapSnapshotWriter::DoWriteStack(void* stackPointer, void* arg)
+    {
+        HeapSnapshotWriter* self = (HeapSnapshotWriter*)arg;
+        char* stackBase = (char*)self->gc->GetStackTop();
+        putc('R', self->fp);
+        self->WriteUnsigned(kRootStack);
+        self->WriteAddress(uintptr_t(stackPointer), 0);
+        self->source = uintptr_t(stackPointer);
+        self->ScanConservatively(stackPointer, stackBase - (char*)stackPointer);
+    }
+
+    void HeapSnapshotWriter::TraceObject(const void* userptr)
+    {
+        GCTraceableBase* obj = (GCTraceableBase*)userptr;
+        for ( size_t cursor=0 ; obj->gcTrace(gc, cursor) ; cursor++ )
+            ;
+    }
+
+    void HeapSnapshotWriter::ScanConservatively(const void* start, size_t size)
+    {
+        const uintptr_t* p = (const uintptr_t*)(uintptr_t(start) & ~(sizeof(uintptr_t)-1));
+        const uintptr_t* limit = (const uintptr_t*)((const char*)start + size);
+        for ( ; p < limit ; p++ )
+            Edge(*p);
+    }
+
+    void HeapSnapshotWriter::VisitLocation(uintptr_t* loc)
+    {
+        if (!learning)
+            Edge(*loc & ~uintptr_t(7));
+    }
+
+    void HeapSnapshotWriter::VisitAtom(avmplus::Atom* loc)
+    {
+        avmplus::Atom a = *loc;
+        uint32_t kind = 0;
+        switch (a & 7)
+        {
+            case avmplus::AtomConstants::kObjectType:
+                kind = kKindObject;
+                break;
+            case avmplus::AtomConstants::kStringType:
+                kind = kKindString;
+                break;
+            case avmplus::AtomConstants::kNamespaceType:
+                kind = kKindNamespace;
+                break;
+            case avmplus::AtomConstants::kSpecialBibopType:
+            case avmplus::AtomConstants::kDoubleType:
+                break;
+            default:
+                return;
+        }
+
+        if (!learning) {
+            Edge(a & ~uintptr_t(7));
+            return;
+        }
+        if (kind == 0)
+            return;
+
+        const void* target = FindObject(a & ~uintptr_t(7));
+        if (target != NULL && target == (const void*)(a & ~uintptr_t(7)) && vtableKinds.get(*(const void**)target) == NULL)
+            vtableKinds.put(*(const void**)target, (const void*)uintptr_t(kind));
+    }
+
+    void HeapSnapshotWriter::VisitConservativeLocation(uintptr_t* loc)
+    {
+        if (!learning)
+            Edge(*loc);
+    }
+
+    void HeapSnapshotWriter::Edge(uintptr_t val)
+    {
+        const void* target = FindObject(val);
+        if (target == NULL)
+            return;
+        putc('E', fp);
+        WriteAddress(uintptr_t(target), source);
+        numEdges++;
+    }
+
+    const void* HeapSnapshotWriter::FindObject(uintptr_t val)
+    {
+        const void* item = (const void*)val;
+        if (!gc->IsPointerToGCPage(item))
+            return NULL;
+        const void* userptr = gc->FindBeginningGuarded(item, true);
+        if (userptr == NULL)
+            return NULL;
+        if ((GC::GetGCBits(GetRealPointer(userptr)) & (kMark|kQueued)) == (kMark|kQueued))
+            return NULL;    // On a free list
+        return userptr;
+    }
+
+    uint32_t HeapSnapshotWriter::TypeOf(const void* userptr, GCAlloc* alloc, gcbits_t bits)
+    {
+        if (alloc != NULL && alloc == gc->bibopAllocFloat)
+            return kTypeFloat;
+        if (alloc != NULL && alloc == gc->bibopAllocFloat4)
+            return kTypeFloat4;
+
+        GCBlockHeader* header = GetBlockHeader(userptr);
+        if (!(bits & (kVirtualGCTrace|kFinalizable)) && !header->rcobject)
+            return header->containsPointers ? kTypeConservative : kTypeLeaf;
+
+        const void* vtable = *(const void**)userptr;
+        switch (uintptr_t(vtableKinds.get(vtable)))
+        {
+            case kKindObject: {
+                avmplus::Traits* traits = ((avmplus::ScriptObject*)userptr)->vtable->traits;
+                return Type(traits, traits, NULL);
+            }
+            case kKindString:
+                return kTypeString;
+            case kKindNamespace:
+                return kTypeNamespace;
+        }
+
+        char name[64];
+        VMPI_snprintf(name, sizeof(name), "(C++ vtable %p)", vtable);
+        return Type(vtable, NULL, name);
+    }
+
+    // The number of bytes of 's' in UTF-8.
+    static uint32_t UTF8Length(avmplus::String* s)
+    {
+        uint32_t n = 0;
+        int32_t len = s != NULL ? s->length() : 0;
+        for (int32_t i=0 ; i < len ; i++) {
+            wchar c = s->charAt(i);
+            n += c < 0x80 ? 1 : c < 0x800 ? 2 : 3;
+        }
+        return n;
+    }
+
+    uint32_t HeapSnapshotWriter::Type(const void* key, avmplus::Traits* traits, const char* name)
+    {
+        uint32_t id = uint32_t(uintptr_t(types.get(key)));
+        if (id != 0)
+            return id;
+        id = nextType++;
+        types.put(key, (const void*)uintptr_t(id));
+
+        putc('T', fp);
+        WriteUnsigned(id);
+        if (traits != NULL) {
+            // "uri::name", or "name" in the public namespace.
+            avmplus::Namespacep ns = traits->ns();
+            avmplus::Stringp uri = ns != NULL ? ns->getURI() : NULL;
+            uint32_t uriLength = UTF8Length(uri);
+            WriteUnsigned(uriLength + (uriLength > 0 ? 2 : 0) + UTF8Length(traits->name()));
+            if (uriLength > 0) {
+                WriteString(uri);
+                fputs("::", fp);
+            }
+            WriteString(traits->name());
+        }
+        else {
+            WriteUnsigned(VMPI_strlen(name));
+            fputs(name, fp);
+        }
+        return id;
+    }
+
+    void HeapSnapshotWriter::WriteString(avmplus::String* s)
+    {
+        int32_t len = s != NULL ? s->length() : 0;
+        for (int32_t i=0 ; i < len ; i++) {
+            wchar c = s->charAt(i);
+            if (c < 0x80) {
+                putc(int(c), fp);
+            }
+            else if (c < 0x800) {
+                putc(0xC0 | (c >> 6), fp);
+                putc(0x80 | (c & 0x3F), fp);
+            }
+            else {
+                putc(0xE0 | (c >> 12), fp);
+                putc(0x80 | ((c >> 6) & 0x3F), fp);
+                putc(0x80 | (c & 0x3F), fp);
+            }
+        }
+    }
+
+    void HeapSnapshotWriter::WriteUnsigned(uint64_t v)
+    {
+        do {
+            uint8_t b = uint8_t(v & 0x7F);
+            v >>= 7;
+            if (v != 0)
+                b |= 0x80;
+            putc(b, fp);
+        } while (v != 0);
+    }
+
+    void HeapSnapshotWriter::WriteAddress(uintptr_t address, uintptr_t base)
+    {
+        int64_t delta = int64_t(address) - int64_t(base);
+        WriteUnsigned((uint64_t(delta) << 1) ^ uint64_t(delta >> 63));
+    }
+}
@@ -0,0 +1,170 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCHeapSnapshot__
+#define __GCHeapSnapshot__
+
+namespace avmplus
+{
+    class String;
+    class Traits;
+#ifdef VMCFG_SELFTEST
+    namespace ST_mmgc_heapsnapshot { class ST_mmgc_heapsnapshot; }
+#endif
+}
+
+namespace MMgc
+{
+    /**
+     * Writes a heap snapshot for offline analysis (GC::WriteHeapSnapshot).
+     *
+     * The snapshot is written after a full collection, which leaves every object
+     * that is not on a free list live.  The objects are found with GCAllocIterator
+     * and GCLargeAllocIterator, and the references of exactly traced objects and
+     * roots by running their tracers with the writer installed as GC::m_edgeVisitor.
+     * Conservatively traced objects and roots, and the native stack, are scanned
+     * for words that point into live objects, the way the marker scans them.
+     *
+     * The snapshot is streamed to the file as the heap is walked.  The writer
+     * allocates no managed memory, and the only unmanaged memory it allocates is
+     * for its type tables, which grow with the number of types and not with the
+     * size of the heap.
+     *
+     * Objects are typed by their C++ vtable, the first word of every object that
+     * is finalized or exactly traced.  The vtables of the C++ classes of
+     * ScriptObject, String, and Namespace are learned in a first pass over the
+     * heap from the objects that atoms reference; the ScriptObjects are then typed
+     * by the name of their AS3 class.  Other C++ classes are named by the address
+     * of their vtable, and objects without a vtable by how they are traced.
+     *
+     * The file starts with the eight bytes "AVMHEAP" NUL and the format version.
+     * Then follows a sequence of records, each a tag byte followed by unsigned
+     * LEB128 numbers; addresses are written as the zigzag-encoded difference to a
+     * base address given below:
+     *
+     *   'T' id length bytes            A type; the name is 'length' bytes of UTF-8.
+     *   'R' kind address               A root (kRoot* below).  The base is 0.
+     *   'O' address size type flags    An object (kObject* below).  The base is the
+     *                                  previous object's address, or 0.
+     *   'E' address                    A reference from the preceding root or object
+     *                                  to the object at 'address'.  The base is the
+     *                                  address of the root or object.
+     *   'Z' objects edges              The end, with the numbers of 'O' and 'E' records.
+     *
+     * Types are defined before they are used.  utils/heapsnapshot.py reads the
+     * format, and computes dominators and retained sizes.
+     */
+    class HeapSnapshotWriter : public GCEdgeVisitor
+    {
+#ifdef VMCFG_SELFTEST
+        friend class avmplus::ST_mmgc_heapsnapshot::ST_mmgc_heapsnapshot;
+#endif
+    public:
+        static const uint32_t kVersion = 1;
+
+        // Root kinds.
+        enum {
+            kRootExact = 0,             // An exactly traced GCRoot
+            kRootConservative = 1,      // A conservatively traced GCRoot
+            kRootStack = 2              // The native stack, at the stack pointer
+        };
+
+        // Object flags.
+        enum {
+            kObjectExact = 1,           // References found by the object's tracer
+            kObjectConservative = 2,    // References found by scanning the object
+            kObjectRC = 4,              // Reference counted
+            kObjectFinalized = 8        // Has a destructor
+        };
+
+        // Types of objects without a vtable.
+        enum {
+            kTypeLeaf = 1,              // Contains no pointers
+            kTypeConservative = 2,      // Scanned conservatively
+            kTypeFloat = 3,
+            kTypeFloat4 = 4,
+            kTypeString = 5,
+            kTypeNamespace = 6,
+            kFirstDynamicType = 7
+        };
+
+        HeapSnapshotWriter(GC* gc);
+        virtual ~HeapSnapshotWriter();
+
+        /**
+         * Write the snapshot to 'filename'.  The caller must have run a full
+         * collection.
+         *
+         * @return false if the file could not be written.
+         */
+        bool Write(const char* filename);
+
+        virtual void VisitLocation(uintptr_t* loc);
+        virtual void VisitAtom(avmplus::Atom* loc);
+        virtual void VisitConservativeLocation(uintptr_t* loc);
+
+    private:
+        // Kinds of C++ classes learned from atoms, the values in vtableKinds.
+        enum {
+            kKindObject = 1,
+            kKindString = 2,
+            kKindNamespace = 3
+        };
+
+        // Run 'visit' on every object in the heap.
+        void ForEachObject(void (HeapSnapshotWriter::*visit)(const void* userptr, GCAlloc* alloc));
+
+        // First pass: trace the object to learn the vtables of the objects that
+        // atoms reference.
+        void LearnObject(const void* userptr, GCAlloc* alloc);
+
+        // Second pass: write the object and its references.
+        void WriteObject(const void* userptr, GCAlloc* alloc);
+
+        // Write the roots and their references.
+        void WriteRoots();
+
+        // VMPI_callWithRegistersSaved callback, writes the native stack root.
+        static void DoWriteStack(void* stackPointer, void* arg);
+
+        // Run the tracer of the exactly traced object 'userptr'.
+        void TraceObject(const void* userptr);
+
+        // Write an edge for every word in [start, start+size) that points into a
+        // live object.
+        void ScanConservatively(const void* start, size_t size);
+
+        // Write an edge to the object that 'val' points into, if any.
+        void Edge(uintptr_t val);
+
+        // @return the start of the live object that 'val' points into, or NULL.
+        const void* FindObject(uintptr_t val);
+
+        // @return the type of the object at 'userptr', writing it if it is new.
+        uint32_t TypeOf(const void* userptr, GCAlloc* alloc, gcbits_t bits);
+
+        // @return the type keyed by 'key', writing it if it is new.  The name is
+        // the AS3 class name of 'traits' if it is not NULL, otherwise 'name'.
+        uint32_t Type(const void* key, avmplus::Traits* traits, const char* name);
+
+        void WriteString(avmplus::String* s);
+        void WriteUnsigned(uint64_t v);
+        void WriteAddress(uintptr_t address, uintptr_t base);
+
+        GC* const gc;
+        FILE* fp;
+        bool learning;                  // First pass, nothing is written
+        uintptr_t source;               // The root or object whose references are visited
+        uintptr_t previousObject;       // The base address of the next 'O' record
+        uint32_t nextType;
+        uint64_t numObjects;
+        uint64_t numEdges;
+        GCHashtable vtableKinds;        // C++ vtable -> kKind*
+        GCHashtable types;              // C++ vtable or Traits* -> type id
+    };
+}
+
+#endif /* __GCHeapSnapshot__ */
@@ -93,6 +93,15 @@ namespace MMgc
         }
         return false;
     }
+
+    REALLY_INLINE bool GCLargeAllocIterator::GetNextAllocatedObject(void*& out_ptr)
+    {
+        if (block == NULL)
+            return false;
+        out_ptr = GetUserPointer(block->GetObject());
+        block = GCLargeAlloc::Next(block);
+        return true;
+    }
 }
 
 #endif /* __GCLargeAlloc_inlines__ */
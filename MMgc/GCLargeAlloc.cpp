@@ -120,6 +120,10 @@ namespace MMgc
 #endif
             m_totalAllocatedBytes += computedSize;
         }
+
+        if ((m_gc->allocationSampleCountdown -= int32_t(computedSize)) < 0)
+            m_gc->SampleAllocation(item, MMGC_RETURN_ADDRESS());
+
         return item;
     }
 
@@ -140,7 +144,7 @@ namespace MMgc
         // We can't allow free'ing something during Sweeping, otherwise alloc counters
         // get decremented twice and destructors will be called twice.
         GCAssert(m_gc->collecting == false || m_gc->marking == true);
-        if (m_gc->marking && (m_gc->collecting || IsProtectedAgainstFree(b))) {
+        if (m_gc->BarrierActive() && (m_gc->collecting || IsProtectedAgainstFree(b))) {
             m_gc->AbortFree(GetUserPointer(item));
             return;
         }
@@ -253,8 +257,9 @@ namespace MMgc
                 m_totalAllocatedBytes -= b->size;
                 continue;
             }
-            // clear marks
-            b->flags[0] &= ~(kMark|kQueued);
+            // clear marks, unless they are sticky (generational mode)
+            if (!m_gc->generational)
+                b->flags[0] &= ~(kMark|kQueued);
             prev = (LargeBlock**)(&b->next);
         }
         m_startedFinalize = false;
@@ -16,6 +16,7 @@ namespace MMgc
     {
         friend class GC;
         friend class GCLargeAllocIterator;
+        friend class AllocationSampler;
     private:
 
         // Additional per-object flags for large objects.  These are stored in flags[1].
@@ -130,6 +131,10 @@ namespace MMgc
 
         bool GetNextMarkedObject(void*& out_ptr);
 
+        // Like GetNextMarkedObject, but returns every object, whether it contains
+        // pointers or not.  Only meaningful when no objects are waiting to be swept.
+        bool GetNextAllocatedObject(void*& out_ptr);
+
     private:
         GCLargeAlloc* const alloc;
         GCLargeAlloc::LargeBlock* block;
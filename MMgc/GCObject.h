@@ -399,7 +399,16 @@ namespace MMgc
      * on, as it makes assignments and calls less visible.
      *
      *
-     * The operators and methods here are exactly like those of GCObject.
+     * The operators and methods here are exactly like those of GCObject, with
+     * one addition: an exactly traced object allocated with the kMovableObject
+     * flag may be moved by the GC if GCConfig::compaction is set.  Such an object
+     * must be referenced only from exactly traced fields, from the stack, from
+     * roots, and from conservatively traced objects whose stores go through the
+     * write barrier (objects reached conservatively are not moved in that
+     * collection).  It must not be referenced through interior pointers except
+     * from the stack, and its address must not be used as a hash key or stored
+     * anywhere else.
+     * Objects larger than GC::kLargestAlloc are never moved.  See GCCompactor.h.
      */
     class GCTraceableObject : public GCTraceableBase
     {
@@ -409,6 +418,7 @@ namespace MMgc
         static void *operator new(size_t size, GC *gc, GCExactFlag flag, size_t extra) GNUC_ONLY(throw());
         static void *operator new(size_t size, GC *gc, size_t extra) GNUC_ONLY(throw());
         static void *operator new(size_t size, GC *gc, GCExactFlag flag) GNUC_ONLY(throw());
+        static void *operator new(size_t size, GC *gc, GCExactFlag flag, GCMovableFlag movable) GNUC_ONLY(throw());
         static void *operator new(size_t size, GC *gc) GNUC_ONLY(throw());
         static void operator delete(void *gcObject);
         
@@ -492,6 +502,11 @@ namespace MMgc
         return gc->AllocPtrZeroExact(size, kGCTraceableObjectNewPartition);
     }
     
+    REALLY_INLINE void *GCTraceableObject::operator new(size_t size, GC *gc, GCExactFlag, GCMovableFlag) GNUC_ONLY(throw())
+    {
+        return gc->Alloc(size, GC::kContainsPointers|GC::kZero|GC::kInternalExact|GC::kInternalMovable, kGCTraceableObjectNewPartition);
+    }
+    
     REALLY_INLINE void GCTraceableObject::operator delete(void *gcObject)
     {
         GC::GetGC(gcObject)->FreeFromDelete(gcObject);
@@ -0,0 +1,411 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MMgc.h"
+
+namespace MMgc
+{
+    // A marker considers sharing work after every kShareInterval items it processes
+    // (must be a power of 2), and only if its stack holds at least kShareThreshold
+    // words.  Sharing is cheap but not free; these values keep the cost in the noise
+    // for a busy marker while letting an idle marker get work quickly.
+    static const uint32_t kShareInterval = 64;
+    static const uint32_t kShareThreshold = 32;
+
+    void GCMarkerWork::Clear()
+    {
+        objectsExact = 0;
+        bytesExact = 0;
+        objectsConservative = 0;
+        bytesConservative = 0;
+        objectsPointerfree = 0;
+        bytesPointerfree = 0;
+        steals = 0;
+        chunks = 0;
+        busyTicks = 0;
+        rootAndStackWords = 0;
+        rootAndStackTicks = 0;
+    }
+
+    GCParallelMarker::Marker::Marker(GCParallelMarker* owner, uint32_t index, GCMarkStack* stack)
+        : owner(owner)
+        , index(index)
+        , stack(stack)
+        , thread(NULL)
+        , epoch(0)
+        , totalBytes(0)
+        , totalTicks(0)
+        , totalSteals(0)
+        , totalChunks(0)
+        , shared(0)
+    {
+        work.Clear();
+        VMPI_lockInit(&lock);
+    }
+
+    GCParallelMarker::Marker::~Marker()
+    {
+        VMPI_lockDestroy(&lock);
+    }
+
+    void GCParallelMarker::Marker::run()
+    {
+        owner->HelperLoop(this);
+    }
+
+    GCParallelMarker::GCParallelMarker(GC* gc, uint32_t numHelpers)
+        : m_gc(gc)
+        , m_numHelpers(numHelpers < kMaxMarkers ? numHelpers : kMaxMarkers-1)
+        , m_numMarkers(1)
+        , m_helpersStarted(false)
+        , m_drains(0)
+        , m_idle(0)
+        , m_running(0)
+        , m_epoch(0)
+        , m_shutdown(false)
+        , m_numRanges(0)
+    {
+        VMPI_lockInit(&m_rangeLock);
+        VMPI_lockInit(&m_segmentLock);
+        VMPI_memset(m_markers, 0, sizeof(m_markers));
+        m_markers[0] = mmfx_new(Marker(this, 0, &gc->m_incrementalWork));
+        for ( uint32_t i=1 ; i <= m_numHelpers ; i++ ) {
+#ifdef MMGC_MARKSTACK_ALLOWANCE
+            GCMarkStack* stack = mmfx_new(GCMarkStack(0));
+#else
+            GCMarkStack* stack = mmfx_new(GCMarkStack());
+#endif
+            stack->SetDeadItem(gc->emptyWeakRef);
+            stack->SetSegmentLock(&m_segmentLock);
+            m_markers[i] = mmfx_new(Marker(this, i, stack));
+        }
+    }
+
+    GCParallelMarker::~GCParallelMarker()
+    {
+        SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+            m_shutdown = true;
+            locker.notifyAll();
+        }
+        for ( uint32_t i=1 ; i <= m_numHelpers ; i++ ) {
+            Marker* m = m_markers[i];
+            if (m->thread != NULL) {
+                m->thread->join();
+                mmfx_delete(m->thread);
+            }
+            mmfx_delete(m->stack);
+            mmfx_delete(m);
+        }
+        mmfx_delete(m_markers[0]);
+        VMPI_lockDestroy(&m_segmentLock);
+        VMPI_lockDestroy(&m_rangeLock);
+    }
+
+    uint32_t GCParallelMarker::GetNumMarkers()
+    {
+        return m_numMarkers;
+    }
+
+    void GCParallelMarker::StartHelpers()
+    {
+        if (m_helpersStarted)
+            return;
+        m_helpersStarted = true;
+
+        // Start as many helpers as we can; the markers in use must be contiguous.
+        for ( uint32_t i=1 ; i <= m_numHelpers ; i++ ) {
+            Marker* m = m_markers[i];
+            m->epoch = m_epoch;
+            m->thread = mmfx_new(vmbase::VMThread("GCParallelMarker", m));
+            if (!m->thread->start()) {
+                mmfx_delete(m->thread);
+                m->thread = NULL;
+                break;
+            }
+            m_numMarkers++;
+        }
+    }
+
+    void GCParallelMarker::Mark()
+    {
+        GCAssert(!m_gc->m_markingInParallel);
+
+        StartHelpers();
+
+        for ( uint32_t i=0 ; i < m_numMarkers ; i++ ) {
+            GCAssert(m_markers[i]->shared == 0);
+            GCAssert(m_markers[i]->stack->IsEmpty() || i == 0);
+            m_markers[i]->work.Clear();
+        }
+        GCAssert(m_numRanges == 0);
+        m_idle.set(0);
+        m_running.set(int32_t(m_numMarkers-1));
+        m_drains++;
+
+        m_gc->m_incrementalWork.SetSegmentLock(&m_segmentLock);
+        m_gc->m_markingInParallel = true;
+        m_current = m_markers[0];
+
+        if (m_numMarkers > 1) {
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                m_epoch++;
+                locker.notifyAll();
+            }
+        }
+
+        Drain(m_markers[0]);
+
+        // The helpers have seen termination but may still be returning from Drain;
+        // none of them will touch the mark stacks again, but wait for them anyway so
+        // that their mark bit updates and work counts are visible here.
+        if (m_numMarkers > 1) {
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                while (m_running.get() > 0)
+                    locker.wait();
+            }
+        }
+
+        GCAssert(m_numRanges == 0);
+        m_current = NULL;
+        m_gc->m_markingInParallel = false;
+        m_gc->m_incrementalWork.SetSegmentLock(NULL);
+
+        // Free the helpers' cached segments, as ClearMarkStack does for the GC's own stack.
+        for ( uint32_t i=1 ; i < m_numMarkers ; i++ )
+            m_markers[i]->stack->Clear();
+
+        SignalWork();
+    }
+
+    void GCParallelMarker::HelperLoop(Marker* m)
+    {
+        m_current = m;
+        for (;;) {
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                while (!m_shutdown && m_epoch == m->epoch)
+                    locker.wait();
+                if (m_shutdown)
+                    return;
+                m->epoch = m_epoch;
+            }
+
+            Drain(m);
+
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                if (m_running.decAndGet() == 0)
+                    locker.notifyAll();
+            }
+        }
+    }
+
+    // Termination: a marker becomes idle only when its stack and its own steal queue
+    // are empty and it has failed to steal.  Only a marker that is not idle adds to
+    // a steal queue (its own) or to the range table, and a marker that leaves the idle
+    // state to steal does so before it takes anything.  So when every marker is idle
+    // at the same time all stacks, queues, and ranges are empty and no more work can
+    // appear.
+
+    void GCParallelMarker::Drain(Marker* m)
+    {
+        const int32_t numMarkers = int32_t(m_numMarkers);
+        for (;;) {
+            DrainLocal(m);
+            if (FindWork(m))
+                continue;
+
+            m_idle.inc();
+            for (;;) {
+                if (m_idle.get() == numMarkers)
+                    return;
+                if (AnyWorkShared()) {
+                    m_idle.dec();
+                    if (FindWork(m))
+                        break;
+                    m_idle.inc();
+                }
+                VMPI_spinloopPause();
+            }
+        }
+    }
+
+    void GCParallelMarker::DrainLocal(Marker* m)
+    {
+        GCMarkStack* stack = m->stack;
+        if (stack->IsEmpty())
+            return;
+
+        uint64_t start = VMPI_getPerformanceCounter();
+        uint32_t n = 0;
+        while (!stack->IsEmpty()) {
+            const void* ptr;
+            if ((ptr = stack->Pop_GCObject()) != NULL)
+                m_gc->MarkItem_GCObject(ptr);
+            else
+                m_gc->MarkTopItem_NonGCObject();
+            if ((++n & (kShareInterval-1)) == 0 && m->shared == 0 && m_idle.get() > 0)
+                Share(m);
+        }
+        m->work.busyTicks += VMPI_getPerformanceCounter() - start;
+    }
+
+    void GCParallelMarker::Share(Marker* m)
+    {
+        GCMarkStack* stack = m->stack;
+        uint32_t limit = stack->Count();
+        if (limit < kShareThreshold)
+            return;
+        limit /= 2;
+        if (limit > kStealQueueSize)
+            limit = kStealQueueSize;
+
+        // Only plain GCObject items are shared; stop at the first item that is not one.
+        VMPI_lockAcquire(&m->lock);
+        GCAssert(m->shared == 0);
+        uint32_t n = 0;
+        while (n < limit && !stack->IsEmpty()) {
+            const void* ptr = stack->Pop_GCObject();
+            if (ptr == NULL)
+                break;
+            m->queue[n++] = ptr;
+        }
+        m->shared = n;
+        VMPI_lockRelease(&m->lock);
+    }
+
+    bool GCParallelMarker::Steal(Marker* thief, Marker* victim)
+    {
+        if (victim->shared == 0)
+            return false;
+
+        const void* items[kStealQueueSize];
+        uint32_t n;
+
+        VMPI_lockAcquire(&victim->lock);
+        uint32_t avail = victim->shared;
+        n = (victim == thief) ? avail : (avail + 1) / 2;
+        victim->shared = avail - n;
+        VMPI_memcpy(items, victim->queue + (avail - n), n * sizeof(const void*));
+        VMPI_lockRelease(&victim->lock);
+
+        if (n == 0)
+            return false;
+
+        // The items are queued (claimed) already, so they go straight onto the stack.
+        for ( uint32_t i=0 ; i < n ; i++ ) {
+            if (!thief->stack->Push_GCObject(items[i]))
+                m_gc->SignalMarkStackOverflow_GCObject(items[i]);
+        }
+        if (victim != thief)
+            thief->work.steals++;
+        return true;
+    }
+
+    bool GCParallelMarker::ShareRange(const void* p, uint32_t size, GCMarkStack::TypeTag type, const void* baseptr)
+    {
+        GCAssert(type == GCMarkStack::kStackMemory || type == GCMarkStack::kLargeRootChunk);
+
+        VMPI_lockAcquire(&m_rangeLock);
+        bool shared = m_numRanges < kMaxSharedRanges;
+        if (shared) {
+            SharedRange& r = m_ranges[m_numRanges];
+            r.next = (const char*)p;
+            r.limit = (const char*)p + size;
+            r.baseptr = baseptr;
+            r.type = type;
+            m_numRanges++;
+        }
+        VMPI_lockRelease(&m_rangeLock);
+        return shared;
+    }
+
+    bool GCParallelMarker::TakeRangeChunk(Marker* m)
+    {
+        if (m_numRanges == 0)
+            return false;
+
+        const void* p = NULL;
+        uint32_t size = 0;
+        const void* baseptr = NULL;
+        GCMarkStack::TypeTag type = GCMarkStack::kStackMemory;
+
+        VMPI_lockAcquire(&m_rangeLock);
+        if (m_numRanges > 0) {
+            SharedRange& r = m_ranges[m_numRanges-1];
+            p = r.next;
+            size = uint32_t(r.limit - r.next);
+            if (size > kShareRangeChunk)
+                size = kShareRangeChunk;
+            baseptr = r.baseptr;
+            type = r.type;
+            r.next += size;
+            if (r.next == r.limit)
+                m_numRanges--;
+        }
+        VMPI_lockRelease(&m_rangeLock);
+
+        if (p == NULL)
+            return false;
+
+        bool pushed = (type == GCMarkStack::kStackMemory) ? m->stack->Push_StackMemory(p, size, baseptr)
+                                                          : m->stack->Push_LargeRootChunk(p, size, baseptr);
+        if (!pushed)
+            m_gc->SignalMarkStackOverflow_NonGCObject();
+        m->work.chunks++;
+        return true;
+    }
+
+    bool GCParallelMarker::FindWork(Marker* m)
+    {
+        if (Steal(m, m))
+            return true;
+        if (TakeRangeChunk(m))
+            return true;
+        for ( uint32_t i=1 ; i < m_numMarkers ; i++ ) {
+            if (Steal(m, m_markers[(m->index + i) % m_numMarkers]))
+                return true;
+        }
+        return false;
+    }
+
+    bool GCParallelMarker::AnyWorkShared()
+    {
+        if (m_numRanges != 0)
+            return true;
+        for ( uint32_t i=0 ; i < m_numMarkers ; i++ ) {
+            if (m_markers[i]->shared != 0)
+                return true;
+        }
+        return false;
+    }
+
+    void GCParallelMarker::SignalWork()
+    {
+        for ( uint32_t i=0 ; i < m_numMarkers ; i++ ) {
+            Marker* m = m_markers[i];
+            m_gc->policy.signalParallelMarkWork(m->work);
+            m->totalBytes += uint64_t(m->work.bytesExact) + m->work.bytesConservative + m->work.bytesPointerfree;
+            m->totalTicks += m->work.busyTicks;
+            m->totalSteals += m->work.steals;
+            m->totalChunks += m->work.chunks;
+        }
+    }
+
+    void GCParallelMarker::DumpStats()
+    {
+        GCLog("[mem] \tparallel mark: %u markers, %u drains\n", m_numMarkers, m_drains);
+        for ( uint32_t i=0 ; i < m_numMarkers ; i++ ) {
+            Marker* m = m_markers[i];
+            uint64_t millis = GC::ticksToMillis(m->totalTicks);
+            GCLog("[mem] \t  marker %u: %u kb in %u ms (%u mb/s), %u steals, %u root/stack chunks\n",
+                  i,
+                  uint32_t(m->totalBytes >> 10),
+                  uint32_t(millis),
+                  millis == 0 ? 0 : uint32_t((m->totalBytes >> 10) / millis),
+                  uint32_t(m->totalSteals),
+                  uint32_t(m->totalChunks));
+        }
+    }
+}
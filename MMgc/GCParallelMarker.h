@@ -0,0 +1,236 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCParallelMarker__
+#define __GCParallelMarker__
+
+namespace MMgc
+{
+    /**
+     * Mark work performed by one marker thread while the mark stack is drained in
+     * parallel.  The counts mirror the ones GCPolicyManager keeps for serial marking
+     * and are folded into the policy manager when the drain completes.
+     */
+    struct GCMarkerWork
+    {
+        void Clear();
+
+        uint32_t objectsExact;
+        uint32_t bytesExact;
+        uint32_t objectsConservative;
+        uint32_t bytesConservative;
+        uint32_t objectsPointerfree;
+        uint32_t bytesPointerfree;
+        uint32_t steals;        // Successful steals from other markers' steal queues
+        uint32_t chunks;        // Chunks of shared root and stack ranges taken
+        uint64_t busyTicks;     // Time spent processing mark work, excluding time spent looking for work
+        uint64_t rootAndStackWords;     // See GCPolicyManager::signalRootAndStackScan
+        uint64_t rootAndStackTicks;
+    };
+
+    /**
+     * Parallel drain of the GC's mark stack.
+     *
+     * A GCParallelMarker owns a set of helper threads that join the collector's own
+     * thread when GC::Mark() drains the mark stack to completion at the end of a
+     * collection (FinishIncrementalMark).  The collector thread is marker 0 and works
+     * on GC::m_incrementalWork; every helper has a private GCMarkStack.
+     *
+     * Load balancing is by work stealing.  A marker that has surplus work while some
+     * other marker is idle moves a batch of GCObject items off the top of its stack
+     * into its steal queue, a small lock-protected array.  A marker that runs out of
+     * work first reclaims its own steal queue and then steals half of some other
+     * marker's queue.  Only plain GCObject items are ever moved between markers:
+     * split items, protectors, and stack or root chunks stay on the stack that they
+     * were pushed onto, so the ordering invariants that the marker depends on (see
+     * GCStack.h and the comments above GC::SplitItem_ConservativeOrNonGCObject) hold
+     * within each stack.  The drain terminates when all markers are idle at once.
+     *
+     * The exception is a large root or stack area, which would otherwise be scanned
+     * piecemeal by the marker that popped it.  When such an item is split, the rest
+     * of it is entered into a shared range table instead of being pushed back (see
+     * ShareRange), and markers looking for work take kShareRangeChunk bytes at a time
+     * from the table onto their own stacks.  This is safe because roots and stacks
+     * can't go away while the mutator is stopped, so the protectors don't matter.
+     *
+     * The mutator is stopped for the duration of the drain.  Objects are claimed for
+     * marking by setting their queued (or mark) bit atomically, so every object is
+     * pushed and traced by exactly one marker; see GC::ClaimForMarking.  Mark stack
+     * segments are allocated under a lock private to the marker.
+     *
+     * The incremental marker (GC::IncrementalMark) remains serial: it is time-sliced,
+     * and its work must be left on m_incrementalWork between slices.
+     */
+    class GCParallelMarker
+    {
+    public:
+        // Maximum number of markers, including the collector's own thread.
+        static const uint32_t kMaxMarkers = 16;
+
+        // Number of entries in each marker's steal queue.
+        static const uint32_t kStealQueueSize = 256;
+
+        // Root and stack areas with at least kShareRangeThreshold bytes left to scan
+        // are shared, in chunks of kShareRangeChunk bytes.  At most kMaxSharedRanges
+        // areas are shared at a time.
+        static const uint32_t kShareRangeThreshold = 32*1024;
+        static const uint32_t kShareRangeChunk = 8*1024;
+        static const uint32_t kMaxSharedRanges = 16;
+
+        /**
+         * Create a marker that will use up to 'numHelpers' helper threads; the number
+         * is capped at kMaxMarkers-1.  The threads are started on first use.
+         */
+        GCParallelMarker(GC* gc, uint32_t numHelpers);
+
+        /**
+         * Stop and join the helper threads.  Must not be called while a drain is in
+         * progress.
+         */
+        ~GCParallelMarker();
+
+        /**
+         * Drain the GC's mark stack on the calling thread and the helper threads, and
+         * signal the mark work to the policy manager.  Must be called on the collector
+         * thread with the mutator stopped.  If no helper thread could be started the
+         * stack is drained on the calling thread alone.
+         */
+        void Mark();
+
+        /**
+         * @return the number of markers that take part in a drain, including the
+         * collector thread.  This is 1 until the first drain has started the helpers.
+         */
+        uint32_t GetNumMarkers();
+
+        /**
+         * Enter the rest of a root or stack area that is being split, [p, p+size),
+         * into the shared range table.  Called by a marker during a drain; 'type' is
+         * GCMarkStack::kStackMemory or GCMarkStack::kLargeRootChunk.
+         *
+         * @return false if the table is full, in which case the caller must push the
+         * item as usual.
+         */
+        bool ShareRange(const void* p, uint32_t size, GCMarkStack::TypeTag type, const void* baseptr);
+
+        /**
+         * Print per-marker statistics for all drains to date, for -memstats.
+         */
+        void DumpStats();
+
+        /**
+         * Per-marker state.
+         */
+        class Marker : public vmbase::Runnable
+        {
+        public:
+            Marker(GCParallelMarker* owner, uint32_t index, GCMarkStack* stack);
+            virtual ~Marker();
+
+            // Entry point of the helper thread.
+            virtual void run();
+
+            GCParallelMarker* const owner;
+            const uint32_t index;
+            GCMarkStack* const stack;       // GC::m_incrementalWork for marker 0, otherwise owned
+            vmbase::VMThread* thread;       // NULL for marker 0 and for helpers that are not started
+            uint32_t epoch;                 // The last drain this helper took part in
+            GCMarkerWork work;              // Work done during the current drain
+
+            // Work done during all drains to date.
+            uint64_t totalBytes;
+            uint64_t totalTicks;
+            uint64_t totalSteals;
+            uint64_t totalChunks;
+
+            // The steal queue.  'shared' is written with 'lock' held but may be read
+            // without it as a hint.
+            vmpi_spin_lock_t lock;
+            volatile uint32_t shared;
+            const void* queue[kStealQueueSize];
+        };
+
+        /**
+         * @return the marker for the calling thread; only valid while a drain is
+         * in progress and only on a thread that takes part in it.
+         */
+        Marker* CurrentMarker() { return m_current; }
+
+    private:
+        // Start the helper threads if they have not been started.
+        void StartHelpers();
+
+        // The marking loop run by every marker for the duration of a drain.
+        void Drain(Marker* m);
+
+        // Process items from the marker's own stack until it is empty, sharing
+        // surplus work when other markers are idle.
+        void DrainLocal(Marker* m);
+
+        // Move a batch of GCObject items from the top of the marker's stack into its
+        // steal queue, if the queue is empty.
+        void Share(Marker* m);
+
+        // Move items from victim's steal queue onto thief's stack; take all of them if
+        // victim == thief, otherwise half.  Return true if anything was moved.
+        bool Steal(Marker* thief, Marker* victim);
+
+        // Move a chunk of a shared range onto the marker's stack.  Return true if
+        // there was one.
+        bool TakeRangeChunk(Marker* m);
+
+        // Try to obtain work, first from the marker's own steal queue, then from the
+        // shared ranges, and then from the other markers' queues.
+        bool FindWork(Marker* m);
+
+        // Return true if any marker's steal queue or the range table looks nonempty.
+        bool AnyWorkShared();
+
+        // Body of the helper threads.
+        void HelperLoop(Marker* m);
+
+        // Fold the per-marker work into the policy manager.
+        void SignalWork();
+
+        GC* const m_gc;
+        const uint32_t m_numHelpers;    // Helpers requested
+        uint32_t m_numMarkers;          // Markers in use: 1 + helpers started
+        bool m_helpersStarted;
+        uint32_t m_drains;              // Number of drains to date
+        Marker* m_markers[kMaxMarkers];
+
+        // Drain state, reset at the start of each drain.
+        vmbase::AtomicCounter32 m_idle;     // Number of markers that have run out of work
+        vmbase::AtomicCounter32 m_running;  // Number of helpers that have not finished the current drain
+
+        // Helper thread control, protected by m_monitor.
+        vmbase::WaitNotifyMonitor m_monitor;
+        uint32_t m_epoch;               // Incremented to start a drain
+        bool m_shutdown;                // Set to make the helpers exit
+
+        // The shared root and stack ranges.  m_numRanges is written with m_rangeLock
+        // held but may be read without it as a hint.
+        struct SharedRange
+        {
+            const char* next;           // Start of the part not yet taken
+            const char* limit;
+            const void* baseptr;
+            GCMarkStack::TypeTag type;
+        };
+        SharedRange m_ranges[kMaxSharedRanges];
+        volatile uint32_t m_numRanges;
+        vmpi_spin_lock_t m_rangeLock;
+
+        vmpi_spin_lock_t m_segmentLock; // Serializes mark stack segment allocation
+        GCThreadLocal<Marker*> m_current;
+
+    private: // not implemented
+        GCParallelMarker(const GCParallelMarker&);
+        GCParallelMarker& operator=(const GCParallelMarker&);
+    };
+}
+
+#endif /* __GCParallelMarker__ */
@@ -93,6 +93,28 @@ namespace MMgc
         bytesScannedPointerfreeLastCollection += uint32_t(nbytes);
     }
 
+    REALLY_INLINE void GCPolicyManager::signalParallelMarkWork(const GCMarkerWork& work)
+    {
+        objectsScannedExactlyLastCollection += work.objectsExact;
+        bytesScannedExactlyLastCollection += work.bytesExact;
+        objectsScannedConservativelyLastCollection += work.objectsConservative;
+        bytesScannedConservativelyLastCollection += work.bytesConservative;
+        objectsScannedPointerfreeLastCollection += work.objectsPointerfree;
+        bytesScannedPointerfreeLastCollection += work.bytesPointerfree;
+#ifdef MMGC_POLICY_PROFILING
+        rootAndStackWords += work.rootAndStackWords;
+        rootAndStackTicks += work.rootAndStackTicks;
+#endif
+    }
+
+#ifdef MMGC_POLICY_PROFILING
+    REALLY_INLINE void GCPolicyManager::signalRootAndStackScan(uint64_t words, uint64_t ticks)
+    {
+        rootAndStackWords += words;
+        rootAndStackTicks += ticks;
+    }
+#endif
+
     REALLY_INLINE void GCPolicyManager::signalFreeWork(size_t nbytes)
     {
         remainingMinorAllocationBudget += int32_t(nbytes);
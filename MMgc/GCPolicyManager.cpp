@@ -25,6 +25,11 @@ namespace MMgc
 #define R_INITIAL_VALUE (10*R_LOWER_LIMIT)
 #define GREEDY_TRIGGER (-(INT_MAX/2))               // must be <= 0 but should never go positive as a result of a single alloc action or multiple free actions
 
+    // Pause-target mode: the smallest mark quantum as a fraction of the target, and the
+    // highest allocation trigger.
+#define P_MIN_FRACTION 0.125
+#define T_UPPER_LIMIT 0.9
+
     GCConfig::GCConfig()
         : collectionThreshold(256) // 4KB blocks, that is, 1MB
         , markstackAllowance(0)
@@ -32,6 +37,16 @@ namespace MMgc
         , drc(true)
         , validateDRC(false)
         , incrementalValidation(false)
+        , markerThreads(0)
+        , backgroundSweep(false)
+        , generational(false)
+        , compaction(false)
+        , reapSlice(0)
+        , incrementalWeakRefs(false)
+        , exactStackFrames(false)
+        , allocationSampleInterval(0)
+        , sizeClasses(NULL)
+        , sizeClassStatistics(false)
         , mode(kIncrementalGC)
     {}
 
@@ -83,6 +98,8 @@ namespace MMgc
         , bytesScannedPointerfreeTotal(0)
         , start_time(0)
         , start_event(NO_EVENT)
+        , start_bytesMarked(0)
+        , start_blocksOwned(0)
         , collectionThreshold(config.collectionThreshold)
         , fullCollectionQueued(false)
         , pendingClearZCTStats(false)
@@ -96,6 +113,8 @@ namespace MMgc
         , objectsPinned(0)
         , objectsAllocated(0)
         , bytesAllocated(0)
+        , rootAndStackWords(0)
+        , rootAndStackTicks(0)
 #endif
 #ifdef MMGC_POINTINESS_PROFILING
         , candidateWords(0)
@@ -116,10 +135,16 @@ namespace MMgc
         , removeZCTFinalTotal(0)
 #endif
         , P(0.005)              // seconds; 5ms.  The marker /will/ overshoot this significantly
+        , P_target(heap->Config().gcPauseTarget / 1000.0)
+        , L_target(1.0 + heap->Config().gcOverheadTarget)
+        , markOvershoot(0)
+        , requestedMarkTicks(0)
+        , allocationRate(0)
+        , finalScanTicks(0)
         , R(R_INITIAL_VALUE)    // bytes/second; will be updated on-line
         , L_ideal(heap->Config().gcLoad)
         , L_cutoff(heap->Config().gcLoadCutoff)
-        , L_actual(L_ideal[0])
+        , L_actual(P_target > 0 ? L_target : L_ideal[0])
         , T(1.0-(1.0/L_actual))
         , G(heap->Config().gcEfficiency)
         , X(heap->Config().gcLoadCeiling)
@@ -131,12 +156,16 @@ namespace MMgc
         , adjustR_startTime(0)
         , adjustR_totalTime(0)
     {
+        for ( size_t i=0 ; i < kNumPauseBuckets ; i++ )
+            pauseHistogram[i] = 0;
 #ifdef MMGC_POLICY_PROFILING
         for ( size_t i=0 ; i < ARRAY_SIZE(barrierStageTotal) ; i++ ) {
             barrierStageTotal[i] = 0;
             barrierStageLastCollection[i] = 0;
         }
 #endif
+        if (P_target > 0)
+            P = P_target;
         adjustPolicyInitially();
     }
 
@@ -217,6 +246,27 @@ namespace MMgc
     //    b = sum of time spent in StartIncrementalMark, IncrementalMark, FinishIncrementalMark
     // If b > aG then we must throttle GC activity for the next cycle.  G controls clustering.
 
+    // Pause-target mode (GCHeapConfig::gcPauseTarget > 0):
+    //
+    // The user gives a target for the incremental slices, P_target, and a target heap
+    // overhead O, and the policy derives the rest from measurements:
+    //
+    // L is 1+O for all heap sizes instead of coming from the gcLoad table; G and X still
+    //   apply, so L grows past 1+O when the collector cannot keep up.
+    // P, the mark quantum, is P_target less the smoothed amount by which the marker has
+    //   been overrunning its quantum (it checks the clock only every so often), but not
+    //   less than P_target/8.
+    // T is chosen so that marking can finish before the budget runs out: marking a
+    //   heap of H bytes takes H/R seconds of GC time, or H/(RG) seconds of elapsed time
+    //   when the GC takes at most a fraction G of the time, during which a mutator
+    //   allocating at a rate of a bytes/sec allocates aH(1-G)/(RG) bytes.  The budget
+    //   is H(L-1), so marking should start when a fraction f = a(1-G)/(RG(L-1)) of it
+    //   remains; we reserve 2f to absorb errors in R and a, so T = 1-2f, clamped to
+    //   [0,0.9].  Until a has been measured T stays at 1-1/L.
+    //
+    // a is measured as the allocation budget used between the ends of two collections
+    // divided by the time spent outside the collector in that interval.
+
     // Open issues / to do:
     //  - precise semantics of V, specifically, what is the interval over which it's computed
     //  - incorporate V in the computations
@@ -253,6 +303,8 @@ namespace MMgc
 
     double GCPolicyManager::queryLoadForHeapsize(double H)
     {
+        if (P_target > 0)
+            return L_target;
         int i=0;
         while (H / (1024*1024) >= L_cutoff[i])
             i++;
@@ -308,6 +360,9 @@ namespace MMgc
         // during the last cycle
         adjustL(H);
 
+        if (P_target > 0)
+            adjustT();
+
         // The budget is H(L-1), with a floor
         double remainingBeforeGC = double(lowerLimitCollectionThreshold()) * double(GCHeap::kBlockSize) - H;
         remainingMajorAllocationBudget = majorAllocationBudget = H * (L_actual - 1.0);
@@ -369,12 +424,97 @@ namespace MMgc
     // allowed before the next mark downward, but as soon as we do that aggressively
     // we get into pause clustering issues and it will seem like one long GC pause anyway.
 
-    uint32_t GCPolicyManager::incrementalMarkMilliseconds() {
+    uint32_t GCPolicyManager::incrementalMarkMicroseconds() {
         // Nonsensical to call this in non-incremental mode
         GCAssert(gc->incremental);
         // Bad to divide by 0 here.
         GCAssert(minorAllocationBudget != 0);
-        return uint32_t(P * 1000.0 * double(minorAllocationBudget - remainingMinorAllocationBudget) / double(minorAllocationBudget));
+        uint32_t micros = uint32_t(P * 1000000.0 * double(minorAllocationBudget - remainingMinorAllocationBudget) / double(minorAllocationBudget));
+        requestedMarkTicks = uint64_t(micros) * VMPI_getPerformanceFrequency() / 1000000;
+        return micros;
+    }
+
+    void GCPolicyManager::adjustP(uint64_t elapsed)
+    {
+        // A mark that stopped short of its quantum ran out of work and says nothing
+        // about the overshoot.
+        if (elapsed < requestedMarkTicks)
+            return;
+
+        double overshoot = double(elapsed - requestedMarkTicks) / double(VMPI_getPerformanceFrequency());
+        markOvershoot = 0.75 * markOvershoot + 0.25 * overshoot;
+
+        P = P_target - markOvershoot;
+        if (P < P_target * P_MIN_FRACTION)
+            P = P_target * P_MIN_FRACTION;
+    }
+
+    void GCPolicyManager::adjustT()
+    {
+        if (allocationRate == 0) {
+            T = 1.0 - (1.0 / L_actual);
+            return;
+        }
+
+        double f = allocationRate * (1 - G) / (R * G * (L_actual - 1));
+        T = 1.0 - 2.0 * f;
+        if (T < 0)
+            T = 0;
+        if (T > T_UPPER_LIMIT)
+            T = T_UPPER_LIMIT;
+    }
+
+    void GCPolicyManager::measureAllocationRate(uint64_t cycleTicks, uint64_t gcTicks)
+    {
+        if (gc->greedy || cycleTicks <= gcTicks)
+            return;
+
+        double allocated = majorAllocationBudget - (remainingMajorAllocationBudget + double(remainingMinorAllocationBudget));
+        if (allocated <= 0)
+            return;
+
+        double rate = allocated / (double(cycleTicks - gcTicks) / double(VMPI_getPerformanceFrequency()));
+        allocationRate = (allocationRate == 0) ? rate : (allocationRate + rate) / 2;
+    }
+
+    void GCPolicyManager::recordPause(uint64_t ticks)
+    {
+        uint64_t micros = ticks * 1000000 / VMPI_getPerformanceFrequency();
+        uint32_t i = 0;
+        while (i < kNumPauseBuckets-1 && micros >= (uint64_t(kFirstPauseBucketMicros) << i))
+            i++;
+        pauseHistogram[i]++;
+    }
+
+    void GCPolicyManager::DumpPacingInfo()
+    {
+        char buf[256];
+
+        if (P_target > 0)
+            VMPI_snprintf(buf, sizeof(buf), "%.2fms", P_target * 1000.0);
+        else
+            VMPI_snprintf(buf, sizeof(buf), "off");
+        GCLog("[mem] \tpacing: pause-target=%s mark-quantum=%.2fms load=%.2f trigger=%.2f mark-rate=%.1fMB/s alloc-rate=%.1fMB/s\n",
+              buf,
+              P * 1000.0,
+              L_actual,
+              T,
+              R / (1024*1024),
+              allocationRate / (1024*1024));
+
+        VMPI_snprintf(buf, sizeof(buf), "[mem] \tpause histogram (ms):");
+        for ( uint32_t i=0 ; i < kNumPauseBuckets ; i++ ) {
+            size_t len = VMPI_strlen(buf);
+            if (i < kNumPauseBuckets-1)
+                VMPI_snprintf(buf + len, sizeof(buf) - len, " <%g=%llu",
+                              double(kFirstPauseBucketMicros << i) / 1000.0,
+                              (unsigned long long)pauseHistogram[i]);
+            else
+                VMPI_snprintf(buf + len, sizeof(buf) - len, " >=%g=%llu\n",
+                              double(kFirstPauseBucketMicros << (i-1)) / 1000.0,
+                              (unsigned long long)pauseHistogram[i]);
+        }
+        GCLog(buf);
     }
 
     bool GCPolicyManager::queryEndOfCollectionCycle() {
@@ -442,6 +582,39 @@ namespace MMgc
         start_event = NO_EVENT;
     }
 
+    void GCPolicyManager::tracePhase(PolicyEvent ev) {
+        const char* name = NULL;
+        bool marking = true;
+        switch (ev) {
+            case END_StartIncrementalMark:
+                name = "StartIncrementalMark";
+                break;
+            case END_IncrementalMark:
+                name = "IncrementalMark";
+                break;
+            case END_FinalRootAndStackScan:
+                name = "FinalRootAndStackScan";
+                break;
+            case END_FinalizeAndSweep:
+            case END_FinalizeAndSweepNoShrink:
+                name = "FinalizeAndSweep";
+                marking = false;
+                break;
+            case END_ReapZCT:
+                name = "ReapZCT";
+                marking = false;
+                break;
+            default:
+                return;
+        }
+        if (marking)
+            gc->TracePhase(name, start_time, int64_t(bytesMarked() - start_bytesMarked));
+        else
+            gc->TracePhase(name, start_time, (int64_t(blocksOwned) - int64_t(start_blocksOwned)) * GCHeap::kBlockSize);
+        if (ev == END_FinalizeAndSweep || ev == END_FinalizeAndSweepNoShrink)
+            gc->TracePhase("Collection", timeStartOfLastCollection, int64_t(bytesMarked() - gc->m_bytesMarkedAtStart));
+    }
+
     void GCPolicyManager::signal(PolicyEvent ev) {
         switch (ev) {
             case START_StartIncrementalMark:
@@ -500,6 +673,10 @@ namespace MMgc
 #endif
                 start_time = now();
                 start_event = ev;
+                if (heap->GetTraceLog() != NULL) {
+                    start_bytesMarked = bytesMarked();
+                    start_blocksOwned = blocksOwned;
+                }
                 return; // to circumvent resetting of start_event below
         }
 
@@ -517,8 +694,12 @@ namespace MMgc
         uint64_t t = now();
         uint64_t elapsed = t - start_time;
 
+        if (heap->GetTraceLog() != NULL)
+            tracePhase(ev);
+
         switch (ev) {
             case END_StartIncrementalMark:
+                recordPause(elapsed);
                 countStartIncrementalMark++;
                 timeStartIncrementalMark += elapsed;
                 timeMaxStartIncrementalMark = max(timeMaxStartIncrementalMark, elapsed);
@@ -526,6 +707,7 @@ namespace MMgc
                 endAdjustingR();
                 break;
             case END_FinalRootAndStackScan:
+                finalScanTicks = elapsed;
                 countFinalRootAndStackScan++;
                 timeFinalRootAndStackScan += elapsed;
                 timeMaxFinalRootAndStackScan = max(timeMaxFinalRootAndStackScan, elapsed);
@@ -533,6 +715,7 @@ namespace MMgc
                 endAdjustingR();
                 break;
             case END_ReapZCT:
+                recordPause(elapsed);
                 countReapZCT++;
                 timeReapZCT += elapsed;
                 timeReapZCTLastCollection += elapsed;
@@ -540,6 +723,9 @@ namespace MMgc
                 timeMaxReapZCTLastCollection = max(timeMaxReapZCTLastCollection, elapsed);
                 break;
             case END_IncrementalMark:
+                recordPause(elapsed);
+                if (P_target > 0)
+                    adjustP(elapsed);
                 countIncrementalMark++;
                 timeIncrementalMark += elapsed;
                 timeMaxIncrementalMark = max(timeMaxIncrementalMark, elapsed);
@@ -549,6 +735,10 @@ namespace MMgc
                 break;
             case END_FinalizeAndSweep:
             case END_FinalizeAndSweepNoShrink:
+                recordPause(finalScanTicks + elapsed);
+                finalScanTicks = 0;
+                if (timeEndOfLastCollection != 0)
+                    measureAllocationRate(t - timeEndOfLastCollection, timeInLastCollection + elapsed);
                 countFinalizeAndSweep++;
                 timeFinalizeAndSweep += elapsed;
                 timeMaxFinalizeAndSweep = max(timeMaxFinalizeAndSweep, elapsed);
@@ -706,6 +896,10 @@ namespace MMgc
               (unsigned long long)(bytesScannedExactlyLastCollection + bytesScannedExactlyTotal),
               (unsigned long long)(bytesScannedConservativelyLastCollection + bytesScannedConservativelyTotal),
               (unsigned long long)(bytesScannedPointerfreeLastCollection + bytesScannedPointerfreeTotal));
+        GCLog("[gcbehavior] root-and-stack-scan: words=%llu ms=%.1f words-per-second=%.0f\n",
+              (unsigned long long)rootAndStackWords,
+              ticksToMillis(rootAndStackTicks),
+              rootAndStackTicks == 0 ? 0.0 : double(rootAndStackWords) * double(VMPI_getPerformanceFrequency()) / double(rootAndStackTicks));
 
         size_t blimit = ARRAY_SIZE(barrierStageLastCollection);
         utotal = 0;
@@ -11,6 +11,7 @@
 namespace avmplus
 {
     namespace ST_mmgc_dependent { class ST_mmgc_dependent; }
+    namespace ST_mmgc_pacing { class ST_mmgc_pacing; }
 }
 #endif
 
@@ -51,6 +52,80 @@ namespace MMgc
         /* Defaults to false.  Validate incremental marking. */
         bool incrementalValidation;
 
+        /* Defaults to 0.  Set it to use that many helper threads, in addition to
+         * the collector's own thread, to drain the mark stack when finishing a
+         * collection; see GCParallelMarker.h.  At most GCParallelMarker::kMaxMarkers-1
+         * helpers are used.  The GC ignores this setting if the heap graph or the
+         * conservative or pointiness profilers are enabled, and on 64-bit systems
+         * built with MMGC_USE_DELAYED_PAGEMAP, whose page map can't be read from
+         * several threads at once.
+         */
+        uint32_t markerThreads;
+
+        /* Defaults to false.  Set it to sweep small-object blocks on a background
+         * thread after each collection instead of only lazily on the allocating
+         * thread; see GCBackgroundSweeper.h.  Ignored if GCHeapConfig::eagerSweeping
+         * is set.
+         */
+        bool backgroundSweep;
+
+        /* Defaults to false.  Set it to make most collections minor collections,
+         * which trace only the objects allocated since the previous collection and
+         * the old objects the write barrier has recorded as modified since then.
+         * Objects that survive a collection keep their mark bits and are not traced
+         * again until the next major collection.  Only effective in incremental
+         * mode; GC::Collect() always performs a major collection.
+         */
+        bool generational;
+
+        /* Defaults to false.  Set it to evacuate sparsely occupied small-object
+         * blocks after marking: movable objects (see GCTraceableObject), such as
+         * the buffers of avmplus lists, are copied into other blocks, the exactly
+         * traced references to them are updated, and the emptied blocks are
+         * returned to the heap.  See GCCompactor.h.  Ignored in generational mode
+         * and while the memory profiler or a sampler is tracking allocations.
+         */
+        bool compaction;
+
+        /* Defaults to 0.  Set it to bound the ZCT reaps that are started because
+         * the ZCT has filled up to that many microseconds each, leaving the rest of
+         * the ZCT for later reaps.  See ZCT.h.
+         */
+        uint32_t reapSlice;
+
+        /* Defaults to false.  Set it to visit the weak references during the
+         * incremental mark slices once the mark stack runs dry, so that the final
+         * pause only has to process those whose objects were not yet marked and
+         * those created during the collection.  See GC::MarkOrClearWeakRefs.
+         */
+        bool incrementalWeakRefs;
+
+        /* Defaults to false.  Set it to scan the stack frames that the GCCallbacks
+         * report, JIT-compiled frames in the case of avmplus, with their stack maps
+         * instead of conservatively.  See GCStackFrames.h.
+         */
+        bool exactStackFrames;
+
+        /* Defaults to 0.  Set it to sample the allocations of managed objects, one
+         * every that many bytes allocated on average, for an allocation profile.
+         * See GCAllocationSampler.h.
+         */
+        uint32_t allocationSampleInterval;
+
+        /* Defaults to NULL.  Set it to a table of GC::kNumSizeClasses size classes
+         * to use instead of GC::kSizeClasses, for instance one computed by
+         * GC::ComputeSizeClasses for the embedder's workload.  The table must keep
+         * the first and last entries of GC::kSizeClasses, be strictly increasing,
+         * and hold multiples of 8; an invalid table is ignored.
+         */
+        const uint16_t* sizeClasses;
+
+        /* Defaults to false.  Set it to record the sizes of the requests for small
+         * objects, see GC::GetSizeClassStats.  Allocation is slower: every request
+         * takes the out-of-line path.
+         */
+        bool sizeClassStatistics;
+
         /**
          * Garbage collection mode.  The GC is configured at creation in one of
          * these (it would be pointlessly hairy to allow the mode to be changed
@@ -100,6 +175,7 @@ namespace MMgc
     public:
 #ifdef VMCFG_SELFTEST
         friend class avmplus::ST_mmgc_dependent::ST_mmgc_dependent;
+        friend class avmplus::ST_mmgc_pacing::ST_mmgc_pacing;
 #endif
         GCPolicyManager(GC* gc, GCHeap* heap, GCConfig& config);
 
@@ -112,12 +188,13 @@ namespace MMgc
         /**
          * Situation: the GC is about to run the incremental marker.
          *
-         * @return the desired length of the next incremental mark quantum.
+         * @return the desired length of the next incremental mark quantum, in
+         *         microseconds.
          * @note the result can vary from call to call; the function should
          *       be called as an incremental mark is about to start and the
          *       result should not be cached.
          */
-        uint32_t incrementalMarkMilliseconds();
+        uint32_t incrementalMarkMicroseconds();
 
         /**
          * @return the number of blocks owned by this GC, as accounted for by calls to
@@ -211,6 +288,13 @@ namespace MMgc
          */
         void signalPointerfreeMarkWork(size_t nbytes);
 
+        /**
+         * Situation: the mark stack has been drained in parallel, and one marker
+         * thread performed the mark work recorded in 'work'.  This is equivalent
+         * to signaling each object in 'work' separately.
+         */
+        void signalParallelMarkWork(const GCMarkerWork& work);
+
         /**
          * Situation: signal that some number of bytes have just been successfully
          * allocated and are about to be returned to the caller of the allocator.
@@ -260,6 +344,13 @@ namespace MMgc
          * Situation: signal that the ZCT reaper has run and performed some work.
          */
         void signalReapWork(uint32_t objects_reaped, uint32_t bytes_reaped, uint32_t objects_pinned);
+
+        /**
+         * Situation: signal that 'words' words of a root or stack have been scanned
+         * conservatively, taking 'ticks' ticks.  Only signaled when the GC behavior
+         * is summarized (GCHeapConfig::gcbehavior), since timing the scans costs.
+         */
+        /*REALLY_INLINE*/ void signalRootAndStackScan(uint64_t words, uint64_t ticks);
 #endif
 #ifdef MMGC_POINTINESS_PROFILING
         /**
@@ -344,6 +435,11 @@ namespace MMgc
          */
         double queryAllocationBudgetFractionUsed();
 
+        /**
+         * Print the current pacing parameters and the pause histogram (for -memstats).
+         */
+        void DumpPacingInfo();
+
         // ----- Public data --------------------------------------
 
         // Elapsed time (in ticks) for various collection phases, and the maximum phase time
@@ -389,6 +485,14 @@ namespace MMgc
         uint64_t countFinalizeAndSweep;
         uint64_t countReapZCT;
 
+        // Histogram of GC pauses across the run.  Bucket i counts the pauses shorter
+        // than kFirstPauseBucketMicros << i, the last bucket the longer ones.  Every
+        // StartIncrementalMark, IncrementalMark and ReapZCT is one pause, and so is
+        // FinalRootAndStackScan together with the FinalizeAndSweep that follows it.
+        static const uint32_t kNumPauseBuckets = 10;
+        static const uint32_t kFirstPauseBucketMicros = 250;
+        uint64_t pauseHistogram[kNumPauseBuckets];
+
     private:
         // The following parameters can vary not just from machine to machine and
         // run to run on the same machine, but within a run in response to memory
@@ -447,6 +551,24 @@ namespace MMgc
         // next one)
         void adjustPolicyForNextMinorCycle();
 
+        // In pause-target mode, called when an incremental mark ends to adjust P so that
+        // the marker's slices, overshoot included, stay within P_target
+        void adjustP(uint64_t elapsed);
+
+        // In pause-target mode, called from adjustPolicyForNextMajorCycle to compute T
+        // from the mark rate and the allocation rate
+        void adjustT();
+
+        // Called when a collection ends to update allocationRate from the allocation
+        // budget used since the end of the previous collection
+        void measureAllocationRate(uint64_t cycleTicks, uint64_t gcTicks);
+
+        // Count one pause in pauseHistogram
+        void recordPause(uint64_t ticks);
+
+        // Record the phase ended by 'ev' in the heap's trace log
+        void tracePhase(PolicyEvent ev);
+
         // ----- Private data --------------------------------------
 
         GC * const gc;
@@ -494,6 +616,11 @@ namespace MMgc
         uint64_t start_time;
         PolicyEvent start_event;
 
+        // The same for the trace log, when there is one: the bytes marked and the
+        // blocks owned at the start event
+        uint64_t start_bytesMarked;
+        size_t start_blocksOwned;
+
         // Value returned by lowerLimitCollectionThreshold() and set by setLowerLimitCollectionThreshold():
         // the heap size, in blocks, below which we do not collect.
         uint32_t collectionThreshold;
@@ -525,6 +652,10 @@ namespace MMgc
         // Allocation work, overall
         uint64_t objectsAllocated;
         uint64_t bytesAllocated;
+
+        // Conservative scanning of roots and stacks, overall
+        uint64_t rootAndStackWords;
+        uint64_t rootAndStackTicks;
 #endif
 #ifdef MMGC_POINTINESS_PROFILING
         // Track the number of scannable words, the number that passes the initial range
@@ -552,9 +683,29 @@ namespace MMgc
 
         // Various policy parameters.  For more documentation, see comments in GC.cpp.
 
-        // max pause time in seconds
+        // max pause time in seconds; in pause-target mode, the mark quantum that
+        // keeps incremental marks within P_target
         double P;
 
+        // pause target in seconds (GCHeapConfig::gcPauseTarget), or 0 if the policy
+        // is not in pause-target mode
+        double P_target;
+
+        // in pause-target mode, the load factor that gives the requested heap overhead
+        double L_target;
+
+        // smoothed amount by which incremental marks overrun their quantum, in seconds
+        double markOvershoot;
+
+        // the quantum last handed out by incrementalMarkMicroseconds, in ticks
+        uint64_t requestedMarkTicks;
+
+        // smoothed mutator allocation rate in bytes/sec of mutator time, 0 until measured
+        double allocationRate;
+
+        // length of the FinalRootAndStackScan whose FinalizeAndSweep is pending, in ticks
+        uint64_t finalScanTicks;
+
         // approximate mark rate in bytes/sec, [1M,infty)
         double R;
 
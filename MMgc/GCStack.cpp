@@ -21,6 +21,7 @@ namespace MMgc
         , m_hiddenSegments(0)
         , m_extraSegment(NULL)
         , m_deadItem(0)
+        , m_segmentLock(NULL)
 #ifdef MMGC_MARKSTACK_ALLOWANCE
         , m_allowance(allowance > 0 ? allowance : 2147483647)
 #endif
@@ -46,6 +47,11 @@ namespace MMgc
         m_deadItem = uintptr_t(item);
     }
 
+    void GCMarkStack::SetSegmentLock(vmpi_spin_lock_t* lock)
+    {
+        m_segmentLock = lock;
+    }
+
     bool GCMarkStack::Push_LargeExactObjectTail(const void* p, size_t cursor)
     {
         uintptr_t* top = allocSpace(3);
@@ -537,8 +543,12 @@ namespace MMgc
 #endif
         if (mustSucceed)
             return GCHeap::GetGCHeap()->GetPartition(kStackPartition)->Alloc(1, GCHeap::flags_Alloc);
-        else
+        if (m_segmentLock == NULL)
             return GCHeap::GetGCHeap()->GetPartition(kStackPartition)->AllocNoOOM(1, GCHeap::flags_Alloc | GCHeap::kCanFail);
+        VMPI_lockAcquire(m_segmentLock);
+        void* p = GCHeap::GetGCHeap()->GetPartition(kStackPartition)->AllocNoOOM(1, GCHeap::flags_Alloc | GCHeap::kCanFail);
+        VMPI_lockRelease(m_segmentLock);
+        return p;
     }
 
     inline void GCMarkStack::FreeStackSegment(void* p)
@@ -546,7 +556,13 @@ namespace MMgc
 #ifdef MMGC_MARKSTACK_ALLOWANCE
         ++m_allowance;
 #endif
+        if (m_segmentLock == NULL) {
+            GCHeap::GetGCHeap()->GetPartition(kStackPartition)->FreeNoOOM(p);
+            return;
+        }
+        VMPI_lockAcquire(m_segmentLock);
         GCHeap::GetGCHeap()->GetPartition(kStackPartition)->FreeNoOOM(p);
+        VMPI_lockRelease(m_segmentLock);
     }
 
 #ifdef GCDEBUG
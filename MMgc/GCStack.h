@@ -71,6 +71,13 @@ namespace MMgc
          */
         void SetDeadItem(void* item);
 
+        /**
+         * Serialize segment allocation and deallocation on 'lock', or stop doing so if
+         * 'lock' is NULL.  Used while several threads push onto their own mark stacks
+         * at the same time, see GCParallelMarker.
+         */
+        void SetSegmentLock(vmpi_spin_lock_t* lock);
+
         /** Push a GC item; return true if successful, false if OOM */
         bool Push_GCObject(const void *p);
         
@@ -287,6 +294,7 @@ namespace MMgc
         uint32_t            m_hiddenSegments; // Number of those older segments
         StackSegment*       m_extraSegment;   // Single-element cache to control costs of straddling a segment boundary
         uintptr_t           m_deadItem;       // A managed object that is used to clear out dead slots
+        vmpi_spin_lock_t*   m_segmentLock;    // If not NULL, held while segments are allocated and freed
 #ifdef MMGC_MARKSTACK_ALLOWANCE
         int32_t             m_allowance;      // Allowance for the number of elements
 #endif
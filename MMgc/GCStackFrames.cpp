@@ -0,0 +1,85 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MMgc.h"
+
+namespace MMgc
+{
+    GCStackFrames::GCStackFrames()
+        : m_frames(NULL)
+        , m_count(0)
+        , m_capacity(0)
+        , m_low(NULL)
+        , m_high(NULL)
+    {
+    }
+
+    GCStackFrames::~GCStackFrames()
+    {
+        if (m_frames != NULL)
+            VMPI_free(m_frames);
+    }
+
+    void GCStackFrames::Begin(const void* low, const void* high)
+    {
+        GCAssert(m_low == NULL);
+        GCAssert(low != NULL && low <= high);
+        m_low = (const char*)low;
+        m_high = (const char*)high;
+        m_count = 0;
+    }
+
+    void GCStackFrames::End()
+    {
+        m_low = NULL;
+        m_high = NULL;
+        m_count = 0;
+    }
+
+    bool GCStackFrames::InRange(const void* p, size_t size) const
+    {
+        return m_low != NULL &&
+               (const char*)p >= m_low &&
+               (const char*)p <= m_high &&
+               size_t(m_high - (const char*)p) >= size;
+    }
+
+    void GCStackFrames::AddFrame(const void* base, uint32_t nwords, const uint32_t* bitmap)
+    {
+        if (nwords == 0 || (uintptr_t(base) & (sizeof(void*) - 1)) != 0 || !InRange(base, nwords * sizeof(void*)))
+            return;
+        if (m_count > 0) {
+            const Frame& last = m_frames[m_count - 1];
+            if ((const uintptr_t*)base < last.base + last.nwords)
+                return;
+        }
+        // Without the memory the frame is simply scanned conservatively.
+        if (!EnsureCapacity(m_count + 1))
+            return;
+        Frame& frame = m_frames[m_count++];
+        frame.base = (const uintptr_t*)base;
+        frame.nwords = nwords;
+        frame.bitmap = bitmap;
+    }
+
+    bool GCStackFrames::EnsureCapacity(uint32_t count)
+    {
+        if (count <= m_capacity)
+            return true;
+
+        uint32_t capacity = m_capacity < 64 ? 64 : m_capacity * 2;
+        Frame* frames = (Frame*)VMPI_alloc(capacity * sizeof(Frame));
+        if (frames == NULL)
+            return false;
+        if (m_frames != NULL) {
+            VMPI_memcpy(frames, m_frames, m_count * sizeof(Frame));
+            VMPI_free(m_frames);
+        }
+        m_frames = frames;
+        m_capacity = capacity;
+        return true;
+    }
+}
@@ -0,0 +1,100 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCStackFrames__
+#define __GCStackFrames__
+
+namespace avmplus { namespace ST_mmgc_stackframes { class ST_mmgc_stackframes; } };
+
+namespace MMgc
+{
+    /**
+     * The words of the native stack scanned by the last stack scan of a GC,
+     * see GC::GetStackFrameStats.
+     */
+    struct StackFrameStats
+    {
+        uint32_t frames;            // The frames that were scanned exactly
+        uint32_t wordsTraced;       // The words of those frames that were traced
+        uint32_t wordsSkipped;      // The words of those frames that were not
+        uint32_t wordsConservative; // The words of the rest of the stack
+    };
+
+    /**
+     * Stack frames with a known layout (GCConfig::exactStackFrames).
+     *
+     * The native stack is normally scanned conservatively, which costs time in
+     * proportion to its depth and retains whatever a stale or non-pointer word
+     * happens to point to.  When the GC scans the stack to mark from it, or the ZCT
+     * to pin the objects it references, they first ask every GCCallback to report
+     * the frames on the stack whose layout it knows, with a bitmap of the words that
+     * can hold pointers; JIT-compiled frames are the usual case.  Those words are
+     * scanned, the rest of the frames is skipped, and everything between the frames
+     * is scanned conservatively as before.
+     *
+     * The frames must be reported in order of increasing address.  A frame that is
+     * not entirely within the range being scanned, or that overlaps the frame
+     * reported before it, is ignored, and so scanned conservatively.
+     */
+    class GCStackFrames
+    {
+        friend class GC;
+        friend class ZCT;
+        friend class avmplus::ST_mmgc_stackframes::ST_mmgc_stackframes;
+    public:
+        GCStackFrames();
+        ~GCStackFrames();
+
+        /**
+         * Report the 'nwords' words at 'base' as a frame in which only the words
+         * whose bits are set in 'bitmap', bit i%32 of bitmap[i/32] for base[i], can
+         * hold pointers.  'bitmap' must stay valid until the scan is done.
+         */
+        void AddFrame(const void* base, uint32_t nwords, const uint32_t* bitmap);
+
+        /**
+         * @return true if [p,p+size) is within the range being scanned, so that a
+         * callback can read it to find or validate a frame.
+         */
+        bool InRange(const void* p, size_t size) const;
+
+    private:
+        struct Frame
+        {
+            const uintptr_t* base;
+            uint32_t nwords;
+            const uint32_t* bitmap;
+        };
+
+        // Start collecting the frames in [low,high).
+        void Begin(const void* low, const void* high);
+
+        // Forget the frames.
+        void End();
+
+        // Make room for 'count' frames.  Returns false if memory is exhausted.
+        bool EnsureCapacity(uint32_t count);
+
+        static bool IsSet(const uint32_t* bitmap, uint32_t i)
+        {
+            return (bitmap[i >> 5] & (1U << (i & 31))) != 0;
+        }
+
+        // The frames, allocated with VMPI_alloc and kept from one scan to the
+        // next.
+        Frame* m_frames;
+        uint32_t m_count;
+        uint32_t m_capacity;
+        const char* m_low;              // NULL unless between Begin() and End()
+        const char* m_high;
+
+    private: // not implemented
+        GCStackFrames(const GCStackFrames&);
+        GCStackFrames& operator=(const GCStackFrames&);
+    };
+}
+
+#endif /* __GCStackFrames__ */
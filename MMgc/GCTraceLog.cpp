@@ -0,0 +1,106 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MMgc.h"
+
+#include <stdio.h>
+
+namespace MMgc
+{
+    GCTraceLog::GCTraceLog(uint32_t capacity)
+        : m_events(NULL)
+        , m_capacity(capacity)
+        , m_total(0)
+        , m_tracks(0)
+        , m_origin(VMPI_getPerformanceCounter())
+    {
+        GCAssert(capacity > 0);
+        VMPI_lockInit(&m_lock);
+        m_events = (Event*)VMPI_alloc(capacity * sizeof(Event));
+    }
+
+    GCTraceLog::~GCTraceLog()
+    {
+        if (m_events != NULL)
+            VMPI_free(m_events);
+        VMPI_lockDestroy(&m_lock);
+    }
+
+    uint32_t GCTraceLog::NewTrack()
+    {
+        MMGC_LOCK(m_lock);
+        return ++m_tracks;
+    }
+
+    void GCTraceLog::Record(const char* name, uint32_t track, uint64_t start, uint64_t end, int64_t bytes, uint64_t heapBytes)
+    {
+        MMGC_LOCK(m_lock);
+        Event& e = m_events[m_total % m_capacity];
+        e.name = name;
+        e.track = track;
+        e.start = start;
+        e.end = end;
+        e.bytes = bytes;
+        e.heapBytes = heapBytes;
+        m_total++;
+    }
+
+    uint64_t GCTraceLog::GetTotalEvents()
+    {
+        MMGC_LOCK(m_lock);
+        return m_total;
+    }
+
+    static void writeString(FILE* fp, const char* s)
+    {
+        fputc('"', fp);
+        for ( ; *s != 0 ; s++ ) {
+            if (*s == '"' || *s == '\\')
+                fprintf(fp, "\\%c", *s);
+            else if ((unsigned char)*s < 0x20)
+                fprintf(fp, "\\u%04x", unsigned((unsigned char)*s));
+            else
+                fputc(*s, fp);
+        }
+        fputc('"', fp);
+    }
+
+    bool GCTraceLog::Write(const char* filename)
+    {
+        FILE* fp = fopen(filename, "w");
+        if (fp == NULL)
+            return false;
+
+        MMGC_LOCK(m_lock);
+
+        double microsPerTick = 1000000.0 / double(VMPI_getPerformanceFrequency());
+        uint64_t first = m_total > m_capacity ? m_total - m_capacity : 0;
+
+        fprintf(fp, "{\"traceEvents\":[\n");
+        fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"MMgc\"}},\n");
+        fprintf(fp, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GCHeap\"}}");
+        for (uint32_t track = 1; track <= m_tracks; track++)
+            fprintf(fp, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GC %u\"}}", track, track);
+
+        for (uint64_t i = first; i < m_total; i++) {
+            const Event& e = m_events[i % m_capacity];
+            fprintf(fp, ",\n{\"name\":");
+            writeString(fp, e.name);
+            fprintf(fp, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,"
+                        "\"args\":{\"bytes\":%lld,\"heapBytes\":%llu}}",
+                    e.track == kHeapTrack ? "gcheap" : "gc",
+                    e.track,
+                    double(int64_t(e.start - m_origin)) * microsPerTick,
+                    double(e.end - e.start) * microsPerTick,
+                    (long long)e.bytes,
+                    (unsigned long long)e.heapBytes);
+        }
+
+        fprintf(fp, "\n],\n\"displayTimeUnit\":\"ms\",\n\"otherData\":{\"events\":\"%llu\",\"dropped\":\"%llu\"}}\n",
+                (unsigned long long)m_total, (unsigned long long)first);
+        return fclose(fp) == 0;
+    }
+}
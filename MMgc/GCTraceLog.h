@@ -0,0 +1,115 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __GCTraceLog__
+#define __GCTraceLog__
+
+namespace avmplus { namespace ST_mmgc_tracelog { class ST_mmgc_tracelog; } };
+
+namespace MMgc
+{
+    /**
+     * A timeline of collector and heap activity (GCHeap::EnableTraceLog).
+     *
+     * Every GC phase and every heap expansion and decommit is recorded as an event
+     * with its start and end time and a byte count, into a fixed-size ring buffer
+     * that keeps the most recent events.  Recording takes a spinlock and copies a
+     * few words; nothing is allocated after the log is created, so events can be
+     * recorded with the heap lock held.
+     *
+     * Events are recorded on tracks: track 0 is the heap, and every GC gets its own
+     * track the first time it records an event.  The events of a GC are:
+     *
+     *   StartIncrementalMark, IncrementalMark, FinalRootAndStackScan
+     *                          The mark phases; 'bytes' is the number of bytes marked.
+     *   FinalizeAndSweep       'bytes' is the change in the memory owned by the GC,
+     *                          negative when blocks were returned to the heap.
+     *   ReapZCT                As FinalizeAndSweep.
+     *   PresweepCallbacks, PostsweepCallbacks
+     *                          The GCCallbacks, within FinalizeAndSweep.
+     *   Collection             From the start of StartIncrementalMark to the end of
+     *                          FinalizeAndSweep, including the mutator time between
+     *                          the phases; 'bytes' is the number of bytes marked.
+     *
+     * and 'heapBytes' is the memory owned by the GC after the event.  The heap's
+     * events are ExpandHeap and Decommit, with the change in the size of the heap
+     * and its size afterwards.  An embedder can record its own events, for example
+     * one per frame, on a track from NewTrack() to line them up with the pauses.
+     *
+     * Write() produces the Chrome trace-event JSON format, which chrome://tracing
+     * and other trace viewers load directly: one complete ("X") event per event,
+     * with times in microseconds since the log was created and the byte counts as
+     * arguments, and metadata events naming the tracks.
+     */
+    class GCTraceLog
+    {
+        friend class avmplus::ST_mmgc_tracelog::ST_mmgc_tracelog;
+    public:
+        // The number of events kept by the shell's -gctrace.
+        static const uint32_t kDefaultCapacity = 65536;
+
+        // The heap's track.
+        static const uint32_t kHeapTrack = 0;
+
+        /**
+         * A log that keeps the last 'capacity' events.  Check IsValid() for whether
+         * the buffer could be allocated.
+         */
+        GCTraceLog(uint32_t capacity);
+        ~GCTraceLog();
+
+        bool IsValid() const { return m_events != NULL; }
+
+        /**
+         * @return a new track, numbered from 1.
+         */
+        uint32_t NewTrack();
+
+        /**
+         * Record an event on 'track' from 'start' to 'end', in VMPI_getPerformanceCounter
+         * ticks.  'name' must be a string constant, it is not copied.
+         */
+        void Record(const char* name, uint32_t track, uint64_t start, uint64_t end, int64_t bytes, uint64_t heapBytes);
+
+        /**
+         * @return the number of events recorded to date, including those that have
+         * been overwritten.
+         */
+        uint64_t GetTotalEvents();
+
+        /**
+         * Write the events in the buffer to 'filename' in the Chrome trace-event
+         * format.  Events may be recorded while the file is being written; they wait.
+         *
+         * @return false if the file could not be written.
+         */
+        bool Write(const char* filename);
+
+    private:
+        struct Event
+        {
+            const char* name;
+            uint32_t track;
+            uint64_t start;
+            uint64_t end;
+            int64_t bytes;
+            uint64_t heapBytes;
+        };
+
+        vmpi_spin_lock_t m_lock;        // Protects everything below
+        Event* m_events;                // The ring buffer, allocated with VMPI_alloc
+        const uint32_t m_capacity;
+        uint64_t m_total;               // Events recorded, m_events[m_total % m_capacity] is next
+        uint32_t m_tracks;              // Tracks handed out by NewTrack
+        const uint64_t m_origin;        // Ticks at creation, time 0 in the file
+
+    private: // not implemented
+        GCTraceLog(const GCTraceLog&);
+        GCTraceLog& operator=(const GCTraceLog&);
+    };
+}
+
+#endif /* __GCTraceLog__ */
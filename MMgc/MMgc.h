@@ -189,6 +189,25 @@
 
 #define MMGC_FASTBITS
 
+// MMGC_SIMD_CONSERVATIVE_SCAN makes the conservative marker test the words of stacks,
+// roots, and conservatively traced objects against the bounds of the GC's memory
+// several at a time with SSE2, and only look closer at the words that are in bounds.
+//
+// The filter reads memory that valgrind may consider undefined, and it would upset
+// the word counts of MMGC_POINTINESS_PROFILING, so it is disabled with those.
+
+#if (defined MMGC_AMD64 || (defined MMGC_IA32 && (defined __SSE2__ || (defined _M_IX86_FP && _M_IX86_FP >= 2)))) \
+    && !defined MMGC_VALGRIND && !defined MMGC_POINTINESS_PROFILING
+    #define MMGC_SIMD_CONSERVATIVE_SCAN
+#endif
+
+// MMGC_SIMD_HASHTABLE_PROBE makes GCGroupHashtable compare the control bytes of a
+// group of slots with one SSE2 instruction instead of one at a time.
+
+#if defined MMGC_AMD64 || (defined MMGC_IA32 && (defined __SSE2__ || (defined _M_IX86_FP && _M_IX86_FP >= 2)))
+    #define MMGC_SIMD_HASHTABLE_PROBE
+#endif
+
 #include "GCDebug.h"
 #include "GCLog.h"
 
@@ -213,6 +232,12 @@
 // https://bugzilla.mozilla.org/show_bug.cgi?id=581070
 //#define MMGC_USE_UNIFORM_PAGEMAP
 
+// On 64-bit systems the GC's page map is a LockFreeT3, which the parallel
+// markers can read without locking.  This reverts to DelayT4, which is a little
+// smaller for small heaps but whose lookup cache must not be shared between
+// threads, so the GC then ignores GCConfig::markerThreads.
+//#define MMGC_USE_DELAYED_PAGEMAP
+
 #ifdef MMGC_HEAP_GRAPH
     #define HEAP_GRAPH_ARG(x) , x
 #else
@@ -229,6 +254,9 @@ namespace MMgc
     class Cleaner;
     class GCAlloc;
     class GCHeap;
+    class GCHeapReleaser;
+    class GCStackFrames;
+    class GCTraceLog;
     class GCTraceableBase;
 
 #define CAPACITY(T)  (uint32_t(GCHeap::kBlockSize) / uint32_t(sizeof(T)))
@@ -320,16 +348,27 @@ const static int kCodePartition = 0;
 #include "GCThreads.h"
 #include "GCAllocObject.h"
 #include "GCHashtable.h"
+#include "GCGroupHashtable.h"
 #include "GCMemoryProfiler.h"
 #include "GCThreadLocal.h"
+#include "GCParallelMarker.h"
+#include "SizeClassHistogram.h"
 #include "FixedAlloc.h"
 #include "FixedMalloc.h"
 #include "GCGlobalNew.h"
 #include "BasicList.h"
 #include "GCHeap.h"
+#include "GCHeapReleaser.h"
+#include "GCTraceLog.h"
 #include "PageMap.h"
 #include "GCAlloc.h"
 #include "GCLargeAlloc.h"
+#include "GCBackgroundSweeper.h"
+#include "GCEdgeVisitor.h"
+#include "GCCompactor.h"
+#include "GCAllocationSampler.h"
+#include "GCHeapSnapshot.h"
+#include "GCStackFrames.h"
 #include "ZCT.h"
 #include "HeapGraph.h"
 #include "GCPolicyManager.h"
@@ -342,6 +381,7 @@ const static int kCodePartition = 0;
 
 #include "Shared-inlines.h"
 #include "GCHashtable-inlines.h"
+#include "GCGroupHashtable-inlines.h"
 #include "FixedAlloc-inlines.h"
 #include "FixedMalloc-inlines.h"
 #include "PageMap-inlines.h"
@@ -302,6 +302,70 @@ namespace MMgc
             else
                 (void)0; // uncacheable implies unmapped implies already clear.
         }
+
+        /* static */
+        REALLY_INLINE uint32_t LockFreeT3::AddrToIndex0(uintptr_t addr)
+        {
+            uint32_t rtn = uint32_t(addr >> tier0_shift);
+            GCAssert(rtn < tier0_entries);
+            return rtn;
+        }
+
+        /* static */
+        REALLY_INLINE uint32_t LockFreeT3::AddrToIndex1(uintptr_t addr)
+        {
+            return uint32_t(addr >> tier1_shift) & tier1_postshift_mask;
+        }
+
+        /* static */
+        REALLY_INLINE uint32_t LockFreeT3::AddrToIndex2(uintptr_t addr)
+        {
+            return uint32_t(addr >> tier2_shift) & tier2_postshift_mask;
+        }
+
+        /* static */
+        REALLY_INLINE uint32_t LockFreeT3::AddrToByteShiftAmt(uintptr_t addr)
+        {
+            // shift amount to determine position in the byte (times 2 b/c 2 bits per page)
+            return (uint32_t(addr >> kPageShift) & 0x3) * 2;
+        }
+
+        REALLY_INLINE uint8_t *LockFreeT3::AddrToLeafBytes(uintptr_t addr) const
+        {
+            uint8_t **subMap1 = pageMap[AddrToIndex0(addr)];
+            if (subMap1 == NULL)
+                return NULL;
+            return subMap1[AddrToIndex1(addr)]; // (may be NULL)
+        }
+
+        REALLY_INLINE PageType LockFreeT3::AddrToVal(uintptr_t addr) const
+        {
+            uint8_t* leaf = AddrToLeafBytes(addr);
+
+            MMGC_STATIC_ASSERT(kNonGC == 0);
+            if (leaf == NULL)
+                return kNonGC;
+
+            uint8_t byte = leaf[AddrToIndex2(addr)];
+            return PageType((byte >> AddrToByteShiftAmt(addr)) & 0x3);
+        }
+
+        REALLY_INLINE void LockFreeT3::AddrSet(uintptr_t addr, PageType val)
+        {
+            uint8_t* leaf = AddrToLeafBytes(addr);
+            GCAssert(leaf != NULL);
+            uint32_t shift = AddrToByteShiftAmt(addr);
+            GCAssert(((leaf[AddrToIndex2(addr)] >> shift)&0x3) == 0);
+            leaf[AddrToIndex2(addr)] |= uint8_t(val << shift);
+        }
+
+        REALLY_INLINE void LockFreeT3::AddrClear(uintptr_t addr)
+        {
+            uint8_t* leaf = AddrToLeafBytes(addr);
+            if (leaf == NULL)
+                return;
+            leaf[AddrToIndex2(addr)] &= uint8_t(~(0x3 << AddrToByteShiftAmt(addr)));
+        }
 #endif // ! defined(MMGC_USE_UNIFORM_PAGEMAP) && defined(MMGC_64BIT)
 
     }
@@ -570,6 +570,88 @@ namespace MMgc
         {
             SimpleExpandSetAll(this, heap, item, numPages, val);
         }
+
+        LockFreeT3::LockFreeT3()
+            : PageMapBase()
+        {
+            for (size_t i = 0; i < tier0_entries; i++) {
+                pageMap[i] = NULL;
+            }
+        }
+
+        void LockFreeT3::DestroyPageMapVia(GCHeap *heap)
+        {
+            // Was allocated with AllocNoOOM, can't use heapFree here
+            for (size_t i=0; i < tier0_entries; i++) {
+                uint8_t **subMap1 = pageMap[i];
+                if (subMap1 == NULL)
+                    continue;
+                for (size_t j=0; j < tier1_entries; j++) {
+                    uint8_t *subMap2 = subMap1[j];
+                    if (subMap2 == NULL)
+                        continue;
+                    heap->GetPartition(kPageMapPartition)->Free(subMap2);
+                }
+                heap->GetPartition(kPageMapPartition)->Free(subMap1);
+                pageMap[i] = NULL;
+            }
+        }
+
+        void LockFreeT3::InitPageMap(GCHeap *heap, uintptr_t start, uintptr_t limit)
+        {
+            // AddrToIndex drops low order bits, but we want to round *up* for limit calc.
+            uint32_t i_lim = AddrToIndex0(limit-1)+1;
+            GCAssert(i_lim <= tier0_entries);
+            uint32_t i = AddrToIndex0(start), j = AddrToIndex1(start);
+
+            // A node is zeroed when it is allocated; the barrier makes the
+            // zeroes visible to other threads before the pointer is.
+            for (; i < i_lim; i++, j=0) {
+                uint8_t **subMap1 = pageMap[i];
+                uint32_t j_lim = (i+1 < i_lim) ? tier1_entries : AddrToIndex1(limit-1)+1;
+                if (subMap1 == NULL) {
+                    subMap1 = (uint8_t**)heap->GetPartition(kPageMapPartition)->AllocNoOOM(tier1_pages);
+                    VMPI_memoryBarrier();
+                    pageMap[i] = subMap1;
+                }
+                for (; j < j_lim; j++) {
+                    if (subMap1[j] == NULL) {
+                        uint8_t *subMap2 = (uint8_t*)heap->GetPartition(kPageMapPartition)->AllocNoOOM(tier2_pages);
+                        VMPI_memoryBarrier();
+                        subMap1[j] = subMap2;
+                    }
+                }
+            }
+        }
+
+        void LockFreeT3::EnsureCapacity(GCHeap *heap, void *item, uint32_t numPages)
+        {
+            uintptr_t addr = uintptr_t(item);
+            // (see the FIXME on the +1 in Tiered4::EnsureCapacity)
+            uintptr_t addr_lim = addr + (numPages+1)*PageMap::kPageSize;
+
+            InitPageMap(heap, addr, addr_lim);
+
+            // Readers that see the wider range must also see its nodes.
+            if (addr < memStart || addr_lim > memEnd) {
+                VMPI_memoryBarrier();
+                if (addr < memStart)
+                    memStart = addr;
+                if (addr_lim > memEnd)
+                    memEnd = addr_lim;
+            }
+        }
+
+        void LockFreeT3::ExpandSetAll(GCHeap *heap, void *item,
+                                      uint32_t numPages, PageType val)
+        {
+            SimpleExpandSetAll(this, heap, item, numPages, val);
+        }
+
+        void LockFreeT3::ClearAddrs(void *item, uint32_t numpages)
+        {
+            SimpleClearAddrs(this, item, numpages);
+        }
 #endif // ! defined(MMGC_USE_UNIFORM_PAGEMAP) && defined(MMGC_64BIT)
     }
 }
@@ -438,6 +438,89 @@ namespace MMgc
                                      uintptr_t addr, uintptr_t addr_lim);
             bool stillInitialDelay; // true iff only cache exists.
         };
+
+        // LockFreeT3 is a three level radix tree whose lookups take no
+        // locks and write nothing, so that helper threads (the parallel
+        // markers) can read it while the owning thread maps new pages.
+        //
+        // The root is inlined into the member; interior nodes and leaves
+        // are allocated zeroed and published with a barrier before the
+        // pointer to them is stored, and the mappable range is widened
+        // only after the nodes covering it are published.  Nodes are
+        // never freed before DestroyPageMapVia, so a reader that sees a
+        // node pointer can always dereference it; the two dependent loads
+        // need no barrier on any architecture we support.
+        //
+        // Updates are made only by the thread that owns the GC; payload
+        // bytes are updated in place and readers see the old or the new
+        // byte, never a torn one.
+        class LockFreeT3 : protected PageMapBase
+        {
+        protected:
+            // root inlined into member itself; interior nodes and leaves
+            // are allocated in page-sized units.
+            static const uint32_t tier0_nbits = 11;
+            static const uint32_t tier1_nbits = 10;
+            static const uint32_t tier2_nbits = 13;
+
+            // 12 : covers 4096 byte page
+            //  2 : index a bit-pair in a byte
+            //
+            // sum of all three + 2 + 12 is 48, the address width that
+            // Tiered4 covers (see the AMD64 note there).
+            MMGC_STATIC_ASSERT(tier0_nbits + tier1_nbits + tier2_nbits + 2 + kPageShift == 48);
+
+            static const uint32_t tier0_entries = 1 << tier0_nbits;
+            static const uint32_t tier1_entries = 1 << tier1_nbits;
+            static const uint32_t tier2_entries = 1 << tier2_nbits;
+
+            static const uint32_t tier1_pages = tier1_entries*sizeof(uint8_t*) / GCHeap::kBlockSize;
+            static const uint32_t tier2_pages = tier2_entries*sizeof(uint8_t) / GCHeap::kBlockSize;
+
+            MMGC_STATIC_ASSERT(tier1_pages * GCHeap::kBlockSize == tier1_entries*sizeof(uint8_t*));
+            MMGC_STATIC_ASSERT(tier2_pages * GCHeap::kBlockSize == tier2_entries*sizeof(uint8_t));
+
+            static const uintptr_t tier2_shift = kPageShift+2;
+            static const uint32_t tier2_postshift_mask = (1 << tier2_nbits)-1;
+            static const uintptr_t tier1_shift = tier2_shift + tier2_nbits;
+            static const uint32_t tier1_postshift_mask = (1 << tier1_nbits)-1;
+            static const uintptr_t tier0_shift = tier1_shift + tier1_nbits;
+            // Doc for public methods: see above.
+        public:
+            LockFreeT3();
+
+            // adjust access (aka "re-export") utilty methods.
+            using PageMapBase::MemStart;
+            using PageMapBase::MemEnd;
+            using PageMapBase::AddrIsMappable;
+
+            void DestroyPageMapVia(GCHeap *heap);
+            PageType AddrToVal(uintptr_t addr) const;
+            void ExpandSetAll(GCHeap *h, void *item, uint32_t np, PageType val);
+            void ClearAddrs(void *item, uint32_t numpages);
+        protected:
+            // (helper implements ExpandSetAll via EnsureCapacity and AddrSet)
+            template<typename PM>
+            friend void SimpleExpandSetAll(PM*,GCHeap*,void*,uint32_t,PageType);
+            // (helper implements ClearAddrs via AddrClear)
+            template<typename PM>
+            friend void SimpleClearAddrs(PM*,void*,uint32_t);
+
+            void AddrSet(uintptr_t addr, PageType val);
+            void AddrClear(uintptr_t addr);
+            void EnsureCapacity(GCHeap *heap, void *item, uint32_t numpages);
+            uint8_t* AddrToLeafBytes(uintptr_t addr) const;
+
+            static uint32_t AddrToIndex0(uintptr_t addr);
+            static uint32_t AddrToIndex1(uintptr_t addr);
+            static uint32_t AddrToIndex2(uintptr_t addr);
+            static uint32_t AddrToByteShiftAmt(uintptr_t addr);
+
+            /** publishes the nodes covering the half-open range [start,limit). */
+            void InitPageMap(GCHeap *heap, uintptr_t start, uintptr_t limit);
+        protected:
+            uint8_t **pageMap[tier0_entries];
+        };
 #endif // ! defined(MMGC_USE_UNIFORM_PAGEMAP) && defined(MMGC_64BIT)
     }
 }
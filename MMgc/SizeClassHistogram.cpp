@@ -0,0 +1,190 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "MMgc.h"
+
+namespace MMgc
+{
+    SizeClassHistogram::SizeClassHistogram()
+        : largeRequests(0)
+        , largeBytes(0)
+        , numBuckets(0)
+        , counts(NULL)
+        , bytes(NULL)
+    {
+    }
+
+    SizeClassHistogram::~SizeClassHistogram()
+    {
+        Destroy();
+    }
+
+    bool SizeClassHistogram::Init(uint32_t largestAlloc)
+    {
+        GCAssert(counts == NULL);
+        GCAssert(largestAlloc > 0 && (largestAlloc & 7) == 0);
+        numBuckets = largestAlloc >> 3;
+        counts = (uint64_t*)VMPI_alloc(numBuckets * sizeof(uint64_t));
+        bytes = (uint64_t*)VMPI_alloc(numBuckets * sizeof(uint64_t));
+        if (counts == NULL || bytes == NULL) {
+            Destroy();
+            return false;
+        }
+        VMPI_memset(counts, 0, numBuckets * sizeof(uint64_t));
+        VMPI_memset(bytes, 0, numBuckets * sizeof(uint64_t));
+        largeRequests = 0;
+        largeBytes = 0;
+        return true;
+    }
+
+    void SizeClassHistogram::Destroy()
+    {
+        if (counts != NULL)
+            VMPI_free(counts);
+        if (bytes != NULL)
+            VMPI_free(bytes);
+        counts = NULL;
+        bytes = NULL;
+        numBuckets = 0;
+    }
+
+    void SizeClassHistogram::Record(size_t size, size_t askSize)
+    {
+        GCAssert(IsEnabled());
+        size_t bucket = size == 0 ? 0 : (size - 1) >> 3;
+        if (bucket < numBuckets) {
+            counts[bucket]++;
+            bytes[bucket] += askSize;
+        }
+        else {
+            largeRequests++;
+            largeBytes += askSize;
+        }
+    }
+
+    void SizeClassHistogram::Accumulate(uint32_t previousSize, uint32_t itemSize, SizeClassStats& stats) const
+    {
+        for (uint32_t i=previousSize >> 3; i < numBuckets && (i+1)*8 <= itemSize; i++) {
+            stats.requests += counts[i];
+            stats.bytesRequested += bytes[i];
+        }
+    }
+
+    bool SizeClassHistogram::ComputeSizeClasses(uint16_t* sizeClasses, uint32_t numClasses, uint32_t numFixed, size_t usableBlockBytes) const
+    {
+        GCAssert(numFixed > 0 && numFixed < numClasses);
+
+        // The fixed classes take the buckets up to and including 'first'-1; the
+        // others are chosen among the larger buckets by dynamic programming over
+        // the number of classes and the bucket of the largest class so far.
+        const uint32_t first = (sizeClasses[numFixed-1] + 7) >> 3;
+        const uint32_t numFree = numClasses - numFixed;
+        GCAssert(first + numFree <= numBuckets);
+
+        uint64_t total = 0;
+        for (uint32_t i=0; i < numBuckets; i++)
+            total += counts[i];
+        if (total == 0)
+            return false;
+
+        // cumulative[j] is the number of requests in buckets first..j-1, itemCost[j]
+        // the memory used per item if bucket j is the largest of its class.
+        double* cumulative = (double*)VMPI_alloc((numBuckets+1) * sizeof(double));
+        double* itemCost = (double*)VMPI_alloc(numBuckets * sizeof(double));
+        double* cost = (double*)VMPI_alloc(numFree * numBuckets * sizeof(double));
+        uint16_t* previous = (uint16_t*)VMPI_alloc(numFree * numBuckets * sizeof(uint16_t));
+        bool result = cumulative != NULL && itemCost != NULL && cost != NULL && previous != NULL;
+        if (result) {
+            cumulative[first] = 0;
+            for (uint32_t j=first; j < numBuckets; j++) {
+                cumulative[j+1] = cumulative[j] + double(counts[j]);
+                size_t itemSize = (j+1)*8;
+                itemCost[j] = double(usableBlockBytes) / double(usableBlockBytes / itemSize);
+            }
+
+            // cost[k*numBuckets+j] is the least memory used by buckets first..j in
+            // k+1 classes, the last of which has the size of bucket j; previous[]
+            // is the largest bucket of the class before it.
+            for (uint32_t j=first; j < numBuckets; j++) {
+                cost[j] = itemCost[j] * (cumulative[j+1] - cumulative[first]);
+                previous[j] = uint16_t(first-1);
+            }
+            for (uint32_t k=1; k < numFree; k++) {
+                for (uint32_t j=first+k; j < numBuckets; j++) {
+                    double best = -1;
+                    uint32_t bestp = 0;
+                    for (uint32_t p=first+k-1; p < j; p++) {
+                        double c = cost[(k-1)*numBuckets+p] + itemCost[j] * (cumulative[j+1] - cumulative[p+1]);
+                        if (best < 0 || c < best) {
+                            best = c;
+                            bestp = p;
+                        }
+                    }
+                    cost[k*numBuckets+j] = best;
+                    previous[k*numBuckets+j] = uint16_t(bestp);
+                }
+            }
+
+            uint32_t j = numBuckets-1;
+            for (uint32_t k=numFree; k > 0; k--) {
+                sizeClasses[numFixed+k-1] = uint16_t((j+1)*8);
+                j = previous[(k-1)*numBuckets+j];
+            }
+            GCAssert(j == first-1);
+        }
+
+        if (cumulative != NULL)
+            VMPI_free(cumulative);
+        if (itemCost != NULL)
+            VMPI_free(itemCost);
+        if (cost != NULL)
+            VMPI_free(cost);
+        if (previous != NULL)
+            VMPI_free(previous);
+        return result;
+    }
+
+    /*static*/
+    bool SizeClassHistogram::IsValid(const uint16_t* sizeClasses, const int16_t* defaults, uint32_t numClasses)
+    {
+        if (sizeClasses[0] != defaults[0] || sizeClasses[numClasses-1] != defaults[numClasses-1])
+            return false;
+        for (uint32_t i=1; i < numClasses; i++) {
+            if ((sizeClasses[i] & 7) != 0 || sizeClasses[i] <= sizeClasses[i-1])
+                return false;
+        }
+        return true;
+    }
+
+    /*static*/
+    void SizeClassHistogram::LogHeader(const char* name)
+    {
+        GCLog("[mem] %s size classes\n", name);
+        GCLog("[mem] %6s %10s %12s %12s %6s %10s %7s\n", "size", "requests", "requested", "rounded", "waste", "live", "blocks");
+    }
+
+    /*static*/
+    void SizeClassHistogram::LogStats(const SizeClassStats& stats)
+    {
+        if (stats.requests == 0 && stats.blocks == 0)
+            return;
+        double waste = stats.bytesRounded == 0 ? 0 : 100.0 * double(stats.bytesRounded - stats.bytesRequested) / double(stats.bytesRounded);
+        GCLog("[mem] %6u %10llu %12llu %12llu %5.1f%% %10u %7u\n",
+              unsigned(stats.itemSize),
+              (unsigned long long)stats.requests,
+              (unsigned long long)stats.bytesRequested,
+              (unsigned long long)stats.bytesRounded,
+              waste,
+              unsigned(stats.liveItems),
+              unsigned(stats.blocks));
+    }
+
+    void SizeClassHistogram::LogLargeRequests() const
+    {
+        if (IsEnabled())
+            GCLog("[mem] %6s %10llu %12llu\n", "large", (unsigned long long)largeRequests, (unsigned long long)largeBytes);
+    }
+}
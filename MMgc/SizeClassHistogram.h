@@ -0,0 +1,111 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __SizeClassHistogram__
+#define __SizeClassHistogram__
+
+namespace MMgc
+{
+    /**
+     * Statistics for one size class of FixedMalloc or GC, see
+     * FixedMalloc::GetSizeClassStats and GC::GetSizeClassStats.  The requests
+     * are counted only while size-class statistics are enabled.
+     */
+    struct SizeClassStats
+    {
+        uint32_t itemSize;          // The size of the items of the class
+        uint64_t requests;          // The number of requests the class served
+        uint64_t bytesRequested;    // The number of bytes those requests asked for
+        uint64_t bytesRounded;      // requests * itemSize
+        size_t liveItems;           // The number of items allocated now
+        size_t blocks;              // The number of blocks the class holds now
+    };
+
+    /**
+     * A histogram of the sizes of small-object requests, kept by FixedMalloc and GC
+     * while size-class statistics are enabled, with 8-byte buckets: bucket i counts
+     * the requests that need an item of 8*i+1 to 8*i+8 bytes.
+     *
+     * ComputeSizeClasses fits a size-class table to the histogram.  An embedder
+     * can record a histogram for its workload and ship the resulting table in
+     * GCHeapConfig::fixedMallocSizeClasses and GCConfig::sizeClasses.
+     *
+     * The histogram does no locking of its own.  The storage is allocated by
+     * Init with VMPI_alloc, so FixedMalloc can keep a histogram of itself.
+     */
+    class SizeClassHistogram
+    {
+    public:
+        SizeClassHistogram();
+        ~SizeClassHistogram();
+
+        /**
+         * Start recording requests of up to 'largestAlloc' bytes, which must be
+         * a multiple of 8.
+         *
+         * @return false if the storage could not be allocated.
+         */
+        bool Init(uint32_t largestAlloc);
+
+        // Free the storage, if any.
+        void Destroy();
+
+        // @return true if requests are being recorded.
+        bool IsEnabled() const { return counts != NULL; }
+
+        // Record a request for 'askSize' bytes that needs an item of 'size' bytes.
+        // Requests larger than the largest bucket are only counted.
+        void Record(size_t size, size_t askSize);
+
+        // Add the requests that needed more than 'previousSize' bytes and at most
+        // 'itemSize' bytes to 'stats'.
+        void Accumulate(uint32_t previousSize, uint32_t itemSize, SizeClassStats& stats) const;
+
+        /**
+         * Compute a table of 'numClasses' size classes that minimizes the memory
+         * used by the recorded requests, counting both the rounding of each
+         * request to its class and the part of a block that is too small for
+         * one more item.  'usableBlockBytes' is the number of bytes in a block
+         * that can hold items.
+         *
+         * The first 'numFixed' entries of 'sizeClasses' are given by the caller
+         * and left alone; they must be no larger than the largest bucket.  The
+         * last entry is the largest bucket's size, so that every small request
+         * still has a class.
+         *
+         * @return false if no requests have been recorded, leaving 'sizeClasses'
+         *         unchanged.
+         */
+        bool ComputeSizeClasses(uint16_t* sizeClasses, uint32_t numClasses, uint32_t numFixed, size_t usableBlockBytes) const;
+
+        /**
+         * @return true if 'sizeClasses' is a table of 'numClasses' size classes that
+         *         can replace 'defaults': it is strictly increasing, every entry is
+         *         a multiple of 8 except for the first, which must equal the first
+         *         default, and the last equals the last default.
+         */
+        static bool IsValid(const uint16_t* sizeClasses, const int16_t* defaults, uint32_t numClasses);
+
+        // Log the column headings for LogStats, for the allocator 'name'.
+        static void LogHeader(const char* name);
+
+        // Log 'stats', unless the class has neither requests nor blocks.
+        static void LogStats(const SizeClassStats& stats);
+
+        // Log the requests larger than the largest bucket.
+        void LogLargeRequests() const;
+
+        uint64_t largeRequests;     // Requests larger than the largest bucket
+        uint64_t largeBytes;        // The bytes asked for by those requests
+
+    private:
+        uint32_t numBuckets;
+        uint64_t* counts;           // Requests per bucket
+        uint64_t* bytes;            // Bytes asked for per bucket
+    };
+}
+
+#endif /* __SizeClassHistogram__ */
@@ -59,9 +59,7 @@ namespace MMgc
      */
     template<class T> class WriteBarrier
     {
-#ifdef MMGC_HEAP_GRAPH
         friend class GC;    // for location()
-#endif
         
     private:
         T set(const T tNew);
@@ -103,9 +101,8 @@ namespace MMgc
         // WriteBarriers on the stack with it
         WriteBarrier(const WriteBarrier<T>& toCopy);    // unimplemented
 
-#ifdef MMGC_HEAP_GRAPH
+        // Used by MMGC_HEAP_GRAPH and by GCCompactor's reference fixup.
         const T* location() const { return &t; }
-#endif
         
         T t;
     };
@@ -116,9 +113,7 @@ namespace MMgc
      */
     template<class T> class WriteBarrierRC
     {
-#ifdef MMGC_HEAP_GRAPH
         friend class GC;    // for location()
-#endif
 
     private:
         T set(const T tNew);
@@ -164,9 +159,8 @@ namespace MMgc
         // WriteBarrierRCs on the stack with it
         WriteBarrierRC(const WriteBarrierRC<T>& toCopy);
 
-#ifdef MMGC_HEAP_GRAPH
+        // Used by MMGC_HEAP_GRAPH and by GCCompactor's reference fixup.
         const T* location() const { return &t; }
-#endif
         
         T t;
     };
@@ -19,6 +19,15 @@
 
 //#define ZCT_TESTING                   // Test the handling of a failure to extend the ZCT
 
+#if defined __GNUC__
+    #define ZCT_PREFETCH(p) __builtin_prefetch((const void*)(p))
+#elif defined _MSC_VER && (defined MMGC_IA32 || defined MMGC_AMD64)
+    #include <xmmintrin.h>
+    #define ZCT_PREFETCH(p) _mm_prefetch((const char*)(p), _MM_HINT_T0)
+#else
+    #define ZCT_PREFETCH(p) ((void)0)
+#endif
+
 namespace MMgc
 {
     /* The ZCT is implemented as a two-level table.  Given a ZCT index, the
@@ -67,6 +76,19 @@ namespace MMgc
      * - The ZCT will honor calls to Pin() from prereap() but not necessarily any
      *   calls to Pin() earlier than that.  When an object is added to the ZCT its
      *   pinned flag is cleared.  (This is consistent with the old ZCT code.)
+     *
+     *
+     * Reap slices (GCConfig::reapSlice):
+     *
+     * A reap that has used up its slice stops popping the ZCT and puts the objects
+     * it pinned back on top of the ZCT, with new indices.  The objects below them are
+     * left as they are; they are visited by the next reap, which scans the stack
+     * again.  Some of them may still be pinned by the reap that was cut short, which
+     * is safe: a pinned object is only kept for another reap.
+     *
+     * The deadline is checked every kDeadlineCheckInterval entries, so a reap
+     * always makes some progress, but a single finalizer that runs long (think of
+     * an array releasing a million elements) can't be cut short.
      */
 
 #ifdef ZCT_TESTING
@@ -81,6 +103,7 @@ namespace MMgc
         , blocktop(NULL)
         , reaping(false)
         , budget(0)
+        , reapSliceTicks(0)
         , bottom(NULL)
         , top(NULL)
         , limit(NULL)
@@ -144,6 +167,13 @@ namespace MMgc
         }
     }
 
+    void ZCT::SetReapSlice(uint32_t micros)
+    {
+        reapSliceTicks = micros * VMPI_getPerformanceFrequency() / 1000000;
+        if (micros > 0 && reapSliceTicks == 0)
+            reapSliceTicks = 1;
+    }
+
     void ZCT::Destroy()
     {
         ClearBlockTable();
@@ -236,7 +266,7 @@ namespace MMgc
             shouldGrow = true;
         else {
             // 'obj' will not be reaped as it's on the stack; we'll add it to the ZCT below.
-            Reap();
+            Reap(true, true);
             uint32_t avail = AvailableInCurrentSegment();
             budget = gc->policy.queryZCTBudget(uint32_t(blocktop - blocktable));
             if (avail == 0)
@@ -279,7 +309,7 @@ namespace MMgc
         return (slowState ? slowTopIndex : topIndex) + CAPACITY(RCObject*) <= RCObject::ZCT_CAPACITY;
     }
 
-    void ZCT::Reap(bool scanStack)
+    void ZCT::Reap(bool scanStack, bool timeBounded)
     {
         if(gc->collecting)
             return;
@@ -308,6 +338,11 @@ namespace MMgc
         size_t bytes_reaped = 0;
         size_t blocks_before = gc->GetNumBlocks();
 
+        uint64_t deadline = 0;
+        if (reapSliceTicks != 0 && timeBounded && topIndex < RCObject::ZCT_CAPACITY/2)
+            deadline = start + reapSliceTicks;
+        uint32_t untilDeadlineCheck = kDeadlineCheckInterval;
+
         // Note that we must pin from root segments even if scanStack is false, because the
         // MMGC_GC_ROOT_THREAD creates one AutoRCRootSegment that is not managed by avmStackAlloc.
         // The root segment list should be very short if scanStack==false so performance-wise
@@ -361,6 +396,18 @@ namespace MMgc
                     break;
                 PopFastSegment();
             }
+
+            if (deadline != 0 && --untilDeadlineCheck == 0) {
+                untilDeadlineCheck = kDeadlineCheckInterval;
+                if (VMPI_getPerformanceCounter() >= deadline)
+                    break;
+            }
+
+            // The reaper destroys objects that were last touched a while ago, when
+            // their reference counts dropped to zero.
+            if (uint32_t(top - bottom) > kPrefetchDistance)
+                ZCT_PREFETCH(*(top - kPrefetchDistance - 1));
+
             RCObject *rcobj = *--top;
             --topIndex;
 
@@ -379,7 +426,12 @@ namespace MMgc
                 ReapObject(rcobj);
             }
         }
-        UsePinningMemory();
+
+        const uint32_t objects_left = topIndex;
+        if (objects_left == 0)
+            UsePinningMemory();
+        else
+            RestorePinnedObjects();
 
 #ifdef GCDEBUG
         if(gc->validateDefRef)
@@ -391,13 +443,14 @@ namespace MMgc
 
         if(gc->heap->Config().gcstats && objects_reaped > 0) {
             size_t blocks_after = gc->GetNumBlocks();
-            gc->gclog("[mem] DRC reaped %u objects (%u kb) freeing %u pages (%u kb) in %.2f millis (%.4f s)\n",
+            gc->gclog("[mem] DRC reaped %u objects (%u kb) freeing %u pages (%u kb) in %.2f millis (%.4f s), %u entries left\n",
                       objects_reaped,
                       unsigned(bytes_reaped/1024),
                       unsigned(blocks_before - blocks_after),
                       unsigned(blocks_after * GCHeap::kBlockSize / 1024),
                       GC::duration(start),
-                      GC::duration(gc->t0)/1000);
+                      GC::duration(gc->t0)/1000,
+                      objects_left);
         }
 
         reaping = false;
@@ -406,9 +459,10 @@ namespace MMgc
         for ( uint32_t i=0 ; i < topIndex ; i++ ) {
             // The first element of each block is usually NULL because it has
             // been used as a link for pinList.
+            // The objects left by a reap slice may still be pinned.
             if (Get(i) != NULL) {
                 GCAssert(Get(i)->getZCTIndex() == i);
-                GCAssert(!Get(i)->IsPinned());
+                GCAssert(objects_left > 0 || !Get(i)->IsPinned());
             }
         }
 #endif
@@ -507,6 +561,29 @@ namespace MMgc
         pinLast = NULL;
     }
 
+    void ZCT::RestorePinnedObjects()
+    {
+        GCAssert(reaping);
+
+        // An entry whose object has left the ZCT since it was pinned is stale.
+        uint32_t index = 0;
+        while (pinList != NULL) {
+            RCObject** block = pinList;
+            pinList = (RCObject**)block[0];
+            RCObject** blockLimit = block == pinLast ? pinTop : block + CAPACITY(RCObject*);
+            index++;
+            for ( RCObject** p = block+1 ; p < blockLimit ; p++, index++ ) {
+                RCObject* obj = *p;
+                if (obj->InZCT() && obj->getZCTIndex() == index) {
+                    obj->ClearZCTFlag();
+                    Add(obj);
+                }
+            }
+            FreeBlock(block);
+        }
+        pinLast = NULL;
+    }
+
     REALLY_INLINE void ZCT::PinObject(RCObject* obj)
     {
         if (pinTop == pinLimit) {
@@ -544,7 +621,41 @@ namespace MMgc
         ZCT* zct = (ZCT*)arg;
         GC* gc = zct->gc;
         char* stackBase = (char*)gc->GetStackTop();
-        zct->PinStackObjects(stackPointer, stackBase - (char*)stackPointer);
+        if (gc->exactStackFrames)
+            zct->PinStackObjectsWithFrames((char*)stackPointer, stackBase);
+        else
+            zct->PinStackObjects(stackPointer, stackBase - (char*)stackPointer);
+    }
+
+    void ZCT::PinStackObjectsWithFrames(const char* start, const char* end)
+    {
+        GCStackFrames& frames = gc->stackFrames;
+        frames.Begin(start, end);
+        gc->DoStackFramesCallbacks(frames);
+
+        const char* p = start;
+        for ( uint32_t i=0 ; i < frames.m_count ; i++ ) {
+            const GCStackFrames::Frame& frame = frames.m_frames[i];
+            if ((const char*)frame.base > p)
+                PinStackObjects(p, (const char*)frame.base - p);
+            // Pin each run of words that can hold pointers.
+            uint32_t j = 0;
+            while (j < frame.nwords) {
+                if (!GCStackFrames::IsSet(frame.bitmap, j)) {
+                    j++;
+                    continue;
+                }
+                uint32_t run = j;
+                while (j < frame.nwords && GCStackFrames::IsSet(frame.bitmap, j))
+                    j++;
+                PinStackObjects(frame.base + run, (j - run) * sizeof(void*));
+            }
+            p = (const char*)(frame.base + frame.nwords);
+        }
+        if (end > p)
+            PinStackObjects(p, end - p);
+
+        frames.End();
     }
 
     void ZCT::PinRootSegments()
@@ -7,6 +7,13 @@
 #ifndef __GCZCT__
 #define __GCZCT__
 
+#ifdef VMCFG_SELFTEST
+namespace avmplus
+{
+    namespace ST_mmgc_reap { class ST_mmgc_reap; }
+}
+#endif
+
 namespace MMgc
 {
     /**
@@ -19,11 +26,19 @@ namespace MMgc
      *
      * When Reap() is called the ZCT is traversed; objects that are not pinned are
      * destroyed.  Reap runs finalizers, which means more objects may be entered
-     * into the ZCT and visited by Reap.  The process is not currently time-bounded.
+     * into the ZCT and visited by Reap.
+     *
+     * Reaping is not time-bounded unless a reap slice has been set (GCConfig::reapSlice).
+     * Then the reaps started because the ZCT has filled up end when the slice is used up,
+     * leaving the objects not yet visited in the ZCT for later reaps, which are
+     * interleaved with the mutator's work.
      */
     class ZCT
     {
         friend class GC;
+#ifdef VMCFG_SELFTEST
+        friend class avmplus::ST_mmgc_reap::ST_mmgc_reap;
+#endif
     public:
         ZCT();
 
@@ -44,6 +59,12 @@ namespace MMgc
          */
         void SetGC(GC* gc);
 
+        /**
+         * Bound the reaps started by Add() to 'micros' microseconds each; see the
+         * class comment.  Zero restores the default, unbounded reaping.
+         */
+        void SetReapSlice(uint32_t micros);
+
         /**
          * MUST be called by the collector when the collector sets collecting=true
          */
@@ -85,8 +106,15 @@ namespace MMgc
          * whether they were pinned by Reap or explicitly from the prereap() callback
          * or even earlier.  Reap does not unpin any pinned objects that were not in
          * the ZCT.
+         *
+         * If timeBounded is true and a reap slice has been set then Reap returns
+         * when the slice has been used up, even if the ZCT is not empty.  The pinned
+         * objects that were visited are then unpinned, but the objects that were not
+         * visited may remain pinned until a later reap visits them.  The bound is
+         * ignored if the ZCT is more than half full, so that it can't fill up
+         * because reaping doesn't keep up.
          */
-        void Reap(bool scanNativeStack=true);
+        void Reap(bool scanNativeStack=true, bool timeBounded=false);
 
         /**
          * Throw away unused memory (discretionary); to be called at the end of
@@ -147,6 +175,11 @@ namespace MMgc
         // 'start' must itself be aligned.
         void PinStackObjects(const void *start, size_t len);
 
+        // Like PinStackObjects, but for the frames that the GCCallbacks report
+        // (GCConfig::exactStackFrames) only the words that can hold pointers are
+        // examined.
+        void PinStackObjectsWithFrames(const char* start, const char* end);
+
         // The object was pinned, leave it in the ZCT by moving it to the pinning memory.
         void PinObject(RCObject* obj);
 
@@ -169,6 +202,10 @@ namespace MMgc
         // Discard the pinning memory
         void ClearPinningMemory();
 
+        // Reaping ended with objects left in the ZCT: add the objects in the pinning
+        // memory to the ZCT again, and discard the pinning memory.
+        void RestorePinnedObjects();
+
         // Discard a block that is no longer used because ZCT popping during reaping
         // has gone below the block's beginning.
         void PopFastSegment();
@@ -188,6 +225,12 @@ namespace MMgc
         // When adding should pin be cleared or kept?
         uint32_t KeepPinned();
 
+        // Number of entries popped between checks of a reap's deadline.
+        static const uint32_t kDeadlineCheckInterval = 32;
+
+        // Number of entries ahead of the current one whose objects are prefetched.
+        static const uint32_t kPrefetchDistance = 8;
+
         // Private data
 
         GC *gc;
@@ -196,6 +239,7 @@ namespace MMgc
         bool reaping;               // Are we reaping the zct?
 
         uint32_t budget;            // Remaining number of full blocks to grow by before reaping
+        uint64_t reapSliceTicks;    // Time bound of reaps started by Add(), or 0
 
         // Fast path state
         RCObject **bottom;          // Current segment
@@ -25,18 +25,27 @@ MMgc_CXXSRCS := $(MMgc_CXXSRCS) \
   $(curdir)/GC.cpp \
   $(curdir)/GCAlloc.cpp \
   $(curdir)/GCAllocObject.cpp \
+  $(curdir)/GCBackgroundSweeper.cpp \
+  $(curdir)/GCCompactor.cpp \
+  $(curdir)/GCAllocationSampler.cpp \
+  $(curdir)/GCHeapSnapshot.cpp \
   $(curdir)/GCDebug.cpp \
   $(curdir)/GCHashtable.cpp \
   $(curdir)/GCHeap.cpp \
+  $(curdir)/GCHeapReleaser.cpp \
   $(curdir)/GCLargeAlloc.cpp \
   $(curdir)/GCLog.cpp \
   $(curdir)/GCMemoryProfiler.cpp \
   $(curdir)/GCObject.cpp \
+  $(curdir)/GCParallelMarker.cpp \
   $(curdir)/GCPolicyManager.cpp \
+  $(curdir)/GCStackFrames.cpp \
   $(curdir)/GCStack.cpp \
   $(curdir)/GCTests.cpp \
   $(curdir)/GCThreads.cpp \
+  $(curdir)/GCTraceLog.cpp \
   $(curdir)/PageMap.cpp \
+  $(curdir)/SizeClassHistogram.cpp \
   $(curdir)/ZCT.cpp \
   $(curdir)/GCGlobalNew.cpp \
   $(curdir)/../other-licenses/wtf/AddressSpaceRandomization.cpp \
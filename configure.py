@@ -611,8 +611,8 @@ elif the_os == "linux":
 #    if cpu == "x86_64":
 #        # workaround https://bugzilla.mozilla.org/show_bug.cgi?id=467776
 #        OPT_CXXFLAGS += '-fno-schedule-insns2 '
-    if config.getDebug():
-        OS_LIBS.append("dl")
+    # dladdr and dlsym, for the jit code cache
+    OS_LIBS.append("dl")
 elif the_os == "android":
     BASE_D_FLAGS = "-DANDROID -DHAVE_SYS_UIO_H -Dlinux -DUNIX -Dcompress=zlib_compress "
 
@@ -3855,6 +3855,20 @@ return the result of the comparison ToPrimitive(x) == y.
 #endif
     }
 
+#if defined VMCFG_NANOJIT && defined AVMPLUS_VERBOSE
+    void AvmCore::dumpBindingCaches()
+    {
+        if (!isVerbose(VB_jit))
+            return;
+        for (LivePoolNode* node = livePools; node != NULL; node = node->next)
+        {
+            PoolObject* pool = (PoolObject*)(void*)(node->pool->get());
+            if (pool && pool->codeMgr && pool->codeMgr->bindingCaches)
+                pool->codeMgr->dumpBindingCaches(console);
+        }
+    }
+#endif
+
     void AvmCore::postsweep()
     {
 #ifdef VMCFG_NANOJIT
@@ -3877,6 +3891,25 @@ return the result of the comparison ToPrimitive(x) == y.
 #endif
     }
 
+    void AvmCore::enumerateStackFrames(MMgc::GCStackFrames& frames)
+    {
+#ifdef VMCFG_NANOJIT
+        // The MethodFrames are linked from the innermost frame outwards, which is
+        // the order GCStackFrames wants.
+        for (MethodFrame* f = currentMethodFrame; f != NULL; f = f->next)
+        {
+            MethodEnv* env = f->env();
+            if (env == NULL || env->method->isNative())
+                continue;
+            const JitStackMap* map = env->method->jit_stack_map();
+            if (map != NULL)
+                map->addFrame(f, frames);
+        }
+#else
+        (void)frames;
+#endif
+    }
+
     REALLY_INLINE int AvmCore::numStringsCheckLoadBalance()
     {
         int m = numStrings;
@@ -5500,6 +5533,18 @@ return the result of the comparison ToPrimitive(x) == y.
         // on kEmpty ditch WORDCODE and switch to abc interpreter
     }
 
+    uint32_t AvmCore::captureMethodFrames(uintptr_t* frames, uint32_t maxDepth) const
+    {
+        uint32_t depth = 0;
+        for (MethodFrame* f = currentMethodFrame; f != NULL && depth < maxDepth; f = f->next)
+        {
+            MethodEnv* env = f->env();
+            if (env && env->method)
+                frames[depth++] = uintptr_t(env->method);
+        }
+        return depth;
+    }
+
     CodeContext* AvmCore::codeContext() const
     {
         for (MethodFrame* f = currentMethodFrame; f != NULL; f = f->next)
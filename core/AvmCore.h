@@ -73,9 +73,23 @@ const int kBufferPadding = 16;
 		bool opt_array_read_fastpath;
         // Generate vector element access inline for integral index type.
 		bool opt_inline_vector_access;
+        // Replace early bound calls to small final methods (slot getters and setters, methods
+        // returning a constant or their argument) by their body.
+        bool opt_inline_methods;
+        // Hoist the vector pointer, length and data loads out of loops over local vectors,
+        // and drop the range checks that the loop condition already implies.
+        bool opt_vector_loops;
+        // Assemble the methods that reach the OSR invocation threshold on a compiler
+        // thread, and keep interpreting them until the code is ready (JitCompileQueue).
+        bool background_compile;
+        // Directory of the persistent code cache (JitCodeCache), or NULL for none.
+        const char* code_cache;
+        // Record the operand types of arithmetic and compare operations while a method
+        // is interpreted before OSR, and specialize its inline fastpaths for them.
+        bool type_feedback;
 
         // Initialize with default options.
-        JitConfig() : opt_inline(true), opt_array_read_fastpath(false), opt_inline_vector_access(true) {}
+        JitConfig() : opt_inline(true), opt_array_read_fastpath(false), opt_inline_vector_access(true), opt_inline_methods(true), opt_vector_loops(true), background_compile(false), code_cache(NULL), type_feedback(true) {}
     };
 #endif
 
@@ -469,6 +483,7 @@ const int kBufferPadding = 16;
     class AvmCore : public MMgc::GCRoot
     {
         friend class CodegenLIR;
+        friend class JitCodeCache;
         friend class halfmoon::JitFriend;
         friend class Deoptimizer;
         friend class EnterCodeContext;
@@ -518,6 +533,7 @@ const int kBufferPadding = 16;
             void postsweep() { if(core) core->postsweep(); }
             void log(const char *str) { if(core) core->console << str; }
             void oom(MMgc::MemoryStatus status) { if(core) core->oom(status); }
+            void enumerateStackFrames(MMgc::GCStackFrames& frames) { if(core) core->enumerateStackFrames(frames); }
         private:
             AvmCore *core;
         };
@@ -1052,6 +1068,12 @@ const int kBufferPadding = 16;
         virtual void postsweep();
         virtual void oom(MMgc::MemoryStatus status);
 
+        /**
+         * Report the frames of jit-compiled methods on the stack that have stack
+         * maps, for GCConfig::exactStackFrames.
+         */
+        void enumerateStackFrames(MMgc::GCStackFrames& frames);
+
     public:
         DomainMgr* domainMgr() const;
 
@@ -1904,6 +1926,15 @@ const int kBufferPadding = 16;
          * Creates a StackTrace from the current executing call stack
          */
         StackTrace* newStackTrace();
+
+        /**
+         * Store the MethodInfo of each of the innermost AS3 frames on the call stack
+         * in 'frames', innermost first, up to 'maxDepth' of them.  Does not allocate,
+         * so it can be used by the GC's allocation sampler.
+         *
+         * @return the number of frames stored
+         */
+        uint32_t captureMethodFrames(uintptr_t* frames, uint32_t maxDepth) const;
         
         CodeContext* codeContext() const;
         Namespace* dxns() const;
@@ -2224,6 +2255,13 @@ const int kBufferPadding = 16;
 #ifdef VMCFG_NANOJIT
     public:
         void flushBindingCachesNextSweep();
+#ifdef AVMPLUS_VERBOSE
+        /**
+         * Print the statistics of the binding caches of the live pools, if
+         * -Dverbose=jit is on.  Called by the host when the program has ended.
+         */
+        void dumpBindingCaches();
+#endif
 #endif
 
 #ifdef VMCFG_TELEMETRY
@@ -11,6 +11,8 @@
 
 #include "CodegenLIR.h"
 #include "exec-osr.h"
+#include "JitCompileQueue.h"
+#include "JitCodeCache.h"
 
 #if defined(WIN32) && defined(AVMPLUS_ARM)
 #include <intrin.h>
@@ -672,6 +674,10 @@ namespace avmplus
         catch_label("catch"),
         call_error_label("call_error"),
         inlineFastpath(false),
+        optVectorLoops(false),
+        vectorAccesses(NULL),
+        loopPreheaders(NULL),
+        osrJump(NULL),
         call_cache_builder(*alloc1, *initCodeMgr(pool)),
         get_cache_builder(*alloc1, *pool->codeMgr),
         set_cache_builder(*alloc1, *pool->codeMgr),
@@ -682,7 +688,10 @@ namespace avmplus
         blockLabels(NULL),
         cseFilter(NULL),
         noise(noise),
-        jit_debug_info(NULL)
+        jit_debug_info(NULL),
+        assm(NULL),
+        stackMaps(NULL),
+        relocs(NULL)
         DEBUGGER_ONLY(, haveDebugger(core->debugger() != NULL) )
     {
         #ifdef AVMPLUS_MAC_CARBON
@@ -831,6 +840,10 @@ namespace avmplus
             return has_backedges;
         }
 
+        bool isReachable() const {
+            return reachable;
+        }
+
         void setNotNull(LIns* ins, Traits* t) {
             if (isNullable(t))
                 checked->put(ins, true);
@@ -1607,6 +1620,13 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
             }
         }
 
+#ifndef VMCFG_VECTOR_SMASH_PROTECTION
+        // Values hoisted out of a loop must not be observed by the debugger or
+        // reloaded by an exception handler, see optimizeVectorLoops().
+        optVectorLoops = inlineFastpath && core->config.jitconfig.opt_vector_loops &&
+                         !haveDebugger && !driver->hasReachableExceptions();
+#endif
+
 #if defined(NANOJIT_ARM) && defined(VMCFG_FLOAT)
         // The LIR instructions for float and float4 are not supported by nanojit
         // for soft float, and we are planning to rip out soft float entirely.
@@ -2027,10 +2047,155 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         callIns(FUNCTIONID(osr_adjust_frame), 4,
                 methodFrame, haveDebugger ? csn : InsConstPtr(0), vars, tags);
         branchToAbcPos(LIR_j, NULL, osr->osrPc());
+        osrJump = getCodegenLabel(osr->osrPc()).unpatchedEdges->head.branchIns;
         emitLabel(no_osr_label);
         resumeCSE();
     }
 
+    // An inline vector read or write, see emitInlineVectorRead() and emitInlineVectorWrite().
+    struct VectorAccess
+    {
+        LIns* check;        // jf (geui index len) -> arrayinbounds
+        LIns* slowCall;     // the helper called when the check fails
+        LIns* slowExit;     // for a write, the jump from the helper to the end; NULL for a read
+    };
+
+    // A local holding a vector, loaded with its length and data ahead of a loop.
+    struct HoistedVector
+    {
+        int32_t disp;       // the local's offset in vars
+        int32_t lenOffset;
+        int32_t dataOffset;
+        LIns* ptr;
+        LIns* len;
+        LIns* data;
+    };
+
+    static const int kMaxHoistedVectors = 4;
+
+    // The code emitted by emitLoopPreheader() in front of a loop.
+    struct LoopPreheader
+    {
+        const uint8_t* header;      // the loop header
+        LIns* entry;                // the jump over the body to the condition, or NULL
+        CodegenLabel* label;        // the entry of the OSR jump, or NULL
+        LIns* zero;
+        int count;
+        HoistedVector vectors[kMaxHoistedVectors];
+    };
+
+    // Stands in for a null vector in the preheader, so that its length and data can
+    // be loaded unconditionally; the loop only uses them after a null check.
+    static const uint64_t emptyVectorObject[16] = { 0 };
+
+    // The offsets of the data pointer and length that the inline vector accesses use
+    // for a vector of type t.
+    bool CodegenLIR::vectorOffsets(Traits* t, int32_t& dataOffset, int32_t& lenOffset)
+    {
+        if (t == NULL)
+            return false;
+        if (t == VECTORINT_TYPE) {
+            dataOffset = int32_t(offsetof(IntVectorObject, m_list.m_header.data));
+            lenOffset = int32_t(offsetof(IntVectorObject, m_list.m_header.len));
+        } else if (t == VECTORUINT_TYPE) {
+            dataOffset = int32_t(offsetof(UIntVectorObject, m_list.m_header.data));
+            lenOffset = int32_t(offsetof(UIntVectorObject, m_list.m_header.len));
+        } else if (t == VECTORDOUBLE_TYPE) {
+            dataOffset = int32_t(offsetof(DoubleVectorObject, m_list.m_header.data));
+            lenOffset = int32_t(offsetof(DoubleVectorObject, m_list.m_header.len));
+#ifdef VMCFG_FLOAT
+        } else if (t == VECTORFLOAT_TYPE) {
+            dataOffset = int32_t(offsetof(FloatVectorObject, m_list.m_header.data));
+            lenOffset = int32_t(offsetof(FloatVectorObject, m_list.m_header.len));
+        } else if (t == VECTORFLOAT4_TYPE) {
+            dataOffset = int32_t(offsetof(Float4VectorObject, m_list.m_header.data));
+            lenOffset = int32_t(offsetof(Float4VectorObject, m_list.m_header.len));
+#endif
+        } else if (t->subtypeof(VECTOROBJ_TYPE)) {
+            dataOffset = int32_t(offsetof(ObjectVectorObject, m_list.m_header.data));
+            lenOffset = int32_t(offsetof(ObjectVectorObject, m_list.m_header.len));
+        } else {
+            return false;
+        }
+        AvmAssert(dataOffset + sizeof(void*) <= sizeof(emptyVectorObject) &&
+                  lenOffset + sizeof(uint32_t) <= sizeof(emptyVectorObject));
+        return true;
+    }
+
+    // Load the vectors held in locals at a loop header, with their length and data,
+    // ahead of the loop.  Called before the jump over the body of a loop compiled
+    // with its condition at the bottom, or before the header of a loop entered by
+    // falling into it.  optimizeVectorLoops() later replaces the loads in the loop
+    // by these ones where it can show that they are invariant.
+    LoopPreheader* CodegenLIR::emitLoopPreheader(const uint8_t* header)
+    {
+        if (!driver->hasFrameState(header))
+            return NULL;
+        const FrameState* loopState = driver->getFrameState(header);
+        CodegenLabel& headerLabel = getCodegenLabel(header);
+        if (!loopState->targetOfBackwardsBranch || headerLabel.labelIns)
+            return NULL;
+        bool osrEntry = osr && osr->osrPc() == header;
+        if (osrEntry && loopState->stackDepth != 0)
+            return NULL;
+        // Other forward branches to the header would bypass the preheader; the OSR
+        // jump, emitted first, is retargeted to it by optimizeVectorLoop().
+        if (headerLabel.unpatchedEdges) {
+            if (!osrEntry || headerLabel.unpatchedEdges->tail ||
+                headerLabel.unpatchedEdges->head.branchIns != osrJump)
+                return NULL;
+        }
+
+        LoopPreheader* ph = new (*alloc1) LoopPreheader();
+        ph->header = header;
+        ph->entry = NULL;
+        ph->label = NULL;
+        ph->count = 0;
+        for (int i = 0, n = ms->local_count(); i < n && ph->count < kMaxHoistedVectors; i++) {
+            const FrameValue& v = loopState->value(i);
+            HoistedVector& hv = ph->vectors[ph->count];
+            if (v.sst_mask == (1 << SST_scriptobject) && vectorOffsets(v.traits, hv.dataOffset, hv.lenOffset)) {
+                hv.disp = i << VARSHIFT(info);
+                ph->count++;
+            }
+        }
+        if (ph->count == 0)
+            return NULL;
+
+        // The values are those of the loop header, also for the OSR entry.
+        const FrameState* savedState = state;
+        state = loopState;
+        if (osrEntry) {
+            ph->label = &createLabel("osr_preheader");
+            emitLabel(*ph->label);
+        }
+        for (int k = 0; k < ph->count; k++) {
+            HoistedVector& hv = ph->vectors[k];
+            int i = hv.disp >> VARSHIFT(info);
+            hv.ptr = localGetp(i);
+            LIns* obj = hv.ptr;
+            if (!loopState->value(i).notNull)
+                obj = lirout->insChoose(eqp0(hv.ptr), InsConstPtr(emptyVectorObject), hv.ptr, use_cmov);
+            hv.len = loadIns(LIR_ldi, hv.lenOffset, obj, ACCSET_OTHER, LOAD_NORMAL);
+            hv.data = loadIns(LIR_ldp, hv.dataOffset, obj, ACCSET_OTHER, LOAD_NORMAL);
+        }
+        ph->zero = InsConst(0);
+        state = savedState;
+        loopPreheaders = new (*alloc1) Seq<LoopPreheader*>(ph, loopPreheaders);
+        return ph;
+    }
+
+    void CodegenLIR::recordVectorAccess(CodegenLabel& inbounds, LIns* slowCall, LIns* slowExit)
+    {
+        if (!optVectorLoops || !inbounds.unpatchedEdges)
+            return;
+        VectorAccess* access = new (*alloc1) VectorAccess();
+        access->check = inbounds.unpatchedEdges->head.branchIns;
+        access->slowCall = slowCall;
+        access->slowExit = slowExit;
+        vectorAccesses = new (*alloc1) Seq<VectorAccess*>(access, vectorAccesses);
+    }
+
     void CodegenLIR::emitInitializers()
     {
         struct JitInitVisitor: public InitVisitor {
@@ -2465,6 +2630,11 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
     // fallback:
     //     result = op_add_a_aa(coreAddr, lhsa, rhsa);              # handle the general case out-of-line
     // done:
+    //
+    // If the interpreter has recorded the kinds of the operands (MethodInfo::type_feedback),
+    // the intptr fastpath is only emitted if both operands have been intptr atoms, and a
+    // double + double or String + String fastpath is added before the fallback if both
+    // operands have been of that kind.
 
     void CodegenLIR::emitAddAtomToAtom(int i, int j, Traits* type)
     {
@@ -2479,29 +2649,64 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
 
         #ifdef VMCFG_FASTPATH_ADD_INLINE
         if (inlineFastpath) {
+            const uint32_t seen = typeFeedback();
+            const uint32_t both = seen & (seen >> 4);
             CodegenLabel fallback("fallback");
             CodegenLabel done("done");
-            // intptr + intptr fastpath
             suspendCSE();
-            LIns* t0 = xorp(lhs, AtomConstants::kIntptrType);
-            LIns* t1 = xorp(rhs, AtomConstants::kIntptrType);
-            LIns* t2 = binaryIns(LIR_orp, t0, t1);
-            LIns* t3 = andp(t2, AtomConstants::kAtomTypeMask);
-            branchToLabel(LIR_jf, eqp0(t3), fallback);
-            LIns* lhsStripped = subp(lhs, AtomConstants::kIntptrType);
-            #ifdef AVMPLUS_64BIT
-                // restrict range of intptr result to 54 bits
-                // since 64-bit int atoms expect exactly 54 bits of precision, shift bit 54+3 up into the sign bit
-                LIns* lhsShifted = lshp(lhsStripped, atomSignExtendShift-AtomConstants::kAtomTypeSize);
-                LIns* rhsShifted = lshp(rhs, atomSignExtendShift-AtomConstants::kAtomTypeSize);
-                LIns* sumShifted = branchJovToLabel(LIR_addjovp, lhsShifted, rhsShifted, fallback);
-                LIns* sum = rshp(sumShifted, atomSignExtendShift-AtomConstants::kAtomTypeSize);
-            #else
-                LIns* sum = branchJovToLabel(LIR_addjovp, lhsStripped, rhs, fallback);
-            #endif
-            localSet(i, sum, type);
-            JIT_EVENT(jit_add_a_aa_fast_intptr);
-            branchToLabel(LIR_j, NULL, done);
+            if (seen == 0 || (both & MethodInfo::kFeedbackInt)) {
+                // intptr + intptr fastpath
+                CodegenLabel not_intptr("not_intptr");
+                LIns* t0 = xorp(lhs, AtomConstants::kIntptrType);
+                LIns* t1 = xorp(rhs, AtomConstants::kIntptrType);
+                LIns* t2 = binaryIns(LIR_orp, t0, t1);
+                LIns* t3 = andp(t2, AtomConstants::kAtomTypeMask);
+                branchToLabel(LIR_jf, eqp0(t3), not_intptr);
+                LIns* lhsStripped = subp(lhs, AtomConstants::kIntptrType);
+                #ifdef AVMPLUS_64BIT
+                    // restrict range of intptr result to 54 bits
+                    // since 64-bit int atoms expect exactly 54 bits of precision, shift bit 54+3 up into the sign bit
+                    LIns* lhsShifted = lshp(lhsStripped, atomSignExtendShift-AtomConstants::kAtomTypeSize);
+                    LIns* rhsShifted = lshp(rhs, atomSignExtendShift-AtomConstants::kAtomTypeSize);
+                    LIns* sumShifted = branchJovToLabel(LIR_addjovp, lhsShifted, rhsShifted, fallback);
+                    LIns* sum = rshp(sumShifted, atomSignExtendShift-AtomConstants::kAtomTypeSize);
+                #else
+                    LIns* sum = branchJovToLabel(LIR_addjovp, lhsStripped, rhs, fallback);
+                #endif
+                localSet(i, sum, type);
+                JIT_EVENT(jit_add_a_aa_fast_intptr);
+                branchToLabel(LIR_j, NULL, done);
+                emitLabel(not_intptr);
+            }
+            if (both & MethodInfo::kFeedbackDouble) {
+                // double + double fastpath
+                CodegenLabel not_double("not_double");
+                LIns* t0 = xorp(lhs, AtomConstants::kDoubleType);
+                LIns* t1 = xorp(rhs, AtomConstants::kDoubleType);
+                LIns* t3 = andp(binaryIns(LIR_orp, t0, t1), AtomConstants::kAtomTypeMask);
+                branchToLabel(LIR_jf, eqp0(t3), not_double);
+                LIns* lhsd = ldd(subp(lhs, AtomConstants::kDoubleType), 0, ACCSET_OTHER);
+                LIns* rhsd = ldd(subp(rhs, AtomConstants::kDoubleType), 0, ACCSET_OTHER);
+                localSet(i, callIns(FUNCTIONID(doubleToAtom), 2, coreAddr, binaryIns(LIR_addd, lhsd, rhsd)), type);
+                JIT_EVENT(jit_add_a_aa_fast_double);
+                branchToLabel(LIR_j, NULL, done);
+                emitLabel(not_double);
+            }
+            if (both & MethodInfo::kFeedbackString) {
+                // String + String fastpath; the null String is tagged as a String too
+                CodegenLabel not_string("not_string");
+                LIns* t0 = xorp(lhs, AtomConstants::kStringType);
+                LIns* t1 = xorp(rhs, AtomConstants::kStringType);
+                LIns* t3 = andp(binaryIns(LIR_orp, t0, t1), AtomConstants::kAtomTypeMask);
+                branchToLabel(LIR_jf, eqp0(t3), not_string);
+                branchToLabel(LIR_jt, eqp(lhs, AtomConstants::kStringType), not_string);
+                branchToLabel(LIR_jt, eqp(rhs, AtomConstants::kStringType), not_string);
+                LIns* out = callIns(FUNCTIONID(concatStrings), 3, coreAddr, t0, t1);
+                localSet(i, orp(out, AtomConstants::kStringType), type);
+                JIT_EVENT(jit_add_a_aa_fast_string);
+                branchToLabel(LIR_j, NULL, done);
+                emitLabel(not_string);
+            }
             emitLabel(fallback);
             LIns* out = callIns(addFunction, 3, coreAddr, lhs, rhs);
             localSet(i, out, type);
@@ -2614,6 +2819,9 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         this->state = state;
         // get the saved label for our block start and tie it to this location
         CodegenLabel& label = getCodegenLabel(state->abc_pc);
+        // A loop entered by falling into its header: the condition is at the top.
+        if (optVectorLoops && state->targetOfBackwardsBranch && varTracker->isReachable())
+            emitLoopPreheader(state->abc_pc);
         emitLabel(label);
         emitSetPc(state->abc_pc);
 
@@ -3262,7 +3470,13 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         case OP_jump:
         {
             int32_t offset = (int32_t) opd1;
+            // A loop entered by jumping over its body to the condition at the bottom.
+            LoopPreheader* ph = NULL;
+            if (optVectorLoops && offset > 0)
+                ph = emitLoopPreheader(pc+4);
             emit(opcode, uintptr_t(pc+4/*size*/+offset));
+            if (ph)
+                ph->entry = getCodegenLabel(pc+4+offset).unpatchedEdges->head.branchIns;
             break;
         }
         case OP_getslot:
@@ -5029,6 +5243,165 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         return false;
     }
 
+    // Early bound calls to final methods whose whole body is one of these, after
+    // an optional "getlocal0 pushscope", are replaced by the body:
+    //
+    //     getlocal0 getproperty <slot> returnvalue             slot getter
+    //     getlocal0 getlocal1 setproperty <slot> returnvoid    slot setter
+    //     getlocal1 returnvalue                                identity
+    //     pushtrue|pushfalse|pushbyte <n> returnvalue          constant
+    //     returnvoid                                           empty
+    //
+    // None of them can throw, call or loop, so the inlined body needs no exception
+    // edge and no interrupt check, and no StackTrace can miss its frame.  The types
+    // of the slot, the parameter and the result must be the same, so that nothing
+    // is coerced.  The callee doesn't have to be verified yet: the match covers the
+    // whole body, and its header is checked as the verifier would.
+    static const uint32_t kInlineMaxCodeLength = 12;
+
+    bool CodegenLIR::inlineSmallMethod(AbcOpcode opcode, int argc, Traits* result, MethodInfo* mi)
+    {
+        if (opcode != OP_callmethod || !core->config.jitconfig.opt_inline_methods || haveDebugger ||
+            mi->isNative() || mi->abc_body_pos() == NULL)
+            return false;
+
+        const char* why = NULL;
+        int objDisp = state->sp() - argc;
+        Traits* objType = state->value(objDisp).traits;
+        MethodSignaturep ms = mi->getMethodSignature();
+
+        const uint8_t* pos = mi->abc_body_pos();
+        uint32_t maxStack = AvmCore::readU32(pos);
+        uint32_t localCount = AvmCore::readU32(pos);
+        uint32_t initScopeDepth = AvmCore::readU32(pos);
+        uint32_t maxScopeDepth = AvmCore::readU32(pos);
+        uint32_t codeLength = AvmCore::readU32(pos);
+        const uint8_t* pc = pos;
+        const uint8_t* end = pos + codeLength;
+
+        if (codeLength > kInlineMaxCodeLength) {
+            why = "too large";
+        } else if (!mi->isFinal() && !(objType && objType->final)) {
+            why = "may be overridden";
+        } else if (mi->needActivation() || mi->needRestOrArguments() || mi->setsDxns() || mi->hasExceptions()) {
+            why = "needs a frame";
+        } else if (argc != ms->param_count() || result != ms->returnTraits()) {
+            why = "signature";
+        }
+
+        // Match the body.  'kind' describes it for the verbose output.
+        enum { kNone, kGetter, kSetter, kIdentity, kTrue, kFalse, kByte, kEmpty } shape = kNone;
+        const char* kind = NULL;
+        uint32_t stack = 0, scopes = 0, locals = 1;
+        uint32_t index = 0;
+        int slot = -1;
+        if (why == NULL) {
+            if (end - pc >= 2 && pc[0] == OP_getlocal0 && pc[1] == OP_pushscope) {
+                pc += 2;
+                stack = scopes = 1;
+            }
+            const uint8_t* p = pc;
+            uint32_t length = uint32_t(end - pc);
+            if (length >= 4 && pc[0] == OP_getlocal0 && pc[1] == OP_getproperty && argc == 0) {
+                p += 2;
+                index = AvmCore::readU32(p);
+                if (p + 1 == end && *p == OP_returnvalue) {
+                    shape = kGetter;
+                    kind = "slot getter";
+                    stack = 1;
+                }
+            } else if (length >= 5 && pc[0] == OP_getlocal0 && pc[1] == OP_getlocal1 && pc[2] == OP_setproperty && argc == 1) {
+                p += 3;
+                index = AvmCore::readU32(p);
+                if (p + 1 == end && *p == OP_returnvoid && result == VOID_TYPE) {
+                    shape = kSetter;
+                    kind = "slot setter";
+                    stack = 2;
+                    locals = 2;
+                }
+            } else if (length == 2 && pc[0] == OP_getlocal1 && pc[1] == OP_returnvalue && argc == 1 && ms->paramTraits(1) == result) {
+                shape = kIdentity;
+                kind = "identity";
+                stack = 1;
+                locals = 2;
+            } else if (length == 2 && (pc[0] == OP_pushtrue || pc[0] == OP_pushfalse) && pc[1] == OP_returnvalue && result == BOOLEAN_TYPE) {
+                shape = pc[0] == OP_pushtrue ? kTrue : kFalse;
+                kind = "constant";
+                stack = 1;
+            } else if (length == 3 && pc[0] == OP_pushbyte && pc[2] == OP_returnvalue && result == INT_TYPE) {
+                shape = kByte;
+                kind = "constant";
+                stack = 1;
+            } else if (length == 1 && pc[0] == OP_returnvoid && result == VOID_TYPE) {
+                shape = kEmpty;
+                kind = "empty";
+            }
+
+            if (shape == kNone) {
+                why = "no match";
+            } else if (maxStack < stack || localCount < locals || maxScopeDepth < initScopeDepth ||
+                       maxScopeDepth - initScopeDepth < scopes) {
+                why = "bad body";
+            } else if (shape == kGetter || shape == kSetter) {
+                // The slot of 'this', as the callee's verifier would find it.
+                PoolObject* calleePool = mi->pool();
+                Traits* thisType = ms->paramTraits(0);
+                Binding b = BIND_NONE;
+                if (index != 0 && index < calleePool->cpool_mn_offsets.length() && thisType && thisType->isResolved()) {
+                    calleePool->initPrecomputedMultinames();
+                    const Multiname* name = calleePool->precomputedMultiname(index);
+                    if (!name->isRuntime())
+                        b = toplevel->getBinding(thisType, name);
+                }
+                if (AvmCore::isSlotBinding(b) && (shape == kGetter || !AvmCore::isConstBinding(b))) {
+                    Traits* slotType = thisType->getTraitsBindings()->getSlotTraits(AvmCore::bindingToSlotId(b));
+                    if (slotType == (shape == kGetter ? result : ms->paramTraits(1)))
+                        slot = AvmCore::bindingToSlotId(b);
+                }
+                if (slot < 0)
+                    why = "not a slot of the same type";
+            }
+            if (why != NULL)
+                shape = kNone;
+        }
+
+        verbose_only(
+            if (pool->isVerbose(VB_jit, info)) {
+                if (shape != kNone)
+                    core->console << "    inline " << mi << ": " << kind << "\n";
+                else
+                    core->console << "    not inlined " << mi << ": " << why << "\n";
+            })
+        (void)kind;
+
+        switch (shape) {
+        case kGetter:
+            emitGetslot(slot, objDisp, result);
+            break;
+        case kSetter:
+            emitSetslot(OP_setslot, slot, objDisp);
+            localSet(objDisp, InsConstAtom(undefinedAtom), result);
+            break;
+        case kIdentity:
+            localSet(objDisp, localCopy(objDisp + 1), result);
+            break;
+        case kTrue:
+        case kFalse:
+            localSet(objDisp, InsConst(shape == kTrue ? 1 : 0), result);
+            break;
+        case kByte:
+            localSet(objDisp, InsConst(int8_t(pc[1])), result);
+            break;
+        case kEmpty:
+            localSet(objDisp, InsConstAtom(undefinedAtom), result);
+            break;
+        default:
+            return false;
+        }
+        JIT_EVENT(jit_inline_method);
+        return true;
+    }
+
 #ifdef DEBUG
     /**
      * emitTypedCall is used when the Verifier has found an opportunity to early bind,
@@ -5054,6 +5427,9 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         if (inlineBuiltinFunction(opcode, method_id, argc, result, mi))
             return;
 
+        if (inlineSmallMethod(opcode, argc, result, mi))
+            return;
+
         emitCall(opcode, method_id, argc, result, ms);
     }
 #else
@@ -5062,6 +5438,9 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         if (inlineBuiltinFunction(opcode, method_id, argc, result, mi))
             return;
 
+        if (inlineSmallMethod(opcode, argc, result, mi))
+            return;
+
         emitCall(opcode, method_id, argc, result, mi->getMethodSignature());
     }
 #endif
@@ -5541,12 +5920,18 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
 		// For read, the inlined code handles all non-error cases.  If we arrive here, there is definitely a problem.
 		// We call the helper, but only to allow it to handle the error.  The function is not expected to return,
 		// and we do not receive a result.
+        LIns* slowCall;
         if(load_item == LIR_ldf4)
-            callIns(helper, 3, arrayPtr, InsConstPtr(NULL), index);  // we don't really need the returned arg, hence we pass null.
+            slowCall = callIns(helper, 3, arrayPtr, InsConstPtr(NULL), index);  // we don't really need the returned arg, hence we pass null.
         else
-            callIns(helper, 2, arrayPtr, index);
+            slowCall = callIns(helper, 2, arrayPtr, index);
         // The call above is expected to throw.
         lirout->ins0(LIR_unreachable);
+#ifndef VMCFG_VECTOR_SMASH_PROTECTION
+        recordVectorAccess(begin_label, slowCall, NULL);
+#else
+        (void) slowCall;
+#endif
         emitLabel(begin_label);
         resumeCSE();
 #ifndef VMCFG_VECTOR_SMASH_PROTECTION
@@ -5907,8 +6292,13 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         branchToLabel(LIR_jf, cmp, begin_label);
 #endif
 		// The inlined code is just a fastpath.  Handle the general case here. We may need to grow the vector, otherwise, we'll throw an exception.
-        callIns(helper, 3, arrayPtr, index, value);
+        LIns* slowCall = callIns(helper, 3, arrayPtr, index, value);
         branchToLabel(LIR_j, NULL, end_label);
+#ifndef VMCFG_VECTOR_SMASH_PROTECTION
+        recordVectorAccess(begin_label, slowCall, end_label.unpatchedEdges->head.branchIns);
+#else
+        (void) slowCall;
+#endif
         emitLabel(begin_label);
 #ifndef VMCFG_VECTOR_SMASH_PROTECTION
 		// If we are not using vector smash protection, we can load the data pointer a bit later and avoid some register pressure.
@@ -7848,13 +8238,13 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         if (result)
             return result;
         
-        // TODO numeric comparisons can be optimized by inlining the fastpath (int/int, number/number)
-
         AvmAssert(trueAtom == 13);
         AvmAssert(falseAtom == 5);
         AvmAssert(undefinedAtom == 4);
         LIns* lhs = loadAtomRep(lhsi);
         LIns* rhs = loadAtomRep(rhsi);
+        CodegenLabel done("done");
+        LIns* fast = beginCompareFastpath(lhs, rhs, LIR_ltp, LIR_ltd, done);
         LIns* atom = callIns(FUNCTIONID(compare), 2, lhs, rhs);
 
         // caller will use jt for (a<b) and jf for !(a<b)
@@ -7864,7 +8254,8 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         // undefined  0100  1100   n
 
         LIns* c = InsConst(8);
-        return binaryIns(LIR_lti, binaryIns(LIR_xori, p2i(atom), c), c);
+        LIns* cond = binaryIns(LIR_lti, binaryIns(LIR_xori, p2i(atom), c), c);
+        return fast ? endCompareFastpath(fast, cond, done) : cond;
     }
 
     LIns* CodegenLIR::cmpLe(int lhsi, int rhsi)
@@ -7873,9 +8264,10 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         if (result)
             return result;
 
-        // TODO numeric comparisons can be optimized by inlining the fastpath (int/int, number/number)
         LIns* lhs = loadAtomRep(lhsi);
         LIns* rhs = loadAtomRep(rhsi);
+        CodegenLabel done("done");
+        LIns* fast = beginCompareFastpath(lhs, rhs, LIR_lep, LIR_led, done);
         LIns* atom = callIns(FUNCTIONID(compare), 2, rhs, lhs);
 
         // assume caller will use jt for (a<=b) and jf for !(a<=b)
@@ -7886,7 +8278,8 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
 
         LIns* c2 = InsConst(1);
         LIns* c4 = InsConst(4);
-        return binaryIns(LIR_lei, binaryIns(LIR_xori, p2i(atom), c2), c4);
+        LIns* cond = binaryIns(LIR_lei, binaryIns(LIR_xori, p2i(atom), c2), c4);
+        return fast ? endCompareFastpath(fast, cond, done) : cond;
     }
 
     LIns* CodegenLIR::cmpEq(const CallInfo *fid, int lhsi, int rhsi)
@@ -7919,8 +8312,6 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
             return binaryIns(LIR_eqp, lhs, rhs);
         }
         
-        // TODO numeric comparisons can be optimized by inlining the fastpath (int/int, number/number)
-
         if ((lht == rht) && (lht == STRING_TYPE)) {
             LIns* lhs = localGetp(lhsi);
             LIns* rhs = localGetp(rhsi);
@@ -7929,15 +8320,79 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
 
         LIns* lhs = loadAtomRep(lhsi);
         LIns* rhs = loadAtomRep(rhsi);
+        CodegenLabel done("done");
+        LIns* fast = beginCompareFastpath(lhs, rhs, LIR_eqp, LIR_eqd, done);
         LIns* out;
         if (isStrict)
             out = callIns(fid, 2, lhs, rhs);
         else
             out = callIns(fid, 3, coreAddr, lhs, rhs);
         result = binaryIns(LIR_eqp, out, InsConstAtom(trueAtom));
+        return fast ? endCompareFastpath(fast, result, done) : result;
+    }
+
+    // The kinds of the operands of the current instruction seen by the interpreter,
+    // or 0 if it has not run it (MethodInfo::type_feedback).
+    uint32_t CodegenLIR::typeFeedback() const
+    {
+        const uint8_t* feedback = info->type_feedback();
+        return feedback != NULL ? feedback[state->abc_pc - code_pos] : 0;
+    }
+
+    // Inline the compare of two atoms if the interpreter has seen both to be intptr
+    // atoms or both to be double atoms at the current instruction: the intptr atoms
+    // are compared with 'pcmp', since their order is that of their values, and the
+    // doubles with 'dcmp'.  The fastpaths store the result and jump to 'done', and
+    // the code that follows is the fallback for the other operands, which must end
+    // with endCompareFastpath().  Returns the result's stack slot, or NULL if there
+    // is no fastpath.
+    LIns* CodegenLIR::beginCompareFastpath(LIns* lhs, LIns* rhs, LOpcode pcmp, LOpcode dcmp, CodegenLabel& done)
+    {
+        const uint32_t seen = typeFeedback();
+        const uint32_t both = seen & (seen >> 4);
+        if (!inlineFastpath || !(both & (MethodInfo::kFeedbackInt | MethodInfo::kFeedbackDouble)))
+            return NULL;
+
+        suspendCSE();
+        LIns* result = insAlloc(sizeof(int32_t));
+        if (both & MethodInfo::kFeedbackInt) {
+            CodegenLabel not_intptr("not_intptr");
+            LIns* t0 = xorp(lhs, AtomConstants::kIntptrType);
+            LIns* t1 = xorp(rhs, AtomConstants::kIntptrType);
+            LIns* t3 = andp(binaryIns(LIR_orp, t0, t1), AtomConstants::kAtomTypeMask);
+            branchToLabel(LIR_jf, eqp0(t3), not_intptr);
+            sti(binaryIns(pcmp, lhs, rhs), result, 0, ACCSET_OTHER);
+            JIT_EVENT(jit_cmp_fast_intptr);
+            branchToLabel(LIR_j, NULL, done);
+            emitLabel(not_intptr);
+        }
+        if (both & MethodInfo::kFeedbackDouble) {
+            CodegenLabel not_double("not_double");
+            LIns* t0 = xorp(lhs, AtomConstants::kDoubleType);
+            LIns* t1 = xorp(rhs, AtomConstants::kDoubleType);
+            LIns* t3 = andp(binaryIns(LIR_orp, t0, t1), AtomConstants::kAtomTypeMask);
+            branchToLabel(LIR_jf, eqp0(t3), not_double);
+            LIns* lhsd = ldd(subp(lhs, AtomConstants::kDoubleType), 0, ACCSET_OTHER);
+            LIns* rhsd = ldd(subp(rhs, AtomConstants::kDoubleType), 0, ACCSET_OTHER);
+            sti(binaryIns(dcmp, lhsd, rhsd), result, 0, ACCSET_OTHER);
+            JIT_EVENT(jit_cmp_fast_double);
+            branchToLabel(LIR_j, NULL, done);
+            emitLabel(not_double);
+        }
         return result;
     }
 
+    // Store 'cond', the result of the fallback, and join the fastpaths of
+    // beginCompareFastpath().
+    LIns* CodegenLIR::endCompareFastpath(LIns* result, LIns* cond, CodegenLabel& done)
+    {
+        sti(cond, result, 0, ACCSET_OTHER);
+        JIT_EVENT(jit_cmp_slow);
+        emitLabel(done);
+        resumeCSE();
+        return binaryIns(LIR_eqi, ldi(result, 0, ACCSET_OTHER), InsConst(1));
+    }
+
     void CodegenLIR::writeEpilogue(const FrameState *state)
     {
         this->state = state;
@@ -8561,21 +9016,74 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         }
     }
 
-    CodeMgr::CodeMgr(nanojit::Config* config) : codeAlloc(config), bindingCaches(NULL), jit_mgr(NULL)
+    CodeMgr::CodeMgr(nanojit::Config* config)
+        : codeAlloc(config)
+        , bindingCaches(NULL)
+        , megaCalls(NULL)
+        , megaGets(NULL)
+        , megaSets(NULL)
+        , jit_mgr(NULL)
+        , bgCodeAlloc(NULL)
+        , bgAllocator(NULL)
+        , jitQueue(NULL)
+        , jitJobs(0)
     {
         verbose_only( log.lcbits = 0; )
     }
 
+    CodeMgr::~CodeMgr()
+    {
+        if (jitQueue != NULL)
+            jitQueue->cancel(this);
+        AvmAssert(jitJobs == 0);
+        mmfx_delete(bgCodeAlloc);
+        mmfx_delete(bgAllocator);
+    }
+
     void CodeMgr::flushBindingCaches()
     {
         // this clears vtable so all kObjectType receivers are invalidated.
         // of course, this field is also "tag" for primitive receivers,
         // but 0 is never a legal value there (and this is asserted when the tag is set)
         // so this should safely invalidate those as well (though we don't really need to invalidate them)
-        for (BindingCache* b = bindingCaches; b != NULL; b = b->next)
+        for (BindingCache* b = bindingCaches; b != NULL; b = b->next) {
             b->vtable = NULL;
+            // the entries of polymorphic sites, see BindingCache::State
+            for (uint32_t i = 0; b->state == BindingCache::kPolymorphic && i < BindingCache::kPolyEntries; i++) {
+                switch (b->kind) {
+                case BindingCache::kCall: ((CallCache*)b)->entries[i].vtable = NULL; break;
+                case BindingCache::kGet:  ((GetCache*)b)->entries[i].vtable = NULL; break;
+                case BindingCache::kSet:  ((SetCache*)b)->entries[i].vtable = NULL; break;
+                }
+            }
+        }
+        for (uint32_t i = 0; i < BindingCache::kMegaEntries; i++) {
+            if (megaCalls) megaCalls[i].vtable = NULL;
+            if (megaGets)  megaGets[i].vtable = NULL;
+            if (megaSets)  megaSets[i].vtable = NULL;
+        }
     }
 
+#ifdef AVMPLUS_VERBOSE
+    void CodeMgr::dumpBindingCaches(PrintWriter& out)
+    {
+        static const char* const kinds[] = { "call", "get", "set" };
+        static const char* const states[] = { "monomorphic", "polymorphic", "megamorphic" };
+        uint32_t sites[3] = { 0, 0, 0 };
+        for (BindingCache* b = bindingCaches; b != NULL; b = b->next) {
+            sites[b->state]++;
+            if (b->misses == 0)
+                continue;
+            out << "binding cache " << kinds[b->kind] << " " << *b->name << " " << states[b->state]
+                << " hits=" << b->hits << " misses=" << b->misses
+                << " transitions=" << b->transitions << "\n";
+        }
+        out << "binding caches: " << sites[BindingCache::kMonomorphic] << " monomorphic, "
+            << sites[BindingCache::kPolymorphic] << " polymorphic, "
+            << sites[BindingCache::kMegamorphic] << " megamorphic\n";
+    }
+#endif
+
     void analyze_edge(LIns* label, nanojit::BitSet &livein,
                       LabelBitSet& labels, InsList* looplabels)
     {
@@ -9093,18 +9601,674 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
 
     // return pointer to generated code on success, NULL on failure (frame size too large)
     GprMethodProc CodegenLIR::emitMD()
+    {
+        prepareAssembly();
+        PERFM_NTPROF_BEGIN("compile");
+        CodeMgr *mgr = pool->codeMgr;
+        assemble(mgr->codeAlloc, mgr->allocator);
+        PERFM_NTPROF_END("compile");
+        return finishAssembly();
+    }
+
+    // The instructions of a method in program order, from LIR_start at position 0,
+    // and the positions of the branches to each label.
+    class LirIndex
+    {
+    public:
+        LirIndex(Allocator& alloc, LIns* last)
+            : alloc(alloc), count(0)
+        {
+            LirReader counter(last);
+            while (!counter.read()->isop(LIR_start))
+                count++;
+            ins = new (alloc) LIns*[count + 1];
+            positions = new (alloc) HashMap<LIns*, uint32_t>(alloc, count/4 + 1);
+            branches = new (alloc) HashMap<LIns*, Seq<uint32_t>*>(alloc, count/16 + 1);
+            LirReader in(last);
+            for (uint32_t p = count; ; p--) {
+                LIns* i = in.read();
+                ins[p] = i;
+                positions->put(i, p);
+                if (p == 0)
+                    break;
+            }
+            AvmAssert(ins[0]->isop(LIR_start));
+            for (uint32_t p = 1; p <= count; p++) {
+                LIns* i = ins[p];
+                if (i->isop(LIR_jtbl)) {
+                    for (uint32_t j = 0, n = i->getTableSize(); j < n; j++)
+                        addBranch(i->getTarget(j), p);
+                } else if (i->isBranch()) {
+                    addBranch(i->getTarget(), p);
+                }
+            }
+        }
+
+        bool has(LIns* i) const { return positions->containsKey(i); }
+        uint32_t pos(LIns* i) const { AvmAssert(has(i)); return positions->get(i); }
+        Seq<uint32_t>* branchesTo(LIns* label) const { return branches->get(label); }
+
+    private:
+        void addBranch(LIns* label, uint32_t p) {
+            if (label)
+                branches->put(label, new (alloc) Seq<uint32_t>(p, branches->get(label)));
+        }
+
+        Allocator& alloc;
+        HashMap<LIns*, uint32_t>* positions;
+        HashMap<LIns*, Seq<uint32_t>*>* branches;
+
+    public:
+        LIns** ins;
+        uint32_t count;
+    };
+
+    // If c == holds implies a < b, set a and b, and whether the comparison is
+    // unsigned.  A signed one only bounds a from above.
+    static bool matchLessThan(LIns* c, bool holds, LIns*& a, LIns*& b, bool& isUnsigned)
+    {
+        LOpcode op = c->opcode();
+        bool lt, gt;
+        switch (op) {
+            case LIR_lti: case LIR_ltui: CASE64(LIR_ltq:)
+                lt = holds; gt = false; break;
+            case LIR_gei: case LIR_geui: CASE64(LIR_geq:)
+                lt = !holds; gt = false; break;
+            case LIR_gti: case LIR_gtui: CASE64(LIR_gtq:)
+                lt = false; gt = holds; break;
+            case LIR_lei: case LIR_leui: CASE64(LIR_leq:)
+                lt = false; gt = !holds; break;
+            default:
+                return false;
+        }
+        if (!lt && !gt)
+            return false;
+        a = lt ? c->oprnd1() : c->oprnd2();
+        b = lt ? c->oprnd2() : c->oprnd1();
+        isUnsigned = op == LIR_ltui || op == LIR_geui || op == LIR_gtui || op == LIR_leui;
+#ifdef NANOJIT_64BIT
+        if (c->oprnd1()->isQ()) {
+            // An int or uint compared with a uint, widened to 64 bits.
+            if (a->isop(LIR_i2q))
+                isUnsigned = false;
+            else if (a->isop(LIR_ui2uq))
+                isUnsigned = true;
+            else
+                return false;
+            if (!b->isop(LIR_i2q) && !b->isop(LIR_ui2uq))
+                return false;
+            a = a->oprnd1();
+            b = b->oprnd1();
+        }
+#endif
+        return true;
+    }
+
+    static bool isSmallNonNegative(LIns* v)
+    {
+        return v->isImmI() && v->immI() >= 0 && v->immI() <= (1 << 30);
+    }
+
+    static LIns* replacementOf(LIns* ins, HashMap<LIns*, LIns*>& replacements)
+    {
+        while (replacements.containsKey(ins))
+            ins = replacements.get(ins);
+        return ins;
+    }
+
+    // Replace the operands of ins that have a replacement.
+    static void replaceOperands(LIns* ins, HashMap<LIns*, LIns*>& replacements)
+    {
+        if (ins->isCall()) {
+            for (uint32_t i = 0, argc = ins->argc(); i < argc; i++) {
+                LIns* arg = ins->arg(i);
+                LIns* to = replacementOf(arg, replacements);
+                if (to != arg)
+                    ins->replaceOperand(arg, to);
+            }
+            return;
+        }
+        LIns* operands[4];
+        int n = 0;
+        switch (repKinds[ins->opcode()]) {
+            case LRK_Op4:
+                operands[n++] = ins->oprnd4();
+                // fall through
+            case LRK_Op3:
+                operands[n++] = ins->oprnd3();
+                // fall through
+            case LRK_Op2:
+            case LRK_St:
+                operands[n++] = ins->oprnd2();
+                // fall through
+            case LRK_Op1:
+            case LRK_Op1b:
+            case LRK_Ld:
+            case LRK_Jtbl:
+                operands[n++] = ins->oprnd1();
+                break;
+            default:
+                break;
+        }
+        for (int i = 0; i < n; i++) {
+            LIns* to = replacementOf(operands[i], replacements);
+            if (to != operands[i])
+                ins->replaceOperand(operands[i], to);
+        }
+    }
+
+    // The analysis of one loop by optimizeVectorLoop().  The loop spans the
+    // instructions from its header, at position h, to its last back edge at b.
+    class VectorLoop
+    {
+    public:
+        VectorLoop(Allocator& alloc, const LirIndex& lir, LoopPreheader* ph, LIns* vars,
+                   LIns* osrJump, const HashMap<LIns*, VectorAccess*>& accessByCall,
+                   const CallInfo* makeatom)
+            : alloc(alloc), lir(lir), ph(ph), vars(vars), osrJump(osrJump)
+            , accessByCall(accessByCall), makeatom(makeatom)
+            , h(0), b(0), cond(0), nfacts(0), stores(alloc), nonNegative(alloc)
+            , accesses(alloc), removed(alloc), naccesses(0), nremoved(0), mayResize(true)
+        {}
+
+        // Returns NULL if the loop can be optimized, or why not.
+        const char* analyze(LIns* header);
+
+        // Map the loads of the invariant vectors in the loop to the preheader's.
+        void replaceLoads(HashMap<LIns*, LIns*>& replacements, bool used[kMaxHoistedVectors][3]);
+
+    private:
+        struct Fact {
+            int32_t disp;       // vars[disp] < length of vectors[k] at position 'at'
+            int k;
+            bool isUnsigned;
+            uint32_t at;
+        };
+
+        bool isVarsAddress(LIns* i) const {
+            return i == vars || (i->isop(LIR_addp) && (i->oprnd1() == vars || i->oprnd2() == vars));
+        }
+
+        bool isLocalLoad(LIns* i, LOpcode op) const {
+            return i->isop(op) && i->oprnd1() == vars;
+        }
+
+        bool inLoop(LIns* i) const {
+            if (!lir.has(i))
+                return false;
+            uint32_t p = lir.pos(i);
+            return p >= h && p <= b;
+        }
+
+        bool mayWriteLocals(LIns* call) const {
+            if (call->callInfo()->_isPure || call->callInfo() == makeatom)
+                return false;
+            for (uint32_t i = 0, n = call->argc(); i < n; i++)
+                if (isVarsAddress(call->arg(i)))
+                    return true;
+            return false;
+        }
+
+        // true if the local at disp is stored strictly between positions from and to.
+        bool storedBetween(int32_t disp, uint32_t from, uint32_t to) const {
+            for (Seq<uint32_t>* p = stores.get(disp); p != NULL; p = p->tail)
+                if (p->head > from && p->head < to)
+                    return true;
+            return false;
+        }
+
+        int vectorOf(LIns* ptr) const;
+        int vectorOfLength(LIns* len) const;
+        bool localAt(LIns* v, uint32_t at, int32_t& disp, uint32_t& def) const;
+        bool matchFact(LIns* cond, bool holds, uint32_t at, Fact& f) const;
+        bool dominates(uint32_t from, uint32_t to) const;
+        bool isNonNegative(int32_t disp);
+        bool isIncremented(int32_t disp) const;
+        bool isNonNegativeOnEntry(int32_t disp) const;
+        bool canRemove(VectorAccess* access);
+
+        Allocator& alloc;
+        const LirIndex& lir;
+        LoopPreheader* ph;
+        LIns* vars;
+        LIns* osrJump;
+        const HashMap<LIns*, VectorAccess*>& accessByCall;
+        const CallInfo* makeatom;
+
+    public:
+        uint32_t h, b;
+        uint32_t cond;                  // the condition the preheader jumps to, or 0
+        bool active[kMaxHoistedVectors];
+        Fact facts[4];
+        int nfacts;
+        HashMap<int32_t, Seq<uint32_t>*> stores;   // positions of the stores to each local
+        HashMap<int32_t, bool> nonNegative;
+        SeqBuilder<VectorAccess*> accesses;
+        SeqBuilder<VectorAccess*> removed;
+        int naccesses;
+        int nremoved;
+        bool mayResize;
+    };
+
+    // The hoisted vector that ptr is loaded from, or -1.
+    int VectorLoop::vectorOf(LIns* ptr) const
+    {
+        for (int k = 0; k < ph->count; k++) {
+            if (!active[k])
+                continue;
+            if (ptr == ph->vectors[k].ptr)
+                return k;
+            if (isLocalLoad(ptr, LIR_ldp) && ptr->disp() == ph->vectors[k].disp && inLoop(ptr))
+                return k;
+        }
+        return -1;
+    }
+
+    // The hoisted vector that len is the length of, or -1.
+    int VectorLoop::vectorOfLength(LIns* len) const
+    {
+        for (int k = 0; k < ph->count; k++)
+            if (active[k] && len == ph->vectors[k].len)
+                return k;
+        if (!len->isop(LIR_ldi) || !inLoop(len))
+            return -1;
+        int k = vectorOf(len->oprnd1());
+        return k >= 0 && len->disp() == ph->vectors[k].lenOffset ? k : -1;
+    }
+
+    // If v is the value of a local at position 'at', loaded or stored in the loop
+    // with no store to the local in between, set disp to the local and def to the
+    // position of the load or store.
+    bool VectorLoop::localAt(LIns* v, uint32_t at, int32_t& disp, uint32_t& def) const
+    {
+        if (isLocalLoad(v, LIR_ldi) && inLoop(v) && lir.pos(v) < at) {
+            disp = v->disp();
+            def = lir.pos(v);
+            return !storedBetween(disp, def, at);
+        }
+        for (uint32_t p = at - 1; p > h && !lir.ins[p]->isop(LIR_label); p--) {
+            LIns* i = lir.ins[p];
+            if (i->isop(LIR_sti) && i->oprnd2() == vars && i->oprnd1() == v) {
+                disp = i->disp();
+                def = p;
+                return !storedBetween(disp, def, at);
+            }
+        }
+        return false;
+    }
+
+    // If cond == holds at position 'at' implies that a local is less than the length
+    // of a hoisted vector, describe it in f.
+    bool VectorLoop::matchFact(LIns* cond, bool holds, uint32_t at, Fact& f) const
+    {
+        LIns *a, *len;
+        uint32_t def;
+        if (!matchLessThan(cond, holds, a, len, f.isUnsigned) || !localAt(a, at, f.disp, def))
+            return false;
+        f.k = vectorOfLength(len);
+        f.at = at;
+        return f.k >= 0;
+    }
+
+    // true if every path from the loop header to position 'to' goes through 'from'.
+    bool VectorLoop::dominates(uint32_t from, uint32_t to) const
+    {
+        for (uint32_t p = from + 1; p <= to; p++) {
+            if (!lir.ins[p]->isop(LIR_label))
+                continue;
+            for (Seq<uint32_t>* q = lir.branchesTo(lir.ins[p]); q != NULL; q = q->tail)
+                if (q->head < from || q->head >= to)
+                    return false;
+        }
+        return true;
+    }
+
+    // true if the local at disp stays in [0, 2^30 + 2^12] in the loop while it is
+    // compared with a vector length, which is less than 2^30: it is set to a small
+    // constant before the loop, and in the loop it is set to small constants or
+    // incremented by at most 256, at most 16 times.
+    bool VectorLoop::isNonNegative(int32_t disp)
+    {
+        if (!nonNegative.containsKey(disp))
+            nonNegative.put(disp, isIncremented(disp) && isNonNegativeOnEntry(disp));
+        return nonNegative.get(disp);
+    }
+
+    bool VectorLoop::isIncremented(int32_t disp) const
+    {
+        int n = 0;
+        for (Seq<uint32_t>* s = stores.get(disp); s != NULL; s = s->tail) {
+            LIns* st = lir.ins[s->head];
+            if (++n > 16 || !st->isop(LIR_sti))
+                return false;
+            LIns* v = st->oprnd1();
+            if (isSmallNonNegative(v))
+                continue;
+            if (!v->isop(LIR_addi))
+                return false;
+            LIns* x = v->oprnd1();
+            LIns* c = v->oprnd2();
+            if (x->isImmI()) {
+                LIns* t = x; x = c; c = t;
+            }
+            if (!c->isImmI() || c->immI() < 0 || c->immI() > 256 ||
+                !isLocalLoad(x, LIR_ldi) || x->disp() != disp || !inLoop(x) || lir.pos(x) >= s->head)
+                return false;
+        }
+        return true;
+    }
+
+    // true if the value stored last on the way to the preheader is a small constant.
+    // An OSR entry comes from the same code, run by the interpreter.
+    bool VectorLoop::isNonNegativeOnEntry(int32_t disp) const
+    {
+        for (uint32_t p = (ph->entry ? lir.pos(ph->entry) : h) - 1; p > 0; p--) {
+            LIns* i = lir.ins[p];
+            if (i->isop(LIR_label)) {
+                if (ph->label && i == ph->label->labelIns)
+                    continue;
+                return false;
+            }
+            if (i->isStore() && i->oprnd2() == vars && i->disp() == disp)
+                return i->isop(LIR_sti) && isSmallNonNegative(i->oprnd1());
+            if ((i->isStore() && i->oprnd2() != vars && isVarsAddress(i->oprnd2())) ||
+                (i->isCall() && mayWriteLocals(i)))
+                return false;
+        }
+        return false;
+    }
+
+    // true if the range check of the access is implied by a loop condition.
+    bool VectorLoop::canRemove(VectorAccess* access)
+    {
+        LIns* check = access->check;
+        LIns* cmp = check->oprnd1();
+        if (!check->isop(LIR_jf) || !cmp->isop(LIR_geui))
+            return false;
+        uint32_t at = lir.pos(check);
+        int k = vectorOfLength(cmp->oprnd2());
+        int32_t disp;
+        uint32_t def;
+        if (k < 0 || !localAt(cmp->oprnd1(), at, disp, def))
+            return false;
+        for (int j = 0; j < nfacts; j++) {
+            Fact& f = facts[j];
+            if (f.disp != disp || f.k != k || f.at > at)
+                continue;
+            if (!f.isUnsigned && !isNonNegative(disp))
+                continue;
+            if (storedBetween(disp, def < f.at ? def : f.at, at) || !dominates(f.at, at))
+                continue;
+            return true;
+        }
+        return false;
+    }
+
+    const char* VectorLoop::analyze(LIns* header)
+    {
+        if (!header || !lir.has(header))
+            return "no loop header";
+        h = lir.pos(header);
+        for (Seq<uint32_t>* q = lir.branchesTo(header); q != NULL; q = q->tail) {
+            if (q->head > h) {
+                if (q->head > b)
+                    b = q->head;
+            } else if (!ph->label || lir.ins[q->head] != osrJump) {
+                return "header reached by a forward branch";
+            }
+        }
+        if (b == 0)
+            return "no back edge";
+        if (ph->entry) {
+            LIns* target = ph->entry->getTarget();
+            if (!lir.has(ph->entry) || lir.pos(ph->entry) != h - 1 || !inLoop(target))
+                return "no jump to the condition";
+            cond = lir.pos(target);
+        } else {
+            LIns* prev = lir.ins[h - 1];
+            if (prev->isUnConditionalBranch() || prev->isRet() || prev->isop(LIR_unreachable))
+                return "header not reached from the preheader";
+        }
+
+        // Control flow and side effects in the loop.
+        int calls = 0;
+        int writes = 0;
+        for (uint32_t p = h + 1; p <= b; p++) {
+            LIns* i = lir.ins[p];
+            if (i->isop(LIR_label)) {
+                for (Seq<uint32_t>* q = lir.branchesTo(i); q != NULL; q = q->tail) {
+                    if (q->head >= p && q->head <= b)
+                        return "nested loop";
+                    if ((q->head < h || q->head > b) && !(p == cond && lir.ins[q->head] == ph->entry))
+                        return "loop entered by a branch";
+                }
+            } else if (i->isop(LIR_jtbl)) {
+                return "switch in loop";
+            } else if (i->isStore()) {
+                if (i->oprnd2() == vars)
+                    stores.put(i->disp(), new (alloc) Seq<uint32_t>(p, stores.get(i->disp())));
+                else if (isVarsAddress(i->oprnd2()))
+                    return "local stored by address";
+            } else if (i->isCall() && !i->callInfo()->_isPure) {
+                VectorAccess* access = accessByCall.get(i);
+                if (access) {
+                    accesses.add(access);
+                    naccesses++;
+                    if (access->slowExit)
+                        writes++;
+                } else if (i->callInfo() != makeatom) {
+                    if (mayWriteLocals(i))
+                        return "local passed by address";
+                    calls++;
+                }
+            }
+        }
+        if (ph->label && ph->entry) {
+            // The OSR entry evaluates the condition once more before the header.
+            for (uint32_t p = cond; p <= b; p++) {
+                LIns* i = lir.ins[p];
+                if (i->isStore() || (i->isCall() && !i->callInfo()->_isPure))
+                    return "side effects in the condition";
+            }
+        }
+
+        int count = 0;
+        for (int k = 0; k < ph->count; k++) {
+            active[k] = !stores.containsKey(ph->vectors[k].disp);
+            if (active[k])
+                count++;
+        }
+        if (count == 0)
+            return "vectors stored in the loop";
+
+        // Without calls, only the range checks of the writes can resize the vectors.
+        // If they are all removed, none does.
+        if (calls > 0)
+            return NULL;
+        if (ph->entry) {
+            // The back edges of the condition at the bottom.
+            Fact f;
+            int n = 0;
+            for (Seq<uint32_t>* q = lir.branchesTo(header); q != NULL; q = q->tail) {
+                LIns* br = lir.ins[q->head];
+                Fact g;
+                if (q->head < h)
+                    continue;
+                if (!(br->isop(LIR_jt) || br->isop(LIR_jf)) || !matchFact(br->oprnd1(), br->isop(LIR_jt), q->head, g) ||
+                    (n > 0 && (g.disp != f.disp || g.k != f.k || g.isUnsigned != f.isUnsigned))) {
+                    n = 0;
+                    break;
+                }
+                f = g;
+                n++;
+            }
+            if (n > 0) {
+                f.at = h;
+                facts[nfacts++] = f;
+            }
+        }
+        // The exits of the header block, for a condition at the top.
+        for (uint32_t p = h + 1; p <= b && !lir.ins[p]->isop(LIR_label) && nfacts < 4; p++) {
+            LIns* i = lir.ins[p];
+            Fact g;
+            if ((i->isop(LIR_jt) || i->isop(LIR_jf)) && !inLoop(i->getTarget()) &&
+                matchFact(i->oprnd1(), i->isop(LIR_jf), p, g) && !storedBetween(g.disp, h, p)) {
+                facts[nfacts++] = g;
+            }
+        }
+        for (Seq<VectorAccess*>* p = accesses.get(); p != NULL; p = p->tail) {
+            if (canRemove(p->head)) {
+                removed.add(p->head);
+                nremoved++;
+                if (p->head->slowExit)
+                    writes--;
+            }
+        }
+        if (writes > 0) {
+            removed.clear();
+            nremoved = 0;
+        } else {
+            mayResize = false;
+        }
+        return NULL;
+    }
+
+    void VectorLoop::replaceLoads(HashMap<LIns*, LIns*>& replacements, bool used[kMaxHoistedVectors][3])
+    {
+        for (uint32_t p = h; p <= b; p++) {
+            LIns* i = lir.ins[p];
+            if (!i->isLoad() || i->loadQual() == LOAD_VOLATILE)
+                continue;
+            for (int k = 0; k < ph->count; k++) {
+                HoistedVector& hv = ph->vectors[k];
+                if (!active[k])
+                    continue;
+                if (isLocalLoad(i, LIR_ldp) && i->disp() == hv.disp) {
+                    replacements.put(i, hv.ptr);
+                    used[k][0] = true;
+                } else if (!mayResize && vectorOf(i->oprnd1()) == k) {
+                    if (i->isop(LIR_ldi) && i->disp() == hv.lenOffset) {
+                        replacements.put(i, hv.len);
+                        used[k][1] = true;
+                    } else if (i->isop(LIR_ldp) && i->disp() == hv.dataOffset) {
+                        replacements.put(i, hv.data);
+                        used[k][2] = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // Replace the loads of the vectors held in locals, their length and data, by
+    // the loads of the preheaders emitted by emitLoopPreheader(), in the loops that
+    // do not store these locals; without calls that may resize the vectors, also
+    // remove the range checks that the loop conditions imply.  Runs after deadvars().
+    void CodegenLIR::optimizeVectorLoops()
+    {
+        if (!loopPreheaders)
+            return;
+        Allocator alloc;
+        LirIndex lir(alloc, frag->lastIns);
+        HashMap<LIns*, VectorAccess*> accessByCall(alloc);
+        for (Seq<VectorAccess*>* p = vectorAccesses; p != NULL; p = p->tail)
+            accessByCall.put(p->head->slowCall, p->head);
+        HashMap<LIns*, LIns*> replacements(alloc);
+        SeqBuilder<LIns*> live(alloc);
+        bool changed = false;
+        for (Seq<LoopPreheader*>* p = loopPreheaders; p != NULL; p = p->tail)
+            changed |= optimizeVectorLoop(lir, p->head, accessByCall, replacements, live, alloc);
+        if (!changed)
+            return;
+        for (uint32_t p = 1; p <= lir.count; p++)
+            replaceOperands(lir.ins[p], replacements);
+        // The hoisted values are live across the back edges.
+        for (Seq<LIns*>* p = live.get(); p != NULL; p = p->tail) {
+            LIns* v = replacementOf(p->head, replacements);
+            if (v->isI())
+                lirout->ins1(LIR_livei, v);
+            else
+                livep(v);
+        }
+    }
+
+    bool CodegenLIR::optimizeVectorLoop(const LirIndex& lir, LoopPreheader* ph,
+                                        const HashMap<LIns*, VectorAccess*>& accessByCall,
+                                        HashMap<LIns*, LIns*>& replacements, SeqBuilder<LIns*>& live,
+                                        Allocator& alloc)
+    {
+        VectorLoop loop(alloc, lir, ph, vars, osrJump, accessByCall, FUNCTIONID(makeatom));
+        CodegenLabel* header = blockLabels->get(ph->header);
+        const char* why = loop.analyze(header ? header->labelIns : NULL);
+        if (why) {
+            verbose_only( if (pool->isVerbose(VB_jit, info))
+                core->console << "    loop B" << int(ph->header - code_pos) << " not optimized: " << why << "\n"; )
+            return false;
+        }
+
+        bool used[kMaxHoistedVectors][3];
+        VMPI_memset(used, 0, sizeof(used));
+        loop.replaceLoads(replacements, used);
+        int hoisted = 0;
+        for (int k = 0; k < ph->count; k++) {
+            HoistedVector& hv = ph->vectors[k];
+            if (used[k][0])
+                live.add(hv.ptr);
+            if (used[k][1])
+                live.add(hv.len);
+            if (used[k][2])
+                live.add(hv.data);
+            if (used[k][0] || used[k][1] || used[k][2])
+                hoisted++;
+        }
+
+        // The removed checks always branch to the fast path.
+        for (Seq<VectorAccess*>* p = loop.removed.get(); p != NULL; p = p->tail) {
+            VectorAccess* access = p->head;
+            access->check->replaceOperand(access->check->oprnd1(), ph->zero);
+            eraseIns(access->slowCall, lir.ins[lir.pos(access->slowCall) - 1]);
+            if (access->slowExit)
+                eraseIns(access->slowExit, lir.ins[lir.pos(access->slowExit) - 1]);
+        }
+
+        if (ph->label)
+            osrJump->setTarget(ph->label->labelIns);
+
+        verbose_only( if (pool->isVerbose(VB_jit, info))
+            core->console << "    loop B" << int(ph->header - code_pos) << ": hoisted " << hoisted
+                          << " of " << ph->count << " vectors, removed " << loop.nremoved << " of "
+                          << loop.naccesses << " range checks\n"; )
+        return true;
+    }
+
+    void CodegenLIR::prepareAssembly()
     {
         deadvars();  // deadvars_kill() will add livep(vars) or livep(tags) if necessary
+        optimizeVectorLoops();
 
         // do this very last so it's after livep(vars)
         frag->lastIns = livep(undefConst);
 
-        PERFM_NTPROF_BEGIN("compile");
+        #if NJ_RELOCATION_SUPPORTED
+        // The code of OSR entries and of methods seen by a debugger or a profiler
+        // is specific to this run.
+        JitCodeCache* codeCache = ((BaseExecMgr*)core->exec)->jitCodeCache;
+        if (codeCache && !osr && !jit_observer && !haveDebugger && !haveVTune && codeCache->isUsable()) {
+            relocs = new (*lir_alloc) RelocBuilder(*lir_alloc);
+            for (Seq<CallCache*>* p = call_cache_builder.allocated(); p != NULL; p = p->tail)
+                relocs->caches.add(p->head);
+            for (Seq<GetCache*>* p = get_cache_builder.allocated(); p != NULL; p = p->tail)
+                relocs->caches.add(p->head);
+            for (Seq<SetCache*>* p = set_cache_builder.allocated(); p != NULL; p = p->tail)
+                relocs->caches.add(p->head);
+            relocs->scan(frag, core);
+        }
+        #endif
+
         mmfx_delete( alloc1 );
         alloc1 = NULL;
 
-        CodeMgr *mgr = pool->codeMgr;
         #ifdef NJ_VERBOSE
+        CodeMgr *mgr = pool->codeMgr;
         if (pool->isVerbose(LC_ReadLIR, info)) {
             StringBuffer sb(core);
             sb << info;
@@ -9150,25 +10314,49 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
             lircfg(f, frag, &ignore, alloc, mode);
             fclose(f);
         }
+        verboseJit = pool->isVerbose(VB_jit, info);
+        verboseRaw = pool->isVerbose(VB_raw, info);
         #endif
 
+        #if NJ_STACKMAPS_SUPPORTED
+        if (core->GetGC()->ExactStackFrames())
+            stackMaps = new (*lir_alloc) StackMapBuilder(*lir_alloc, methodFrame);
+        #endif
+    }
+
+    // Reads only the LIR and the nanojit configuration, and allocates only from this
+    // CodegenLIR's allocators and the ones passed in, so that it can run on the
+    // compiler thread (JitCompileQueue).  Methods with verbose jit output are never
+    // assembled there, since the log is not thread safe.
+    void CodegenLIR::assemble(CodeAlloc& codeAlloc, Allocator& dataAlloc)
+    {
         // Use the 'active' log if we are in verbose output mode otherwise sink the output
-        LogControl* log = &(mgr->log);
+        LogControl* log = &pool->codeMgr->log;
         verbose_only(
             SinkLogControl sink;
-            log = pool->isVerbose(VB_jit,info) ? log : &sink;
+            log = verboseJit ? log : &sink;
         )
 
-        Assembler *assm = new (*lir_alloc) Assembler(mgr->codeAlloc, mgr->allocator, *lir_alloc, log, core->config.njconfig);
+        assm = new (*lir_alloc) Assembler(codeAlloc, dataAlloc, *lir_alloc, log, core->config.njconfig);
         #ifdef VMCFG_VTUNE
         assm->vtuneHandle = vtuneInit(info->getMethodName());
         #endif /* VMCFG_VTUNE */
 
         assm->setNoiseGenerator(noise);
 
+        #if NJ_STACKMAPS_SUPPORTED
+        if (stackMaps)
+            assm->setStackMapWriter(stackMaps);
+        #endif
+
+        #if NJ_RELOCATION_SUPPORTED
+        if (relocs)
+            assm->setRelocWriter(relocs);
+        #endif
+
         verbose_only(
             StringList asmOutput(*lir_alloc);
-            if (!pool->isVerbose(VB_raw, info))
+            if (!verboseRaw)
                 assm->_outputCache = &asmOutput;
         );
 
@@ -9176,7 +10364,6 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         LirReader reader(frag->lastIns);
         assm->assemble(frag, &reader);
         assm->endAssembly(frag);
-        PERFM_NTPROF_END("compile");
 
         verbose_only(
             assm->_outputCache = 0;
@@ -9184,7 +10371,10 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
                 assm->outputf("%s", p->head);
             }
         );
+    }
 
+    GprMethodProc CodegenLIR::finishAssembly()
+    {
         PERFM_NVPROF("IR-bytes", frag->lirbuf->byteCount());
         PERFM_NVPROF("IR", frag->lirbuf->insCount());
 
@@ -9194,6 +10384,22 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
             // save pointer to generated code
             code = (GprMethodProc) frag->code();
             PERFM_NVPROF("JIT method bytes", CodeAlloc::size(assm->codeList));
+            #if NJ_STACKMAPS_SUPPORTED
+            if (stackMaps)
+                info->set_jit_stack_map(stackMaps->finish(pool->codeMgr->allocator));
+            #endif
+            #if NJ_RELOCATION_SUPPORTED
+            if (relocs && relocs->valid) {
+                // Only code in a single block can be saved.
+                CodeRange r(assm->codeList);
+                const uint8_t* start = (const uint8_t*) code;
+                const uint8_t* end = (const uint8_t*) r.frontEnd();
+                bool single = start >= r.frontStart() && start < end;
+                r.popFront();
+                if (single && r.empty())
+                    ((BaseExecMgr*)core->exec)->jitCodeCache->save(info, start, end - start, relocs, info->jit_stack_map());
+            }
+            #endif
             if (jit_observer)
                 jit_observer->notifyMethodJITed(info, assm->codeList, jit_debug_info);
         } else {
@@ -9213,20 +10419,202 @@ FLOAT_ONLY(           !(v.sst_mask == (1 << SST_float)  && v.traits == FLOAT_TYP
         return code;
     }
 
-    BindingCache::BindingCache(const Multiname* name, BindingCache* next)
-        : name(name), next(next)
+    StackMapBuilder::StackMapBuilder(Allocator& alloc, LIns* methodFrame)
+        : alloc(alloc)
+        , methodFrame(methodFrame)
+        , safepoints(alloc)
+        , count(0)
+        , methodFrameDisp(0)
+        , frameSize(0)
+        , argSize(0)
+        , valid(true)
+        , done(false)
+    {}
+
+    void StackMapBuilder::safepoint(Assembler*, NIns* returnAddress, const uint32_t* bitmap, uint32_t nwords)
+    {
+        // The MethodFrame is how the GC finds the frame, so it must be in the
+        // same place at every call.
+        if (!methodFrame->isInAr()) {
+            valid = false;
+            return;
+        }
+        int32_t disp = arDisp(methodFrame);
+        if (count > 0 && disp != methodFrameDisp)
+            valid = false;
+        methodFrameDisp = disp;
+
+        // The calls are assembled last to first, so the previous one is the next
+        // call in the code.
+        Safepoint sp;
+        sp.returnAddress = returnAddress;
+        sp.nwords = nwords;
+        size_t nbytes = ((nwords + 31) / 32) * sizeof(uint32_t);
+        Seq<Safepoint>* prev = safepoints.get();
+        if (prev != NULL && prev->head.nwords == nwords && VMPI_memcmp(prev->head.bitmap, bitmap, nbytes) == 0) {
+            sp.bitmap = prev->head.bitmap;
+        } else {
+            uint32_t* copy = (uint32_t*) alloc.alloc(nbytes);
+            VMPI_memcpy(copy, bitmap, nbytes);
+            sp.bitmap = copy;
+        }
+        safepoints.insert(sp);
+        count++;
+    }
+
+    void StackMapBuilder::endAssembly(Assembler*, uint32_t frameSize, uint32_t argSize)
+    {
+        AvmAssert(frameSize % sizeof(void*) == 0 && argSize <= frameSize);
+        this->frameSize = frameSize;
+        this->argSize = argSize;
+        done = true;
+    }
+
+    JitStackMap* StackMapBuilder::finish(Allocator& codeAlloc)
+    {
+        if (!valid || !done || count == 0)
+            return NULL;
+
+        const uint32_t nwords = frameSize / sizeof(void*);
+        const uint32_t argWords = (argSize + sizeof(void*) - 1) / sizeof(void*);
+        const size_t nbytes = ((nwords + 31) / 32) * sizeof(uint32_t);
+
+        JitStackMap* map = new (codeAlloc) JitStackMap();
+        map->methodFrameDisp = methodFrameDisp;
+        map->frameSize = frameSize;
+        map->count = count;
+        map->returnAddresses = (const NIns**) codeAlloc.alloc(count * sizeof(NIns*));
+        map->bitmaps = (const uint32_t**) codeAlloc.alloc(count * sizeof(uint32_t*));
+
+        // Turn each distinct bitmap around, so that it starts at the stack
+        // pointer, and add the outgoing arguments.
+        const uint32_t* lastIn = NULL;
+        const uint32_t* lastOut = NULL;
+        uint32_t n = 0;
+        for (Seq<Safepoint>* p = safepoints.get(); p != NULL; p = p->tail, n++) {
+            const Safepoint& sp = p->head;
+            if (sp.bitmap != lastIn) {
+                AvmAssert(sp.nwords <= nwords);
+                uint32_t* out = (uint32_t*) codeAlloc.alloc(nbytes);
+                VMPI_memset(out, 0, nbytes);
+                for (uint32_t i = 0; i < sp.nwords; i++) {
+                    if (sp.bitmap[i >> 5] & (1U << (i & 31))) {
+                        uint32_t j = nwords - 1 - i;
+                        out[j >> 5] |= 1U << (j & 31);
+                    }
+                }
+                for (uint32_t j = 0; j < argWords; j++)
+                    out[j >> 5] |= 1U << (j & 31);
+                lastIn = sp.bitmap;
+                lastOut = out;
+            }
+            // Insertion sort by return address; the calls are already in code
+            // order within each chunk of code.
+            uint32_t k = n;
+            while (k > 0 && map->returnAddresses[k-1] > sp.returnAddress) {
+                map->returnAddresses[k] = map->returnAddresses[k-1];
+                map->bitmaps[k] = map->bitmaps[k-1];
+                k--;
+            }
+            map->returnAddresses[k] = sp.returnAddress;
+            map->bitmaps[k] = lastOut;
+        }
+        return map;
+    }
+
+    RelocBuilder::RelocBuilder(Allocator& alloc)
+        : relocs(alloc)
+        , caches(alloc)
+        , valid(true)
+    {}
+
+    void RelocBuilder::imm64(Assembler*, NIns* loc, uint64_t value, bool call)
+    {
+        Reloc r;
+        r.loc = loc;
+        r.value = value;
+        r.call = call;
+        r.branch = false;
+        relocs.add(r);
+    }
+
+    void RelocBuilder::branch64(Assembler*, NIns* loc)
+    {
+        Reloc r;
+        r.loc = loc;
+        r.value = 0;
+        r.call = false;
+        r.branch = true;
+        relocs.add(r);
+    }
+
+    void RelocBuilder::absolute(Assembler*)
+    {
+        valid = false;
+    }
+
+    void RelocBuilder::scan(Fragment* frag, AvmCore* core)
+    {
+        // Constants of 64 bits are always assembled as imm64s.  The Assembler may
+        // fold one of 32 bits into an instruction, so it must not be an address
+        // that changes from one run to the next: not in the GC heap or the AvmCore.
+        MMgc::GCHeap* heap = MMgc::GCHeap::GetGCHeap();
+        LirReader in(frag->lastIns);
+        for (LIns* ins = in.read(); !ins->isop(LIR_start); ins = in.read()) {
+            if (!ins->isImmQ())
+                continue;
+            uint64_t v = ins->immQ();
+            if (v < 0x10000 || v > 0xffffffffULL)
+                continue;
+            uintptr_t p = uintptr_t(v) & ~uintptr_t(7);
+            bool changes = p >= uintptr_t(core) && p < uintptr_t(core) + sizeof(AvmCore);
+            for (int i = 0; i < MMgc::kNumHeapPartitions && !changes; i++)
+                changes = heap->GetPartition(i)->IsAddressInHeap((void*)p);
+            if (changes) {
+                valid = false;
+                return;
+            }
+        }
+    }
+
+    void JitStackMap::addFrame(const MethodFrame* methodFrame, MMgc::GCStackFrames& frames) const
+    {
+        const char* fp = (const char*)methodFrame - methodFrameDisp;
+        const void* const* sp = (const void* const*)(fp - frameSize);
+
+        // The return address of the call in progress is the word below the
+        // stack pointer.  Check that it is on the stack before reading it.
+        if (!frames.InRange(sp - 1, frameSize + sizeof(void*)))
+            return;
+        const NIns* returnAddress = (const NIns*)sp[-1];
+        uint32_t lo = 0;
+        uint32_t hi = count;
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (returnAddresses[mid] < returnAddress)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        if (lo < count && returnAddresses[lo] == returnAddress)
+            frames.AddFrame(sp, frameSize / sizeof(void*), bitmaps[lo]);
+    }
+
+    BindingCache::BindingCache(const Multiname* name, BindingCache* next, Kind kind)
+        : vtable(NULL), slot_offset(0), name(name), next(next), kind(uint8_t(kind))
+        , state(kMonomorphic), hits(0), misses(0), transitions(0)
     {}
 
     CallCache::CallCache(const Multiname* name, BindingCache* next)
-        : BindingCache(name, next), call_handler(callprop_miss)
+        : BindingCache(name, next, kCall), call_handler(callprop_miss), entries(NULL)
     {}
 
     GetCache::GetCache(const Multiname* name, BindingCache* next)
-        : BindingCache(name, next), get_handler(getprop_miss)
+        : BindingCache(name, next, kGet), get_handler(getprop_miss), entries(NULL)
     {}
 
     SetCache::SetCache(const Multiname* name, BindingCache* next)
-        : BindingCache(name, next), set_handler(setprop_miss)
+        : BindingCache(name, next, kSet), set_handler(setprop_miss), entries(NULL)
     {}
 
     template class CacheBuilder<CallCache>;
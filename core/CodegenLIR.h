@@ -78,6 +78,34 @@ namespace avmplus
     //    name              Multiname* for this dynamic access.  Used on a cache miss,
     //                      and also for handlers that access dynamic properties.
     //
+    // The handlers of a cache check that the receiver matches its vtable or tag, so
+    // a site is monomorphic: a miss on another type rebinds the cache.  A site that
+    // sees more than one type would thrash, so the miss handler moves it through
+    // three states (see cache_miss() in jit-calls.h):
+    //
+    //    monomorphic       the cache holds one binding and its handler is the
+    //                      specialized handler.  Misses on the bound type, or while
+    //                      the cache is unbound, rebind it; a miss on a second type
+    //                      makes the site polymorphic.
+    //
+    //    polymorphic       the binding moves to the first of kPolyEntries entries
+    //                      allocated for the site, and the cache's handler becomes
+    //                      *_poly(), which scans the entries for the receiver's vtable
+    //                      or tag and calls the entry's specialized handler.  Misses
+    //                      bind a free entry; a miss with every entry taken makes the
+    //                      site megamorphic.
+    //
+    //    megamorphic       the handler becomes *_mega(), which looks up the receiver and
+    //                      name in a direct-mapped table of kMegaEntries caches shared
+    //                      by all the sites of the CodeMgr, and binds the table entry
+    //                      on a miss.
+    //
+    // Sites never go back to a previous state.  Monomorphic sites, by far the most
+    // common, run the same code as before; the PIC only costs them the extra words of
+    // the cache.  Every cache counts its misses and transitions, and its hits in
+    // AVMPLUS_VERBOSE builds; -Dverbose=jit prints them when the program ends
+    // (AvmCore::dumpBindingCaches).
+    //
     // If jit'd code for a method needs cache entries, they are allocated and
     // saved on MethodInfo::_abc.call_cache. The table is only allocated when jit
     // compilation was successful, so jit'd code must load this pointer at runtime
@@ -99,6 +127,9 @@ namespace avmplus
     //     handler that's slightly slower than not using a cache at all.
     //     see callprop_miss() in jit-calls.h for detail on handled cases.
     //
+    // Entries and megamorphic tables hold vtables too, and flushBindingCaches() clears
+    // them along with the caches.
+    //
     // Alternatives that led to current design:
     //
     //   * specializing slot accessors on slot type, and storing slot_offset,
@@ -159,7 +190,17 @@ namespace avmplus
     // binding cache common code
     class BindingCache {
     public:
-        BindingCache(const Multiname*, BindingCache* next);
+        enum Kind { kCall, kGet, kSet };
+        enum State { kMonomorphic, kPolymorphic, kMegamorphic };
+
+        static const uint32_t kPolyEntries = 4;     // entries of a polymorphic site
+        static const uint32_t kMegaEntries = 256;   // entries of a megamorphic table, a power of 2
+
+        BindingCache(const Multiname*, BindingCache* next, Kind);
+
+        /** the vtable or tag the cache is bound to, 0 if it is unbound */
+        uintptr_t key() const { return uintptr_t(vtable); }
+
         union {
             VTable* vtable;         // for kObjectType receivers
             Atom tag;               // for primitive receivers
@@ -170,6 +211,11 @@ namespace avmplus
         };
         const Multiname* const name;      // multiname for this entry, saved when cache created.
         BindingCache* const next;         // singly-linked list
+        const uint8_t kind;               // Kind
+        uint8_t state;                    // State
+        uint32_t hits;                    // handler hits, counted only if AVMPLUS_VERBOSE
+        uint32_t misses;                  // calls to the miss handler
+        uint32_t transitions;             // changes of state
     };
 
     // cache for late bound calls
@@ -178,6 +224,7 @@ namespace avmplus
         typedef Atom (*Handler)(CallCache&, Atom base, int argc, Atom* args, MethodEnv*);
         CallCache(const Multiname*, BindingCache* next);
         Handler call_handler;
+        CallCache* entries;            // kPolyEntries entries once polymorphic, else NULL
     };
 
     // cache for late bound gets
@@ -186,6 +233,7 @@ namespace avmplus
         typedef Atom (*Handler)(GetCache&, MethodEnv*, Atom);
         GetCache(const Multiname*, BindingCache* next);
         Handler get_handler;
+        GetCache* entries;            // kPolyEntries entries once polymorphic, else NULL
     };
 
     // bind cache for sets.  This is necessarily larger than for gets because
@@ -196,6 +244,7 @@ namespace avmplus
         typedef void (*Handler)(SetCache&, Atom obj, Atom val, MethodEnv*);
         SetCache(const Multiname*, BindingCache* next);
         Handler set_handler;
+        SetCache* entries;            // kPolyEntries entries once polymorphic, else NULL
         union {
             Traits* slot_type;  // slot or setter type, for implicit coercion
             GC* gc;             // saved GC* for set-handlers that call WBATOM
@@ -218,11 +267,109 @@ namespace avmplus
 
         /** allocate a new cache slot or reuse an existing one with the same multiname */
         C* allocateCacheSlot(const Multiname* name);
+
+        /** the caches allocated so far */
+        Seq<C*>* allocated() const { return caches.get(); }
+    };
+
+    /**
+     * The stack maps of a method compiled by CodegenLIR, for the exact scanning of
+     * its frames by the GC (GCConfig::exactStackFrames).  There is one map per call
+     * in the code, keyed by the call's return address, with a bit for each word of
+     * the frame, from the stack pointer up to the frame pointer, that can hold a
+     * pointer during the call: the words of LIR_allocp areas such as vars and tags,
+     * the spill slots of pointer-sized values that are live across the call, and the
+     * outgoing arguments.  Allocated in the CodeMgr's allocator, with code lifetime.
+     */
+    class JitStackMap
+    {
+    public:
+        /**
+         * Report the frame of 'methodFrame' to 'frames' if it is stopped in one of
+         * the calls mapped here.  A frame that is not, for example one that is
+         * polling a safepoint or was entered by OSR at an unexpected point, is
+         * left to the conservative scan.
+         */
+        void addFrame(const MethodFrame* methodFrame, MMgc::GCStackFrames& frames) const;
+
+        int32_t methodFrameDisp;        // Displacement of the MethodFrame from the frame pointer
+        uint32_t frameSize;             // Bytes from the stack pointer to the frame pointer during calls
+        uint32_t count;                 // Number of calls
+        const NIns** returnAddresses;   // Sorted
+        const uint32_t** bitmaps;       // For each return address; bit i for the i-th word above the stack pointer
+    };
+
+    /**
+     * Receives the stack maps from the Assembler and builds a JitStackMap.  Calls
+     * in a row often have the same map, so consecutive equal maps are shared.
+     */
+    class StackMapBuilder : public nanojit::StackMapWriter
+    {
+    public:
+        StackMapBuilder(Allocator& alloc, LIns* methodFrame);
+
+        void safepoint(Assembler* assm, NIns* returnAddress, const uint32_t* bitmap, uint32_t nwords);
+        void endAssembly(Assembler* assm, uint32_t frameSize, uint32_t argSize);
+
+        /** Build the JitStackMap in 'alloc', NULL if there is nothing to map. */
+        JitStackMap* finish(Allocator& alloc);
+
+    private:
+        struct Safepoint
+        {
+            NIns* returnAddress;
+            const uint32_t* bitmap;     // Relative to the frame pointer, as received
+            uint32_t nwords;
+        };
+
+        Allocator& alloc;
+        LIns* const methodFrame;
+        SeqBuilder<Safepoint> safepoints;
+        uint32_t count;
+        int32_t methodFrameDisp;
+        uint32_t frameSize;
+        uint32_t argSize;
+        bool valid;                     // False if the MethodFrame was not in the frame at some call
+        bool done;                      // Set by endAssembly()
+    };
+
+    /**
+     * Receives the 64-bit immediates of relocatable code from the Assembler, for
+     * JitCodeCache.  The code is not relocatable if the Assembler reported a
+     * reference it can't patch, or if the LIR has a constant that may be an address
+     * and fits in 32 bits, since the Assembler can fold those into instructions.
+     */
+    class RelocBuilder : public nanojit::RelocWriter
+    {
+    public:
+        struct Reloc
+        {
+            NIns* loc;                  // The 8 bytes of the immediate
+            uint64_t value;             // Unset for a branch, whose target is patched later
+            bool call;                  // The target of a call
+            bool branch;                // The target of a branch
+        };
+
+        RelocBuilder(Allocator& alloc);
+
+        void imm64(Assembler* assm, NIns* loc, uint64_t value, bool call);
+        void branch64(Assembler* assm, NIns* loc);
+        void absolute(Assembler* assm);
+
+        /** Clear 'valid' if the LIR of 'frag' has a constant the relocs would miss. */
+        void scan(Fragment* frag, AvmCore* core);
+
+        SeqBuilder<Reloc> relocs;       // In the order received, the code is written last to first
+        SeqBuilder<BindingCache*> caches;   // The method's binding caches
+        bool valid;
     };
 
     class VarTracker;
     class MopsRangeCheckFilter;
     class PrologWriter;
+    class LirIndex;
+    struct VectorAccess;
+    struct LoopPreheader;
 
     typedef HashMap<LIns*, nanojit::BitSet*> LabelBitSet;
 
@@ -302,6 +449,10 @@ namespace avmplus
 #endif
         int labelCount;
         bool inlineFastpath; // Allow aggressive or speculative inlining, e.g., introducing new labels.
+        bool optVectorLoops; // Emit loop preheaders and record vector accesses for optimizeVectorLoops().
+        Seq<VectorAccess*>* vectorAccesses;     // Inline vector accesses, most recent first
+        Seq<LoopPreheader*>* loopPreheaders;    // Loop preheaders, most recent first
+        LIns* osrJump;                          // The jump from the OSR entry to the loop header, or NULL
         CacheBuilder<CallCache> call_cache_builder;
         CacheBuilder<GetCache> get_cache_builder;
         CacheBuilder<SetCache> set_cache_builder;
@@ -316,6 +467,11 @@ namespace avmplus
         verbose_only(VerboseWriter *vbWriter;)
         verbose_only(LInsPrinter* vbNames;)
         JITDebugInfo *jit_debug_info;
+        Assembler* assm;                // Set by assemble()
+        StackMapBuilder* stackMaps;     // NULL unless the GC scans jit frames exactly
+        RelocBuilder* relocs;           // NULL unless the code is saved in the JitCodeCache
+        verbose_only(bool verboseJit;)  // Set by prepareAssembly(), for assemble()
+        verbose_only(bool verboseRaw;)
 
 #ifdef DEBUGGER
         bool haveDebugger;
@@ -374,6 +530,9 @@ namespace avmplus
         LIns* cmpLt(int lhsi, int rhsi);
         LIns* cmpLe(int lhsi, int rhsi);
         LIns* cmpOptimization(int lhsi, int rhsi, LOpcode icmp, LOpcode ucmp, LOpcode fcmp, bool strictOperation = false);
+        LIns* beginCompareFastpath(LIns* lhs, LIns* rhs, LOpcode pcmp, LOpcode dcmp, CodegenLabel& done);
+        LIns* endCompareFastpath(LIns* result, LIns* cond, CodegenLabel& done);
+        uint32_t typeFeedback() const;
         debug_only( bool isPointer(int i); )
         void emitSetPc(const uint8_t* pc);
         void emitSampleCheck();
@@ -391,6 +550,11 @@ namespace avmplus
         void deadvars_kill(Allocator& alloc,
                 nanojit::BitSet& varlivein, LabelBitSet& varlabels,
                 nanojit::BitSet& taglivein, LabelBitSet& taglabels);
+        void optimizeVectorLoops();
+        bool optimizeVectorLoop(const LirIndex& lir, LoopPreheader* ph,
+                                const HashMap<LIns*, VectorAccess*>& accessByCall,
+                                HashMap<LIns*, LIns*>& replacements, SeqBuilder<LIns*>& live,
+                                Allocator& alloc);
         void copyParam(int i, int &offset);
         bool haveSSE2() const;
 
@@ -504,12 +668,16 @@ namespace avmplus
         void emitInitializers();
         void emitDebugEnter();
         void emitOsrBranch();
+        LoopPreheader* emitLoopPreheader(const uint8_t* header);
+        bool vectorOffsets(Traits* t, int32_t& dataOffset, int32_t& lenOffset);
+        void recordVectorAccess(CodegenLabel& inbounds, LIns* slowCall, LIns* slowExit);
 
         bool isPromote(LOpcode op);
         LIns* imm2Int(LIns* imm);
         LIns* coerceNumberToInt(int i);
 
         bool inlineBuiltinFunction(AbcOpcode opcode, intptr_t method_id, int argc, Traits* result, MethodInfo* mi);
+        bool inlineSmallMethod(AbcOpcode opcode, int argc, Traits* result, MethodInfo* mi);
         LIns* optimizeIntCmpWithNumberCall(int callIndex, int otherIndex, LOpcode icmp, bool swap);
         LIns* optimizeStringCmpWithStringCall(int callIndex, int otherIndex, LOpcode icmp, bool swap);
 
@@ -593,6 +761,13 @@ namespace avmplus
                    OSR *osr_state, JITNoise* noise);
         GprMethodProc emitMD();
 
+        // The three steps of emitMD(), for JitCompileQueue: prepareAssembly() and
+        // finishAssembly() run on the main thread, and assemble() may run on the
+        // compiler thread in between, into the background allocators of the CodeMgr.
+        void prepareAssembly();
+        void assemble(CodeAlloc& codeAlloc, Allocator& dataAlloc);
+        GprMethodProc finishAssembly();
+
         // May return true if JIT will always fail based on information known prior to invocation.
         static bool jitWillFail(const MethodSignaturep ms);
 
@@ -260,6 +260,15 @@ namespace avmplus
 #   define OSR(i1)
 #endif
 
+// Record the kinds of the operands of the instruction at 'offset' (JitConfig::type_feedback).
+#if defined VMCFG_NANOJIT && !defined VMCFG_WORDCODE
+#   define TYPE_FEEDBACK(offset, a1, a2) \
+        if (feedback != NULL)                                       \
+            feedback[offset] |= uint8_t(MethodInfo::feedbackKinds(a1, a2))
+#else
+#   define TYPE_FEEDBACK(offset, a1, a2)
+#endif
+
 /* [Pepper Linux x86 only] 
  *
  * GCC 4.4.3 generates wrong optimization code for the following 2 functions:
@@ -757,6 +766,9 @@ namespace avmplus
         register const bytecode_t* /* NOT VOLATILE */ pc = info->word_code_start();
 #else
         register const bytecode_t* /* NOT VOLATILE */ pc = ms->abc_code_start();
+#endif
+#if defined VMCFG_NANOJIT && !defined VMCFG_WORDCODE
+        uint8_t* const feedback = info->type_feedback();
 #endif
         intptr_t volatile expc=0;
         MMgc::GC::AllocaAutoPtr _framep;
@@ -1619,6 +1631,7 @@ FLOAT_ONLY(\
                 a1 = sp[-1];
                 a2 = sp[0];
                 sp--;
+                TYPE_FEEDBACK(pc-1-codeStart, a1, a2);
             PEEPHOLE_ONLY( add_two_values_into_tos_impl: )
                 ADD_TWO_VALUES_AND_NEXT(a1, a2, sp[0]);
             }
@@ -1946,6 +1959,7 @@ FLOAT_ONLY(\
             INSTR(equals) {
                 // OPTIMIZEME - equals on some classes of values?
                 SAVE_EXPC;
+                TYPE_FEEDBACK(expc, sp[-1], sp[0]);
                 sp[-1] = core->equals(sp[-1], sp[0]);
                 sp--;
                 NEXT;
@@ -1953,6 +1967,7 @@ FLOAT_ONLY(\
 
             INSTR(strictequals) {
                 // OPTIMIZEME - strictequals on some classes of values?
+                TYPE_FEEDBACK(pc-1-codeStart, sp[-1], sp[0]);
                 sp[-1] = AvmCore::stricteq(sp[-1], sp[0]);
                 sp--;
                 NEXT;
@@ -2059,6 +2074,7 @@ FLOAT_ONLY(\
     a1 = sp[-1]; \
     a2 = sp[0]; \
     sp -= 2; \
+    TYPE_FEEDBACK(expc, a1, a2); \
     i1 = S24ARG
 
             INSTR(ifeq) {
@@ -2149,6 +2165,7 @@ FLOAT_ONLY(\
     a1 = sp[-1]; \
     a2 = sp[0]; \
     sp--; \
+    TYPE_FEEDBACK(pc-1-codeStart, a1, a2); \
     if (IS_BOTH_INTEGER(a1, a2))                                \
         b1 = a1 numeric_cmp a2; \
     else if (IS_BOTH_DOUBLE(a1, a2)) \
@@ -0,0 +1,867 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "avmplus.h"
+
+#ifdef VMCFG_NANOJIT
+#include "CodegenLIR.h"
+#include "JitCodeCache.h"
+
+#include <stdio.h>
+
+#if NJ_RELOCATION_SUPPORTED && (defined(AVMPLUS_UNIX) || defined(AVMPLUS_MAC))
+    #define JIT_CODE_CACHE_SUPPORTED
+    #include <dlfcn.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+namespace avmplus
+{
+    // FNV-1a, for the keys and the checksums.
+    static const uint64_t kHashSeed = 0xcbf29ce484222325ULL;
+
+    static uint64_t hash(uint64_t h, const void* p, size_t n)
+    {
+        const uint8_t* b = (const uint8_t*)p;
+        for (size_t i = 0; i < n; i++) {
+            h ^= b[i];
+            h *= 0x100000001b3ULL;
+        }
+        return h;
+    }
+
+    static uint32_t checksum(const void* p, size_t n)
+    {
+        const uint8_t* b = (const uint8_t*)p;
+        uint32_t h = 0x811c9dc5;
+        for (size_t i = 0; i < n; i++) {
+            h ^= b[i];
+            h *= 0x01000193;
+        }
+        return h;
+    }
+
+    static size_t pad8(size_t n)
+    {
+        return (n + 7) & ~size_t(7);
+    }
+
+    // True if an immediate can't be an address.  Immediates of 32 bits are not
+    // reported (RelocBuilder::scan checks them), and user space addresses are
+    // below 2^47.
+    static bool isNumber(uint64_t v)
+    {
+        return v <= 0xffffffffULL || v >= (uint64_t(1) << 47);
+    }
+
+    // An address in the VM's image.
+    static void imageAnchor() {}
+
+    JitCodeCache::JitCodeCache(AvmCore* core, const char* dir)
+        : m_core(core)
+        , m_dir(dir)
+        , m_buildId(0)
+        , m_imageBase(0)
+        , m_lastKey(0)
+        , m_files(NULL)
+    {
+        m_buildId = computeBuildId();
+    }
+
+    JitCodeCache::~JitCodeCache()
+    {
+        while (m_files != NULL) {
+            PoolFile* f = m_files;
+            m_files = f->next;
+            mmfx_delete_array(f->data);
+            mmfx_delete_array(f->records);
+            mmfx_delete(f);
+        }
+    }
+
+    bool JitCodeCache::isSupported()
+    {
+#ifdef JIT_CODE_CACHE_SUPPORTED
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    uint64_t JitCodeCache::computeBuildId()
+    {
+#ifdef JIT_CODE_CACHE_SUPPORTED
+        // The image must be the same file: the offsets into it are saved.
+        Dl_info info;
+        if (!dladdr((void*)&imageAnchor, &info) || info.dli_fbase == NULL || info.dli_fname == NULL)
+            return 0;
+        struct stat st;
+        if (stat(info.dli_fname, &st) != 0)
+            return 0;
+        m_imageBase = uintptr_t(info.dli_fbase);
+
+        const char* built = __DATE__ " " __TIME__;
+        uint64_t h = hash(kHashSeed, built, VMPI_strlen(built));
+        uint64_t file[2] = { uint64_t(st.st_size), uint64_t(st.st_mtime) };
+        h = hash(h, file, sizeof(file));
+        uint32_t sizes[] = { kVersion, uint32_t(sizeof(AvmCore)), uint32_t(sizeof(PoolObject)),
+                             uint32_t(sizeof(MethodInfo)), uint32_t(sizeof(Traits)),
+                             uint32_t(sizeof(CallCache)), uint32_t(sizeof(GetCache)),
+                             uint32_t(sizeof(SetCache)) };
+        h = hash(h, sizes, sizeof(sizes));
+
+        // The options that change the code.
+        const nanojit::Config& nj = m_core->config.njconfig;
+        const JitConfig& jit = m_core->config.jitconfig;
+        uint32_t options = nj.cseopt | nj.force_long_branch << 1 | nj.soft_float << 2 |
+                           jit.opt_inline << 3 | jit.opt_array_read_fastpath << 4 |
+                           jit.opt_inline_vector_access << 5 | m_core->config.interrupts << 6 |
+                           jit.type_feedback << 7 | jit.opt_inline_methods << 8 |
+                           nj.global_regalloc << 9 | jit.opt_vector_loops << 10;
+        h = hash(h, &options, sizeof(options));
+        return h != 0 ? h : 1;
+#else
+        return 0;
+#endif
+    }
+
+    bool JitCodeCache::isUsable() const
+    {
+        if (m_buildId == 0)
+            return false;
+        const nanojit::Config& nj = m_core->config.njconfig;
+        if (nj.harden_function_alignment || nj.harden_nop_insertion || nj.harden_blind_constants)
+            return false;
+#ifdef DEBUGGER
+        if (m_core->debugger() != NULL)
+            return false;
+        Sampler* s = m_core->get_sampler();
+        if (s && s->sampling())
+            return false;
+#endif
+#ifdef VMCFG_TELEMETRY_SAMPLER
+        if (m_core->samplerEnabled)
+            return false;
+#endif
+        return true;
+    }
+
+    void JitCodeCache::addPool(PoolObject* pool)
+    {
+        if (m_buildId == 0)
+            return;
+
+        // Code compiled for a pool depends on the pools loaded before it.
+        ScriptBuffer code = pool->code();
+        ApiVersion apiVersion = pool->getApiVersion();
+        uint64_t h = hash(kHashSeed, &m_buildId, sizeof(m_buildId));
+        h = hash(h, &m_lastKey, sizeof(m_lastKey));
+        h = hash(h, code.getBuffer(), code.getSize());
+        h = hash(h, &apiVersion, sizeof(apiVersion));
+        if (h == 0)
+            h = 1;
+        pool->codeCacheKey = h;
+        m_lastKey = h;
+
+        if (findFile(h) == NULL)
+            readFile(h, pool->methodCount());
+    }
+
+    void JitCodeCache::fileName(uint64_t key, char* buf, size_t size) const
+    {
+        VMPI_snprintf(buf, size, "%s/%08x%08x.jit", m_dir, uint32_t(key >> 32), uint32_t(key));
+    }
+
+    JitCodeCache::PoolFile* JitCodeCache::findFile(uint64_t key) const
+    {
+        for (PoolFile* f = m_files; f != NULL; f = f->next)
+            if (f->key == key)
+                return f;
+        return NULL;
+    }
+
+    JitCodeCache::PoolFile* JitCodeCache::readFile(uint64_t key, uint32_t methodCount)
+    {
+        PoolFile* f = mmfx_new(PoolFile);
+        f->next = m_files;
+        f->key = key;
+        f->data = NULL;
+        f->methodCount = 0;
+        f->records = NULL;
+        f->index = NULL;
+        f->indexed = NULL;
+        m_files = f;
+
+        char name[1024];
+        fileName(key, name, sizeof(name));
+        FILE* fp = fopen(name, "rb");
+        if (fp == NULL)
+            return f;
+        long size = -1;
+        if (fseek(fp, 0, SEEK_END) == 0)
+            size = ftell(fp);
+        if (size < 0 || size > 0x7fffffff || fseek(fp, 0, SEEK_SET) != 0) {
+            fclose(fp);
+            return f;
+        }
+        uint8_t* data = mmfx_new_array(uint8_t, size > 0 ? size_t(size) : 1);
+        bool ok = fread(data, 1, size_t(size), fp) == size_t(size);
+        fclose(fp);
+        const FileHeader* header = (const FileHeader*)data;
+        if (!ok || size < long(sizeof(FileHeader)) || header->magic != kFileMagic || header->version != kVersion ||
+            header->buildId != m_buildId || header->key != key) {
+            mmfx_delete_array(data);
+            // Start again, or the records saved in this run would follow the bad header.
+            if (ok)
+                remove(name);
+            return f;
+        }
+
+        f->data = data;
+        f->methodCount = methodCount;
+        f->records = mmfx_new_array(const RecordBody*, methodCount > 0 ? methodCount : 1);
+        VMPI_memset(f->records, 0, methodCount * sizeof(const RecordBody*));
+
+        // Later records supersede earlier ones; the first bad one ends the file,
+        // since a write may have been cut short.
+        size_t pos = sizeof(FileHeader);
+        while (pos + sizeof(RecordHeader) <= size_t(size)) {
+            const RecordHeader* rh = (const RecordHeader*)(data + pos);
+            size_t next = pos + sizeof(RecordHeader);
+            if (rh->magic != kRecordMagic || rh->size < sizeof(RecordBody) || rh->size > size_t(size) - next ||
+                (rh->size & 7) != 0 || checksum(data + next, rh->size) != rh->checksum)
+                break;
+            const RecordBody* body = (const RecordBody*)(data + next);
+            if (recordSize(body) == rh->size && body->methodId < methodCount)
+                f->records[body->methodId] = body;
+            pos = next + rh->size;
+        }
+        // Drop the rest, or the records saved in this run would follow it.
+        if (pos != size_t(size)) {
+#ifdef JIT_CODE_CACHE_SUPPORTED
+            if (truncate(name, off_t(pos)) != 0)
+#endif
+                remove(name);
+        }
+        return f;
+    }
+
+    uint64_t JitCodeCache::recordSize(const RecordBody* body)
+    {
+        return sizeof(RecordBody) +
+               uint64_t(body->literalCount) * sizeof(Literal) +
+               uint64_t(body->relocCount) * sizeof(Reloc) +
+               uint64_t(body->safepointCount) * sizeof(Safepoint) +
+               pad8(uint64_t(body->bitmapCount) * body->bitmapWords * sizeof(uint32_t)) +
+               pad8(body->namesSize) +
+               pad8(body->codeSize);
+    }
+
+    PoolObject* JitCodeCache::findPool(uint64_t key) const
+    {
+        for (LivePoolNode* node = m_core->livePools; node != NULL; node = node->next) {
+            PoolObject* pool = (PoolObject*) node->pool->get();
+            if (pool != NULL && pool->codeCacheKey == key)
+                return pool;
+        }
+        return NULL;
+    }
+
+    const JitCodeCache::RecordBody* JitCodeCache::findRecord(const MethodInfo* m) const
+    {
+        uint64_t key = m->pool()->codeCacheKey;
+        if (key == 0)
+            return NULL;
+        PoolFile* f = findFile(key);
+        if (f == NULL || f->records == NULL || uint32_t(m->method_id()) >= f->methodCount)
+            return NULL;
+        return f->records[m->method_id()];
+    }
+
+    bool JitCodeCache::has(const MethodInfo* m) const
+    {
+        const RecordBody* body = findRecord(m);
+        if (body == NULL)
+            return false;
+        // Don't verify the method for code that refers to a pool that isn't loaded.
+        const Literal* lits = (const Literal*)(body + 1);
+        for (uint32_t i = 0; i < body->literalCount; i++)
+            if (lits[i].kind >= kString && findPool(lits[i].arg) == NULL)
+                return false;
+        return true;
+    }
+
+    // Saving
+
+    uintptr_t JitCodeCache::resolveInPool(PoolObject* pool, uint8_t kind, uint32_t index)
+    {
+        switch (kind) {
+        case kString:
+            return index < pool->constantStringCount ? uintptr_t(pool->getString(index)) : 0;
+        case kNamespace:
+            return index < pool->cpool_ns.length() ? uintptr_t(pool->cpool_ns[index]) : 0;
+        case kNamespaceSet:
+            return index < pool->cpool_ns_set.length() ? uintptr_t(pool->cpool_ns_set[index]) : 0;
+        case kDouble:
+            return index < pool->cpool_double.length() ? uintptr_t(pool->cpool_double[index]) : 0;
+#ifdef VMCFG_FLOAT
+        case kFloat:
+            return index < pool->cpool_float.length() ? uintptr_t(pool->cpool_float[index]) : 0;
+        case kFloat4:
+            return index < pool->cpool_float4.length() ? uintptr_t(pool->cpool_float4[index]) : 0;
+#endif
+        case kMultiname:
+            return pool->precompNames != NULL && index > 0 && index < pool->precompNames->capacity()
+                   ? uintptr_t(pool->precomputedMultiname(index)) : 0;
+        case kMethod:
+            return index < pool->methodCount() ? uintptr_t(pool->getMethodInfo(index)) : 0;
+        case kClass:
+            return index < pool->classCount() ? uintptr_t(pool->getClassTraits(index)) : 0;
+        case kInstance:
+            return index < pool->classCount() && pool->getClassTraits(index) != NULL
+                   ? uintptr_t((Traits*)pool->getClassTraits(index)->itraits) : 0;
+        case kScript:
+            return index < pool->scriptCount() ? uintptr_t(pool->getScriptTraits(index)) : 0;
+        default:
+            return 0;
+        }
+    }
+
+    void JitCodeCache::indexPool(PoolFile* f, PoolObject* pool)
+    {
+        // Everything but the strings, which are created lazily, is created when
+        // the pool is parsed.
+        uint32_t n = pool->cpool_ns.length() + pool->cpool_ns_set.length() + pool->cpool_double.length() +
+                     pool->methodCount() + 2 * pool->classCount() + pool->scriptCount() +
+                     (pool->precompNames != NULL ? pool->precompNames->capacity() : 0);
+        f->index = new (m_alloc) PointerIndex(m_alloc, n / 4 + 16);
+        f->indexed = pool;
+
+        static const uint8_t kinds[] = { kNamespace, kNamespaceSet, kDouble,
+#ifdef VMCFG_FLOAT
+                                         kFloat, kFloat4,
+#endif
+                                         kMultiname, kMethod, kClass, kInstance, kScript };
+        for (uint32_t k = 0; k < sizeof(kinds); k++) {
+            for (uint32_t i = 0; ; i++) {
+                uint32_t count = indexLimit(pool, kinds[k]);
+                if (i >= count)
+                    break;
+                uintptr_t p = resolveInPool(pool, kinds[k], i);
+                if (p != 0 && !f->index->containsKey(p))
+                    f->index->put(p, uint64_t(kinds[k]) << 32 | i);
+            }
+        }
+    }
+
+    uint32_t JitCodeCache::indexLimit(PoolObject* pool, uint8_t kind)
+    {
+        switch (kind) {
+        case kNamespace:    return pool->cpool_ns.length();
+        case kNamespaceSet: return pool->cpool_ns_set.length();
+        case kDouble:       return pool->cpool_double.length();
+#ifdef VMCFG_FLOAT
+        case kFloat:        return pool->cpool_float.length();
+        case kFloat4:       return pool->cpool_float4.length();
+#endif
+        case kMultiname:    return pool->precompNames != NULL ? pool->precompNames->capacity() : 0;
+        case kMethod:       return pool->methodCount();
+        case kClass:
+        case kInstance:     return pool->classCount();
+        case kScript:       return pool->scriptCount();
+        default:            return 0;
+        }
+    }
+
+    bool JitCodeCache::classifyInPool(PoolObject* pool, uintptr_t p, bool strings, Literal& lit)
+    {
+        if (strings) {
+            if (pool->_abcStrings == NULL)
+                return false;
+            for (uint32_t i = 0; i < pool->constantStringCount; i++) {
+                const ConstantStringData& d = pool->_abcStrings->data[i];
+                if (d.abcPtr >= pool->_abcStringStart && d.abcPtr < pool->_abcStringEnd)
+                    continue;   // Not created yet
+                if (uintptr_t(d.str) == p) {
+                    lit.kind = kString;
+                    lit.index = i;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        PoolFile* f = findFile(pool->codeCacheKey);
+        if (f == NULL)
+            return false;
+        if (f->indexed != pool)
+            indexPool(f, pool);
+        if (!f->index->containsKey(p))
+            return false;
+        uint64_t entry = f->index->get(p);
+        lit.kind = uint8_t(entry >> 32);
+        lit.index = uint32_t(entry);
+        // The pool indexed may have died, and another taken its place.
+        if (resolveInPool(pool, lit.kind, lit.index) != p) {
+            indexPool(f, pool);
+            return classifyInPool(pool, p, false, lit);
+        }
+        return true;
+    }
+
+    bool JitCodeCache::classify(MethodInfo* m, uint64_t value, bool call, const RelocBuilder* relocs,
+                                Literal& lit, const char*& name)
+    {
+        VMPI_memset(&lit, 0, sizeof(lit));
+        name = NULL;
+        uintptr_t p = uintptr_t(value);
+        AvmCore* core = m_core;
+
+        if (!call) {
+            if (p >= uintptr_t(core) && p < uintptr_t(core) + sizeof(AvmCore)) {
+                lit.kind = kCoreAddress;
+                lit.arg = p - uintptr_t(core);
+                return true;
+            }
+            if (p == uintptr_t(core->GetGC())) {
+                lit.kind = kGC;
+                return true;
+            }
+
+            PoolObject* pool = m->pool();
+            for (Seq<BindingCache*>* s = relocs->caches.get(); s != NULL; s = s->tail) {
+                BindingCache* c = s->head;
+                if (p != uintptr_t(c))
+                    continue;
+                Literal multiname;
+                if (!classifyInPool(pool, uintptr_t(c->name), false, multiname) || multiname.kind != kMultiname)
+                    return false;
+                lit.kind = uint8_t(kCallCache + c->kind);
+                lit.index = multiname.index;
+                return true;
+            }
+
+            if (p == uintptr_t(m->activationTraits())) {
+                lit.kind = kActivation;
+                return true;
+            }
+            ExceptionHandlerTable* exceptions = m->abc_exceptions();
+            if (exceptions != NULL) {
+                if (p == uintptr_t(exceptions)) {
+                    lit.kind = kExceptions;
+                    return true;
+                }
+                for (int32_t i = 0; i < exceptions->exception_count; i++) {
+                    if (p == uintptr_t(exceptions->exceptions[i].scopeTraits)) {
+                        lit.kind = kScopeTraits;
+                        lit.index = uint32_t(i);
+                        return true;
+                    }
+                }
+            }
+
+            // The core's constants, which are often in a pool too.
+            uintptr_t* first = (uintptr_t*)&core->booleanStrings[0];
+            uintptr_t* last = (uintptr_t*)&core->exceptionAddr;
+            for (uintptr_t* f = first; f < last; f++) {
+                if (*f == p) {
+                    lit.kind = kCoreField;
+                    lit.arg = uintptr_t(f) - uintptr_t(core);
+                    return true;
+                }
+            }
+
+            // Atoms keep their tag.
+            uintptr_t tag = p & 7;
+            for (int strings = 0; strings < 2; strings++) {
+                for (LivePoolNode* node = core->livePools; node != NULL; node = node->next) {
+                    PoolObject* pool = (PoolObject*) node->pool->get();
+                    if (pool == NULL || pool->codeCacheKey == 0)
+                        continue;
+                    if (classifyInPool(pool, p & ~uintptr_t(7), strings != 0, lit)) {
+                        lit.tag = uint8_t(tag);
+                        lit.arg = pool->codeCacheKey;
+                        return true;
+                    }
+                }
+            }
+        }
+
+#ifdef JIT_CODE_CACHE_SUPPORTED
+        // Calls, and the addresses of functions and static data.
+        Dl_info info;
+        if (dladdr((void*)p, &info) && info.dli_fbase != NULL) {
+            if (uintptr_t(info.dli_fbase) == m_imageBase) {
+                lit.kind = kImage;
+                lit.arg = p - m_imageBase;
+                return true;
+            }
+            if (info.dli_sname != NULL && uintptr_t(info.dli_saddr) == p) {
+                lit.kind = kSymbol;
+                lit.arg = VMPI_strlen(info.dli_sname);
+                name = info.dli_sname;
+                return true;
+            }
+        }
+#endif
+        return false;
+    }
+
+    bool JitCodeCache::save(MethodInfo* m, const void* code, size_t size, const RelocBuilder* relocs, const JitStackMap* map)
+    {
+        if (m->pool()->codeCacheKey == 0 || findFile(m->pool()->codeCacheKey) == NULL)
+            return false;
+
+        const uint8_t* start = (const uint8_t*)code;
+        const char* reason = NULL;
+        uint64_t culprit = 0;
+
+        uint32_t relocCount = 0;
+        for (Seq<RelocBuilder::Reloc>* s = relocs->relocs.get(); s != NULL; s = s->tail)
+            relocCount++;
+
+        // The literals, with the value each one describes.
+        Literal* lits = mmfx_new_array(Literal, relocCount + 1);
+        uint64_t* values = mmfx_new_array(uint64_t, relocCount + 1);
+        const char** names = mmfx_new_array(const char*, relocCount + 1);
+        Reloc* out = mmfx_new_array(Reloc, relocCount + 1);
+        uint32_t literalCount = 0;
+        uint32_t n = 0;
+        size_t namesSize = 0;
+
+        for (Seq<RelocBuilder::Reloc>* s = relocs->relocs.get(); s != NULL && reason == NULL; s = s->tail) {
+            const RelocBuilder::Reloc& r = s->head;
+            size_t offset = (const uint8_t*)r.loc - start;
+            if ((const uint8_t*)r.loc < start || offset + sizeof(uint64_t) > size) {
+                reason = "immediate outside the code";
+                break;
+            }
+            uint64_t value;
+            VMPI_memcpy(&value, start + offset, sizeof(value));
+            AvmAssert(r.branch || value == r.value);
+            if (!r.call && !r.branch && isNumber(value))
+                continue;
+
+            uint32_t i = 0;
+            while (i < literalCount && values[i] != value)
+                i++;
+            if (i == literalCount) {
+                if (r.branch) {
+                    // Long branches go to the method's own code.
+                    VMPI_memset(&lits[i], 0, sizeof(Literal));
+                    names[i] = NULL;
+                    lits[i].kind = kCode;
+                    lits[i].arg = value - uint64_t(uintptr_t(start));
+                    if (value < uint64_t(uintptr_t(start)) || lits[i].arg > size) {
+                        reason = "branch outside the code";
+                        culprit = value;
+                        break;
+                    }
+                } else if (!classify(m, value, r.call, relocs, lits[i], names[i])) {
+                    // An Atom of an integer, unless it is the address of a field.
+                    if (!r.call && (value & 7) == kIntptrType)
+                        continue;
+                    reason = r.call ? "call" : "value";
+                    culprit = value;
+                    break;
+                }
+                if (names[i] != NULL) {
+                    lits[i].index = uint32_t(namesSize);
+                    namesSize += size_t(lits[i].arg) + 1;
+                }
+                values[i] = value;
+                literalCount++;
+            }
+            out[n].offset = uint32_t(offset);
+            out[n].literal = i;
+            n++;
+        }
+
+        // The stack map, with offsets for the return addresses.
+        uint32_t safepointCount = map != NULL ? map->count : 0;
+        uint32_t bitmapWords = map != NULL ? (map->frameSize / sizeof(void*) + 31) / 32 : 0;
+        Safepoint* safepoints = mmfx_new_array(Safepoint, safepointCount + 1);
+        const uint32_t** bitmaps = mmfx_new_array(const uint32_t*, safepointCount + 1);
+        uint32_t bitmapCount = 0;
+        for (uint32_t i = 0; i < safepointCount && reason == NULL; i++) {
+            const uint8_t* ra = (const uint8_t*)map->returnAddresses[i];
+            if (ra <= start || ra > start + size) {
+                reason = "return address outside the code";
+                break;
+            }
+            uint32_t b = 0;
+            while (b < bitmapCount && bitmaps[b] != map->bitmaps[i])
+                b++;
+            if (b == bitmapCount)
+                bitmaps[bitmapCount++] = map->bitmaps[i];
+            safepoints[i].offset = uint32_t(ra - start);
+            safepoints[i].bitmap = b;
+        }
+
+        if (reason == NULL) {
+            RecordBody body;
+            VMPI_memset(&body, 0, sizeof(body));
+            body.methodId = uint32_t(m->method_id());
+            body.codeSize = uint32_t(size);
+            body.codeAlign = uint32_t(uintptr_t(start) & (kCodeAlign - 1));
+            body.literalCount = literalCount;
+            body.relocCount = n;
+            body.safepointCount = safepointCount;
+            body.bitmapCount = bitmapCount;
+            body.bitmapWords = bitmapWords;
+            body.methodFrameDisp = map != NULL ? map->methodFrameDisp : 0;
+            body.frameSize = map != NULL ? map->frameSize : 0;
+            body.namesSize = uint32_t(namesSize);
+
+            // Built in memory and written at once, with the file header if the
+            // file is new.
+            size_t bodySize = size_t(recordSize(&body));
+            size_t total = sizeof(FileHeader) + sizeof(RecordHeader) + bodySize;
+            uint8_t* buf = mmfx_new_array(uint8_t, total);
+            VMPI_memset(buf, 0, total);
+            FileHeader* fh = (FileHeader*)buf;
+            fh->magic = kFileMagic;
+            fh->version = kVersion;
+            fh->buildId = m_buildId;
+            fh->key = m->pool()->codeCacheKey;
+            RecordHeader* rh = (RecordHeader*)(fh + 1);
+            uint8_t* p = (uint8_t*)(rh + 1);
+            VMPI_memcpy(p, &body, sizeof(body));
+            p += sizeof(body);
+            VMPI_memcpy(p, lits, literalCount * sizeof(Literal));
+            p += literalCount * sizeof(Literal);
+            VMPI_memcpy(p, out, n * sizeof(Reloc));
+            p += n * sizeof(Reloc);
+            VMPI_memcpy(p, safepoints, safepointCount * sizeof(Safepoint));
+            p += safepointCount * sizeof(Safepoint);
+            for (uint32_t b = 0; b < bitmapCount; b++)
+                VMPI_memcpy(p + b * bitmapWords * sizeof(uint32_t), bitmaps[b], bitmapWords * sizeof(uint32_t));
+            p += pad8(bitmapCount * bitmapWords * sizeof(uint32_t));
+            for (uint32_t i = 0; i < literalCount; i++)
+                if (names[i] != NULL)
+                    VMPI_memcpy(p + lits[i].index, names[i], size_t(lits[i].arg) + 1);
+            p += pad8(namesSize);
+            VMPI_memcpy(p, start, size);
+            rh->magic = kRecordMagic;
+            rh->size = uint32_t(bodySize);
+            rh->checksum = checksum(rh + 1, bodySize);
+
+            char name[1024];
+            fileName(m->pool()->codeCacheKey, name, sizeof(name));
+            FILE* fp = fopen(name, "ab");
+            if (fp != NULL) {
+                setvbuf(fp, NULL, _IONBF, 0);
+                fseek(fp, 0, SEEK_END);
+                const uint8_t* from = ftell(fp) == 0 ? buf : (const uint8_t*)rh;
+                if (fwrite(from, 1, buf + total - from, fp) != size_t(buf + total - from))
+                    reason = "write error";
+                fclose(fp);
+            } else {
+                reason = "can't open the file";
+            }
+            mmfx_delete_array(buf);
+        }
+
+        mmfx_delete_array(bitmaps);
+        mmfx_delete_array(safepoints);
+        mmfx_delete_array(out);
+        mmfx_delete_array(names);
+        mmfx_delete_array(values);
+        mmfx_delete_array(lits);
+
+#ifdef AVMPLUS_VERBOSE
+        if (m->pool()->isVerbose(VB_execpolicy)) {
+            if (reason == NULL) {
+                m_core->console << "codecache save (" << m->unique_method_id() << ") " << m
+                                << " " << uint32_t(size) << " bytes\n";
+            } else {
+                m_core->console << "codecache reject (" << m->unique_method_id() << ") " << m
+                                << " " << reason;
+                if (culprit != 0)
+                    m_core->console << " " << hexAddr(culprit);
+                m_core->console << "\n";
+            }
+        }
+#else
+        (void)culprit;
+#endif
+        return reason == NULL;
+    }
+
+    // Loading
+
+    uintptr_t JitCodeCache::resolve(MethodInfo* m, const Literal& lit, const char* names, uint32_t namesSize, CodeMgr* mgr)
+    {
+        AvmCore* core = m_core;
+        ExceptionHandlerTable* exceptions = m->abc_exceptions();
+        switch (lit.kind) {
+        case kImage:
+            return m_imageBase + uintptr_t(lit.arg);
+        case kSymbol:
+#ifdef JIT_CODE_CACHE_SUPPORTED
+            if (uint64_t(lit.index) + lit.arg < namesSize && names[lit.index + lit.arg] == 0)
+                return uintptr_t(dlsym(RTLD_DEFAULT, names + lit.index));
+#endif
+            return 0;
+        case kCoreAddress:
+            return lit.arg < sizeof(AvmCore) ? uintptr_t(core) + uintptr_t(lit.arg) : 0;
+        case kCoreField: {
+            uintptr_t first = uintptr_t(&core->booleanStrings[0]) - uintptr_t(core);
+            uintptr_t last = uintptr_t(&core->exceptionAddr) - uintptr_t(core);
+            if (lit.arg < first || lit.arg >= last || (lit.arg & (sizeof(uintptr_t) - 1)) != 0)
+                return 0;
+            return *(uintptr_t*)(uintptr_t(core) + uintptr_t(lit.arg));
+        }
+        case kGC:
+            return uintptr_t(core->GetGC());
+        case kCode:
+            return 0;   // Resolved by load(), which places the code
+        case kCallCache:
+        case kGetCache:
+        case kSetCache: {
+            PoolObject* pool = m->pool();
+            const Multiname* name = (const Multiname*)resolveInPool(pool, kMultiname, lit.index);
+            if (name == NULL)
+                return 0;
+            BindingCache* c;
+            if (lit.kind == kCallCache)
+                c = new (mgr->allocator) CallCache(name, mgr->bindingCaches);
+            else if (lit.kind == kGetCache)
+                c = new (mgr->allocator) GetCache(name, mgr->bindingCaches);
+            else
+                c = new (mgr->allocator) SetCache(name, mgr->bindingCaches);
+            mgr->bindingCaches = c;
+            return uintptr_t(c);
+        }
+        case kActivation:
+            return uintptr_t(m->activationTraits());
+        case kExceptions:
+            return uintptr_t(exceptions);
+        case kScopeTraits:
+            return exceptions != NULL && lit.index < uint32_t(exceptions->exception_count)
+                   ? uintptr_t(exceptions->exceptions[lit.index].scopeTraits) : 0;
+        default: {
+            PoolObject* pool = findPool(lit.arg);
+            if (pool == NULL)
+                return 0;
+            uintptr_t p = resolveInPool(pool, lit.kind, lit.index);
+            return p != 0 ? p | lit.tag : 0;
+        }
+        }
+    }
+
+    GprMethodProc JitCodeCache::load(MethodInfo* m)
+    {
+        const RecordBody* body = findRecord(m);
+        if (body == NULL)
+            return NULL;
+
+        const Literal* lits = (const Literal*)(body + 1);
+        const Reloc* relocs = (const Reloc*)(lits + body->literalCount);
+        const Safepoint* safepoints = (const Safepoint*)(relocs + body->relocCount);
+        const uint32_t* bitmaps = (const uint32_t*)(safepoints + body->safepointCount);
+        const char* names = (const char*)bitmaps + pad8(body->bitmapCount * body->bitmapWords * sizeof(uint32_t));
+        const uint8_t* code = (const uint8_t*)names + pad8(body->namesSize);
+        const size_t size = body->codeSize;
+
+        // The checksum only catches accidents, check everything that is used.
+        if (size == 0 || body->codeAlign >= kCodeAlign)
+            return NULL;
+        for (uint32_t i = 0; i < body->relocCount; i++)
+            if (uint64_t(relocs[i].offset) + sizeof(uint64_t) > size || relocs[i].literal >= body->literalCount)
+                return NULL;
+        for (uint32_t i = 0; i < body->literalCount; i++)
+            if (lits[i].kind == kCode && lits[i].arg > size)
+                return NULL;
+        for (uint32_t i = 0; i < body->safepointCount; i++)
+            if (safepoints[i].offset == 0 || safepoints[i].offset > size || safepoints[i].bitmap >= body->bitmapCount)
+                return NULL;
+
+        // The binding caches last, so that they are only made for code that is installed.
+        CodeMgr* mgr = initCodeMgr(m->pool());
+        uintptr_t* values = mmfx_new_array(uintptr_t, body->literalCount + 1);
+        bool resolved = true;
+        for (int pass = 0; pass < 2 && resolved; pass++) {
+            for (uint32_t i = 0; i < body->literalCount && resolved; i++) {
+                bool cache = lits[i].kind >= kCallCache && lits[i].kind <= kSetCache;
+                if (cache != (pass == 1) || lits[i].kind == kCode)
+                    continue;
+                values[i] = resolve(m, lits[i], names, body->namesSize, mgr);
+                resolved = values[i] != 0;
+            }
+        }
+        if (!resolved) {
+            mmfx_delete_array(values);
+            return NULL;
+        }
+
+        // A block that can hold the code at its original alignment.  The blocks
+        // that are too small are held until then, so that they aren't returned again.
+        CodeAlloc& codeAlloc = mgr->codeAlloc;
+        const size_t need = size + 2 * kCodeAlign;
+        CodeList* tooSmall = NULL;
+        NIns* start = NULL;
+        NIns* end = NULL;
+        for (int tries = 0; ; tries++) {
+            codeAlloc.alloc(start, end, 0);
+            if (size_t((uint8_t*)end - (uint8_t*)start) >= need)
+                break;
+            CodeAlloc::add(tooSmall, start, end);
+            start = end = NULL;
+            if (tries == 8)
+                break;
+        }
+        codeAlloc.freeAll(tooSmall);
+        if (start == NULL) {
+            mmfx_delete_array(values);
+            return NULL;
+        }
+
+        uintptr_t at = ((uintptr_t(end) - size) & ~uintptr_t(kCodeAlign - 1)) + body->codeAlign;
+        if (at + size > uintptr_t(end))
+            at -= kCodeAlign;
+        uint8_t* dst = (uint8_t*)at;
+        VMPI_memcpy(dst, code, size);
+        for (uint32_t i = 0; i < body->relocCount; i++) {
+            const Literal& lit = lits[relocs[i].literal];
+            uint64_t v = lit.kind == kCode ? uint64_t(at + uintptr_t(lit.arg)) : values[relocs[i].literal];
+            VMPI_memcpy(dst + relocs[i].offset, &v, sizeof(v));
+        }
+        mmfx_delete_array(values);
+
+        CodeList* blocks = NULL;
+        codeAlloc.addRemainder(blocks, start, end, start, (NIns*)dst);
+#if defined(NANOJIT_WIN_CFG)
+        codeAlloc.markExec(blocks, (NIns*)dst);
+#else
+        codeAlloc.markExec(blocks);
+#endif
+        CodeAlloc::flushICache(blocks);
+
+        if (body->safepointCount > 0 && m_core->GetGC()->ExactStackFrames()) {
+            Allocator& alloc = mgr->allocator;
+            JitStackMap* map = new (alloc) JitStackMap();
+            map->methodFrameDisp = body->methodFrameDisp;
+            map->frameSize = body->frameSize;
+            map->count = body->safepointCount;
+            map->returnAddresses = (const NIns**) alloc.alloc(map->count * sizeof(NIns*));
+            map->bitmaps = (const uint32_t**) alloc.alloc(map->count * sizeof(uint32_t*));
+            size_t nbytes = body->bitmapCount * body->bitmapWords * sizeof(uint32_t);
+            uint32_t* copy = (uint32_t*) alloc.alloc(nbytes > 0 ? nbytes : sizeof(uint32_t));
+            VMPI_memcpy(copy, bitmaps, nbytes);
+            for (uint32_t i = 0; i < map->count; i++) {
+                map->returnAddresses[i] = (const NIns*)(dst + safepoints[i].offset);
+                map->bitmaps[i] = copy + safepoints[i].bitmap * body->bitmapWords;
+            }
+            m->set_jit_stack_map(map);
+        }
+
+        return (GprMethodProc)dst;
+    }
+}
+
+#endif // VMCFG_NANOJIT
@@ -0,0 +1,220 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __avmplus_JitCodeCache__
+#define __avmplus_JitCodeCache__
+
+namespace avmplus
+{
+    class RelocBuilder;
+    class JitStackMap;
+
+    /**
+     * A persistent cache of the code compiled by CodegenLIR (JitConfig::code_cache).
+     *
+     * Every pool gets a key when its ABC is prepared: a hash of the ABC, of the keys
+     * of the pools loaded before it, and of this build of the VM and its options.
+     * The code of the pool's methods is appended to the file <dir>/<key>.jit as it
+     * is compiled, and the next run that loads the same pools in the same order
+     * installs it instead of compiling again: the verifier still runs, with a plain
+     * CodeWriter, then the code is copied into the pool's CodeAlloc and patched.
+     *
+     * Relocatable code is assembled with a RelocWriter: every call and every 64-bit
+     * constant is a movq of a 64-bit immediate that the RelocBuilder records (x64
+     * only, see NJ_RELOCATION_SUPPORTED).  When the method is saved each immediate
+     * that may be an address is described as something that can be found again:
+     * an offset into the VM's image, a symbol of another library, a field of the
+     * AvmCore, one of the method's binding caches, or a constant, method or traits
+     * of a pool, by index and pool key.  A method that refers to anything else is
+     * not saved.
+     *
+     * A record is checksummed and written with a single write, a file is read once
+     * when its pool is added, and a record that is truncated, corrupt, or that
+     * refers to a pool that is not loaded is ignored: the method is compiled as
+     * usual and its new record supersedes the old one.  A file is cut back to its
+     * last good record, and one with a bad header removed, before new records are
+     * appended to it.
+     *
+     * Main thread only.
+     */
+    class JitCodeCache
+    {
+    public:
+        /** A cache in the existing directory 'dir', which is not copied. */
+        JitCodeCache(AvmCore* core, const char* dir);
+        ~JitCodeCache();
+
+        /** True if the cache can work on this platform. */
+        static bool isSupported();
+
+        /**
+         * Give 'pool' its key and read its file.  Called once per pool, when its ABC
+         * is prepared (BaseExecMgr::notifyAbcPrepared); the order matters.
+         */
+        void addPool(PoolObject* pool);
+
+        /**
+         * True if code compiled now can be saved, and saved code installed: no
+         * debugger, sampler or hardening option changes the code.
+         */
+        bool isUsable() const;
+
+        /** True if there is a record for 'm'. */
+        bool has(const MethodInfo* m) const;
+
+        /**
+         * Copy the saved code of 'm', which has just been verified, into its pool's
+         * CodeAlloc and set its stack map.  Returns NULL if there is no record for
+         * 'm' or the record can't be resolved.
+         */
+        GprMethodProc load(MethodInfo* m);
+
+        /**
+         * Append the code of 'm', [code, code+size), to its pool's file.  Returns
+         * false if the code refers to something that can't be found again.
+         */
+        bool save(MethodInfo* m, const void* code, size_t size, const RelocBuilder* relocs, const JitStackMap* map);
+
+    private:
+        // How an immediate is found again.  Kinds from kString on are in a pool.
+        enum LiteralKind
+        {
+            kImage,                     // 'arg' is the offset into the VM's image
+            kSymbol,                    // 'index' is the offset of the symbol's name in the record, 'arg' its length
+            kCoreAddress,               // 'arg' is the offset into the AvmCore
+            kCoreField,                 // The value of the AvmCore field at offset 'arg'
+            kGC,                        // The AvmCore's GC
+            kCode,                      // 'arg' is the offset into the method's code
+            kCallCache,                 // A new binding cache for multiname 'index' of the method's pool
+            kGetCache,
+            kSetCache,
+            kActivation,                // The method's activation traits
+            kExceptions,                // The method's exception handler table
+            kScopeTraits,               // The scope traits of exception handler 'index' of the method
+            kString,                    // Constant 'index' of the pool with key 'arg'
+            kNamespace,
+            kNamespaceSet,
+            kDouble,
+            kFloat,
+            kFloat4,
+            kMultiname,                 // Precomputed multiname 'index'
+            kMethod,                    // MethodInfo 'index'
+            kClass,                     // Class traits 'index'
+            kInstance,                  // Instance traits of class 'index'
+            kScript                     // Script traits 'index'
+        };
+
+        struct Literal
+        {
+            uint8_t kind;               // LiteralKind
+            uint8_t tag;                // Low bits to add to the address
+            uint16_t pad;
+            uint32_t index;
+            uint64_t arg;
+        };
+
+        struct Reloc
+        {
+            uint32_t offset;            // Of the immediate, from the start of the code
+            uint32_t literal;
+        };
+
+        struct Safepoint
+        {
+            uint32_t offset;            // Of the return address
+            uint32_t bitmap;            // Index of its bitmap
+        };
+
+        struct FileHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t buildId;
+            uint64_t key;
+        };
+
+        struct RecordHeader
+        {
+            uint32_t magic;
+            uint32_t size;              // Of the body, which follows
+            uint32_t checksum;          // Of the body
+            uint32_t pad;
+        };
+
+        // The body of a record is a RecordBody followed by the literals, the relocs,
+        // the safepoints, the bitmaps, the symbol names padded to 8 bytes, and the code.
+        struct RecordBody
+        {
+            uint32_t methodId;
+            uint32_t codeSize;
+            uint32_t codeAlign;         // Address of the code modulo kCodeAlign
+            uint32_t literalCount;
+            uint32_t relocCount;
+            uint32_t safepointCount;
+            uint32_t bitmapCount;
+            uint32_t bitmapWords;
+            int32_t methodFrameDisp;
+            uint32_t frameSize;
+            uint32_t namesSize;
+            uint32_t pad;
+        };
+
+        // Address -> kind << 32 | index
+        typedef nanojit::HashMap<uintptr_t, uint64_t> PointerIndex;
+
+        // The contents of a pool's file, kept for the life of the cache.
+        struct PoolFile
+        {
+            PoolFile* next;
+            uint64_t key;
+            uint8_t* data;              // The whole file, or NULL if it could not be read
+            uint32_t methodCount;       // Length of 'records'
+            const RecordBody** records; // By method id, the last valid record; NULL if none
+            PointerIndex* index;        // Addresses of the constants of 'indexed', but its strings
+            PoolObject* indexed;        // The pool 'index' was built for, or NULL
+        };
+
+        static const uint32_t kFileMagic = 0x4a434331;     // 'JCC1'
+        static const uint32_t kRecordMagic = 0x4a524543;   // 'JREC'
+        static const uint32_t kVersion = 1;
+        static const uint32_t kCodeAlign = 16;
+
+        uint64_t computeBuildId();
+        PoolFile* readFile(uint64_t key, uint32_t methodCount);
+        PoolFile* findFile(uint64_t key) const;
+        PoolObject* findPool(uint64_t key) const;
+        const RecordBody* findRecord(const MethodInfo* m) const;
+        void fileName(uint64_t key, char* buf, size_t size) const;
+        static uint64_t recordSize(const RecordBody* body);
+
+        // Describe 'value' for 'm'.  Returns false if it can't be found again.
+        bool classify(MethodInfo* m, uint64_t value, bool call, const RelocBuilder* relocs,
+                      Literal& lit, const char*& name);
+        bool classifyInPool(PoolObject* pool, uintptr_t p, bool strings, Literal& lit);
+        void indexPool(PoolFile* f, PoolObject* pool);
+        static uint32_t indexLimit(PoolObject* pool, uint8_t kind);
+
+        // The constant of kind 'kind' at 'index' in 'pool', or 0 if there is none.
+        static uintptr_t resolveInPool(PoolObject* pool, uint8_t kind, uint32_t index);
+
+        // The value of 'lit' for 'm' in this run, or 0 if it can't be found.
+        uintptr_t resolve(MethodInfo* m, const Literal& lit, const char* names, uint32_t namesSize, CodeMgr* mgr);
+
+        AvmCore* const m_core;
+        const char* const m_dir;
+        uint64_t m_buildId;             // 0 if the image could not be identified
+        uintptr_t m_imageBase;          // Load address of the VM's image
+        uint64_t m_lastKey;             // Key of the last pool added
+        PoolFile* m_files;
+        Allocator m_alloc;              // For the pool indexes
+
+    private: // not implemented
+        JitCodeCache(const JitCodeCache&);
+        JitCodeCache& operator=(const JitCodeCache&);
+    };
+}
+
+#endif /* __avmplus_JitCodeCache__ */
@@ -0,0 +1,188 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#include "avmplus.h"
+
+#ifdef VMCFG_NANOJIT
+#include "CodegenLIR.h"
+#include "JitCompileQueue.h"
+
+namespace avmplus
+{
+    JitCompileQueue::JitCompileQueue()
+        : m_thread(NULL)
+        , m_noise(MMgc::GCHeap::secret)
+        , m_queued(NULL)
+        , m_running(NULL)
+        , m_finished(NULL)
+        , m_shutdown(false)
+        , m_hasFinished(false)
+        , m_installed(0)
+        , m_latencyTicks(0)
+    {
+    }
+
+    JitCompileQueue::~JitCompileQueue()
+    {
+        if (m_thread != NULL) {
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                m_shutdown = true;
+                locker.notifyAll();
+            }
+            m_thread->join();
+            mmfx_delete(m_thread);
+        }
+        // The thread only exits between jobs.
+        AvmAssert(m_running == NULL);
+        discard(m_queued, NULL);
+        discard(m_finished, NULL);
+    }
+
+    bool JitCompileQueue::start()
+    {
+        AvmAssert(m_thread == NULL);
+        m_thread = mmfx_new(vmbase::VMThread("JitCompileQueue", this));
+        if (!m_thread->start()) {
+            mmfx_delete(m_thread);
+            m_thread = NULL;
+            return false;
+        }
+        return true;
+    }
+
+    uint32_t JitCompileQueue::enqueue(MethodInfo* method, CodegenLIR* jit, CodeMgr* mgr)
+    {
+        AvmAssert(m_thread != NULL);
+        AvmAssert(mgr->jitQueue == NULL || mgr->jitQueue == this);
+
+        // Small chunks, since every job seals the chunks it has written to.
+        if (mgr->bgCodeAlloc == NULL) {
+            mgr->bgCodeAlloc = mmfx_new(CodeAlloc(&method->pool()->core->config.njconfig, 1));
+            mgr->bgAllocator = mmfx_new(Allocator());
+        }
+        mgr->jitQueue = this;
+        mgr->jitJobs++;
+
+        Job* job = mmfx_new(Job);
+        job->next = NULL;
+        job->method = method;
+        job->jit = jit;
+        job->mgr = mgr;
+        job->queued = VMPI_getPerformanceCounter();
+        job->started = 0;
+        job->finished = 0;
+
+        uint32_t ahead = 0;
+        SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+            Job** p = &m_queued;
+            for ( ; *p != NULL ; p = &(*p)->next)
+                ahead++;
+            *p = job;
+            if (m_running != NULL)
+                ahead++;
+            locker.notifyAll();
+        }
+        return ahead;
+    }
+
+    JitCompileQueue::Job* JitCompileQueue::takeFinished()
+    {
+        Job* job = NULL;
+        SCOPE_LOCK_NO_SP(m_monitor) {
+            job = m_finished;
+            if (job != NULL) {
+                m_finished = job->next;
+                job->next = NULL;
+            }
+            m_hasFinished = m_finished != NULL;
+        }
+        return job;
+    }
+
+    void JitCompileQueue::release(Job* job)
+    {
+        CodeMgr* mgr = job->mgr;
+        AvmAssert(mgr->jitQueue == this && mgr->jitJobs > 0);
+        if (--mgr->jitJobs == 0)
+            mgr->jitQueue = NULL;
+
+        m_installed++;
+        m_latencyTicks += job->finished - job->queued;
+
+        mmfx_delete(job->jit);
+        mmfx_delete(job);
+    }
+
+    void JitCompileQueue::cancel(CodeMgr* mgr)
+    {
+        SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+            // The thread is using the CodeMgr's allocators, let it finish.
+            while (m_running != NULL && m_running->mgr == mgr)
+                locker.wait();
+            discard(m_queued, mgr);
+            discard(m_finished, mgr);
+            m_hasFinished = m_finished != NULL;
+        }
+        AvmAssert(mgr->jitJobs == 0 && mgr->jitQueue == NULL);
+    }
+
+    void JitCompileQueue::discard(Job*& list, CodeMgr* mgr)
+    {
+        // The methods are not touched: they may be dead already.
+        for (Job** p = &list ; *p != NULL ; ) {
+            Job* job = *p;
+            if (mgr != NULL && job->mgr != mgr) {
+                p = &job->next;
+                continue;
+            }
+            *p = job->next;
+            AvmAssert(job->mgr->jitJobs > 0);
+            if (--job->mgr->jitJobs == 0)
+                job->mgr->jitQueue = NULL;
+            mmfx_delete(job->jit);
+            mmfx_delete(job);
+        }
+    }
+
+    void JitCompileQueue::run()
+    {
+        // The assembler allocates from FixedMalloc and the code heap, which must
+        // be entered on this thread too.
+        MMGC_ENTER_VOID;
+
+        for (;;) {
+            Job* job;
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                while (!m_shutdown && m_queued == NULL)
+                    locker.wait();
+                if (m_shutdown)
+                    return;
+                job = m_queued;
+                m_queued = job->next;
+                job->next = NULL;
+                m_running = job;
+            }
+
+            job->started = VMPI_getPerformanceCounter();
+            CodeMgr* mgr = job->mgr;
+            job->jit->assemble(*mgr->bgCodeAlloc, *mgr->bgAllocator);
+            mgr->bgCodeAlloc->seal();
+            job->finished = VMPI_getPerformanceCounter();
+
+            SCOPE_LOCK_NO_SP_NAMED(locker, m_monitor) {
+                Job** p = &m_finished;
+                while (*p != NULL)
+                    p = &(*p)->next;
+                *p = job;
+                m_running = NULL;
+                m_hasFinished = true;
+                locker.notifyAll();
+            }
+        }
+    }
+}
+
+#endif // VMCFG_NANOJIT
@@ -0,0 +1,120 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+#ifndef __avmplus_JitCompileQueue__
+#define __avmplus_JitCompileQueue__
+
+namespace avmplus
+{
+    /**
+     * Background compilation of hot methods (JitConfig::background_compile).
+     *
+     * When an interpreted method reaches the OSR invocation threshold it is normally
+     * compiled on the spot, and the call that tripped the counter waits for the
+     * verifier, the LIR generation and the assembly.  With a JitCompileQueue the
+     * main thread still verifies the method and generates its LIR, which need the
+     * GC and the pool, then hands the CodegenLIR to the compiler thread for the
+     * assembly and goes on interpreting the method.  The main thread installs the
+     * finished code itself, from OSR::countInvoke, when the method is next called
+     * or loops (BaseExecMgr::installJit), so the method's entry points only ever
+     * change on the thread that runs it.  Hot loops are still compiled on the spot,
+     * since OSR needs the code at once.
+     *
+     * The compiler thread assembles into the CodeMgr's bgCodeAlloc and bgAllocator,
+     * which nothing else allocates from while a job is running.  A chunk of code
+     * memory is writable while code is written to it, so after each job the thread
+     * seals the code allocator (CodeAlloc::seal): the code handed over is in chunks
+     * that are never written to again.
+     *
+     * Everything except run() is called on the main thread.
+     */
+    class JitCompileQueue : public vmbase::Runnable
+    {
+    public:
+        // Calls and loop edges between the checks for finished code while a method is pending
+        static const uint32_t kPollInterval = 16;
+
+        struct Job
+        {
+            Job* next;
+            MethodInfo* method;
+            CodegenLIR* jit;            // Owned by the job
+            CodeMgr* mgr;               // The method's pool->codeMgr
+            uint64_t queued;            // Ticks when queued
+            uint64_t started;           // Ticks when the thread took it
+            uint64_t finished;          // Ticks when assembled
+        };
+
+        JitCompileQueue();
+
+        /** Discard all jobs, then stop and join the thread. */
+        virtual ~JitCompileQueue();
+
+        /** Start the thread.  Returns false if it could not be started. */
+        bool start();
+
+        /**
+         * Queue the assembly of 'jit', which has generated the LIR of 'method' and
+         * is prepared for assembly (CodegenLIR::prepareAssembly).  The queue owns
+         * 'jit' from now on.
+         *
+         * @return the number of jobs ahead of this one.
+         */
+        uint32_t enqueue(MethodInfo* method, CodegenLIR* jit, CodeMgr* mgr);
+
+        /** True if there may be finished jobs; does not lock. */
+        bool hasFinished() const { return m_hasFinished; }
+
+        /**
+         * Take the job that finished first, or NULL if none has.  The caller
+         * installs its code and then hands it to release().
+         */
+        Job* takeFinished();
+
+        /** Delete a job taken with takeFinished(), and its CodegenLIR. */
+        void release(Job* job);
+
+        /**
+         * Discard the jobs for 'mgr', waiting for the thread if it is assembling one
+         * of them.  Called when the CodeMgr is deleted.
+         */
+        void cancel(CodeMgr* mgr);
+
+        /** Random number source for the CodegenLIRs of the jobs; used by the thread only. */
+        JITNoise* noise() { return &m_noise; }
+
+        // Statistics, for the verbose output
+        uint32_t installed() const { return m_installed; }
+        uint64_t totalLatencyTicks() const { return m_latencyTicks; }
+
+        virtual void run();
+
+    private:
+        // Unlink and delete the jobs on 'list' for 'mgr', or all of them if 'mgr' is NULL.
+        void discard(Job*& list, CodeMgr* mgr);
+
+        vmbase::VMThread* m_thread;     // NULL until start()
+        JITNoise m_noise;
+
+        // The jobs and thread control, protected by m_monitor.
+        vmbase::WaitNotifyMonitor m_monitor;
+        Job* m_queued;                  // FIFO, head first
+        Job* m_running;                 // The job being assembled, or NULL
+        Job* m_finished;                // FIFO, head first
+        bool m_shutdown;                // Set to make the thread exit
+        volatile bool m_hasFinished;    // m_finished != NULL, for polling without the lock
+
+        // Main thread only
+        uint32_t m_installed;           // Jobs released after being assembled
+        uint64_t m_latencyTicks;        // Total time from enqueue() to the end of the assembly
+
+    private: // not implemented
+        JitCompileQueue(const JitCompileQueue&);
+        JitCompileQueue& operator=(const JitCompileQueue&);
+    };
+}
+
+#endif /* __avmplus_JitCompileQueue__ */
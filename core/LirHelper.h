@@ -19,6 +19,8 @@ namespace avmplus
     using namespace nanojit;
     using halfmoon::JitManager;
 
+    class JitCompileQueue;
+
     /**
      * LogControl adapter to print output to AvmCore.console.
      */
@@ -47,6 +49,9 @@ namespace avmplus
     };
 
     class BindingCache; // forward.
+    class CallCache;
+    class GetCache;
+    class SetCache;
 
     /**
      * CodeMgr manages memory for compiled code, including the code itself
@@ -61,10 +66,28 @@ namespace avmplus
         BindingCache* bindingCaches;    // head of linked list of all BindingCaches allocated by this codeMgr
                                         // (only for flushing... lifetime is still managed by codeAlloc)
         CodeMgr(nanojit::Config* conf);
+        ~CodeMgr();
         void flushBindingCaches();      // invalidate all binding caches for this codemgr... needed when AbcEnv is unloaded
+#ifdef AVMPLUS_VERBOSE
+        void dumpBindingCaches(PrintWriter&);   // print the statistics of the binding caches that have missed
+#endif
+
+        // Megamorphic lookup tables of BindingCache::kMegaEntries entries, shared by
+        // the binding caches of this codemgr.  Allocated in 'allocator' when a site
+        // first becomes megamorphic.
+        CallCache*  megaCalls;
+        GetCache*   megaGets;
+        SetCache*   megaSets;
 
         // DEOPT & PROFILER todo: provide some way to free code memory
         JitManager *jit_mgr;
+
+        // Code and data of the methods assembled on the compiler thread, which is
+        // the only thread that allocates from these.  Created by the first job.
+        CodeAlloc*  bgCodeAlloc;
+        Allocator*  bgAllocator;
+        JitCompileQueue* jitQueue;      // The queue while it has jobs for this CodeMgr, else NULL
+        uint32_t    jitJobs;            // Jobs queued, running or not yet installed
     };
 
     // AccSet conventions
@@ -222,6 +222,16 @@ REALLY_INLINE void MethodInfo::setHasFailedJit()
     _hasFailedJit = 1;
 }
 
+REALLY_INLINE uint32_t MethodInfo::isJitPending() const
+{
+    return _isJitPending;
+}
+
+REALLY_INLINE void MethodInfo::setJitPending(bool pending)
+{
+    _isJitPending = pending ? 1 : 0;
+}
+
 REALLY_INLINE uint32_t MethodInfo::isInterpreted() const
 {
     return _isInterpImpl;
@@ -351,6 +361,43 @@ REALLY_INLINE void MethodInfo::set_word_code(MMgc::GC* gc, TranslatedCode* trans
 }
 #endif // VMCFG_WORDCODE
 
+#ifdef VMCFG_NANOJIT
+REALLY_INLINE const JitStackMap* MethodInfo::jit_stack_map() const
+{
+    AvmAssert(!isNative());
+    return _abc.jit_stack_map;
+}
+
+REALLY_INLINE void MethodInfo::set_jit_stack_map(const JitStackMap* map)
+{
+    AvmAssert(!isNative());
+    _abc.jit_stack_map = map;
+}
+
+REALLY_INLINE uint32_t MethodInfo::feedbackKind(Atom a)
+{
+    // One nibble per atom tag, from kDoubleType down to kUnusedAtomTag.
+    return (0x21888488 >> ((uint32_t(a) & kAtomTypeMask) * 4)) & 15;
+}
+
+REALLY_INLINE uint32_t MethodInfo::feedbackKinds(Atom lhs, Atom rhs)
+{
+    return feedbackKind(lhs) | feedbackKind(rhs) << 4;
+}
+
+REALLY_INLINE uint8_t* MethodInfo::type_feedback() const
+{
+    AvmAssert(!isNative());
+    return _abc.type_feedback;
+}
+
+REALLY_INLINE void MethodInfo::set_type_feedback(uint8_t* feedback)
+{
+    AvmAssert(!isNative());
+    _abc.type_feedback = feedback;
+}
+#endif
+
 REALLY_INLINE int32_t MethodInfo::method_id() const
 {
     return _method_id;
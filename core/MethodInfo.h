@@ -173,6 +173,7 @@ namespace avmplus
         uint32_t setsDxns() const;
         uint32_t isStaticInit() const;
         uint32_t hasFailedJit() const;
+        uint32_t isJitPending() const;
         uint32_t isInterpreted() const;
         uint32_t unboxThis() const;
         uint32_t onlyUntypedParameters() const;
@@ -180,6 +181,7 @@ namespace avmplus
         void setUnboxThis();
         void setStaticInit();
         void setHasFailedJit();
+        void setJitPending(bool pending);
         void setHasExceptions();
         void setLazyRest();
         void setNeedsDxns();
@@ -236,6 +238,27 @@ namespace avmplus
         void set_word_code(MMgc::GC* gc, TranslatedCode* translated_code);
     #endif
 
+    #ifdef VMCFG_NANOJIT
+        const JitStackMap* jit_stack_map() const;
+        void set_jit_stack_map(const JitStackMap* map);
+
+        // Operand types seen by the interpreter (JitConfig::type_feedback): one byte
+        // per byte of ABC code, at the offset of each add and compare instruction,
+        // holding the kinds of its left operand in the low nibble and of its right
+        // operand in the high nibble.  NULL if the method is not profiled.
+        enum TypeFeedbackKind
+        {
+            kFeedbackInt    = 1,
+            kFeedbackDouble = 2,
+            kFeedbackString = 4,
+            kFeedbackOther  = 8
+        };
+        static uint32_t feedbackKind(Atom a);
+        static uint32_t feedbackKinds(Atom lhs, Atom rhs);
+        uint8_t* type_feedback() const;
+        void set_type_feedback(uint8_t* feedback);
+    #endif
+
         int32_t  method_id() const;
         uint32_t unique_method_id() const;
 
@@ -305,6 +328,10 @@ namespace avmplus
                 // The contents are the same as the 'exceptions' structure above, except the 'from', 'to', and 'target' fields.
                 ExceptionHandlerTable*  exceptions;
             } word_code;
+    #endif
+    #ifdef VMCFG_NANOJIT
+            const JitStackMap*      jit_stack_map;  // for exact scanning of the jit code's frames, NULL if none; code lifetime
+            uint8_t*                type_feedback;  // see type_feedback(); pool lifetime
     #endif
         };
 
@@ -412,6 +439,10 @@ namespace avmplus
         // set to indicate that an attempted jit compilation has failed
         uint32_t                _hasFailedJit:1;
 
+        // set while the method is being compiled on the compiler thread
+        // (JitCompileQueue); it is interpreted until the code is installed
+        uint32_t                _isJitPending:1;
+
         // true if execution mechanism is the interpreter
         uint32_t                _isInterpImpl:1;
 
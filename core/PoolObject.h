@@ -93,6 +93,7 @@ namespace avmplus
         friend class AbcParser;
         friend class ConstantStringContainer;
         friend class DomainMgr;
+        friend class JitCodeCache;
         friend class halfmoon::JitFriend;
 
         PoolObject(AvmCore* core, ScriptBuffer& sb, const uint8_t* startpos, ApiVersion apiVersion);
@@ -229,6 +230,7 @@ namespace avmplus
     public:
 #ifdef VMCFG_NANOJIT
         CodeMgr* codeMgr;   // points to unmanaged memory and so, not traced
+        uint64_t codeCacheKey;  // JitCodeCache key, 0 until the pool is prepared or if there is no cache
 #endif
 
     private:
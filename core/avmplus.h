@@ -132,6 +132,7 @@ namespace avmplus
     class UIntVectorObject;
     class ObjectVectorObject;
     class JSONClass;
+    class JitStackMap;
     class LinkObject;
     class MathClass;
     class MathUtils;
@@ -203,9 +203,11 @@ namespace avmplus
         REALLY_INLINE explicit TracedListData() {}
 		
 		// We want to allocate these in a separate partition for variable-sized buffer data.
+		// The buffer is only referenced from its TracedListHeader, which traces it exactly,
+		// and from the stack, so it is movable (see MMgc/GCCompactor.h).
 		REALLY_INLINE void *operator new(size_t size, MMgc::GC *gc, MMgc::GCExactFlag, size_t extra)
 		{
-			return gc->AllocExtraPtrZeroExact(size, extra, MMgc::kTracedListPartition);
+			return gc->AllocExtraPtrZeroExactMovable(size, extra, MMgc::kTracedListPartition);
 		}
 
 		virtual bool gcTrace(MMgc::GC* gc, size_t cursor);
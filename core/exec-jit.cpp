@@ -9,6 +9,8 @@
 
 #ifdef VMCFG_NANOJIT
 #include "CodegenLIR.h"
+#include "JitCompileQueue.h"
+#include "JitCodeCache.h"
 
 #ifdef VMCFG_SHARK
 #include <dlfcn.h> // dl apis for JITLoggingObserver
@@ -238,8 +240,45 @@ void BaseExecMgr::verifyJit(MethodInfo* m, MethodSignaturep ms,
     GprMethodProc code = jit.emitMD();
     if (code) {
         setJit(m, code);
-    } else if (config.jitordie) {
-        jit.~CodegenLIR(); // Explicit cleanup since destructor won't run otherwise.
+    } else {
+        if (config.jitordie)
+            jit.~CodegenLIR(); // Explicit cleanup since destructor won't run otherwise.
+        failJit(m, ms);
+    }
+}
+
+bool BaseExecMgr::verifyCachedJit(MethodInfo* m, MethodSignaturep ms,
+        Toplevel *toplevel, AbcEnv* abc_env)
+{
+    if (!isJitEnabled() || jit_observer || !jitCodeCache->isUsable() || !jitCodeCache->has(m))
+        return false;
+#ifdef VMCFG_COMPILEPOLICY
+    if (_ruleSet && ruleMatch(&_ruleSet->interp, m))
+        return false;
+#endif
+    CodeWriter coder;
+    verifyCommon(m, ms, toplevel, abc_env, &coder);
+    GprMethodProc code = jitCodeCache->load(m);
+    if (code) {
+#ifdef AVMPLUS_VERBOSE
+        if (m->pool()->isVerbose(VB_execpolicy))
+            core->console << "execpolicy jit-cached (" << m->unique_method_id() << ") " << m << "\n";
+#endif
+        setJit(m, code);
+    } else {
+        // The method has been verified already, interpret it.
+#ifdef AVMPLUS_VERBOSE
+        if (m->pool()->isVerbose(VB_execpolicy))
+            core->console << "execpolicy interp (" << m->unique_method_id() << ") " << m << " jit-cache-failed\n";
+#endif
+        setInterp(m, ms, OSR::isSupported(abc_env, m, ms));
+    }
+    return true;
+}
+
+void BaseExecMgr::failJit(MethodInfo* m, MethodSignaturep ms)
+{
+    if (config.jitordie) {
         Exception* e = new (core->GetGC())
                 Exception(core, core->newStringLatin1("JIT failed")->atom());
         e->flags |= Exception::EXIT_EXCEPTION;
@@ -260,6 +299,83 @@ void BaseExecMgr::verifyJit(MethodInfo* m, MethodSignaturep ms,
     }
 }
 
+bool BaseExecMgr::queueJit(MethodEnv* env)
+{
+    MethodInfo* m = env->method;
+    bool background = jitQueue != NULL && jit_observer == NULL;
+#if defined(VMCFG_HALFMOON) || defined(VMCFG_VTUNE)
+    // Both hook into the compilation on the main thread.
+    background = false;
+#endif
+#ifdef AVMPLUS_VERBOSE
+    // The jit listing goes to the console as the method is assembled.
+    if (m->pool()->isVerbose(VB_jit, m))
+        background = false;
+#endif
+    if (!background)
+        return false;
+
+    MethodSignaturep ms = m->getMethodSignature();
+    CodegenLIR* jit = mmfx_new(CodegenLIR(m, ms, env->toplevel(), NULL, jitQueue->noise()));
+    TRY(core, kCatchAction_Rethrow) {
+        verifyCommon(m, ms, env->toplevel(), env->abcEnv(), jit);
+    }
+    CATCH (Exception *exception) {
+        mmfx_delete(jit);
+        core->throwException(exception);
+    }
+    END_CATCH
+    END_TRY
+
+    jit->prepareAssembly();
+    uint32_t ahead = jitQueue->enqueue(m, jit, m->pool()->codeMgr);
+    m->setJitPending(true);
+    m->_abc.countdown = JitCompileQueue::kPollInterval;
+#ifdef AVMPLUS_VERBOSE
+    if (m->pool()->isVerbose(VB_execpolicy))
+        core->console << "execpolicy jit queued " << m << " ahead=" << ahead << "\n";
+#else
+    (void)ahead;
+#endif
+    return true;
+}
+
+void BaseExecMgr::installJit()
+{
+    if (jitQueue == NULL || !jitQueue->hasFinished())
+        return;
+
+    JitCompileQueue::Job* job;
+    while ((job = jitQueue->takeFinished()) != NULL) {
+        MethodInfo* m = job->method;
+        AvmAssert(m->isJitPending() && m->isInterpreted());
+        m->setJitPending(false);
+        GprMethodProc code = job->jit->finishAssembly();
+#ifdef AVMPLUS_VERBOSE
+        if (m->pool()->isVerbose(VB_execpolicy)) {
+            double microsPerTick = 1000000.0 / double(VMPI_getPerformanceFrequency());
+            uint64_t latency = job->finished - job->queued;
+            uint32_t n = jitQueue->installed() + 1;
+            core->console << "execpolicy jit background " << m
+                          << " latency=" << uint32_t(double(latency) * microsPerTick)
+                          << "us assembly=" << uint32_t(double(job->finished - job->started) * microsPerTick)
+                          << "us (" << n << " methods, average latency "
+                          << uint32_t(double(jitQueue->totalLatencyTicks() + latency) * microsPerTick / n)
+                          << "us)\n";
+        }
+#endif
+        jitQueue->release(job);
+        if (code) {
+            setJit(m, code);
+            // The MethodEnvs still call the counting trampolines; switch each
+            // over to the code at its next call.
+            m->_abc.countdown = 1;
+        } else {
+            failJit(m, m->getMethodSignature());
+        }
+    }
+}
+
 uintptr_t BaseExecMgr::initInterpGPR(MethodEnv* env, int argc, uint32_t* ap)
 {
     initObj(env, (ScriptObject*) atomPtr(((uintptr_t*)ap)[0]));
@@ -843,6 +959,18 @@ void BaseExecMgr::setupJit(AvmCore* core)
         jit_observer = new JITLoggingObserver(core, core->config.jitprof_level);
 #endif
 
+    // Without a thread, hot methods are compiled synchronously.
+    if (config.jitconfig.background_compile && config.runmode == RM_mixed && config.osr_enabled) {
+        jitQueue = mmfx_new(JitCompileQueue());
+        if (!jitQueue->start()) {
+            mmfx_delete(jitQueue);
+            jitQueue = NULL;
+        }
+    }
+
+    if (config.jitconfig.code_cache && JitCodeCache::isSupported())
+        jitCodeCache = mmfx_new(JitCodeCache(core, config.jitconfig.code_cache));
+
     (void)core;
 }
 
@@ -10,6 +10,7 @@
 #include "CodegenLIR.h"
 #include "FrameState.h"
 #include "exec-osr.h"
+#include "JitCompileQueue.h"
 
 /*
 
@@ -155,6 +156,14 @@ namespace avmplus
                       MethodSignaturep ms, const uint8_t* osr_pc, Atom* result)
     {
         BaseExecMgr* exec = BaseExecMgr::exec(env);
+        MethodInfo* m = env->method;
+        if (m->isJitPending() || !m->isInterpreted()) {
+            // The method is being compiled on the compiler thread, or has just
+            // been installed from there.  Keep interpreting this frame.
+            exec->installJit();
+            m->_abc.countdown = JitCompileQueue::kPollInterval;
+            return false;
+        }
         OSR osr(osr_pc, interp_frame);
 
 #ifdef AVMPLUS_VERBOSE
@@ -320,7 +329,16 @@ namespace avmplus
         MethodInfo* m = env->method;
         if (--m->_abc.countdown)
             return false;
-        if (m->isInterpreted()) {
+        if (m->isJitPending()) {
+            // Compiling on the compiler thread; see if it's done.
+            BaseExecMgr::exec(env)->installJit();
+            if (m->isJitPending()) {
+                m->_abc.countdown = JitCompileQueue::kPollInterval;
+                return false;
+            }
+            if (m->isInterpreted())
+                return false;   // the compilation failed
+        } else if (m->isInterpreted()) {
 #ifdef AVMPLUS_VERBOSE
             if (m->pool()->isVerbose(VB_execpolicy))
                 env->core()->console <<
@@ -328,6 +346,8 @@ namespace avmplus
 #endif
             AvmAssert(!m->hasFailedJit());
             BaseExecMgr* exec = BaseExecMgr::exec(env);
+            if (exec->queueJit(env))
+                return false;
             exec->verifyJit(m, m->getMethodSignature(),
                             env->toplevel(), env->abcEnv(), NULL);
             if (m->hasFailedJit())
@@ -6,12 +6,22 @@
 
 #include "avmplus.h"
 
+#ifdef VMCFG_NANOJIT
+#include "CodegenLIR.h"
+#include "JitCodeCache.h"
+#endif
+
 namespace avmplus {
 
 // Called after ABC is loaded before anything else happens.  We have a
 // chance here to kick off eager verification.
 void BaseExecMgr::notifyAbcPrepared(Toplevel* toplevel, AbcEnv* abcEnv)
 {
+#ifdef VMCFG_NANOJIT
+    // Once per pool: in verifyall mode the builtins are prepared twice.
+    if (jitCodeCache && abcEnv->pool()->codeCacheKey == 0)
+        jitCodeCache->addPool(abcEnv->pool());
+#endif
 #ifdef VMCFG_VERIFYALL
     if (config.verifyall) {
         PoolObject* pool = abcEnv->pool();
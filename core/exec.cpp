@@ -8,6 +8,12 @@
 #include "../vprof/vprof.h"
 #include "Interpreter.h"
 
+#ifdef VMCFG_NANOJIT
+#include "CodegenLIR.h"
+#include "JitCompileQueue.h"
+#include "JitCodeCache.h"
+#endif
+
 namespace avmplus {
 
 // Computes the size in bytes of an argument of type t, when passed
@@ -47,6 +53,8 @@ BaseExecMgr::BaseExecMgr(AvmCore* core)
     , current_osr(NULL)
     , jit_observer(NULL)
 	, noise(MMgc::GCHeap::secret)  // TODO: Generate this from a random number provider held by AvmCore
+    , jitQueue(NULL)
+    , jitCodeCache(NULL)
 #endif
 {
 #ifdef SUPERWORD_PROFILING
@@ -68,6 +76,10 @@ BaseExecMgr::~BaseExecMgr()
 #ifdef VMCFG_NANOJIT
     delete jit_observer;
     jit_observer = NULL;
+    mmfx_delete(jitQueue);
+    jitQueue = NULL;
+    mmfx_delete(jitCodeCache);
+    jitCodeCache = NULL;
 #endif
 }
 
@@ -292,6 +304,17 @@ void BaseExecMgr::setInterp(MethodInfo* m, MethodSignaturep ms, bool isOsr)
                              ms->returnTraitsBT() == BUILTIN_number ? 1 : 0);
         m->_implGPR = impl_stubs[osr][ctor][rtype];
 
+    #ifndef VMCFG_WORDCODE
+        // Profile the method until it is compiled.  The table lives as long as
+        // the pool, so that the code generated later can be specialized with it.
+        if (isOsr && config.jitconfig.type_feedback && !m->type_feedback()) {
+            uint32_t length = m->parse_code_length();
+            uint8_t* feedback = (uint8_t*) initCodeMgr(m->pool())->allocator.alloc(length);
+            VMPI_memset(feedback, 0, length);
+            m->set_type_feedback(feedback);
+        }
+    #endif
+
         // The countdown was previously set to config.osr_threshold, the
         // global default, and then possibly overridden by an explicit
         // ExecPolicy attribute.  If in fact OSR is not supported, zero
@@ -372,6 +395,9 @@ void BaseExecMgr::verifyMethod(MethodInfo* m, Toplevel *toplevel, AbcEnv* abc_en
     if (m->isNative())
         verifyNative(m, ms);
 #ifdef VMCFG_NANOJIT
+    else if (jitCodeCache && verifyCachedJit(m, ms, toplevel, abc_env)) {
+        // Installed the code saved by a previous run.
+    }
     else if (shouldJitFirst(abc_env, m, ms)) {
         verifyJit(m, ms, toplevel, abc_env, NULL);
     }
@@ -128,6 +128,9 @@ class MethodRecognizer;
 
 #ifdef VMCFG_NANOJIT
 
+class JitCompileQueue;
+class JitCodeCache;
+
 /**
  * Associates debugfile/debugline information with locations in JITted code
  */
@@ -388,9 +391,29 @@ private:
     void verifyJit(MethodInfo*, MethodSignaturep, Toplevel*, AbcEnv*,
                    OSR *osr_state);
 
+    /**
+     * Run the verifier and install the code of the method saved in the
+     * JitCodeCache by a previous run.  Returns false, before verifying, if
+     * there is no code to install.
+     */
+    bool verifyCachedJit(MethodInfo*, MethodSignaturep, Toplevel*, AbcEnv*);
+
     /** Install JIT code pointers and set MethodInfo::_isJitImpl. */
     void setJit(MethodInfo*, GprMethodProc p);
 
+    /** Handle a failed compilation: throw if jitordie, else interpret forever. */
+    void failJit(MethodInfo*, MethodSignaturep);
+
+    /**
+     * Verify the method with the JIT attached and queue its assembly on the
+     * compiler thread, leaving it interpreted meanwhile.  Returns false if the
+     * method should be compiled synchronously instead.
+     */
+    bool queueJit(MethodEnv*);
+
+    /** Install the code of the methods assembled by the compiler thread. */
+    void installJit();
+
     /**
      * Invoker called on the first invocation then calls invoke_generic,
      * installs jitInvokerNow yielding a 1-call delay before we try to
@@ -509,6 +532,8 @@ private:
     OSR *current_osr;
     JITObserver *jit_observer; // Current JITObserver or NULL if not profiling.
     JITNoise noise;  // Random number source for JIT hardening
+    JitCompileQueue* jitQueue; // Compiler thread, or NULL unless JitConfig::background_compile
+    JitCodeCache* jitCodeCache; // NULL unless JitConfig::code_cache
 #endif
 };
 
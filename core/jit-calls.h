@@ -35,12 +35,128 @@ namespace avmplus
     # define PROF_IF(label, expr) if (expr)
     #endif
 
+    // hits are only counted for the -Dverbose=jit statistics
+    #ifdef AVMPLUS_VERBOSE
+    # define COUNT_HIT(c) ((c).hits++, true)
+    #else
+    # define COUNT_HIT(c) true
+    #endif
+
     // if the cached obj was a ScriptObject, we have a hit when
     // the new object's tag is kObjectType and the cached vtable matches exactly
-    #define OBJ_HIT(obj, c)  (atomKind(obj) == kObjectType && atomObj(obj)->vtable == (c).vtable)
+    #define OBJ_HIT(obj, c)  (atomKind(obj) == kObjectType && atomObj(obj)->vtable == (c).vtable && COUNT_HIT(c))
 
     // if the cached obj was a primitive, we only need a matching atom tag for a hit
-    #define PRIM_HIT(val, c) (atomKind(val) == c.tag)
+    #define PRIM_HIT(val, c) (atomKind(val) == c.tag && COUNT_HIT(c))
+
+    // the BindingCache::key() a cache must have to hit on obj: its vtable if it
+    // is a ScriptObject, as in OBJ_HIT, else its tag, as in PRIM_HIT.
+    REALLY_INLINE uintptr_t cache_key(Atom obj)
+    {
+        return isObjectPtr(obj) ? uintptr_t(atomObj(obj)->vtable) : uintptr_t(atomKind(obj));
+    }
+
+    // the entry of a megamorphic table for a name and key
+    REALLY_INLINE uint32_t mega_index(const Multiname* name, uintptr_t key)
+    {
+        uintptr_t h = (uintptr_t(name) >> 3) ^ (key >> 3) ^ (key >> 11) ^ key;
+        return uint32_t(h) & (BindingCache::kMegaEntries - 1);
+    }
+
+    // the entry of polymorphic site c bound to obj, or NULL
+    template <class C>
+    REALLY_INLINE C* poly_lookup(C& c, Atom obj)
+    {
+        uintptr_t key = cache_key(obj);
+        for (uint32_t i = 0; i < BindingCache::kPolyEntries; i++) {
+            if (c.entries[i].key() == key)
+                return &c.entries[i];
+        }
+        return NULL;
+    }
+
+    // the entry of the megamorphic table bound to obj for megamorphic site c, or NULL
+    template <class C>
+    REALLY_INLINE C* mega_lookup(C& c, Atom obj, MethodEnv* env, C* CodeMgr::*table)
+    {
+        uintptr_t key = cache_key(obj);
+        C& e = (env->method->pool()->codeMgr->*table)[mega_index(c.name, key)];
+        return e.name == c.name && e.key() == key ? &e : NULL;
+    }
+
+#ifdef AVMPLUS_VERBOSE
+    void trace_transition(BindingCache& c, MethodEnv* env)
+    {
+        static const char* const kinds[] = { "call", "get", "set" };
+        MethodInfo* m = env->method;
+        if (m->pool()->isVerbose(VB_jit, m)) {
+            m->pool()->core->console << "binding cache " << kinds[c.kind] << " " << *c.name
+                << (c.state == BindingCache::kPolymorphic ? " polymorphic" : " megamorphic")
+                << " in " << m << " after " << c.misses << " misses\n";
+        }
+    }
+#endif
+
+    // The miss handlers' state machine, see BindingCache::State.  Binds the cache
+    // or entry to use for obj with bind(), updating c's state, and returns it.  The
+    // caller installs the handler for c's state.
+    template <class C>
+    C& cache_miss(C& c, Atom obj, MethodEnv* env, void (*bind)(C&, Atom, MethodEnv*), C* CodeMgr::*table)
+    {
+        AvmAssert(!AvmCore::isNullOrUndefined(obj));
+        uintptr_t key = cache_key(obj);
+        CodeMgr* mgr = env->method->pool()->codeMgr;
+        c.misses++;
+        switch (c.state) {
+        case BindingCache::kMonomorphic:
+            if (c.key() == 0 || c.key() == key) {
+                bind(c, obj, env);
+                return c;
+            }
+            // second type: the current binding becomes the first entry
+            c.entries = (C*) mgr->allocator.alloc(BindingCache::kPolyEntries * sizeof(C));
+            new (&c.entries[0]) C(c);
+            for (uint32_t i = 1; i < BindingCache::kPolyEntries; i++)
+                new (&c.entries[i]) C(c.name, NULL);
+            c.state = BindingCache::kPolymorphic;
+            c.transitions++;
+#ifdef AVMPLUS_VERBOSE
+            trace_transition(c, env);
+#endif
+            bind(c.entries[1], obj, env);
+            return c.entries[1];
+
+        case BindingCache::kPolymorphic:
+            for (uint32_t i = 0; i < BindingCache::kPolyEntries; i++) {
+                C& e = c.entries[i];
+                if (e.key() == 0 || e.key() == key) {
+                    bind(e, obj, env);
+                    return e;
+                }
+            }
+            c.state = BindingCache::kMegamorphic;
+            c.transitions++;
+#ifdef AVMPLUS_VERBOSE
+            trace_transition(c, env);
+#endif
+            // fall through
+
+        default: {
+            AvmAssert(c.state == BindingCache::kMegamorphic);
+            if (mgr->*table == NULL) {
+                C* t = (C*) mgr->allocator.alloc(BindingCache::kMegaEntries * sizeof(C));
+                for (uint32_t i = 0; i < BindingCache::kMegaEntries; i++)
+                    new (&t[i]) C(NULL, NULL);
+                mgr->*table = t;
+            }
+            // the entry may belong to another name, rebuild it for ours
+            C& e = (mgr->*table)[mega_index(c.name, key)];
+            new (&e) C(c.name, NULL);
+            bind(e, obj, env);
+            return e;
+        }
+        }
+    }
 
     REALLY_INLINE Atom invoke_cached_method(CallCache& c, Atom obj, int argc, Atom* args)
     {
@@ -155,12 +271,11 @@ namespace avmplus
         0                       // BKIND_GETSET (impossible on primitive)
     };
 
-    // cache handler when cache miss occurs:
+    // bind a cache to obj:
     //  - Look up the binding using the Multiname saved in the cache
     //  - save the object vtable (for ScriptObject*) or atom tag (all others)
     //  - pick a handler and save the MethodEnv* or slot_offset
-    //  - invoke the new handler, which WILL NOT miss on this first call
-    Atom callprop_miss(CallCache& c, Atom obj, int argc, Atom* args, MethodEnv* env)
+    void callprop_bind(CallCache& c, Atom obj, MethodEnv* env)
     {
         AssertNotNull(obj);
         Toplevel* toplevel = env->toplevel();
@@ -191,7 +306,37 @@ namespace avmplus
             c.tag = atomKind(obj);
             AvmAssert(c.tag != 0);
         }
-        return c.call_handler(c, obj, argc, args, env);
+    }
+
+    // polymorphic site: dispatch to the entry for obj
+    Atom callprop_poly(CallCache& c, Atom obj, int argc, Atom* args, MethodEnv* env)
+    {
+        CallCache* e = poly_lookup(c, obj);
+        PROF_IF ("callprop_poly hit", e != NULL && COUNT_HIT(c))
+            return e->call_handler(*e, obj, argc, args, env);
+        return callprop_miss(c, obj, argc, args, env);
+    }
+
+    // megamorphic site: dispatch to the entry of the CodeMgr's table for obj
+    Atom callprop_mega(CallCache& c, Atom obj, int argc, Atom* args, MethodEnv* env)
+    {
+        CallCache* e = mega_lookup(c, obj, env, &CodeMgr::megaCalls);
+        PROF_IF ("callprop_mega hit", e != NULL && COUNT_HIT(c))
+            return e->call_handler(*e, obj, argc, args, env);
+        return callprop_miss(c, obj, argc, args, env);
+    }
+
+    // cache handler when cache miss occurs: bind the cache, or an entry of
+    // a polymorphic or megamorphic site, then invoke the entry's new handler,
+    // which WILL NOT miss on this first call
+    Atom callprop_miss(CallCache& c, Atom obj, int argc, Atom* args, MethodEnv* env)
+    {
+        CallCache& e = cache_miss(c, obj, env, callprop_bind, &CodeMgr::megaCalls);
+        if (c.state == BindingCache::kPolymorphic)
+            c.call_handler = callprop_poly;
+        else if (c.state == BindingCache::kMegamorphic)
+            c.call_handler = callprop_mega;
+        return e.call_handler(e, obj, argc, args, env);
     }
     FUNCTION(CALL_INDIRECT, SIG6(A,P,P,A,I,P,P), call_cache_handler)
 
@@ -340,9 +485,9 @@ namespace avmplus
         0,                    // BKIND_GETSET (impossible on primitive)
     };
 
-    Atom getprop_miss(GetCache& c, MethodEnv* env, Atom obj)
+    // bind a cache to obj, like callprop_bind()
+    void getprop_bind(GetCache& c, Atom obj, MethodEnv* env)
     {
-        // cache handler when cache miss occurs
         AvmAssert(!AvmCore::isNullOrUndefined(obj));
         Toplevel* toplevel = env->toplevel();
         VTable* vtable = toplevel->toVTable(obj);
@@ -388,7 +533,35 @@ namespace avmplus
             c.tag = atomKind(obj);
             AvmAssert(c.tag != 0);
         }
-        return c.get_handler(c, env, obj);
+    }
+
+    // polymorphic site: dispatch to the entry for obj
+    Atom getprop_poly(GetCache& c, MethodEnv* env, Atom obj)
+    {
+        GetCache* e = poly_lookup(c, obj);
+        PROF_IF ("getprop_poly hit", e != NULL && COUNT_HIT(c))
+            return e->get_handler(*e, env, obj);
+        return getprop_miss(c, env, obj);
+    }
+
+    // megamorphic site: dispatch to the entry of the CodeMgr's table for obj
+    Atom getprop_mega(GetCache& c, MethodEnv* env, Atom obj)
+    {
+        GetCache* e = mega_lookup(c, obj, env, &CodeMgr::megaGets);
+        PROF_IF ("getprop_mega hit", e != NULL && COUNT_HIT(c))
+            return e->get_handler(*e, env, obj);
+        return getprop_miss(c, env, obj);
+    }
+
+    // cache handler when cache miss occurs, like callprop_miss()
+    Atom getprop_miss(GetCache& c, MethodEnv* env, Atom obj)
+    {
+        GetCache& e = cache_miss(c, obj, env, getprop_bind, &CodeMgr::megaGets);
+        if (c.state == BindingCache::kPolymorphic)
+            c.get_handler = getprop_poly;
+        else if (c.state == BindingCache::kMegamorphic)
+            c.get_handler = getprop_mega;
+        return e.get_handler(e, env, obj);
     }
     FUNCTION(CALL_INDIRECT, SIG4(A,P,P,P,A), get_cache_handler)
 
@@ -802,9 +975,9 @@ namespace avmplus
 #endif // VMCFG_FLOAT
     };
 
-    void setprop_miss(SetCache& c, Atom obj, Atom val, MethodEnv* env)
+    // bind a cache to obj, like callprop_bind()
+    void setprop_bind(SetCache& c, Atom obj, MethodEnv* env)
     {
-        // cache handler when cache miss occurs
         AvmAssert(!AvmCore::isNullOrUndefined(obj));
         Toplevel* toplevel = env->toplevel();
         VTable* vtable = toplevel->toVTable(obj);
@@ -844,8 +1017,42 @@ namespace avmplus
             // must be a primitive: int, bool, string, namespace, or number.
             // all paths lead to an error, so just use the generic handler.
             c.set_handler = &setprop_generic;
+            c.tag = atomKind(obj);
+            AvmAssert(c.tag != 0);
+        }
+    }
+
+    // polymorphic site: dispatch to the entry for obj
+    void setprop_poly(SetCache& c, Atom obj, Atom val, MethodEnv* env)
+    {
+        SetCache* e = poly_lookup(c, obj);
+        PROF_IF ("setprop_poly hit", e != NULL && COUNT_HIT(c)) {
+            e->set_handler(*e, obj, val, env);
+        } else {
+            setprop_miss(c, obj, val, env);
         }
-        c.set_handler(c, obj, val, env);
+    }
+
+    // megamorphic site: dispatch to the entry of the CodeMgr's table for obj
+    void setprop_mega(SetCache& c, Atom obj, Atom val, MethodEnv* env)
+    {
+        SetCache* e = mega_lookup(c, obj, env, &CodeMgr::megaSets);
+        PROF_IF ("setprop_mega hit", e != NULL && COUNT_HIT(c)) {
+            e->set_handler(*e, obj, val, env);
+        } else {
+            setprop_miss(c, obj, val, env);
+        }
+    }
+
+    // cache handler when cache miss occurs, like callprop_miss()
+    void setprop_miss(SetCache& c, Atom obj, Atom val, MethodEnv* env)
+    {
+        SetCache& e = cache_miss(c, obj, env, setprop_bind, &CodeMgr::megaSets);
+        if (c.state == BindingCache::kPolymorphic)
+            c.set_handler = setprop_poly;
+        else if (c.state == BindingCache::kMegamorphic)
+            c.set_handler = setprop_mega;
+        e.set_handler(e, obj, val, env);
     }
     FUNCTION(CALL_INDIRECT, SIG5(V,P,P,A,A,P), set_cache_handler)
 
@@ -57,6 +57,8 @@ avmplus_CXXSRCS := $(avmplus_CXXSRCS) \
   $(curdir)/IntClass.cpp \
   $(curdir)/Interpreter.cpp \
   $(curdir)/InvokerCompiler.cpp \
+  $(curdir)/JitCodeCache.cpp \
+  $(curdir)/JitCompileQueue.cpp \
   $(curdir)/JSONClass.cpp \
   $(curdir)/LirHelper.cpp \
   $(curdir)/MathClass.cpp \
@@ -1,4 +1,4 @@
-// Generated from ST_avmplus_basics.st, ST_avmplus_builtins.st, ST_avmplus_peephole.st, ST_avmplus_vector_accessors.st, ST_mmgc_543560.st, ST_mmgc_575631.st, ST_mmgc_580603.st, ST_mmgc_603411.st, ST_mmgc_637993.st, ST_mmgc_basics.st, ST_mmgc_dependent.st, ST_mmgc_exact.st, ST_mmgc_externalalloc.st, ST_mmgc_finalize_uninit.st, ST_mmgc_fixedmalloc_findbeginning.st, ST_mmgc_gcheap.st, ST_mmgc_gcoption.st, ST_mmgc_mmfx_array.st, ST_mmgc_threads.st, ST_mmgc_weakref.st, ST_nanojit_codealloc.st, ST_vmbase_concurrency.st, ST_vmbase_safepoints.st, ST_vmpi_threads.st, ST_workers_Buffer.st, ST_workers_NoSyncSingleItemBuffer.st, ST_workers_Promise.st
+// Generated from ST_avmplus_basics.st, ST_avmplus_builtins.st, ST_avmplus_peephole.st, ST_avmplus_vector_accessors.st, ST_mmgc_543560.st, ST_mmgc_575631.st, ST_mmgc_580603.st, ST_mmgc_603411.st, ST_mmgc_637993.st, ST_mmgc_allocsampler.st, ST_mmgc_asyncdecommit.st, ST_mmgc_basics.st, ST_mmgc_bgsweep.st, ST_mmgc_blockcache.st, ST_mmgc_compaction.st, ST_mmgc_conservativescan.st, ST_mmgc_dependent.st, ST_mmgc_exact.st, ST_mmgc_externalalloc.st, ST_mmgc_finalize_uninit.st, ST_mmgc_fixedmalloc_findbeginning.st, ST_mmgc_gcheap.st, ST_mmgc_gcoption.st, ST_mmgc_generational.st, ST_mmgc_grouphashtable.st, ST_mmgc_heapsnapshot.st, ST_mmgc_incweakrefs.st, ST_mmgc_mmfx_array.st, ST_mmgc_pacing.st, ST_mmgc_pagemap.st, ST_mmgc_parallelmark.st, ST_mmgc_reap.st, ST_mmgc_sizeclasses.st, ST_mmgc_stackframes.st, ST_mmgc_threads.st, ST_mmgc_tracelog.st, ST_mmgc_weakref.st, ST_nanojit_codealloc.st, ST_vmbase_concurrency.st, ST_vmbase_safepoints.st, ST_vmpi_threads.st, ST_workers_Buffer.st, ST_workers_NoSyncSingleItemBuffer.st, ST_workers_Promise.st
 // Generated from ST_avmplus_basics.st
 // -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
 // vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
@@ -1393,6 +1393,398 @@ void create_mmgc_bugzilla_637993(AvmCore* core) { new ST_mmgc_bugzilla_637993(co
 }
 #endif
 
+// Generated from ST_mmgc_allocsampler.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// The allocation sampler (GCConfig::allocationSampleInterval): sampled objects are
+// flagged, the samples of freed and unreachable objects are retired, and the
+// weighted samples estimate the allocation volume.  The GCs have no AvmCore, so
+// all samples are attributed to the native callers of the allocators.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_allocsampler {
+using namespace MMgc;
+
+class ST_mmgc_allocsampler : public Selftest {
+public:
+ST_mmgc_allocsampler(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+void test2();
+void test3();
+private:
+    MMgc::GC *gc;
+
+    // Creates 'gc' with a mean sampling interval of 'interval' bytes.
+    void newGC(uint32_t interval)
+    {
+        GCConfig config;
+        config.allocationSampleInterval = interval;
+        gc = new GC(GCHeap::GetGCHeap(), config);
+    }
+
+    // @return true if the object 'userptr' is flagged as sampled.
+    bool sampled(const void* userptr)
+    {
+        return (GC::GetGCBits(GetRealPointer(userptr)) & kSampled) != 0;
+    }
+
+    // @return the estimated number of live bytes, over all sites.
+    double liveBytes()
+    {
+        AllocationSampler* s = gc->m_allocationSampler;
+        double total = s->overflow.liveBytes;
+        for ( uint32_t i=0 ; i < AllocationSampler::kSiteTableSize ; i++ ) {
+            if (s->sites[i] != NULL)
+                total += s->sites[i]->liveBytes;
+        }
+        return total;
+    }
+
+    // @return the estimated number of allocated bytes, over all sites.
+    double allocBytes()
+    {
+        AllocationSampler* s = gc->m_allocationSampler;
+        double total = s->overflow.allocBytes;
+        for ( uint32_t i=0 ; i < AllocationSampler::kSiteTableSize ; i++ ) {
+            if (s->sites[i] != NULL)
+                total += s->sites[i]->allocBytes;
+        }
+        return total;
+    }
+
+};
+ST_mmgc_allocsampler::ST_mmgc_allocsampler(AvmCore* core)
+    : Selftest(core, "mmgc", "allocsampler", ST_mmgc_allocsampler::ST_names,ST_mmgc_allocsampler::ST_explicits)
+{}
+const char* ST_mmgc_allocsampler::ST_names[] = {"off","sampled","collected","estimate", NULL };
+const bool ST_mmgc_allocsampler::ST_explicits[] = {false,false,false,false, false };
+void ST_mmgc_allocsampler::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+case 2: test2(); return;
+case 3: test3(); return;
+}
+}
+void ST_mmgc_allocsampler::prologue() {
+    gc = NULL;
+
+}
+void ST_mmgc_allocsampler::epilogue() {
+    delete gc;
+
+}
+void ST_mmgc_allocsampler::test0() {
+{
+    newGC(0);
+    MMGC_GCENTER(gc);
+    void* p = gc->Alloc(64, GC::kZero, kAVMShellGCPartition);
+// line 72 "ST_mmgc_allocsampler.st"
+verifyPass(gc->m_allocationSampler == NULL, "gc->m_allocationSampler == NULL", __FILE__, __LINE__);
+// line 73 "ST_mmgc_allocsampler.st"
+verifyPass(!sampled(p), "!sampled(p)", __FILE__, __LINE__);
+// line 74 "ST_mmgc_allocsampler.st"
+verifyPass(gc->DumpAllocationProfile(), "gc->DumpAllocationProfile()", __FILE__, __LINE__);
+    delete gc;
+    gc = NULL;
+}
+
+}
+void ST_mmgc_allocsampler::test1() {
+{
+    // With a mean interval of one byte nearly every object is sampled.
+    newGC(1);
+    MMGC_GCENTER(gc);
+    AllocationSampler* s = gc->m_allocationSampler;
+// line 85 "ST_mmgc_allocsampler.st"
+verifyPass(s != NULL, "s != NULL", __FILE__, __LINE__);
+
+    const uint32_t kObjects = 100;
+    void* small[kObjects];
+    uint32_t flagged = 0;
+    for ( uint32_t i=0 ; i < kObjects ; i++ ) {
+        small[i] = gc->Alloc(64, GC::kZero, kAVMShellGCPartition);
+        if (sampled(small[i]))
+            flagged++;
+    }
+    void* large = gc->Alloc(100000, GC::kZero, kAVMShellGCPartition);
+// line 96 "ST_mmgc_allocsampler.st"
+verifyPass(flagged > kObjects * 9 / 10, "flagged > kObjects * 9 / 10", __FILE__, __LINE__);
+// line 97 "ST_mmgc_allocsampler.st"
+verifyPass(sampled(large), "sampled(large)", __FILE__, __LINE__);
+// line 98 "ST_mmgc_allocsampler.st"
+verifyPass(s->numSamples == uint64_t(flagged) + 1, "s->numSamples == uint64_t(flagged) + 1", __FILE__, __LINE__);
+// line 99 "ST_mmgc_allocsampler.st"
+verifyPass(s->samples.count() == flagged + 1, "s->samples.count() == flagged + 1", __FILE__, __LINE__);
+
+    // Freeing explicitly retires the samples the next time they are checked.
+    double live = liveBytes();
+    for ( uint32_t i=0 ; i < kObjects ; i++ )
+        gc->Free(small[i]);
+    gc->Free(large);
+    s->RetireDeadSamples(false);
+// line 107 "ST_mmgc_allocsampler.st"
+verifyPass(s->samples.count() == 0, "s->samples.count() == 0", __FILE__, __LINE__);
+// line 108 "ST_mmgc_allocsampler.st"
+verifyPass(liveBytes() < live / 1000, "liveBytes() < live / 1000", __FILE__, __LINE__);
+// line 109 "ST_mmgc_allocsampler.st"
+verifyPass(allocBytes() >= live, "allocBytes() >= live", __FILE__, __LINE__);
+    delete gc;
+    gc = NULL;
+}
+
+}
+void ST_mmgc_allocsampler::test2() {
+{
+    newGC(1);
+    MMGC_GCENTER(gc);
+    AllocationSampler* s = gc->m_allocationSampler;
+
+    // Unreachable objects are retired by the collection that finds them dead,
+    // the reachable one stays live.
+    const uint32_t kObjects = 1000;
+    for ( uint32_t i=0 ; i < kObjects ; i++ )
+        gc->Alloc(48, GC::kZero, kAVMShellGCPartition);
+    void* keeper[1];
+    keeper[0] = gc->Alloc(48, GC::kZero, kAVMShellGCPartition);
+    GCRoot* root = new GCRoot(gc, keeper, sizeof(keeper));
+    uint32_t before = s->samples.count();
+// line 129 "ST_mmgc_allocsampler.st"
+verifyPass(before > kObjects * 9 / 10, "before > kObjects * 9 / 10", __FILE__, __LINE__);
+
+    gc->Collect(false);
+// line 132 "ST_mmgc_allocsampler.st"
+verifyPass(s->samples.count() < before / 10, "s->samples.count() < before / 10", __FILE__, __LINE__);
+// line 133 "ST_mmgc_allocsampler.st"
+verifyPass(s->samples.get(keeper[0]) != NULL, "s->samples.get(keeper[0]) != NULL", __FILE__, __LINE__);
+// line 134 "ST_mmgc_allocsampler.st"
+verifyPass(sampled(keeper[0]), "sampled(keeper[0])", __FILE__, __LINE__);
+
+    delete root;
+    delete gc;
+    gc = NULL;
+}
+
+}
+void ST_mmgc_allocsampler::test3() {
+{
+    // The weighted samples estimate the number of bytes allocated.
+    newGC(4096);
+    MMGC_GCENTER(gc);
+    const uint32_t kBytes = 16*1024*1024;
+    uint32_t allocated = 0;
+    for ( uint32_t size=16 ; allocated < kBytes ; size = size < 2048 ? size * 2 : 16 ) {
+        allocated += uint32_t(GC::Size(gc->Alloc(size, GC::kZero, kAVMShellGCPartition)));
+        allocated += uint32_t(GC::Size(gc->Alloc(size, GC::kZero, kAVMShellGCPartition)));
+    }
+    double estimate = allocBytes();
+// line 153 "ST_mmgc_allocsampler.st"
+verifyPass(gc->m_allocationSampler->numSamples > 1000, "gc->m_allocationSampler->numSamples > 1000", __FILE__, __LINE__);
+// line 154 "ST_mmgc_allocsampler.st"
+verifyPass(estimate > allocated * 0.75 && estimate < allocated * 1.33, "estimate > allocated * 0.75 && estimate < allocated * 1.33", __FILE__, __LINE__);
+// line 155 "ST_mmgc_allocsampler.st"
+verifyPass(gc->DumpAllocationProfile("/dev/null"), "gc->DumpAllocationProfile(\"/dev/null\")", __FILE__, __LINE__);
+    delete gc;
+    gc = NULL;
+}
+
+}
+void create_mmgc_allocsampler(AvmCore* core) { new ST_mmgc_allocsampler(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_asyncdecommit.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// GCHeap::Decommit with GCHeapConfig::asyncDecommit and decommitHysteresis: the heap
+// size drops when Decommit returns, the releaser puts the blocks back on the free
+// lists where they can be allocated again, and with hysteresis only the memory that
+// stayed free over the required number of calls is decommitted.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_asyncdecommit {
+using namespace MMgc;
+
+class ST_mmgc_asyncdecommit : public Selftest {
+public:
+ST_mmgc_asyncdecommit(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+private:
+    static const int kNumChunks = 64;
+    static const size_t kChunkBlocks = 128;
+
+    GCHeap* heap;
+    bool savedAsyncDecommit;
+    uint32_t savedHysteresis;
+    void* chunks[kNumChunks];
+
+    GCHeap::Partition* partition()
+    {
+        return heap->GetPartition(MMgc::kAVMShellHeapPartition);
+    }
+
+    // Allocate and fill chunks [from,to).
+    void grow(int from, int to)
+    {
+        for ( int i=from ; i < to ; i++ ) {
+            chunks[i] = partition()->Alloc(kChunkBlocks);
+            VMPI_memset(chunks[i], i, kChunkBlocks * GCHeap::kBlockSize);
+        }
+    }
+
+    // Free chunks [from,to).
+    void shrink(int from, int to)
+    {
+        for ( int i=from ; i < to ; i++ ) {
+            partition()->Free(chunks[i]);
+            chunks[i] = NULL;
+        }
+    }
+
+    // What Decommit would decommit right now without hysteresis, ignoring the
+    // limits.
+    size_t excess()
+    {
+        size_t heapSize = heap->GetTotalHeapSize();
+        size_t freeSize = heap->GetFreeHeapSize();
+        size_t size = (freeSize * 100 - heapSize * GCHeap::kDecommitThresholdPercentage) / 100;
+        return size < GCHeap::kMinHeapIncrement ? GCHeap::kMinHeapIncrement : size;
+    }
+
+};
+ST_mmgc_asyncdecommit::ST_mmgc_asyncdecommit(AvmCore* core)
+    : Selftest(core, "mmgc", "asyncdecommit", ST_mmgc_asyncdecommit::ST_names,ST_mmgc_asyncdecommit::ST_explicits)
+{}
+const char* ST_mmgc_asyncdecommit::ST_names[] = {"async","hysteresis", NULL };
+const bool ST_mmgc_asyncdecommit::ST_explicits[] = {false,false, false };
+void ST_mmgc_asyncdecommit::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+}
+}
+void ST_mmgc_asyncdecommit::prologue() {
+    heap = GCHeap::GetGCHeap();
+    savedAsyncDecommit = heap->config.asyncDecommit;
+    savedHysteresis = heap->config.decommitHysteresis;
+    VMPI_memset(chunks, 0, sizeof(chunks));
+
+}
+void ST_mmgc_asyncdecommit::epilogue() {
+    if (heap->releaser != NULL)
+        heap->releaser->Flush();
+    heap->config.asyncDecommit = savedAsyncDecommit;
+    heap->config.decommitHysteresis = savedHysteresis;
+
+}
+void ST_mmgc_asyncdecommit::test0() {
+{
+    heap->config.asyncDecommit = true;
+    heap->config.decommitHysteresis = 0;
+
+    grow(0, kNumChunks);
+    shrink(0, kNumChunks);
+// line 81 "ST_mmgc_asyncdecommit.st"
+verifyPass(heap->FreeMemoryExceedsDecommitThreshold(), "heap->FreeMemoryExceedsDecommitThreshold()", __FILE__, __LINE__);
+
+    size_t before = heap->GetTotalHeapSize();
+    heap->Decommit();
+// line 85 "ST_mmgc_asyncdecommit.st"
+verifyPass(heap->releaser != NULL, "heap->releaser != NULL", __FILE__, __LINE__);
+    size_t after = heap->GetTotalHeapSize();
+// line 87 "ST_mmgc_asyncdecommit.st"
+verifyPass(after < before, "after < before", __FILE__, __LINE__);
+
+    uint32_t batches = heap->releaser->m_batches;
+    uint64_t done = heap->releaser->m_blocksDecommitted + heap->releaser->m_blocksReleased;
+    heap->releaser->Flush();
+// line 92 "ST_mmgc_asyncdecommit.st"
+verifyPass(heap->releaser->m_batches > batches, "heap->releaser->m_batches > batches", __FILE__, __LINE__);
+// line 93 "ST_mmgc_asyncdecommit.st"
+verifyPass(heap->releaser->m_blocksDecommitted + heap->releaser->m_blocksReleased - done >= before - after, "heap->releaser->m_blocksDecommitted + heap->releaser->m_blocksReleased - done >= before - after", __FILE__, __LINE__);
+// line 94 "ST_mmgc_asyncdecommit.st"
+verifyPass(heap->GetTotalHeapSize() == after, "heap->GetTotalHeapSize() == after", __FILE__, __LINE__);
+
+    // The decommitted blocks are on the free lists again, and can be committed
+    // and used.
+    grow(0, kNumChunks);
+    bool ok = true;
+    for ( int i=0 ; i < kNumChunks ; i++ )
+        ok = ok && ((uint8_t*)chunks[i])[kChunkBlocks * GCHeap::kBlockSize - 1] == uint8_t(i);
+// line 102 "ST_mmgc_asyncdecommit.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+    shrink(0, kNumChunks);
+}
+
+}
+void ST_mmgc_asyncdecommit::test1() {
+{
+    heap->config.asyncDecommit = false;
+    heap->config.decommitHysteresis = 2;
+    heap->decommitStreak = 0;
+
+    grow(0, kNumChunks);
+    shrink(0, kNumChunks);
+    size_t before = heap->GetTotalHeapSize();
+    heap->Decommit();
+// line 116 "ST_mmgc_asyncdecommit.st"
+verifyPass(heap->GetTotalHeapSize() == before, "heap->GetTotalHeapSize() == before", __FILE__, __LINE__);
+
+    // Use half of the memory again for the second call, so that less of it is
+    // free than for the first.
+    grow(0, kNumChunks/2);
+    size_t least = excess();
+    heap->Decommit();
+// line 123 "ST_mmgc_asyncdecommit.st"
+verifyPass(heap->GetTotalHeapSize() == before, "heap->GetTotalHeapSize() == before", __FILE__, __LINE__);
+    shrink(0, kNumChunks/2);
+
+    // The third call decommits, but only what was free for all three.
+    heap->Decommit();
+    size_t after = heap->GetTotalHeapSize();
+// line 129 "ST_mmgc_asyncdecommit.st"
+verifyPass(after < before, "after < before", __FILE__, __LINE__);
+// line 130 "ST_mmgc_asyncdecommit.st"
+verifyPass(before - after <= least, "before - after <= least", __FILE__, __LINE__);
+// line 131 "ST_mmgc_asyncdecommit.st"
+verifyPass(heap->decommitStreak == 0, "heap->decommitStreak == 0", __FILE__, __LINE__);
+}
+
+}
+void create_mmgc_asyncdecommit(AvmCore* core) { new ST_mmgc_asyncdecommit(core); }
+}
+}
+#endif
+
 // Generated from ST_mmgc_basics.st
 // -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
 // vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
@@ -1938,7 +2330,7 @@ void create_mmgc_basics(AvmCore* core) { new ST_mmgc_basics(core); }
 }
 #endif
 
-// Generated from ST_mmgc_dependent.st
+// Generated from ST_mmgc_bgsweep.st
 // -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
 // vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
 //
@@ -1946,39 +2338,36 @@ void create_mmgc_basics(AvmCore* core) { new ST_mmgc_basics(core); }
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-// Bugzilla 543560 - here we risk deleting an object that is still on the mark stack because
-// of how we perform large-object splitting.  The setup is that user code that deletes the object
-// gets to run after the first part of the large object has been popped off the mark stack
-// but before the rest has been handled.
+// Background sweeping (GCConfig::backgroundSweep): live objects in blocks that are
+// queued for the sweeper must be left alone, and the mutator must be able to
+// allocate, free, and create weak references in those blocks while the sweeper runs.
 
 #include "avmshell.h"
 #ifdef VMCFG_SELFTEST
 namespace avmplus {
-namespace ST_mmgc_dependent {
+namespace ST_mmgc_bgsweep {
 using namespace MMgc;
 
-static const size_t nbytes = 16*1024*1024;
-
-class DependentAllocHolder : public GCFinalizedObject {
-public:
+// The first word of a small object is overwritten when it is freed, so the key
+// is stored in the words after it.
+static const int kObjectWords = 4;
 
-  DependentAllocHolder() {
-    memory = (char*)FixedMalloc::GetFixedMalloc(MMgc::kAVMShellFixedPartition)->Alloc(nbytes);
-    GC::GetGC(this)->SignalDependentAllocation(nbytes);
-  }
+static uintptr_t* makeObject(GC* gc, uintptr_t key)
+{
+    uintptr_t* p = (uintptr_t*)gc->Alloc(kObjectWords * sizeof(uintptr_t), GC::kContainsPointers|GC::kZero, kAVMShellGCPartition);
+    p[2] = key;
+    p[3] = ~key;
+    return p;
+}
 
-  virtual ~DependentAllocHolder() {
-    FixedMalloc::GetFixedMalloc(MMgc::kAVMShellFixedPartition)->Free(memory);
-    memory = NULL;
-    GC::GetGC(this)->SignalDependentDeallocation(nbytes);
-  }
-  private:
-    char* memory;
-};
+static bool checkObject(uintptr_t* p, uintptr_t key)
+{
+    return p[2] == key && p[3] == ~key;
+}
 
-class ST_mmgc_dependent : public Selftest {
+class ST_mmgc_bgsweep : public Selftest {
 public:
-ST_mmgc_dependent(AvmCore* core);
+ST_mmgc_bgsweep(AvmCore* core);
 virtual void run(int n);
 virtual void prologue();
 virtual void epilogue();
@@ -1987,138 +2376,157 @@ static const char* ST_names[];
 static const bool ST_explicits[];
 void test0();
 void test1();
-void test2();
 private:
     MMgc::GC *gc;
 
+    // A full collection without GC::Collect's eager sweep, which would leave
+    // nothing for the background sweeper.
+    void collect()
+    {
+        if (!gc->marking)
+            gc->StartIncrementalMark();
+        if (gc->marking)
+            gc->FinishIncrementalMark(true);
+    }
+
+    // Wait until the background sweeper is done with the blocks it was given.
+    void waitForSweeper()
+    {
+        GCBackgroundSweeper* sweeper = gc->m_backgroundSweeper;
+        SCOPE_LOCK_NO_SP_NAMED(locker, sweeper->m_monitor) {
+            while (sweeper->m_busy)
+                locker.wait();
+        }
+    }
+
 };
-ST_mmgc_dependent::ST_mmgc_dependent(AvmCore* core)
-    : Selftest(core, "mmgc", "dependent", ST_mmgc_dependent::ST_names,ST_mmgc_dependent::ST_explicits)
+ST_mmgc_bgsweep::ST_mmgc_bgsweep(AvmCore* core)
+    : Selftest(core, "mmgc", "bgsweep", ST_mmgc_bgsweep::ST_names,ST_mmgc_bgsweep::ST_explicits)
 {}
-const char* ST_mmgc_dependent::ST_names[] = {"dependent_alloc","dependent_memory_total","dependent_memory_unknown", NULL };
-const bool ST_mmgc_dependent::ST_explicits[] = {false,false,false, false };
-void ST_mmgc_dependent::run(int n) {
+const char* ST_mmgc_bgsweep::ST_names[] = {"interleaved","sweptBlocks", NULL };
+const bool ST_mmgc_bgsweep::ST_explicits[] = {false,false, false };
+void ST_mmgc_bgsweep::run(int n) {
 switch(n) {
 case 0: test0(); return;
 case 1: test1(); return;
-case 2: test2(); return;
 }
 }
-void ST_mmgc_dependent::prologue() {
+void ST_mmgc_bgsweep::prologue() {
     GCConfig config;
+    config.backgroundSweep = true;
     gc = new GC(GCHeap::GetGCHeap(), config);
 
 }
-void ST_mmgc_dependent::epilogue() {
+void ST_mmgc_bgsweep::epilogue() {
     delete gc;
 
 }
-void ST_mmgc_dependent::test0() {
-    size_t maxheap = 0;
-    {
-        MMGC_GCENTER(gc);
+void ST_mmgc_bgsweep::test0() {
+{
+    MMGC_GCENTER(gc);
 
-        int count = 100;
-        for (int c=0; c<count; c++) {
-            (void)(new (gc) DependentAllocHolder());
-            size_t heapsize = gc->policy.blocksOwnedByGC() * GCHeap::kBlockSize;
-            // printf("%lu\n", (unsigned long)heapsize);
-            if (heapsize > maxheap)
-                maxheap = heapsize;
+    // Every other object is garbage, so every block ends up on a sweep list with
+    // live and dead objects in it.
+
+    const int nobjs = 20000;
+    uintptr_t** objs = (uintptr_t**)gc->Alloc(nobjs * sizeof(uintptr_t*), GC::kContainsPointers|GC::kZero, kAVMShellGCPartition);
+    GCWeakRef* refs[nobjs/100];
+
+    bool ok = true;
+    for ( int round=0 ; round < 4 ; round++ ) {
+        for ( int i=0 ; i < nobjs ; i++ ) {
+            uintptr_t* p = makeObject(gc, uintptr_t(round*nobjs + i));
+            if (i % 2 == 0)
+                objs[i] = p;
         }
-    }
 
-    // This is tricky to get right but for this test the 16MB blocks will dominate
-    // completely.  So assume that heap size must stay below L*2*16MB for the
-    // L that applies at 32MB.
+        collect();
 
-// line 68 "ST_mmgc_dependent.st"
-verifyPass(size_t(gc->policy.queryLoadForHeapsize(double(2*nbytes)) * 2.0 * double(nbytes)) >= maxheap, "size_t(gc->policy.queryLoadForHeapsize(double(2*nbytes)) * 2.0 * double(nbytes)) >= maxheap", __FILE__, __LINE__);
+        // Right after the collection most blocks are still queued.  Take weak
+        // references to some survivors and free others explicitly.
 
-}
-void ST_mmgc_dependent::test1() {
-#if defined VMCFG_TELEMETRY && defined AVMSHELL_BUILD
-    size_t depMem_start,depMem_end;
-    depMem_start = depMem_end = 0;
-    MMgc::GC* gc = core->gc;
+        for ( int i=0 ; i < nobjs/100 ; i++ )
+            refs[i] = GC::GetWeakRef(objs[i*100]);
+        for ( int i=2 ; i < nobjs ; i+=100 ) {
+            gc->Free(objs[i]);
+            objs[i] = NULL;
+        }
 
-    // Check total dependent memory consistency
-    for(int i = 0; i < MMgc::typeCount; i++)
-        depMem_start += gc->getDependentMemory((MMgc::DependentMemoryType)i);
-// line 79 "ST_mmgc_dependent.st"
-verifyPass(depMem_start == gc->policy.dependentAllocation, "depMem_start == gc->policy.dependentAllocation", __FILE__, __LINE__);
+        // Allocating sweeps blocks or picks up blocks the sweeper has swept.
 
-    // Check byteArray type dependent memory
-    avmshell::ShellCore* c = (avmshell::ShellCore*)core;
-    avmshell::ShellToplevel* top = c->shell_toplevel;
+        for ( int i=1 ; i < nobjs ; i+=2 )
+            objs[i] = makeObject(gc, uintptr_t(round*nobjs + i));
 
-    size_t byteArray_bytes1 = gc->getDependentMemory(MMgc::typeByteArray);
-    ByteArrayObject* byteArray = top->byteArrayClass()->constructByteArray();
-    byteArray->writeBoolean(false);
-    byteArray->writeDouble(3.14);
+        for ( int i=0 ; i < nobjs ; i++ )
+            if (objs[i] != NULL && !checkObject(objs[i], uintptr_t(round*nobjs + i)))
+                ok = false;
+        for ( int i=0 ; i < nobjs/100 ; i++ )
+            if ((void*)refs[i]->get() != (void*)objs[i*100])
+                ok = false;
 
-    // Allocate known type dependent memory
-    size_t byteArray_bytes2 = gc->getDependentMemory(MMgc::typeByteArray);
-// line 92 "ST_mmgc_dependent.st"
-verifyPass(byteArray_bytes2 > byteArray_bytes1, "byteArray_bytes2 > byteArray_bytes1", __FILE__, __LINE__);
+        VMPI_memset(objs, 0, nobjs * sizeof(uintptr_t*));
+    }
+// line 112 "ST_mmgc_bgsweep.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
 
-    // Allocate unknown dependent memory
-    DependentAllocHolder* obj = new (gc) DependentAllocHolder();
+    VMPI_memset(refs, 0, sizeof(refs));
+    gc->Free(objs);
+}
 
-    size_t byteArray_bytes3 = gc->getDependentMemory(MMgc::typeByteArray);
-// line 98 "ST_mmgc_dependent.st"
-verifyPass(byteArray_bytes3 == byteArray_bytes2, "byteArray_bytes3 == byteArray_bytes2", __FILE__, __LINE__);
-    byteArray->clear();
- 
-// line 101 "ST_mmgc_dependent.st"
-verifyPass(gc->getDependentMemory(MMgc::typeByteArray) == byteArray_bytes1, "gc->getDependentMemory(MMgc::typeByteArray) == byteArray_bytes1", __FILE__, __LINE__);
-    delete obj;
+}
+void ST_mmgc_bgsweep::test1() {
+{
+    MMGC_GCENTER(gc);
 
-    // Consistency check
-    for(int i = 0; i < MMgc::typeCount; i++)
-        depMem_end += gc->getDependentMemory((MMgc::DependentMemoryType)i);
-// line 107 "ST_mmgc_dependent.st"
-verifyPass(depMem_end == gc->policy.dependentAllocation, "depMem_end == gc->policy.dependentAllocation", __FILE__, __LINE__);
-// line 108 "ST_mmgc_dependent.st"
-verifyPass(depMem_end == depMem_start, "depMem_end == depMem_start", __FILE__, __LINE__);
+    // Let the sweeper sweep every block, then free an object in one block and
+    // take a weak reference to an object in another.  Taking those blocks back
+    // from the sweeper must not sweep them again: the survivors' mark bits have
+    // been cleared, so they would all be freed.
+
+    const int nobjs = 2000;
+    uintptr_t** objs = (uintptr_t**)gc->Alloc(nobjs * sizeof(uintptr_t*), GC::kContainsPointers|GC::kZero, kAVMShellGCPartition);
+    for ( int i=0 ; i < nobjs ; i++ ) {
+        uintptr_t* p = makeObject(gc, uintptr_t(i));
+        if (i % 2 == 0)
+            objs[i] = p;
+    }
 
-#if !defined DEBUG && !defined DEBUGGER
-    // Get memory for out of bounds type
-    // getDependentMemory has assert; skip in debug build
-// line 113 "ST_mmgc_dependent.st"
-verifyPass(gc->getDependentMemory(MMgc::typeCount) == 0, "gc->getDependentMemory(MMgc::typeCount) == 0", __FILE__, __LINE__);
-#endif
-// line 115 "ST_mmgc_dependent.st"
-verifyPass(true, "true", __FILE__, __LINE__);
-#endif
+    collect();
+    waitForSweeper();
 
-}
-void ST_mmgc_dependent::test2() {
-#if defined VMCFG_TELEMETRY && defined AVMSHELL_BUILD
-    // Check unknown type dependent memory
-    MMgc::GC* gc = core->gc;
-    size_t unknownDependentMem_start = gc->getDependentMemory(MMgc::typeUnknown);
-    DependentAllocHolder* obj = new (gc) DependentAllocHolder();
-    size_t unknownDependentMem_end = gc->getDependentMemory(MMgc::typeUnknown);
-// line 125 "ST_mmgc_dependent.st"
-verifyPass((unknownDependentMem_end - unknownDependentMem_start) == nbytes, "(unknownDependentMem_end - unknownDependentMem_start) == nbytes", __FILE__, __LINE__);
-    
-    delete obj;
-// line 128 "ST_mmgc_dependent.st"
-verifyPass(unknownDependentMem_start == gc->getDependentMemory(MMgc::typeUnknown), "unknownDependentMem_start == gc->getDependentMemory(MMgc::typeUnknown)", __FILE__, __LINE__);
-#else
-// line 130 "ST_mmgc_dependent.st"
-verifyPass(true, "true", __FILE__, __LINE__);
-#endif
+    gc->Free(objs[0]);
+    objs[0] = NULL;
+    GCWeakRef* ref = GC::GetWeakRef(objs[nobjs/2]);
+
+    // Allocating sweeps the blocks that are still on the sweep lists.
+
+    for ( int i=1 ; i < nobjs ; i+=2 )
+        objs[i] = makeObject(gc, uintptr_t(i));
+
+    // Small objects on a free list have both kMark and kQueued set.
+    bool ok = true;
+    for ( int i=0 ; i < nobjs ; i++ ) {
+        if (objs[i] == NULL)
+            continue;
+        if ((GC::GetGCBits(GetRealPointer(objs[i])) & (kMark|kQueued)) == (kMark|kQueued) || !checkObject(objs[i], uintptr_t(i)))
+            ok = false;
+    }
+// line 155 "ST_mmgc_bgsweep.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+// line 156 "ST_mmgc_bgsweep.st"
+verifyPass((void*)ref->get() == (void*)objs[nobjs/2], "(void*)ref->get() == (void*)objs[nobjs/2]", __FILE__, __LINE__);
 
+    ref = NULL;
+    gc->Free(objs);
+}
 
 }
-void create_mmgc_dependent(AvmCore* core) { new ST_mmgc_dependent(core); }
+void create_mmgc_bgsweep(AvmCore* core) { new ST_mmgc_bgsweep(core); }
 }
 }
 #endif
 
-// Generated from ST_mmgc_exact.st
+// Generated from ST_mmgc_blockcache.st
 // -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
 // vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
 //
@@ -2126,101 +2534,179 @@ void create_mmgc_dependent(AvmCore* core) { new ST_mmgc_dependent(core); }
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+// The GC's block cache (GC::AllocBlock, GC::FreeBlock) and the batched block
+// operations in GCHeap::Partition that it refills and drains it with.
+
 #include "avmshell.h"
 #ifdef VMCFG_SELFTEST
 namespace avmplus {
-namespace ST_mmgc_exact {
-
-class Cthulhu : public MMgc::GCTraceableObject
-{
-public:
-    static Cthulhu* create(MMgc::GC* gc) {
-        return new (gc, MMgc::kExact) Cthulhu();
-    }
+namespace ST_mmgc_blockcache {
+using namespace MMgc;
 
-    virtual bool gcTrace(MMgc::GC* gc, size_t cursor) {
-        (void)gc;
-        // Incorrectly say that there's more to do even when the object is small
-        if (cursor == 0)
-            return true;
-        // Concede
-        return false;
-    }
-};
+// More blocks than the cache holds, so that the tests go through refills and
+// returns.
+static const int kNumBlocks = 50;
 
-// This test triggers a particular edge case in GC::SplitExactGCObject where
-// a small object that returns 'true' from its gcTrace method is synchronously
-// marked until the method returns 'false'; a 'true' return is only ever expected
-// from the gcTrace methods of large objects.
+static bool isZero(void* block)
+{
+    for ( size_t i=0 ; i < GCHeap::kBlockSize / sizeof(uintptr_t) ; i++ )
+        if (((uintptr_t*)block)[i] != 0)
+            return false;
+    return true;
+}
 
-class ST_mmgc_exact : public Selftest {
+class ST_mmgc_blockcache : public Selftest {
 public:
-ST_mmgc_exact(AvmCore* core);
+ST_mmgc_blockcache(AvmCore* core);
 virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
 private:
 static const char* ST_names[];
 static const bool ST_explicits[];
 void test0();
+void test1();
+private:
+    MMgc::GC *gc;
+
 };
-ST_mmgc_exact::ST_mmgc_exact(AvmCore* core)
-    : Selftest(core, "mmgc", "exact", ST_mmgc_exact::ST_names,ST_mmgc_exact::ST_explicits)
+ST_mmgc_blockcache::ST_mmgc_blockcache(AvmCore* core)
+    : Selftest(core, "mmgc", "blockcache", ST_mmgc_blockcache::ST_names,ST_mmgc_blockcache::ST_explicits)
 {}
-const char* ST_mmgc_exact::ST_names[] = {"IncorrectlySplitSmallObject", NULL };
-const bool ST_mmgc_exact::ST_explicits[] = {false, false };
-void ST_mmgc_exact::run(int n) {
+const char* ST_mmgc_blockcache::ST_names[] = {"batch","reuse", NULL };
+const bool ST_mmgc_blockcache::ST_explicits[] = {false,false, false };
+void ST_mmgc_blockcache::run(int n) {
 switch(n) {
 case 0: test0(); return;
+case 1: test1(); return;
 }
 }
-void ST_mmgc_exact::test0() {
-    // Create an object that stays alive so that its tracer will be called
-    MMgc::GCObjectLock* lock = core->gc->LockObject(Cthulhu::create(core->gc));
-    core->gc->Collect();
-    core->gc->Collect();
-    core->gc->UnlockObject(lock);
+void ST_mmgc_blockcache::prologue() {
+    GCConfig config;
+    gc = new GC(GCHeap::GetGCHeap(), config);
 
-// line 42 "ST_mmgc_exact.st"
-verifyPass(true, "true", __FILE__, __LINE__);
+}
+void ST_mmgc_blockcache::epilogue() {
+    delete gc;
 
+}
+void ST_mmgc_blockcache::test0() {
+{
+    GCHeap::Partition* partition = GCHeap::GetGCHeap()->GetPartition(kAVMShellGCPartition);
+    void* items[kNumBlocks];
+
+    size_t n = partition->AllocBlocks(items, kNumBlocks);
+// line 46 "ST_mmgc_blockcache.st"
+verifyPass(n == size_t(kNumBlocks), "n == size_t(kNumBlocks)", __FILE__, __LINE__);
+
+    bool ok = true;
+    for ( size_t i=0 ; i < n ; i++ ) {
+        void* block = (void*)(uintptr_t(items[i]) & ~uintptr_t(1));
+        if ((uintptr_t(block) & GCHeap::kOffsetMask) != 0 || partition->Size(block) != 1)
+            ok = false;
+        if ((uintptr_t(items[i]) & 1) != 0 && !isZero(block))
+            ok = false;
+        items[i] = block;
+    }
+// line 57 "ST_mmgc_blockcache.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
 
+    partition->FreeBlocks(items, n);
 }
-void create_mmgc_exact(AvmCore* core) { new ST_mmgc_exact(core); }
+
+}
+void ST_mmgc_blockcache::test1() {
+{
+    MMGC_GCENTER(gc);
+
+    void* blocks[kNumBlocks];
+    bool ok = true;
+    for ( int round=0 ; round < 3 ; round++ ) {
+        for ( int i=0 ; i < kNumBlocks ; i++ ) {
+            blocks[i] = gc->AllocBlock(1, kAVMShellGCPartition, PageMap::kGCAllocPage);
+            if (!isZero(blocks[i]) || !gc->IsPointerToGCPage(blocks[i]))
+                ok = false;
+            for ( int j=0 ; j < i ; j++ )
+                if (blocks[j] == blocks[i])
+                    ok = false;
+            VMPI_memset(blocks[i], 0xAB, GCHeap::kBlockSize);
+        }
+        for ( int i=0 ; i < kNumBlocks ; i++ ) {
+            gc->FreeBlock(blocks[i], 1, kAVMShellGCPartition);
+            if (gc->IsPointerToGCPage(blocks[i]))
+                ok = false;
+        }
+    }
+// line 84 "ST_mmgc_blockcache.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+}
+
+}
+void create_mmgc_blockcache(AvmCore* core) { new ST_mmgc_blockcache(core); }
 }
 }
 #endif
 
-// Generated from ST_mmgc_externalalloc.st
-// -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+// Generated from ST_mmgc_compaction.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
 //
 // This Source Code Form is subject to the terms of the Mozilla Public
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+// Compaction (GCConfig::compaction): the live objects in sparse blocks of movable
+// objects must be moved, the references to them from exactly traced fields and
+// roots must follow them, and the emptied blocks must be returned.
+
 #include "avmshell.h"
 #ifdef VMCFG_SELFTEST
 namespace avmplus {
-namespace ST_mmgc_externalalloc {
+namespace ST_mmgc_compaction {
 using namespace MMgc;
-class MyCallback : public MMgc::OOMCallback
+
+class Node : public GCTraceableObject
 {
 public:
-    MMgc::MemoryStatus status;
+    Node(int key) : key(key) {}
 
-    MyCallback()
+    virtual bool gcTrace(GC* gc, size_t)
     {
-        status = MMgc::GCHeap::GetGCHeap()->GetStatus();
-        MMgc::GCHeap::GetGCHeap()->AddOOMCallback(this);
+        gc->TraceLocation(&next);
+        return false;
     }
 
-    void memoryStatusChange(MMgc::MemoryStatus /*oldStatus*/, MMgc::MemoryStatus newStatus)
+    int key;
+    GCMember<Node> next;
+};
+
+// Enough nodes to fill several times kMinCandidates blocks, of which one in
+// kSurvivorInterval survives, so that every block is a candidate.
+static const int kNumNodes = 8000;
+static const int kSurvivorInterval = 8;
+static const int kNumSurvivors = kNumNodes / kSurvivorInterval;
+
+// The survivors are reachable only from this exact root, so that the conservative
+// stack scan doesn't pin them.  Their original addresses are kept in static
+// memory, which the GC does not scan.
+struct NodeRoot : public GCRoot
+{
+    NodeRoot(GC* gc) : GCRoot(gc, kExact), head(NULL) {}
+
+    virtual bool gcTrace(GC* gc, size_t)
     {
-        status = newStatus;
+        gc->TraceLocation(&head);
+        return false;
     }
+
+    Node* head;
 };
 
-class ST_mmgc_externalalloc : public Selftest {
+static uintptr_t addresses[kNumSurvivors];
+
+class ST_mmgc_compaction : public Selftest {
 public:
-ST_mmgc_externalalloc(AvmCore* core);
+ST_mmgc_compaction(AvmCore* core);
 virtual void run(int n);
 virtual void prologue();
 virtual void epilogue();
@@ -2228,279 +2714,255 @@ private:
 static const char* ST_names[];
 static const bool ST_explicits[];
 void test0();
+void test1();
 private:
-    MyCallback *cb;
+    MMgc::GC *gc;
+
+    // Build the list of survivors, last one first, and return the number of blocks
+    // in use before the garbage is collected.
+    size_t populate(NodeRoot* root)
+    {
+        for ( int i=0 ; i < kNumNodes ; i++ ) {
+            Node* n = new (gc, kExact, kMovableObject) Node(i);
+            if (i % kSurvivorInterval == 0) {
+                n->next = root->head;
+                root->head = n;
+                addresses[i / kSurvivorInterval] = uintptr_t(n);
+            }
+        }
+        return gc->GetNumBlocks();
+    }
 
 };
-ST_mmgc_externalalloc::ST_mmgc_externalalloc(AvmCore* core)
-    : Selftest(core, "mmgc", "externalalloc", ST_mmgc_externalalloc::ST_names,ST_mmgc_externalalloc::ST_explicits)
+ST_mmgc_compaction::ST_mmgc_compaction(AvmCore* core)
+    : Selftest(core, "mmgc", "compaction", ST_mmgc_compaction::ST_names,ST_mmgc_compaction::ST_explicits)
 {}
-const char* ST_mmgc_externalalloc::ST_names[] = {"externalAllocation", NULL };
-const bool ST_mmgc_externalalloc::ST_explicits[] = {false, false };
-void ST_mmgc_externalalloc::run(int n) {
+const char* ST_mmgc_compaction::ST_names[] = {"evacuate","pinned", NULL };
+const bool ST_mmgc_compaction::ST_explicits[] = {false,false, false };
+void ST_mmgc_compaction::run(int n) {
 switch(n) {
 case 0: test0(); return;
+case 1: test1(); return;
 }
 }
-void ST_mmgc_externalalloc::prologue() {
-    cb = new MyCallback();
+void ST_mmgc_compaction::prologue() {
+    GCConfig config;
+    config.compaction = true;
+    gc = new GC(GCHeap::GetGCHeap(), config);
 
 }
-void ST_mmgc_externalalloc::epilogue() {
-    cb = NULL;
+void ST_mmgc_compaction::epilogue() {
+    delete gc;
 
 }
-void ST_mmgc_externalalloc::test0() {
-    MMGC_GCENTER(core->gc);
-    size_t softlimit = GCHeap::GetGCHeap()->Config().heapSoftLimit;
-    // Remove the heapSoftLimit, this should ensure that we are not in a MMgc::kMemSoftLimit state,
-    // and hopefully we are in a kMemNormal state otherwise we are in a kMemAbort state and all bets are off.
-    GCHeap::GetGCHeap()->Config().heapSoftLimit = 0;
-// line 45 "ST_mmgc_externalalloc.st"
-verifyPass(cb->status==MMgc::kMemNormal, "cb->status==MMgc::kMemNormal", __FILE__, __LINE__);
-    GCHeap::GetGCHeap()->Config().heapSoftLimit = GCHeap::GetGCHeap()->GetTotalHeapSize();
-    MMgc::GCHeap::SignalExternalAllocation(1024*1024);
-// line 48 "ST_mmgc_externalalloc.st"
-verifyPass(cb->status==MMgc::kMemSoftLimit, "cb->status==MMgc::kMemSoftLimit", __FILE__, __LINE__);
-    MMgc::GCHeap::SignalExternalDeallocation(1024*1024);
-// line 50 "ST_mmgc_externalalloc.st"
-verifyPass(cb->status==MMgc::kMemNormal, "cb->status==MMgc::kMemNormal", __FILE__, __LINE__);
-    GCHeap::GetGCHeap()->Config().heapSoftLimit = softlimit;
-    softlimit = 0;
+void ST_mmgc_compaction::test0() {
+{
+    MMGC_GCENTER(gc);
+
+    NodeRoot* root = new NodeRoot(gc);
+    size_t blocksBefore = populate(root);
+
+    gc->Collect();
+    gc->Collect();
 
+    // The links and keys must be intact, and most survivors must have moved; a
+    // few may be pinned by stale values on the stack.
+    bool ok = true;
+    int count = 0;
+    int moved = 0;
+    for ( Node* n = root->head ; n != NULL ; n = n->next ) {
+        int i = kNumSurvivors - 1 - count;
+        if (i < 0 || n->key != i * kSurvivorInterval || !gc->IsPointerToGCObject(GetRealPointer(n)))
+            ok = false;
+        else if (uintptr_t(n) != addresses[i])
+            moved++;
+        count++;
+    }
+// line 107 "ST_mmgc_compaction.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+// line 108 "ST_mmgc_compaction.st"
+verifyPass(count == kNumSurvivors, "count == kNumSurvivors", __FILE__, __LINE__);
+// line 109 "ST_mmgc_compaction.st"
+verifyPass(moved > kNumSurvivors / 2, "moved > kNumSurvivors / 2", __FILE__, __LINE__);
 
+    // The survivors now fill about 1/kSurvivorInterval of the blocks they occupied.
+// line 112 "ST_mmgc_compaction.st"
+verifyPass(gc->GetNumBlocks() < blocksBefore / 2, "gc->GetNumBlocks() < blocksBefore / 2", __FILE__, __LINE__);
 
+    delete root;
 }
-void create_mmgc_externalalloc(AvmCore* core) { new ST_mmgc_externalalloc(core); }
+
+}
+void ST_mmgc_compaction::test1() {
+{
+    MMGC_GCENTER(gc);
+
+    NodeRoot* root = new NodeRoot(gc);
+    populate(root);
+
+    // A node held in conservatively scanned memory must not move.
+    GCRoot* pin = new GCRoot(gc, (const void*)&addresses[0], sizeof(uintptr_t));
+
+    gc->Collect();
+
+    Node* first = NULL;
+    for ( Node* n = root->head ; n != NULL ; n = n->next )
+        first = n;
+// line 132 "ST_mmgc_compaction.st"
+verifyPass(first != NULL && first->key == 0, "first != NULL && first->key == 0", __FILE__, __LINE__);
+// line 133 "ST_mmgc_compaction.st"
+verifyPass(uintptr_t(first) == addresses[0], "uintptr_t(first) == addresses[0]", __FILE__, __LINE__);
+
+    delete pin;
+    delete root;
+}
+
+}
+void create_mmgc_compaction(AvmCore* core) { new ST_mmgc_compaction(core); }
 }
 }
 #endif
 
-// Generated from ST_mmgc_finalize_uninit.st
-// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// Generated from ST_mmgc_conservativescan.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
 // This Source Code Form is subject to the terms of the Mozilla Public
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
-
-// Bugzilla 573737 - a throw from an argument to a constructor can
-// cause an object to be allocated on the gc-heap before it has been
-// fully initialized.  (In particular, its vtable could be missing.)
-// Since finalizers use the virtual destructor method, a missing
-// vtable is a problem.
-//
-// Its a little tricky to test this because the "order of evaluation
-// to an operator new() to get memory and the evaluation of arguments
-// to constructors is undefined"; see details below.
+// Conservative scanning of roots (GC::MarkItem_ConservativeOrNonGCObject and its
+// prefilter, see MMGC_SIMD_CONSERVATIVE_SCAN): a pointer must be found in any word
+// of a root, whatever its position relative to the words around it.
 
 #include "avmshell.h"
 #ifdef VMCFG_SELFTEST
 namespace avmplus {
-namespace ST_mmgc_finalize_uninit {
-
+namespace ST_mmgc_conservativescan {
 using namespace MMgc;
 
-class D : public GCFinalizedObject
+class CSObject : public GCFinalizedObject
 {
 public:
-    D(int dummyArgument) { (void)dummyArgument; }
-    ~D() { ++finalized; }
-    static int finalized_count() { return D::finalized; }
-    static void reset_finalized_count() { finalized = 0; }
-    // "usual" overload of placement new used in mmgc client code
-    void * operator new(size_t size, GC *gc) {
-        return GCFinalizedObject::operator new(size, gc);
-    }
-    // hack to explicitly order new-allocation + ctor-arg eval; see below
-    // (but reallys its just good ol' placement new!)
-    void * operator new(size_t size, GC *gc, void *raw) {
-        (void)size; (void)gc;
-        return raw;
-    }
-private:
-    static int finalized;
+    CSObject(int key) : key(key) {}
+    ~CSObject() { key = -1; }
+    int key;
 };
 
-/*static*/
-int D::finalized;
-
-int deathValue(AvmCore *core)
+// Values that are not pointers to objects, to fill the words between the pointers.
+static uintptr_t noise(size_t i)
 {
-    core->throwAtom(atomFromIntptrValue(1)); /* won't return */
-
-    return 0; /* silence compiler warnings */
+    switch (i % 4) {
+        case 0:  return 0;
+        case 1:  return uintptr_t(i);
+        case 2:  return ~uintptr_t(i);
+        default: return uintptr_t(1) << (i % (8 * sizeof(uintptr_t)));
+    }
 }
 
-// Test checks that finalizers themselves have not broken; here,
-// constructor argument subexpression evaluates cleanly.
-class ST_mmgc_finalize_uninit : public Selftest {
+class ST_mmgc_conservativescan : public Selftest {
 public:
-ST_mmgc_finalize_uninit(AvmCore* core);
+ST_mmgc_conservativescan(AvmCore* core);
 virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
 private:
 static const char* ST_names[];
 static const bool ST_explicits[];
 void test0();
 void test1();
-void test2();
-void test3();
-};
-ST_mmgc_finalize_uninit::ST_mmgc_finalize_uninit(AvmCore* core)
-    : Selftest(core, "mmgc", "finalize_uninit", ST_mmgc_finalize_uninit::ST_names,ST_mmgc_finalize_uninit::ST_explicits)
-{}
-const char* ST_mmgc_finalize_uninit::ST_names[] = {"check_finalizers_still_work","original_death","desugared_check_finalizers_still_work","desugared_death", NULL };
-const bool ST_mmgc_finalize_uninit::ST_explicits[] = {false,false,false,false, false };
-void ST_mmgc_finalize_uninit::run(int n) {
-switch(n) {
-case 0: test0(); return;
-case 1: test1(); return;
-case 2: test2(); return;
-case 3: test3(); return;
-}
-}
-void ST_mmgc_finalize_uninit::test0() {
-{
-    D::reset_finalized_count();
-    D* d;
-    int i;
-
-    // loop to alloc many (and subsequently reclaim >=expected percentage)
-    for (i = 0; i < 100; i++) {
-        d = new (core->gc) D(1);
-    }
-    (void) d;
-
-    core->gc->Collect(); // finish any prior incremental work ...
-    core->gc->Collect(); // ... and ensure we got fresh + complete gc.
-
-    // printf("D::finalized_count(): %d\n", D::finalized_count());
-
-// line 75 "ST_mmgc_finalize_uninit.st"
-verifyPass((D::finalized_count() > 90), "(D::finalized_count() > 90)", __FILE__, __LINE__);
-}
+private:
+    MMgc::GC *gc;
 
-// Test illustrates of the kind of code that exposed the original bug;
-// here, constructor argument subexpression throws.
-}
-void ST_mmgc_finalize_uninit::test1() {
-{
-    D* d;
-    volatile int i;
+    // Fill a root of 'nwords' words with noise and pointers to objects, 'stride'
+    // words apart and in the last three words, some of them tagged like atoms.
+    // Return true if all the objects survive collection.
+    bool scan(size_t nwords, size_t stride)
+    {
+        const size_t kMaxObjects = 512;
+        GCWeakRef* refs[kMaxObjects];
+        uintptr_t* words = mmfx_new_array(uintptr_t, nwords);
+        for ( size_t i=0 ; i < nwords ; i++ )
+            words[i] = noise(i);
+
+        size_t nobjs = 0;
+        for ( size_t i=0 ; i < nwords && nobjs < kMaxObjects ; i += (i + stride < nwords - 3 ? stride : 1) ) {
+            CSObject* obj = new (gc) CSObject(int(nobjs));
+            refs[nobjs++] = obj->GetWeakRef();
+            words[i] = uintptr_t(obj) | (i % 3 == 0 ? 1 : 0);
+        }
 
-    // Here, constructor argument subexpression throws
+        GCRoot* root = new GCRoot(gc, words, nwords * sizeof(uintptr_t));
+        gc->Collect();
+        gc->Collect();
 
-    // Just one allocation attempt alone would risk false retention of
-    // intermediate values, so loop a bit to ensure that *some* D's,
-    // if allocated at all, will be considered garbage.
-    for (i = 0; i < 5; i++) {
-        TRY (core, kCatchAction_Ignore) {
-            d = new (core->gc) D(deathValue(core));
-        }  CATCH (Exception *e) {
-            (void)e;
+        bool ok = true;
+        for ( size_t k=0 ; k < nobjs ; k++ ) {
+            CSObject* obj = (CSObject*)refs[k]->get();
+            if (obj == NULL || obj->key != int(k))
+                ok = false;
         }
-        END_CATCH
-        END_TRY
-    }
-    (void) d;
 
-    // if things go badly, one of the collections below will segfault
-    // during finalization.
-    core->gc->Collect();
-    core->gc->Collect();
+        delete root;
+        mmfx_delete_array(words);
+        return ok;
+    }
 
-    // (not dying is passing.)
-// line 107 "ST_mmgc_finalize_uninit.st"
-verifyPass(true, "true", __FILE__, __LINE__);
+};
+ST_mmgc_conservativescan::ST_mmgc_conservativescan(AvmCore* core)
+    : Selftest(core, "mmgc", "conservativescan", ST_mmgc_conservativescan::ST_names,ST_mmgc_conservativescan::ST_explicits)
+{}
+const char* ST_mmgc_conservativescan::ST_names[] = {"small_roots","large_root", NULL };
+const bool ST_mmgc_conservativescan::ST_explicits[] = {false,false, false };
+void ST_mmgc_conservativescan::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+}
 }
+void ST_mmgc_conservativescan::prologue() {
+    GCConfig config;
+    gc = new GC(GCHeap::GetGCHeap(), config);
 
-// C++ standard says "The order of evaluation to an operator new() to
-// get memory and the evaluation of arguments to constructors is
-// undefined."
-//
-// Unfortunately, it is difficult to directly express the particular
-// order of evaluation that exposes the bug in question, because
-// allocation and construction are tied together.
-//
-// So, here we manually decompose the tests above to control
-// evaluation order of operator new() and constructor arguments, to
-// express suitable evil (namely: allocation; args eval; construction)
-// for selftest.
-//
-// The desugaring iteself is:
-// desugar[[ new (gc-exp) D(arg-exp) ]]
-// ==> mem = D::operator new(sizeof(D), arg), new (gc-exp, mem) D(arg-exp)
+}
+void ST_mmgc_conservativescan::epilogue() {
+    delete gc;
 
-// Test illustrates desugaring is "sound"; keep in sync with
-// check_finalizers_still_work above.
 }
-void ST_mmgc_finalize_uninit::test2() {
+void ST_mmgc_conservativescan::test0() {
 {
-    D::reset_finalized_count();
-    D* d;
-    int i;
-
-    // loop to alloc many (and subsequently reclaim >=expected percentage)
-    for (i = 0; i < 100; i++) {
-        // d = new (core->gc) D(s);
-        void *mem = D::operator new(sizeof(D), core->gc);
-        d = new (core->gc, mem) D(1);
-    }
-    (void) d;
-
-    core->gc->Collect(); // finish any prior incremental work ...
-    core->gc->Collect(); // ... and ensure we got fresh + complete gc.
-
-    // printf("D::finalized_count(): %d\n", D::finalized_count());
+    MMGC_GCENTER(gc);
 
-// line 148 "ST_mmgc_finalize_uninit.st"
-verifyPass((D::finalized_count() > 90), "(D::finalized_count() > 90)", __FILE__, __LINE__);
+    // Every size up to a few filter groups, so that pointers appear at every
+    // position within a group and in every length of tail.
+    bool ok = true;
+    for ( size_t nwords=1 ; nwords <= 19 ; nwords++ )
+        if (!scan(nwords, 2))
+            ok = false;
+// line 92 "ST_mmgc_conservativescan.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
 }
 
-
-// Test forces evil order of evaluation via desugaring of
-// construction; keep in sync with original_death above.
 }
-void ST_mmgc_finalize_uninit::test3() {
+void ST_mmgc_conservativescan::test1() {
 {
-    D* d;
-    volatile int i;
-
-    // Here, constructor argument subexpression throws
-
-    // Just one allocation attempt alone would risk false retention of
-    // intermediate values, so loop a bit to ensure that *some* D's,
-    // which are forcibly allocated here, will be considered garbage.
-    for (i = 0; i < 5; i++) {
-        TRY (core, kCatchAction_Ignore) {
-            // d = new (core->gc) D(deathValue());
-            void *mem = D::operator new(sizeof(D), core->gc);
-            d = new (core->gc, mem) D(deathValue(core));
-        }  CATCH (Exception *e) {
-            (void)e;
-        }
-        END_CATCH
-        END_TRY
-    }
-    (void) d;
-
-    // if things go badly, one of the collections below will segfault
-    // during finalization.
-    core->gc->Collect();
-    core->gc->Collect();
+    MMGC_GCENTER(gc);
 
-    // (not dying is passing.)
-// line 183 "ST_mmgc_finalize_uninit.st"
-verifyPass(true, "true", __FILE__, __LINE__);
+    // Large enough to be split, with pointers at odd strides so that they fall
+    // on every position in the groups.
+// line 101 "ST_mmgc_conservativescan.st"
+verifyPass(scan(4099, 17), "scan(4099, 17)", __FILE__, __LINE__);
+// line 102 "ST_mmgc_conservativescan.st"
+verifyPass(scan(20000, 79), "scan(20000, 79)", __FILE__, __LINE__);
 }
 
 }
-void create_mmgc_finalize_uninit(AvmCore* core) { new ST_mmgc_finalize_uninit(core); }
+void create_mmgc_conservativescan(AvmCore* core) { new ST_mmgc_conservativescan(core); }
 }
 }
 #endif
 
-// Generated from ST_mmgc_fixedmalloc_findbeginning.st
+// Generated from ST_mmgc_dependent.st
 // -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
 // vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
 //
@@ -2508,345 +2970,2830 @@ void create_mmgc_finalize_uninit(AvmCore* core) { new ST_mmgc_finalize_uninit(co
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-// Bugzilla 663508: Add FixedMalloc::FindBeginning
+// Bugzilla 543560 - here we risk deleting an object that is still on the mark stack because
+// of how we perform large-object splitting.  The setup is that user code that deletes the object
+// gets to run after the first part of the large object has been popped off the mark stack
+// but before the rest has been handled.
 
 #include "avmshell.h"
 #ifdef VMCFG_SELFTEST
 namespace avmplus {
-namespace ST_mmgc_fixedmalloc_findbeginning {
+namespace ST_mmgc_dependent {
 using namespace MMgc;
 
-class ST_mmgc_fixedmalloc_findbeginning : public Selftest {
+static const size_t nbytes = 16*1024*1024;
+
+class DependentAllocHolder : public GCFinalizedObject {
 public:
-ST_mmgc_fixedmalloc_findbeginning(AvmCore* core);
+
+  DependentAllocHolder() {
+    memory = (char*)FixedMalloc::GetFixedMalloc(MMgc::kAVMShellFixedPartition)->Alloc(nbytes);
+    GC::GetGC(this)->SignalDependentAllocation(nbytes);
+  }
+
+  virtual ~DependentAllocHolder() {
+    FixedMalloc::GetFixedMalloc(MMgc::kAVMShellFixedPartition)->Free(memory);
+    memory = NULL;
+    GC::GetGC(this)->SignalDependentDeallocation(nbytes);
+  }
+  private:
+    char* memory;
+};
+
+class ST_mmgc_dependent : public Selftest {
+public:
+ST_mmgc_dependent(AvmCore* core);
 virtual void run(int n);
 virtual void prologue();
+virtual void epilogue();
 private:
 static const char* ST_names[];
 static const bool ST_explicits[];
 void test0();
 void test1();
 void test2();
-void test3();
-void test4();
-void test5();
-void test6();
-void test7();
-void test8();
-void test9();
-void test10();
-void test11();
+private:
+    MMgc::GC *gc;
 
-    MMgc::FixedMalloc *fm;
+};
+ST_mmgc_dependent::ST_mmgc_dependent(AvmCore* core)
+    : Selftest(core, "mmgc", "dependent", ST_mmgc_dependent::ST_names,ST_mmgc_dependent::ST_explicits)
+{}
+const char* ST_mmgc_dependent::ST_names[] = {"dependent_alloc","dependent_memory_total","dependent_memory_unknown", NULL };
+const bool ST_mmgc_dependent::ST_explicits[] = {false,false,false, false };
+void ST_mmgc_dependent::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+case 2: test2(); return;
+}
+}
+void ST_mmgc_dependent::prologue() {
+    GCConfig config;
+    gc = new GC(GCHeap::GetGCHeap(), config);
 
-    // Allocates object of size sz and tests FixedMalloc::FindBeginning
-    // at various addresses within the allocated object.  The sampled
-    // addresses are meant to cover the following interesting edge
-    // cases: at or near the object's start, the middle of the object,
-    // and at or near the object's end.
-    //
-    // If all the tests successively identify the object's start, then
-    // returns 0.  Otherwise returns a numeric code identifying which
-    // tests failed.
-    int allocateVerifyAndFree(size_t sz)
+}
+void ST_mmgc_dependent::epilogue() {
+    delete gc;
+
+}
+void ST_mmgc_dependent::test0() {
+    size_t maxheap = 0;
     {
-        int retval = 0;
-        (void)sz;
+        MMGC_GCENTER(gc);
 
-        char *obj = (char*)fm->Alloc(sz);
+        int count = 100;
+        for (int c=0; c<count; c++) {
+            (void)(new (gc) DependentAllocHolder());
+            size_t heapsize = gc->policy.blocksOwnedByGC() * GCHeap::kBlockSize;
+            // printf("%lu\n", (unsigned long)heapsize);
+            if (heapsize > maxheap)
+                maxheap = heapsize;
+        }
+    }
 
-        retval |= checkLookups(obj, obj, sz);
-        retval = retval << 2;
-        if (sz > 1) retval |= checkLookups(obj+1, obj, sz);
-        retval = retval << 2;
-        if (sz > 3) retval |= checkLookups(obj+3, obj, sz);
-        retval = retval << 2;
-        retval |= checkLookups(obj+sz/2, obj, sz);
-        retval = retval << 2;
-        retval |= checkLookups(obj+sz-1, obj, sz);
-        retval = retval << 2;
+    // This is tricky to get right but for this test the 16MB blocks will dominate
+    // completely.  So assume that heap size must stay below L*2*16MB for the
+    // L that applies at 32MB.
 
-        fm->Free(obj);
+// line 68 "ST_mmgc_dependent.st"
+verifyPass(size_t(gc->policy.queryLoadForHeapsize(double(2*nbytes)) * 2.0 * double(nbytes)) >= maxheap, "size_t(gc->policy.queryLoadForHeapsize(double(2*nbytes)) * 2.0 * double(nbytes)) >= maxheap", __FILE__, __LINE__);
 
-        return retval;
-    }
+}
+void ST_mmgc_dependent::test1() {
+#if defined VMCFG_TELEMETRY && defined AVMSHELL_BUILD
+    size_t depMem_start,depMem_end;
+    depMem_start = depMem_end = 0;
+    MMgc::GC* gc = core->gc;
 
-    // Returns 0 if both test of FixedMalloc::FindBeginning and
-    // FixedMalloc::FindBeginningAndSize pass.
-    // Returns 1 if the first test (of FindBeginning) fails.
+    // Check total dependent memory consistency
+    for(int i = 0; i < MMgc::typeCount; i++)
+        depMem_start += gc->getDependentMemory((MMgc::DependentMemoryType)i);
+// line 79 "ST_mmgc_dependent.st"
+verifyPass(depMem_start == gc->policy.dependentAllocation, "depMem_start == gc->policy.dependentAllocation", __FILE__, __LINE__);
+
+    // Check byteArray type dependent memory
+    avmshell::ShellCore* c = (avmshell::ShellCore*)core;
+    avmshell::ShellToplevel* top = c->shell_toplevel;
+
+    size_t byteArray_bytes1 = gc->getDependentMemory(MMgc::typeByteArray);
+    ByteArrayObject* byteArray = top->byteArrayClass()->constructByteArray();
+    byteArray->writeBoolean(false);
+    byteArray->writeDouble(3.14);
+
+    // Allocate known type dependent memory
+    size_t byteArray_bytes2 = gc->getDependentMemory(MMgc::typeByteArray);
+// line 92 "ST_mmgc_dependent.st"
+verifyPass(byteArray_bytes2 > byteArray_bytes1, "byteArray_bytes2 > byteArray_bytes1", __FILE__, __LINE__);
+
+    // Allocate unknown dependent memory
+    DependentAllocHolder* obj = new (gc) DependentAllocHolder();
+
+    size_t byteArray_bytes3 = gc->getDependentMemory(MMgc::typeByteArray);
+// line 98 "ST_mmgc_dependent.st"
+verifyPass(byteArray_bytes3 == byteArray_bytes2, "byteArray_bytes3 == byteArray_bytes2", __FILE__, __LINE__);
+    byteArray->clear();
+ 
+// line 101 "ST_mmgc_dependent.st"
+verifyPass(gc->getDependentMemory(MMgc::typeByteArray) == byteArray_bytes1, "gc->getDependentMemory(MMgc::typeByteArray) == byteArray_bytes1", __FILE__, __LINE__);
+    delete obj;
+
+    // Consistency check
+    for(int i = 0; i < MMgc::typeCount; i++)
+        depMem_end += gc->getDependentMemory((MMgc::DependentMemoryType)i);
+// line 107 "ST_mmgc_dependent.st"
+verifyPass(depMem_end == gc->policy.dependentAllocation, "depMem_end == gc->policy.dependentAllocation", __FILE__, __LINE__);
+// line 108 "ST_mmgc_dependent.st"
+verifyPass(depMem_end == depMem_start, "depMem_end == depMem_start", __FILE__, __LINE__);
+
+#if !defined DEBUG && !defined DEBUGGER
+    // Get memory for out of bounds type
+    // getDependentMemory has assert; skip in debug build
+// line 113 "ST_mmgc_dependent.st"
+verifyPass(gc->getDependentMemory(MMgc::typeCount) == 0, "gc->getDependentMemory(MMgc::typeCount) == 0", __FILE__, __LINE__);
+#endif
+// line 115 "ST_mmgc_dependent.st"
+verifyPass(true, "true", __FILE__, __LINE__);
+#endif
+
+}
+void ST_mmgc_dependent::test2() {
+#if defined VMCFG_TELEMETRY && defined AVMSHELL_BUILD
+    // Check unknown type dependent memory
+    MMgc::GC* gc = core->gc;
+    size_t unknownDependentMem_start = gc->getDependentMemory(MMgc::typeUnknown);
+    DependentAllocHolder* obj = new (gc) DependentAllocHolder();
+    size_t unknownDependentMem_end = gc->getDependentMemory(MMgc::typeUnknown);
+// line 125 "ST_mmgc_dependent.st"
+verifyPass((unknownDependentMem_end - unknownDependentMem_start) == nbytes, "(unknownDependentMem_end - unknownDependentMem_start) == nbytes", __FILE__, __LINE__);
+    
+    delete obj;
+// line 128 "ST_mmgc_dependent.st"
+verifyPass(unknownDependentMem_start == gc->getDependentMemory(MMgc::typeUnknown), "unknownDependentMem_start == gc->getDependentMemory(MMgc::typeUnknown)", __FILE__, __LINE__);
+#else
+// line 130 "ST_mmgc_dependent.st"
+verifyPass(true, "true", __FILE__, __LINE__);
+#endif
+
+
+}
+void create_mmgc_dependent(AvmCore* core) { new ST_mmgc_dependent(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_exact.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_exact {
+
+class Cthulhu : public MMgc::GCTraceableObject
+{
+public:
+    static Cthulhu* create(MMgc::GC* gc) {
+        return new (gc, MMgc::kExact) Cthulhu();
+    }
+
+    virtual bool gcTrace(MMgc::GC* gc, size_t cursor) {
+        (void)gc;
+        // Incorrectly say that there's more to do even when the object is small
+        if (cursor == 0)
+            return true;
+        // Concede
+        return false;
+    }
+};
+
+// This test triggers a particular edge case in GC::SplitExactGCObject where
+// a small object that returns 'true' from its gcTrace method is synchronously
+// marked until the method returns 'false'; a 'true' return is only ever expected
+// from the gcTrace methods of large objects.
+
+class ST_mmgc_exact : public Selftest {
+public:
+ST_mmgc_exact(AvmCore* core);
+virtual void run(int n);
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+};
+ST_mmgc_exact::ST_mmgc_exact(AvmCore* core)
+    : Selftest(core, "mmgc", "exact", ST_mmgc_exact::ST_names,ST_mmgc_exact::ST_explicits)
+{}
+const char* ST_mmgc_exact::ST_names[] = {"IncorrectlySplitSmallObject", NULL };
+const bool ST_mmgc_exact::ST_explicits[] = {false, false };
+void ST_mmgc_exact::run(int n) {
+switch(n) {
+case 0: test0(); return;
+}
+}
+void ST_mmgc_exact::test0() {
+    // Create an object that stays alive so that its tracer will be called
+    MMgc::GCObjectLock* lock = core->gc->LockObject(Cthulhu::create(core->gc));
+    core->gc->Collect();
+    core->gc->Collect();
+    core->gc->UnlockObject(lock);
+
+// line 42 "ST_mmgc_exact.st"
+verifyPass(true, "true", __FILE__, __LINE__);
+
+
+}
+void create_mmgc_exact(AvmCore* core) { new ST_mmgc_exact(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_externalalloc.st
+// -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_externalalloc {
+using namespace MMgc;
+class MyCallback : public MMgc::OOMCallback
+{
+public:
+    MMgc::MemoryStatus status;
+
+    MyCallback()
+    {
+        status = MMgc::GCHeap::GetGCHeap()->GetStatus();
+        MMgc::GCHeap::GetGCHeap()->AddOOMCallback(this);
+    }
+
+    void memoryStatusChange(MMgc::MemoryStatus /*oldStatus*/, MMgc::MemoryStatus newStatus)
+    {
+        status = newStatus;
+    }
+};
+
+class ST_mmgc_externalalloc : public Selftest {
+public:
+ST_mmgc_externalalloc(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+private:
+    MyCallback *cb;
+
+};
+ST_mmgc_externalalloc::ST_mmgc_externalalloc(AvmCore* core)
+    : Selftest(core, "mmgc", "externalalloc", ST_mmgc_externalalloc::ST_names,ST_mmgc_externalalloc::ST_explicits)
+{}
+const char* ST_mmgc_externalalloc::ST_names[] = {"externalAllocation", NULL };
+const bool ST_mmgc_externalalloc::ST_explicits[] = {false, false };
+void ST_mmgc_externalalloc::run(int n) {
+switch(n) {
+case 0: test0(); return;
+}
+}
+void ST_mmgc_externalalloc::prologue() {
+    cb = new MyCallback();
+
+}
+void ST_mmgc_externalalloc::epilogue() {
+    cb = NULL;
+
+}
+void ST_mmgc_externalalloc::test0() {
+    MMGC_GCENTER(core->gc);
+    size_t softlimit = GCHeap::GetGCHeap()->Config().heapSoftLimit;
+    // Remove the heapSoftLimit, this should ensure that we are not in a MMgc::kMemSoftLimit state,
+    // and hopefully we are in a kMemNormal state otherwise we are in a kMemAbort state and all bets are off.
+    GCHeap::GetGCHeap()->Config().heapSoftLimit = 0;
+// line 45 "ST_mmgc_externalalloc.st"
+verifyPass(cb->status==MMgc::kMemNormal, "cb->status==MMgc::kMemNormal", __FILE__, __LINE__);
+    GCHeap::GetGCHeap()->Config().heapSoftLimit = GCHeap::GetGCHeap()->GetTotalHeapSize();
+    MMgc::GCHeap::SignalExternalAllocation(1024*1024);
+// line 48 "ST_mmgc_externalalloc.st"
+verifyPass(cb->status==MMgc::kMemSoftLimit, "cb->status==MMgc::kMemSoftLimit", __FILE__, __LINE__);
+    MMgc::GCHeap::SignalExternalDeallocation(1024*1024);
+// line 50 "ST_mmgc_externalalloc.st"
+verifyPass(cb->status==MMgc::kMemNormal, "cb->status==MMgc::kMemNormal", __FILE__, __LINE__);
+    GCHeap::GetGCHeap()->Config().heapSoftLimit = softlimit;
+    softlimit = 0;
+
+
+
+}
+void create_mmgc_externalalloc(AvmCore* core) { new ST_mmgc_externalalloc(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_finalize_uninit.st
+// -*- mode: c++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+
+// Bugzilla 573737 - a throw from an argument to a constructor can
+// cause an object to be allocated on the gc-heap before it has been
+// fully initialized.  (In particular, its vtable could be missing.)
+// Since finalizers use the virtual destructor method, a missing
+// vtable is a problem.
+//
+// Its a little tricky to test this because the "order of evaluation
+// to an operator new() to get memory and the evaluation of arguments
+// to constructors is undefined"; see details below.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_finalize_uninit {
+
+using namespace MMgc;
+
+class D : public GCFinalizedObject
+{
+public:
+    D(int dummyArgument) { (void)dummyArgument; }
+    ~D() { ++finalized; }
+    static int finalized_count() { return D::finalized; }
+    static void reset_finalized_count() { finalized = 0; }
+    // "usual" overload of placement new used in mmgc client code
+    void * operator new(size_t size, GC *gc) {
+        return GCFinalizedObject::operator new(size, gc);
+    }
+    // hack to explicitly order new-allocation + ctor-arg eval; see below
+    // (but reallys its just good ol' placement new!)
+    void * operator new(size_t size, GC *gc, void *raw) {
+        (void)size; (void)gc;
+        return raw;
+    }
+private:
+    static int finalized;
+};
+
+/*static*/
+int D::finalized;
+
+int deathValue(AvmCore *core)
+{
+    core->throwAtom(atomFromIntptrValue(1)); /* won't return */
+
+    return 0; /* silence compiler warnings */
+}
+
+// Test checks that finalizers themselves have not broken; here,
+// constructor argument subexpression evaluates cleanly.
+class ST_mmgc_finalize_uninit : public Selftest {
+public:
+ST_mmgc_finalize_uninit(AvmCore* core);
+virtual void run(int n);
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+void test2();
+void test3();
+};
+ST_mmgc_finalize_uninit::ST_mmgc_finalize_uninit(AvmCore* core)
+    : Selftest(core, "mmgc", "finalize_uninit", ST_mmgc_finalize_uninit::ST_names,ST_mmgc_finalize_uninit::ST_explicits)
+{}
+const char* ST_mmgc_finalize_uninit::ST_names[] = {"check_finalizers_still_work","original_death","desugared_check_finalizers_still_work","desugared_death", NULL };
+const bool ST_mmgc_finalize_uninit::ST_explicits[] = {false,false,false,false, false };
+void ST_mmgc_finalize_uninit::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+case 2: test2(); return;
+case 3: test3(); return;
+}
+}
+void ST_mmgc_finalize_uninit::test0() {
+{
+    D::reset_finalized_count();
+    D* d;
+    int i;
+
+    // loop to alloc many (and subsequently reclaim >=expected percentage)
+    for (i = 0; i < 100; i++) {
+        d = new (core->gc) D(1);
+    }
+    (void) d;
+
+    core->gc->Collect(); // finish any prior incremental work ...
+    core->gc->Collect(); // ... and ensure we got fresh + complete gc.
+
+    // printf("D::finalized_count(): %d\n", D::finalized_count());
+
+// line 75 "ST_mmgc_finalize_uninit.st"
+verifyPass((D::finalized_count() > 90), "(D::finalized_count() > 90)", __FILE__, __LINE__);
+}
+
+// Test illustrates of the kind of code that exposed the original bug;
+// here, constructor argument subexpression throws.
+}
+void ST_mmgc_finalize_uninit::test1() {
+{
+    D* d;
+    volatile int i;
+
+    // Here, constructor argument subexpression throws
+
+    // Just one allocation attempt alone would risk false retention of
+    // intermediate values, so loop a bit to ensure that *some* D's,
+    // if allocated at all, will be considered garbage.
+    for (i = 0; i < 5; i++) {
+        TRY (core, kCatchAction_Ignore) {
+            d = new (core->gc) D(deathValue(core));
+        }  CATCH (Exception *e) {
+            (void)e;
+        }
+        END_CATCH
+        END_TRY
+    }
+    (void) d;
+
+    // if things go badly, one of the collections below will segfault
+    // during finalization.
+    core->gc->Collect();
+    core->gc->Collect();
+
+    // (not dying is passing.)
+// line 107 "ST_mmgc_finalize_uninit.st"
+verifyPass(true, "true", __FILE__, __LINE__);
+}
+
+// C++ standard says "The order of evaluation to an operator new() to
+// get memory and the evaluation of arguments to constructors is
+// undefined."
+//
+// Unfortunately, it is difficult to directly express the particular
+// order of evaluation that exposes the bug in question, because
+// allocation and construction are tied together.
+//
+// So, here we manually decompose the tests above to control
+// evaluation order of operator new() and constructor arguments, to
+// express suitable evil (namely: allocation; args eval; construction)
+// for selftest.
+//
+// The desugaring iteself is:
+// desugar[[ new (gc-exp) D(arg-exp) ]]
+// ==> mem = D::operator new(sizeof(D), arg), new (gc-exp, mem) D(arg-exp)
+
+// Test illustrates desugaring is "sound"; keep in sync with
+// check_finalizers_still_work above.
+}
+void ST_mmgc_finalize_uninit::test2() {
+{
+    D::reset_finalized_count();
+    D* d;
+    int i;
+
+    // loop to alloc many (and subsequently reclaim >=expected percentage)
+    for (i = 0; i < 100; i++) {
+        // d = new (core->gc) D(s);
+        void *mem = D::operator new(sizeof(D), core->gc);
+        d = new (core->gc, mem) D(1);
+    }
+    (void) d;
+
+    core->gc->Collect(); // finish any prior incremental work ...
+    core->gc->Collect(); // ... and ensure we got fresh + complete gc.
+
+    // printf("D::finalized_count(): %d\n", D::finalized_count());
+
+// line 148 "ST_mmgc_finalize_uninit.st"
+verifyPass((D::finalized_count() > 90), "(D::finalized_count() > 90)", __FILE__, __LINE__);
+}
+
+
+// Test forces evil order of evaluation via desugaring of
+// construction; keep in sync with original_death above.
+}
+void ST_mmgc_finalize_uninit::test3() {
+{
+    D* d;
+    volatile int i;
+
+    // Here, constructor argument subexpression throws
+
+    // Just one allocation attempt alone would risk false retention of
+    // intermediate values, so loop a bit to ensure that *some* D's,
+    // which are forcibly allocated here, will be considered garbage.
+    for (i = 0; i < 5; i++) {
+        TRY (core, kCatchAction_Ignore) {
+            // d = new (core->gc) D(deathValue());
+            void *mem = D::operator new(sizeof(D), core->gc);
+            d = new (core->gc, mem) D(deathValue(core));
+        }  CATCH (Exception *e) {
+            (void)e;
+        }
+        END_CATCH
+        END_TRY
+    }
+    (void) d;
+
+    // if things go badly, one of the collections below will segfault
+    // during finalization.
+    core->gc->Collect();
+    core->gc->Collect();
+
+    // (not dying is passing.)
+// line 183 "ST_mmgc_finalize_uninit.st"
+verifyPass(true, "true", __FILE__, __LINE__);
+}
+
+}
+void create_mmgc_finalize_uninit(AvmCore* core) { new ST_mmgc_finalize_uninit(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_fixedmalloc_findbeginning.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Bugzilla 663508: Add FixedMalloc::FindBeginning
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_fixedmalloc_findbeginning {
+using namespace MMgc;
+
+class ST_mmgc_fixedmalloc_findbeginning : public Selftest {
+public:
+ST_mmgc_fixedmalloc_findbeginning(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+void test2();
+void test3();
+void test4();
+void test5();
+void test6();
+void test7();
+void test8();
+void test9();
+void test10();
+void test11();
+
+    MMgc::FixedMalloc *fm;
+
+    // Allocates object of size sz and tests FixedMalloc::FindBeginning
+    // at various addresses within the allocated object.  The sampled
+    // addresses are meant to cover the following interesting edge
+    // cases: at or near the object's start, the middle of the object,
+    // and at or near the object's end.
+    //
+    // If all the tests successively identify the object's start, then
+    // returns 0.  Otherwise returns a numeric code identifying which
+    // tests failed.
+    int allocateVerifyAndFree(size_t sz)
+    {
+        int retval = 0;
+        (void)sz;
+
+        char *obj = (char*)fm->Alloc(sz);
+
+        retval |= checkLookups(obj, obj, sz);
+        retval = retval << 2;
+        if (sz > 1) retval |= checkLookups(obj+1, obj, sz);
+        retval = retval << 2;
+        if (sz > 3) retval |= checkLookups(obj+3, obj, sz);
+        retval = retval << 2;
+        retval |= checkLookups(obj+sz/2, obj, sz);
+        retval = retval << 2;
+        retval |= checkLookups(obj+sz-1, obj, sz);
+        retval = retval << 2;
+
+        fm->Free(obj);
+
+        return retval;
+    }
+
+    // Returns 0 if both test of FixedMalloc::FindBeginning and
+    // FixedMalloc::FindBeginningAndSize pass.
+    // Returns 1 if the first test (of FindBeginning) fails.
     // Returns 2 if the second test (of FindBeginningAndSize) fails.
     int checkLookups(const void* probe, const void* realStart, size_t sz)
     {
-        int retval = 0;
-        const void* begin_recv;
-        size_t size_recv;
-        size_t roundup_actual_size;
+        int retval = 0;
+        const void* begin_recv;
+        size_t size_recv;
+        size_t roundup_actual_size;
+
+        if (sz <= (size_t)FixedMalloc::kLargestAlloc)
+            roundup_actual_size = fm->FindAllocatorForSize(sz)->GetItemSize();
+        else
+            roundup_actual_size =
+                roundUp(sz + DebugSize(), GCHeap::kBlockSize) - DebugSize();
+
+        if (fm->FindBeginning(probe) != realStart)
+            retval |= 1;
+        if (!fm->FindBeginningAndSize(probe, begin_recv, size_recv) ||
+            (begin_recv != realStart) ||
+            (size_recv != roundup_actual_size))
+            retval |= 3;
+
+        return retval;
+    }
+
+    size_t roundUp(size_t s, size_t inc) {
+        return (((s + inc - 1) / inc) * inc);
+    }
+
+};
+ST_mmgc_fixedmalloc_findbeginning::ST_mmgc_fixedmalloc_findbeginning(AvmCore* core)
+    : Selftest(core, "mmgc", "fixedmalloc_findbeginning", ST_mmgc_fixedmalloc_findbeginning::ST_names,ST_mmgc_fixedmalloc_findbeginning::ST_explicits)
+{}
+const char* ST_mmgc_fixedmalloc_findbeginning::ST_names[] = {"findbeginnings_small0","findbeginnings_small1","findbeginnings_small2","findbeginnings_small3","findbeginnings_almost_large1","findbeginnings_almost_large2","findbeginnings_large","findbeginnings_almost_multiblock1","findbeginnings_almost_multiblock2","findbeginnings_barely_multiblock","findbeginnings_multiblock_two","findbeginnings_multiblock_ten", NULL };
+const bool ST_mmgc_fixedmalloc_findbeginning::ST_explicits[] = {false,false,false,false,false,false,false,false,false,false,false,false, false };
+void ST_mmgc_fixedmalloc_findbeginning::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+case 2: test2(); return;
+case 3: test3(); return;
+case 4: test4(); return;
+case 5: test5(); return;
+case 6: test6(); return;
+case 7: test7(); return;
+case 8: test8(); return;
+case 9: test9(); return;
+case 10: test10(); return;
+case 11: test11(); return;
+}
+}
+void ST_mmgc_fixedmalloc_findbeginning::prologue() {
+	fm = MMgc::FixedMalloc::GetFixedMalloc(MMgc::kAVMShellFixedPartition);
+
+}
+
+void ST_mmgc_fixedmalloc_findbeginning::test0() {
+    {
+        size_t sz = FixedMalloc::kSizeClasses[0];
+// line 91 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test1() {
+    {
+        size_t sz = FixedMalloc::kSizeClasses[1];
+// line 98 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test2() {
+    {
+        size_t sz = FixedMalloc::kSizeClasses[2];
+// line 105 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test3() {
+    {
+        size_t sz = FixedMalloc::kSizeClasses[3];
+// line 112 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test4() {
+    {
+        size_t sz = FixedMalloc::kLargestAlloc - 1;
+        sz = sz - DebugSize();
+// line 120 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+        sz = sz + DebugSize();
+// line 123 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test5() {
+    {
+        size_t sz = FixedMalloc::kLargestAlloc;
+        sz = sz - DebugSize();
+// line 131 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+        sz = sz + DebugSize();
+// line 134 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test6() {
+    {
+        size_t sz = FixedMalloc::kLargestAlloc+1;
+        sz = sz - DebugSize();
+// line 142 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+        sz = sz + DebugSize();
+// line 145 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test7() {
+    {
+        size_t sz = GCHeap::kBlockSize-1;
+        sz = sz - DebugSize();
+// line 153 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+        sz = sz + DebugSize();
+// line 156 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test8() {
+    {
+        size_t sz = GCHeap::kBlockSize;
+        sz = sz - DebugSize();
+// line 164 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+        sz = sz + DebugSize();
+// line 167 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test9() {
+    {
+        size_t sz = GCHeap::kBlockSize+1;
+        sz = sz - DebugSize();
+// line 175 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+        sz = sz + DebugSize();
+// line 178 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test10() {
+    {
+        size_t sz = GCHeap::kBlockSize*2;
+        sz = sz - DebugSize();
+// line 186 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+        sz = sz + DebugSize();
+// line 189 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void ST_mmgc_fixedmalloc_findbeginning::test11() {
+    {
+        size_t sz = GCHeap::kBlockSize*10;
+        sz = sz - DebugSize();
+// line 197 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+        sz = sz + DebugSize();
+// line 200 "ST_mmgc_fixedmalloc_findbeginning.st"
+verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
+              ;
+    }
+
+}
+void create_mmgc_fixedmalloc_findbeginning(AvmCore* core) { new ST_mmgc_fixedmalloc_findbeginning(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_gcheap.st
+// -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_gcheap {
+class ST_mmgc_gcheap : public Selftest {
+public:
+ST_mmgc_gcheap(AvmCore* core);
+virtual void run(int n);
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+};
+ST_mmgc_gcheap::ST_mmgc_gcheap(AvmCore* core)
+    : Selftest(core, "mmgc", "gcheap", ST_mmgc_gcheap::ST_names,ST_mmgc_gcheap::ST_explicits)
+{}
+const char* ST_mmgc_gcheap::ST_names[] = {"largeAlloc","largeAllocAlignment", NULL };
+const bool ST_mmgc_gcheap::ST_explicits[] = {false,false, false };
+void ST_mmgc_gcheap::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+}
+}
+using namespace MMgc;
+
+void ST_mmgc_gcheap::test0() {
+       GCHeap *heap = GCHeap::GetGCHeap();
+       for(int i=1;i<4;i++) {
+          void *item = heap->GetPartition(MMgc::kAVMShellHeapPartition)->Alloc(GCHeap::kOSAllocThreshold*i);
+// line 17 "ST_mmgc_gcheap.st"
+verifyPass(heap->GetPartition(MMgc::kAVMShellHeapPartition)->Size(item) == GCHeap::kOSAllocThreshold*i, "heap->GetPartition(MMgc::kAVMShellHeapPartition)->Size(item) == GCHeap::kOSAllocThreshold*i", __FILE__, __LINE__);
+          heap->GetPartition(MMgc::kAVMShellHeapPartition)->Free(item);
+       }
+// line 20 "ST_mmgc_gcheap.st"
+verifyPass(true, "true", __FILE__, __LINE__);
+
+}
+void ST_mmgc_gcheap::test1() {
+       GCHeap *heap = GCHeap::GetGCHeap();
+       for(int i=1;i<10;i++) {
+          void *item = heap->GetPartition(MMgc::kAVMShellHeapPartition)->Alloc(GCHeap::kOSAllocThreshold*i, GCHeap::flags_Alloc, 1<<i);
+// line 26 "ST_mmgc_gcheap.st"
+verifyPass(heap->GetPartition(MMgc::kAVMShellHeapPartition)->Size(item) == GCHeap::kOSAllocThreshold*i, "heap->GetPartition(MMgc::kAVMShellHeapPartition)->Size(item) == GCHeap::kOSAllocThreshold*i", __FILE__, __LINE__);
+// line 27 "ST_mmgc_gcheap.st"
+verifyPass(uintptr_t(((GCHeap::kBlockSize<<(i-1))-1) & uintptr_t(item)) == 0, "uintptr_t(((GCHeap::kBlockSize<<(i-1))-1) & uintptr_t(item)) == 0", __FILE__, __LINE__);
+          heap->GetPartition(MMgc::kAVMShellHeapPartition)->Free(item);
+       }
+
+
+}
+void create_mmgc_gcheap(AvmCore* core) { new ST_mmgc_gcheap(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_gcoption.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_gcoption {
+using namespace MMgc;
+
+class ST_mmgc_gcoption : public Selftest {
+public:
+ST_mmgc_gcoption(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+void test2();
+void test3();
+void test4();
+void test5();
+void test6();
+void test7();
+    bool m_ret;
+    bool m_wrong;
+    GCHeap *m_heap;
+    GCHeapConfig m_config_orig;
+    bool isParamOption(const char* line) {
+        return m_heap->config.IsGCOptionWithParam(line);
+    }
+    bool notParamOption(const char* line) {
+        return !isParamOption(line);
+    }
+    bool approxEqual(double x, double y) {
+        double delta1 = x - y;
+        // abs() does not produce correct results at e.g. DBL_MAX.
+        double delta2 = (delta1 > 0) ? delta1 : -delta1;
+        return (delta2 < 0.0001);
+    }
+    void parseApply(const char* line, const char* optExtra=0)
+    {
+        m_ret = m_heap->config.ParseAndApplyOption(line, m_wrong, optExtra);
+    }
+    bool parsedCorrectly() {
+        return m_ret && !m_wrong;
+    }
+    bool gcoptionButIncorrectFormat() {
+        return m_ret && m_wrong;
+    }
+
+    void saveOrigHeapConfig() {
+        memcpy(&m_config_orig, &m_heap->config, sizeof(GCHeapConfig));
+    }
+
+    void restoreHeapConfig() {
+        memcpy(&m_heap->config, &m_config_orig, sizeof(GCHeapConfig));
+    }
+
+    bool configUnchanged() {
+        const char* c1 = (const char*)&m_heap->config;
+        const char* c2 = (const char*)&m_config_orig;
+        bool noChangeSeen = true;
+        for (size_t i=0; i < sizeof(GCHeapConfig); i++) {
+            if (*c1 != *c2)
+                noChangeSeen = false;
+        }
+        return noChangeSeen;
+    }
+
+};
+ST_mmgc_gcoption::ST_mmgc_gcoption(AvmCore* core)
+    : Selftest(core, "mmgc", "gcoption", ST_mmgc_gcoption::ST_names,ST_mmgc_gcoption::ST_explicits)
+{}
+const char* ST_mmgc_gcoption::ST_names[] = {"detect_parameterized_options","parse_memstats","parse_memlimit","parse_gcbehavior_gcsummary_eagersweep","parse_hugepages_numabind","parse_asyncdecommit_hysteresis","parse_load_gcwork","parse_gcpause", NULL };
+const bool ST_mmgc_gcoption::ST_explicits[] = {false,false,false,false,false,false,false,false, false };
+void ST_mmgc_gcoption::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+case 2: test2(); return;
+case 3: test3(); return;
+case 4: test4(); return;
+case 5: test5(); return;
+case 6: test6(); return;
+case 7: test7(); return;
+}
+}
+void ST_mmgc_gcoption::prologue() {
+{
+    m_heap = GCHeap::GetGCHeap();
+    saveOrigHeapConfig();
+}
+
+}
+void ST_mmgc_gcoption::epilogue() {
+{
+    restoreHeapConfig();
+}
+
+}
+void ST_mmgc_gcoption::test0() {
+{
+// line 75 "ST_mmgc_gcoption.st"
+verifyPass(isParamOption("-memlimit"), "isParamOption(\"-memlimit\")", __FILE__, __LINE__);
+// line 76 "ST_mmgc_gcoption.st"
+verifyPass(isParamOption("-load"), "isParamOption(\"-load\")", __FILE__, __LINE__);
+// line 77 "ST_mmgc_gcoption.st"
+verifyPass(isParamOption("-loadCeiling"), "isParamOption(\"-loadCeiling\")", __FILE__, __LINE__);
+// line 78 "ST_mmgc_gcoption.st"
+verifyPass(isParamOption("-gcwork"), "isParamOption(\"-gcwork\")", __FILE__, __LINE__);
+// line 79 "ST_mmgc_gcoption.st"
+verifyPass(isParamOption("-gcpause"), "isParamOption(\"-gcpause\")", __FILE__, __LINE__);
+// line 80 "ST_mmgc_gcoption.st"
+verifyPass(isParamOption("-gcstack"), "isParamOption(\"-gcstack\")", __FILE__, __LINE__);
+// line 81 "ST_mmgc_gcoption.st"
+verifyPass(isParamOption("-decommithysteresis"), "isParamOption(\"-decommithysteresis\")", __FILE__, __LINE__);
+
+// line 83 "ST_mmgc_gcoption.st"
+verifyPass(notParamOption("-memlimit=10"), "notParamOption(\"-memlimit=10\")", __FILE__, __LINE__);
+// line 84 "ST_mmgc_gcoption.st"
+verifyPass(notParamOption("-load 1.5"), "notParamOption(\"-load 1.5\")", __FILE__, __LINE__);
+// line 85 "ST_mmgc_gcoption.st"
+verifyPass(notParamOption("-loadCeiling 1.5"), "notParamOption(\"-loadCeiling 1.5\")", __FILE__, __LINE__);
+// line 86 "ST_mmgc_gcoption.st"
+verifyPass(notParamOption("-gcwork 1.5"), "notParamOption(\"-gcwork 1.5\")", __FILE__, __LINE__);
+// line 87 "ST_mmgc_gcoption.st"
+verifyPass(notParamOption("-gcpause 2"), "notParamOption(\"-gcpause 2\")", __FILE__, __LINE__);
+// line 88 "ST_mmgc_gcoption.st"
+verifyPass(notParamOption("-gcstack 10"), "notParamOption(\"-gcstack 10\")", __FILE__, __LINE__);
+
+// line 90 "ST_mmgc_gcoption.st"
+verifyPass(notParamOption("-not_an_option_and_never_will_be"), "notParamOption(\"-not_an_option_and_never_will_be\")", __FILE__, __LINE__);
+// line 91 "ST_mmgc_gcoption.st"
+verifyPass(notParamOption("-not_an_option_and_never_will_be 10"), "notParamOption(\"-not_an_option_and_never_will_be 10\")", __FILE__, __LINE__);
+// line 92 "ST_mmgc_gcoption.st"
+verifyPass(notParamOption("-not_an_option_and_never_will_be=10"), "notParamOption(\"-not_an_option_and_never_will_be=10\")", __FILE__, __LINE__);
+          ;
+}
+
+}
+void ST_mmgc_gcoption::test1() {
+{
+    // sanity checks:
+    // - make sure our configUnchanged check is sane
+    // - make sure our restoreHeapConfig works.
+// line 101 "ST_mmgc_gcoption.st"
+verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
+    memset(&m_heap->config, 0xfe, sizeof(GCHeapConfig));
+// line 103 "ST_mmgc_gcoption.st"
+verifyPass(!configUnchanged(), "!configUnchanged()", __FILE__, __LINE__);
+    restoreHeapConfig();
+// line 105 "ST_mmgc_gcoption.st"
+verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
+          ;
+
+    parseApply("-memstats");
+// line 109 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 110 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.gcstats && m_heap->config.autoGCStats, "m_heap->config.gcstats && m_heap->config.autoGCStats", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-memstats-verbose");
+// line 115 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 116 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.gcstats && m_heap->config.autoGCStats && m_heap->config.verbose, "m_heap->config.gcstats && m_heap->config.autoGCStats && m_heap->config.verbose", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+}
+}
+void ST_mmgc_gcoption::test2() {
+{
+    parseApply("-memlimit   10");
+// line 123 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 124 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.heapLimit == 10, "m_heap->config.heapLimit == 10", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-memlimit=11");
+// line 129 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 130 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.heapLimit == 11, "m_heap->config.heapLimit == 11", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-memlimit = 12");
+// line 135 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 136 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.heapLimit == 12, "m_heap->config.heapLimit == 12", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-memlimit");
+// line 141 "ST_mmgc_gcoption.st"
+verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
+// line 142 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.heapLimit == m_config_orig.heapLimit, "m_heap->config.heapLimit == m_config_orig.heapLimit", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-memlimit", "13");
+// line 147 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 148 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.heapLimit == 13, "m_heap->config.heapLimit == 13", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+}
+}
+void ST_mmgc_gcoption::test3() {
+{
+#ifdef MMGC_POLICY_PROFILING
+    parseApply("-gcbehavior");
+// line 156 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 157 "ST_mmgc_gcoption.st"
+verifyPass((m_heap->config.gcbehavior == 2), "(m_heap->config.gcbehavior == 2)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-gcsummary");
+// line 162 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 163 "ST_mmgc_gcoption.st"
+verifyPass((m_heap->config.gcbehavior == 1), "(m_heap->config.gcbehavior == 1)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+#endif
+
+    parseApply("-eagersweep");
+// line 169 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 170 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.eagerSweeping, "m_heap->config.eagerSweeping", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+}
+}
+void ST_mmgc_gcoption::test4() {
+{
+    parseApply("-hugepages");
+// line 177 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 178 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.hugePages, "m_heap->config.hugePages", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-numabind");
+// line 183 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 184 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.numaBind, "m_heap->config.numaBind", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+}
+}
+void ST_mmgc_gcoption::test5() {
+{
+    parseApply("-asyncdecommit");
+// line 191 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 192 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.asyncDecommit, "m_heap->config.asyncDecommit", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-decommithysteresis", "3");
+// line 197 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 198 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.decommitHysteresis == 3, "m_heap->config.decommitHysteresis == 3", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-decommithysteresis=0");
+// line 203 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 204 "ST_mmgc_gcoption.st"
+verifyPass(m_heap->config.decommitHysteresis == 0, "m_heap->config.decommitHysteresis == 0", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-decommithysteresis", "-1");
+// line 209 "ST_mmgc_gcoption.st"
+verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-decommithysteresis", "2x");
+// line 214 "ST_mmgc_gcoption.st"
+verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+}
+}
+void ST_mmgc_gcoption::test6() {
+{
+    parseApply("-load 7.0");
+// line 221 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 222 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoad[0], 7.0), "approxEqual(m_heap->config.gcLoad[0], 7.0)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    // test load with '<space><param>'
+    parseApply("-load 6.0,10,5.0");
+// line 228 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 229 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoad[0], 6.0), "approxEqual(m_heap->config.gcLoad[0], 6.0)", __FILE__, __LINE__);
+// line 230 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoadCutoff[0], 10.0), "approxEqual(m_heap->config.gcLoadCutoff[0], 10.0)", __FILE__, __LINE__);
+// line 231 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoad[1], 5.0), "approxEqual(m_heap->config.gcLoad[1], 5.0)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    // test load with separate <param>
+    parseApply("-load", "8.0,20.5,7.0");
+// line 237 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 238 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoad[0], 8.0), "approxEqual(m_heap->config.gcLoad[0], 8.0)", __FILE__, __LINE__);
+// line 239 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoadCutoff[0], 20.5), "approxEqual(m_heap->config.gcLoadCutoff[0], 20.5)", __FILE__, __LINE__);
+// line 240 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoad[1], 7.0), "approxEqual(m_heap->config.gcLoad[1], 7.0)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    // test load with '=<param>'
+    parseApply("-load=10.0,30.5,9.0");
+// line 246 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 247 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoad[0], 10.0), "approxEqual(m_heap->config.gcLoad[0], 10.0)", __FILE__, __LINE__);
+// line 248 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoadCutoff[0], 30.5), "approxEqual(m_heap->config.gcLoadCutoff[0], 30.5)", __FILE__, __LINE__);
+// line 249 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoad[1], 9.0), "approxEqual(m_heap->config.gcLoad[1], 9.0)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    // Max load pairs is 7
+    parseApply("-load 1.5,1.5,2,2,3,3,4,4,5,5,6,6,7,7,8,8");
+// line 255 "ST_mmgc_gcoption.st"
+verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
+// line 256 "ST_mmgc_gcoption.st"
+verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
+    restoreHeapConfig();
+
+    // Ensure that the last load value is ignored
+    parseApply("-load=10.0,30.0,9.0,60.0");
+// line 261 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 262 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoad[0], 10.0), "approxEqual(m_heap->config.gcLoad[0], 10.0)", __FILE__, __LINE__);
+// line 263 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoadCutoff[0], 30.0), "approxEqual(m_heap->config.gcLoadCutoff[0], 30.0)", __FILE__, __LINE__);
+// line 264 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoad[1], 9.0), "approxEqual(m_heap->config.gcLoad[1], 9.0)", __FILE__, __LINE__);
+// line 265 "ST_mmgc_gcoption.st"
+verifyPass(!approxEqual(m_heap->config.gcLoadCutoff[1], 60.0), "!approxEqual(m_heap->config.gcLoadCutoff[1], 60.0)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-load");
+// line 270 "ST_mmgc_gcoption.st"
+verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
+// line 271 "ST_mmgc_gcoption.st"
+verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    // L (load) must be > 1
+    parseApply("-load 1,30");
+// line 277 "ST_mmgc_gcoption.st"
+verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
+// line 278 "ST_mmgc_gcoption.st"
+verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-load badvalue");
+// line 283 "ST_mmgc_gcoption.st"
+verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
+// line 284 "ST_mmgc_gcoption.st"
+verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+
+    parseApply("-loadCeiling 11.5");
+// line 290 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 291 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcLoadCeiling, 11.5), "approxEqual(m_heap->config.gcLoadCeiling, 11.5)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-gcwork 12.5");
+// line 296 "ST_mmgc_gcoption.st"
+verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-gcwork 0.123456");
+// line 301 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 302 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcEfficiency, .123456), "approxEqual(m_heap->config.gcEfficiency, .123456)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-gcwork=0.23456");
+// line 307 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 308 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcEfficiency, .23456), "approxEqual(m_heap->config.gcEfficiency, .23456)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-gcwork", "0.3456");
+// line 313 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 314 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcEfficiency, .3456), "approxEqual(m_heap->config.gcEfficiency, .3456)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+}
+}
+void ST_mmgc_gcoption::test7() {
+{
+    parseApply("-gcpause 2");
+// line 322 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 323 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcPauseTarget, 2.0), "approxEqual(m_heap->config.gcPauseTarget, 2.0)", __FILE__, __LINE__);
+// line 324 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcOverheadTarget, m_config_orig.gcOverheadTarget), "approxEqual(m_heap->config.gcOverheadTarget, m_config_orig.gcOverheadTarget)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-gcpause=1.5,0.25");
+// line 329 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 330 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcPauseTarget, 1.5), "approxEqual(m_heap->config.gcPauseTarget, 1.5)", __FILE__, __LINE__);
+// line 331 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcOverheadTarget, 0.25), "approxEqual(m_heap->config.gcOverheadTarget, 0.25)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-gcpause", "0.5,2");
+// line 336 "ST_mmgc_gcoption.st"
+verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
+// line 337 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcPauseTarget, 0.5), "approxEqual(m_heap->config.gcPauseTarget, 0.5)", __FILE__, __LINE__);
+// line 338 "ST_mmgc_gcoption.st"
+verifyPass(approxEqual(m_heap->config.gcOverheadTarget, 2.0), "approxEqual(m_heap->config.gcOverheadTarget, 2.0)", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-gcpause 0");
+// line 343 "ST_mmgc_gcoption.st"
+verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
+// line 344 "ST_mmgc_gcoption.st"
+verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+
+    parseApply("-gcpause 2,badvalue");
+// line 349 "ST_mmgc_gcoption.st"
+verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
+// line 350 "ST_mmgc_gcoption.st"
+verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
+          ;
+    restoreHeapConfig();
+}
+
+}
+void create_mmgc_gcoption(AvmCore* core) { new ST_mmgc_gcoption(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_generational.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Generational mode (GCConfig::generational): a minor collection must keep young
+// objects that are reachable only from old objects modified through the write
+// barrier, must reclaim young garbage, and must leave old garbage to the next
+// major collection.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_generational {
+using namespace MMgc;
+
+class Node : public GCFinalizedObject
+{
+public:
+    Node(int key) : key(key) {}
+    ~Node() { key = -1; }
+    int key;
+    GCMember<Node> next;
+};
+
+static const int kNumNodes = 100;
+
+// The collections below don't scan the stack, so everything the tests look at
+// after a collection is held here.
+struct NodeRoot : public GCRoot
+{
+    NodeRoot(GC* gc) : GCRoot(gc)
+    {
+        VMPI_memset(nodes, 0, sizeof(nodes));
+        VMPI_memset(refs, 0, sizeof(refs));
+    }
+    Node* nodes[kNumNodes];
+    GCWeakRef* refs[kNumNodes];
+};
+
+class ST_mmgc_generational : public Selftest {
+public:
+ST_mmgc_generational(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+private:
+    MMgc::GC *gc;
+
+    bool collect(bool major)
+    {
+        gc->m_majorCollectionRequested = major;
+        gc->StartIncrementalMark();
+        bool minor = gc->m_minorCollection;
+        gc->FinishIncrementalMark(false);
+        return minor == !major;
+    }
+
+};
+ST_mmgc_generational::ST_mmgc_generational(AvmCore* core)
+    : Selftest(core, "mmgc", "generational", ST_mmgc_generational::ST_names,ST_mmgc_generational::ST_explicits)
+{}
+const char* ST_mmgc_generational::ST_names[] = {"minor","major", NULL };
+const bool ST_mmgc_generational::ST_explicits[] = {false,false, false };
+void ST_mmgc_generational::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+}
+}
+void ST_mmgc_generational::prologue() {
+    GCConfig config;
+    config.generational = true;
+    gc = new GC(GCHeap::GetGCHeap(), config);
+
+}
+void ST_mmgc_generational::epilogue() {
+    delete gc;
+
+}
+void ST_mmgc_generational::test0() {
+{
+    MMGC_GCENTER(gc);
+
+    NodeRoot* root = new NodeRoot(gc);
+    for ( int i=0 ; i < kNumNodes ; i++ )
+        root->nodes[i] = new (gc) Node(i);
+
+// line 72 "ST_mmgc_generational.st"
+verifyPass(collect(true), "collect(true)", __FILE__, __LINE__);
+
+    // The nodes are old now.  Hang young nodes off them through the write barrier,
+    // and create young garbage.
+
+    for ( int i=0 ; i < kNumNodes ; i++ ) {
+        root->nodes[i]->next = new (gc) Node(1000 + i);
+        root->refs[i] = (new (gc) Node(2000 + i))->GetWeakRef();
+    }
+
+// line 82 "ST_mmgc_generational.st"
+verifyPass(collect(false), "collect(false)", __FILE__, __LINE__);
+
+    bool ok = true;
+    for ( int i=0 ; i < kNumNodes ; i++ ) {
+        if (root->nodes[i]->key != i || root->nodes[i]->next->key != 1000 + i)
+            ok = false;
+        if (root->refs[i]->get() != NULL)
+            ok = false;
+    }
+// line 91 "ST_mmgc_generational.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+
+    // The young nodes have been promoted: a further minor collection neither
+    // traces nor frees them.
+
+    for ( int i=0 ; i < kNumNodes ; i++ )
+        root->refs[i] = root->nodes[i]->next->GetWeakRef();
+
+// line 99 "ST_mmgc_generational.st"
+verifyPass(collect(false), "collect(false)", __FILE__, __LINE__);
+
+    ok = true;
+    for ( int i=0 ; i < kNumNodes ; i++ )
+        if ((void*)root->refs[i]->get() != (void*)root->nodes[i]->next || root->nodes[i]->next->key != 1000 + i)
+            ok = false;
+// line 105 "ST_mmgc_generational.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+
+    delete root;
+}
+
+}
+void ST_mmgc_generational::test1() {
+{
+    MMGC_GCENTER(gc);
+
+    NodeRoot* root = new NodeRoot(gc);
+    for ( int i=0 ; i < kNumNodes ; i++ ) {
+        root->nodes[i] = new (gc) Node(i);
+        root->refs[i] = root->nodes[i]->GetWeakRef();
+    }
+
+// line 120 "ST_mmgc_generational.st"
+verifyPass(collect(true), "collect(true)", __FILE__, __LINE__);
+
+    // Drop every other old node.  A minor collection does not reclaim them; a
+    // major collection does.
+
+    for ( int i=0 ; i < kNumNodes ; i+=2 )
+        root->nodes[i] = NULL;
+
+// line 128 "ST_mmgc_generational.st"
+verifyPass(collect(false), "collect(false)", __FILE__, __LINE__);
+
+    bool ok = true;
+    for ( int i=0 ; i < kNumNodes ; i++ )
+        if (root->refs[i]->get() == NULL)
+            ok = false;
+// line 134 "ST_mmgc_generational.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+
+// line 136 "ST_mmgc_generational.st"
+verifyPass(collect(true), "collect(true)", __FILE__, __LINE__);
+
+    ok = true;
+    for ( int i=0 ; i < kNumNodes ; i++ ) {
+        if ((root->refs[i]->get() == NULL) != (i % 2 == 0))
+            ok = false;
+        if (i % 2 == 1 && root->nodes[i]->key != i)
+            ok = false;
+    }
+// line 145 "ST_mmgc_generational.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+
+    delete root;
+}
+
+}
+void create_mmgc_generational(AvmCore* core) { new ST_mmgc_generational(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_grouphashtable.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// GCGroupHashtable, checked against GCHashtable: random insertions and removals,
+// removal of the current key during iteration (as GC::MarkOrClearWeakRefs does),
+// shrinking, and other key handlers and value types.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_grouphashtable {
+using namespace MMgc;
+
+class ST_mmgc_grouphashtable : public Selftest {
+public:
+ST_mmgc_grouphashtable(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+void test2();
+void test3();
+void test4();
+void test5();
+private:
+    uint32_t seed;
+
+    uint32_t random()
+    {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+    }
+
+    static const void* key(uint32_t i) { return (const void*)(uintptr_t(i + 1) * 8); }
+    static const void* value(uint32_t i) { return (const void*)(uintptr_t(i) * 2 + 1); }
+
+    // True if 'table' holds exactly the entries of 'oracle'.
+    bool same(GCGroupHashtable& table, GCHashtable& oracle, uint32_t numKeys)
+    {
+        if (table.count() != oracle.count())
+            return false;
+        for (uint32_t i=0; i < numKeys; i++) {
+            if (table.get(key(i)) != oracle.get(key(i)))
+                return false;
+        }
+        return true;
+    }
+
+};
+ST_mmgc_grouphashtable::ST_mmgc_grouphashtable(AvmCore* core)
+    : Selftest(core, "mmgc", "grouphashtable", ST_mmgc_grouphashtable::ST_names,ST_mmgc_grouphashtable::ST_explicits)
+{}
+const char* ST_mmgc_grouphashtable::ST_names[] = {"random","clusters","iterate","prune","empty","handlers", NULL };
+const bool ST_mmgc_grouphashtable::ST_explicits[] = {false,false,false,false,false,false, false };
+void ST_mmgc_grouphashtable::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+case 2: test2(); return;
+case 3: test3(); return;
+case 4: test4(); return;
+case 5: test5(); return;
+}
+}
+void ST_mmgc_grouphashtable::prologue() {
+    seed = 1;
+
+}
+void ST_mmgc_grouphashtable::test0() {
+{
+    GCGroupHashtable table;
+    GCHashtable oracle;
+    const uint32_t numKeys = 5000;
+    bool ok = true;
+    for (int round=0; round < 20 && ok; round++) {
+        for (int n=0; n < 2000; n++) {
+            uint32_t i = random() % numKeys;
+            if (random() % 3 == 0) {
+                ok = ok && table.remove(key(i), (random() & 1) != 0) == oracle.remove(key(i));
+            } else {
+                table.put(key(i), value(i + round));
+                oracle.put(key(i), value(i + round));
+            }
+        }
+        ok = ok && same(table, oracle, numKeys);
+    }
+// line 64 "ST_mmgc_grouphashtable.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+}
+
+}
+void ST_mmgc_grouphashtable::test1() {
+{
+    // Keys 4096 apart share their low bits, which makes for long clusters that
+    // wrap around the end of the table.
+    GCGroupHashtable table(16);
+    const uint32_t n = 200;
+    for (uint32_t i=0; i < n; i++)
+        table.put((const void*)(uintptr_t(i + 1) << 12), value(i));
+    bool ok = table.count() == n;
+    for (uint32_t i=0; i < n; i += 2)
+        ok = ok && table.remove((const void*)(uintptr_t(i + 1) << 12), false) == value(i);
+    for (uint32_t i=0; i < n; i++)
+        ok = ok && table.get((const void*)(uintptr_t(i + 1) << 12)) == ((i & 1) ? value(i) : NULL);
+// line 80 "ST_mmgc_grouphashtable.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+// line 81 "ST_mmgc_grouphashtable.st"
+verifyPass(table.count() == n/2, "table.count() == n/2", __FILE__, __LINE__);
+}
+
+}
+void ST_mmgc_grouphashtable::test2() {
+{
+    GCGroupHashtable table;
+    GCHashtable visits;
+    const uint32_t numKeys = 3000;
+    for (uint32_t i=0; i < numKeys; i++)
+        table.put(key(i), value(i));
+    uint32_t removed = 0;
+    {
+        GCGroupHashtable::Iterator it(&table);
+        const void* k;
+        while ((k = it.nextKey()) != NULL) {
+            visits.put(k, (const void*)(uintptr_t(visits.get(k)) + 1));
+            uint32_t i = uint32_t(uintptr_t(k) / 8 - 1);
+            if (it.value() != value(i))
+                break;
+            if ((i % 3) != 0) {
+                table.remove(k, false);
+                removed++;
+            }
+        }
+    }
+    bool once = visits.count() == numKeys;
+    for (uint32_t i=0; i < numKeys; i++)
+        once = once && visits.get(key(i)) == (const void*)1;
+// line 109 "ST_mmgc_grouphashtable.st"
+verifyPass(once, "once", __FILE__, __LINE__);
+// line 110 "ST_mmgc_grouphashtable.st"
+verifyPass(table.count() == numKeys - removed, "table.count() == numKeys - removed", __FILE__, __LINE__);
+    bool ok = true;
+    for (uint32_t i=0; i < numKeys; i++)
+        ok = ok && table.get(key(i)) == ((i % 3) == 0 ? value(i) : NULL);
+// line 114 "ST_mmgc_grouphashtable.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+}
+
+}
+void ST_mmgc_grouphashtable::test3() {
+{
+    GCGroupHashtable table;
+    for (uint32_t i=0; i < 10000; i++)
+        table.put(key(i), value(i));
+    uint64_t full = table.bytesUsed();
+    for (uint32_t i=100; i < 10000; i++)
+        table.remove(key(i), false);
+// line 125 "ST_mmgc_grouphashtable.st"
+verifyPass(table.bytesUsed() == full, "table.bytesUsed() == full", __FILE__, __LINE__);
+    table.prune();
+// line 127 "ST_mmgc_grouphashtable.st"
+verifyPass(table.bytesUsed() < full / 16, "table.bytesUsed() < full / 16", __FILE__, __LINE__);
+    bool ok = table.count() == 100;
+    for (uint32_t i=0; i < 100; i++)
+        ok = ok && table.get(key(i)) == value(i);
+// line 131 "ST_mmgc_grouphashtable.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+    table.clear();
+// line 133 "ST_mmgc_grouphashtable.st"
+verifyPass(table.count() == 0 && table.get(key(0)) == NULL, "table.count() == 0 && table.get(key(0)) == NULL", __FILE__, __LINE__);
+    table.put(key(0), value(0));
+// line 135 "ST_mmgc_grouphashtable.st"
+verifyPass(table.get(key(0)) == value(0), "table.get(key(0)) == value(0)", __FILE__, __LINE__);
+}
+
+}
+void ST_mmgc_grouphashtable::test4() {
+{
+    GCGroupHashtable table(0);
+// line 141 "ST_mmgc_grouphashtable.st"
+verifyPass(table.count() == 0 && table.get(key(0)) == NULL && table.remove(key(0)) == NULL, "table.count() == 0 && table.get(key(0)) == NULL && table.remove(key(0)) == NULL", __FILE__, __LINE__);
+    {
+        GCGroupHashtable::Iterator it(&table);
+// line 144 "ST_mmgc_grouphashtable.st"
+verifyPass(it.nextKey() == NULL, "it.nextKey() == NULL", __FILE__, __LINE__);
+// line 145 "ST_mmgc_grouphashtable.st"
+verifyPass(it.nextKey() == NULL, "it.nextKey() == NULL", __FILE__, __LINE__);
+    }
+// line 147 "ST_mmgc_grouphashtable.st"
+verifyPass(table.nextIndex(0) == 0, "table.nextIndex(0) == 0", __FILE__, __LINE__);
+    table.put(key(7), value(7));
+    int32_t i = table.nextIndex(0);
+// line 150 "ST_mmgc_grouphashtable.st"
+verifyPass(i != 0 && table.keyAt(i-1) == key(7) && table.valueAt(i-1) == value(7), "i != 0 && table.keyAt(i-1) == key(7) && table.valueAt(i-1) == value(7)", __FILE__, __LINE__);
+// line 151 "ST_mmgc_grouphashtable.st"
+verifyPass(table.nextIndex(i) == 0, "table.nextIndex(i) == 0", __FILE__, __LINE__);
+}
+
+}
+void ST_mmgc_grouphashtable::test5() {
+{
+    GCGroupHashtableBase<const void*, GCStringHashtableKeyHandler, GCHashtableAllocHandler_VMPI> strings;
+    const char* a = "alpha";
+    const char* b = "beta";
+    strings.put(a, value(1));
+    strings.put(b, value(2));
+// line 161 "ST_mmgc_grouphashtable.st"
+verifyPass(strings.get(a) == value(1), "strings.get(a) == value(1)", __FILE__, __LINE__);
+// line 162 "ST_mmgc_grouphashtable.st"
+verifyPass(strings.remove(a) == value(1), "strings.remove(a) == value(1)", __FILE__, __LINE__);
+// line 163 "ST_mmgc_grouphashtable.st"
+verifyPass(strings.get(a) == NULL && strings.get(b) == value(2), "strings.get(a) == NULL && strings.get(b) == value(2)", __FILE__, __LINE__);
+
+    GCGroupHashtableBase<uint64_t, GCHashtableKeyHandler, GCHashtableAllocHandler_VMPI> numbers;
+    numbers.put(key(1), uint64_t(1) << 40);
+// line 167 "ST_mmgc_grouphashtable.st"
+verifyPass(numbers.get(key(1)) == uint64_t(1) << 40, "numbers.get(key(1)) == uint64_t(1) << 40", __FILE__, __LINE__);
+// line 168 "ST_mmgc_grouphashtable.st"
+verifyPass(numbers.get(key(2)) == 0, "numbers.get(key(2)) == 0", __FILE__, __LINE__);
+}
+
+}
+void create_mmgc_grouphashtable(AvmCore* core) { new ST_mmgc_grouphashtable(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_heapsnapshot.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// The heap snapshot (GC::WriteHeapSnapshot): the file is read back and the
+// records of a small rooted graph are checked.  The GCs have no AvmCore, so the
+// objects are conservatively traced and typed by how they are traced.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_heapsnapshot {
+using namespace MMgc;
+
+class ST_mmgc_heapsnapshot : public Selftest {
+public:
+ST_mmgc_heapsnapshot(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+private:
+    MMgc::GC *gc;
+
+    // What was found in the snapshot.
+    bool valid;
+    uint64_t numObjects;
+    uint64_t numEdges;
+    bool rootEdge;          // The root references 'a'
+    bool objectEdge;        // 'a' references 'b'
+    uint64_t aType, aFlags, bType, bSize;
+
+    uint64_t readUnsigned(const uint8_t*& p, const uint8_t* limit)
+    {
+        uint64_t v = 0;
+        for ( int shift=0 ; p < limit ; shift += 7 ) {
+            uint8_t b = *p++;
+            v |= uint64_t(b & 0x7f) << shift;
+            if (b < 0x80)
+                return v;
+        }
+        valid = false;
+        return 0;
+    }
+
+    uintptr_t readAddress(const uint8_t*& p, const uint8_t* limit, uintptr_t base)
+    {
+        uint64_t v = readUnsigned(p, limit);
+        return base + uintptr_t((v >> 1) ^ (0 - (v & 1)));
+    }
+
+    // The snapshot is written to the current directory and removed when read.
+    static const char* file() { return "ST_mmgc_heapsnapshot.tmp"; }
+
+    // Reads file(), looking for the root at 'root' and the objects 'a' and 'b'.
+    void readSnapshot(const void* root, const void* a, const void* b)
+    {
+        valid = false;
+        numObjects = numEdges = 0;
+        rootEdge = objectEdge = false;
+        aType = aFlags = bType = bSize = 0;
+
+        FILE* fp = fopen(file(), "rb");
+        if (fp == NULL)
+            return;
+        fseek(fp, 0, SEEK_END);
+        long length = ftell(fp);
+        fseek(fp, 0, SEEK_SET);
+        uint8_t* data = new uint8_t[length];
+        size_t got = fread(data, 1, length, fp);
+        fclose(fp);
+        remove(file());
+
+        const uint8_t* p = data;
+        const uint8_t* limit = data + got;
+        valid = got > 8 && VMPI_memcmp(data, "AVMHEAP\0", 8) == 0;
+        p += 8;
+        if (valid && readUnsigned(p, limit) != HeapSnapshotWriter::kVersion)
+            valid = false;
+
+        uintptr_t source = 0, previous = 0;
+        uint64_t edges = 0;
+        bool end = false;
+        while (valid && !end && p < limit) {
+            uint8_t tag = *p++;
+            if (tag == 'T') {
+                readUnsigned(p, limit);
+                p += readUnsigned(p, limit);
+            }
+            else if (tag == 'R') {
+                readUnsigned(p, limit);
+                source = readAddress(p, limit, 0);
+            }
+            else if (tag == 'O') {
+                source = previous = readAddress(p, limit, previous);
+                uint64_t size = readUnsigned(p, limit);
+                uint64_t type = readUnsigned(p, limit);
+                uint64_t flags = readUnsigned(p, limit);
+                if (source == uintptr_t(a)) {
+                    aType = type;
+                    aFlags = flags;
+                }
+                if (source == uintptr_t(b)) {
+                    bType = type;
+                    bSize = size;
+                }
+                numObjects++;
+            }
+            else if (tag == 'E') {
+                uintptr_t target = readAddress(p, limit, source);
+                if (source == uintptr_t(root) && target == uintptr_t(a))
+                    rootEdge = true;
+                if (source == uintptr_t(a) && target == uintptr_t(b))
+                    objectEdge = true;
+                edges++;
+            }
+            else if (tag == 'Z') {
+                numEdges = edges;
+                valid = readUnsigned(p, limit) == numObjects && readUnsigned(p, limit) == edges && p == limit;
+                end = true;
+            }
+            else {
+                valid = false;
+            }
+        }
+        valid = valid && end;
+        delete [] data;
+    }
+
+};
+ST_mmgc_heapsnapshot::ST_mmgc_heapsnapshot(AvmCore* core)
+    : Selftest(core, "mmgc", "heapsnapshot", ST_mmgc_heapsnapshot::ST_names,ST_mmgc_heapsnapshot::ST_explicits)
+{}
+const char* ST_mmgc_heapsnapshot::ST_names[] = {"graph","unwritable", NULL };
+const bool ST_mmgc_heapsnapshot::ST_explicits[] = {false,false, false };
+void ST_mmgc_heapsnapshot::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+}
+}
+void ST_mmgc_heapsnapshot::prologue() {
+    GCConfig config;
+    gc = new GC(GCHeap::GetGCHeap(), config);
+
+}
+void ST_mmgc_heapsnapshot::epilogue() {
+    delete gc;
+
+}
+void ST_mmgc_heapsnapshot::test0() {
+{
+    MMGC_GCENTER(gc);
+    void** a = (void**)gc->Alloc(32, GC::kContainsPointers|GC::kZero, kAVMShellGCPartition);
+    void* b = gc->Alloc(24, GC::kZero, kAVMShellGCPartition);
+    a[1] = b;
+    void* keeper[1];
+    keeper[0] = a;
+    GCRoot* root = new GCRoot(gc, keeper, sizeof(keeper));
+
+// line 144 "ST_mmgc_heapsnapshot.st"
+verifyPass(gc->WriteHeapSnapshot(file()), "gc->WriteHeapSnapshot(file())", __FILE__, __LINE__);
+    readSnapshot(keeper, a, b);
+// line 146 "ST_mmgc_heapsnapshot.st"
+verifyPass(valid, "valid", __FILE__, __LINE__);
+// line 147 "ST_mmgc_heapsnapshot.st"
+verifyPass(numObjects >= 2 && numEdges >= 2, "numObjects >= 2 && numEdges >= 2", __FILE__, __LINE__);
+// line 148 "ST_mmgc_heapsnapshot.st"
+verifyPass(rootEdge, "rootEdge", __FILE__, __LINE__);
+// line 149 "ST_mmgc_heapsnapshot.st"
+verifyPass(objectEdge, "objectEdge", __FILE__, __LINE__);
+// line 150 "ST_mmgc_heapsnapshot.st"
+verifyPass(aType == HeapSnapshotWriter::kTypeConservative, "aType == HeapSnapshotWriter::kTypeConservative", __FILE__, __LINE__);
+// line 151 "ST_mmgc_heapsnapshot.st"
+verifyPass(aFlags == HeapSnapshotWriter::kObjectConservative, "aFlags == HeapSnapshotWriter::kObjectConservative", __FILE__, __LINE__);
+// line 152 "ST_mmgc_heapsnapshot.st"
+verifyPass(bType == HeapSnapshotWriter::kTypeLeaf, "bType == HeapSnapshotWriter::kTypeLeaf", __FILE__, __LINE__);
+// line 153 "ST_mmgc_heapsnapshot.st"
+verifyPass(bSize == GC::Size(b), "bSize == GC::Size(b)", __FILE__, __LINE__);
+    delete root;
+}
+
+}
+void ST_mmgc_heapsnapshot::test1() {
+{
+    MMGC_GCENTER(gc);
+// line 160 "ST_mmgc_heapsnapshot.st"
+verifyPass(!gc->WriteHeapSnapshot("/nonexistent/directory/snapshot"), "!gc->WriteHeapSnapshot(\"/nonexistent/directory/snapshot\")", __FILE__, __LINE__);
+}
+
+}
+void create_mmgc_heapsnapshot(AvmCore* core) { new ST_mmgc_heapsnapshot(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_incweakrefs.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Incremental weak-reference processing (GCConfig::incrementalWeakRefs): the weak
+// references visited during the mark slices must be neither cleared nor lost, the
+// final pause must only look at the others, and removing entries or growing the
+// table during the visit must not make the visit miss any.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_incweakrefs {
+using namespace MMgc;
+
+class Node : public GCFinalizedObject
+{
+public:
+    Node(int key) : key(key) {}
+    ~Node() { key = -1; }
+    int key;
+};
+
+static const int kNumNodes = 2000;
+
+// The collections below don't scan the stack, so everything the tests look at
+// after a collection is held here.
+struct NodeRoot : public GCRoot
+{
+    NodeRoot(GC* gc) : GCRoot(gc)
+    {
+        VMPI_memset(nodes, 0, sizeof(nodes));
+        VMPI_memset(refs, 0, sizeof(refs));
+    }
+    Node* nodes[2*kNumNodes];
+    GCWeakRef* refs[2*kNumNodes];
+};
 
-        if (sz <= (size_t)FixedMalloc::kLargestAlloc)
-            roundup_actual_size = fm->FindAllocatorForSize(sz)->GetItemSize();
-        else
-            roundup_actual_size =
-                roundUp(sz + DebugSize(), GCHeap::kBlockSize) - DebugSize();
+class ST_mmgc_incweakrefs : public Selftest {
+public:
+ST_mmgc_incweakrefs(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+void test2();
+private:
+    MMgc::GC *gc;
 
-        if (fm->FindBeginning(probe) != realStart)
-            retval |= 1;
-        if (!fm->FindBeginningAndSize(probe, begin_recv, size_recv) ||
-            (begin_recv != realStart) ||
-            (size_recv != roundup_actual_size))
-            retval |= 3;
+    // Run mark slices until the weak references have all been visited.
+    bool visit()
+    {
+        for ( int i=0 ; i < 1000 && !gc->weakRefsVisited ; i++ )
+            gc->IncrementalMark();
+        return gc->weakRefsVisited;
+    }
 
-        return retval;
+    // Create the nodes [from,to) and weak references to them.
+    void populate(NodeRoot* root, int from, int to)
+    {
+        for ( int i=from ; i < to ; i++ ) {
+            root->nodes[i] = new (gc) Node(i);
+            root->refs[i] = root->nodes[i]->GetWeakRef();
+        }
     }
 
-    size_t roundUp(size_t s, size_t inc) {
-        return (((s + inc - 1) / inc) * inc);
+    // True if the weak references [0,to) refer to their nodes, or are cleared for
+    // the nodes that have been dropped.
+    bool check(NodeRoot* root, int to)
+    {
+        for ( int i=0 ; i < to ; i++ ) {
+            Node* n = (Node*)(void*)root->refs[i]->get();
+            if (n != root->nodes[i] || (n != NULL && n->key != i))
+                return false;
+        }
+        return true;
     }
 
 };
-ST_mmgc_fixedmalloc_findbeginning::ST_mmgc_fixedmalloc_findbeginning(AvmCore* core)
-    : Selftest(core, "mmgc", "fixedmalloc_findbeginning", ST_mmgc_fixedmalloc_findbeginning::ST_names,ST_mmgc_fixedmalloc_findbeginning::ST_explicits)
+ST_mmgc_incweakrefs::ST_mmgc_incweakrefs(AvmCore* core)
+    : Selftest(core, "mmgc", "incweakrefs", ST_mmgc_incweakrefs::ST_names,ST_mmgc_incweakrefs::ST_explicits)
 {}
-const char* ST_mmgc_fixedmalloc_findbeginning::ST_names[] = {"findbeginnings_small0","findbeginnings_small1","findbeginnings_small2","findbeginnings_small3","findbeginnings_almost_large1","findbeginnings_almost_large2","findbeginnings_large","findbeginnings_almost_multiblock1","findbeginnings_almost_multiblock2","findbeginnings_barely_multiblock","findbeginnings_multiblock_two","findbeginnings_multiblock_ten", NULL };
-const bool ST_mmgc_fixedmalloc_findbeginning::ST_explicits[] = {false,false,false,false,false,false,false,false,false,false,false,false, false };
-void ST_mmgc_fixedmalloc_findbeginning::run(int n) {
+const char* ST_mmgc_incweakrefs::ST_names[] = {"visit","remove","grow", NULL };
+const bool ST_mmgc_incweakrefs::ST_explicits[] = {false,false,false, false };
+void ST_mmgc_incweakrefs::run(int n) {
 switch(n) {
 case 0: test0(); return;
 case 1: test1(); return;
 case 2: test2(); return;
-case 3: test3(); return;
-case 4: test4(); return;
-case 5: test5(); return;
-case 6: test6(); return;
-case 7: test7(); return;
-case 8: test8(); return;
-case 9: test9(); return;
-case 10: test10(); return;
-case 11: test11(); return;
 }
 }
-void ST_mmgc_fixedmalloc_findbeginning::prologue() {
-	fm = MMgc::FixedMalloc::GetFixedMalloc(MMgc::kAVMShellFixedPartition);
+void ST_mmgc_incweakrefs::prologue() {
+    GCConfig config;
+    config.incrementalWeakRefs = true;
+    gc = new GC(GCHeap::GetGCHeap(), config);
 
 }
+void ST_mmgc_incweakrefs::epilogue() {
+    delete gc;
 
-void ST_mmgc_fixedmalloc_findbeginning::test0() {
-    {
-        size_t sz = FixedMalloc::kSizeClasses[0];
-// line 91 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
+}
+void ST_mmgc_incweakrefs::test0() {
+{
+    MMGC_GCENTER(gc);
+
+    NodeRoot* root = new NodeRoot(gc);
+    populate(root, 0, kNumNodes);
+    gc->Collect();
+
+    // Drop the odd nodes, then mark.  The even nodes are marked by the time the
+    // mark stack runs dry, so only the odd ones are left for the final pause, with
+    // those created after the visit.
+
+    for ( int i=1 ; i < kNumNodes ; i+=2 )
+        root->nodes[i] = NULL;
+    gc->StartIncrementalMark();
+// line 98 "ST_mmgc_incweakrefs.st"
+verifyPass(visit(), "visit()", __FILE__, __LINE__);
+    populate(root, kNumNodes, 2*kNumNodes);
+    gc->FinishIncrementalMark(false);
+
+// line 102 "ST_mmgc_incweakrefs.st"
+verifyPass(check(root, 2*kNumNodes), "check(root, 2*kNumNodes)", __FILE__, __LINE__);
+
+    WeakRefStats stats;
+    gc->GetWeakRefStats(stats);
+// line 106 "ST_mmgc_incweakrefs.st"
+verifyPass(stats.entries == 2*kNumNodes, "stats.entries == 2*kNumNodes", __FILE__, __LINE__);
+// line 107 "ST_mmgc_incweakrefs.st"
+verifyPass(stats.visitedIncrementally == kNumNodes, "stats.visitedIncrementally == kNumNodes", __FILE__, __LINE__);
+// line 108 "ST_mmgc_incweakrefs.st"
+verifyPass(stats.visitedInPause == kNumNodes/2 + kNumNodes, "stats.visitedInPause == kNumNodes/2 + kNumNodes", __FILE__, __LINE__);
+// line 109 "ST_mmgc_incweakrefs.st"
+verifyPass(stats.cleared == kNumNodes/2, "stats.cleared == kNumNodes/2", __FILE__, __LINE__);
+
+    // The weak references of the surviving nodes are still the ones in the table.
+    bool same = true;
+    for ( int i=0 ; i < 2*kNumNodes ; i++ )
+        if (root->nodes[i] != NULL && root->nodes[i]->GetWeakRef() != root->refs[i])
+            same = false;
+// line 116 "ST_mmgc_incweakrefs.st"
+verifyPass(same, "same", __FILE__, __LINE__);
+
+    delete root;
+}
+
+}
+void ST_mmgc_incweakrefs::test1() {
+{
+    MMGC_GCENTER(gc);
+
+    NodeRoot* root = new NodeRoot(gc);
+    populate(root, 0, kNumNodes);
+    gc->Collect();
+
+    // Visit a few entries, then free a node explicitly: its entry is removed
+    // and the visit starts over.
+
+    for ( int i=2 ; i < kNumNodes ; i+=2 )
+        root->nodes[i] = NULL;
+    gc->StartIncrementalMark();
+    gc->ResetWeakRefVisit();    // the first mark slice may have completed the visit
+    gc->VisitWeakRefs(1);
+// line 137 "ST_mmgc_incweakrefs.st"
+verifyPass(gc->weakRefsCursor != 0 && !gc->weakRefsVisited, "gc->weakRefsCursor != 0 && !gc->weakRefsVisited", __FILE__, __LINE__);
+    delete root->nodes[0];
+    root->nodes[0] = NULL;
+// line 140 "ST_mmgc_incweakrefs.st"
+verifyPass(gc->weakRefsCursor == 0, "gc->weakRefsCursor == 0", __FILE__, __LINE__);
+// line 141 "ST_mmgc_incweakrefs.st"
+verifyPass(visit(), "visit()", __FILE__, __LINE__);
+    gc->FinishIncrementalMark(false);
+// line 143 "ST_mmgc_incweakrefs.st"
+verifyPass(check(root, kNumNodes), "check(root, kNumNodes)", __FILE__, __LINE__);
+
+    // A removal after the visit is complete leaves it alone.
+
+    gc->StartIncrementalMark();
+// line 148 "ST_mmgc_incweakrefs.st"
+verifyPass(visit(), "visit()", __FILE__, __LINE__);
+// line 149 "ST_mmgc_incweakrefs.st"
+verifyPass(gc->weakRefsVisited, "gc->weakRefsVisited", __FILE__, __LINE__);
+    delete root->nodes[1];
+    root->nodes[1] = NULL;
+// line 152 "ST_mmgc_incweakrefs.st"
+verifyPass(gc->weakRefsVisited, "gc->weakRefsVisited", __FILE__, __LINE__);
+    gc->FinishIncrementalMark(false);
+// line 154 "ST_mmgc_incweakrefs.st"
+verifyPass(check(root, kNumNodes), "check(root, kNumNodes)", __FILE__, __LINE__);
+
+    delete root;
+}
+
+}
+void ST_mmgc_incweakrefs::test2() {
+{
+    MMGC_GCENTER(gc);
+
+    NodeRoot* root = new NodeRoot(gc);
+    populate(root, 0, kNumNodes);
+    gc->Collect();
+
+    // Visit a few entries, then create weak references until the table grows.
+    // The visit starts over.  The allocations may run mark slices, which can
+    // finish the visit first; it is restarted then, but a slice may still finish
+    // it just before the table grows.
+
+    for ( int i=0 ; i < kNumNodes ; i+=3 )
+        root->nodes[i] = NULL;
+    gc->StartIncrementalMark();
+    gc->ResetWeakRefVisit();    // the first mark slice may have completed the visit
+    gc->VisitWeakRefs(1);
+// line 175 "ST_mmgc_incweakrefs.st"
+verifyPass(gc->weakRefsCursor != 0 && !gc->weakRefsVisited, "gc->weakRefsCursor != 0 && !gc->weakRefsVisited", __FILE__, __LINE__);
+    uint64_t tableBytes = gc->weakRefs.bytesUsed();
+    int n = kNumNodes;
+    while (n < 2*kNumNodes && gc->weakRefs.bytesUsed() == tableBytes) {
+        if (gc->weakRefsVisited) {
+            gc->ResetWeakRefVisit();
+            gc->VisitWeakRefs(1);
+        }
+        populate(root, n, n+1);
+        n++;
     }
+// line 182 "ST_mmgc_incweakrefs.st"
+verifyPass(gc->weakRefs.bytesUsed() != tableBytes, "gc->weakRefs.bytesUsed() != tableBytes", __FILE__, __LINE__);
+// line 183 "ST_mmgc_incweakrefs.st"
+verifyPass(gc->weakRefsCursor == 0 || gc->weakRefsVisited, "gc->weakRefsCursor == 0 || gc->weakRefsVisited", __FILE__, __LINE__);
+// line 184 "ST_mmgc_incweakrefs.st"
+verifyPass(visit(), "visit()", __FILE__, __LINE__);
+    gc->FinishIncrementalMark(false);
+// line 186 "ST_mmgc_incweakrefs.st"
+verifyPass(check(root, n), "check(root, n)", __FILE__, __LINE__);
 
+    delete root;
 }
-void ST_mmgc_fixedmalloc_findbeginning::test1() {
-    {
-        size_t sz = FixedMalloc::kSizeClasses[1];
-// line 98 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-    }
 
 }
-void ST_mmgc_fixedmalloc_findbeginning::test2() {
-    {
-        size_t sz = FixedMalloc::kSizeClasses[2];
-// line 105 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-    }
+void create_mmgc_incweakrefs(AvmCore* core) { new ST_mmgc_incweakrefs(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_mmfx_array.st
+// -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_mmfx_array {
+class ST_mmgc_mmfx_array : public Selftest {
+public:
+ST_mmgc_mmfx_array(AvmCore* core);
+virtual void run(int n);
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+void test2();
+};
+ST_mmgc_mmfx_array::ST_mmgc_mmfx_array(AvmCore* core)
+    : Selftest(core, "mmgc", "mmfx_array", ST_mmgc_mmfx_array::ST_names,ST_mmgc_mmfx_array::ST_explicits)
+{}
+const char* ST_mmgc_mmfx_array::ST_names[] = {"mmfx_new_array_oom","mmfx_new_array_opts_canFail","mmfx_new_array_opts_oom", NULL };
+const bool ST_mmgc_mmfx_array::ST_explicits[] = {true,true,true, false };
+void ST_mmgc_mmfx_array::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+case 2: test2(); return;
+}
+}
+using namespace MMgc;
+
+// There are different failure modes.
+// 1) if you call mmfx_new_array() it can OOM:
+//     -> it should OOM and shutdown
+// 2) if you call mmfx_new_array_opts(canFail) and it OOMs:
+//     -> it should return NULL and NOT OOM
+// 3) if you call mmfx_new_aray_opts() without the canFail flag:
+//     -> it should OOM and shutdown
+
+
+void ST_mmgc_mmfx_array::test0() {
+    // This will cause an OOM abort and exit, run with -memlimit 1024
+    int* m_ints = mmfx_new_array(int, 1048576);
+    mmfx_delete_array(m_ints);
+    m_ints = NULL;
+// line 27 "ST_mmgc_mmfx_array.st"
+verifyPass(false, "false", __FILE__, __LINE__);
 
 }
-void ST_mmgc_fixedmalloc_findbeginning::test3() {
-    {
-        size_t sz = FixedMalloc::kSizeClasses[3];
-// line 112 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-    }
+void ST_mmgc_mmfx_array::test1() {
+    // This should fail and return NULL, run with -memlimit 1024
+    int* m_ints = mmfx_new_array_opt(int, 1048576, MMgc::kCanFail);
+// line 32 "ST_mmgc_mmfx_array.st"
+verifyPass(m_ints == NULL, "m_ints == NULL", __FILE__, __LINE__);
+    mmfx_delete_array(m_ints);
+    m_ints = NULL;
+
+}
+void ST_mmgc_mmfx_array::test2() {
+    // This will cause an OOM abort and exit, run with -memlimit 1024
+    int* m_ints = mmfx_new_array_opt(int, 1048576, MMgc::kZero);
+    mmfx_delete_array(m_ints);
+    m_ints = NULL;
+// line 41 "ST_mmgc_mmfx_array.st"
+verifyPass(false, "false", __FILE__, __LINE__);
+
+
+
+}
+void create_mmgc_mmfx_array(AvmCore* core) { new ST_mmgc_mmfx_array(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_pacing.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// Pause-target pacing (GCHeapConfig::gcPauseTarget): the policy uses the requested
+// load factor, keeps its parameters within their bounds while the collector runs,
+// and counts every pause in the histogram.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_pacing {
+using namespace MMgc;
+
+class PacingNode : public GCObject
+{
+public:
+    GCMember<PacingNode> next;
+    uintptr_t payload[6];
+};
+
+class ST_mmgc_pacing : public Selftest {
+public:
+ST_mmgc_pacing(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+private:
+    MMgc::GC *gc;
+
+};
+ST_mmgc_pacing::ST_mmgc_pacing(AvmCore* core)
+    : Selftest(core, "mmgc", "pacing", ST_mmgc_pacing::ST_names,ST_mmgc_pacing::ST_explicits)
+{}
+const char* ST_mmgc_pacing::ST_names[] = {"load","adapt", NULL };
+const bool ST_mmgc_pacing::ST_explicits[] = {false,false, false };
+void ST_mmgc_pacing::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+}
+}
+void ST_mmgc_pacing::prologue() {
+    // The policy reads the targets when the GC is created.
+    GCHeapConfig& heapConfig = GCHeap::GetGCHeap()->config;
+    double savedPause = heapConfig.gcPauseTarget;
+    double savedOverhead = heapConfig.gcOverheadTarget;
+    heapConfig.gcPauseTarget = 2.0;
+    heapConfig.gcOverheadTarget = 0.5;
+    GCConfig config;
+    gc = new GC(GCHeap::GetGCHeap(), config);
+    heapConfig.gcPauseTarget = savedPause;
+    heapConfig.gcOverheadTarget = savedOverhead;
+
+}
+void ST_mmgc_pacing::epilogue() {
+    delete gc;
 
 }
-void ST_mmgc_fixedmalloc_findbeginning::test4() {
-    {
-        size_t sz = FixedMalloc::kLargestAlloc - 1;
-        sz = sz - DebugSize();
-// line 120 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-        sz = sz + DebugSize();
-// line 123 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-    }
+void ST_mmgc_pacing::test0() {
+    // The overhead target replaces the load factor table at every heap size.
+// line 46 "ST_mmgc_pacing.st"
+verifyPass(gc->policy.queryLoadForHeapsize(1024.0*1024.0) == 1.5, "gc->policy.queryLoadForHeapsize(1024.0*1024.0) == 1.5", __FILE__, __LINE__);
+// line 47 "ST_mmgc_pacing.st"
+verifyPass(gc->policy.queryLoadForHeapsize(1024.0*1024.0*1024.0) == 1.5, "gc->policy.queryLoadForHeapsize(1024.0*1024.0*1024.0) == 1.5", __FILE__, __LINE__);
 
 }
-void ST_mmgc_fixedmalloc_findbeginning::test5() {
-    {
-        size_t sz = FixedMalloc::kLargestAlloc;
-        sz = sz - DebugSize();
-// line 131 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-        sz = sz + DebugSize();
-// line 134 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
+void ST_mmgc_pacing::test1() {
+{
+    MMGC_GCENTER(gc);
+
+    // A live list that keeps growing, and plenty of garbage, so that the collector
+    // runs through several incremental cycles.
+    PacingNode* live = NULL;
+    for ( int i=0 ; i < 400000 ; i++ ) {
+        PacingNode* n = new (gc) PacingNode();
+        if (i % 8 == 0) {
+            n->next = live;
+            live = n;
+        }
     }
 
+    GCPolicyManager& policy = gc->policy;
+
+// line 66 "ST_mmgc_pacing.st"
+verifyPass(policy.countFinalizeAndSweep > 0, "policy.countFinalizeAndSweep > 0", __FILE__, __LINE__);
+// line 67 "ST_mmgc_pacing.st"
+verifyPass(policy.countIncrementalMark > 0, "policy.countIncrementalMark > 0", __FILE__, __LINE__);
+// line 68 "ST_mmgc_pacing.st"
+verifyPass(policy.P <= policy.P_target && policy.P >= policy.P_target / 8, "policy.P <= policy.P_target && policy.P >= policy.P_target / 8", __FILE__, __LINE__);
+// line 69 "ST_mmgc_pacing.st"
+verifyPass(policy.T >= 0 && policy.T <= 0.9, "policy.T >= 0 && policy.T <= 0.9", __FILE__, __LINE__);
+// line 70 "ST_mmgc_pacing.st"
+verifyPass(policy.allocationRate > 0, "policy.allocationRate > 0", __FILE__, __LINE__);
+
+    uint64_t pauses = 0;
+    for ( uint32_t i=0 ; i < GCPolicyManager::kNumPauseBuckets ; i++ )
+        pauses += policy.pauseHistogram[i];
+// line 75 "ST_mmgc_pacing.st"
+verifyPass(pauses == policy.countStartIncrementalMark + policy.countIncrementalMark + policy.countFinalizeAndSweep + policy.countReapZCT, "pauses == policy.countStartIncrementalMark + policy.countIncrementalMark + policy.countFinalizeAndSweep + policy.countReapZCT", __FILE__, __LINE__);
+
+    live = NULL;
 }
-void ST_mmgc_fixedmalloc_findbeginning::test6() {
-    {
-        size_t sz = FixedMalloc::kLargestAlloc+1;
-        sz = sz - DebugSize();
-// line 142 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-        sz = sz + DebugSize();
-// line 145 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-    }
 
 }
-void ST_mmgc_fixedmalloc_findbeginning::test7() {
-    {
-        size_t sz = GCHeap::kBlockSize-1;
-        sz = sz - DebugSize();
-// line 153 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-        sz = sz + DebugSize();
-// line 156 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-    }
+void create_mmgc_pacing(AvmCore* core) { new ST_mmgc_pacing(core); }
+}
+}
+#endif
+
+// Generated from ST_mmgc_pagemap.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// The lock-free 64-bit page map (PageMap::LockFreeT3).  The page map only records
+// addresses, so the tests map address ranges that need not be backed by memory.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+#if defined AVMPLUS_64BIT
+#if !defined MMGC_USE_UNIFORM_PAGEMAP
+namespace avmplus {
+namespace ST_mmgc_pagemap {
+using namespace MMgc;
+
+class ST_mmgc_pagemap : public Selftest {
+public:
+ST_mmgc_pagemap(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+private:
+    MMgc::PageMap::LockFreeT3 *pageMap;
+
+    static const uintptr_t kPage = PageMap::kPageSize;
 
+};
+ST_mmgc_pagemap::ST_mmgc_pagemap(AvmCore* core)
+    : Selftest(core, "mmgc", "pagemap", ST_mmgc_pagemap::ST_names,ST_mmgc_pagemap::ST_explicits)
+{}
+const char* ST_mmgc_pagemap::ST_names[] = {"sparse","clear", NULL };
+const bool ST_mmgc_pagemap::ST_explicits[] = {false,false, false };
+void ST_mmgc_pagemap::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
 }
-void ST_mmgc_fixedmalloc_findbeginning::test8() {
-    {
-        size_t sz = GCHeap::kBlockSize;
-        sz = sz - DebugSize();
-// line 164 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-        sz = sz + DebugSize();
-// line 167 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-    }
+}
+void ST_mmgc_pagemap::prologue() {
+    pageMap = mmfx_new(PageMap::LockFreeT3());
 
 }
-void ST_mmgc_fixedmalloc_findbeginning::test9() {
-    {
-        size_t sz = GCHeap::kBlockSize+1;
-        sz = sz - DebugSize();
-// line 175 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-        sz = sz + DebugSize();
-// line 178 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-    }
+void ST_mmgc_pagemap::epilogue() {
+    pageMap->DestroyPageMapVia(GCHeap::GetGCHeap());
+    mmfx_delete(pageMap);
 
 }
-void ST_mmgc_fixedmalloc_findbeginning::test10() {
-    {
-        size_t sz = GCHeap::kBlockSize*2;
-        sz = sz - DebugSize();
-// line 186 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-        sz = sz + DebugSize();
-// line 189 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-    }
+void ST_mmgc_pagemap::test0() {
+{
+    // Ranges far apart, one straddling a leaf boundary (128MB) and one straddling
+    // an interior node boundary (128GB).
+
+    const uintptr_t low  = uintptr_t(0x10000000);
+    const uintptr_t leaf = uintptr_t(0x7FFFF000) - 2*kPage;
+    const uintptr_t node = (uintptr_t(1) << 37) - 3*kPage;
+    const uintptr_t high = uintptr_t(0x7F0000000000);
+
+// line 42 "ST_mmgc_pagemap.st"
+verifyPass(!pageMap->AddrIsMappable(low), "!pageMap->AddrIsMappable(low)", __FILE__, __LINE__);
+
+    pageMap->ExpandSetAll(GCHeap::GetGCHeap(), (void*)low, 4, PageMap::kGCAllocPage);
+    pageMap->ExpandSetAll(GCHeap::GetGCHeap(), (void*)leaf, 1, PageMap::kGCLargeAllocPageFirst);
+    pageMap->ExpandSetAll(GCHeap::GetGCHeap(), (void*)(leaf+kPage), 5, PageMap::kGCLargeAllocPageRest);
+    pageMap->ExpandSetAll(GCHeap::GetGCHeap(), (void*)node, 7, PageMap::kGCAllocPage);
+    pageMap->ExpandSetAll(GCHeap::GetGCHeap(), (void*)high, 2, PageMap::kGCAllocPage);
+
+// line 50 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->MemStart() == low, "pageMap->MemStart() == low", __FILE__, __LINE__);
+// line 51 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->MemEnd() > high + kPage, "pageMap->MemEnd() > high + kPage", __FILE__, __LINE__);
+// line 52 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrIsMappable(high + kPage), "pageMap->AddrIsMappable(high + kPage)", __FILE__, __LINE__);
+
+    bool ok = true;
+    for ( uintptr_t i=0 ; i < 4 ; i++ )
+        ok &= pageMap->AddrToVal(low + i*kPage + 8) == PageMap::kGCAllocPage;
+// line 57 "ST_mmgc_pagemap.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+// line 58 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(low + 4*kPage) == PageMap::kNonGC, "pageMap->AddrToVal(low + 4*kPage) == PageMap::kNonGC", __FILE__, __LINE__);
+// line 59 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(low - kPage) == PageMap::kNonGC, "pageMap->AddrToVal(low - kPage) == PageMap::kNonGC", __FILE__, __LINE__);
+
+// line 61 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(leaf) == PageMap::kGCLargeAllocPageFirst, "pageMap->AddrToVal(leaf) == PageMap::kGCLargeAllocPageFirst", __FILE__, __LINE__);
+    ok = true;
+    for ( uintptr_t i=1 ; i < 6 ; i++ )
+        ok &= pageMap->AddrToVal(leaf + i*kPage) == PageMap::kGCLargeAllocPageRest;
+// line 65 "ST_mmgc_pagemap.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+// line 66 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(leaf + 6*kPage) == PageMap::kNonGC, "pageMap->AddrToVal(leaf + 6*kPage) == PageMap::kNonGC", __FILE__, __LINE__);
+
+    ok = true;
+    for ( uintptr_t i=0 ; i < 7 ; i++ )
+        ok &= pageMap->AddrToVal(node + i*kPage + kPage - 1) == PageMap::kGCAllocPage;
+// line 71 "ST_mmgc_pagemap.st"
+verifyPass(ok, "ok", __FILE__, __LINE__);
+
+    // Addresses inside the range that were never mapped, including ones with no
+    // leaf or interior node at all.
+// line 75 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(uintptr_t(0x3000000000)) == PageMap::kNonGC, "pageMap->AddrToVal(uintptr_t(0x3000000000)) == PageMap::kNonGC", __FILE__, __LINE__);
+// line 76 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(uintptr_t(0x400000000000)) == PageMap::kNonGC, "pageMap->AddrToVal(uintptr_t(0x400000000000)) == PageMap::kNonGC", __FILE__, __LINE__);
+// line 77 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(high + kPage) == PageMap::kGCAllocPage, "pageMap->AddrToVal(high + kPage) == PageMap::kGCAllocPage", __FILE__, __LINE__);
+}
+
+}
+void ST_mmgc_pagemap::test1() {
+{
+    const uintptr_t base = uintptr_t(0x20000000);
 
+    pageMap->ExpandSetAll(GCHeap::GetGCHeap(), (void*)base, 8, PageMap::kGCAllocPage);
+    pageMap->ClearAddrs((void*)(base + 2*kPage), 4);
+
+// line 87 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(base + kPage) == PageMap::kGCAllocPage, "pageMap->AddrToVal(base + kPage) == PageMap::kGCAllocPage", __FILE__, __LINE__);
+// line 88 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(base + 2*kPage) == PageMap::kNonGC, "pageMap->AddrToVal(base + 2*kPage) == PageMap::kNonGC", __FILE__, __LINE__);
+// line 89 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(base + 5*kPage) == PageMap::kNonGC, "pageMap->AddrToVal(base + 5*kPage) == PageMap::kNonGC", __FILE__, __LINE__);
+// line 90 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(base + 6*kPage) == PageMap::kGCAllocPage, "pageMap->AddrToVal(base + 6*kPage) == PageMap::kGCAllocPage", __FILE__, __LINE__);
+
+    // Cleared pages can be mapped again, with a different type.
+    pageMap->ExpandSetAll(GCHeap::GetGCHeap(), (void*)(base + 2*kPage), 1, PageMap::kGCLargeAllocPageFirst);
+// line 94 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(base + 2*kPage) == PageMap::kGCLargeAllocPageFirst, "pageMap->AddrToVal(base + 2*kPage) == PageMap::kGCLargeAllocPageFirst", __FILE__, __LINE__);
+
+    // Clearing addresses that were never mapped is harmless.
+    pageMap->ClearAddrs((void*)uintptr_t(0x500000000000), 3);
+// line 98 "ST_mmgc_pagemap.st"
+verifyPass(pageMap->AddrToVal(base + 7*kPage) == PageMap::kGCAllocPage, "pageMap->AddrToVal(base + 7*kPage) == PageMap::kGCAllocPage", __FILE__, __LINE__);
 }
-void ST_mmgc_fixedmalloc_findbeginning::test11() {
-    {
-        size_t sz = GCHeap::kBlockSize*10;
-        sz = sz - DebugSize();
-// line 197 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-        sz = sz + DebugSize();
-// line 200 "ST_mmgc_fixedmalloc_findbeginning.st"
-verifyPass(allocateVerifyAndFree(sz) == 0, "allocateVerifyAndFree(sz) == 0", __FILE__, __LINE__);
-              ;
-    }
 
 }
-void create_mmgc_fixedmalloc_findbeginning(AvmCore* core) { new ST_mmgc_fixedmalloc_findbeginning(core); }
+void create_mmgc_pagemap(AvmCore* core) { new ST_mmgc_pagemap(core); }
 }
 }
 #endif
+#endif
+#endif
 
-// Generated from ST_mmgc_gcheap.st
-// -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+// Generated from ST_mmgc_parallelmark.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
 //
 // This Source Code Form is subject to the terms of the Mozilla Public
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+// Parallel marking (GCConfig::markerThreads): every reachable object must survive
+// collection, and unreachable objects must still be reclaimed, when the mark stack
+// is drained by several threads.
+
 #include "avmshell.h"
 #ifdef VMCFG_SELFTEST
 namespace avmplus {
-namespace ST_mmgc_gcheap {
-class ST_mmgc_gcheap : public Selftest {
+namespace ST_mmgc_parallelmark {
+using namespace MMgc;
+
+class PMNode : public GCFinalizedObject
+{
 public:
-ST_mmgc_gcheap(AvmCore* core);
+    static const int kFanout = 4;
+
+    PMNode(int key) : key(key) {}
+    ~PMNode() { key = -1; }
+
+    int key;
+    GCMember<PMNode> kids[kFanout];
+};
+
+// A complete tree of the given depth whose nodes all have 'key'.
+static PMNode* makeTree(GC* gc, int depth, int key)
+{
+    PMNode* n = new (gc) PMNode(key);
+    if (depth > 0)
+        for ( int i=0 ; i < PMNode::kFanout ; i++ )
+            n->kids[i] = makeTree(gc, depth-1, key);
+    return n;
+}
+
+// Count the nodes in the tree that have 'key'.
+static int countTree(PMNode* n, int key)
+{
+    if (n == NULL || n->key != key)
+        return 0;
+    int count = 1;
+    for ( int i=0 ; i < PMNode::kFanout ; i++ )
+        count += countTree(n->kids[i], key);
+    return count;
+}
+
+class ST_mmgc_parallelmark : public Selftest {
+public:
+ST_mmgc_parallelmark(AvmCore* core);
 virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
 private:
 static const char* ST_names[];
 static const bool ST_explicits[];
 void test0();
 void test1();
+private:
+    MMgc::GC *gc;
+
 };
-ST_mmgc_gcheap::ST_mmgc_gcheap(AvmCore* core)
-    : Selftest(core, "mmgc", "gcheap", ST_mmgc_gcheap::ST_names,ST_mmgc_gcheap::ST_explicits)
+ST_mmgc_parallelmark::ST_mmgc_parallelmark(AvmCore* core)
+    : Selftest(core, "mmgc", "parallelmark", ST_mmgc_parallelmark::ST_names,ST_mmgc_parallelmark::ST_explicits)
 {}
-const char* ST_mmgc_gcheap::ST_names[] = {"largeAlloc","largeAllocAlignment", NULL };
-const bool ST_mmgc_gcheap::ST_explicits[] = {false,false, false };
-void ST_mmgc_gcheap::run(int n) {
+const char* ST_mmgc_parallelmark::ST_names[] = {"reachable_survive","large_root", NULL };
+const bool ST_mmgc_parallelmark::ST_explicits[] = {false,false, false };
+void ST_mmgc_parallelmark::run(int n) {
 switch(n) {
 case 0: test0(); return;
 case 1: test1(); return;
 }
 }
-using namespace MMgc;
+void ST_mmgc_parallelmark::prologue() {
+    GCConfig config;
+    config.markerThreads = 3;
+    gc = new GC(GCHeap::GetGCHeap(), config);
 
-void ST_mmgc_gcheap::test0() {
-       GCHeap *heap = GCHeap::GetGCHeap();
-       for(int i=1;i<4;i++) {
-          void *item = heap->GetPartition(MMgc::kAVMShellHeapPartition)->Alloc(GCHeap::kOSAllocThreshold*i);
-// line 17 "ST_mmgc_gcheap.st"
-verifyPass(heap->GetPartition(MMgc::kAVMShellHeapPartition)->Size(item) == GCHeap::kOSAllocThreshold*i, "heap->GetPartition(MMgc::kAVMShellHeapPartition)->Size(item) == GCHeap::kOSAllocThreshold*i", __FILE__, __LINE__);
-          heap->GetPartition(MMgc::kAVMShellHeapPartition)->Free(item);
-       }
-// line 20 "ST_mmgc_gcheap.st"
-verifyPass(true, "true", __FILE__, __LINE__);
+}
+void ST_mmgc_parallelmark::epilogue() {
+    delete gc;
 
 }
-void ST_mmgc_gcheap::test1() {
-       GCHeap *heap = GCHeap::GetGCHeap();
-       for(int i=1;i<10;i++) {
-          void *item = heap->GetPartition(MMgc::kAVMShellHeapPartition)->Alloc(GCHeap::kOSAllocThreshold*i, GCHeap::flags_Alloc, 1<<i);
-// line 26 "ST_mmgc_gcheap.st"
-verifyPass(heap->GetPartition(MMgc::kAVMShellHeapPartition)->Size(item) == GCHeap::kOSAllocThreshold*i, "heap->GetPartition(MMgc::kAVMShellHeapPartition)->Size(item) == GCHeap::kOSAllocThreshold*i", __FILE__, __LINE__);
-// line 27 "ST_mmgc_gcheap.st"
-verifyPass(uintptr_t(((GCHeap::kBlockSize<<(i-1))-1) & uintptr_t(item)) == 0, "uintptr_t(((GCHeap::kBlockSize<<(i-1))-1) & uintptr_t(item)) == 0", __FILE__, __LINE__);
-          heap->GetPartition(MMgc::kAVMShellHeapPartition)->Free(item);
-       }
+void ST_mmgc_parallelmark::test0() {
+{
+    MMGC_GCENTER(gc);
+
+    // A large pointer-containing array of small trees gives the markers plenty
+    // of independent work to share.
+
+    const int ntrees = 4096;
+    const int depth = 3;
+    const int treesize = 1 + 4 + 16 + 64;
 
+    PMNode** trees = (PMNode**)gc->Alloc(ntrees * sizeof(PMNode*), GC::kContainsPointers|GC::kZero, kAVMShellGCPartition);
+    GCWeakRef* garbage[16];
+    for ( int i=0 ; i < ntrees ; i++ )
+        trees[i] = makeTree(gc, depth, i);
+    for ( int i=0 ; i < 16 ; i++ )
+        garbage[i] = makeTree(gc, depth, -2)->GetWeakRef();
 
+    gc->Collect();
+    gc->Collect();
+
+    int live = 0;
+    for ( int i=0 ; i < ntrees ; i++ )
+        live += countTree(trees[i], i);
+// line 87 "ST_mmgc_parallelmark.st"
+verifyPass(live == ntrees * treesize, "live == ntrees * treesize", __FILE__, __LINE__);
+
+    // The conservative stack scan may retain the odd tree, so allow some slack.
+
+    int cleared = 0;
+    for ( int i=0 ; i < 16 ; i++ )
+        cleared += garbage[i]->get() == NULL;
+// line 94 "ST_mmgc_parallelmark.st"
+verifyPass(cleared >= 14, "cleared >= 14", __FILE__, __LINE__);
+
+    // Drop half the trees and make sure they go away while the others stay.
+
+    GCWeakRef* dropped[ntrees/2];
+    for ( int i=0 ; i < ntrees ; i+=2 ) {
+        dropped[i/2] = trees[i]->GetWeakRef();
+        trees[i] = NULL;
+    }
+
+    gc->Collect();
+    gc->Collect();
+
+    live = 0;
+    for ( int i=1 ; i < ntrees ; i+=2 )
+        live += countTree(trees[i], i);
+// line 110 "ST_mmgc_parallelmark.st"
+verifyPass(live == (ntrees/2) * treesize, "live == (ntrees/2) * treesize", __FILE__, __LINE__);
+
+    cleared = 0;
+    for ( int i=0 ; i < ntrees/2 ; i++ )
+        cleared += dropped[i]->get() == NULL;
+// line 115 "ST_mmgc_parallelmark.st"
+verifyPass(cleared >= ntrees/2 - 2, "cleared >= ntrees/2 - 2", __FILE__, __LINE__);
+
+    VMPI_memset(garbage, 0, sizeof(garbage));
+    VMPI_memset(dropped, 0, sizeof(dropped));
+    gc->Free(trees);
 }
-void create_mmgc_gcheap(AvmCore* core) { new ST_mmgc_gcheap(core); }
+
+}
+void ST_mmgc_parallelmark::test1() {
+{
+    MMGC_GCENTER(gc);
+
+    // A conservative root large enough for the markers to share it in chunks,
+    // with a tree hanging off every few hundred words.
+
+    const int nwords = 256*1024;
+    const int spacing = 509;
+    const int depth = 2;
+    const int treesize = 1 + 4 + 16;
+
+    uintptr_t* words = mmfx_new_array(uintptr_t, nwords);
+    VMPI_memset(words, 0, nwords * sizeof(uintptr_t));
+    for ( int i=0 ; i < nwords ; i += spacing )
+        words[i] = uintptr_t(makeTree(gc, depth, i));
+
+    GCRoot* root = new GCRoot(gc, words, nwords * sizeof(uintptr_t));
+    gc->Collect();
+    gc->Collect();
+
+    int live = 0;
+    for ( int i=0 ; i < nwords ; i += spacing )
+        live += countTree((PMNode*)words[i], i);
+// line 146 "ST_mmgc_parallelmark.st"
+verifyPass(live == ((nwords + spacing - 1) / spacing) * treesize, "live == ((nwords + spacing - 1) / spacing) * treesize", __FILE__, __LINE__);
+
+    delete root;
+    mmfx_delete_array(words);
+}
+
+}
+void create_mmgc_parallelmark(AvmCore* core) { new ST_mmgc_parallelmark(core); }
 }
 }
 #endif
 
-// Generated from ST_mmgc_gcoption.st
+// Generated from ST_mmgc_reap.st
 // -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
 // vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
 //
@@ -2854,15 +5801,48 @@ void create_mmgc_gcheap(AvmCore* core) { new ST_mmgc_gcheap(core); }
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-#include "avmshell.h"
-#ifdef VMCFG_SELFTEST
-namespace avmplus {
-namespace ST_mmgc_gcoption {
-using namespace MMgc;
+// Reap slices (GCConfig::reapSlice): a time-bounded reap leaves the objects it did
+// not get to and the objects it pinned in the ZCT, and later reaps finish the job.
+// The reaps are run without scanning the stack, so the pointers the tests keep on
+// the stack don't pin anything.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_reap {
+using namespace MMgc;
+
+class ReapNode : public RCObject
+{
+public:
+    ReapNode(uint32_t* deaths) : deaths(deaths) {}
+    ~ReapNode() { (*deaths)++; deaths = NULL; }
+
+    GCMember<ReapNode> next;
+    uint32_t* deaths;
+};
+
+// Pins an object whenever the ZCT is about to be reaped.
+class ReapPinner : public GCCallback
+{
+public:
+    ReapPinner(GC* gc, RCObject* obj) : GCCallback(gc), obj(obj) {}
+
+    // Only the start of the reap is of interest; keep prereap(void*) visible.
+    using GCCallback::prereap;
+
+    virtual void prereap()
+    {
+        if (obj != NULL)
+            obj->Pin();
+    }
+
+    RCObject* obj;
+};
 
-class ST_mmgc_gcoption : public Selftest {
+class ST_mmgc_reap : public Selftest {
 public:
-ST_mmgc_gcoption(AvmCore* core);
+ST_mmgc_reap(AvmCore* core);
 virtual void run(int n);
 virtual void prologue();
 virtual void epilogue();
@@ -2871,440 +5851,602 @@ static const char* ST_names[];
 static const bool ST_explicits[];
 void test0();
 void test1();
-void test2();
-void test3();
-void test4();
-    bool m_ret;
-    bool m_wrong;
-    GCHeap *m_heap;
-    GCHeapConfig m_config_orig;
-    bool isParamOption(const char* line) {
-        return m_heap->config.IsGCOptionWithParam(line);
-    }
-    bool notParamOption(const char* line) {
-        return !isParamOption(line);
-    }
-    bool approxEqual(double x, double y) {
-        double delta1 = x - y;
-        // abs() does not produce correct results at e.g. DBL_MAX.
-        double delta2 = (delta1 > 0) ? delta1 : -delta1;
-        return (delta2 < 0.0001);
-    }
-    void parseApply(const char* line, const char* optExtra=0)
-    {
-        m_ret = m_heap->config.ParseAndApplyOption(line, m_wrong, optExtra);
-    }
-    bool parsedCorrectly() {
-        return m_ret && !m_wrong;
-    }
-    bool gcoptionButIncorrectFormat() {
-        return m_ret && m_wrong;
-    }
-
-    void saveOrigHeapConfig() {
-        memcpy(&m_config_orig, &m_heap->config, sizeof(GCHeapConfig));
-    }
-
-    void restoreHeapConfig() {
-        memcpy(&m_heap->config, &m_config_orig, sizeof(GCHeapConfig));
-    }
+private:
+    MMgc::GC *gc;
+    uint32_t deaths;
 
-    bool configUnchanged() {
-        const char* c1 = (const char*)&m_heap->config;
-        const char* c2 = (const char*)&m_config_orig;
-        bool noChangeSeen = true;
-        for (size_t i=0; i < sizeof(GCHeapConfig); i++) {
-            if (*c1 != *c2)
-                noChangeSeen = false;
+    // @return the number of ZCT entries that are not NULL.
+    uint32_t entries()
+    {
+        uint32_t n = 0;
+        for ( uint32_t i=0 ; i < gc->zct.topIndex ; i++ ) {
+            if (gc->zct.Get(i) != NULL)
+                n++;
         }
-        return noChangeSeen;
+        return n;
     }
 
 };
-ST_mmgc_gcoption::ST_mmgc_gcoption(AvmCore* core)
-    : Selftest(core, "mmgc", "gcoption", ST_mmgc_gcoption::ST_names,ST_mmgc_gcoption::ST_explicits)
+ST_mmgc_reap::ST_mmgc_reap(AvmCore* core)
+    : Selftest(core, "mmgc", "reap", ST_mmgc_reap::ST_names,ST_mmgc_reap::ST_explicits)
 {}
-const char* ST_mmgc_gcoption::ST_names[] = {"detect_parameterized_options","parse_memstats","parse_memlimit","parse_gcbehavior_gcsummary_eagersweep","parse_load_gcwork", NULL };
-const bool ST_mmgc_gcoption::ST_explicits[] = {false,false,false,false,false, false };
-void ST_mmgc_gcoption::run(int n) {
+const char* ST_mmgc_reap::ST_names[] = {"slices","pinned", NULL };
+const bool ST_mmgc_reap::ST_explicits[] = {false,false, false };
+void ST_mmgc_reap::run(int n) {
 switch(n) {
 case 0: test0(); return;
 case 1: test1(); return;
-case 2: test2(); return;
-case 3: test3(); return;
-case 4: test4(); return;
-}
 }
-void ST_mmgc_gcoption::prologue() {
-{
-    m_heap = GCHeap::GetGCHeap();
-    saveOrigHeapConfig();
 }
+void ST_mmgc_reap::prologue() {
+    GCConfig config;
+    config.reapSlice = 1;
+    gc = new GC(GCHeap::GetGCHeap(), config);
+    deaths = 0;
 
 }
-void ST_mmgc_gcoption::epilogue() {
-{
-    restoreHeapConfig();
-}
+void ST_mmgc_reap::epilogue() {
+    delete gc;
 
 }
-void ST_mmgc_gcoption::test0() {
+void ST_mmgc_reap::test0() {
 {
-// line 75 "ST_mmgc_gcoption.st"
-verifyPass(isParamOption("-memlimit"), "isParamOption(\"-memlimit\")", __FILE__, __LINE__);
-// line 76 "ST_mmgc_gcoption.st"
-verifyPass(isParamOption("-load"), "isParamOption(\"-load\")", __FILE__, __LINE__);
-// line 77 "ST_mmgc_gcoption.st"
-verifyPass(isParamOption("-loadCeiling"), "isParamOption(\"-loadCeiling\")", __FILE__, __LINE__);
-// line 78 "ST_mmgc_gcoption.st"
-verifyPass(isParamOption("-gcwork"), "isParamOption(\"-gcwork\")", __FILE__, __LINE__);
-// line 79 "ST_mmgc_gcoption.st"
-verifyPass(isParamOption("-gcstack"), "isParamOption(\"-gcstack\")", __FILE__, __LINE__);
-
-// line 81 "ST_mmgc_gcoption.st"
-verifyPass(notParamOption("-memlimit=10"), "notParamOption(\"-memlimit=10\")", __FILE__, __LINE__);
-// line 82 "ST_mmgc_gcoption.st"
-verifyPass(notParamOption("-load 1.5"), "notParamOption(\"-load 1.5\")", __FILE__, __LINE__);
-// line 83 "ST_mmgc_gcoption.st"
-verifyPass(notParamOption("-loadCeiling 1.5"), "notParamOption(\"-loadCeiling 1.5\")", __FILE__, __LINE__);
-// line 84 "ST_mmgc_gcoption.st"
-verifyPass(notParamOption("-gcwork 1.5"), "notParamOption(\"-gcwork 1.5\")", __FILE__, __LINE__);
-// line 85 "ST_mmgc_gcoption.st"
-verifyPass(notParamOption("-gcstack 10"), "notParamOption(\"-gcstack 10\")", __FILE__, __LINE__);
-
-// line 87 "ST_mmgc_gcoption.st"
-verifyPass(notParamOption("-not_an_option_and_never_will_be"), "notParamOption(\"-not_an_option_and_never_will_be\")", __FILE__, __LINE__);
-// line 88 "ST_mmgc_gcoption.st"
-verifyPass(notParamOption("-not_an_option_and_never_will_be 10"), "notParamOption(\"-not_an_option_and_never_will_be 10\")", __FILE__, __LINE__);
-// line 89 "ST_mmgc_gcoption.st"
-verifyPass(notParamOption("-not_an_option_and_never_will_be=10"), "notParamOption(\"-not_an_option_and_never_will_be=10\")", __FILE__, __LINE__);
-          ;
-}
+    MMGC_GCENTER(gc);
 
+    // Only the head of the list is in the ZCT.  Destroying a node drops the
+    // reference count of the next one to zero, so reaping the list is a single
+    // cascade that a slice of a microsecond cuts short, leaving the next node
+    // as the only object in the ZCT.
+    const uint32_t kNodes = 20000;
+    ReapNode* head = NULL;
+    for ( uint32_t i=0 ; i < kNodes ; i++ ) {
+        ReapNode* n = new (gc) ReapNode(&deaths);
+        n->next = head;
+        head = n;
+    }
+    head = NULL;
+// line 85 "ST_mmgc_reap.st"
+verifyPass(deaths == 0, "deaths == 0", __FILE__, __LINE__);
+
+    gc->zct.Reap(false, true);
+// line 88 "ST_mmgc_reap.st"
+verifyPass(deaths > 0 && deaths < kNodes, "deaths > 0 && deaths < kNodes", __FILE__, __LINE__);
+// line 89 "ST_mmgc_reap.st"
+verifyPass(entries() == 1, "entries() == 1", __FILE__, __LINE__);
+
+    uint32_t slices = 1;
+    bool oneEntry = true;
+    while (deaths < kNodes && slices < kNodes) {
+        gc->zct.Reap(false, true);
+        oneEntry &= deaths == kNodes || entries() == 1;
+        slices++;
+    }
+// line 98 "ST_mmgc_reap.st"
+verifyPass(oneEntry, "oneEntry", __FILE__, __LINE__);
+// line 99 "ST_mmgc_reap.st"
+verifyPass(deaths == kNodes, "deaths == kNodes", __FILE__, __LINE__);
+// line 100 "ST_mmgc_reap.st"
+verifyPass(slices > 2, "slices > 2", __FILE__, __LINE__);
+
+    // Reaps that are not asked to be time-bounded run to the end of the cascade,
+    // or to one of the nodes that were pinned by the reaps that scanned the stack
+    // while the list was built; those are a few hundred nodes apart.
+    for ( uint32_t i=0 ; i < kNodes ; i++ ) {
+        ReapNode* n = new (gc) ReapNode(&deaths);
+        n->next = head;
+        head = n;
+    }
+    head = NULL;
+    uint32_t reaps = 0;
+    while (deaths < 2*kNodes && reaps < kNodes) {
+        gc->zct.Reap(false);
+        reaps++;
+    }
+// line 116 "ST_mmgc_reap.st"
+verifyPass(deaths == 2*kNodes, "deaths == 2*kNodes", __FILE__, __LINE__);
+// line 117 "ST_mmgc_reap.st"
+verifyPass(reaps * 4 < slices, "reaps * 4 < slices", __FILE__, __LINE__);
 }
-void ST_mmgc_gcoption::test1() {
-{
-    // sanity checks:
-    // - make sure our configUnchanged check is sane
-    // - make sure our restoreHeapConfig works.
-// line 98 "ST_mmgc_gcoption.st"
-verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
-    memset(&m_heap->config, 0xfe, sizeof(GCHeapConfig));
-// line 100 "ST_mmgc_gcoption.st"
-verifyPass(!configUnchanged(), "!configUnchanged()", __FILE__, __LINE__);
-    restoreHeapConfig();
-// line 102 "ST_mmgc_gcoption.st"
-verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
-          ;
 
-    parseApply("-memstats");
-// line 106 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 107 "ST_mmgc_gcoption.st"
-verifyPass(m_heap->config.gcstats && m_heap->config.autoGCStats, "m_heap->config.gcstats && m_heap->config.autoGCStats", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
-
-    parseApply("-memstats-verbose");
-// line 112 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 113 "ST_mmgc_gcoption.st"
-verifyPass(m_heap->config.gcstats && m_heap->config.autoGCStats && m_heap->config.verbose, "m_heap->config.gcstats && m_heap->config.autoGCStats && m_heap->config.verbose", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
-}
 }
-void ST_mmgc_gcoption::test2() {
+void ST_mmgc_reap::test1() {
 {
-    parseApply("-memlimit   10");
-// line 120 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 121 "ST_mmgc_gcoption.st"
-verifyPass(m_heap->config.heapLimit == 10, "m_heap->config.heapLimit == 10", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+    MMGC_GCENTER(gc);
 
-    parseApply("-memlimit=11");
-// line 126 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 127 "ST_mmgc_gcoption.st"
-verifyPass(m_heap->config.heapLimit == 11, "m_heap->config.heapLimit == 11", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+    while (gc->zct.topIndex > 0)
+        gc->zct.Reap(false);
+    deaths = 0;
 
-    parseApply("-memlimit = 12");
-// line 132 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 133 "ST_mmgc_gcoption.st"
-verifyPass(m_heap->config.heapLimit == 12, "m_heap->config.heapLimit == 12", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+    const uint32_t kNodes = 20000;
+    ReapNode* head = NULL;
+    for ( uint32_t i=0 ; i < kNodes ; i++ ) {
+        ReapNode* n = new (gc) ReapNode(&deaths);
+        n->next = head;
+        head = n;
+    }
+    head = NULL;
+
+    // The pinned object is on top of the list's head in the ZCT, so it is visited
+    // first and must be put back when the slice ends.
+    uint32_t keeperDeaths = 0;
+    ReapNode* keeper = new (gc) ReapNode(&keeperDeaths);
+    ReapPinner* pinner = new ReapPinner(gc, keeper);
+
+    gc->zct.Reap(false, true);
+// line 144 "ST_mmgc_reap.st"
+verifyPass(deaths > 0 && deaths < kNodes, "deaths > 0 && deaths < kNodes", __FILE__, __LINE__);
+// line 145 "ST_mmgc_reap.st"
+verifyPass(keeperDeaths == 0, "keeperDeaths == 0", __FILE__, __LINE__);
+// line 146 "ST_mmgc_reap.st"
+verifyPass(entries() == 2, "entries() == 2", __FILE__, __LINE__);
+
+    // Still pinned, it survives the reaps that finish the list.
+    uint32_t slices = 1;
+    while (deaths < kNodes && slices < kNodes) {
+        gc->zct.Reap(false, true);
+        slices++;
+    }
+// line 154 "ST_mmgc_reap.st"
+verifyPass(deaths == kNodes, "deaths == kNodes", __FILE__, __LINE__);
+// line 155 "ST_mmgc_reap.st"
+verifyPass(keeperDeaths == 0, "keeperDeaths == 0", __FILE__, __LINE__);
+// line 156 "ST_mmgc_reap.st"
+verifyPass(entries() == 1, "entries() == 1", __FILE__, __LINE__);
 
-    parseApply("-memlimit");
-// line 138 "ST_mmgc_gcoption.st"
-verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
-// line 139 "ST_mmgc_gcoption.st"
-verifyPass(m_heap->config.heapLimit == m_config_orig.heapLimit, "m_heap->config.heapLimit == m_config_orig.heapLimit", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+    pinner->obj = NULL;
+    keeper = NULL;
+    gc->zct.Reap(false, true);
+// line 161 "ST_mmgc_reap.st"
+verifyPass(keeperDeaths == 1, "keeperDeaths == 1", __FILE__, __LINE__);
+// line 162 "ST_mmgc_reap.st"
+verifyPass(entries() == 0, "entries() == 0", __FILE__, __LINE__);
 
-    parseApply("-memlimit", "13");
-// line 144 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 145 "ST_mmgc_gcoption.st"
-verifyPass(m_heap->config.heapLimit == 13, "m_heap->config.heapLimit == 13", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
-}
+    delete pinner;
 }
-void ST_mmgc_gcoption::test3() {
-{
-#ifdef MMGC_POLICY_PROFILING
-    parseApply("-gcbehavior");
-// line 153 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 154 "ST_mmgc_gcoption.st"
-verifyPass((m_heap->config.gcbehavior == 2), "(m_heap->config.gcbehavior == 2)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
-
-    parseApply("-gcsummary");
-// line 159 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 160 "ST_mmgc_gcoption.st"
-verifyPass((m_heap->config.gcbehavior == 1), "(m_heap->config.gcbehavior == 1)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
-#endif
 
-    parseApply("-eagersweep");
-// line 166 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 167 "ST_mmgc_gcoption.st"
-verifyPass(m_heap->config.eagerSweeping, "m_heap->config.eagerSweeping", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
 }
+void create_mmgc_reap(AvmCore* core) { new ST_mmgc_reap(core); }
 }
-void ST_mmgc_gcoption::test4() {
-{
-    parseApply("-load 7.0");
-// line 174 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 175 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoad[0], 7.0), "approxEqual(m_heap->config.gcLoad[0], 7.0)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
-
-    // test load with '<space><param>'
-    parseApply("-load 6.0,10,5.0");
-// line 181 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 182 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoad[0], 6.0), "approxEqual(m_heap->config.gcLoad[0], 6.0)", __FILE__, __LINE__);
-// line 183 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoadCutoff[0], 10.0), "approxEqual(m_heap->config.gcLoadCutoff[0], 10.0)", __FILE__, __LINE__);
-// line 184 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoad[1], 5.0), "approxEqual(m_heap->config.gcLoad[1], 5.0)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
-
-    // test load with separate <param>
-    parseApply("-load", "8.0,20.5,7.0");
-// line 190 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 191 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoad[0], 8.0), "approxEqual(m_heap->config.gcLoad[0], 8.0)", __FILE__, __LINE__);
-// line 192 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoadCutoff[0], 20.5), "approxEqual(m_heap->config.gcLoadCutoff[0], 20.5)", __FILE__, __LINE__);
-// line 193 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoad[1], 7.0), "approxEqual(m_heap->config.gcLoad[1], 7.0)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+}
+#endif
 
-    // test load with '=<param>'
-    parseApply("-load=10.0,30.5,9.0");
-// line 199 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 200 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoad[0], 10.0), "approxEqual(m_heap->config.gcLoad[0], 10.0)", __FILE__, __LINE__);
-// line 201 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoadCutoff[0], 30.5), "approxEqual(m_heap->config.gcLoadCutoff[0], 30.5)", __FILE__, __LINE__);
-// line 202 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoad[1], 9.0), "approxEqual(m_heap->config.gcLoad[1], 9.0)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+// Generated from ST_mmgc_sizeclasses.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
-    // Max load pairs is 7
-    parseApply("-load 1.5,1.5,2,2,3,3,4,4,5,5,6,6,7,7,8,8");
-// line 208 "ST_mmgc_gcoption.st"
-verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
-// line 209 "ST_mmgc_gcoption.st"
-verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
-    restoreHeapConfig();
+// Size-class statistics and tuning: GCConfig::sizeClasses replaces the size
+// classes of a GC, GCConfig::sizeClassStatistics records the requests, and
+// SizeClassHistogram::ComputeSizeClasses fits a table to them.
 
-    // Ensure that the last load value is ignored
-    parseApply("-load=10.0,30.0,9.0,60.0");
-// line 214 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 215 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoad[0], 10.0), "approxEqual(m_heap->config.gcLoad[0], 10.0)", __FILE__, __LINE__);
-// line 216 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoadCutoff[0], 30.0), "approxEqual(m_heap->config.gcLoadCutoff[0], 30.0)", __FILE__, __LINE__);
-// line 217 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoad[1], 9.0), "approxEqual(m_heap->config.gcLoad[1], 9.0)", __FILE__, __LINE__);
-// line 218 "ST_mmgc_gcoption.st"
-verifyPass(!approxEqual(m_heap->config.gcLoadCutoff[1], 60.0), "!approxEqual(m_heap->config.gcLoadCutoff[1], 60.0)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_sizeclasses {
+using namespace MMgc;
 
-    parseApply("-load");
-// line 223 "ST_mmgc_gcoption.st"
-verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
-// line 224 "ST_mmgc_gcoption.st"
-verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+class ST_mmgc_sizeclasses : public Selftest {
+public:
+ST_mmgc_sizeclasses(AvmCore* core);
+virtual void run(int n);
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+void test2();
+void test3();
+void test4();
+private:
+    uint16_t table[GC::kNumSizeClasses];
 
-    // L (load) must be > 1
-    parseApply("-load 1,30");
-// line 230 "ST_mmgc_gcoption.st"
-verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
-// line 231 "ST_mmgc_gcoption.st"
-verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+    void copyDefaults()
+    {
+        for (int i=0; i < GC::kNumSizeClasses; i++)
+            table[i] = uint16_t(GC::kSizeClasses[i]);
+    }
 
-    parseApply("-load badvalue");
-// line 236 "ST_mmgc_gcoption.st"
-verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
-// line 237 "ST_mmgc_gcoption.st"
-verifyPass(configUnchanged(), "configUnchanged()", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+    // The index of the built-in size class that serves a request for 'size' bytes.
+    static int classFor(size_t size)
+    {
+        size = ((size + 7) & ~7) + DebugSize();
+        int i = 0;
+        while (size_t(GC::kSizeClasses[i]) < size)
+            i++;
+        return i;
+    }
 
+};
+ST_mmgc_sizeclasses::ST_mmgc_sizeclasses(AvmCore* core)
+    : Selftest(core, "mmgc", "sizeclasses", ST_mmgc_sizeclasses::ST_names,ST_mmgc_sizeclasses::ST_explicits)
+{}
+const char* ST_mmgc_sizeclasses::ST_names[] = {"customtable","invalidtables","statistics","tune","fixedmalloc", NULL };
+const bool ST_mmgc_sizeclasses::ST_explicits[] = {false,false,false,false,false, false };
+void ST_mmgc_sizeclasses::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+case 2: test2(); return;
+case 3: test3(); return;
+case 4: test4(); return;
+}
+}
+void ST_mmgc_sizeclasses::test0() {
+{
+    // Replace the 144-byte class by a 136-byte one.
+    copyDefaults();
+// line 42 "ST_mmgc_sizeclasses.st"
+verifyPass(GC::kSizeClasses[15] == 128 && GC::kSizeClasses[16] == 144, "GC::kSizeClasses[15] == 128 && GC::kSizeClasses[16] == 144", __FILE__, __LINE__);
+    table[16] = 136;
+    GCConfig config;
+    config.sizeClasses = table;
+    GC* gc = new GC(GCHeap::GetGCHeap(), config);
+    {
+        MMGC_GCENTER(gc);
+        void* p = gc->Alloc(136 - DebugSize(), GC::kZero, kAVMShellGCPartition);
+        void* q = gc->Alloc(137 - DebugSize(), GC::kZero, kAVMShellGCPartition);
+        void* r = gc->AllocPtrZero(120 - DebugSize(), kAVMShellGCPartition);
+// line 52 "ST_mmgc_sizeclasses.st"
+verifyPass(GC::Size(p) == 136 - DebugSize(), "GC::Size(p) == 136 - DebugSize()", __FILE__, __LINE__);
+// line 53 "ST_mmgc_sizeclasses.st"
+verifyPass(GC::Size(q) == 160 - DebugSize(), "GC::Size(q) == 160 - DebugSize()", __FILE__, __LINE__);
+// line 54 "ST_mmgc_sizeclasses.st"
+verifyPass(GC::Size(r) == 120 - DebugSize(), "GC::Size(r) == 120 - DebugSize()", __FILE__, __LINE__);
+    }
+    delete gc;
+}
 
-    parseApply("-loadCeiling 11.5");
-// line 243 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 244 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcLoadCeiling, 11.5), "approxEqual(m_heap->config.gcLoadCeiling, 11.5)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+}
+void ST_mmgc_sizeclasses::test1() {
+{
+    copyDefaults();
+// line 62 "ST_mmgc_sizeclasses.st"
+verifyPass(SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses), "SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses)", __FILE__, __LINE__);
+    table[0] = 16;
+// line 64 "ST_mmgc_sizeclasses.st"
+verifyPass(!SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses), "!SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses)", __FILE__, __LINE__);
+    copyDefaults();
+    table[GC::kNumSizeClasses-1] = 1960;
+// line 67 "ST_mmgc_sizeclasses.st"
+verifyPass(!SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses), "!SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses)", __FILE__, __LINE__);
+    copyDefaults();
+    table[16] = 140;
+// line 70 "ST_mmgc_sizeclasses.st"
+verifyPass(!SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses), "!SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses)", __FILE__, __LINE__);
+    copyDefaults();
+    table[16] = 128;
+// line 73 "ST_mmgc_sizeclasses.st"
+verifyPass(!SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses), "!SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses)", __FILE__, __LINE__);
+
+    // An invalid table is ignored.
+    GCConfig config;
+    config.sizeClasses = table;
+    GC* gc = new GC(GCHeap::GetGCHeap(), config);
+    {
+        MMGC_GCENTER(gc);
+        void* p = gc->Alloc(136 - DebugSize(), GC::kZero, kAVMShellGCPartition);
+// line 82 "ST_mmgc_sizeclasses.st"
+verifyPass(GC::Size(p) == 144 - DebugSize(), "GC::Size(p) == 144 - DebugSize()", __FILE__, __LINE__);
+    }
+    delete gc;
+}
 
-    parseApply("-gcwork 12.5");
-// line 249 "ST_mmgc_gcoption.st"
-verifyPass(gcoptionButIncorrectFormat(), "gcoptionButIncorrectFormat()", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+}
+void ST_mmgc_sizeclasses::test2() {
+{
+    const int n = 10;
+    const int k = classFor(100);
+    GCConfig config;
+    config.sizeClassStatistics = true;
+    GC* gc = new GC(GCHeap::GetGCHeap(), config);
+    {
+        MMGC_GCENTER(gc);
+        void* objs[n];
+        for (int i=0; i < n/2; i++)
+            objs[i] = gc->Alloc(100, GC::kZero, kAVMShellGCPartition);
+        for (int i=n/2; i < n; i++)
+            objs[i] = gc->AllocPtrZero(100, kAVMShellGCPartition);
+
+        SizeClassStats stats;
+        gc->GetSizeClassStats(k, stats);
+// line 104 "ST_mmgc_sizeclasses.st"
+verifyPass(stats.itemSize == uint32_t(GC::kSizeClasses[k]), "stats.itemSize == uint32_t(GC::kSizeClasses[k])", __FILE__, __LINE__);
+// line 105 "ST_mmgc_sizeclasses.st"
+verifyPass(stats.requests >= uint64_t(n), "stats.requests >= uint64_t(n)", __FILE__, __LINE__);
+// line 106 "ST_mmgc_sizeclasses.st"
+verifyPass(stats.bytesRequested >= uint64_t(n * 100), "stats.bytesRequested >= uint64_t(n * 100)", __FILE__, __LINE__);
+// line 107 "ST_mmgc_sizeclasses.st"
+verifyPass(stats.bytesRounded == stats.requests * stats.itemSize, "stats.bytesRounded == stats.requests * stats.itemSize", __FILE__, __LINE__);
+// line 108 "ST_mmgc_sizeclasses.st"
+verifyPass(stats.liveItems >= size_t(n), "stats.liveItems >= size_t(n)", __FILE__, __LINE__);
+// line 109 "ST_mmgc_sizeclasses.st"
+verifyPass(stats.blocks >= 1, "stats.blocks >= 1", __FILE__, __LINE__);
+        for (int i=0; i < n; i++)
+            gc->Free(objs[i]);
+    }
+    delete gc;
 
-    parseApply("-gcwork 0.123456");
-// line 254 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 255 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcEfficiency, .123456), "approxEqual(m_heap->config.gcEfficiency, .123456)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+    // Without statistics the requests are not counted.
+    GCConfig plain;
+    gc = new GC(GCHeap::GetGCHeap(), plain);
+    {
+        MMGC_GCENTER(gc);
+        gc->Alloc(100, GC::kZero, kAVMShellGCPartition);
+        SizeClassStats stats;
+        gc->GetSizeClassStats(k, stats);
+// line 123 "ST_mmgc_sizeclasses.st"
+verifyPass(stats.requests == 0, "stats.requests == 0", __FILE__, __LINE__);
+// line 124 "ST_mmgc_sizeclasses.st"
+verifyPass(!gc->ComputeSizeClasses(table), "!gc->ComputeSizeClasses(table)", __FILE__, __LINE__);
+    }
+    delete gc;
+}
 
-    parseApply("-gcwork=0.23456");
-// line 260 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 261 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcEfficiency, .23456), "approxEqual(m_heap->config.gcEfficiency, .23456)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+}
+void ST_mmgc_sizeclasses::test3() {
+{
+    const uint32_t largest = uint32_t(GC::kSizeClasses[GC::kNumSizeClasses-1]);
+    SizeClassHistogram histogram;
+// line 133 "ST_mmgc_sizeclasses.st"
+verifyPass(histogram.Init(largest), "histogram.Init(largest)", __FILE__, __LINE__);
+    copyDefaults();
+// line 135 "ST_mmgc_sizeclasses.st"
+verifyPass(!histogram.ComputeSizeClasses(table, GC::kNumSizeClasses, 1, 4000), "!histogram.ComputeSizeClasses(table, GC::kNumSizeClasses, 1, 4000)", __FILE__, __LINE__);
+    for (int i=0; i < 1000; i++) {
+        histogram.Record(200, 196);
+        histogram.Record(600, 600);
+    }
+    histogram.Record(largest + 8, largest + 8);
+// line 141 "ST_mmgc_sizeclasses.st"
+verifyPass(histogram.largeRequests == 1, "histogram.largeRequests == 1", __FILE__, __LINE__);
+
+// line 143 "ST_mmgc_sizeclasses.st"
+verifyPass(histogram.ComputeSizeClasses(table, GC::kNumSizeClasses, 1, 4000), "histogram.ComputeSizeClasses(table, GC::kNumSizeClasses, 1, 4000)", __FILE__, __LINE__);
+    bool has200 = false, has600 = false;
+    for (int i=0; i < GC::kNumSizeClasses; i++) {
+        has200 = has200 || table[i] == 200;
+        has600 = has600 || table[i] == 600;
+    }
+// line 149 "ST_mmgc_sizeclasses.st"
+verifyPass(has200 && has600, "has200 && has600", __FILE__, __LINE__);
+// line 150 "ST_mmgc_sizeclasses.st"
+verifyPass(SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses), "SizeClassHistogram::IsValid(table, GC::kSizeClasses, GC::kNumSizeClasses)", __FILE__, __LINE__);
 
-    parseApply("-gcwork", "0.3456");
-// line 266 "ST_mmgc_gcoption.st"
-verifyPass(parsedCorrectly(), "parsedCorrectly()", __FILE__, __LINE__);
-// line 267 "ST_mmgc_gcoption.st"
-verifyPass(approxEqual(m_heap->config.gcEfficiency, .3456), "approxEqual(m_heap->config.gcEfficiency, .3456)", __FILE__, __LINE__);
-          ;
-    restoreHeapConfig();
+    SizeClassStats stats;
+    VMPI_memset(&stats, 0, sizeof(stats));
+    histogram.Accumulate(192, 200, stats);
+// line 155 "ST_mmgc_sizeclasses.st"
+verifyPass(stats.requests == 1000 && stats.bytesRequested == 196000, "stats.requests == 1000 && stats.bytesRequested == 196000", __FILE__, __LINE__);
+}
 
 }
+void ST_mmgc_sizeclasses::test4() {
+{
+    FixedMalloc* fm = FixedMalloc::GetFixedMalloc(0);
+    void* p = fm->Alloc(24);
+    size_t live = 0;
+    bool sizes = true;
+    for (int i=0; i < FixedMalloc::kNumSizeClasses; i++) {
+        SizeClassStats stats;
+        fm->GetSizeClassStats(i, stats);
+        sizes = sizes && stats.itemSize == uint32_t(FixedMalloc::kSizeClasses[i]);
+        live += stats.liveItems;
+    }
+// line 170 "ST_mmgc_sizeclasses.st"
+verifyPass(sizes, "sizes", __FILE__, __LINE__);
+// line 171 "ST_mmgc_sizeclasses.st"
+verifyPass(live >= 1, "live >= 1", __FILE__, __LINE__);
+    fm->Free(p);
+}
 
 }
-void create_mmgc_gcoption(AvmCore* core) { new ST_mmgc_gcoption(core); }
+void create_mmgc_sizeclasses(AvmCore* core) { new ST_mmgc_sizeclasses(core); }
 }
 }
 #endif
 
-// Generated from ST_mmgc_mmfx_array.st
-// -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+// Generated from ST_mmgc_stackframes.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
 //
 // This Source Code Form is subject to the terms of the Mozilla Public
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+// Exact stack frames (GCConfig::exactStackFrames): the frames reported by a
+// GCCallback are scanned by their bitmaps, the rest of the stack conservatively,
+// and frames that are out of range, out of order or overlapping are ignored.
+
 #include "avmshell.h"
 #ifdef VMCFG_SELFTEST
 namespace avmplus {
-namespace ST_mmgc_mmfx_array {
-class ST_mmgc_mmfx_array : public Selftest {
+namespace ST_mmgc_stackframes {
+using namespace MMgc;
+
+class Node : public GCFinalizedObject
+{
 public:
-ST_mmgc_mmfx_array(AvmCore* core);
+    Node(int key) : key(key) {}
+    ~Node() { key = -1; }
+    int key;
+};
+
+// Reports one frame, if it has been given one.
+class FrameReporter : public GCCallback
+{
+public:
+    FrameReporter(GC* gc) : GCCallback(gc), base(NULL), nwords(0), bitmap(NULL) {}
+
+    virtual void enumerateStackFrames(GCStackFrames& frames)
+    {
+        if (base != NULL)
+            frames.AddFrame(base, nwords, bitmap);
+    }
+
+    const void* base;
+    uint32_t nwords;
+    const uint32_t* bitmap;
+};
+
+struct RefRoot : public GCRoot
+{
+    RefRoot(GC* gc) : GCRoot(gc), ref(NULL) {}
+    GCWeakRef* ref;
+};
+
+static const uint32_t kFrameWords = 40;
+
+class ST_mmgc_stackframes : public Selftest {
+public:
+ST_mmgc_stackframes(AvmCore* core);
 virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
 private:
 static const char* ST_names[];
 static const bool ST_explicits[];
 void test0();
 void test1();
 void test2();
+private:
+    MMgc::GC *gc;
+
+    // Collect with a frame of kFrameWords words on the stack below the caller,
+    // holding a new Node in word 'slot' and reported with 'bitmap'; 'root' gets a
+    // weak reference to the node.
+    NO_INLINE void collectWithFrame(FrameReporter* reporter, RefRoot* root, uint32_t slot, const uint32_t* bitmap, bool inRange)
+    {
+        uintptr_t frame[kFrameWords];
+        VMPI_memset(frame, 0, sizeof(frame));
+        Node* node = new (gc) Node(1);
+        root->ref = node->GetWeakRef();
+        frame[slot] = (uintptr_t)node;
+        node = NULL;
+
+        // A frame on the heap is out of the range that is scanned.
+        uintptr_t* outside = (uintptr_t*)VMPI_alloc(sizeof(frame));
+        reporter->base = inRange ? (void*)frame : (void*)outside;
+        reporter->nwords = kFrameWords;
+        reporter->bitmap = bitmap;
+        gc->Collect();
+        reporter->base = NULL;
+        VMPI_free(outside);
+    }
+
 };
-ST_mmgc_mmfx_array::ST_mmgc_mmfx_array(AvmCore* core)
-    : Selftest(core, "mmgc", "mmfx_array", ST_mmgc_mmfx_array::ST_names,ST_mmgc_mmfx_array::ST_explicits)
+ST_mmgc_stackframes::ST_mmgc_stackframes(AvmCore* core)
+    : Selftest(core, "mmgc", "stackframes", ST_mmgc_stackframes::ST_names,ST_mmgc_stackframes::ST_explicits)
 {}
-const char* ST_mmgc_mmfx_array::ST_names[] = {"mmfx_new_array_oom","mmfx_new_array_opts_canFail","mmfx_new_array_opts_oom", NULL };
-const bool ST_mmgc_mmfx_array::ST_explicits[] = {true,true,true, false };
-void ST_mmgc_mmfx_array::run(int n) {
+const char* ST_mmgc_stackframes::ST_names[] = {"traced","outofrange","ordering", NULL };
+const bool ST_mmgc_stackframes::ST_explicits[] = {false,false,false, false };
+void ST_mmgc_stackframes::run(int n) {
 switch(n) {
 case 0: test0(); return;
 case 1: test1(); return;
 case 2: test2(); return;
 }
 }
-using namespace MMgc;
+void ST_mmgc_stackframes::prologue() {
+    GCConfig config;
+    config.exactStackFrames = true;
+    gc = new GC(GCHeap::GetGCHeap(), config);
 
-// There are different failure modes.
-// 1) if you call mmfx_new_array() it can OOM:
-//     -> it should OOM and shutdown
-// 2) if you call mmfx_new_array_opts(canFail) and it OOMs:
-//     -> it should return NULL and NOT OOM
-// 3) if you call mmfx_new_aray_opts() without the canFail flag:
-//     -> it should OOM and shutdown
+}
+void ST_mmgc_stackframes::epilogue() {
+    delete gc;
 
+}
+void ST_mmgc_stackframes::test0() {
+{
+    MMGC_GCENTER(gc);
+    FrameReporter reporter(gc);
+    RefRoot* root = new RefRoot(gc);
+    uint32_t bitmap[2] = { (1U << 3) | (1U << 7), 1U << (33 - 32) };
 
-void ST_mmgc_mmfx_array::test0() {
-    // This will cause an OOM abort and exit, run with -memlimit 1024
-    int* m_ints = mmfx_new_array(int, 1048576);
-    mmfx_delete_array(m_ints);
-    m_ints = NULL;
-// line 27 "ST_mmgc_mmfx_array.st"
-verifyPass(false, "false", __FILE__, __LINE__);
+    collectWithFrame(&reporter, root, 33, bitmap, true);
+    StackFrameStats stats;
+    gc->GetStackFrameStats(stats);
+// line 95 "ST_mmgc_stackframes.st"
+verifyPass(stats.frames == 1, "stats.frames == 1", __FILE__, __LINE__);
+// line 96 "ST_mmgc_stackframes.st"
+verifyPass(stats.wordsTraced == 3, "stats.wordsTraced == 3", __FILE__, __LINE__);
+// line 97 "ST_mmgc_stackframes.st"
+verifyPass(stats.wordsSkipped == kFrameWords - 3, "stats.wordsSkipped == kFrameWords - 3", __FILE__, __LINE__);
+// line 98 "ST_mmgc_stackframes.st"
+verifyPass(stats.wordsConservative > 0, "stats.wordsConservative > 0", __FILE__, __LINE__);
+
+    // The node was only reachable from a traced word of the frame.
+    Node* node = (Node*)(void*)root->ref->get();
+// line 102 "ST_mmgc_stackframes.st"
+verifyPass(node != NULL && node->key == 1, "node != NULL && node->key == 1", __FILE__, __LINE__);
 
+    delete root;
 }
-void ST_mmgc_mmfx_array::test1() {
-    // This should fail and return NULL, run with -memlimit 1024
-    int* m_ints = mmfx_new_array_opt(int, 1048576, MMgc::kCanFail);
-// line 32 "ST_mmgc_mmfx_array.st"
-verifyPass(m_ints == NULL, "m_ints == NULL", __FILE__, __LINE__);
-    mmfx_delete_array(m_ints);
-    m_ints = NULL;
 
 }
-void ST_mmgc_mmfx_array::test2() {
-    // This will cause an OOM abort and exit, run with -memlimit 1024
-    int* m_ints = mmfx_new_array_opt(int, 1048576, MMgc::kZero);
-    mmfx_delete_array(m_ints);
-    m_ints = NULL;
-// line 41 "ST_mmgc_mmfx_array.st"
-verifyPass(false, "false", __FILE__, __LINE__);
+void ST_mmgc_stackframes::test1() {
+{
+    MMGC_GCENTER(gc);
+    FrameReporter reporter(gc);
+    RefRoot* root = new RefRoot(gc);
+    uint32_t bitmap[2] = { 0xffffffff, 0xffffffff };
 
+    collectWithFrame(&reporter, root, 0, bitmap, false);
+    StackFrameStats stats;
+    gc->GetStackFrameStats(stats);
+// line 117 "ST_mmgc_stackframes.st"
+verifyPass(stats.frames == 0, "stats.frames == 0", __FILE__, __LINE__);
+// line 118 "ST_mmgc_stackframes.st"
+verifyPass(stats.wordsTraced == 0, "stats.wordsTraced == 0", __FILE__, __LINE__);
+// line 119 "ST_mmgc_stackframes.st"
+verifyPass(stats.wordsConservative > 0, "stats.wordsConservative > 0", __FILE__, __LINE__);
 
+    delete root;
+}
 
 }
-void create_mmgc_mmfx_array(AvmCore* core) { new ST_mmgc_mmfx_array(core); }
+void ST_mmgc_stackframes::test2() {
+{
+    uintptr_t words[32];
+    uint32_t bitmap = 0;
+    GCStackFrames frames;
+    frames.Begin(words, words + 32);
+
+    frames.AddFrame(words + 4, 4, &bitmap);
+// line 132 "ST_mmgc_stackframes.st"
+verifyPass(frames.m_count == 1, "frames.m_count == 1", __FILE__, __LINE__);
+    // Below or overlapping the last frame.
+    frames.AddFrame(words, 4, &bitmap);
+    frames.AddFrame(words + 7, 4, &bitmap);
+// line 136 "ST_mmgc_stackframes.st"
+verifyPass(frames.m_count == 1, "frames.m_count == 1", __FILE__, __LINE__);
+    // Unaligned, empty, or running past the end.
+    frames.AddFrame((char*)(words + 8) + 1, 4, &bitmap);
+    frames.AddFrame(words + 8, 0, &bitmap);
+    frames.AddFrame(words + 30, 4, &bitmap);
+// line 141 "ST_mmgc_stackframes.st"
+verifyPass(frames.m_count == 1, "frames.m_count == 1", __FILE__, __LINE__);
+    frames.AddFrame(words + 8, 4, &bitmap);
+    frames.AddFrame(words + 28, 4, &bitmap);
+// line 144 "ST_mmgc_stackframes.st"
+verifyPass(frames.m_count == 3, "frames.m_count == 3", __FILE__, __LINE__);
+// line 145 "ST_mmgc_stackframes.st"
+verifyPass(frames.InRange(words + 31, sizeof(uintptr_t)), "frames.InRange(words + 31, sizeof(uintptr_t))", __FILE__, __LINE__);
+// line 146 "ST_mmgc_stackframes.st"
+verifyPass(!frames.InRange(words + 31, 2 * sizeof(uintptr_t)), "!frames.InRange(words + 31, 2 * sizeof(uintptr_t))", __FILE__, __LINE__);
+
+    frames.End();
+// line 149 "ST_mmgc_stackframes.st"
+verifyPass(frames.m_count == 0, "frames.m_count == 0", __FILE__, __LINE__);
+// line 150 "ST_mmgc_stackframes.st"
+verifyPass(!frames.InRange(words, sizeof(uintptr_t)), "!frames.InRange(words, sizeof(uintptr_t))", __FILE__, __LINE__);
+}
+
+}
+void create_mmgc_stackframes(AvmCore* core) { new ST_mmgc_stackframes(core); }
 }
 }
 #endif
@@ -3476,6 +6618,195 @@ void create_mmgc_threads(AvmCore* core) { new ST_mmgc_threads(core); }
 #endif
 #endif
 
+// Generated from ST_mmgc_tracelog.st
+// -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
+// vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+// GCTraceLog: the ring buffer keeps the most recent events, a collection and a
+// decommit record their phases on the GC's and the heap's tracks, and the log is
+// written as Chrome trace-event JSON.
+
+#include "avmshell.h"
+#ifdef VMCFG_SELFTEST
+namespace avmplus {
+namespace ST_mmgc_tracelog {
+using namespace MMgc;
+
+class ST_mmgc_tracelog : public Selftest {
+public:
+ST_mmgc_tracelog(AvmCore* core);
+virtual void run(int n);
+virtual void prologue();
+virtual void epilogue();
+private:
+static const char* ST_names[];
+static const bool ST_explicits[];
+void test0();
+void test1();
+private:
+    MMgc::GC *gc;
+
+    // The trace is written to the current directory and removed when read.
+    static const char* file() { return "ST_mmgc_tracelog.tmp"; }
+
+    // Reads file() into 'buf', NUL-terminated.  Returns false if it can't be read.
+    static bool readTrace(char* buf, size_t size)
+    {
+        FILE* fp = fopen(file(), "r");
+        if (fp == NULL)
+            return false;
+        size_t got = fread(buf, 1, size - 1, fp);
+        fclose(fp);
+        remove(file());
+        buf[got] = 0;
+        return got > 0;
+    }
+
+    // The number of events named 'name' on 'track' in 'log'.
+    static uint32_t count(GCTraceLog* log, const char* name, uint32_t track)
+    {
+        uint32_t n = 0;
+        uint64_t first = log->m_total > log->m_capacity ? log->m_total - log->m_capacity : 0;
+        for (uint64_t i=first ; i < log->m_total ; i++) {
+            GCTraceLog::Event& e = log->m_events[i % log->m_capacity];
+            if (VMPI_strcmp(e.name, name) == 0 && e.track == track)
+                n++;
+        }
+        return n;
+    }
+
+};
+ST_mmgc_tracelog::ST_mmgc_tracelog(AvmCore* core)
+    : Selftest(core, "mmgc", "tracelog", ST_mmgc_tracelog::ST_names,ST_mmgc_tracelog::ST_explicits)
+{}
+const char* ST_mmgc_tracelog::ST_names[] = {"ring","collection", NULL };
+const bool ST_mmgc_tracelog::ST_explicits[] = {false,false, false };
+void ST_mmgc_tracelog::run(int n) {
+switch(n) {
+case 0: test0(); return;
+case 1: test1(); return;
+}
+}
+void ST_mmgc_tracelog::prologue() {
+    GCConfig config;
+    gc = new GC(GCHeap::GetGCHeap(), config);
+
+}
+void ST_mmgc_tracelog::epilogue() {
+    delete gc;
+
+}
+void ST_mmgc_tracelog::test0() {
+{
+    GCTraceLog log(4);
+// line 61 "ST_mmgc_tracelog.st"
+verifyPass(log.IsValid(), "log.IsValid()", __FILE__, __LINE__);
+// line 62 "ST_mmgc_tracelog.st"
+verifyPass(log.NewTrack() == 1, "log.NewTrack() == 1", __FILE__, __LINE__);
+// line 63 "ST_mmgc_tracelog.st"
+verifyPass(log.NewTrack() == 2, "log.NewTrack() == 2", __FILE__, __LINE__);
+
+    static const char* names[] = { "e0", "e1", "e2", "e3", "e4", "e5" };
+    for ( int i=0 ; i < 6 ; i++ )
+        log.Record(names[i], 1, log.m_origin + i, log.m_origin + i + 1, -i, i);
+// line 68 "ST_mmgc_tracelog.st"
+verifyPass(log.GetTotalEvents() == 6, "log.GetTotalEvents() == 6", __FILE__, __LINE__);
+// line 69 "ST_mmgc_tracelog.st"
+verifyPass(count(&log, "e1", 1) == 0, "count(&log, \"e1\", 1) == 0", __FILE__, __LINE__);
+// line 70 "ST_mmgc_tracelog.st"
+verifyPass(count(&log, "e2", 1) == 1, "count(&log, \"e2\", 1) == 1", __FILE__, __LINE__);
+// line 71 "ST_mmgc_tracelog.st"
+verifyPass(count(&log, "e5", 1) == 1, "count(&log, \"e5\", 1) == 1", __FILE__, __LINE__);
+
+    char buf[4096];
+// line 74 "ST_mmgc_tracelog.st"
+verifyPass(log.Write(file()), "log.Write(file())", __FILE__, __LINE__);
+// line 75 "ST_mmgc_tracelog.st"
+verifyPass(readTrace(buf, sizeof(buf)), "readTrace(buf, sizeof(buf))", __FILE__, __LINE__);
+    bool header = VMPI_strncmp(buf, "{\"traceEvents\":[", 16) == 0;
+    bool dropped = VMPI_strstr(buf, "\"name\":\"e1\"") == NULL;
+    bool kept = VMPI_strstr(buf, "\"name\":\"e2\"") != NULL;
+    bool args = VMPI_strstr(buf, "\"bytes\":-5,\"heapBytes\":5") != NULL;
+    bool track = VMPI_strstr(buf, "\"args\":{\"name\":\"GC 2\"}") != NULL;
+    bool total = VMPI_strstr(buf, "\"dropped\":\"2\"") != NULL;
+// line 82 "ST_mmgc_tracelog.st"
+verifyPass(header, "header", __FILE__, __LINE__);
+// line 83 "ST_mmgc_tracelog.st"
+verifyPass(dropped && kept, "dropped && kept", __FILE__, __LINE__);
+// line 84 "ST_mmgc_tracelog.st"
+verifyPass(args, "args", __FILE__, __LINE__);
+// line 85 "ST_mmgc_tracelog.st"
+verifyPass(track, "track", __FILE__, __LINE__);
+// line 86 "ST_mmgc_tracelog.st"
+verifyPass(total, "total", __FILE__, __LINE__);
+}
+
+}
+void ST_mmgc_tracelog::test1() {
+{
+    GCHeap* heap = GCHeap::GetGCHeap();
+    GCTraceLog log(1024);
+    GCTraceLog* saved = heap->traceLog;
+    heap->traceLog = &log;
+    {
+        MMGC_GCENTER(gc);
+        for ( int i=0 ; i < 1000 ; i++ )
+            new (gc) GCFinalizedObject();
+        gc->Collect();
+    }
+    heap->Decommit();
+    heap->traceLog = saved;
+
+// line 104 "ST_mmgc_tracelog.st"
+verifyPass(log.m_total <= log.m_capacity, "log.m_total <= log.m_capacity", __FILE__, __LINE__);
+// line 105 "ST_mmgc_tracelog.st"
+verifyPass(gc->traceTrack != 0, "gc->traceTrack != 0", __FILE__, __LINE__);
+// line 106 "ST_mmgc_tracelog.st"
+verifyPass(count(&log, "StartIncrementalMark", gc->traceTrack) >= 1, "count(&log, \"StartIncrementalMark\", gc->traceTrack) >= 1", __FILE__, __LINE__);
+// line 107 "ST_mmgc_tracelog.st"
+verifyPass(count(&log, "FinalRootAndStackScan", gc->traceTrack) >= 1, "count(&log, \"FinalRootAndStackScan\", gc->traceTrack) >= 1", __FILE__, __LINE__);
+// line 108 "ST_mmgc_tracelog.st"
+verifyPass(count(&log, "FinalizeAndSweep", gc->traceTrack) >= 1, "count(&log, \"FinalizeAndSweep\", gc->traceTrack) >= 1", __FILE__, __LINE__);
+// line 109 "ST_mmgc_tracelog.st"
+verifyPass(count(&log, "PresweepCallbacks", gc->traceTrack) >= 1, "count(&log, \"PresweepCallbacks\", gc->traceTrack) >= 1", __FILE__, __LINE__);
+// line 110 "ST_mmgc_tracelog.st"
+verifyPass(count(&log, "PostsweepCallbacks", gc->traceTrack) >= 1, "count(&log, \"PostsweepCallbacks\", gc->traceTrack) >= 1", __FILE__, __LINE__);
+// line 111 "ST_mmgc_tracelog.st"
+verifyPass(count(&log, "Collection", gc->traceTrack) >= 1, "count(&log, \"Collection\", gc->traceTrack) >= 1", __FILE__, __LINE__);
+// line 112 "ST_mmgc_tracelog.st"
+verifyPass(count(&log, "Decommit", GCTraceLog::kHeapTrack) >= 1, "count(&log, \"Decommit\", GCTraceLog::kHeapTrack) >= 1", __FILE__, __LINE__);
+
+    // The callbacks are within the sweep, and the sweep within the collection.
+    GCTraceLog::Event* sweep = NULL;
+    GCTraceLog::Event* presweep = NULL;
+    GCTraceLog::Event* collection = NULL;
+    for ( uint64_t i=0 ; i < log.m_total ; i++ ) {
+        GCTraceLog::Event* e = &log.m_events[i];
+        if (VMPI_strcmp(e->name, "FinalizeAndSweep") == 0)
+            sweep = e;
+        else if (VMPI_strcmp(e->name, "PresweepCallbacks") == 0)
+            presweep = e;
+        else if (VMPI_strcmp(e->name, "Collection") == 0)
+            collection = e;
+    }
+// line 127 "ST_mmgc_tracelog.st"
+verifyPass(sweep->start <= presweep->start && presweep->end <= sweep->end, "sweep->start <= presweep->start && presweep->end <= sweep->end", __FILE__, __LINE__);
+// line 128 "ST_mmgc_tracelog.st"
+verifyPass(collection->start <= sweep->start && sweep->end <= collection->end, "collection->start <= sweep->start && sweep->end <= collection->end", __FILE__, __LINE__);
+// line 129 "ST_mmgc_tracelog.st"
+verifyPass(sweep->heapBytes > 0, "sweep->heapBytes > 0", __FILE__, __LINE__);
+}
+
+}
+void create_mmgc_tracelog(AvmCore* core) { new ST_mmgc_tracelog(core); }
+}
+}
+#endif
+
 // Generated from ST_mmgc_weakref.st
 // -*- mode: c; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*-
 // vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
@@ -3816,15 +7147,17 @@ private:
 static const char* ST_names[];
 static const bool ST_explicits[];
 void test0();
+void test1();
 };
 ST_nanojit_codealloc::ST_nanojit_codealloc(AvmCore* core)
     : Selftest(core, "nanojit", "codealloc", ST_nanojit_codealloc::ST_names,ST_nanojit_codealloc::ST_explicits)
 {}
-const char* ST_nanojit_codealloc::ST_names[] = {"allocfree", NULL };
-const bool ST_nanojit_codealloc::ST_explicits[] = {false, false };
+const char* ST_nanojit_codealloc::ST_names[] = {"allocfree","seal", NULL };
+const bool ST_nanojit_codealloc::ST_explicits[] = {false,false, false };
 void ST_nanojit_codealloc::run(int n) {
 switch(n) {
 case 0: test0(); return;
+case 1: test1(); return;
 }
 }
 
@@ -3872,6 +7205,45 @@ for (uint32_t i = 0; i < n_ap; i++) {
 verifyPass(true, "true", __FILE__, __LINE__);
 
 
+}
+void ST_nanojit_codealloc::test1() {
+
+#ifdef VMCFG_NANOJIT
+
+// After seal(), the free space left in a chunk that holds code is not handed out again.
+// The sealed chunks are executable, so the code is not freed; the destructor frees the chunks.
+nanojit::Config config;
+config.check_page_flags = true;
+CodeAlloc alloc(&config, 1);
+CodeList* code = NULL;
+NIns* start;
+NIns* end;
+
+// Keep the upper half of the first block and give the lower half back.
+alloc.alloc(start, end, 0);
+NIns* first = start;
+alloc.addRemainder(code, start, end, start, start + (end - start) / 2);
+size_t before = alloc.size();
+
+alloc.seal();
+alloc.alloc(start, end, 0);
+bool newChunk = alloc.size() == before + VMPI_getVMPageSize();
+bool elsewhere = start < first || start >= first + before / sizeof(NIns);
+CodeAlloc::add(code, start, end);
+debug_only( alloc.sanity_check(); )
+
+// line 223 "ST_nanojit_codealloc.st"
+verifyPass(newChunk, "newChunk", __FILE__, __LINE__);
+// line 224 "ST_nanojit_codealloc.st"
+verifyPass(elsewhere, "elsewhere", __FILE__, __LINE__);
+
+#else
+
+// line 228 "ST_nanojit_codealloc.st"
+verifyPass(true, "true", __FILE__, __LINE__);
+
+#endif /* VMCFG_NANOJIT */
+
 }
 void create_nanojit_codealloc(AvmCore* core) { new ST_nanojit_codealloc(core); }
 }
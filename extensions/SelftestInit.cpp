@@ -42,9 +42,27 @@ extern void create_mmgc_bugzilla_603411(AvmCore* core);
 namespace ST_mmgc_bugzilla_637993 {
 extern void create_mmgc_bugzilla_637993(AvmCore* core);
 }
+namespace ST_mmgc_allocsampler {
+extern void create_mmgc_allocsampler(AvmCore* core);
+}
+namespace ST_mmgc_asyncdecommit {
+extern void create_mmgc_asyncdecommit(AvmCore* core);
+}
 namespace ST_mmgc_basics {
 extern void create_mmgc_basics(AvmCore* core);
 }
+namespace ST_mmgc_bgsweep {
+extern void create_mmgc_bgsweep(AvmCore* core);
+}
+namespace ST_mmgc_blockcache {
+extern void create_mmgc_blockcache(AvmCore* core);
+}
+namespace ST_mmgc_compaction {
+extern void create_mmgc_compaction(AvmCore* core);
+}
+namespace ST_mmgc_conservativescan {
+extern void create_mmgc_conservativescan(AvmCore* core);
+}
 namespace ST_mmgc_dependent {
 extern void create_mmgc_dependent(AvmCore* core);
 }
@@ -66,14 +84,51 @@ extern void create_mmgc_gcheap(AvmCore* core);
 namespace ST_mmgc_gcoption {
 extern void create_mmgc_gcoption(AvmCore* core);
 }
+namespace ST_mmgc_generational {
+extern void create_mmgc_generational(AvmCore* core);
+}
+namespace ST_mmgc_grouphashtable {
+extern void create_mmgc_grouphashtable(AvmCore* core);
+}
+namespace ST_mmgc_heapsnapshot {
+extern void create_mmgc_heapsnapshot(AvmCore* core);
+}
+namespace ST_mmgc_incweakrefs {
+extern void create_mmgc_incweakrefs(AvmCore* core);
+}
 namespace ST_mmgc_mmfx_array {
 extern void create_mmgc_mmfx_array(AvmCore* core);
 }
+namespace ST_mmgc_pacing {
+extern void create_mmgc_pacing(AvmCore* core);
+}
+#if defined AVMPLUS_64BIT
+#if !defined MMGC_USE_UNIFORM_PAGEMAP
+namespace ST_mmgc_pagemap {
+extern void create_mmgc_pagemap(AvmCore* core);
+}
+#endif
+#endif
+namespace ST_mmgc_parallelmark {
+extern void create_mmgc_parallelmark(AvmCore* core);
+}
+namespace ST_mmgc_reap {
+extern void create_mmgc_reap(AvmCore* core);
+}
+namespace ST_mmgc_sizeclasses {
+extern void create_mmgc_sizeclasses(AvmCore* core);
+}
+namespace ST_mmgc_stackframes {
+extern void create_mmgc_stackframes(AvmCore* core);
+}
 #if defined VMCFG_WORKERTHREADS
 namespace ST_mmgc_threads {
 extern void create_mmgc_threads(AvmCore* core);
 }
 #endif
+namespace ST_mmgc_tracelog {
+extern void create_mmgc_tracelog(AvmCore* core);
+}
 namespace ST_mmgc_weakref {
 extern void create_mmgc_weakref(AvmCore* core);
 }
@@ -124,7 +179,13 @@ ST_mmgc_bugzilla_580603::create_mmgc_bugzilla_580603(core);
 ST_mmgc_bugzilla_603411::create_mmgc_bugzilla_603411(core);
 #endif
 ST_mmgc_bugzilla_637993::create_mmgc_bugzilla_637993(core);
+ST_mmgc_allocsampler::create_mmgc_allocsampler(core);
+ST_mmgc_asyncdecommit::create_mmgc_asyncdecommit(core);
 ST_mmgc_basics::create_mmgc_basics(core);
+ST_mmgc_bgsweep::create_mmgc_bgsweep(core);
+ST_mmgc_blockcache::create_mmgc_blockcache(core);
+ST_mmgc_compaction::create_mmgc_compaction(core);
+ST_mmgc_conservativescan::create_mmgc_conservativescan(core);
 ST_mmgc_dependent::create_mmgc_dependent(core);
 ST_mmgc_exact::create_mmgc_exact(core);
 ST_mmgc_externalalloc::create_mmgc_externalalloc(core);
@@ -132,10 +193,25 @@ ST_mmgc_finalize_uninit::create_mmgc_finalize_uninit(core);
 ST_mmgc_fixedmalloc_findbeginning::create_mmgc_fixedmalloc_findbeginning(core);
 ST_mmgc_gcheap::create_mmgc_gcheap(core);
 ST_mmgc_gcoption::create_mmgc_gcoption(core);
+ST_mmgc_generational::create_mmgc_generational(core);
+ST_mmgc_grouphashtable::create_mmgc_grouphashtable(core);
+ST_mmgc_heapsnapshot::create_mmgc_heapsnapshot(core);
+ST_mmgc_incweakrefs::create_mmgc_incweakrefs(core);
 ST_mmgc_mmfx_array::create_mmgc_mmfx_array(core);
+ST_mmgc_pacing::create_mmgc_pacing(core);
+#if defined AVMPLUS_64BIT
+#if !defined MMGC_USE_UNIFORM_PAGEMAP
+ST_mmgc_pagemap::create_mmgc_pagemap(core);
+#endif
+#endif
+ST_mmgc_parallelmark::create_mmgc_parallelmark(core);
+ST_mmgc_reap::create_mmgc_reap(core);
+ST_mmgc_sizeclasses::create_mmgc_sizeclasses(core);
+ST_mmgc_stackframes::create_mmgc_stackframes(core);
 #if defined VMCFG_WORKERTHREADS
 ST_mmgc_threads::create_mmgc_threads(core);
 #endif
+ST_mmgc_tracelog::create_mmgc_tracelog(core);
 ST_mmgc_weakref::create_mmgc_weakref(core);
 ST_nanojit_codealloc::create_nanojit_codealloc(core);
 ST_vmbase_concurrency::create_vmbase_concurrency(core);
@@ -157,6 +157,7 @@ typedef void* (*decode_instructions_ftype) (void* start, void* end,
         , _branchStateMap(alloc)
         , _patches(alloc)
         , _labels(alloc)
+        , _loops(alloc)
         , _noise(NULL)
     #if NJ_USES_IMMD_POOL
         , _immDPool(alloc)
@@ -174,6 +175,8 @@ typedef void* (*decode_instructions_ftype) (void* start, void* end,
         , vtuneHandle(NULL)
     #endif
         , _mdWriter(mdWriter)
+        , _stackMapWriter(NULL)
+        , _relocWriter(NULL)
 	#if NJ_BLIND_CONSTANTS
         , _blindMask32(0)
     #ifdef NANOJIT_64BIT
@@ -263,12 +266,37 @@ typedef void* (*decode_instructions_ftype) (void* start, void* end,
         return false;
     }
 
+    void Assembler::recordStackMap(NIns* returnAddress)
+    {
+        // AR entries are four bytes, entry i at FP - 4*i; the map has a bit per word.
+        const uint32_t slotsPerWord = sizeof(void*) / 4;
+        uint32_t bitmap[(NJ_MAX_STACK_ENTRY / (sizeof(void*) / 4) + 31) / 32];
+        uint32_t nwords = (_activation.stackSlotsNeeded() - 1 + slotsPerWord - 1) / slotsPerWord;
+        VMPI_memset(bitmap, 0, ((nwords + 31) / 32) * sizeof(uint32_t));
+
+        AR::Iter iter(_activation);
+        LIns* ins;
+        uint32_t nStackSlots;
+        int32_t arIndex;
+        while (iter.next(ins, nStackSlots, arIndex)) {
+            // LIR_allocp areas are pointer-typed too, and are included whole.
+            if (!ins->isP())
+                continue;
+            for (uint32_t i = uint32_t(arIndex); i < uint32_t(arIndex) + nStackSlots; i++) {
+                uint32_t word = (i - 1) / slotsPerWord;
+                bitmap[word >> 5] |= 1U << (word & 31);
+            }
+        }
+        _stackMapWriter->safepoint(this, returnAddress, bitmap, nwords);
+    }
+
     void Assembler::arReset()
     {
         _activation.clear();
         _branchStateMap.clear();
         _patches.clear();
         _labels.clear();
+        _loops.clear();
     #if NJ_USES_IMMD_POOL
         _immDPool.clear();
     #endif
@@ -1462,7 +1490,10 @@ typedef void* (*decode_instructions_ftype) (void* start, void* end,
             // have been emitted by unionRegisterState().
             debug_only( _fpuStkDepth = (_allocator.getActive(FST0) ? -1 : 0); )
 #endif
-            JMP(label->addr);
+            // The target may immediately follow the jump (eg. a range check
+            // whose condition was folded away), in which case just fall through.
+            if (_nIns != label->addr)
+                JMP(label->addr);
         }
         else {
             // Backwards jump.
@@ -1489,6 +1520,7 @@ typedef void* (*decode_instructions_ftype) (void* start, void* end,
 #endif
             if (!label) {
                 // save empty register state at loop header
+                holdLoopCarriedValues(to);
                 _labels.add(to, 0, _allocator);
             }
             else {
@@ -1531,6 +1563,7 @@ typedef void* (*decode_instructions_ftype) (void* start, void* end,
             if (!label) {
                 // Evict all registers, most conservative approach.
                 evictAllActiveRegs();
+                holdLoopCarriedValues(to);
                 _labels.add(to, 0, _allocator);
             }
             else {
@@ -1583,6 +1616,7 @@ typedef void* (*decode_instructions_ftype) (void* start, void* end,
             if (!label) {
                 // evict all registers, most conservative approach.
                 evictAllActiveRegs();
+                holdLoopCarriedValues(to);
                 _labels.add(to, 0, _allocator);
             }
             else {
@@ -1683,6 +1717,9 @@ typedef void* (*decode_instructions_ftype) (void* start, void* end,
                    reader->finalIns()->isRet()        ||
                    isLiveOpcode(reader->finalIns()->opcode()));
 
+        if (_config.global_regalloc)
+            findLoops(reader->finalIns());
+
         for (currIns = reader->read(); !currIns->isop(LIR_start); currIns = reader->read())
         {
             LIns* ins = currIns;        // give it a shorter name for local use
@@ -2671,6 +2708,260 @@ typedef void* (*decode_instructions_ftype) (void* start, void* end,
         pending_lives.clear();
     }
 
+    // Stores the value operands of 'ins' in 'ops', which has room for MAXARGS
+    // of them, and returns their number.
+    static uint32_t getValueOperands(LIns* ins, LIns** ops)
+    {
+        uint32_t n = 0;
+        if (ins->isLInsC()) {
+            for (uint32_t i = 0, argc = ins->argc(); i < argc; i++)
+                ops[n++] = ins->arg(i);
+        } else if (ins->isLInsOp1() || ins->isLInsOp1b() || ins->isLInsLd() || ins->isLInsJtbl()) {
+            ops[n++] = ins->oprnd1();
+        } else if (ins->isLInsOp2() || ins->isLInsSt()) {
+            ops[n++] = ins->oprnd1();
+            ops[n++] = ins->oprnd2();
+        } else if (ins->isLInsOp3()) {
+            ops[n++] = ins->oprnd1();
+            ops[n++] = ins->oprnd2();
+            ops[n++] = ins->oprnd3();
+        } else if (ins->isLInsOp4()) {
+            ops[n++] = ins->oprnd1();
+            ops[n++] = ins->oprnd2();
+            ops[n++] = ins->oprnd3();
+            ops[n++] = ins->oprnd4();
+        }
+        return n;
+    }
+
+    // Values that can be kept in a register across a loop edge.  Callee-saved
+    // register parameters are excluded: they only need a home at the return.
+    static bool isLoopCarriedCandidate(LIns* ins)
+    {
+        if (ins == NULL || !(ins->isI() || ins->isQ() || ins->isD()))
+            return false;
+        if (ins->isop(LIR_paramp) && ins->paramKind() != 0)
+            return false;
+        return !RegAlloc::canRemat(ins);
+    }
+
+    // A forward branch seen by findLoops().
+    struct LoopEdge
+    {
+        uint32_t from;      // position of the branch
+        LIns* to;
+    };
+
+    /**
+     * Finds the loops of the fragment, and for each the values that are defined
+     * before its label and used inside it, with their spill weights (see
+     * LoopState).  This is a backwards pass, in the order gen() reads the
+     * code: a loop becomes active at its last back edge, which is the first one
+     * seen, and ends at its label.  A use inside active loops is counted for
+     * each of them, and the definition of a value while a loop is active shows
+     * that the value is not carried by that loop after all.
+     *
+     * Back edges are branches to labels that have not been seen yet.  Jump
+     * tables are ignored, as the register state at their targets must be empty.
+     *
+     * A value must be defined on every path into the loop, so the values that
+     * are defined after a jump from outside into the loop, such as the OSR
+     * entry, are dropped at the end.
+     */
+    void Assembler::findLoops(LIns* finalIns)
+    {
+        static const int kMaxDepth = 8;
+        LIns* activeLabels[kMaxDepth];
+        LoopState* active[kMaxDepth];
+        int depth = 0;
+
+        // HashMap doesn't grow, so size it for the fragment.
+        uint32_t count = 0;
+        for (LirReader counter(finalIns); !counter.read()->isop(LIR_start); )
+            count++;
+        HashMap<LIns*, uint32_t> position(alloc, count/4 + 1);  // labels and candidate values
+        HashMap<LIns*, uint32_t> loopEnd(alloc);   // label -> position of last back edge
+        SeqBuilder<LoopEdge> forwardEdges(alloc);
+
+        // Positions count up from the end of the fragment.
+        _loops.clear();
+        uint32_t pos = 0;
+        LirReader reader(finalIns);
+        for (LIns* ins = reader.read(); !ins->isop(LIR_start); ins = reader.read(), pos++)
+        {
+            if (ins->isop(LIR_label)) {
+                position.put(ins, pos);
+                for (int i = 0; i < depth; i++) {
+                    if (activeLabels[i] == ins) {
+                        for (int j = i + 1; j < depth; j++) {
+                            activeLabels[j-1] = activeLabels[j];
+                            active[j-1] = active[j];
+                        }
+                        depth--;
+                        break;
+                    }
+                }
+                continue;
+            }
+
+            if (ins->isop(LIR_jtbl)) {
+                for (uint32_t i = 0, n = ins->getTableSize(); i < n; i++) {
+                    LoopEdge e = { pos, ins->getTarget(i) };
+                    if (position.containsKey(e.to))
+                        forwardEdges.add(e);
+                }
+            } else if (ins->isBranch()) {
+                LoopEdge e = { pos, ins->getTarget() };
+                if (position.containsKey(e.to)) {
+                    forwardEdges.add(e);
+                } else if (!_loops.containsKey(e.to) && depth < kMaxDepth) {
+                    LoopState* loop = new (alloc) LoopState(alloc);
+                    _loops.put(e.to, loop);
+                    loopEnd.put(e.to, pos);
+                    activeLabels[depth] = e.to;
+                    active[depth++] = loop;
+                }
+            }
+
+            if (isLoopCarriedCandidate(ins))
+                position.put(ins, pos);
+
+            if (depth == 0)
+                continue;
+
+            // Defined inside the loops: not carried by any of them.
+            for (int i = 0; i < depth; i++)
+                active[i]->carried.remove(ins);
+
+            if (ins->isCall()) {
+                for (int i = 0; i < depth; i++)
+                    active[i]->hasCalls = true;
+            }
+
+            LIns* ops[MAXARGS];
+            uint32_t weight = 1U << (3 * (depth - 1));
+            for (uint32_t k = 0, n = getValueOperands(ins, ops); k < n; k++) {
+                LIns* op = ops[k];
+                if (!isLoopCarriedCandidate(op))
+                    continue;
+                for (int i = 0; i < depth; i++) {
+                    uint32_t w = active[i]->carried.get(op);
+                    active[i]->carried.put(op, w + weight < w ? ~0U : w + weight);
+                }
+            }
+        }
+
+        LoopStateMap::Iter loops(_loops);
+        while (loops.next()) {
+            LIns* label = loops.key();
+            LoopState* loop = loops.value();
+            uint32_t start = position.get(label);
+            uint32_t end = loopEnd.get(label);
+
+            // The earliest jump into the loop from above it.
+            uint32_t entry = 0;
+            for (Seq<LoopEdge>* p = forwardEdges.get(); p != NULL; p = p->tail) {
+                uint32_t to = position.get(p->head.to);
+                if (p->head.from > start && to <= start && to >= end && p->head.from > entry)
+                    entry = p->head.from;
+            }
+            if (entry == 0)
+                continue;
+
+            SeqBuilder<LIns*> late(alloc);
+            HashMap<LIns*, uint32_t>::Iter values(loop->carried);
+            while (values.next()) {
+                if (position.get(values.key()) < entry)
+                    late.add(values.key());
+            }
+            for (Seq<LIns*>* p = late.get(); p != NULL; p = p->tail)
+                loop->carried.remove(p->head);
+        }
+    }
+
+    /**
+     * Called at the last back edge of a loop, before the register state for its
+     * label is saved: puts the heaviest values carried by the loop in free
+     * registers.  The loop body then finds them there, the label doesn't have to
+     * reload them on every iteration, and they are only spilled once, where
+     * they are defined.  Half of each register class is left to the loop body,
+     * and a loop that calls gets callee-saved registers only, so that it
+     * doesn't just trade the reload after the label for one after each call.
+     * Other back edges to the label pick the values up in intersectRegisterState().
+     */
+    void Assembler::holdLoopCarriedValues(LIns* label)
+    {
+        LoopState* loop = _loops.get(label);
+        if (!loop)
+            return;
+
+        // The heaviest values, by decreasing weight.
+        static const uint32_t kMaxHeld = 16;
+        LIns* held[kMaxHeld];
+        uint32_t weights[kMaxHeld];
+        uint32_t n = 0;
+        HashMap<LIns*, uint32_t>::Iter iter(loop->carried);
+        while (iter.next()) {
+            uint32_t w = iter.value();
+            if (n == kMaxHeld && w <= weights[n-1])
+                continue;
+            uint32_t i = (n < kMaxHeld) ? n++ : n - 1;
+            for (; i > 0 && weights[i-1] < w; i--) {
+                held[i] = held[i-1];
+                weights[i] = weights[i-1];
+            }
+            held[i] = iter.key();
+            weights[i] = w;
+        }
+
+        RegisterMask managed = _allocator.getManagedSet();
+        RegisterMask gpAllow = GpRegs & managed;
+        if (loop->hasCalls)
+            gpAllow &= SavedRegs;
+        RegisterMask fpAllow = 0;
+    #ifdef NANOJIT_X64
+        // Every xmm register is a scratch register.
+        if (!loop->hasCalls)
+            fpAllow = FpDRegs & managed;
+    #endif
+        int gpBudget = 0, fpBudget = 0;
+        for (RegisterMask m = gpAllow; m != 0; m &= m - 1)
+            gpBudget++;
+        for (RegisterMask m = fpAllow; m != 0; m &= m - 1)
+            fpBudget++;
+        gpBudget /= 2;
+        fpBudget /= 2;
+
+        for (uint32_t i = 0; i < n; i++) {
+            LIns* ins = held[i];
+            if (ins->isInReg())
+                continue;           // already there, e.g. for a LIR_live
+            RegisterMask allow;
+            if (ins->isD()) {
+                if (fpBudget == 0)
+                    continue;
+                fpBudget--;
+                allow = fpAllow;
+            } else {
+                if (gpBudget == 0)
+                    continue;
+                gpBudget--;
+                allow = gpAllow;
+            }
+            allow &= ~_allocator.activeMask();
+            if (allow == 0)
+                continue;
+            // The uses of 'ins' haven't been generated yet, and might turn out to
+            // be dead; it is live from here on anyway.
+            ins->setResultLive();
+            Register r = findRegFor(ins, allow);
+            (void)r;
+            verbose_only( RefBuf b;
+                          verbose_outputf("## holding %s in %s across the loop edge (weight %u)",
+                                          _thisfrag->lirbuf->printer->formatRef(&b, ins), gpn(r), weights[i]); )
+        }
+    }
+
     void AR::freeEntryAt(uint32_t idx)
     {
         NanoAssert(idx > 0 && idx <= _highWaterMark);
@@ -32,6 +32,8 @@ namespace nanojit
     #define STACK_GRANULARITY        sizeof(void *)
 
     class MetaDataWriter;
+    class StackMapWriter;
+    class RelocWriter;
 
     // Basics:
     // - 'entry' records the state of the native machine stack at particular
@@ -223,6 +225,24 @@ namespace nanojit
         LabelState *get(LIns *);
     };
 
+    /**
+     * The values that are defined before a loop and used inside it, as found by
+     * Assembler::findLoops() when Config::global_regalloc is set.  Each value
+     * has a spill weight, the sum over its uses in the loop of 8^d, where d is
+     * the number of loops the use is nested in.
+     */
+    class LoopState
+    {
+    public:
+        HashMap<LIns*, uint32_t> carried;   // value -> spill weight
+        bool hasCalls;                      // calls clobber the scratch registers
+        LoopState(Allocator& alloc) : carried(alloc), hasCalls(false)
+        {}
+    };
+
+    /** map from a loop's label to its LoopState */
+    typedef HashMap<LIns*, LoopState*> LoopStateMap;
+
     /**
      * Some architectures (i386, X64) can emit two branches that need patching
      * in some situations. This is returned by asm_branch() implementations
@@ -311,6 +331,8 @@ namespace nanojit
             void        beginAssembly(Fragment *frag);
 
             void        setNoiseGenerator(Noise* noise)  { _noise = noise; } // used for attack mitigation; setting to 0 disables all mitigations
+            void        setStackMapWriter(StackMapWriter* w) { _stackMapWriter = w; } // only used if NJ_STACKMAPS_SUPPORTED
+            void        setRelocWriter(RelocWriter* w) { _relocWriter = w; } // only used if NJ_RELOCATION_SUPPORTED
 
             void        releaseRegisters();
             void        patch(GuardRecord *lr);
@@ -405,6 +427,7 @@ namespace nanojit
             RegAllocMap         _branchStateMap;
             NInsMap             _patches;
             LabelStateMap       _labels;
+            LoopStateMap        _loops;
             Noise*              _noise;             // object to generate random noise used when hardening enabled.
         #if NJ_USES_IMMD_POOL
             ImmDPoolMap         _immDPool;
@@ -453,6 +476,14 @@ namespace nanojit
             RegAlloc    _allocator;
 
             MetaDataWriter* _mdWriter;
+            StackMapWriter* _stackMapWriter;
+
+            // Report the stack map of the call that returns to 'returnAddress' to
+            // _stackMapWriter.  Called by the backend once the call and its result
+            // have been assembled, but not its arguments.
+            void        recordStackMap(NIns* returnAddress);
+
+            RelocWriter* _relocWriter;
 
 #if NJ_BLIND_CONSTANTS
             uint32_t    _blindMask32;
@@ -558,6 +589,8 @@ namespace nanojit
             void        reserveSavedRegs();
             void        assignParamRegs();
             void        handleLoopCarriedExprs(InsList& pending_lives, RegisterMask reserved);
+            void        findLoops(LIns* finalIns);
+            void        holdLoopCarriedValues(LIns* label);
 
             // platform specific implementation (see NativeXXX.cpp file)
             void        nBeginAssembly();
@@ -612,5 +645,58 @@ namespace nanojit
         virtual ~MetaDataWriter() {}
     };
 
+    /**
+     * Receives the stack maps of a fragment, see Assembler::setStackMapWriter().
+     * A backend that supports them (NJ_STACKMAPS_SUPPORTED) reports a stack map
+     * for every call, which tells a garbage collector which words of the frame
+     * can hold pointers while the call is in progress.
+     */
+    class StackMapWriter {
+    public:
+        // Report the call that returns to 'returnAddress'.  'bitmap' has a bit
+        // for each of the 'nwords' words below the frame pointer, bit i (bit i%32
+        // of bitmap[i/32]) for the word at FP - (i+1)*sizeof(void*).  A bit is set
+        // if the word is part of a LIR_allocp area, or holds a pointer-sized value
+        // that is live across the call.  Spill slots of other types, free slots
+        // and padding are clear.  The outgoing arguments at the bottom of the
+        // frame are not included, see endAssembly().
+        virtual void safepoint(Assembler* assm, NIns* returnAddress,
+                               const uint32_t* bitmap, uint32_t nwords) = 0;
+
+        // Report the layout of the frame once the prologue has been generated:
+        // the stack pointer is 'frameSize' bytes below the frame pointer during
+        // the calls, and the lowest 'argSize' bytes of the frame hold outgoing
+        // arguments.
+        virtual void endAssembly(Assembler* assm, uint32_t frameSize, uint32_t argSize) = 0;
+
+        virtual ~StackMapWriter() {}
+    };
+
+    /**
+     * Receives the absolute addresses in the code of a fragment, see
+     * Assembler::setRelocWriter().  With a RelocWriter, a backend that supports
+     * it (NJ_RELOCATION_SUPPORTED) writes every call target and every 64-bit
+     * constant that does not fit in 32 bits as a full 64-bit immediate, and
+     * reports where it is, so that the code can be copied elsewhere and the
+     * immediates patched.  Branches are relative, except for the long branches
+     * that hold the absolute address of their target, which are reported with
+     * branch64().  Code that refers to an address in a way that can't be
+     * patched, such as a jump table or a constant pool, is reported with
+     * absolute().
+     */
+    class RelocWriter {
+    public:
+        // The 8 bytes at 'loc' hold 'value', the target of a call if 'call' is set.
+        virtual void imm64(Assembler* assm, NIns* loc, uint64_t value, bool call) = 0;
+
+        // The 8 bytes at 'loc' hold the target of a branch, which may be patched later.
+        virtual void branch64(Assembler* assm, NIns* loc) = 0;
+
+        // The code refers to an address that was not reported with imm64().
+        virtual void absolute(Assembler* assm) = 0;
+
+        virtual ~RelocWriter() {}
+    };
+
 }
 #endif // __nanojit_Assembler__
@@ -29,12 +29,12 @@ namespace nanojit
     // Sanity checks that should remain enabled in release builds.
     #define ABORT_UNLESS(cond) do { NanoAssert(cond); if (!(cond)) VMPI_abort(); } while(0)
 
-    CodeAlloc::CodeAlloc(const Config* config)
+    CodeAlloc::CodeAlloc(const Config* config, size_t chunkPages)
         : heapblocks(0)
         , availblocks(0)
         , totalAllocated(0)
         , bytesPerPage(VMPI_getVMPageSize())
-        , bytesPerAlloc(pagesPerAlloc * bytesPerPage)
+        , bytesPerAlloc((chunkPages != 0 ? chunkPages : pagesPerAlloc) * bytesPerPage)
         , _config(config)
     {
     }
@@ -230,6 +230,23 @@ namespace nanojit
         }
     }
 
+    void CodeAlloc::seal() {
+        CodeList* empty = 0;
+        while (availblocks) {
+            markBlockWrite(availblocks);
+            CodeList* b = removeBlock(availblocks);
+            if (b->lower == 0 && b->higher == b->terminator) {
+                // the whole chunk is free, there is no code in it
+                addBlock(empty, b);
+            } else {
+                // looks allocated from now on, so free() won't coalesce with it
+                b->isFree = false;
+            }
+        }
+        availblocks = empty;
+        markAllExec();
+    }
+
     void CodeAlloc::flushICache(CodeList* &blocks) {
         for (CodeList *b = blocks; b != 0; b = b->next)
             flushICache(b->start(), b->size());
@@ -159,7 +159,9 @@ namespace nanojit
         bool checkChunkMark(void* addr, size_t nbytes, bool isExec);
 
     public:
-        CodeAlloc(const Config* config);
+        /** 'chunkPages' is the size of the chunks to request, in pages; zero for the
+            platform's default. */
+        CodeAlloc(const Config* config, size_t chunkPages = 0);
         ~CodeAlloc();
 
         /** return all the memory allocated through this allocator to the gcheap. */
@@ -174,6 +176,13 @@ namespace nanojit
         /** free several blocks */
         void freeAll(CodeList* &code);
 
+        /** retire the free space in every chunk that holds code, so that later
+            allocations never make those chunks writable again, and mark all chunks
+            executable.  For code that is generated on one thread and run on another:
+            after seal(), the code allocated so far can be handed over while new code
+            goes to chunks of its own.  The retired space is given back by reset(). */
+        void seal();
+
         /** flush the icache for all code in the list, before executing */
         static void flushICache(CodeList* &blocks);
 
@@ -905,6 +905,44 @@ namespace nanojit
         initLInsSk(skipTo);
     }
 
+    bool LIns::replaceOperand(LIns* from, LIns* to)
+    {
+        bool replaced = false;
+        LIns** op;
+        switch (repKinds[opcode()]) {
+        case LRK_C:
+            for (uint32_t i = 0, n = argc(); i < n; i++) {
+                if (toLInsC()->args[i] == from) {
+                    toLInsC()->args[i] = to;
+                    replaced = true;
+                }
+            }
+            return replaced;
+        case LRK_Op4:
+            op = &toLInsOp4()->oprnd_4;
+            if (*op == from) { *op = to; replaced = true; }
+            // fall through
+        case LRK_Op3:
+            op = &toLInsOp3()->oprnd_3;
+            if (*op == from) { *op = to; replaced = true; }
+            // fall through
+        case LRK_Op2:
+        case LRK_St:
+            op = &toLInsOp2()->oprnd_2;
+            if (*op == from) { *op = to; replaced = true; }
+            // fall through
+        case LRK_Op1:
+        case LRK_Op1b:
+        case LRK_Ld:
+        case LRK_Jtbl:
+            op = &toLInsOp2()->oprnd_1;
+            if (*op == from) { *op = to; replaced = true; }
+            return replaced;
+        default:
+            return false;
+        }
+    }
+
     bool insIsS16(LIns* i)
     {
         if (i->isImmI()) {
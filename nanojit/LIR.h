@@ -1173,6 +1173,10 @@ NanoStaticAssert(LIR_start == 0 && LIR_sentinel <= 256); // It's ok if LIR_senti
         }
 
         void overwriteWithSkip(LIns* skipTo);
+
+        // Replaces every use of 'from' among the operands (and call arguments) of
+        // this instruction by 'to'.  Returns true if any operand was replaced.
+        bool replaceOperand(LIns* from, LIns* to);
     };
 
     typedef SeqBuilder<LIns*> InsList;
@@ -69,6 +69,14 @@
 #  define NJ_DIVI_SUPPORTED 0
 #endif
 
+#ifndef NJ_STACKMAPS_SUPPORTED
+#  define NJ_STACKMAPS_SUPPORTED 0
+#endif
+
+#ifndef NJ_RELOCATION_SUPPORTED
+#  define NJ_RELOCATION_SUPPORTED 0
+#endif
+
 #if NJ_SOFTFLOAT_SUPPORTED
     #define CASESF(x)   case x
 #else
@@ -207,6 +207,8 @@ namespace nanojit
         // written instruction, ie. the jump's successor.
         ((uint64_t*)_nIns)[-1] = (uint64_t) target;
         _nIns -= 8;
+        if (_relocWriter)
+            _relocWriter->branch64(this, _nIns);
         emit(op);
     }
 
@@ -1105,12 +1107,23 @@ namespace nanojit
         ArgType argTypes[MAXARGS];
         int argc = call->getArgTypes(argTypes);
 
+        // Make sure the call instruction goes right before the current position,
+        // which is then its return address.
+        NIns *returnAddress = NULL;
+        if (_stackMapWriter) {
+            underrunProtect(8);
+            returnAddress = _nIns;
+        }
+
         if (!call->isIndirect()) {
             verbose_only(if (_logc->lcbits & LC_Native)
                 outputf("        %p:", _nIns);
             )
             NIns *target = (NIns*)call->_address;
-            if (isTargetWithinS32(target)) {
+            if (_relocWriter) {
+                CALLRAX();
+                asm_immq_reloc(RAX, (uint64_t)target, /*call*/true);
+            } else if (isTargetWithinS32(target)) {
                 CALL(8, target);
             } else {
                 // can't reach target from here, load imm64 and do an indirect jump
@@ -1132,6 +1145,11 @@ namespace nanojit
             asm_regarg(ARGTYPE_P, ins->arg(--argc), RAX);
         }
 
+        // The result is free and the arguments are yet to be assembled, so the
+        // activation record holds just what is live across the call.
+        if (returnAddress)
+            recordStackMap(returnAddress);
+
     #ifdef _WIN64
         int stk_used = 32; // always reserve 32byte shadow area
     #else
@@ -1184,6 +1202,8 @@ namespace nanojit
         if(p->isImmF4()){
             // No need to blind constant, as we load from pool.
             const float4_t* vaddr = findImmF4FromPool(p->immF4());
+            if (_relocWriter)
+                _relocWriter->absolute(this);
             if( isTargetWithinS32((NIns*)vaddr) ) {
                 int32_t d = int32_t(int64_t(vaddr)-int64_t(_nIns));
                 LEARIP(r, d);
@@ -2284,6 +2304,8 @@ namespace nanojit
                 asm_immd(r, v0, canClobberCCs, /*blind*/false);
             } else {
                 const float4_t* vaddr = findImmF4FromPool(v);
+                if (_relocWriter)
+                    _relocWriter->absolute(this);
                 bool is_aligned = ( ((uintptr_t)vaddr) & 0xf ) == 0;
                 /* 
                     We must be sure that MOVAPSRMRIP/MOVAPSRMRIP does NOT cross into a new page.
@@ -2465,6 +2487,11 @@ namespace nanojit
             } else {
                 MOVQI32(r, int32_t(v));
             }
+        } else if (_relocWriter) {
+            // The value may be an address, write it where it can be patched.
+            if (blind && shouldBlind(v))
+                _relocWriter->absolute(this);
+            asm_immq_reloc(r, v, /*call*/false);
         } else if (isTargetWithinS32((NIns*)v) && !(blind && shouldBlind(v))) {
             // Value is within +/- 2GB from RIP, thus we can use LEA with RIP-relative disp32.
             // Don't use this pattern for blinded constants, as an attacker might know where
@@ -2485,6 +2512,15 @@ namespace nanojit
         }
     }
 
+    void Assembler::asm_immq_reloc(Register r, uint64_t v, bool call) {
+        // Make sure the immediate is the last 8 bytes of the instruction,
+        // right before the current position.
+        underrunProtect(8+8);
+        NIns* end = _nIns;
+        MOVQI(r, v);
+        _relocWriter->imm64(this, end - 8, v, call);
+    }
+
     void Assembler::asm_immd(Register r, uint64_t v, bool canClobberCCs, bool blind) {
         NanoAssert(IsFpReg(r));
         if (v == 0 && canClobberCCs) {
@@ -2593,10 +2629,11 @@ namespace nanojit
         case LIR_negd:    mask = (uintptr_t) negateMaskD;     break;
         }
 
-        if (isS32(mask)) {
+        // Relocatable code can't refer to the mask, it takes the GP path.
+        if (isS32(mask) && !_relocWriter) {
             // builtin code is in bottom or top 2GB addr space, use absolute addressing
             XORPSA(rr, (int32_t)mask);
-        } else if (isTargetWithinS32((NIns*)mask)) {
+        } else if (isTargetWithinS32((NIns*)mask) && !_relocWriter) {
             // jit code is within +/-2GB of builtin code, use rip-relative
             XORPSM(rr, (NIns*)mask);
         } else {
@@ -2693,6 +2730,9 @@ namespace nanojit
         }
 #endif
 
+        if (_stackMapWriter)
+            _stackMapWriter->endAssembly(this, amt, max_stk_used);
+
         // Reserve stackNeeded bytes, padded
         // to preserve NJ_ALIGN_STACK-byte alignment.
         if (amt) {
@@ -2911,6 +2951,8 @@ namespace nanojit
 
     void Assembler::asm_jtbl(NIns** table, Register indexreg)
     {
+        if (_relocWriter)
+            _relocWriter->absolute(this);
         if (isS32((intptr_t)table)) {
             // table is in low 2GB or high 2GB, can use absolute addressing
             // jmpq [indexreg*8 + table]
@@ -39,6 +39,8 @@ namespace nanojit
 #define NJ_USES_IMMF4_POOL              1   // Note: doesn't use IMMD pool!
 #define NJ_SAFEPOINT_POLLING_SUPPORTED  1
 #define NJ_BLIND_CONSTANTS				1
+#define NJ_STACKMAPS_SUPPORTED          1
+#define NJ_RELOCATION_SUPPORTED         1
 
 // exclude R12 because ESP and R12 cannot be used as an index
 // (index=100 in SIB means "none")
@@ -427,6 +429,7 @@ namespace nanojit
         bool isTargetWithinS32(NIns* target, int32_t maxInstSize=8);\
         void asm_immi(Register r, int32_t v, bool canClobberCCs, bool blind);  \
         void asm_immq(Register r, uint64_t v, bool canClobberCCs, bool blind);     \
+        void asm_immq_reloc(Register r, uint64_t v, bool call);\
         void asm_immd(Register r, uint64_t v, bool canClobberCCs, bool blind);     \
         void asm_regarg(ArgType, LIns*, Register);\
         void asm_stkarg(ArgType, LIns*, int);\
@@ -64,6 +64,7 @@ namespace nanojit
         harden_nop_insertion = false;
         harden_blind_constants = false;
         check_page_flags = false;
+        global_regalloc = false;
 
 #ifdef NANOJIT_STRESS_FORCE_LONG_BRANCH
         force_long_branch = true;
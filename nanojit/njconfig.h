@@ -80,6 +80,11 @@ namespace nanojit
         // If true, compiler will attempt to minimize the ability of an attacker to control literal constants appearing in the code
         uint32_t harden_blind_constants:1;
 
+        // If true, keep the values that are defined before a loop and used in it in
+        // registers across the loop's back edges, instead of reloading them after
+        // the loop header on every iteration.
+        uint32_t global_regalloc:1;
+
 		// Check protection flags when allocating memory for compiled code.
         uint32_t check_page_flags:1;
 
@@ -34,6 +34,19 @@ namespace avmshell
         , drc(true)
         , drcValidation(false)
         , markstackAllowance(0)
+        , markerThreads(0)
+        , backgroundSweep(false)
+        , generational(false)
+        , compaction(false)
+        , reapSlice(0)
+        , incrementalWeakRefs(false)
+        , exactStackFrames(false)
+        , allocationSampleInterval(0)
+        , allocationProfileFile(NULL)
+        , heapSnapshotFile(NULL)
+        , sizeClassStatsFile(NULL)
+        , gcTraceFile(NULL)
+        , gcSizeClasses(NULL)
         , fixedcheck(true)
         , gcthreshold(0)
         , langID(-1)
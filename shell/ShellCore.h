@@ -56,6 +56,19 @@ namespace avmshell
         bool drc;                       // copy to each GC
         bool drcValidation;             // copy to each GC
         int32_t markstackAllowance;     // copy to each GC;
+        uint32_t markerThreads;         // copy to each GC
+        bool backgroundSweep;           // copy to each GC
+        bool generational;              // copy to each GC
+        bool compaction;                // copy to each GC
+        uint32_t reapSlice;             // copy to each GC
+        bool incrementalWeakRefs;       // copy to each GC
+        bool exactStackFrames;          // copy to each GC
+        uint32_t allocationSampleInterval; // copy to the primordial GC
+        const char* allocationProfileFile; // NULL for the log
+        const char* heapSnapshotFile;   // NULL for none
+        const char* sizeClassStatsFile; // NULL for none
+        const char* gcTraceFile;        // NULL for none
+        const uint16_t* gcSizeClasses;  // copy to each GC; NULL for the built-in size classes
         bool fixedcheck;                // copy to each GC
         int gcthreshold;                // copy to each GC
         int langID;                     // copy to ShellCore?
@@ -83,11 +83,108 @@ namespace avmshell
         AvmCore::setStackLimit(minstack);
     }
 
+    // The size classes read from the file given to -gcsizeclasses.  The file is read
+    // by Shell::run before the heap is created, because GCHeap::Init sets up
+    // FixedMalloc; parseCommandLine only checks that it was read.
+    static uint16_t gcSizeClasses[MMgc::GC::kNumSizeClasses];
+    static uint16_t fixedMallocSizeClasses[MMgc::FixedMalloc::kNumSizeClasses];
+    static bool haveGCSizeClasses = false;
+    static bool haveFixedMallocSizeClasses = false;
+
+    // Parses the 'numClasses' sizes following the name on a line of a size-class file.
+    static bool parseSizeClasses(const char* line, uint16_t* sizeClasses, int numClasses, const int16_t* defaults)
+    {
+        for (int i=0; i < numClasses; i++) {
+            int size;
+            int nchar;
+            if (VMPI_sscanf(line, "%d%n", &size, &nchar) != 1 || size <= 0 || size > 0xFFFF)
+                return false;
+            sizeClasses[i] = uint16_t(size);
+            line += nchar;
+        }
+        while (*line == ' ' || *line == '\t' || *line == '\r' || *line == '\n')
+            line++;
+        return *line == 0 && MMgc::SizeClassHistogram::IsValid(sizeClasses, defaults, uint32_t(numClasses));
+    }
+
+    // Reads a file written by -gcsizestats: lines "gc" and "fixedmalloc" followed by
+    // the sizes of the classes, and '#' comments.  Either line may be left out.
+    //
+    // @return false if the file could not be read or holds anything else.
+    static bool readSizeClasses(const char* filename)
+    {
+        FILE* fp = fopen(filename, "r");
+        if (fp == NULL)
+            return false;
+        bool ok = true;
+        char line[1024];
+        while (ok && fgets(line, sizeof(line), fp) != NULL) {
+            if (line[0] == '#' || line[0] == '\n' || line[0] == '\r')
+                continue;
+            if (VMPI_strncmp(line, "gc ", 3) == 0) {
+                ok = parseSizeClasses(line + 3, gcSizeClasses, MMgc::GC::kNumSizeClasses, MMgc::GC::kSizeClasses);
+                haveGCSizeClasses = ok;
+            }
+            else if (VMPI_strncmp(line, "fixedmalloc ", 12) == 0) {
+                ok = parseSizeClasses(line + 12, fixedMallocSizeClasses, MMgc::FixedMalloc::kNumSizeClasses, MMgc::FixedMalloc::kSizeClasses);
+                haveFixedMallocSizeClasses = ok;
+            }
+            else
+                ok = false;
+        }
+        fclose(fp);
+        if (!ok)
+            haveGCSizeClasses = haveFixedMallocSizeClasses = false;
+        return ok;
+    }
+
+    // Logs the size-class statistics of 'gc' and FixedMalloc, and writes the size
+    // classes computed from them to 'filename' in the format read by readSizeClasses.
+    static bool writeSizeClasses(MMgc::GC* gc, const char* filename)
+    {
+        MMgc::FixedMalloc* fm = MMgc::FixedMalloc::GetFixedMalloc(0);
+        gc->DumpSizeClassStats();
+        fm->DumpSizeClassStats();
+
+        uint16_t gcTable[MMgc::GC::kNumSizeClasses];
+        uint16_t fmTable[MMgc::FixedMalloc::kNumSizeClasses];
+        bool haveGC = gc->ComputeSizeClasses(gcTable);
+        bool haveFM = fm->ComputeSizeClasses(fmTable);
+        if (!haveGC && !haveFM)
+            return false;
+        FILE* fp = fopen(filename, "w");
+        if (fp == NULL)
+            return false;
+        fprintf(fp, "# Size classes computed by avmshell -gcsizestats, for -gcsizeclasses\n");
+        if (haveGC) {
+            fprintf(fp, "gc");
+            for (int i=0; i < MMgc::GC::kNumSizeClasses; i++)
+                fprintf(fp, " %u", unsigned(gcTable[i]));
+            fprintf(fp, "\n");
+        }
+        if (haveFM) {
+            fprintf(fp, "fixedmalloc");
+            for (int i=0; i < MMgc::FixedMalloc::kNumSizeClasses; i++)
+                fprintf(fp, " %u", unsigned(fmTable[i]));
+            fprintf(fp, "\n");
+        }
+        return fclose(fp) == 0;
+    }
+
     /* static */
     int Shell::run(int argc, char *argv[])
     {
         MMgc::GCHeap::EnterLockInit();
         MMgc::GCHeapConfig conf;
+
+        // FixedMalloc is created by GCHeap::Init, so its options can't wait for
+        // parseCommandLine.
+        for (int i=1; i < argc && VMPI_strcmp(argv[i], "--") != 0; i++) {
+            if (!VMPI_strcmp(argv[i], "-gcsizestats"))
+                conf.fixedMallocStatistics = true;
+            else if (!VMPI_strcmp(argv[i], "-gcsizeclasses") && i+1 < argc && readSizeClasses(argv[i+1]) && haveFixedMallocSizeClasses)
+                conf.fixedMallocSizeClasses = fixedMallocSizeClasses;
+        }
         
 #if defined(AVMSYSTEM_IPHONE)
         //same as in iOS,CTAIRAppController
@@ -111,6 +208,9 @@ namespace avmshell
             avmplus::FixedHeapRef<Shell> instance(mmfx_new(Shell));
             instance->parseCommandLine(argc, argv);
 
+            if (instance->settings.gcTraceFile != NULL && !MMgc::GCHeap::GetGCHeap()->EnableTraceLog(MMgc::GCTraceLog::kDefaultCapacity))
+                avmplus::AvmLog("Could not create the GC trace log\n");
+
             if (instance->settings.do_log)
               initializeLogging(instance->settings.numfiles > 0 ? instance->settings.filenames[0] : "AVMLOG");
 
@@ -133,6 +233,10 @@ namespace avmshell
 			isolate->run();
 #endif
             instance->waitUntilNoIsolates();
+
+            MMgc::GCTraceLog* traceLog = MMgc::GCHeap::GetGCHeap()->GetTraceLog();
+            if (traceLog != NULL && !traceLog->Write(instance->settings.gcTraceFile))
+                avmplus::AvmLog("Could not write the GC trace to %s\n", instance->settings.gcTraceFile);
             // Shell is refcounted now
             //mmfx_delete(instance);
         }
@@ -184,6 +288,7 @@ namespace avmshell
 
         MMgc::GCConfig gcconfig;
         gcconfig.mode = settings.gcMode();
+        gcconfig.sizeClasses = settings.gcSizeClasses;
         MMgc::GC* gc = mmfx_new(MMgc::GC(MMgc::GCHeap::GetGCHeap(), gcconfig));
         ShellToplevel* toplevel = NULL;
         {
@@ -276,6 +381,16 @@ namespace avmshell
                 gcconfig.collectionThreshold = settings.gcthreshold;
             gcconfig.exactTracing = settings.exactgc;
             gcconfig.markstackAllowance = settings.markstackAllowance;
+            gcconfig.markerThreads = settings.markerThreads;
+            gcconfig.backgroundSweep = settings.backgroundSweep;
+            gcconfig.generational = settings.generational;
+            gcconfig.compaction = settings.compaction;
+            gcconfig.reapSlice = settings.reapSlice;
+            gcconfig.incrementalWeakRefs = settings.incrementalWeakRefs;
+            gcconfig.exactStackFrames = settings.exactStackFrames;
+            gcconfig.allocationSampleInterval = settings.allocationSampleInterval;
+            gcconfig.sizeClasses = settings.gcSizeClasses;
+            gcconfig.sizeClassStatistics = settings.sizeClassStatsFile != NULL;
             gcconfig.drc = settings.drc;
             gcconfig.mode = settings.gcMode();
             gcconfig.validateDRC = settings.drcValidation;
@@ -316,6 +431,12 @@ namespace avmshell
 
 #ifdef VMCFG_AOT
         int exitCode = shell->evaluateFile(settings, NULL);
+        if (!gc->DumpAllocationProfile(settings.allocationProfileFile))
+            avmplus::AvmLog("Could not write the allocation profile to %s\n", settings.allocationProfileFile);
+        if (settings.heapSnapshotFile != NULL && !gc->WriteHeapSnapshot(settings.heapSnapshotFile))
+            avmplus::AvmLog("Could not write the heap snapshot to %s\n", settings.heapSnapshotFile);
+        if (settings.sizeClassStatsFile != NULL && !writeSizeClasses(gc, settings.sizeClassStatsFile))
+            avmplus::AvmLog("Could not write the size classes to %s\n", settings.sizeClassStatsFile);
         aggregate->beforeCoreDeletion(this);
         delete shell;
         mmfx_delete( gc );
@@ -341,6 +462,15 @@ namespace avmshell
                 Shell::repl(shell);
 #endif
 		aggregate->requestAggregateExit();
+#if defined VMCFG_NANOJIT && defined AVMPLUS_VERBOSE
+        shell->dumpBindingCaches();
+#endif
+        if (!gc->DumpAllocationProfile(settings.allocationProfileFile))
+            avmplus::AvmLog("Could not write the allocation profile to %s\n", settings.allocationProfileFile);
+        if (settings.heapSnapshotFile != NULL && !gc->WriteHeapSnapshot(settings.heapSnapshotFile))
+            avmplus::AvmLog("Could not write the heap snapshot to %s\n", settings.heapSnapshotFile);
+        if (settings.sizeClassStatsFile != NULL && !writeSizeClasses(gc, settings.sizeClassStatsFile))
+            avmplus::AvmLog("Could not write the size classes to %s\n", settings.sizeClassStatsFile);
         aggregate->beforeCoreDeletion(this);
         delete shell;
         mmfx_delete( gc );
@@ -535,6 +665,14 @@ namespace avmshell
         gcconfig.collectionThreshold = settings.gcthreshold;
         gcconfig.exactTracing = settings.exactgc;
         gcconfig.markstackAllowance = settings.markstackAllowance;
+        gcconfig.markerThreads = settings.markerThreads;
+        gcconfig.backgroundSweep = settings.backgroundSweep;
+        gcconfig.generational = settings.generational;
+        gcconfig.compaction = settings.compaction;
+        gcconfig.reapSlice = settings.reapSlice;
+        gcconfig.incrementalWeakRefs = settings.incrementalWeakRefs;
+        gcconfig.exactStackFrames = settings.exactStackFrames;
+        gcconfig.sizeClasses = settings.gcSizeClasses;
         gcconfig.mode = settings.gcMode();
 
         // Going multi-threaded.
@@ -951,6 +1089,9 @@ namespace avmshell
                     else if (!VMPI_strcmp(arg+2, "forcelongbranch")) {
                         settings.njconfig.force_long_branch = true;
                     }
+                    else if (!VMPI_strcmp(arg+2, "globalregalloc")) {
+                        settings.njconfig.global_regalloc = true;
+                    }
                     else if (!VMPI_strcmp(arg+2, "checkjitpageflags")) {
                         settings.njconfig.check_page_flags = true;
                     }
@@ -960,9 +1101,24 @@ namespace avmshell
                     else if (!VMPI_strcmp(arg+2, "noinlinevector")) {
                         settings.jitconfig.opt_inline_vector_access = false;
                     }
+                    else if (!VMPI_strcmp(arg+2, "noinlinemethods")) {
+                        settings.jitconfig.opt_inline_methods = false;
+                    }
+                    else if (!VMPI_strcmp(arg+2, "novectorloops")) {
+                        settings.jitconfig.opt_vector_loops = false;
+                    }
+                    else if (!VMPI_strcmp(arg+2, "notypefeedback")) {
+                        settings.jitconfig.type_feedback = false;
+                    }
                     else if (!VMPI_strcmp(arg+2, "arrayfastpath")) {
                         settings.jitconfig.opt_array_read_fastpath = true;
                     }
+                    else if (!VMPI_strcmp(arg+2, "backgroundjit")) {
+                        settings.jitconfig.background_compile = true;
+                    }
+                    else if (!VMPI_strcmp(arg+2, "codecache") && i+1 < argc) {
+                        settings.jitconfig.code_cache = argv[++i];
+                    }
                     else if (!VMPI_strcmp(arg+2, "jitordie")) {
                         settings.runmode = avmplus::RM_jit_all;
                         settings.jitordie = true;
@@ -1081,6 +1237,81 @@ namespace avmshell
                     }
                 }
 #endif
+                else if (!VMPI_strcmp(arg, "-gcmarkthreads") && i+1 < argc ) {
+                    int threads;
+                    int nchar;
+                    const char* val = argv[++i];
+                    if (VMPI_sscanf(val, "%d%n", &threads, &nchar) == 1 && size_t(nchar) == VMPI_strlen(val) && threads >= 0) {
+                        settings.markerThreads = uint32_t(threads);
+                    }
+                    else
+                    {
+                        avmplus::AvmLog("Bad argument to -gcmarkthreads\n");
+                        usage();
+                    }
+                }
+                else if (!VMPI_strcmp(arg, "-gcbgsweep")) {
+                    settings.backgroundSweep = true;
+                }
+                else if (!VMPI_strcmp(arg, "-gcgenerational")) {
+                    settings.generational = true;
+                }
+                else if (!VMPI_strcmp(arg, "-gccompact")) {
+                    settings.compaction = true;
+                }
+                else if (!VMPI_strcmp(arg, "-gcincweakrefs")) {
+                    settings.incrementalWeakRefs = true;
+                }
+                else if (!VMPI_strcmp(arg, "-gcexactstack")) {
+                    settings.exactStackFrames = true;
+                }
+                else if (!VMPI_strcmp(arg, "-gcreapslice") && i+1 < argc ) {
+                    int micros;
+                    int nchar;
+                    const char* val = argv[++i];
+                    if (VMPI_sscanf(val, "%d%n", &micros, &nchar) == 1 && size_t(nchar) == VMPI_strlen(val) && micros >= 0) {
+                        settings.reapSlice = uint32_t(micros);
+                    }
+                    else
+                    {
+                        avmplus::AvmLog("Bad argument to -gcreapslice\n");
+                        usage();
+                    }
+                }
+                else if (!VMPI_strcmp(arg, "-gcprofile") && i+1 < argc ) {
+                    int interval;
+                    int nchar;
+                    const char* val = argv[++i];
+                    if (VMPI_sscanf(val, "%d%n", &interval, &nchar) == 1 && interval > 0 &&
+                        (val[nchar] == 0 || (val[nchar] == ',' && val[nchar+1] != 0))) {
+                        settings.allocationSampleInterval = uint32_t(interval);
+                        settings.allocationProfileFile = val[nchar] == ',' ? val + nchar + 1 : NULL;
+                    }
+                    else
+                    {
+                        avmplus::AvmLog("Bad argument to -gcprofile\n");
+                        usage();
+                    }
+                }
+                else if (!VMPI_strcmp(arg, "-gcsnapshot") && i+1 < argc ) {
+                    settings.heapSnapshotFile = argv[++i];
+                }
+                else if (!VMPI_strcmp(arg, "-gctrace") && i+1 < argc ) {
+                    settings.gcTraceFile = argv[++i];
+                }
+                else if (!VMPI_strcmp(arg, "-gcsizestats") && i+1 < argc ) {
+                    settings.sizeClassStatsFile = argv[++i];
+                }
+                else if (!VMPI_strcmp(arg, "-gcsizeclasses") && i+1 < argc ) {
+                    // Read by Shell::run.
+                    i++;
+                    if (!haveGCSizeClasses && !haveFixedMallocSizeClasses)
+                    {
+                        avmplus::AvmLog("Bad argument to -gcsizeclasses\n");
+                        usage();
+                    }
+                    settings.gcSizeClasses = haveGCSizeClasses ? gcSizeClasses : NULL;
+                }
                 else if (!VMPI_strcmp(arg, "-log")) {
                     settings.do_log = true;
                 }
@@ -1264,6 +1495,11 @@ namespace avmshell
         avmplus::AvmLog("          [-memlimit d] limit the heap size to d pages\n");
         avmplus::AvmLog("          [-eagersweep] sweep the heap synchronously at the end of GC;\n"
                "                        improves usage statistics.\n");
+        avmplus::AvmLog("          [-hugepages]  back the heap with huge pages where the OS supports them\n");
+        avmplus::AvmLog("          [-numabind]   place heap memory on the NUMA node of the thread that needs it\n");
+        avmplus::AvmLog("          [-asyncdecommit] return free heap memory to the OS on a background thread\n");
+        avmplus::AvmLog("          [-decommithysteresis n] only decommit memory that was free at the end of\n"
+               "                        n+1 collections in a row\n");
 #ifdef MMGC_POLICY_PROFILING
         avmplus::AvmLog("          [-gcbehavior] summarize GC behavior and policy, after every gc\n");
         avmplus::AvmLog("          [-gcsummary]  summarize GC behavior and policy, at end only\n");
@@ -1274,11 +1510,36 @@ namespace avmshell
                "                        will be ignored and can be omitted\n", int(MMgc::GCHeapConfig::kNumLoadFactors));
         avmplus::AvmLog("          [-loadCeiling X] GC load multiplier ceiling (default 1.0)\n");
         avmplus::AvmLog("          [-gcwork G]   Max fraction of time (default 0.25) we're willing to spend in GC\n");
+        avmplus::AvmLog("          [-gcpause P[,O]]\n"
+               "                        Adapt GC pacing to incremental slices of at most P ms and a\n"
+               "                        heap overhead of O times the live size (default 1.0); replaces -load\n");
         avmplus::AvmLog("          [-stack N]    Stack size in bytes (will be honored approximately).\n"
                "                        Be aware of the stack margin: %u\n", avmshell::kStackMargin);
 #ifdef MMGC_MARKSTACK_ALLOWANCE
         avmplus::AvmLog("          [-gcstack N]  Mark stack size allowance (# of segments), for testing.\n");
 #endif
+        avmplus::AvmLog("          [-gcmarkthreads N]\n"
+               "                        Use N helper threads to finish marking (default 0)\n");
+        avmplus::AvmLog("          [-gcbgsweep]  Sweep small-object blocks on a background thread\n");
+        avmplus::AvmLog("          [-gcgenerational]  Use minor collections of recently allocated objects\n");
+        avmplus::AvmLog("          [-gccompact]  Evacuate sparse blocks of movable objects after marking\n");
+        avmplus::AvmLog("          [-gcincweakrefs]  Visit weak references during incremental marking\n");
+        avmplus::AvmLog("          [-gcexactstack]  Scan jit frames on the stack with stack maps (x64 only)\n");
+        avmplus::AvmLog("          [-gcreapslice N]\n"
+               "                        Bound ZCT reaps to N microseconds each\n");
+        avmplus::AvmLog("          [-gcprofile N[,F]]\n"
+               "                        Sample one allocation per N bytes on average and write an\n"
+               "                        allocation profile to file F, or to the log, at exit\n");
+        avmplus::AvmLog("          [-gcsnapshot F]\n"
+               "                        Write a heap snapshot to file F at exit, see utils/heapsnapshot.py\n");
+        avmplus::AvmLog("          [-gctrace F]\n"
+               "                        Record the GC phases and heap growth, and write the last %u\n"
+               "                        as Chrome trace-event JSON to file F at exit\n", MMgc::GCTraceLog::kDefaultCapacity);
+        avmplus::AvmLog("          [-gcsizestats F]\n"
+               "                        Log statistics of the small-object size classes at exit and\n"
+               "                        write size classes fitted to the run to file F\n");
+        avmplus::AvmLog("          [-gcsizeclasses F]\n"
+               "                        Use the size classes in file F, as written by -gcsizestats\n");
         avmplus::AvmLog("          [-cache_bindings N]   size of bindings cache (0 = unlimited)\n");
         avmplus::AvmLog("          [-cache_metadata N]   size of metadata cache (0 = unlimited)\n");
         avmplus::AvmLog("          [-cache_methods  N]   size of method cache (0 = unlimited)\n");
@@ -1341,7 +1602,13 @@ namespace avmshell
         avmplus::AvmLog("          [-Dnocse]     disable CSE optimization\n");
         avmplus::AvmLog("          [-Dnoinline]  disable speculative inlining for arithmetic and conversions\n");
         avmplus::AvmLog("          [-Dnoinlinevector]  disable inlining of vector get/set\n");
+        avmplus::AvmLog("          [-Dnoinlinemethods]  disable inlining of small final methods, getters and setters\n");
+        avmplus::AvmLog("          [-Dnovectorloops]  disable hoisting of vector loads and range checks out of loops\n");
+        avmplus::AvmLog("          [-Dnotypefeedback]  with -osr, don't specialize the inline fastpaths for the operand types seen by the interpreter\n");
         avmplus::AvmLog("          [-Darrayfastpath]  enable speculative inlining of simple array reads\n");
+        avmplus::AvmLog("          [-Dbackgroundjit]  with -osr, assemble hot methods on a compiler thread and interpret them meanwhile\n");
+        avmplus::AvmLog("          [-Dcodecache dir]  save the jit code in the existing directory dir, and reuse it in the next runs (x86-64 only)\n");
+        avmplus::AvmLog("          [-Dglobalregalloc]  keep values that are used in loops in registers across the loop edges\n");
         avmplus::AvmLog("          [-Dforcelongbranch]  force full-range branches even if not required (x86-64 only)\n");
         avmplus::AvmLog("          [-jitharden]  enable jit hardening techniques\n");
         avmplus::AvmLog("          [-osr=T]      enable OSR with invocation threshold T; disable with -osr=0; default is -osr=%d\n",
@@ -0,0 +1,317 @@
+/* -*- Mode: C++; c-basic-offset: 4; indent-tabs-mode: nil; tab-width: 4 -*- */
+/* vi: set ts=4 sw=4 expandtab: (add to ~/.vimrc: set modeline modelines=5) */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+import com.adobe.test.Assert;
+
+// CodegenLIR hoists the loads of vectors held in locals out of loops, and drops
+// the range checks that a loop condition like 'i < v.length' implies.  The loops
+// below must behave the same with and without that (-Dnovectorloops), and in the
+// interpreter: accesses out of range still throw, and changes to a vector in the
+// loop are seen.  Running them under -osr enters the compiled loops from the
+// interpreter.
+
+function ints(n:int):Vector.<int>
+{
+    var v:Vector.<int> = new Vector.<int>();
+    for (var i:int = 0; i < n; i++)
+        v.push(i);
+    return v;
+}
+
+function errorOf(f:Function, ...args):String
+{
+    try {
+        f.apply(null, args);
+    } catch (e:Error) {
+        return Object(e).constructor + " " + e.errorID;
+    }
+    return "no error";
+}
+
+var RANGE:String = "[class RangeError] 1125";
+var FIXED:String = "[class RangeError] 1126";
+var NULLREF:String = "[class TypeError] 1009";
+
+// Checks that the loop condition implies.
+
+function sumInt(v:Vector.<int>):int
+{
+    var s:int = 0;
+    for (var i:int = 0; i < v.length; i++)
+        s += v[i];
+    return s;
+}
+
+function sumUint(v:Vector.<uint>):uint
+{
+    var s:uint = 0;
+    for (var i:int = 0; i < v.length; i++)
+        s += v[i];
+    return s;
+}
+
+function sumNumber(v:Vector.<Number>):Number
+{
+    var s:Number = 0;
+    var i:int = 0;
+    while (i < v.length) {
+        s += v[i];
+        i++;
+    }
+    return s;
+}
+
+function joinStrings(v:Vector.<String>):String
+{
+    var s:String = "";
+    for (var i:int = 0; i < v.length; i++)
+        s += v[i];
+    return s;
+}
+
+function fill(v:Vector.<int>, x:int):void
+{
+    for (var i:int = 0; i < v.length; i++)
+        v[i] = x + i;
+}
+
+function copy(from:Vector.<int>, to:Vector.<int>):void
+{
+    for (var i:int = 0; i < from.length; i++)
+        to[i] = from[i];
+}
+
+var u:Vector.<uint> = new Vector.<uint>();
+var d:Vector.<Number> = new Vector.<Number>();
+var strs:Vector.<String> = new Vector.<String>();
+for (var k:int = 0; k < 100; k++) {
+    u.push(k);
+    d.push(k + 0.5);
+    strs.push(String(k % 10));
+}
+
+Assert.expectEq("sum of Vector.<int>", 4950, sumInt(ints(100)));
+Assert.expectEq("sum of Vector.<uint>", 4950, sumUint(u));
+Assert.expectEq("sum of Vector.<Number>", 5000, sumNumber(d));
+Assert.expectEq("join of Vector.<String>", "0123456789", joinStrings(strs).substr(0, 10));
+Assert.expectEq("join length", 100, joinStrings(strs).length);
+Assert.expectEq("sum of an empty vector", 0, sumInt(new Vector.<int>()));
+
+var filled:Vector.<int> = ints(50);
+fill(filled, 1000);
+Assert.expectEq("fill", 1000 * 50 + 1225, sumInt(filled));
+
+var longer:Vector.<int> = ints(60);
+copy(ints(50), longer);
+Assert.expectEq("copy into a longer vector", 1770, sumInt(longer));
+
+// Checks that the loop condition does not imply.
+
+function sumToLength(v:Vector.<int>):int
+{
+    var s:int = 0;
+    for (var i:int = 0; i <= v.length; i++)
+        s += v[i];
+    return s;
+}
+
+function sumFromMinusOne(v:Vector.<int>):int
+{
+    var s:int = 0;
+    for (var i:int = -1; i < v.length; i++)
+        s += v[i];
+    return s;
+}
+
+function sumDown(v:Vector.<int>):int
+{
+    var s:int = 0;
+    for (var i:int = v.length; i >= 0; i--)
+        s += v[i];
+    return s;
+}
+
+function sumPairs(v:Vector.<int>):int
+{
+    var s:int = 0;
+    for (var i:int = 0; i < v.length; i += 2)
+        s += v[i] + v[i+1];
+    return s;
+}
+
+function spread(from:Vector.<int>, to:Vector.<int>):void
+{
+    for (var i:int = 0; i < from.length; i++)
+        to[2*i] = from[i];
+}
+
+Assert.expectEq("i <= v.length", RANGE, errorOf(sumToLength, ints(10)));
+Assert.expectEq("i <= v.length, empty vector", RANGE, errorOf(sumToLength, new Vector.<int>()));
+Assert.expectEq("i from -1", RANGE, errorOf(sumFromMinusOne, ints(10)));
+Assert.expectEq("i from v.length down", RANGE, errorOf(sumDown, ints(10)));
+Assert.expectEq("v[i+1], even length", 45, sumPairs(ints(10)));
+Assert.expectEq("v[i+1], odd length", RANGE, errorOf(sumPairs, ints(11)));
+Assert.expectEq("write past the end of another vector", RANGE, errorOf(spread, ints(10), new Vector.<int>(5)));
+
+// The loop body changes the length of the vector.
+
+function sumPopping(v:Vector.<int>):int
+{
+    var s:int = 0;
+    for (var i:int = 0; i < v.length; i++) {
+        s += v[i];
+        v.pop();
+    }
+    return s;
+}
+
+function sumShrinking(v:Vector.<int>):String
+{
+    var s:int = 0;
+    var n:int = v.length;
+    for (var i:int = 0; i < n; i++) {
+        s += v[i];
+        if (i == 4)
+            v.length = 5;
+    }
+    return String(s);
+}
+
+function appendAll(v:Vector.<int>, n:int):int
+{
+    for (var i:int = 0; i < n; i++)
+        v[i] = i * 2;
+    var s:int = 0;
+    for (i = 0; i < v.length; i++)
+        s += v[i];
+    return s;
+}
+
+function doubleUp(v:Vector.<int>):int
+{
+    var n:int = v.length;
+    for (var i:int = 0; i < v.length && i < 2 * n; i++) {
+        if (i < n)
+            v.push(v[i]);
+    }
+    return v.length;
+}
+
+function growByWriting(v:Vector.<int>):int
+{
+    var s:int = 0;
+    for (var i:int = 0; i < v.length; i++) {
+        if (i < 20)
+            v[v.length] = i;
+        s += v[i];
+    }
+    return s;
+}
+
+var popped:Vector.<int> = ints(10);
+Assert.expectEq("pop in the loop", 0 + 1 + 2 + 3 + 4, sumPopping(popped));
+Assert.expectEq("pop in the loop, length", 5, popped.length);
+Assert.expectEq("length set in the loop", RANGE, errorOf(sumShrinking, ints(10)));
+Assert.expectEq("appending writes", 2 * 4950, appendAll(new Vector.<int>(), 100));
+var doubled:Vector.<int> = ints(10);
+Assert.expectEq("push in the loop", 20, doubleUp(doubled));
+Assert.expectEq("push in the loop, contents", 2 * 45, sumInt(doubled));
+var grown:Vector.<int> = ints(5);
+Assert.expectEq("write at v.length in the loop", 10 + 190, growByWriting(grown));
+Assert.expectEq("write at v.length in the loop, length", 25, grown.length);
+
+// A null vector.
+
+function sumOrNull(v:Vector.<int>, n:int):int
+{
+    var s:int = 0;
+    for (var i:int = 0; i < n; i++) {
+        if (i < 3)
+            s += i;
+        else
+            s += v[i];
+    }
+    return s;
+}
+
+function nullLength(v:Vector.<int>):int
+{
+    var s:int = 0;
+    for (var i:int = 0; i < v.length; i++)
+        s += v[i];
+    return s;
+}
+
+var partial:int = 0;
+function sumOrNullPartial(v:Vector.<int>, n:int):void
+{
+    partial = 0;
+    for (var i:int = 0; i < n; i++) {
+        if (i >= 3)
+            partial += v[i];
+        else
+            partial += i;
+    }
+}
+
+Assert.expectEq("null vector, not accessed", 3, sumOrNull(null, 3));
+Assert.expectEq("null vector, accessed", NULLREF, errorOf(sumOrNull, null, 10));
+Assert.expectEq("null vector in the loop condition", NULLREF, errorOf(nullLength, null));
+Assert.expectEq("null vector, partial sum", NULLREF, errorOf(sumOrNullPartial, null, 10));
+Assert.expectEq("null vector, partial sum value", 3, partial);
+
+// Fixed vectors.
+
+function fixedInts(n:int):Vector.<int>
+{
+    var v:Vector.<int> = new Vector.<int>(n, true);
+    for (var i:int = 0; i < n; i++)
+        v[i] = i;
+    return v;
+}
+
+function fillPastEnd(v:Vector.<int>):void
+{
+    for (var i:int = 0; i <= v.length; i++)
+        v[i] = i;
+}
+
+function pushInLoop(v:Vector.<int>):void
+{
+    for (var i:int = 0; i < v.length; i++)
+        v.push(i);
+}
+
+var fixed:Vector.<int> = fixedInts(100);
+Assert.expectEq("sum of a fixed vector", 4950, sumInt(fixed));
+fill(fixed, 1);
+Assert.expectEq("fill a fixed vector", 5050, sumInt(fixed));
+Assert.expectEq("read past the end of a fixed vector", RANGE, errorOf(sumToLength, fixed));
+Assert.expectEq("write past the end of a fixed vector", RANGE, errorOf(fillPastEnd, fixedInts(10)));
+Assert.expectEq("push onto a fixed vector", FIXED, errorOf(pushInLoop, fixedInts(10)));
+
+// Long loops, entered through OSR under -osr.
+
+function sumLong(n:int):Number
+{
+    var v:Vector.<int> = ints(n);
+    var s:Number = 0;
+    for (var i:int = 0; i < v.length; i++)
+        s += v[i];
+    return s;
+}
+
+function sumLongOffByOne(n:int):Number
+{
+    var v:Vector.<int> = ints(n);
+    var s:Number = 0;
+    for (var i:int = 0; i <= v.length; i++)
+        s += v[i];
+    return s;
+}
+
+Assert.expectEq("long loop", 49995000, sumLong(10000));
+Assert.expectEq("long loop, i <= v.length", RANGE, errorOf(sumLongOffByOne, 10000));
@@ -0,0 +1,101 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+import com.adobe.test.Assert;
+
+// With -Dbackgroundjit a method that becomes hot goes on running in the
+// interpreter while a compiler thread assembles it, and its code is installed
+// on a later call or loop edge.  Each method below is called many times, so
+// that some calls are interpreted and the later ones run the installed code;
+// every call must return the same as in the interpreter.  Several methods are
+// pending at the same time, and hot loops are still compiled at once for OSR.
+
+class Point
+{
+    public var x:Number, y:Number;
+    public function Point(x:Number, y:Number) { this.x = x; this.y = y; }
+    public function dot(p:Point):Number { return x * p.x + y * p.y; }
+    public function toString():String { return "(" + x + "," + y + ")"; }
+}
+
+function mix(i:int):int { return (i * 31 ^ i >> 3) & 0xffff; }
+function half(d:Number):Number { return d / 2 + 0.25; }
+function label(i:int):String { return "n" + (i % 10); }
+function dots(i:int):Number { return new Point(i, 1).dot(new Point(2, i)); }
+function fib(n:int):int { return n < 2 ? n : fib(n - 1) + fib(n - 2); }
+function untyped(a, b) { return a + b; }
+
+function guarded(i:int):int
+{
+    try {
+        if (i % 7 == 0)
+            throw new Error("seven");
+        return i;
+    } catch (e:Error) {
+        return -1;
+    }
+    return 0;
+}
+
+function sumTo(n:int):int
+{
+    var s:int = 0;
+    for (var i:int = 0; i < n; i++)
+        s += i % 13;
+    return s;
+}
+
+// Calls f(i) for i in [0, n) and returns "ok", or the first call whose result
+// differs from expect(i).
+function check(f:Function, expect:Function, n:int):String
+{
+    for (var i:int = 0; i < n; i++) {
+        var r:* = f(i);
+        if (r !== expect(i))
+            return "call " + i + " returned " + r + ", expected " + expect(i);
+    }
+    return "ok";
+}
+
+Assert.expectEq("int method", "ok",
+                check(mix, function(i:int):int { return (i * 31 ^ i >> 3) & 0xffff; }, 5000));
+Assert.expectEq("double method", "ok",
+                check(half, function(i:int):Number { return i / 2 + 0.25; }, 5000));
+Assert.expectEq("string method", "ok",
+                check(label, function(i:int):String { return "n" + (i % 10); }, 5000));
+Assert.expectEq("object method", "ok",
+                check(dots, function(i:int):Number { return 3 * i; }, 5000));
+Assert.expectEq("throwing method", "ok",
+                check(guarded, function(i:int):int { return i % 7 == 0 ? -1 : i; }, 5000));
+Assert.expectEq("untyped method", "ok",
+                check(function(i:int):* { return untyped(i, 0.5); },
+                      function(i:int):* { return i + 0.5; }, 5000));
+Assert.expectEq("untyped method on strings", "ok",
+                check(function(i:int):* { return untyped("s", i); },
+                      function(i:int):* { return "s" + i; }, 5000));
+
+// Recursion: the calls in progress go on in the interpreter when the code of
+// the method is installed.
+Assert.expectEq("recursive method", 6765, fib(20));
+Assert.expectEq("recursive method again", 75025, fib(25));
+
+// Methods that are hot at the same time, called in turns.
+var mixed:Number = 0;
+for (var i:int = 0; i < 20000; i++)
+    mixed += mix(i) + half(i) + guarded(i) + dots(i) + label(i).length;
+Assert.expectEq("methods called in turns", 1509757275, mixed);
+
+// A loop that is hot before its method: the loop is entered through OSR.
+Assert.expectEq("hot loop", 59985, sumTo(10000));
+var sums:int = 0;
+for (i = 0; i < 2000; i++)
+    sums += sumTo(i % 50);
+Assert.expectEq("hot loop, then hot method", 265560, sums);
+
+var p:Point = new Point(1.5, -2);
+var q:Point = new Point(0.5, 4);
+var acc:Number = 0;
+for (i = 0; i < 10000; i++)
+    acc += p.dot(q);
+Assert.expectEq("hot method called from a hot loop", -72500, acc);
+Assert.expectEq("toString", "(1.5,-2)", String(p));
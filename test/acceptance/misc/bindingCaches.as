@@ -0,0 +1,148 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+import avmplus.Domain;
+import avmplus.System;
+import flash.utils.ByteArray;
+import com.adobe.test.Assert;
+
+// The late bound call, get and set sites of compiled code cache their bindings.
+// A site bound to one type goes polymorphic when it sees a second one, and
+// megamorphic when it has seen more types than its polymorphic entries hold;
+// each site below goes through all three states and must keep calling the
+// right method, reading and writing the right property.  The caches are then
+// flushed, which happens when an ABC is unloaded, and prototypes are changed.
+
+class A { public var v:int = 1; public function f():String { return "A"; } }
+class B { public var v:int = 2; public function f():String { return "B"; } }
+class C { public var v:int = 3; public function f():String { return "C"; } }
+class D { public var v:int = 4; public function f():String { return "D"; } }
+class E { public var v:int = 5; public function f():String { return "E"; } }
+class F { public var v:int = 6; public function f():String { return "F"; } }
+class G { public var v:int = 7; public function f():String { return "G"; } }
+class H { public var v:int = 8; public function f():String { return "H"; } }
+
+// 'v' is a const, a method closure or a dynamic property, and 'f' a function
+// held in a variable or a dynamic property, in these.
+class K { public const v:int = 9; public var f:Function = function():String { return "K"; }; }
+class M { public function v():int { return 10; } public function f():String { return "M"; } }
+
+function callF(o:*):String { return o.f(); }
+function getV(o:*):* { return o.v; }
+function setV(o:*, x:*):void { o.v = x; }
+
+function callAll(objs:Array):String
+{
+    var s:String = "";
+    for (var i:int = 0; i < objs.length; i++)
+        s += callF(objs[i]);
+    return s;
+}
+
+function getAll(objs:Array):String
+{
+    var s:Array = [];
+    for (var i:int = 0; i < objs.length; i++)
+        s.push(String(getV(objs[i])).substr(0, 8));
+    return s.join(",");
+}
+
+var a:A = new A(), b:B = new B(), c:C = new C(), d:D = new D();
+var e:E = new E(), f:F = new F(), g:G = new G(), h:H = new H();
+var k:K = new K(), m:M = new M();
+var dyn:Object = { v: 11, f: function():String { return "dyn"; } };
+
+// Monomorphic.
+Assert.expectEq("call, one type", "AAA", callAll([a, a, a]));
+Assert.expectEq("get, one type", "1,1,1", getAll([a, a, a]));
+
+// Polymorphic, up to and past the entries of a site.
+Assert.expectEq("call, two types", "ABAB", callAll([a, b, a, b]));
+Assert.expectEq("get, two types", "1,2,1,2", getAll([a, b, a, b]));
+Assert.expectEq("call, four types", "ABCDDCBA", callAll([a, b, c, d, d, c, b, a]));
+Assert.expectEq("get, four types", "1,2,3,4,4,3,2,1", getAll([a, b, c, d, d, c, b, a]));
+
+// Megamorphic.
+var all:Array = [a, b, c, d, e, f, g, h, k, m, dyn];
+Assert.expectEq("call, many types", "ABCDEFGHKMdyn", callAll(all));
+Assert.expectEq("call, many types again", "dynMKHGFEDCBA", callAll(all.concat().reverse()));
+Assert.expectEq("get, many types", "1,2,3,4,5,6,7,8,9,function,11", getAll(all));
+Assert.expectEq("get, many types again", "11,function,9,8,7,6,5,4,3,2,1", getAll(all.concat().reverse()));
+Assert.expectEq("call, back to one type", "AAA", callAll([a, a, a]));
+
+// Primitives are cached by their tag.
+function str(o:*):String { return o.toString(); }
+Assert.expectEq("call on primitives", "1,x,true,2.5,A",
+                [str(1), str("x"), str(true), str(2.5), str(a).substr(8, 1)].join(","));
+function len(o:*):* { return o.length; }
+Assert.expectEq("get on primitives", "3,2,0,3", [len("abc"), len([1, 2]), len(a.f), len("xyz")].join(","));
+
+// Sets through one site, on slots of every class, a dynamic property, and a
+// const that can't be set.
+function setAll(objs:Array, x:int):String
+{
+    for (var i:int = 0; i < objs.length; i++)
+        setV(objs[i], x + i);
+    return getAll(objs);
+}
+
+var slots:Array = [a, b, c, d, e, f, g, h, dyn];
+Assert.expectEq("set, many types", "100,101,102,103,104,105,106,107,108", setAll(slots, 100));
+Assert.expectEq("set, many types again", "200,201,202,203,204,205,206,207,208", setAll(slots, 200));
+var constError:String = "no error";
+try { setV(k, 1); } catch (err:ReferenceError) { constError = "ReferenceError " + err.errorID; }
+Assert.expectEq("set a const", "ReferenceError 1074", constError);
+Assert.expectEq("set, after the const", "300,301", setAll([a, b], 300));
+
+// Flush the binding caches: they are flushed when the AbcEnv of an ABC that has
+// been loaded is collected.  The ABC is a script that returns.
+var script:Array = [0x10, 0, 0x2E, 0,           // version
+                    0, 0, 0, 0, 0, 0, 0,         // no constants
+                    1, 0, 0, 0, 0,               // method 0
+                    0, 0,                        // no metadata, no classes
+                    1, 0, 0,                     // script 0, init method 0
+                    1, 0, 1, 1, 0, 1,            // the body of method 0
+                    1, 0x47,                     // returnvoid
+                    0, 0];
+
+function loadAndDrop():void
+{
+    var bytes = new ByteArray();
+    for (var i:int = 0; i < script.length; i++)
+        bytes.writeByte(script[i]);
+    new Domain(Domain.currentDomain).loadBytes(bytes);
+}
+
+for (var n:int = 0; n < 3; n++) {
+    loadAndDrop();
+    System.forceFullCollection();
+}
+
+Assert.expectEq("call after a flush", "ABCDEFGHKMdyn", callAll(all));
+Assert.expectEq("call after a flush, one type", "AAA", callAll([a, a, a]));
+Assert.expectEq("get after a flush", "300,301,202,203,204,205,206,207,9,function,208", getAll(all));
+Assert.expectEq("set after a flush", "400,401,402", setAll([a, b, dyn], 400));
+
+// Dynamic properties found on prototypes are not cached: changes to the
+// prototypes are seen at once.
+function callG(o:*):String { return o.g(); }
+function callGAll(objs:Array):String
+{
+    var s:String = "";
+    for (var i:int = 0; i < objs.length; i++)
+        s += callG(objs[i]);
+    return s;
+}
+
+A.prototype.g = function():String { return "a"; };
+Object.prototype.g = function():String { return "o"; };
+Assert.expectEq("call a prototype function", "aooo", callGAll([a, b, dyn, m]));
+A.prototype.g = function():String { return "a2"; };
+Assert.expectEq("call a changed prototype function", "a2ooo", callGAll([a, b, dyn, m]));
+delete A.prototype.g;
+Object.prototype.g = function():String { return "p"; };
+Assert.expectEq("call a deleted prototype function", "pppp", callGAll([a, b, dyn, m]));
+dyn.g = function():String { return "own"; };
+Assert.expectEq("call an own property over a prototype", "ppownp", callGAll([a, b, dyn, m]));
+delete Object.prototype.g;
+delete dyn.g;
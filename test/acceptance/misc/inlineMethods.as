@@ -0,0 +1,145 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+import com.adobe.test.Assert;
+
+// CodegenLIR::inlineSmallMethod replaces early bound calls to small final
+// methods by their bodies.  Each call below is made once through a typed
+// receiver, where it can be inlined, and once late bound through '*', where
+// it can't, and the results must agree.
+
+final class Point
+{
+    private var _x:int;
+    public var name:String = "p";
+
+    public function Point(x:int) { _x = x; }
+
+    public function get x():int { return _x; }
+    public function set x(v:int):void { _x = v; }
+
+    public function getName():String { return name; }
+    public function setName(s:String):void { name = s; }
+    public function same(s:String):String { return s; }
+    public function yes():Boolean { return true; }
+    public function no():Boolean { return false; }
+    public function seven():int { return 7; }
+    public function nothing():void { }
+
+    // Too large to inline; the call must still throw.
+    public function fail():int { throw new RangeError("fail"); }
+}
+
+class Shape
+{
+    public function sides():int { return 0; }
+    public final function kind():String { return "shape"; }
+}
+
+class Triangle extends Shape
+{
+    override public function sides():int { return 3; }
+}
+
+class Square extends Shape
+{
+    override public function sides():int { return 4; }
+}
+
+function typedCalls(p:Point):Array
+{
+    var r:Array = [];
+    r.push(p.x);
+    p.x = p.x + 1;
+    r.push(p.x);
+    r.push(p.getName());
+    p.setName("q");
+    r.push(p.name);
+    r.push(p.same("s"));
+    r.push(p.yes());
+    r.push(p.no());
+    r.push(p.seven());
+    r.push(p.nothing());
+    return r;
+}
+
+function lateBoundCalls(p:*):Array
+{
+    var r:Array = [];
+    r.push(p.x);
+    p.x = p.x + 1;
+    r.push(p.x);
+    r.push(p.getName());
+    p.setName("q");
+    r.push(p.name);
+    r.push(p.same("s"));
+    r.push(p.yes());
+    r.push(p.no());
+    r.push(p.seven());
+    r.push(p.nothing());
+    return r;
+}
+
+Assert.expectEq("inlined and late bound calls agree",
+                String(lateBoundCalls(new Point(41))),
+                String(typedCalls(new Point(41))));
+Assert.expectEq("inlined calls", "41,42,p,q,s,true,false,7,", String(typedCalls(new Point(41))));
+
+// The receiver is checked for null before the inlined body is reached.
+
+function typedGetter(p:Point):int { return p.x; }
+function typedSetter(p:Point):void { p.x = 1; }
+function typedMethod(p:Point):Boolean { return p.yes(); }
+
+function errorOf(f:Function, arg:*):String
+{
+    try {
+        f(arg);
+    } catch (e:Error) {
+        return Object(e).constructor + " " + e.errorID;
+    }
+    return "no error";
+}
+
+Assert.expectEq("getter on null", errorOf(function(p:*) { return p.x; }, null), errorOf(typedGetter, null));
+Assert.expectEq("setter on null", errorOf(function(p:*) { p.x = 1; }, null), errorOf(typedSetter, null));
+Assert.expectEq("method on null", errorOf(function(p:*) { return p.yes(); }, null), errorOf(typedMethod, null));
+Assert.expectEq("getter on null throws", "[class TypeError] 1009", errorOf(typedGetter, null));
+
+// A callee that throws.
+
+function typedFail(p:Point):int { return p.fail() + 1; }
+
+var caught:String = "no error";
+try {
+    typedFail(new Point(0));
+} catch (e:RangeError) {
+    caught = e.message;
+}
+Assert.expectEq("callee throws", "fail", caught);
+
+// Calls that are not monomorphic are not inlined and must reach each override.
+
+function sumSides(shapes:Array):int
+{
+    var n:int = 0;
+    for (var i:int = 0; i < shapes.length; i++) {
+        var s:Shape = shapes[i];
+        n += s.sides();
+    }
+    return n;
+}
+
+function kinds(shapes:Array):String
+{
+    var k:String = "";
+    for (var i:int = 0; i < shapes.length; i++) {
+        var s:Shape = shapes[i];
+        k += s.kind();
+    }
+    return k;
+}
+
+var shapes:Array = [new Triangle(), new Square(), new Shape(), new Square()];
+Assert.expectEq("polymorphic calls", 11, sumSides(shapes));
+Assert.expectEq("final method of a non-final class", "shapeshapeshapeshape", kinds(shapes));
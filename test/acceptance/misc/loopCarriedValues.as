@@ -0,0 +1,116 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+import com.adobe.test.Assert;
+
+// With -Dglobalregalloc the assembler keeps the values that are defined before a
+// loop and used in it in registers across the loop's back edges.  The loops below
+// carry ints, doubles and objects, nest, call, throw, and are entered through OSR
+// under -osr, and must compute the same as without the option.
+
+function sor(n:int, omega:Number, iterations:int):Number
+{
+    var g:Array = [];
+    for (var i:int = 0; i < n; i++) {
+        var row:Array = [];
+        for (var j:int = 0; j < n; j++)
+            row.push((i * 7 + j * 3) % 11 / 10);
+        g.push(row);
+    }
+    var a:Number = omega * 0.25;
+    var b:Number = 1.0 - omega;
+    for (var p:int = 0; p < iterations; p++) {
+        for (i = 1; i < n - 1; i++) {
+            var prev:Array = g[i - 1];
+            var cur:Array = g[i];
+            var next:Array = g[i + 1];
+            for (j = 1; j < n - 1; j++)
+                cur[j] = a * (prev[j] + next[j] + cur[j - 1] + cur[j + 1]) + b * cur[j];
+        }
+    }
+    var s:Number = 0;
+    for (i = 0; i < n; i++)
+        for (j = 0; j < n; j++)
+            s += g[i][j];
+    return Math.round(s * 1000000) / 1000000;
+}
+
+function manyCarried(n:int):int
+{
+    var a:int = n + 1, b:int = n * 2, c:int = n - 3, d:int = n * n;
+    var e:int = a ^ b, f:int = c | 5, g:int = d >> 2, h:int = a + b + c;
+    var s:int = 0;
+    for (var i:int = 0; i < n; i++) {
+        for (var j:int = 0; j < n; j++)
+            s += (a + i) * b - c + (d ^ j) - e + f * g - h;
+        s ^= i;
+    }
+    return s;
+}
+
+function carriedDoubles(n:int):Number
+{
+    var x:Number = 1.5, y:Number = 0.25, z:Number = -2.75;
+    var s:Number = 0;
+    for (var i:int = 0; i < n; i++)
+        s += x * i + y - z / (i + 1);
+    return Math.round(s * 1000) / 1000;
+}
+
+function twice(v:int):int { return v * 2; }
+
+function callInLoop(n:int):int
+{
+    var k:int = n * 3;
+    var m:int = n + 7;
+    var s:int = 0;
+    for (var i:int = 0; i < n; i++)
+        s += twice(i + k) - m;
+    return s;
+}
+
+function throwInLoop(n:int):String
+{
+    var base:int = n * 10;
+    var caught:int = 0;
+    var s:int = 0;
+    for (var i:int = 0; i < n; i++) {
+        try {
+            if (i % 3 == 0)
+                throw new Error("e" + i);
+            s += base + i;
+        } catch (e:Error) {
+            caught++;
+            s -= base;
+        }
+    }
+    return s + "/" + caught;
+}
+
+function objectsInLoop(n:int):String
+{
+    var o:Object = { x: 3 };
+    var prefix:String = "v";
+    var parts:Array = [];
+    for (var i:int = 0; i < n; i++)
+        parts.push(prefix + (o.x + i));
+    return parts.join("");
+}
+
+function longLoop(n:int):Number
+{
+    var a:int = 3, b:int = 5;
+    var d:Number = 0.5;
+    var s:Number = 0;
+    for (var i:int = 0; i < n; i++)
+        s += (i % a) * b + d;
+    return s;
+}
+
+Assert.expectEq("successive over-relaxation", 201.846142, sor(20, 1.25, 10));
+Assert.expectEq("many carried ints", 33509392, manyCarried(40));
+Assert.expectEq("carried doubles", 7464.265, carriedDoubles(100));
+Assert.expectEq("call in the loop", 14600, callInLoop(50));
+Assert.expectEq("throw in the loop", "8817/17", throwInLoop(50));
+Assert.expectEq("objects in the loop", "v3v4v5v6v7", objectsInLoop(5));
+Assert.expectEq("long loop", 54995, longLoop(10000));
@@ -0,0 +1,178 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+import com.adobe.test.Assert;
+
+// Under -osr the interpreter records the kinds of the operands of untyped adds
+// and compares, and CodegenLIR specializes their fastpaths for the kinds it saw
+// when the loop is compiled.  Each function below runs its loop long enough to be
+// compiled after seeing one kind of operand, and is then called with others, which
+// fail the guards of the fastpaths and must fall back to the generic code.  The
+// results must be the same with -Dnotypefeedback and in the interpreter.
+
+var N:int = 50;
+
+function addLoop(a, b, n)
+{
+    var r;
+    for (var i = 0; i < n; i++)
+        r = a + b;
+    return r;
+}
+
+function sumLoop(a, step, n)
+{
+    var s = a;
+    for (var i = 0; i < n; i++)
+        s = s + step;
+    return s;
+}
+
+function lessLoop(a, b, n)
+{
+    var c = 0;
+    for (var i = 0; i < n; i++)
+        if (a < b)
+            c++;
+    return c;
+}
+
+function lessEqualLoop(a, b, n)
+{
+    var c = 0;
+    for (var i = 0; i < n; i++)
+        if (a <= b)
+            c++;
+    return c;
+}
+
+function equalsLoop(a, b, n)
+{
+    var c = 0;
+    for (var i = 0; i < n; i++)
+        if (a == b)
+            c++;
+    return c;
+}
+
+function strictEqualsLoop(a, b, n)
+{
+    var c = 0;
+    for (var i = 0; i < n; i++)
+        if (a === b)
+            c++;
+    return c;
+}
+
+function compareValues(a, b, n)
+{
+    var r;
+    for (var i = 0; i < n; i++)
+        r = [a < b, a <= b, a > b, a >= b, a == b, a != b, a === b, a !== b].join();
+    return r;
+}
+
+// Adds, profiled with ints.
+
+Assert.expectEq("int + int, warm up", 5, addLoop(2, 3, N));
+Assert.expectEq("int + int", 7, addLoop(3, 4, N));
+Assert.expectEq("int + int overflows", 4294967296, addLoop(2147483647, 2147483649, N));
+Assert.expectEq("int + int, negative", -1, addLoop(-2147483648, 2147483647, N));
+Assert.expectEq("int + double", 3.5, addLoop(1, 2.5, N));
+Assert.expectEq("double + int", 3.5, addLoop(2.5, 1, N));
+Assert.expectEq("int + String", "12", addLoop(1, "2", N));
+Assert.expectEq("String + int", "12", addLoop("1", 2, N));
+Assert.expectEq("int + undefined", "NaN", String(addLoop(1, undefined, N)));
+Assert.expectEq("int + null", 1, addLoop(1, null, N));
+Assert.expectEq("int + Boolean", 2, addLoop(1, true, N));
+Assert.expectEq("String + String", "ab", addLoop("a", "b", N));
+Assert.expectEq("Array + int", "1,21", addLoop([1, 2], 1, N));
+
+// Adds, profiled with doubles.
+
+Assert.expectEq("double + double, warm up", 0.75, sumLoop(0, 0.015, N));
+Assert.expectEq("double + double", 4, sumLoop(1.5, 0.05, N));
+Assert.expectEq("double + int", 51.5, sumLoop(1.5, 1, N));
+Assert.expectEq("double + NaN", "NaN", String(sumLoop(0.5, NaN, N)));
+Assert.expectEq("double + Infinity", Infinity, sumLoop(0.5, Infinity, N));
+Assert.expectEq("double + String", "0.5x", sumLoop(0.5, "x", 1));
+Assert.expectEq("double + undefined", "NaN", String(sumLoop(0.5, undefined, N)));
+
+// Adds, profiled with Strings.
+
+Assert.expectEq("String + String, warm up", 50, sumLoop("", "a", N).length);
+Assert.expectEq("String + String", "abbb", sumLoop("a", "b", 3));
+Assert.expectEq("String + int", "a111", sumLoop("a", 1, 3));
+Assert.expectEq("int + String", "1aaa", sumLoop(1, "a", 3));
+Assert.expectEq("String + undefined", "aundefined", sumLoop("a", undefined, 1));
+Assert.expectEq("String + null", "anull", sumLoop("a", null, 1));
+Assert.expectEq("int + int after Strings", 51, sumLoop(1, 1, N));
+
+// A sum that starts as int, overflows to double and ends up as a String.
+
+function mixedSum(n)
+{
+    var s = 2147483600;
+    for (var i = 0; i < n; i++) {
+        s = s + 1;
+        if (i == n - 2)
+            s = s + "!";
+    }
+    return s;
+}
+
+Assert.expectEq("int overflowing to double, then String", "2147483649!1", mixedSum(N));
+
+// Compares, profiled with ints.
+
+Assert.expectEq("int < int, warm up", N, lessLoop(1, 2, N));
+Assert.expectEq("int < int", 0, lessLoop(2, 1, N));
+Assert.expectEq("int < double", N, lessLoop(1, 1.5, N));
+Assert.expectEq("double < int", 0, lessLoop(1.5, 1, N));
+Assert.expectEq("int < NaN", 0, lessLoop(1, NaN, N));
+Assert.expectEq("NaN < int", 0, lessLoop(NaN, 1, N));
+Assert.expectEq("int < String", N, lessLoop(9, "10", N));
+Assert.expectEq("String < String", N, lessLoop("10", "9", N));
+Assert.expectEq("int < undefined", 0, lessLoop(1, undefined, N));
+Assert.expectEq("undefined < int", 0, lessLoop(undefined, 1, N));
+Assert.expectEq("null < int", N, lessLoop(null, 1, N));
+
+Assert.expectEq("int <= int, warm up", N, lessEqualLoop(2, 2, N));
+Assert.expectEq("int <= int", 0, lessEqualLoop(3, 2, N));
+Assert.expectEq("double <= double", N, lessEqualLoop(-0, 0, N));
+Assert.expectEq("NaN <= NaN", 0, lessEqualLoop(NaN, NaN, N));
+Assert.expectEq("String <= int", N, lessEqualLoop("2", 2, N));
+Assert.expectEq("undefined <= undefined", 0, lessEqualLoop(undefined, undefined, N));
+Assert.expectEq("null <= undefined", 0, lessEqualLoop(null, undefined, N));
+
+// Compares, profiled with doubles.
+
+Assert.expectEq("double == double, warm up", N, equalsLoop(0.5, 0.5, N));
+Assert.expectEq("double == double", 0, equalsLoop(0.5, 0.25, N));
+Assert.expectEq("-0 == 0", N, equalsLoop(-0, 0, N));
+Assert.expectEq("NaN == NaN", 0, equalsLoop(NaN, NaN, N));
+Assert.expectEq("double == String", N, equalsLoop(1.5, "1.5", N));
+Assert.expectEq("int == Boolean", N, equalsLoop(1, true, N));
+Assert.expectEq("undefined == null", N, equalsLoop(undefined, null, N));
+Assert.expectEq("undefined == 0", 0, equalsLoop(undefined, 0, N));
+Assert.expectEq("Object == Object", 0, equalsLoop({}, {}, N));
+
+Assert.expectEq("double === double, warm up", N, strictEqualsLoop(0.5, 0.5, N));
+Assert.expectEq("-0 === 0", N, strictEqualsLoop(-0, 0, N));
+Assert.expectEq("NaN === NaN", 0, strictEqualsLoop(NaN, NaN, N));
+Assert.expectEq("int === double", N, strictEqualsLoop(2, 2.0, N));
+Assert.expectEq("double === String", 0, strictEqualsLoop(1.5, "1.5", N));
+Assert.expectEq("String === String", N, strictEqualsLoop("ab", "a" + "b", N));
+Assert.expectEq("undefined === null", 0, strictEqualsLoop(undefined, null, N));
+Assert.expectEq("undefined === undefined", N, strictEqualsLoop(undefined, undefined, N));
+
+// All compares on the same operands, profiled with ints, then with others.
+
+Assert.expectEq("compare 1, 2", "true,true,false,false,false,true,false,true", compareValues(1, 2, N));
+Assert.expectEq("compare 2, 2", "false,true,false,true,true,false,true,false", compareValues(2, 2, N));
+Assert.expectEq("compare 2.5, 2", "false,false,true,true,false,true,false,true", compareValues(2.5, 2, N));
+Assert.expectEq("compare NaN, 2", "false,false,false,false,false,true,false,true", compareValues(NaN, 2, N));
+Assert.expectEq("compare '2', 2", "false,true,false,true,true,false,false,true", compareValues("2", 2, N));
+Assert.expectEq("compare 'b', 'a'", "false,false,true,true,false,true,false,true", compareValues("b", "a", N));
+Assert.expectEq("compare undefined, null", "false,false,false,false,true,false,false,true", compareValues(undefined, null, N));
+Assert.expectEq("compare 0, -0", "false,true,false,true,true,false,true,false", compareValues(0, -0, N));
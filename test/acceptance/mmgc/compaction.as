@@ -0,0 +1,45 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+import com.adobe.test.Assert;
+import avmplus.System;
+
+// With -gccompact the GC moves the buffers of arrays out of sparsely occupied
+// blocks.  Most of the arrays built here die, leaving the survivors' buffers
+// scattered over many blocks; the survivors must be intact after they move.
+
+function Box(v) { this.v = v; }
+
+function build(keep, round) {
+    var junk = [];
+    for (var i = 0; i < 20000; i++) {
+        var a = [new Box(i), i, "s" + i];
+        if (i % 37 == round)
+            keep.push(a);
+        else
+            junk.push(a);
+    }
+}
+
+function check(keep) {
+    for (var k = 0; k < keep.length; k++) {
+        var a = keep[k];
+        var n = a[1];
+        if (a.length != 3 || a[0].v != n || a[2] != "s" + n)
+            return "bad array " + k;
+    }
+    return "ok";
+}
+
+var keep = [];
+for (var round = 0; round < 6; round++) {
+    build(keep, round);
+    System.forceFullCollection();
+}
+Assert.expectEq("arrays after compacting collections", "ok", check(keep));
+Assert.expectEq("number of arrays kept", 3246, keep.length);
+
+keep.push([new Box(-1)]);
+System.forceFullCollection();
+Assert.expectEq("arrays after another collection", "ok", check(keep.slice(0, 3246)));
+Assert.expectEq("array added after compaction", -1, keep[3246][0].v);
@@ -24,6 +24,8 @@ class RunTests (RunTestLib):
         r.compile("testdata/memstats.as",None)
         # for testLanguage.py
         r.compile("testdata/rt_error.as",None)
+        # for testCodeCache.py
+        r.compile("testdata/codecache.as",None)
 
     def runAll(self):
         list=os.listdir(".")
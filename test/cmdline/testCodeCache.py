@@ -0,0 +1,93 @@
+#!/usr/bin/env python
+
+#  This Source Code Form is subject to the terms of the Mozilla Public
+#  License, v. 2.0. If a copy of the MPL was not distributed with this
+#  file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+# -Dcodecache: a run that loads the code saved by an earlier run must print the
+# same as the run that compiled it, and a cache file that is truncated, corrupt,
+# or saved with other options must be ignored, then rewritten by the next run.
+
+import os,re,shutil,tempfile
+from cmdutils import *
+
+def cachefiles(dir):
+    return sorted([os.path.join(dir,f) for f in os.listdir(dir) if f.endswith('.jit')])
+
+def cached(r,dir,args=''):
+    "count the methods installed from the cache"
+    (code,out,err)=r.run_command(None,'%s -Ojit -Dcodecache %s -Dverbose=execpolicy %s testdata/codecache.abc' % (r.avm,dir,args))
+    return len(re.findall('jit-cached',out))
+
+def run():
+    r=RunTestLib()
+    (code,usage,err)=r.run_command(None,r.avm)
+    if not re.search('-Dcodecache',usage):
+        print("codecache     not supported by this shell")
+        return
+    verbose=re.search('-Dverbose',usage)!=None
+    dir=tempfile.mkdtemp()
+    try:
+        command='%s -Ojit -Dcodecache %s testdata/codecache.abc' % (r.avm,dir)
+        (code,cold,err)=r.run_command(None,command)
+        r.run_test('codecache cold',actualcode=code,actualout=cold,expectedcode=0,expectedout=['sumInts 19999','string CACHE-CODE'])
+        if len(cachefiles(dir))==0:
+            print("codecache     not supported on this platform")
+            return
+        expected=['^%s$' % re.escape(cold)]
+        r.run_test('codecache warm',command,expectedcode=0,expectedout=expected)
+        if verbose:
+            r.run_test('codecache warm loads',actualout='cached %d' % cached(r,dir),expectedout=['cached [1-9]'])
+
+        # Cut the files short: the records that remain are still used.
+        for f in cachefiles(dir):
+            size=os.path.getsize(f)
+            open(f,'r+b').truncate(size//2)
+        r.run_test('codecache truncated record',command,expectedcode=0,expectedout=expected)
+        if verbose:
+            r.run_test('codecache truncated record recovers',actualout='cached %d' % cached(r,dir),expectedout=['cached [1-9]'])
+
+        # A truncated header rejects the whole file.
+        for f in cachefiles(dir):
+            open(f,'r+b').truncate(10)
+        if verbose:
+            r.run_test('codecache truncated header',actualout='cached %d' % cached(r,dir),expectedout=['cached 0$'])
+        r.run_test('codecache truncated header output',command,expectedcode=0,expectedout=expected)
+        if verbose:
+            r.run_test('codecache truncated header recovers',actualout='cached %d' % cached(r,dir),expectedout=['cached [1-9]'])
+
+        # A bad checksum in the first record rejects every record after it.
+        shutil.rmtree(dir)
+        os.mkdir(dir)
+        r.run_command(None,command)
+        for f in cachefiles(dir):
+            fp=open(f,'r+b')
+            fp.seek(24+16+2)    # FileHeader, RecordHeader, into RecordBody::methodId
+            b=fp.read(1)
+            fp.seek(24+16+2)
+            fp.write(bytes(bytearray([ord(b)^0x40])))
+            fp.close()
+        if verbose:
+            r.run_test('codecache corrupt record',actualout='cached %d' % cached(r,dir),expectedout=['cached 0$'])
+        r.run_test('codecache corrupt record output',command,expectedcode=0,expectedout=expected)
+        if verbose:
+            r.run_test('codecache corrupt record recovers',actualout='cached %d' % cached(r,dir),expectedout=['cached [1-9]'])
+
+        # Code saved with other options that change the code is not used, and
+        # doesn't replace the code saved with the default options.
+        shutil.rmtree(dir)
+        os.mkdir(dir)
+        r.run_command(None,command)
+        files=len(cachefiles(dir))
+        if verbose:
+            r.run_test('codecache other options',actualout='cached %d' % cached(r,dir,'-Dnoinline'),expectedout=['cached 0$'])
+            r.run_test('codecache other options files',actualout='files %d' % len(cachefiles(dir)),expectedout=['files %d$' % (2*files)])
+            r.run_test('codecache default options',actualout='cached %d' % cached(r,dir),expectedout=['cached [1-9]'])
+        r.run_test('codecache other options output','%s -Ojit -Dcodecache %s -Dnoinline testdata/codecache.abc' % (r.avm,dir),expectedcode=0,expectedout=expected)
+    finally:
+        shutil.rmtree(dir,True)
+
+if __name__ == '__main__':
+    r=RunTestLib()
+    r.compile("testdata/codecache.as")
+    run()
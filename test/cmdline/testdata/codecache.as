@@ -0,0 +1,96 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Run by testCodeCache.py with -Ojit -Dcodecache: the code of these methods
+// refers to strings, doubles, classes, binding caches and helpers, which must
+// all be found again when the code is loaded from the cache.
+
+class Circle
+{
+    private var r:Number;
+    public function Circle(r:Number) { this.r = r; }
+    public function area():Number { return Math.PI * r * r; }
+    public function toString():String { return "circle(" + area().toFixed(2) + ")"; }
+}
+
+class Rect
+{
+    private var w:int, h:int;
+    public function Rect(w:int, h:int) { this.w = w; this.h = h; }
+    public function area():Number { return w * h; }
+    public function width():int { return w; }
+    public function resize(v:int):void { w = v; }
+    public function toString():String { return "rect(" + area().toFixed(2) + ")"; }
+}
+
+function sumInts(n:int):int
+{
+    var s:int = 0;
+    for (var i:int = 0; i < n; i++)
+        s += i * i % 7;
+    return s;
+}
+
+function fib(n:int):Number
+{
+    return n < 2 ? n : fib(n - 1) + fib(n - 2);
+}
+
+function totalArea(shapes:Array):Number
+{
+    var t:Number = 0;
+    for each (var s:* in shapes)
+        t += s.area();
+    return t;
+}
+
+function untyped(a, b)
+{
+    return a + b;
+}
+
+function describe(o:Object):String
+{
+    var keys:Array = [];
+    for (var k:String in o)
+        keys.push(k + "=" + o[k]);
+    keys.sort();
+    return keys.join(",");
+}
+
+function safeDivide(a:int, b:int):String
+{
+    try {
+        if (b == 0)
+            throw new RangeError("divide by zero");
+        return String(a / b);
+    } catch (e:RangeError) {
+        return "caught " + e.message;
+    }
+    return "unreachable";
+}
+
+function makeCounter():Function
+{
+    var count:int = 0;
+    return function():int { return ++count; };
+}
+
+var shapes:Array = [new Circle(1.5), new Rect(3, 4), new Circle(0.5)];
+var rect:Rect = shapes[1];
+rect.resize(5);
+
+print("sumInts " + sumInts(10000));
+print("fib " + fib(20));
+print("shapes " + shapes.join(" "));
+print("area " + totalArea(shapes).toFixed(4));
+print("width " + rect.width());
+print("untyped " + untyped(1, 2) + " " + untyped("a", 2) + " " + untyped(0.5, 0.25));
+print("describe " + describe({b: 2, a: "x", c: 1.5}));
+print("divide " + safeDivide(7, 2) + ", " + safeDivide(1, 0));
+var counter:Function = makeCounter();
+counter();
+counter();
+print("counter " + counter());
+print("string " + "code cache".toUpperCase().split(" ").reverse().join("-"));
@@ -0,0 +1,24 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+var DESC = "Late bound get, set and call at a site that sees four classes";
+include "driver.as"
+
+class P1 { public var x:int = 1; public function f():int { return x; } }
+class P2 { public var y:int = 0; public var x:int = 2; public function f():int { return x; } }
+class P3 { public var x:Number = 3; public function f():int { return 3; } }
+class P4 { public var x:int = 4; public function f():int { return 4; } }
+
+var objs:Array = [new P1, new P2, new P3, new P4];
+
+function polymorphic():void {
+    var s:Number = 0;
+    for ( var i:uint=0 ; i < 100000 ; i++ ) {
+        var o:* = objs[i & 3];
+        o.x = o.x + 1;
+        s += o.f();
+    }
+}
+
+TEST(polymorphic, "pic-1");
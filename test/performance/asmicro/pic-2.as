@@ -0,0 +1,28 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+var DESC = "Late bound get, set and call at a site that sees eight classes";
+include "driver.as"
+
+class M1 { public var x:int = 1; public function f():int { return x; } }
+class M2 { public var y:int = 0; public var x:int = 2; public function f():int { return x; } }
+class M3 { public var x:Number = 3; public function f():int { return 3; } }
+class M4 { public var x:int = 4; public function f():int { return 4; } }
+class M5 { public var x:Number = 5; public function f():int { return x; } }
+class M6 { public var w:int = 0; public var x:int = 6; public function f():int { return 6; } }
+class M7 { public var z:int = 0; public var x:uint = 7; public function f():int { return 7; } }
+class M8 { public var x:* = 8; public function f():int { return 8; } }
+
+var objs:Array = [new M1, new M2, new M3, new M4, new M5, new M6, new M7, new M8];
+
+function megamorphic():void {
+    var s:Number = 0;
+    for ( var i:uint=0 ; i < 100000 ; i++ ) {
+        var o:* = objs[i & 7];
+        o.x = o.x + 1;
+        s += o.f();
+    }
+}
+
+TEST(megamorphic, "pic-2");
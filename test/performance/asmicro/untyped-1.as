@@ -0,0 +1,18 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+var DESC = "Add and compare of untyped variables that hold ints";
+include "driver.as"
+
+function untypedInt():* {
+    var s:* = 0;
+    for ( var i:* = 0 ; i < 100000 ; i = i + 1 ) {
+        if (i == 50000)
+            s = s + 2;
+        s = s + i;
+    }
+    return s;
+}
+
+TEST(untypedInt, "untyped-1");
@@ -0,0 +1,18 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+var DESC = "Add and compare of untyped variables that hold Numbers";
+include "driver.as"
+
+function untypedNumber():* {
+    var s:* = 0.5;
+    var d:* = 0.25;
+    for ( var i:* = 0.5 ; i < 100000.5 ; i = i + 1.0 ) {
+        if (s >= d)
+            s = s + d;
+    }
+    return s;
+}
+
+TEST(untypedNumber, "untyped-2");
@@ -0,0 +1,21 @@
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+var DESC = "Concatenation of untyped variables that hold Strings";
+include "driver.as"
+
+var words:Array = ["alpha", "beta", "gamma", "delta"];
+
+function untypedString():* {
+    var n:* = 0;
+    for ( var i:uint=0 ; i < 10000 ; i++ ) {
+        var a:* = words[i & 3];
+        var b:* = words[(i + 1) & 3];
+        var s:* = a + b;
+        n = n + s.length;
+    }
+    return n;
+}
+
+TEST(untypedString, "untyped-3");
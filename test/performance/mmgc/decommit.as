@@ -0,0 +1,46 @@
+/* -*- mode: java; tab-width: 4 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Returning memory to the OS.  Every round builds a large heap and drops most of it,
+// so that the collection that follows finds most of the heap free and GCHeap::Decommit
+// decommits it; every other round is smaller, so that a part of the memory is free
+// only until the next round and is decommitted and committed again unless decommit
+// has hysteresis.
+//
+//   avmshell -memstats decommit.as -- <rounds> <MB per round>   (default 20, 200)
+//   avmshell -asyncdecommit -memstats decommit.as
+//   avmshell -asyncdecommit -decommithysteresis 2 -memstats decommit.as
+//
+// The metric is the total time.  The pause histogram printed by -memstats shows the
+// pauses of the collections that decommit, and with -asyncdecommit the time the
+// releaser thread spent in the system calls.
+
+import avmplus.System;
+
+var rounds:int = System.argv.length > 0 ? int(System.argv[0]) : 20;
+var megabytes:int = System.argv.length > 1 ? int(System.argv[1]) : 200;
+
+var then = new Date();
+var total:Number = 0;
+var kept:Array = [];
+for (var r:int = 0; r < rounds; r++) {
+    var size:int = (r & 1) ? megabytes / 2 : megabytes;
+    var chunks:Array = [];
+    // 64KB of doubles per chunk.
+    for (var i:int = 0; i < size * 16; i++) {
+        var v:Vector.<Number> = new Vector.<Number>(8192);
+        v[i & 8191] = i;
+        chunks.push(v);
+    }
+    for (i = 0; i < chunks.length; i += 64)
+        total += chunks[i][i & 8191];
+    // Keep a sliver so that the heap does not shrink to nothing.
+    kept.push(chunks[0]);
+    chunks = null;
+    System.forceFullCollection();
+}
+var elapsed = new Date() - then;
+print("decommit: " + rounds + " x " + megabytes + " MB, checksum " + total + ", " + elapsed + " ms");
+print("metric time " + elapsed);
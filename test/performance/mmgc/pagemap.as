@@ -0,0 +1,56 @@
+/* -*- mode: java; tab-width: 4 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Page map lookups.  Every word of the native stack that falls inside the GC's
+// address range is looked up in the page map when the stack is scanned, so a deep
+// recursion whose frames hold references to objects scattered over a large heap
+// makes stack scanning mostly page map lookups, from all over the map.
+//
+//   avmshell -gcsummary pagemap.as -- <heap MB> <depth>     (default 256, 4000)
+//
+// The metric is the time of the collections at the bottom of the recursion; the
+// root-and-stack-scan rate reported by -gcsummary is the number to compare when
+// changing the page map.  A heap of more than 128MB spreads the references over
+// several page map leaves.
+
+import avmplus.System;
+
+const kCollections:int = 50;
+const kChunk:int = 64*1024;
+
+var heapMB:int = System.argv.length > 0 ? int(System.argv[0]) : 256;
+var depth:int = System.argv.length > 1 ? int(System.argv[1]) : 4000;
+
+// Fresh strings of about 64KB each, so that they are large objects spread over the
+// heap, with a small object allocated in between each.
+var bulk:Array = [];
+var small:Array = [];
+var s:String = "x";
+while (s.length < kChunk / 2)
+    s += s;
+for (var i:int = 0; i < heapMB * 1024 * 1024 / kChunk; i++) {
+    bulk.push(s + i);
+    small.push({ v: i });
+}
+
+function collect():Number {
+    var then = new Date();
+    for (var i:int = 0; i < kCollections; i++)
+        System.forceFullCollection();
+    return new Date() - then;
+}
+
+// Each frame holds references to a large and a small object far apart in the heap.
+function recurse(n:int, a:Object, b:Object, c:Object, d:Object):Number {
+    if (n == 0)
+        return collect();
+    var k:int = (n * 7919) % small.length;
+    return recurse(n - 1, bulk[k], small[k], bulk[small.length - 1 - k], small[(k * 31) % small.length]) + (a == null ? 0 : 0);
+}
+
+var shallow = collect();
+var deep = recurse(depth, null, null, null, null);
+print("collections near the top: " + shallow + " ms, at depth " + depth + ": " + deep + " ms");
+print("metric time " + deep);
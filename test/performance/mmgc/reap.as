@@ -0,0 +1,74 @@
+/* -*- mode: java; tab-width: 4 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// ZCT reaping.  Strings are reference counted, so the strings made by concatenation
+// and dropped right away are destroyed by the ZCT reaper rather than by the
+// collector; and dropping an array that holds the only references to many strings
+// enters them all into the ZCT at once when the array is reaped, which makes for
+// one long reap unless reaps are sliced.  The strings of the last phase are
+// stored in a scrambled order, so that they are not destroyed in address order.
+//
+//   avmshell -memstats reap.as -- <million strings> <array length>   (default 4, 200000)
+//   avmshell -gcreapslice 1000 -memstats reap.as
+//
+// The metric is the total time.  The pause histogram printed by -memstats shows
+// what slicing does to the reap pauses.
+
+import avmplus.System;
+
+var millions:int = System.argv.length > 0 ? int(System.argv[0]) : 4;
+var arrayLength:int = System.argv.length > 1 ? int(System.argv[1]) : 200000;
+
+// Short-lived strings.
+function churn(n:int):int {
+    var total:int = 0;
+    for (var i:int = 0; i < n; i++) {
+        var s:String = "s" + i;
+        total += s.length;
+    }
+    return total;
+}
+
+// Arrays of strings that are dropped all at once.
+function teardown(n:int):int {
+    var total:int = 0;
+    var a:Array = [];
+    for (var i:int = 0; i < n; i++) {
+        a.push("t" + i);
+        if (a.length == arrayLength) {
+            total += a.length;
+            a = [];
+        }
+    }
+    return total;
+}
+
+// The same, but the strings are stored in the array in a scrambled order, so that
+// they enter the ZCT in no particular order of address when the array is reaped.
+function scrambled(n:int):int {
+    var total:int = 0;
+    var a:Array = new Array(arrayLength);
+    var k:int = 0;
+    for (var i:int = 0; i < n; i++) {
+        a[(k * 7919) % arrayLength] = "u" + i;
+        if (++k == arrayLength) {
+            total += a.length;
+            a = new Array(arrayLength);
+            k = 0;
+        }
+    }
+    return total;
+}
+
+var then = new Date();
+var total:int = 0;
+for (var m:int = 0; m < millions; m++) {
+    total += churn(500000);
+    total += teardown(500000);
+    total += scrambled(500000);
+}
+var elapsed = new Date() - then;
+print("strings: " + millions + "M, checksum " + total + ", " + elapsed + " ms");
+print("metric time " + elapsed);
@@ -0,0 +1,40 @@
+/* -*- mode: java; tab-width: 4 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Collecting with a deep native stack.  Every round recurses to the given depth through
+// JIT-compiled frames that each hold a few objects, numbers and dead values, and
+// collects at the bottom, so that the stack scan is a good part of the mark work.
+//
+//   avmshell -Ojit -memstats recursion.as -- <rounds> <depth>   (default 200, 2000)
+//   avmshell -Ojit -gcexactstack -memstats recursion.as
+//
+// The metric is the total time.  With -gcexactstack, -memstats prints how many words
+// of the stack were traced, skipped and scanned conservatively by each collection.
+
+import avmplus.System;
+
+var rounds:int = System.argv.length > 0 ? int(System.argv[0]) : 200;
+var depth:int = System.argv.length > 1 ? int(System.argv[1]) : 2000;
+
+function descend(n:int, parent:Object):Number
+{
+    var node:Object = { parent: parent, value: n };
+    var scratch:Array = [n, n + 1];
+    var x:Number = n * 0.5;
+    if (n == 0) {
+        System.forceFullCollection();
+        return x + scratch.length;
+    }
+    var result:Number = descend(n - 1, node) + x;
+    return result + node.value + scratch[1];
+}
+
+var then = new Date();
+var total:Number = 0;
+for (var r:int = 0; r < rounds; r++)
+    total += descend(depth, null);
+var elapsed = new Date() - then;
+print("recursion: " + rounds + " x " + depth + " frames, checksum " + total + ", " + elapsed + " ms");
+print("metric time " + elapsed);
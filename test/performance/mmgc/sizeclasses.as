@@ -0,0 +1,38 @@
+/* -*- mode: java; tab-width: 4 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Small-object size classes.  The program keeps many vectors alive whose backing
+// stores fall just above the built-in size classes, so that much of each item is
+// wasted; -gcsizestats reports the waste per class and writes size classes fitted
+// to the run, which -gcsizeclasses then uses:
+//
+//   avmshell -gcsizestats sizes.txt sizeclasses.as -- <thousand vectors>   (default 200)
+//   avmshell -gcsizeclasses sizes.txt sizeclasses.as
+//
+// The metric is the total time; compare the heap sizes printed by the two runs.
+
+import avmplus.System;
+
+var thousands:int = System.argv.length > 0 ? int(System.argv[0]) : 200;
+
+// Vector lengths whose backing stores are somewhat larger than a built-in class.
+var lengths:Array = [ 34, 62, 100, 140, 170, 250, 330 ];
+
+var then = new Date();
+var live:Array = [];
+var total:int = 0;
+for (var t:int = 0; t < thousands; t++) {
+    for (var i:int = 0; i < 1000; i++) {
+        var v:Vector.<int> = new Vector.<int>(lengths[i % lengths.length]);
+        v[0] = i;
+        total += v.length;
+        // Keep a quarter of the vectors, drop the rest.
+        if ((i & 3) == 0)
+            live.push(v);
+    }
+}
+var elapsed = new Date() - then;
+print("vectors: " + thousands + "K, " + live.length + " live, checksum " + total + ", heap " + System.totalMemory + " bytes, " + elapsed + " ms");
+print("metric time " + elapsed);
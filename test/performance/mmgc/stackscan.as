@@ -0,0 +1,42 @@
+/* -*- mode: java; tab-width: 4 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Conservative scanning of a deep native stack.  Every frame of a deep recursion
+// is on the native stack, which each full collection scans word by word, so the
+// collections at the bottom of the recursion take longer than the same
+// collections near the top; the difference is mostly stack scanning.
+//
+//   avmshell -gcsummary stackscan.as -- <depth>     (default 4000)
+//
+// The metric is the time of the collections at the bottom.  With -gcsummary the
+// GC also reports the words of roots and stacks it scanned conservatively and
+// the rate (root-and-stack-scan), which is the number to look at; combine with
+// -gcmarkthreads to scan in parallel.
+
+import avmplus.System;
+
+const kCollections:int = 100;
+
+function collect():Number {
+    var then = new Date();
+    for (var i:int = 0; i < kCollections; i++)
+        System.forceFullCollection();
+    return new Date() - then;
+}
+
+// Frames hold a mix of pointers and numbers, like real code.
+function recurse(n:int, d:Number, o:Object, s:String):Number {
+    if (n == 0)
+        return collect();
+    var x = { v: n };
+    return recurse(n - 1, d * 0.5, x, s) + (o == null ? 0 : 0);
+}
+
+var depth = System.argv.length > 0 ? int(System.argv[0]) : 4000;
+
+var shallow = collect();
+var deep = recurse(depth, 1.0, null, "s");
+print("collections near the top: " + shallow + " ms, at depth " + depth + ": " + deep + " ms");
+print("metric time " + deep);
@@ -0,0 +1,51 @@
+/* -*- mode: java; tab-width: 4 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// The weak-reference table.  Every key of a Dictionary(true) has a weak reference,
+// so filling weak-keyed dictionaries fills the GC's weak-reference table and
+// looking keys up probes it; when the dictionaries are dropped their keys die
+// together and the collector clears tens of thousands of weak references at the
+// end of one collection.  Half of the keys are kept alive in between, so that the
+// table is probed while it holds many live entries and many removed ones.
+//
+//   avmshell weakrefs.as -- <rounds> <keys per round>   (default 20, 50000)
+//
+// The metric is the total time.  With -gcincweakrefs -gcstats the collector logs
+// how many weak references each collection visited during marking and how many in
+// its final pause.
+
+import avmplus.System;
+import flash.utils.Dictionary;
+
+var rounds:int = System.argv.length > 0 ? int(System.argv[0]) : 20;
+var keysPerRound:int = System.argv.length > 1 ? int(System.argv[1]) : 50000;
+
+var then = new Date();
+var total:int = 0;
+var survivors:Array = [];
+for (var r:int = 0; r < rounds; r++) {
+    var d:Dictionary = new Dictionary(true);
+    var keys:Array = [];
+    for (var i:int = 0; i < keysPerRound; i++) {
+        var k:Object = {};
+        d[k] = i;
+        keys.push(k);
+    }
+    // Lookups of present keys.
+    for (var j:int = 0; j < 4; j++) {
+        for (i = 0; i < keysPerRound; i++)
+            total += int(d[keys[i]]) & 1;
+    }
+    // Keep every other key of the last round alive, drop the rest with the dictionary.
+    survivors = [];
+    for (i = 0; i < keysPerRound; i += 2)
+        survivors.push(keys[i]);
+    keys = null;
+    d = null;
+    System.forceFullCollection();
+}
+var elapsed = new Date() - then;
+print("weak keys: " + rounds + " x " + keysPerRound + ", checksum " + total + ", " + elapsed + " ms");
+print("metric time " + elapsed);
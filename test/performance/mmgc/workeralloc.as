@@ -0,0 +1,63 @@
+/* -*- mode: java; tab-width: 4 -*- */
+/* This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/. */
+
+// Allocation throughput with several workers allocating at once.  Every worker
+// has its own GC but the workers share the heap, so this exposes contention on
+// the heap.  Each worker does the same amount of work, so with enough cores the
+// time should stay flat as workers are added:
+//
+//   avmshell workeralloc.as -- <workers>     (default 4)
+
+import flash.system.Worker;
+import flash.system.WorkerDomain;
+import flash.utils.ByteArray;
+import avmplus.System;
+
+const kIterations:int = 500000;
+
+if (Worker.current.isPrimordial) {
+    var workers = System.argv.length > 0 ? int(System.argv[0]) : 4;
+
+    // One word per worker, set by the worker when it is done.
+    var results = new ByteArray();
+    results.shareable = true;
+    results.length = 4 * workers;
+
+    var then = new Date();
+    for (var i:int = 0; i < workers; i++) {
+        var w = WorkerDomain.current.createWorkerFromPrimordial();
+        w.setSharedProperty("results", results);
+        w.setSharedProperty("index", i);
+        w.start();
+    }
+
+    var done:int = 0;
+    while (done < workers) {
+        System.sleep(1);
+        done = 0;
+        for (i = 0; i < workers; i++) {
+            results.position = 4 * i;
+            if (results.readInt() != 0)
+                done++;
+        }
+    }
+    var now = new Date();
+    print("metric time " + (now - then));
+}
+else {
+    results = Worker.current.getSharedProperty("results");
+    var index = Worker.current.getSharedProperty("index");
+
+    // Short-lived objects of a few sizes, so that several allocators create and
+    // free blocks.
+    var sum:int = 0;
+    for (i = 0; i < kIterations; i++) {
+        var o = { a: i, b: [i, i], c: "x" + (i & 255) };
+        sum += o.b[1] & 1;
+    }
+
+    results.position = 4 * index;
+    results.writeInt(1 + (sum & 1));
+}
@@ -0,0 +1,262 @@
+#!/usr/bin/env python
+# This Source Code Form is subject to the terms of the Mozilla Public
+# License, v. 2.0. If a copy of the MPL was not distributed with this
+# file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+# Reads a heap snapshot written by GC::WriteHeapSnapshot (avmshell -gcsnapshot F),
+# computes the dominator tree of the object graph, and reports the shallow and
+# retained sizes by type and the objects that retain the most memory.
+#
+# The object that dominates 'o' is the object through which every path from the
+# roots to 'o' passes; the retained size of an object is the amount of memory
+# that would be freed if the object were.  See MMgc/GCHeapSnapshot.h for the
+# format.
+
+import sys
+from getopt import getopt, GetoptError
+from os.path import basename
+
+MAGIC = b"AVMHEAP\0"
+VERSION = 1
+
+ROOT_KINDS = { 0: "exact root", 1: "conservative root", 2: "stack" }
+FIXED_TYPES = { 1: "(pointer-free object)", 2: "(conservatively traced object)", 3: "float", 4: "float4", 5: "String", 6: "Namespace" }
+
+def usage(c):
+    print("usage: %s [options] snapshot" % basename(sys.argv[0]))
+    print(" -n --top N      show the N largest types and objects (default 20)")
+    print(" -h --help       show this message")
+    sys.exit(c)
+
+class Snapshot:
+    def __init__(self, data):
+        self.data = bytearray(data)
+        self.pos = 0
+        self.types = dict(FIXED_TYPES)
+        self.roots = []         # [(kind, address)]
+        self.objects = []       # [(address, size, type, flags)]
+        self.edges = []         # [[target address]], parallel to roots + objects
+        self.read()
+
+    def fail(self, msg):
+        raise ValueError("offset %d: %s" % (self.pos, msg))
+
+    def unsigned(self):
+        v = 0
+        shift = 0
+        while True:
+            if self.pos >= len(self.data):
+                self.fail("truncated")
+            b = self.data[self.pos]
+            self.pos += 1
+            v |= (b & 0x7f) << shift
+            shift += 7
+            if b < 0x80:
+                return v
+
+    def address(self, base):
+        v = self.unsigned()
+        return base + ((v >> 1) ^ -(v & 1))
+
+    def read(self):
+        if self.data[0:8] != bytearray(MAGIC):
+            self.fail("not a heap snapshot")
+        self.pos = 8
+        version = self.unsigned()
+        if version != VERSION:
+            self.fail("unsupported version %d" % version)
+        previous = 0
+        source = None
+        while True:
+            if self.pos >= len(self.data):
+                self.fail("truncated")
+            tag = chr(self.data[self.pos])
+            self.pos += 1
+            if tag == 'T':
+                id = self.unsigned()
+                n = self.unsigned()
+                self.types[id] = self.data[self.pos:self.pos+n].decode("utf-8", "replace")
+                self.pos += n
+            elif tag == 'R':
+                kind = self.unsigned()
+                source = self.address(0)
+                self.roots.append((kind, source))
+                self.edges.append([])
+            elif tag == 'O':
+                source = self.address(previous)
+                previous = source
+                size = self.unsigned()
+                type = self.unsigned()
+                flags = self.unsigned()
+                self.objects.append((source, size, type, flags))
+                self.edges.append([])
+            elif tag == 'E':
+                if source is None:
+                    self.fail("edge without a source")
+                self.edges[-1].append(self.address(source))
+            elif tag == 'Z':
+                numObjects = self.unsigned()
+                numEdges = self.unsigned()
+                if numObjects != len(self.objects) or numEdges != sum([len(e) for e in self.edges]):
+                    self.fail("counts do not match")
+                return
+            else:
+                self.fail("unknown record %r" % tag)
+
+    def typeName(self, type):
+        return self.types.get(type, "(type %d)" % type)
+
+# Computes the immediate dominators of the nodes of 'succs', a list of successor
+# lists with node 0 as the entry, with the iterative algorithm of Cooper, Harvey,
+# and Kennedy, "A Simple, Fast Dominance Algorithm".  Returns the dominators and
+# the nodes in reverse postorder; unreachable nodes are left out of both.
+def dominators(succs):
+    n = len(succs)
+    order = []
+    visited = [False] * n
+    visited[0] = True
+    stack = [(0, 0)]
+    while stack:
+        node, i = stack.pop()
+        if i < len(succs[node]):
+            stack.append((node, i+1))
+            s = succs[node][i]
+            if not visited[s]:
+                visited[s] = True
+                stack.append((s, 0))
+        else:
+            order.append(node)
+    order.reverse()
+    rpo = [-1] * n
+    for i in range(len(order)):
+        rpo[order[i]] = i
+    preds = [[] for i in range(n)]
+    for node in order:
+        for s in succs[node]:
+            preds[s].append(node)
+
+    idom = [-1] * n
+    idom[0] = 0
+    changed = True
+    while changed:
+        changed = False
+        for node in order[1:]:
+            new = -1
+            for p in preds[node]:
+                if idom[p] == -1:
+                    continue
+                if new == -1:
+                    new = p
+                    continue
+                a, b = p, new
+                while a != b:
+                    while rpo[a] > rpo[b]:
+                        a = idom[a]
+                    while rpo[b] > rpo[a]:
+                        b = idom[b]
+                new = a
+            if idom[node] != new:
+                idom[node] = new
+                changed = True
+    return idom, order
+
+def analyze(snap, top):
+    # Node 0 is a synthetic root that points to the roots and to the objects that
+    # no root reaches, then come the roots and then the objects.
+    numRoots = len(snap.roots)
+    first = 1 + numRoots
+    index = {}
+    for i in range(len(snap.objects)):
+        index[snap.objects[i][0]] = first + i
+    succs = [list(range(1, first))]
+    for targets in snap.edges:
+        succs.append([index[t] for t in targets if t in index])
+    reached = [False] * len(succs)
+    work = [0]
+    while work:
+        for t in succs[work.pop()]:
+            if not reached[t]:
+                reached[t] = True
+                work.append(t)
+    unreachable = [i for i in range(first, len(succs)) if not reached[i]]
+    succs[0].extend(unreachable)
+
+    idom, order = dominators(succs)
+    size = [0] * first + [o[1] for o in snap.objects]
+    retained = list(size)
+    for node in reversed(order[1:]):
+        retained[idom[node]] += retained[node]
+
+    total = sum(size)
+    print("%d roots, %d objects, %d references, %d bytes" % (numRoots, len(snap.objects), sum([len(e) for e in snap.edges]), total))
+    if unreachable:
+        print("%d objects (%d bytes) are not reachable from the roots" % (len(unreachable), sum([size[i] for i in unreachable])))
+
+    # The retained size of a type counts each object once: only objects that are
+    # not dominated by an object of the same type contribute theirs.
+    byType = {}
+    for i in range(len(snap.objects)):
+        node = first + i
+        type = snap.objects[i][2]
+        t = byType.setdefault(type, [0, 0, 0])
+        t[0] += 1
+        t[1] += size[node]
+        d = idom[node]
+        while d >= first and snap.objects[d - first][2] != type:
+            d = idom[d]
+        if d < first:
+            t[2] += retained[node]
+
+    print("")
+    print("%10s %12s %12s  %s" % ("count", "shallow", "retained", "type"))
+    types = sorted(byType.items(), key=lambda kv: (-kv[1][2], -kv[1][1]))
+    for type, t in types[:top]:
+        print("%10d %12d %12d  %s" % (t[0], t[1], t[2], snap.typeName(type)))
+
+    print("")
+    print("%10s %12s  %-18s %s" % ("shallow", "retained", "address", "type, dominated by"))
+    nodes = sorted(range(1, len(succs)), key=lambda node: -retained[node])
+    for node in nodes[:top]:
+        if node < first:
+            kind, addr = snap.roots[node - 1]
+            what = ROOT_KINDS.get(kind, "root")
+        else:
+            addr, s, type, flags = snap.objects[node - first]
+            what = snap.typeName(type)
+        d = idom[node]
+        if d == 0:
+            by = "a root" if node < first or reached[node] else "unreachable"
+        elif d < first:
+            by = ROOT_KINDS.get(snap.roots[d - 1][0], "root")
+        else:
+            by = "%s 0x%x" % (snap.typeName(snap.objects[d - first][2]), snap.objects[d - first][0])
+        print("%10d %12d  0x%-16x %s, %s" % (size[node], retained[node], addr, what, by))
+
+def main():
+    top = 20
+    try:
+        opts, args = getopt(sys.argv[1:], "n:h", ["top=", "help"])
+    except GetoptError:
+        usage(2)
+    for o, v in opts:
+        if o in ("-n", "--top"):
+            top = int(v)
+        elif o in ("-h", "--help"):
+            usage(0)
+    if len(args) != 1:
+        usage(2)
+    f = open(args[0], "rb")
+    try:
+        data = f.read()
+    finally:
+        f.close()
+    try:
+        snap = Snapshot(data)
+    except ValueError:
+        e = sys.exc_info()[1]
+        print("%s: %s" % (args[0], e))
+        sys.exit(1)
+    analyze(snap, top)
+
+if __name__ == '__main__':
+    main()
@@ -2710,6 +2710,7 @@ usageAndQuit(const string& progname)
         "  -v --verbose      print LIR and assembly code\n"
         "  --execute         execute LIR\n"
         "  --[no-]optimize   enable or disable optimization of the LIR (default=off)\n"
+        "  --globalregalloc  keep the values used in loops in registers across back edges\n"
         "  --random [N]      generate a random LIR block of size N (default=100)\n"
         "  --stkskip [N]     push approximately N Kbytes of stack before execution (default=100)\n"
         "\n"
@@ -2804,6 +2805,8 @@ processCmdLine(int argc, char **argv, CmdLineOptions& opts)
             opts.optimize = true;
         else if (arg == "--no-optimize")
             opts.optimize = false;
+        else if (arg == "--globalregalloc")
+            opts.config.global_regalloc = true;
         else if (arg == "--random") {
             if (!parseOptionalInt(argc, argv, &i, &opts.random, 100))
                 errMsgAndQuit(opts.progname, "--random argument must be greater than zero");
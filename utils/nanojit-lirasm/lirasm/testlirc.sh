@@ -99,6 +99,7 @@ if [[ $($LIRASM --show-arch 2>/dev/null) == "i386" ]] ; then
     runtests "littleendian"
     runtest "--random 1000000"
     runtest "--random 1000000 --optimize"
+    runtests "."               "--globalregalloc"
 
     if [[ $TESTFLOAT != float ]] ; then
         # i386 without SSE2.
@@ -117,6 +118,8 @@ elif [[ $($LIRASM --show-arch 2>/dev/null) == "X64" ]] ; then
     runtests "littleendian"
     runtest "--random 1000000"
     runtest "--random 1000000 --optimize"
+    runtests "."               "--globalregalloc"
+    runtests "64-bit"          "--globalregalloc"
 
 elif [[ $($LIRASM --show-arch 2>/dev/null) == "arm" ]] ; then
     # ARMv7 with VFP.  We could test without VFP but such a platform seems